@@ -0,0 +1,89 @@
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mCc/lexer.h"
+#include "mCc/source.h"
+
+/* All examples, one after the other */
+static char *read_examples(size_t *size)
+{
+	char *text = NULL;
+	*size = 0;
+	DIR *dir = opendir(MCC_EXAMPLES_DIR);
+	if (!dir)
+		return NULL;
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		size_t len = strlen(entry->d_name);
+		if (len < 3 || strcmp(entry->d_name + len - 3, ".mC") != 0)
+			continue;
+
+		char path[4096];
+		snprintf(path, sizeof(path), "%s/%s", MCC_EXAMPLES_DIR, entry->d_name);
+		struct mCc_source source;
+		if (mCc_source_open(&source, path))
+			continue;
+		char *tmp = realloc(text, *size + source.size + 1);
+		if (tmp) {
+			text = tmp;
+			memcpy(text + *size, source.data, source.size);
+			*size += source.size;
+			text[(*size)++] = '\n';
+		}
+		mCc_source_close(&source);
+	}
+	closedir(dir);
+	return text;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	const long repetitions = argc >= 2 ? atol(argv[1]) : 50;
+
+	// The examples repeated to about 4 MB
+	size_t size;
+	char *examples = read_examples(&size);
+	assert(examples && size > 0);
+	size_t copies = (4 << 20) / size + 1;
+	char *text = malloc(copies * size);
+	assert(text);
+	for (size_t i = 0; i < copies; ++i)
+		memcpy(text + i * size, examples, size);
+	free(examples);
+
+	struct mCc_source source;
+	int ret = mCc_source_init(&source, text, copies * size, NULL);
+	assert(ret == 0);
+	(void)ret;
+	free(text);
+
+	const char *names[] = { "flex", "hand" };
+	unsigned int counts[2];
+	for (int kind = MCC_LEXER_KIND_FLEX; kind <= MCC_LEXER_KIND_HAND; ++kind) {
+		double start = now();
+		for (long i = 0; i < repetitions; i++) {
+			struct mCc_lexer_token *tokens =
+			    mCc_lexer_tokens(&source, kind, &counts[kind]);
+			assert(tokens);
+			free(tokens);
+		}
+		double seconds = now() - start;
+		printf("%s: %u tokens, %.1f MB/s\n", names[kind], counts[kind],
+		       repetitions * (source.size / 1e6) / seconds);
+	}
+	assert(counts[MCC_LEXER_KIND_FLEX] == counts[MCC_LEXER_KIND_HAND]);
+
+	mCc_source_close(&source);
+	return EXIT_SUCCESS;
+}
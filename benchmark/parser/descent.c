@@ -0,0 +1,100 @@
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mCc/ast.h"
+#include "mCc/parser.h"
+#include "mCc/source.h"
+
+/* All examples, one after the other */
+static char *read_examples(size_t *size)
+{
+	char *text = NULL;
+	*size = 0;
+	DIR *dir = opendir(MCC_EXAMPLES_DIR);
+	if (!dir)
+		return NULL;
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		size_t len = strlen(entry->d_name);
+		if (len < 3 || strcmp(entry->d_name + len - 3, ".mC") != 0)
+			continue;
+
+		char path[4096];
+		snprintf(path, sizeof(path), "%s/%s", MCC_EXAMPLES_DIR, entry->d_name);
+		struct mCc_source source;
+		if (mCc_source_open(&source, path))
+			continue;
+		char *tmp = realloc(text, *size + source.size + 1);
+		if (tmp) {
+			text = tmp;
+			memcpy(text + *size, source.data, source.size);
+			*size += source.size;
+			text[(*size)++] = '\n';
+		}
+		mCc_source_close(&source);
+	}
+	closedir(dir);
+	return text;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	const long repetitions = argc >= 2 ? atol(argv[1]) : 20;
+
+	// The examples repeated to about 1 MB, a program of many functions
+	size_t size;
+	char *examples = read_examples(&size);
+	assert(examples && size > 0);
+	size_t copies = (1 << 20) / size + 1;
+	char *program = malloc(copies * size + 1);
+	assert(program);
+	for (size_t i = 0; i < copies; ++i)
+		memcpy(program + i * size, examples, size);
+	program[copies * size] = '\0';
+	free(examples);
+
+	const char expression[] = "42 * (-192 + 3.14) - a[i + 1] / f(x, y) < 7";
+
+	const enum mCc_parser_kind kinds[] = { MCC_PARSER_KIND_BISON,
+		                                   MCC_PARSER_KIND_DESCENT };
+	const char *names[] = { "bison", "descent" };
+	for (int k = 0; k < 2; ++k) {
+		enum mCc_parser_kind kind = kinds[k];
+
+		double start = now();
+		for (long i = 0; i < repetitions; i++) {
+			struct mCc_parser_result result =
+			    mCc_parser_parse_buffer(program, copies * size, kind);
+			assert(result.status == MCC_PARSER_STATUS_OK);
+			mCc_ast_delete_program(result.program);
+		}
+		double program_seconds = now() - start;
+
+		start = now();
+		for (long i = 0; i < repetitions * 5000; i++) {
+			struct mCc_parser_result result = mCc_parser_parse_buffer(
+			    expression, sizeof(expression) - 1, kind);
+			assert(result.status == MCC_PARSER_STATUS_OK);
+			mCc_ast_delete_expression(result.expression);
+		}
+		double expression_seconds = now() - start;
+
+		printf("%s: program %.1f MB/s, expression %.2f us\n", names[k],
+		       repetitions * (copies * size / 1e6) / program_seconds,
+		       expression_seconds * 1e6 / (repetitions * 5000));
+	}
+
+	free(program);
+	return EXIT_SUCCESS;
+}
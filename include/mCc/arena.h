@@ -0,0 +1,110 @@
+/**
+ * @file arena.h
+ * @brief Bump allocator for data that is released all at once.
+ *
+ * An arena hands out memory from large blocks by advancing a pointer and
+ * never frees single allocations. Deleting the arena frees all its blocks,
+ * so releasing a whole data structure costs one call per block instead of one
+ * free per object. The parser allocates the AST from an arena.
+ *
+ * An arena may only be used by one thread at a time.
+ *
+ * @author richard
+ * @date 2018-07-04
+ */
+#ifndef MCC_ARENA_H
+#define MCC_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Size of the first block, which also holds the arena itself
+#define MCC_ARENA_FIRST_BLOCK_SIZE (4 * 1024)
+/// Blocks double in size up to this
+#define MCC_ARENA_MAX_BLOCK_SIZE (256 * 1024)
+
+struct mCc_arena_block;
+
+struct mCc_arena {
+    struct mCc_arena_block *blocks; ///< Most recent block first
+    char *pos;                      ///< Next free byte in the current block
+    char *end;                      ///< End of the current block
+    void *last;                     ///< Most recent allocation, or NULL
+    size_t next_block_size;
+    size_t allocated; ///< Bytes handed out, for statistics
+};
+
+/// A point in the life of an arena, see #mCc_arena_release
+struct mCc_arena_mark {
+    struct mCc_arena_block *block; ///< The current block at the time
+    char *pos;
+    char *end;
+    void *last;
+    size_t allocated;
+};
+
+/**
+ * @brief Create an empty arena.
+ *
+ * @return The arena, or NULL on memory error
+ */
+struct mCc_arena *mCc_arena_new(void);
+
+/**
+ * @brief Free every block of an arena and the arena itself.
+ */
+void mCc_arena_delete(struct mCc_arena *arena);
+
+/**
+ * @brief Allocate memory aligned for any type.
+ *
+ * @return The memory, or NULL on memory error
+ */
+void *mCc_arena_alloc(struct mCc_arena *arena, size_t size);
+
+/**
+ * @brief Resize an allocation of the arena, like realloc.
+ *
+ * The most recent allocation grows in place if its block has room, others
+ * are copied and their old memory is wasted until the arena is deleted.
+ *
+ * @param arena The arena
+ * @param ptr The allocation, or NULL to allocate
+ * @param old_size The size it was allocated with
+ * @param new_size The size requested
+ *
+ * @return The allocation, or NULL on memory error, leaving ptr unchanged
+ */
+void *mCc_arena_realloc(struct mCc_arena *arena, void *ptr, size_t old_size,
+                        size_t new_size);
+
+/**
+ * @brief Copy a string into the arena.
+ *
+ * @return The copy, or NULL on memory error
+ */
+char *mCc_arena_strdup(struct mCc_arena *arena, const char *str);
+
+/**
+ * @brief Remember the current end of the allocations of an arena.
+ */
+struct mCc_arena_mark mCc_arena_mark(const struct mCc_arena *arena);
+
+/**
+ * @brief Free everything allocated since a mark, like a partial delete.
+ *
+ * The blocks started since are freed, and the memory is handed out again.
+ *
+ * @param arena The arena
+ * @param mark A mark of the arena, taken after any mark released since
+ */
+void mCc_arena_release(struct mCc_arena *arena, struct mCc_arena_mark mark);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_ARENA_H
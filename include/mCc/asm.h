@@ -8,6 +8,7 @@
 #define MCC_ASM_H
 
 #include "tac.h"
+#include "writer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,11 +19,76 @@ struct mCc_asm_stack_pos {
 	int stack_ptr;
 	enum mCc_tac_quad_literal_type lit_type;
 	float float_lit; ///< (Optional) For float numbers
+	bool indirect;   ///< Local slot holding a pointer to an array parameter
 };
 
-void mCc_asm_generate_assembly(struct mCc_tac_program *prog, FILE *out,
+#define MCC_ASM_ARRAY_LENGTH 4096
+
+/// Registers for the first arguments of the internal calling convention
+#define MCC_ASM_INTERNAL_REG_PARAMS 3
+
+/// A register argument of the upcoming call, loaded right before the call
+struct mCc_asm_reg_param {
+	bool used;
+	int stack_ptr;
+	bool address; ///< Pass the address (local array) instead of the value
+};
+
+/**
+ * @brief The stack layout of the function being generated, kept in a
+ * #mCc_context.
+ */
+struct mCc_asm_state {
+	struct mCc_asm_stack_pos position[MCC_ASM_ARRAY_LENGTH];
+	struct mCc_asm_stack_pos position_param[MCC_ASM_ARRAY_LENGTH];
+	struct mCc_asm_stack_pos position_fpu[MCC_ASM_ARRAY_LENGTH];
+	int current_elements_in_local_array;
+	int current_elements_in_param_array;
+	int current_elements_in_fpu;
+	int current_frame_pointer;
+	int current_param_pointer;
+	int var_count;
+	struct mCc_asm_reg_param pending_reg_params[MCC_ASM_INTERNAL_REG_PARAMS];
+	const char *function; ///< Name of the function, qualifies its labels
+};
+
+struct mCc_context;
+
+void mCc_asm_generate_assembly(struct mCc_context *ctx,
+                               struct mCc_tac_program *prog, FILE *out,
                                char *source_filename);
 
+/**
+ * @brief Like #mCc_asm_generate_assembly, but into a writer which is not
+ * flushed.
+ */
+void mCc_asm_write_assembly(struct mCc_context *ctx,
+                            struct mCc_tac_program *prog,
+                            struct mCc_writer *out, char *source_filename);
+
+/**
+ * @brief Write the part of the assembly in front of the functions.
+ */
+void mCc_asm_write_header(struct mCc_writer *out, const char *source_filename);
+
+/**
+ * @brief Write the assembly of a single function, with its strings and
+ * floats.
+ *
+ * The assembly only depends on the quads of the function, since its labels
+ * are named after it. #mCc_asm_write_assembly is the header followed by every
+ * function.
+ *
+ * @param ctx The context
+ * @param prog The program
+ * @param begin Position of the label of the function
+ * @param end Position after the last quad of the function
+ * @param out The writer, not flushed
+ */
+void mCc_asm_write_function(struct mCc_context *ctx,
+                            struct mCc_tac_program *prog, unsigned int begin,
+                            unsigned int end, struct mCc_writer *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,10 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mCc/intern.h"
 
 /* Forward Declarations */
 struct mCc_ast_expression;
@@ -23,17 +27,24 @@ struct mCc_ast_statement;
 struct mCc_ast_identifier;
 struct mCc_ast_arguments;
 struct mCc_symtab_entry;
+struct mCc_arena;
+struct mCc_source;
 
 /* ---------------------------------------------------------------- AST Node */
 
 /**
  * Node attribute containing the source location.
+ *
+ * The parser only records the byte offsets. The lines and columns stay 0
+ * until #mCc_source_resolve looks them up for a diagnostic or printer.
  */
 struct mCc_ast_source_location {
 	int start_line;
 	int start_col;
 	int end_line;
 	int end_col;
+	uint32_t start_offset; ///< Offset of the first byte
+	uint32_t end_offset;   ///< Offset after the last byte, 0 if not parsed
 };
 
 /**
@@ -56,8 +67,80 @@ struct mCc_ast_node {
 	enum mCc_ast_type computed_type;     ///< computed type from Type checking
 	bool outside_if; ///< keeps track íf the node is inside an if, for type
 	                 ///< checking
+	bool arena_root; ///< Deleting this node deletes its arena
+	struct mCc_arena *arena; ///< Arena holding the node, NULL if malloc'd
 };
 
+/* ------------------------------------------------------------------ Memory */
+
+/**
+ * @brief Allocate the nodes created by this thread from an arena.
+ *
+ * Nodes, their strings and their arrays are then not freed one by one: the
+ * delete functions do nothing for them, except on the node passed to
+ * #mCc_ast_set_arena_root, which deletes the whole arena. The parser
+ * allocates every tree it builds like this.
+ *
+ * @param arena The arena, or NULL to use malloc again
+ *
+ * @return The arena used before
+ */
+struct mCc_arena *mCc_ast_use_arena(struct mCc_arena *arena);
+
+/**
+ * @brief Let the deletion of a node release the arena it was allocated from.
+ *
+ * @param node The root of the tree, its arena must be a different one from
+ *             that of every other root
+ */
+void mCc_ast_set_arena_root(struct mCc_ast_node *node);
+
+/**
+ * @brief Intern the names and strings of the nodes this thread allocates.
+ *
+ * Identifiers and string literals allocated from an arena then point to the
+ * text of their atom instead of a copy of their own, and identifiers carry
+ * the atom. The parser interns every tree it builds into an interner in the
+ * arena of the tree.
+ *
+ * @param interner The interner, which must live as long as the nodes, or NULL
+ *                 to copy the text again
+ *
+ * @return The interner used before
+ */
+struct mCc_interner *mCc_ast_use_interner(struct mCc_interner *interner);
+
+/**
+ * @brief Allocate a node, from the current arena if there is one.
+ *
+ * @param size The size of the node, which starts with a #mCc_ast_node
+ *
+ * @return The node with its memory attributes set, or NULL on memory error
+ */
+void *mCc_ast_alloc_node(size_t size);
+
+/**
+ * @brief Resize an array or string belonging to a node, like realloc.
+ *
+ * @param owner The node owning the array
+ * @param ptr The array, or NULL to allocate a new one
+ * @param old_size The size of the array in bytes
+ * @param new_size The size requested
+ *
+ * @return The array, or NULL on memory error, leaving ptr unchanged
+ */
+void *mCc_ast_realloc(const struct mCc_ast_node *owner, void *ptr,
+                      size_t old_size, size_t new_size);
+
+/**
+ * @brief Handle the deletion of a node from an arena.
+ *
+ * @param node The node to delete
+ *
+ * @return true if the node is in an arena and must not be freed
+ */
+bool mCc_ast_delete_from_arena(struct mCc_ast_node *node);
+
 /* Don't move or remove this! It needs to be below #mCc_ast_node because that is
  * used in ast_statements.h */
 #include "ast_statements.h"
@@ -157,6 +240,9 @@ struct mCc_ast_expression {
 		struct {
 			struct mCc_ast_arguments *arguments; ///< argument list
 			struct mCc_ast_identifier *f_name;   ///< function name
+			/// The called function, set by symbol linking. Unlike
+			/// f_name->symtab_ref, it outlives the symbol tables.
+			const struct mCc_ast_function_def *callee;
 		};
 
 		/**
@@ -349,6 +435,9 @@ void mCc_ast_delete_literal(struct mCc_ast_literal *literal);
 
 /* -------------------------------------------------------------- Identifiers */
 
+/// Slot of an identifier that is not linked to a variable
+#define MCC_AST_SLOT_NONE ((unsigned int)-1)
+
 /**
  * Node representing a identifier.
  */
@@ -359,6 +448,11 @@ struct mCc_ast_identifier {
 	 * The ID string
 	 */
 	char *id_value;
+	/// The interned name, #MCC_ATOM_NONE if id_value is a copy of its own
+	mCc_atom atom;
+	/// Index of the variable, array or parameter among those of its function,
+	/// set by symbol linking; #MCC_AST_SLOT_NONE for functions
+	unsigned int slot;
 };
 
 /**
@@ -474,6 +568,10 @@ struct mCc_ast_program {
 	unsigned int func_def_alloc_size;
 	unsigned int func_def_count;             ///< Number of function definitions
 	struct mCc_ast_function_def **func_defs; ///< Function definitions
+	/// The interner of the names and strings, NULL if they are not interned
+	struct mCc_interner *interner;
+	/// The text it was parsed from, to resolve locations, or NULL
+	struct mCc_source *source;
 };
 
 /**
@@ -0,0 +1,204 @@
+/**
+ * @file ast_compact.h
+ * @brief Compact AST kept in contiguous arrays.
+ *
+ * The nodes of a program are stored by kind in arrays and refer to each other
+ * by 32-bit indices instead of pointers. Expressions and statements are laid
+ * out in pre-order, so the first child of a node directly follows it and all
+ * nodes of a function are one contiguous range. Lists (arguments, parameters,
+ * sub-statements) are runs in #mCc_ast_compact.lists, names and string
+ * literals live in one character pool. Source locations are the offset of the
+ * first character of a node in the source buffer; the end of a node is not
+ * kept.
+ *
+ * A pass that looks at every node of a kind scans an array from front to back
+ * instead of chasing pointers, like the fingerprints of the function cache
+ * (see #mCc_func_cache_fingerprint_compact). Code using the pointer AST and
+ * #mCc_ast_visitor runs on a tree expanded from the compact one.
+ *
+ * @author richard
+ * @date 2018-07-06
+ */
+#ifndef MCC_AST_COMPACT_H
+#define MCC_AST_COMPACT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mCc/ast.h"
+#include "mCc/ast_visit.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Index of a missing node or list
+#define MCC_AST_COMPACT_NONE UINT32_MAX
+
+/**
+ * Expression. The first sub-expression of unary operations, parentheses,
+ * binary operations (lhs) and array subscripts is the next expression.
+ */
+struct mCc_ast_compact_expression {
+    uint8_t type;          ///< #mCc_ast_expression_type
+    uint8_t op;            ///< #mCc_ast_unary_op or #mCc_ast_binary_op
+    uint8_t computed_type; ///< #mCc_ast_type
+    uint32_t loc;          ///< Offset in the source
+    /// Literal, identifier (calls and subscripts: the name) or NONE
+    uint32_t a;
+    /// Binary operations: rhs, calls: argument list or NONE
+    uint32_t b;
+};
+
+/**
+ * Statement. The body of an if or while is the next statement.
+ */
+struct mCc_ast_compact_statement {
+    uint8_t type;          ///< #mCc_ast_statement_type
+    uint8_t computed_type; ///< #mCc_ast_type
+    uint32_t loc;          ///< Offset in the source
+    /// Expression (condition, return value, ...), assigned identifier,
+    /// declaration or statement list of a compound statement, or NONE
+    uint32_t a;
+    uint32_t b; ///< Else statement or array subscript of an assignment
+    uint32_t c; ///< Assigned expression
+};
+
+struct mCc_ast_compact_literal {
+    uint8_t type; ///< #mCc_ast_literal_type
+    uint32_t loc; ///< Offset in the source
+    union {
+        long i_value;
+        double f_value;
+        uint32_t s_value; ///< Offset in the character pool
+        bool b_value;
+    };
+};
+
+struct mCc_ast_compact_identifier {
+    uint32_t loc;  ///< Offset in the source
+    uint32_t name; ///< Offset in the character pool
+};
+
+struct mCc_ast_compact_declaration {
+    uint8_t type;        ///< #mCc_ast_type
+    uint32_t loc;        ///< Offset in the source
+    uint32_t identifier; ///< The declared identifier
+    uint32_t array_size; ///< Literal or NONE
+};
+
+struct mCc_ast_compact_function {
+    uint8_t type;              ///< #mCc_ast_type returned
+    uint32_t loc;              ///< Offset in the source
+    uint32_t identifier;       ///< The name
+    uint32_t parameters;       ///< List of declarations or NONE
+    uint32_t body;             ///< Statement or NONE
+    uint32_t first_expression; ///< Its expressions start here
+    uint32_t first_statement;  ///< Its statements start here
+};
+
+/// A growing array of a node kind
+#define MCC_AST_COMPACT_ARRAY(type)                                            \
+    struct {                                                                   \
+        type *data;                                                            \
+        uint32_t count;                                                        \
+        uint32_t capacity;                                                     \
+    }
+
+struct mCc_ast_compact {
+    MCC_AST_COMPACT_ARRAY(struct mCc_ast_compact_expression) expressions;
+    MCC_AST_COMPACT_ARRAY(struct mCc_ast_compact_statement) statements;
+    MCC_AST_COMPACT_ARRAY(struct mCc_ast_compact_literal) literals;
+    MCC_AST_COMPACT_ARRAY(struct mCc_ast_compact_identifier) identifiers;
+    MCC_AST_COMPACT_ARRAY(struct mCc_ast_compact_declaration) declarations;
+    MCC_AST_COMPACT_ARRAY(struct mCc_ast_compact_function) functions;
+    /// Lists: the length followed by the indices of the elements
+    MCC_AST_COMPACT_ARRAY(uint32_t) lists;
+    MCC_AST_COMPACT_ARRAY(char) chars; ///< NUL-terminated names and strings
+    /// Offset at which every line starts, to recover lines and columns
+    MCC_AST_COMPACT_ARRAY(uint32_t) line_starts;
+    /// The functions sorted by name, see #mCc_ast_compact_find_function
+    MCC_AST_COMPACT_ARRAY(uint32_t) functions_by_name;
+};
+
+/**
+ * @brief Build the compact form of a program.
+ *
+ * @param compact The compact AST, must be freed with #mCc_ast_compact_free
+ *                even on error
+ * @param prog The parsed, possibly type checked program
+ * @param source The source it was parsed from
+ * @param size The length of the source
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+int mCc_ast_compact_build(struct mCc_ast_compact *compact,
+                          const struct mCc_ast_program *prog,
+                          const char *source, size_t size);
+
+/**
+ * @brief Free the arrays of a compact AST.
+ */
+void mCc_ast_compact_free(struct mCc_ast_compact *compact);
+
+/**
+ * @brief The line and column of an offset, like those of the parser.
+ *
+ * Start and end of the result are both set to the offset.
+ */
+struct mCc_ast_source_location
+mCc_ast_compact_location(const struct mCc_ast_compact *compact,
+                         uint32_t offset);
+
+/**
+ * @brief The length and elements of a list.
+ *
+ * @param compact The compact AST
+ * @param list The list or NONE, which is empty
+ * @param count Set to the number of elements
+ *
+ * @return The elements
+ */
+const uint32_t *mCc_ast_compact_list(const struct mCc_ast_compact *compact,
+                                     uint32_t list, uint32_t *count);
+
+/**
+ * @brief The name of an identifier.
+ */
+const char *mCc_ast_compact_name(const struct mCc_ast_compact *compact,
+                                 uint32_t identifier);
+
+/**
+ * @brief Find a function of the program by name.
+ *
+ * @return Its index in #mCc_ast_compact.functions, or #MCC_AST_COMPACT_NONE
+ */
+uint32_t mCc_ast_compact_find_function(const struct mCc_ast_compact *compact,
+                                       const char *name);
+
+/**
+ * @brief Expand a compact AST into pointer nodes.
+ *
+ * The program lives in an arena of its own and is released with
+ * #mCc_ast_delete_program. Source locations end where they start.
+ *
+ * @return The program, or NULL on memory error
+ */
+struct mCc_ast_program *
+mCc_ast_compact_expand(const struct mCc_ast_compact *compact);
+
+/**
+ * @brief Run a visitor over a compact AST, as #mCc_ast_visit_program does.
+ *
+ * The visitor sees the nodes of an expanded tree, which is deleted afterwards.
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+int mCc_ast_compact_visit(const struct mCc_ast_compact *compact,
+                          struct mCc_ast_visitor *visitor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_AST_COMPACT_H
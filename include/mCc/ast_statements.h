@@ -224,6 +224,11 @@ struct mCc_ast_function_def {
 	struct mCc_ast_statement *body;
 	struct mCc_ast_identifier *identifier;
 	struct mCc_ast_parameters *para;
+	/// Number of slots of its variables, arrays and parameters, set by
+	/// symbol linking
+	unsigned int slot_count;
+	/// Whether this is a built-in function implemented in C (cdecl)
+	bool built_in;
 };
 
 /**
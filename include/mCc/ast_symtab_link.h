@@ -23,8 +23,51 @@ struct mCc_ast_symtab_build_result {
 	struct mCc_symtab_scope *root_symtab;
 };
 
+struct mCc_context;
+
+/**
+ * @brief Build the symbol tables of a program and link its identifiers.
+ *
+ * @param ctx The context owning the scopes
+ * @param prog The program
+ *
+ * @return The result, root_symtab is NULL on error
+ */
+struct mCc_ast_symtab_build_result
+mCc_ast_symtab_build(struct mCc_context *ctx, struct mCc_ast_program *prog);
+
+/**
+ * @brief Open the root scope and enter the functions of a program, without
+ * linking their bodies.
+ *
+ * The functions need no bodies, like the signatures of a streamed parse (see
+ * #mCc_parser_parse_source_stream). Their bodies are linked one at a time by
+ * #mCc_ast_symtab_build_function afterwards.
+ *
+ * @param ctx The context, which keeps the root scope
+ * @param prog The program of the functions, which must outlive the scopes
+ *
+ * @return The result, with the root scope unless there was an error
+ */
+struct mCc_ast_symtab_build_result
+mCc_ast_symtab_declare(struct mCc_context *ctx, struct mCc_ast_program *prog);
+
+/**
+ * @brief Link the body of a function in the root scope of
+ * #mCc_ast_symtab_declare.
+ *
+ * The scopes of the function linked before are freed first, so the context
+ * only keeps those of one function besides the root scope. On error, all
+ * scopes are freed.
+ *
+ * @param ctx The context of #mCc_ast_symtab_declare
+ * @param func The function, declared in the root scope
+ *
+ * @return The result
+ */
 struct mCc_ast_symtab_build_result
-mCc_ast_symtab_build(struct mCc_ast_program *prog);
+mCc_ast_symtab_build_function(struct mCc_context *ctx,
+                              struct mCc_ast_function_def *func);
 
 #ifdef __cplusplus
 }
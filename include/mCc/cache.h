@@ -0,0 +1,156 @@
+/**
+ * @file cache.h
+ * @brief Content-addressed on-disk cache of compiler outputs.
+ *
+ * An entry is addressed by a hash of its key, which the caller builds from
+ * everything the output depends on: the compiler, the options and the
+ * source. Sources are normalised first, so changing whitespace or comments
+ * still hits. Every entry stores its whole key, so a hash collision is a
+ * miss and never a wrong output.
+ *
+ * Entries are written to a temporary file and renamed, so concurrent
+ * compilers never see half an entry. Hits refresh the modification time,
+ * and the least recently used entries are evicted when the cache outgrows
+ * its size limit.
+ *
+ * @author richard
+ * @date 2018-06-29
+ */
+#ifndef MCC_CACHE_H
+#define MCC_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mCc/writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Default size limit, 256 MiB
+#define MCC_CACHE_DEFAULT_MAX_SIZE (UINT64_C(256) << 20)
+
+struct mCc_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t entries; ///< Only filled in by #mCc_cache_read_stats
+    uint64_t size;    ///< Bytes in the entries, like entries
+};
+
+struct mCc_cache {
+    char *dir;
+    uint64_t max_size;            ///< Older entries are evicted beyond it
+    pthread_mutex_t lock;         ///< Guards stats
+    struct mCc_cache_stats stats; ///< Of this process, saved when closing
+};
+
+struct mCc_cache_key {
+    struct mCc_writer writer; ///< Collects the parts
+    char *data;               ///< The key, after #mCc_cache_key_finish
+    size_t size;
+    uint64_t hash;
+};
+
+/**
+ * @brief Hash bytes, e.g. a large input to add to a key as its digest.
+ */
+uint64_t mCc_cache_hash(const void *data, size_t size);
+
+/**
+ * @brief Normalise a source: outside of string literals, comments become a
+ * space and runs of white space a single space, which is dropped next to
+ * punctuation that never joins another token.
+ *
+ * Follows the lexer exactly, so sources with the same normal form have the
+ * same tokens.
+ *
+ * @param src The source
+ * @param len Its length
+ * @param out Receives the normal form, at most len bytes
+ *
+ * @return The length of the normal form
+ */
+size_t mCc_cache_normalise(const char *src, size_t len, char *out);
+
+void mCc_cache_key_init(struct mCc_cache_key *key);
+
+/**
+ * @brief Add a part to a key, parts are delimited by their size.
+ */
+void mCc_cache_key_add(struct mCc_cache_key *key, const void *data,
+                       size_t size);
+
+void mCc_cache_key_add_string(struct mCc_cache_key *key, const char *str);
+
+void mCc_cache_key_add_uint(struct mCc_cache_key *key, uint64_t value);
+
+/**
+ * @brief Add the normal form of a source to a key.
+ */
+void mCc_cache_key_add_source(struct mCc_cache_key *key, const char *src,
+                              size_t len);
+
+/**
+ * @brief Finish a key after its last part.
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+int mCc_cache_key_finish(struct mCc_cache_key *key);
+
+void mCc_cache_key_free(struct mCc_cache_key *key);
+
+/**
+ * @brief Open a cache, creating its directory if needed.
+ *
+ * @param cache The cache
+ * @param dir The directory
+ * @param max_size The size limit in bytes
+ *
+ * @return 0 on success, -1 with errno set on error
+ */
+int mCc_cache_open(struct mCc_cache *cache, const char *dir,
+                   uint64_t max_size);
+
+/**
+ * @brief Look up an entry.
+ *
+ * @param cache The cache
+ * @param key The finished key
+ * @param data Set to the entry's data, free it with free(3)
+ * @param size Set to the size of data
+ *
+ * @return 0 on a hit, non-zero on a miss
+ */
+int mCc_cache_get(struct mCc_cache *cache, const struct mCc_cache_key *key,
+                  char **data, size_t *size);
+
+/**
+ * @brief Add or replace an entry.
+ *
+ * @return 0 on success, non-zero on error
+ */
+int mCc_cache_put(struct mCc_cache *cache, const struct mCc_cache_key *key,
+                  const void *data, size_t size);
+
+/**
+ * @brief Add the statistics of this process to the cache, evict entries over
+ * the size limit and free the cache.
+ */
+void mCc_cache_close(struct mCc_cache *cache);
+
+/**
+ * @brief Read the statistics of a cache directory.
+ *
+ * @return 0 on success, -1 with errno set if the directory cannot be read
+ */
+int mCc_cache_read_stats(const char *dir, struct mCc_cache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_CACHE_H
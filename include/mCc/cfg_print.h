@@ -14,8 +14,13 @@ struct connect{
 };
 
 void mCc_cfg_program_print(struct mCc_tac_program *self, FILE *out);
-void mCc_cfg_quad_print(struct mCc_tac_program *self, struct mCc_tac_quad *quad,FILE *out);
-void mCc_cfg_print_connections(struct mCc_tac_program *self, FILE *out);
+void mCc_cfg_program_write(struct mCc_tac_program *self,
+                           struct mCc_writer *out);
+/// first_func is set while no function has been printed yet and cleared
+void mCc_cfg_quad_print(struct mCc_tac_program *self, struct mCc_tac_quad *quad,
+                        struct mCc_writer *out, int *first_func);
+void mCc_cfg_print_connections(struct mCc_tac_program *self,
+                               struct mCc_writer *out);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,152 @@
+/**
+ * @file compile.h
+ * @brief In-process compilation of a source buffer.
+ *
+ * Runs parsing, symbol table construction, type checking, TAC generation,
+ * optimisation and code generation without touching the file system. The
+ * result is returned in a buffer owned by the caller, together with the
+ * diagnostics. Every call compiles in its own #mCc_context, starts from a
+ * clean state and frees everything it allocated besides the output, so calls
+ * may be repeated and run on several threads at once. With a
+ * #mCc_func_cache, only the functions that changed since an earlier call are
+ * generated again. Streamed, every function is compiled and freed as soon as
+ * it is parsed, see #mCc_compile_stream.
+ *
+ * @author richard
+ * @date 2018-06-26
+ */
+#ifndef MCC_COMPILE_H
+#define MCC_COMPILE_H
+
+#include <stddef.h>
+
+#include "mCc/ast.h"
+#include "mCc/parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mCc_context;
+struct mCc_func_cache;
+struct mCc_source;
+struct mCc_writer;
+
+enum mCc_compile_output_kind {
+    MCC_COMPILE_OUTPUT_ASSEMBLY, ///< AT&T assembly text
+    MCC_COMPILE_OUTPUT_OBJECT    ///< ELF32 relocatable object
+};
+
+enum mCc_compile_status {
+    MCC_COMPILE_STATUS_OK,
+    MCC_COMPILE_STATUS_PARSE_ERROR,
+    MCC_COMPILE_STATUS_SYMTAB_ERROR,
+    MCC_COMPILE_STATUS_TYPE_ERROR,
+    MCC_COMPILE_STATUS_ASSEMBLER_ERROR,
+    MCC_COMPILE_STATUS_MEMORY_ERROR,
+    MCC_COMPILE_STATUS_SERVER_ERROR ///< See #mCc_client_compile
+};
+
+struct mCc_compile_options {
+    const char *source_name; ///< Name for the .file directive
+    unsigned int opt_level;  ///< 0-3, see #mCc_tac_opt_default_options
+    enum mCc_compile_output_kind output_kind;
+    /// Parser of a whole program, streaming uses the descent parser
+    enum mCc_parser_kind parser;
+    /// Reuses the functions of earlier compilations, or NULL
+    struct mCc_func_cache *func_cache;
+    /// Compile each function as soon as it is parsed, unless there is a
+    /// func_cache, which needs the whole program
+    int stream;
+};
+
+struct mCc_compile_diagnostic {
+    enum mCc_compile_status status;
+    struct mCc_ast_source_location loc; ///< All 0 if not applicable
+    char *message;                      ///< Human-readable description
+    char *text; ///< Source text at the error, NULL except for parse errors
+};
+
+struct mCc_output {
+    enum mCc_compile_status status;
+    char *data;  ///< The assembly (NUL-terminated) or object, NULL on error
+    size_t size; ///< Size of data, without the terminating NUL
+    struct mCc_compile_diagnostic *diagnostics;
+    unsigned int diagnostic_count;
+};
+
+/**
+ * @brief Options for assembly output at the given optimisation level.
+ */
+struct mCc_compile_options mCc_compile_default_options(unsigned int opt_level);
+
+/**
+ * @brief Compile a source buffer in memory.
+ *
+ * Thread-safe, concurrent calls do not share any state.
+ *
+ * @param src The source, need not be NUL-terminated
+ * @param len The length of src
+ * @param options The options, NULL for #mCc_compile_default_options(0)
+ * @param output Filled in with the result, release with #mCc_output_free
+ *
+ * @return #MCC_COMPILE_STATUS_OK or the status of the first diagnostic
+ */
+enum mCc_compile_status
+mCc_compile_string(const char *src, size_t len,
+                   const struct mCc_compile_options *options,
+                   struct mCc_output *output);
+
+/**
+ * @brief Compile a source buffer in memory, reusing a context.
+ *
+ * Like #mCc_compile_string, but the context is reset afterwards instead of
+ * deleted, so a long-running caller can keep one context per thread. A
+ * context must only be used by one thread at a time.
+ *
+ * @param ctx The context, see #mCc_context_new
+ */
+enum mCc_compile_status
+mCc_compile_string_in_context(struct mCc_context *ctx, const char *src,
+                              size_t len,
+                              const struct mCc_compile_options *options,
+                              struct mCc_output *output);
+
+/**
+ * @brief Compile a source function by function into a writer.
+ *
+ * After a pre-scan of the signatures, each function is linked, checked,
+ * translated, optimised and written as soon as it is parsed, and freed
+ * before the next one is parsed (see #mCc_parser_parse_source_stream). Only
+ * the largest function is held in memory besides the source and whatever
+ * the writer keeps, and the assembly is the same as that of a whole
+ * compilation.
+ *
+ * Errors are reported in the order of the source, so an error in a function
+ * is found before a syntax error in a later one. From a function with
+ * statements nested too deeply to stream on, the rest of the program is
+ * compiled as a whole.
+ *
+ * @param ctx The context, which is reset afterwards
+ * @param source The source
+ * @param options The options, the output kind and func_cache are ignored
+ * @param writer Receives the assembly, which is incomplete on error
+ * @param output Filled in with the diagnostics, without data
+ *
+ * @return #MCC_COMPILE_STATUS_OK or the status of the first diagnostic
+ */
+enum mCc_compile_status
+mCc_compile_stream(struct mCc_context *ctx, struct mCc_source *source,
+                   const struct mCc_compile_options *options,
+                   struct mCc_writer *writer, struct mCc_output *output);
+
+/**
+ * @brief Free the data and diagnostics of an output, which can be reused.
+ */
+void mCc_output_free(struct mCc_output *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_COMPILE_H
@@ -0,0 +1,61 @@
+/**
+ * @file context.h
+ * @brief The state of one compilation.
+ *
+ * Every phase keeps the state it needs across calls (counters, the scopes
+ * to free, the stack layout of the code generator, ...) in a context instead
+ * of globals. A context is passed to each phase of the same compilation, so
+ * separate contexts may be used on separate threads at the same time.
+ *
+ * @author richard
+ * @date 2018-06-27
+ */
+#ifndef MCC_CONTEXT_H
+#define MCC_CONTEXT_H
+
+#include "mCc/asm.h"
+#include "mCc/ast_symtab_link.h"
+#include "mCc/symtab.h"
+#include "mCc/tac.h"
+#include "mCc/tac_builder.h"
+#include "mCc/typecheck.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mCc_context {
+    struct mCc_symtab_state symtab;                 ///< Scopes
+    struct mCc_ast_symtab_build_result symtab_link; ///< The pending result
+    struct mCc_typecheck_state typecheck;
+    struct mCc_tac_numbering tac_numbering;
+    struct mCc_tac_builder_state tac_builder;
+    struct mCc_asm_state assembly;
+};
+
+/**
+ * @brief Create an empty context.
+ *
+ * @return The context, or NULL if out of memory
+ */
+struct mCc_context *mCc_context_new(void);
+
+/**
+ * @brief Delete a context together with the scopes and strings it still owns.
+ *
+ * Programs built in the context must be deleted first.
+ */
+void mCc_context_delete(struct mCc_context *ctx);
+
+/**
+ * @brief Free what a compilation left in a context, so the next one can start.
+ *
+ * Programs built in the context must be deleted first.
+ */
+void mCc_context_reset(struct mCc_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_CONTEXT_H
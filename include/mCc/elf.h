@@ -0,0 +1,179 @@
+/**
+ * @file elf.h
+ * @brief Declarations for 32-bit ELF objects: writing, reading and linking.
+ * @author richard
+ * @date 2018-06-20
+ */
+#ifndef MCC_ELF_H
+#define MCC_ELF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Section index of undefined symbols
+#define MCC_ELF_UNDEF (-1)
+/// Section index of absolute symbols
+#define MCC_ELF_ABS (-2)
+
+/// Relocation types of the i386 ABI, the addend is stored in place
+enum mCc_elf_reloc_type {
+    MCC_ELF_R_386_32 = 1,   ///< Absolute address S + A
+    MCC_ELF_R_386_PC32 = 2, ///< PC-relative address S + A - P
+    MCC_ELF_R_386_PLT32 = 4 ///< Call through the PLT, linked statically as PC32
+};
+
+struct mCc_elf_reloc {
+    uint32_t offset;              ///< Offset of the patched word in the section
+    enum mCc_elf_reloc_type type;
+    unsigned int symbol;          ///< Index into the symbols of the object
+};
+
+struct mCc_elf_section {
+    char *name;
+    uint32_t type;  ///< SHT_PROGBITS or SHT_NOBITS
+    uint32_t flags; ///< SHF_* flags
+    uint32_t align;
+    unsigned char *data; ///< NULL for SHT_NOBITS
+    uint32_t size;
+    uint32_t capacity;
+    struct mCc_elf_reloc *relocs;
+    unsigned int reloc_count;
+    unsigned int reloc_capacity;
+    uint32_t addr; ///< Virtual address, set by the linker
+};
+
+struct mCc_elf_symbol {
+    char *name;
+    int section; ///< Index of the section, #MCC_ELF_UNDEF or #MCC_ELF_ABS
+    uint32_t value;
+    bool global;
+    bool is_section; ///< Section symbol, named after its section
+};
+
+/// A relocatable object in memory
+struct mCc_elf_object {
+    struct mCc_elf_section *sections;
+    unsigned int section_count;
+    struct mCc_elf_symbol *symbols;
+    unsigned int symbol_count;
+    unsigned int symbol_capacity;
+    int *symbol_hash;              ///< Open addressing on names, -1 is free
+    unsigned int symbol_hash_size; ///< Power of two
+};
+
+/// Error description of the assembler, reader and linker
+struct mCc_elf_error {
+    unsigned int line; ///< Line of the assembler input, 0 if not applicable
+    char msg[160];
+};
+
+/// Section flags
+#define MCC_ELF_SHF_WRITE (0x1)
+#define MCC_ELF_SHF_ALLOC (0x2)
+#define MCC_ELF_SHF_EXECINSTR (0x4)
+
+/// Section types
+#define MCC_ELF_SHT_PROGBITS (1)
+#define MCC_ELF_SHT_NOBITS (8)
+
+struct mCc_elf_object *mCc_elf_object_new(void);
+
+void mCc_elf_object_delete(struct mCc_elf_object *obj);
+
+/**
+ * @brief Get a section by name or add it.
+ *
+ * @param obj The object
+ * @param name The section name, e.g. ".text"
+ * @param type The type of a new section
+ * @param flags The flags of a new section
+ *
+ * @return The section index, or -1 on memory error
+ */
+int mCc_elf_get_section(struct mCc_elf_object *obj, const char *name,
+                        uint32_t type, uint32_t flags);
+
+/**
+ * @brief Append bytes to a section.
+ *
+ * @param section The section
+ * @param data The bytes, or NULL to append zeros
+ * @param size The number of bytes
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+int mCc_elf_section_append(struct mCc_elf_section *section, const void *data,
+                           uint32_t size);
+
+/**
+ * @brief Get a symbol by name or add it as undefined local symbol.
+ *
+ * @param obj The object
+ * @param name The symbol name
+ *
+ * @return The symbol index, or -1 on memory error
+ */
+int mCc_elf_get_symbol(struct mCc_elf_object *obj, const char *name);
+
+/**
+ * @brief Add a relocation to a section.
+ *
+ * @param section The section containing the patched word
+ * @param offset The offset of the patched word
+ * @param type The relocation type
+ * @param symbol The index of the symbol
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+int mCc_elf_add_reloc(struct mCc_elf_section *section, uint32_t offset,
+                      enum mCc_elf_reloc_type type, unsigned int symbol);
+
+/**
+ * @brief Write an object as ELF32 relocatable file (ET_REL).
+ *
+ * @param obj The object
+ * @param out The output file
+ *
+ * @return 0 on success, non-zero on I/O or memory error
+ */
+int mCc_elf_write_object(const struct mCc_elf_object *obj, FILE *out);
+
+/**
+ * @brief Read an ELF32 relocatable file of the i386 ABI.
+ *
+ * Only allocated sections and REL relocations are kept.
+ *
+ * @param in The input file
+ * @param error Set on failure
+ *
+ * @return The object, or NULL on failure
+ */
+struct mCc_elf_object *mCc_elf_read_object(FILE *in,
+                                           struct mCc_elf_error *error);
+
+/**
+ * @brief Link relocatable objects into a static executable (ET_EXEC).
+ *
+ * Code and read-only data are placed in one segment, writable data and bss
+ * in another. The entry point is the symbol _start.
+ *
+ * @param objs The objects, their section addresses are updated
+ * @param count The number of objects
+ * @param out The output file
+ * @param error Set on failure
+ *
+ * @return 0 on success, non-zero on failure
+ */
+int mCc_elf_link(struct mCc_elf_object **objs, unsigned int count, FILE *out,
+                 struct mCc_elf_error *error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_ELF_H
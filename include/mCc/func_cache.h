@@ -0,0 +1,127 @@
+/**
+ * @file func_cache.h
+ * @brief Cache of the optimised assembly of single functions.
+ *
+ * Every function is fingerprinted by its body, the signatures of the
+ * functions it calls and the optimisation options. Temporaries, labels,
+ * strings and floats are numbered per function and the labels in the
+ * assembly are named after their function, so the assembly of a function
+ * only depends on its fingerprint. An unchanged function in an edited program
+ * is copied from the cache, only the changed ones are built, optimised and
+ * generated again.
+ *
+ * The cache is kept in memory and may be shared by several threads. It can be
+ * backed by an on-disk #mCc_cache, so later processes find the functions too.
+ *
+ * @author richard
+ * @date 2018-07-02
+ */
+#ifndef MCC_FUNC_CACHE_H
+#define MCC_FUNC_CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mCc/ast.h"
+#include "mCc/ast_compact.h"
+#include "mCc/cache.h"
+#include "mCc/tac_opt.h"
+#include "mCc/writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mCc_context;
+struct mCc_func_cache_entry;
+
+/// Entries not used by this many compilations are evicted from memory
+#define MCC_FUNC_CACHE_MAX_AGE 16
+
+struct mCc_func_cache_stats {
+    uint64_t hits;   ///< Functions copied from the cache
+    uint64_t misses; ///< Functions generated
+};
+
+struct mCc_func_cache {
+    struct mCc_func_cache_entry *entries; ///< Hash table by fingerprint
+    uint64_t generation;                  ///< Compilations so far
+    pthread_mutex_t lock;                 ///< Guards everything but disk
+    struct mCc_func_cache_stats stats;
+    struct mCc_cache *disk; ///< Or NULL
+    char *prefix;           ///< Starts every key on disk
+    size_t prefix_size;
+};
+
+/**
+ * @brief Initialise an empty cache.
+ *
+ * @param cache The cache
+ * @param disk Stores the functions on disk as well, or NULL
+ * @param prefix A finished key of everything else the assembly depends on,
+ *               e.g. the compiler, only used with disk, may be NULL
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+int mCc_func_cache_init(struct mCc_func_cache *cache, struct mCc_cache *disk,
+                        const struct mCc_cache_key *prefix);
+
+/**
+ * @brief Free the entries of a cache, but not its disk cache.
+ */
+void mCc_func_cache_free(struct mCc_func_cache *cache);
+
+/**
+ * @brief Add the fingerprint of a function to a key.
+ *
+ * Covers the body, the types computed by the type checker and the signatures
+ * of the called functions. The program must be linked and type checked.
+ */
+void mCc_func_cache_fingerprint(struct mCc_cache_key *key,
+                                const struct mCc_ast_function_def *fun_def,
+                                const struct mCc_tac_opt_options *options);
+
+/**
+ * @brief Add the fingerprint of a function of a compact AST to a key.
+ *
+ * The same bytes as #mCc_func_cache_fingerprint for the function of the
+ * program the compact AST was built from, read by one pass over its
+ * expressions and statements. The callees are looked up by name among the
+ * functions of the program and the built-ins, as linking does.
+ *
+ * @param key The key
+ * @param compact A program that was linked and type checked before it was
+ *                built
+ * @param function The index of the function in #mCc_ast_compact.functions
+ * @param options The optimisation options
+ */
+void mCc_func_cache_fingerprint_compact(
+        struct mCc_cache_key *key, const struct mCc_ast_compact *compact,
+        uint32_t function, const struct mCc_tac_opt_options *options);
+
+/**
+ * @brief Write the assembly of a program, like #mCc_asm_write_assembly after
+ * #mCc_tac_build and #mCc_tac_optimize, reusing cached functions.
+ *
+ * @param cache The cache
+ * @param ctx The context the program was linked and type checked in
+ * @param prog The program
+ * @param options The optimisation options
+ * @param out The writer, not flushed
+ * @param source_filename Name for the .file directive
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+int mCc_func_cache_write_assembly(struct mCc_func_cache *cache,
+                                  struct mCc_context *ctx,
+                                  struct mCc_ast_program *prog,
+                                  const struct mCc_tac_opt_options *options,
+                                  struct mCc_writer *out,
+                                  const char *source_filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_FUNC_CACHE_H
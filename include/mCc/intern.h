@@ -0,0 +1,111 @@
+/**
+ * @file intern.h
+ * @brief String interning.
+ *
+ * An interner keeps one copy of every distinct string it is given and
+ * numbers them in order of appearance. The number, an atom, stands for the
+ * string: two atoms of the same interner are equal exactly if their strings
+ * are, so names are compared and hashed as 32-bit integers, and the text of
+ * an atom stays at the same address as long as the interner lives.
+ *
+ * The strings and the hash table live in an arena. The parser interns the
+ * identifiers and string literals of a tree into an interner in the arena of
+ * the tree, the symbol table keys its entries on the atoms.
+ *
+ * An interner may only be used by one thread at a time.
+ *
+ * @author richard
+ * @date 2018-07-08
+ */
+#ifndef MCC_INTERN_H
+#define MCC_INTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mCc_arena;
+
+/// An interned string
+typedef uint32_t mCc_atom;
+
+/// No string, never handed out by an interner
+#define MCC_ATOM_NONE ((mCc_atom)0)
+
+/// Number of slots of the hash table of a new interner
+#define MCC_INTERNER_FIRST_CAPACITY (256)
+
+struct mCc_interner_string {
+    const char *str;
+    uint32_t length;
+    uint32_t hash;
+};
+
+struct mCc_interner {
+    struct mCc_arena *arena; ///< Holds the strings and tables
+    bool own_arena;          ///< Whether deleting the interner deletes it
+    mCc_atom *slots;         ///< Open addressing, MCC_ATOM_NONE if empty
+    uint32_t capacity;       ///< Number of slots, a power of two
+    /// The strings by atom, the first one is unused
+    struct mCc_interner_string *strings;
+    uint32_t count;          ///< Atoms handed out plus one
+    uint32_t strings_capacity;
+    char *chars;             ///< Free space for the next strings
+    char *chars_end;
+};
+
+/**
+ * @brief Create an empty interner.
+ *
+ * @param arena The arena to allocate it from, which must outlive it, or NULL
+ *              for an arena of its own
+ *
+ * @return The interner, or NULL on memory error
+ */
+struct mCc_interner *mCc_interner_new(struct mCc_arena *arena);
+
+/**
+ * @brief Delete an interner and its strings, if it has an arena of its own.
+ *
+ * An interner in an arena of someone else goes away with that arena.
+ */
+void mCc_interner_delete(struct mCc_interner *interner);
+
+/**
+ * @brief The atom of a string, which is copied the first time it is seen.
+ *
+ * @param interner The interner
+ * @param str The string, which need not be NUL-terminated
+ * @param length The length of the string
+ *
+ * @return The atom, or #MCC_ATOM_NONE on memory error
+ */
+mCc_atom mCc_interner_intern(struct mCc_interner *interner, const char *str,
+                             size_t length);
+
+/**
+ * @brief The atom of a string, without adding it.
+ *
+ * @return The atom, or #MCC_ATOM_NONE if the string was never interned
+ */
+mCc_atom mCc_interner_find(const struct mCc_interner *interner,
+                           const char *str, size_t length);
+
+/**
+ * @brief The NUL-terminated text of an atom.
+ *
+ * @return The text, or NULL for #MCC_ATOM_NONE and atoms of other interners
+ *         beyond the number handed out by this one
+ */
+const char *mCc_interner_str(const struct mCc_interner *interner,
+                             mCc_atom atom);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_INTERN_H
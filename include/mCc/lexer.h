@@ -0,0 +1,110 @@
+/**
+ * @file lexer.h
+ * @brief Hand-written lexer, an alternative to the flex scanner.
+ *
+ * The lexer produces the same tokens with the same locations as the flex
+ * scanner in scanner.l. It skips whitespace and comments a vector of bytes at
+ * a time, classifies keywords and types with a perfect hash instead of a
+ * rule each, and converts literals without going through libc where the
+ * result is exact.
+ *
+ * Building with `-Dlexer=hand` makes the parser use it instead of flex. Both
+ * are always built, so they can be compared, see #mCc_lexer_tokens.
+ *
+ * Like flex, the lexer scans the text of a source in place and terminates
+ * the text of every token with a NUL until the next one is scanned.
+ *
+ * @author richard
+ * @date 2018-07-11
+ */
+#ifndef MCC_LEXER_H
+#define MCC_LEXER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mCc/ast.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mCc_source;
+
+struct mCc_lexer_token {
+    int kind;              ///< Token number of the parser, 0 at the end
+    uint32_t start_offset; ///< Offset of the first byte
+    uint32_t end_offset;   ///< Offset after the last byte
+    union {
+        long i_value;
+        double f_value;
+        bool b_value;
+        enum mCc_ast_type type;
+    };
+    /// The text of the token, up to the next one
+    char *text;
+};
+
+struct mCc_lexer {
+    struct mCc_source *source;
+    char *cur; ///< Next byte to scan
+    char *end; ///< End of the text
+    char *text; ///< Text of the last token, "" before the first one
+    /// Where the NUL after the text of the last token was written
+    char *held;
+    char held_char; ///< The byte it replaced
+    /// Range of the last token, whitespace or comment, which is also that of
+    /// the end like in flex
+    uint32_t last_start;
+    uint32_t last_end;
+};
+
+/**
+ * @brief Start scanning a source.
+ *
+ * @param lexer The lexer, must be closed with #mCc_lexer_close
+ * @param source The source, which must outlive the lexer
+ */
+void mCc_lexer_init(struct mCc_lexer *lexer, struct mCc_source *source);
+
+/**
+ * @brief Restore the text of the source.
+ */
+void mCc_lexer_close(struct mCc_lexer *lexer);
+
+/**
+ * @brief Scan the next token.
+ *
+ * Invalid characters are reported on stderr and skipped.
+ *
+ * @param lexer The lexer
+ * @param token The token
+ *
+ * @return The kind of the token, 0 at the end
+ */
+int mCc_lexer_next(struct mCc_lexer *lexer, struct mCc_lexer_token *token);
+
+enum mCc_lexer_kind {
+    MCC_LEXER_KIND_FLEX,
+    MCC_LEXER_KIND_HAND,
+};
+
+/**
+ * @brief Scan a whole source, for comparing and measuring the lexers.
+ *
+ * @param source The source
+ * @param kind The lexer to use
+ * @param count Set to the number of tokens, including the one at the end
+ *
+ * @return The tokens, with the text NULL, to be freed by the caller, or NULL
+ *         on memory error
+ */
+struct mCc_lexer_token *mCc_lexer_tokens(struct mCc_source *source,
+                                         enum mCc_lexer_kind kind,
+                                         unsigned int *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_LEXER_H
@@ -15,6 +15,8 @@ enum mCc_parser_status {
 	MCC_PARSER_STATUS_UNABLE_TO_OPEN_STREAM,
 	MCC_PARSER_STATUS_UNKNOWN_ERROR,
 	MCC_PARSER_STATUS_PARSE_ERROR,
+	/// Statements too deep to stream, see #mCc_parser_parse_source_stream
+	MCC_PARSER_STATUS_TOO_DEEP,
 };
 
 struct mCc_parser_result {
@@ -32,10 +34,84 @@ struct mCc_parser_result {
 	struct mCc_ast_source_location err_loc;
 };
 
+/**
+ * The parser of a parse. Both build the same tree, the default is bison
+ * unless mCc was built with `-Dparser=descent`.
+ */
+enum mCc_parser_kind {
+	MCC_PARSER_KIND_DEFAULT, ///< The one selected when building mCc
+	MCC_PARSER_KIND_BISON,   ///< Generated by bison from parser.y
+	MCC_PARSER_KIND_DESCENT, ///< Hand-written, see mCc/parser_descent.h
+};
+
+/// Parse with the default parser
 struct mCc_parser_result mCc_parser_parse_string(const char *input);
 
+/// Like #mCc_parser_parse_string, for input that is not NUL-terminated
+struct mCc_parser_result mCc_parser_parse_buffer(const char *input, size_t len,
+                                                 enum mCc_parser_kind kind);
+
+/// Parse with the default parser
 struct mCc_parser_result mCc_parser_parse_file(FILE *input);
 
+/**
+ * @brief Parse a source, scanning its text in place.
+ *
+ * The source must outlive the tree, which refers to it to resolve the
+ * locations of its nodes. #mCc_parser_parse_string,
+ * #mCc_parser_parse_buffer and #mCc_parser_parse_file copy their input into
+ * a source of the tree instead.
+ */
+struct mCc_parser_result mCc_parser_parse_source(struct mCc_source *source,
+                                                 enum mCc_parser_kind kind);
+
+/// Receives the parts of a program from #mCc_parser_parse_source_stream
+struct mCc_parser_stream {
+	/**
+	 * Called once before the first function with the program of the
+	 * signatures of all functions, which have no bodies. It stays the
+	 * program of the result.
+	 *
+	 * @return 0 to go on, anything else to stop parsing
+	 */
+	int (*signatures)(struct mCc_ast_program *program, void *userdata);
+	/**
+	 * Called with every function definition as soon as it is parsed. The
+	 * function is the root of an arena of its own, which the callback
+	 * deletes with #mCc_ast_delete_func_def when it is done with it.
+	 *
+	 * @return 0 to go on, anything else to stop parsing
+	 */
+	int (*function)(struct mCc_ast_function_def *func, void *userdata);
+	void *userdata;
+};
+
+/**
+ * @brief Parse a program, handing over each function as soon as it is parsed.
+ *
+ * A pre-scan reads the signatures of the functions first, skipping their
+ * bodies, so that the functions can be linked as they come. The functions are
+ * then parsed one after the other by the descent parser (see
+ * mCc/parser_descent.h), each into an arena of its own, so a consumer that
+ * deletes every function when it is done needs memory for the largest one
+ * rather than the whole program.
+ *
+ * If the pre-scan fails, the source is parsed like #mCc_parser_parse_source
+ * without calling back, for the error or a toplevel that is not a program.
+ * Statements nested too deeply for the descent parser stop the parse with
+ * #MCC_PARSER_STATUS_TOO_DEEP, after which the source can still be parsed as
+ * a whole.
+ *
+ * @param source The source, which must outlive the signatures
+ * @param stream The callbacks
+ *
+ * @return The result, with the program of the signatures unless there was an
+ *         error
+ */
+struct mCc_parser_result
+mCc_parser_parse_source_stream(struct mCc_source *source,
+                               const struct mCc_parser_stream *stream);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,88 @@
+/**
+ * @file parser_descent.h
+ * @brief Hand-written parser, an alternative to the bison parser.
+ *
+ * The parser builds the same tree with the same locations as the grammar in
+ * parser.y, reading tokens from the hand-written lexer (mCc/lexer.h).
+ * Statements are parsed by recursive descent. Expressions are parsed by
+ * precedence climbing with a stack of pending operators and operands instead
+ * of recursion, so nesting them deeply does not grow the C stack, and every
+ * node is built once without the chain of reductions bison goes through.
+ *
+ * Statements nested deeper than #MCC_PARSER_DESCENT_MAX_DEPTH are left to the
+ * bison parser, whose automaton keeps its states on a stack of its own.
+ *
+ * Select it with `-Dparser=descent`, `mCc --parser=descent` or
+ * #MCC_PARSER_KIND_DESCENT.
+ *
+ * @author richard
+ * @date 2018-07-14
+ */
+#ifndef MCC_PARSER_DESCENT_H
+#define MCC_PARSER_DESCENT_H
+
+#include "mCc/parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Statements nested deeper than this are parsed by the bison parser
+#define MCC_PARSER_DESCENT_MAX_DEPTH (1024)
+
+struct mCc_source;
+
+/**
+ * @brief Parse a source into the arena and interner in use by the AST.
+ *
+ * Like the bison parser, it sets the expression, statement or program of the
+ * result, or the status and error of the first syntax error.
+ *
+ * @param source The source, scanned in place
+ * @param result The result, with the status #MCC_PARSER_STATUS_OK
+ *
+ * @return 0, or -1 if the statements are nested too deeply, in which case the
+ *         result is unchanged and the nodes built so far are garbage
+ */
+int mCc_parser_descent_parse(struct mCc_source *source,
+                             struct mCc_parser_result *result);
+
+/**
+ * @brief Read the signatures of the functions of a program, skipping their
+ * bodies.
+ *
+ * Every function becomes a function definition without a body, located like
+ * the whole definition. Bodies are only scanned for their matching braces.
+ *
+ * @param source The source, scanned in place
+ * @param result The result, set to the program of the signatures or to the
+ *               first syntax error outside of the bodies
+ *
+ * @return 0, or -1 if the source is not a program with proper signatures
+ */
+int mCc_parser_descent_scan_signatures(struct mCc_source *source,
+                                       struct mCc_parser_result *result);
+
+/**
+ * @brief Parse the functions of a program and hand them over one at a time.
+ *
+ * Each function is built in an arena and interner of its own, see
+ * #mCc_parser_parse_source_stream, and passed to the function callback of
+ * the stream as soon as its `}` was read.
+ *
+ * @param source The source of a program, scanned in place
+ * @param result The result, with the status of the first syntax error
+ * @param stream The callbacks, of which only the function callback is called
+ *
+ * @return 0, or -1 if the statements are nested too deeply, in which case the
+ *         status is #MCC_PARSER_STATUS_TOO_DEEP
+ */
+int mCc_parser_descent_parse_stream(struct mCc_source *source,
+                                    struct mCc_parser_result *result,
+                                    const struct mCc_parser_stream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_PARSER_DESCENT_H
@@ -0,0 +1,116 @@
+/**
+ * @file server.h
+ * @brief Compile server on a Unix domain socket, and its client.
+ *
+ * A server answers compile requests from a pool of threads that stay alive
+ * between requests, each with its own #mCc_context, so a request pays
+ * neither for starting a process nor for setting up the built-ins. A
+ * connection carries any number of requests, each answered before the next
+ * one is read.
+ *
+ * A request is a #mCc_server_request followed by the source name and the
+ * source. A response is a #mCc_server_response followed by the data, then a
+ * #mCc_server_diagnostic, the message and the text for every diagnostic.
+ * Both ends run on the same machine, integers are in host byte order.
+ *
+ * @author richard
+ * @date 2018-06-28
+ */
+#ifndef MCC_SERVER_H
+#define MCC_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mCc/compile.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Limit of a source, a source name and the data of a response
+#define MCC_SERVER_MAX_SIZE (64u << 20)
+
+/// Size of a missing diagnostic text
+#define MCC_SERVER_NO_TEXT UINT32_MAX
+
+struct mCc_server_request {
+    uint32_t opt_level;   ///< See #mCc_compile_options
+    uint32_t output_kind; ///< An #mCc_compile_output_kind
+    uint32_t parser;      ///< An #mCc_parser_kind
+    uint32_t name_size;
+    uint32_t source_size;
+};
+
+struct mCc_server_response {
+    uint32_t status; ///< An #mCc_compile_status
+    uint32_t data_size;
+    uint32_t diagnostic_count;
+};
+
+struct mCc_server_diagnostic {
+    uint32_t status;
+    int32_t start_line;
+    int32_t start_col;
+    int32_t end_line;
+    int32_t end_col;
+    uint32_t message_size;
+    uint32_t text_size; ///< #MCC_SERVER_NO_TEXT if there is no text
+};
+
+/**
+ * @brief Create a listening socket, replacing a stale one at path.
+ *
+ * A socket at path is only removed if no server accepts on it any more.
+ * Fails with EEXIST if path is some other file and with EADDRINUSE if a
+ * server still listens on it.
+ *
+ * @param path The path of the socket
+ *
+ * @return The socket, or -1 with errno set
+ */
+int mCc_server_listen(const char *path);
+
+/**
+ * @brief Serve compile requests until the socket is shut down.
+ *
+ * The calling thread is one of the workers. Returns once every worker saw
+ * accept fail, e.g. after shutdown(2) on the socket. The workers share a
+ * #mCc_func_cache, so a program sent again after an edit only has its changed
+ * functions generated.
+ *
+ * @param fd The listening socket, see #mCc_server_listen
+ * @param threads The number of workers, at least 1
+ *
+ * @return 0, or -1 if no worker could get a context
+ */
+int mCc_server_run(int fd, unsigned int threads);
+
+/**
+ * @brief Connect to a server.
+ *
+ * @param path The path of the server's socket
+ *
+ * @return The connection, or -1 with errno set
+ */
+int mCc_client_connect(const char *path);
+
+/**
+ * @brief Compile a source buffer on a server.
+ *
+ * Behaves like #mCc_compile_string. If the server cannot be reached, the
+ * status is #MCC_COMPILE_STATUS_SERVER_ERROR and the connection should be
+ * closed.
+ *
+ * @param fd The connection, see #mCc_client_connect
+ */
+enum mCc_compile_status
+mCc_client_compile(int fd, const char *src, size_t len,
+                   const struct mCc_compile_options *options,
+                   struct mCc_output *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_SERVER_H
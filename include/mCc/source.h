@@ -0,0 +1,113 @@
+/**
+ * @file source.h
+ * @brief The text of a program and the lines and columns in it.
+ *
+ * A source holds the whole input in memory, mapped from its file where
+ * possible, and terminated by the two NUL bytes that flex expects at the end
+ * of a buffer it scans in place. The scanner only counts bytes: tokens and
+ * AST nodes record byte offsets, and lines and columns are looked up in a
+ * table of line starts when a diagnostic or printer needs them. The table is
+ * built on the first lookup.
+ *
+ * @author richard
+ * @date 2018-07-10
+ */
+#ifndef MCC_SOURCE_H
+#define MCC_SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "mCc/ast.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mCc_arena;
+
+struct mCc_source {
+    /// The text, followed by two NUL bytes. The scanner writes into it while
+    /// scanning and restores it afterwards.
+    char *data;
+    size_t size;            ///< Length of the text without the NULs
+    size_t mapped_size;     ///< Length of the mapping of data, 0 if read
+    struct mCc_arena *arena; ///< Holds data and lines, malloc'd if NULL
+    uint32_t *line_starts;  ///< Offset of every line, NULL until looked up
+    uint32_t line_count;
+};
+
+/**
+ * @brief Open a file, or stdin for "-".
+ *
+ * Regular files are mapped privately, others are read once.
+ *
+ * @param source The source to initialise
+ * @param path The file
+ *
+ * @return 0 on success, -1 on error with errno set
+ */
+int mCc_source_open(struct mCc_source *source, const char *path);
+
+/**
+ * @brief Read a whole stream.
+ *
+ * @param source The source to initialise
+ * @param in The stream
+ * @param arena The arena to read into, which must outlive the source, or
+ *              NULL for memory freed by #mCc_source_close
+ *
+ * @return 0 on success, -1 on error with errno set
+ */
+int mCc_source_read(struct mCc_source *source, FILE *in,
+                    struct mCc_arena *arena);
+
+/**
+ * @brief Copy a buffer.
+ *
+ * @param source The source to initialise
+ * @param data The text, which need not be NUL-terminated
+ * @param size The length of the text
+ * @param arena Like for #mCc_source_read
+ *
+ * @return 0 on success, -1 on memory error
+ */
+int mCc_source_init(struct mCc_source *source, const char *data, size_t size,
+                    struct mCc_arena *arena);
+
+/**
+ * @brief Unmap or free the text and the lines, unless they are in an arena.
+ */
+void mCc_source_close(struct mCc_source *source);
+
+/**
+ * @brief The lines and columns of a range of bytes.
+ *
+ * Lines and columns start at 1, the end column is that of the last byte. A
+ * range ending after a newline ends in column 0 of the next line.
+ *
+ * @param source The source
+ * @param start The offset of the first byte
+ * @param end The offset after the last byte
+ *
+ * @return The location with the offsets, without lines and columns on memory
+ *         error
+ */
+struct mCc_ast_source_location mCc_source_locate(struct mCc_source *source,
+                                                 uint32_t start, uint32_t end);
+
+/**
+ * @brief Fill in the lines and columns of a location recorded by the parser.
+ *
+ * Locations without a range, of nodes not created by the parser, and a NULL
+ * source are left alone.
+ */
+void mCc_source_resolve(struct mCc_source *source,
+                        struct mCc_ast_source_location *loc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_SOURCE_H
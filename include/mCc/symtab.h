@@ -7,15 +7,17 @@
 #ifndef MCC_ST_H
 #define MCC_ST_H
 
+#include "arena.h"
 #include "ast.h"
 
-#include "lib/uthash.h"
 #include "tac.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct mCc_context;
+
 enum mCc_symtab_entry_type {
 	MCC_SYMTAB_ENTRY_TYPE_VAR,
 	MCC_SYMTAB_ENTRY_TYPE_ARR,
@@ -25,7 +27,10 @@ enum mCc_symtab_entry_type {
 struct mCc_symtab_entry {
 	/// Scope/Symbol Table containing this entry
 	struct mCc_symtab_scope *scope;
-	UT_hash_handle hh; ///< Internal data for hash table
+	/// The entry of the same name in an enclosing scope, hidden by this one
+	struct mCc_symtab_entry *shadowed;
+	/// The next entry of the same scope, in order of declaration
+	struct mCc_symtab_entry *next_in_scope;
 
 	/// The kind of entry (var, arr, ...)
 	enum mCc_symtab_entry_type entry_type;
@@ -34,38 +39,94 @@ struct mCc_symtab_entry {
 	struct mCc_ast_source_location sloc;
 	/// The identifier of the entry
 	struct mCc_ast_identifier *identifier;
+	/// The name in the interner of the scopes, the key of the bindings
+	mCc_atom atom;
 
 	/// The primitive type (int, bool, ...)
 	enum mCc_ast_type primitive_type;
 
-	/// The temporary variable(number) for TAC creation
-	struct mCc_tac_quad_entry tac_tmp;
+	/// Index among the variables of the function, see
+	/// #mCc_ast_identifier.slot
+	unsigned int slot;
+
+	/// Whether this is a built-in function implemented in C (cdecl)
+	bool built_in;
 
 	union {
 		/// If entry_type is #MCC_SYMTAB_ENTRY_TYPE_ARR
 		unsigned int arr_size;
 
 		/// If entry_type is #MCC_SYMTAB_ENTRY_TYPE_FUNC
-		struct mCc_ast_parameters *params;
+		struct {
+			struct mCc_ast_parameters *params;
+			/// The definition, only a signature in a streamed parse
+			const struct mCc_ast_function_def *func_def;
+		};
 	};
 };
 
-/* scope == table for our purposes, since a new table is opened for every scope.
- * data structure: embedded hash table using uthash,
- * the entries of which are #mCc_symtab_entry.
+/* The scopes of a context share one table, which maps every name to the
+ * innermost entry for it in the open scopes. That entry points to the one it
+ * shadows, so every name has a stack of entries.
+ *
+ * Scopes are opened and left like a stack. Every entry added is recorded in
+ * an undo log, and leaving a scope pops the entries it added, so the hidden
+ * ones are visible again. The scopes and their entries are kept until the
+ * scopes are deleted, for printing and because the AST links to the entries.
  */
 struct mCc_symtab_scope {
 	/// Parent scope, needed for lookup
 	struct mCc_symtab_scope *parent;
+	/// The context owning the scope, which frees it
+	struct mCc_context *ctx;
 	char *name; ///< Human-readable name for debugging
+	unsigned int depth; ///< Number of enclosing scopes
+
+	/// Length of the undo log when the scope was opened
+	unsigned int log_start;
+	bool open; ///< Whether its entries are bound, until it is left
+
+	/// The entries, in order of declaration
+	struct mCc_symtab_entry *first_entry;
+	struct mCc_symtab_entry *last_entry;
+};
 
-	/** Contains the entries.
-	 *
-	 * MUST BE INITIALIZED TO NULL.
-	 *
-	 * Not actually an array!
-	 * Instead, it is used by uthash to store the hash table.  */
-	struct mCc_symtab_entry *hash_table;
+/// Number of built-in functions, entered into every root scope
+#define MCC_SYMTAB_BUILT_IN_COUNT (6)
+
+/// All scopes of a #mCc_context, for printing and freeing
+struct mCc_symtab_state {
+	struct mCc_symtab_scope **scopes;
+	unsigned int scope_count;
+	/// Number of entries for which memory was allocated
+	unsigned int scope_alloc_size;
+	/// Holds the scopes, their names and entries
+	struct mCc_arena *arena;
+	struct mCc_symtab_scope *current; ///< Innermost open scope, or NULL
+
+	/// The innermost entry for each atom, NULL if it is not declared. Atoms
+	/// are numbered densely, so they index the table directly.
+	struct mCc_symtab_entry **bindings;
+	unsigned int binding_count; ///< Atoms the table has room for
+
+	/// Undo log: the entries of the open scopes, in order of declaration
+	struct mCc_symtab_entry **log;
+	unsigned int log_count;
+	unsigned int log_alloc_size;
+	/// Slots handed out in the current function, reset by each scope opened
+	/// in a root scope
+	unsigned int slot_count;
+	/// The scopes of the functions start here, 0 before the first one
+	unsigned int function_scope_start;
+	/// Where the arena was before the first scope of a function
+	struct mCc_arena_mark function_mark;
+
+	/// The names of the entries, see #mCc_symtab_set_interner
+	struct mCc_interner *interner;
+	/// Interner of the context, used without one of the program
+	struct mCc_interner *own_interner;
+	/// The text of the program, see #mCc_symtab_set_source
+	struct mCc_source *source;
 };
 
 /************************************************ Functions */
@@ -99,13 +160,63 @@ struct mCc_symtab_scope {
  * the params) and another for each body.
  * */
 
+/**
+ * @brief Key the scopes of a context on the atoms of an interner.
+ *
+ * Identifiers with an atom of this interner are then looked up without
+ * looking at their name. Without an interner, or after the scopes were
+ * deleted, the context interns the names itself.
+ *
+ * @param ctx The context
+ * @param interner The interner of the program, which must outlive the scopes,
+ *                 or NULL
+ */
+void mCc_symtab_set_interner(struct mCc_context *ctx,
+                             struct mCc_interner *interner);
+
+/**
+ * @brief Give the text the declarations were parsed from.
+ *
+ * The entries keep the byte offsets of their declarations, the printer looks
+ * up their lines and columns in it.
+ *
+ * @param ctx The context
+ * @param source The source of the program, which must outlive the scopes, or
+ *               NULL
+ */
+void mCc_symtab_set_source(struct mCc_context *ctx, struct mCc_source *source);
+
+/**
+ * @brief The definition of a built-in function.
+ *
+ * @param name The name of the function
+ *
+ * @return The constant definition, or NULL if no built-in has that name
+ */
+const struct mCc_ast_function_def *mCc_symtab_built_in(const char *name);
+
+/**
+ * @brief Open a new top-level scope, containing the built-in functions.
+ *
+ * Scopes of the context that are still open are left first.
+ *
+ * @param ctx The context which owns the scope and frees it in
+ * #mCc_symtab_delete_all_scopes
+ * @param name The human-readable name of the new scope, copied
+ *
+ * @return A pointer to the new scope, or NULL on failure.
+ */
+struct mCc_symtab_scope *mCc_symtab_new_root_scope(struct mCc_context *ctx,
+                                                   const char *name);
+
 /**
  * @brief Open a new scope inside an existing one.
  *
  * If childscope_name is dynamic, the caller must free it after this function
- * returns because it is copied.
+ * returns because it is copied. The new scope belongs to the context of self.
+ * Scopes still open inside self are left first.
  *
- * @param self The scope to add to
+ * @param self The open scope to add to
  * @param childscope_name The human-readable name of the new scope
  *
  * @return A pointer to the new scope, or NULL on failure.
@@ -113,13 +224,25 @@ struct mCc_symtab_scope {
 struct mCc_symtab_scope *mCc_symtab_new_scope_in(struct mCc_symtab_scope *self,
                                                  const char *childscope_name);
 
+/**
+ * @brief Leave a scope, hiding its entries from lookups again.
+ *
+ * Scopes still open inside it are left as well. The entries stay linked to
+ * the AST and are freed with the scopes.
+ *
+ * @param self The open scope to leave
+ *
+ * @return The parent scope
+ */
+struct mCc_symtab_scope *mCc_symtab_scope_leave(struct mCc_symtab_scope *self);
+
 /**
  * @brief Record a declaration in a new entry in the given scope.
  *
  * An error is returned if the ID was already declared in this scope.
- * To do that, first check whether the hash table contains the ID.
+ * Scopes still open inside self are left first.
  *
- * @param self The scope to record the declaration in
+ * @param self The open scope to record the declaration in
  * @param decl The declaration to record
  *
  * @return 0 on success, 1 if the ID was already declared in this scope, -1 on
@@ -132,9 +255,9 @@ int mCc_symtab_scope_add_decl(struct mCc_symtab_scope *self,
  * @brief Record a function definition in a new entry in the given scope.
  *
  * An error is returned if the ID was already declared in this scope.
- * To do that, first check whether the hash table contains the ID.
+ * Scopes still open inside self are left first.
  *
- * @param self The scope to record the declaration in
+ * @param self The open scope to record the declaration in
  * @param func_def The function definition to record
  *
  * @return 0 on success, 1 if the ID was already declared in this scope, -1 on
@@ -162,10 +285,13 @@ enum MCC_SYMTAB_SCOPE_LINK_ERROR {
 /**
  * @brief Recursively lookup an ID, starting from the given scope.
  *
- * Internally, this will perform a hash table lookup in each scope until a scope
- * without parent is reached.
+ * The innermost entry of the open scopes is found in the table of the
+ * context, indexed by the atom of the name, which is only looked up in the
+ * interner if the identifier does not carry an atom of the interner of the
+ * scopes. If scope is not the innermost open one, entries of the scopes
+ * inside it are skipped.
  *
- * @param scope The scope to start lookup in
+ * @param scope The open scope to start lookup in
  * @param id The ID to look for
  *
  * @return A pointer to the entry, or NULL if the ID is undeclared.
@@ -205,16 +331,36 @@ mCc_symtab_scope_link_ref_assignment(struct mCc_symtab_scope *self,
                                      struct mCc_ast_statement *stmt);
 
 /**
- * @brief Free all scopes, their hash tables and entries.
+ * @brief Free all scopes of a context, their hash tables and entries.
  *
  * This is needed because the program usually only holds pointers to entries and
  * the top-level symbol table, which doesn't hold pointers to it's children.
  *
  * This should reset properly so that new scopes can be created afterwards.
  */
-void mCc_symtab_delete_all_scopes(void);
+void mCc_symtab_delete_all_scopes(struct mCc_context *ctx);
+
+/**
+ * @brief Free all scopes of a context like #mCc_symtab_delete_all_scopes.
+ *
+ * The built-in functions are constant and shared by all contexts, so there is
+ * nothing left to keep for the next root scope; this only remains for the
+ * callers that reuse a context.
+ */
+void mCc_symtab_delete_scopes(struct mCc_context *ctx);
+
+/**
+ * @brief Free the scopes opened inside the root scope, keeping the root.
+ *
+ * After a function was compiled, the scopes and entries of its parameters and
+ * body are no longer needed. Freeing them before linking the next function
+ * keeps the scopes of one function at a time.
+ *
+ * @param ctx The context
+ */
+void mCc_symtab_delete_function_scopes(struct mCc_context *ctx);
 
-void mCc_symtab_print_all_scopes(FILE *out);
+void mCc_symtab_print_all_scopes(struct mCc_context *ctx, FILE *out);
 
 #ifdef __cplusplus
 }
@@ -16,6 +16,11 @@ extern "C" {
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "intern.h"
+#include "writer.h"
+
+struct mCc_context;
+
 /******************************** Data Structures */
 
 /// Size by which to increase quad_size when reallocing
@@ -68,8 +73,21 @@ enum mCc_tac_quad_type {
     MCC_TAC_QUAD_STORE,
     MCC_TAC_QUAD_RETURN,
     MCC_TAC_QUAD_RETURN_VOID,
+    MCC_TAC_QUAD_SELECT,
+    MCC_TAC_QUAD_JUMPTRUE,
+    MCC_TAC_QUAD_VECTOR_ZERO,   ///< v[dst] = 0
+    MCC_TAC_QUAD_VECTOR_SPLAT,  ///< v[dst] = arg1 in every lane
+    MCC_TAC_QUAD_VECTOR_LOAD,   ///< v[dst] = arg1[arg2 .. arg2 + 3]
+    MCC_TAC_QUAD_VECTOR_OP,     ///< v[dst] = v[src1] op v[src2]
+    MCC_TAC_QUAD_VECTOR_STORE,  ///< result[arg2 .. arg2 + 3] = v[src1]
+    MCC_TAC_QUAD_VECTOR_REDUCE, ///< result = result + sum of v[src1] (ints)
 };
 
+/// Number of array elements a vector register holds
+#define MCC_TAC_VECTOR_LANES (4)
+/// Number of vector registers, v0 to v7
+#define MCC_TAC_VECTOR_REGS (8)
+
 enum mCc_tac_quad_literal_type {
     MCC_TAC_QUAD_LIT_INT,
     MCC_TAC_QUAD_LIT_FLOAT,
@@ -91,21 +109,22 @@ struct mCc_tac_quad_literal {
     int label_num; ///< Optional, for strings
 };
 
-#define MCC_TAC_LABEL_LEN (4096)
 /// Label with two alternative options
 struct mCc_tac_label {
-    char str[MCC_TAC_LABEL_LEN]; /// For function labels
-    int num;                     /// For anonymous labels
+    /// For function labels: the name, which belongs to the AST
+    const char *str;
+    /// For function labels: the interned name, or MCC_ATOM_NONE
+    mCc_atom name;
+    int num; /// For anonymous labels
     enum mCc_tac_quad_literal_type
             type; /// (Optional)For correct stack allocation later
 };
 
 /// this struct is the used as the type of the quad entries
-#define MCC_TAC_STRING_LEN (4096)
 struct mCc_tac_quad_entry {
     int number;     /// Temporary. -1 will be used as array pointer to params
     int str_number; /// (Optional) For strings
-    char str_value[MCC_TAC_STRING_LEN]; /// (Optional)For Strings
+    const char *str_value; /// (Optional)For Strings, belongs to the AST
     enum mCc_tac_quad_literal_type
             type;       /// (Optional)For correct stack allocation later
     int array_size; /// (Optional)For correct Stack allocation
@@ -113,7 +132,36 @@ struct mCc_tac_quad_entry {
 
 struct mCc_cfg_block {
     int number;
-    char *label_name;
+    const char *label_name;
+};
+
+/// Vector registers of a vector quad, see #MCC_TAC_QUAD_VECTOR_ZERO
+struct mCc_tac_vector {
+    enum mCc_tac_quad_binary_op op; ///< Only for vector ops
+    int dst;
+    int src1;
+    int src2;
+};
+
+/// Calling convention of a function definition or a call site
+enum mCc_tac_call_conv {
+    MCC_TAC_CALL_CONV_CDECL,   ///< All arguments on the stack (main, built-ins)
+    MCC_TAC_CALL_CONV_INTERNAL ///< First arguments in registers (mC-only)
+};
+
+/// Counters for new temporaries, strings and labels of a function, which are
+/// numbered from 0 in every function
+struct mCc_tac_numbering {
+    int next_var;
+    int next_string;
+    int next_label;
+};
+
+/// Incoming parameter of a function, bound to a temporary in the prologue
+struct mCc_tac_param {
+    int number; ///< The temporary that holds the parameter
+    enum mCc_tac_quad_literal_type type;
+    bool is_array; ///< The temporary holds a pointer to the array
 };
 
 /**
@@ -126,6 +174,8 @@ struct mCc_tac_quad {
         struct mCc_tac_quad_literal *literal; ///< Only for literals
         enum mCc_tac_quad_binary_op bin_op;
         enum mCc_tac_quad_unary_op un_op;
+        int select_cond; ///< Only for selects: temporary with the condition
+        struct mCc_tac_vector vector; ///< Only for vector quads
     };
     struct mCc_tac_quad_entry arg1;
     struct mCc_tac_quad_entry arg2;
@@ -135,8 +185,21 @@ struct mCc_tac_quad {
         struct mCc_tac_label label;
         struct mCc_tac_quad_entry ref;
     } result;
-    /// variable or argument count for assembly
+    /// variable or argument count for assembly, argument index for params
     unsigned int var_count;
+    /// For function labels, params and calls
+    enum mCc_tac_call_conv call_conv;
+    /// Only for function labels: the incoming parameters
+    struct mCc_tac_param *params;
+    unsigned int param_count;
+    /// Only for labels: target of a loop back edge, aligned in the assembly
+    bool loop_header;
+    /// Only for labels: header of a loop left with less than one vector or
+    /// unroll factor of iterations, not worth unrolling
+    bool remainder_loop;
+    /// Only for function labels: the numbering continues here when passes
+    /// add temporaries or labels to the function
+    struct mCc_tac_numbering numbering;
     /// To which node this quad counts
     struct mCc_cfg_block cfg_node;
 };
@@ -166,15 +229,27 @@ struct mCc_tac_program {
     unsigned int cfg_alloc_size;
     /// The number of cfg blocks in this program
     unsigned int cfg_count;
+
+    /// The context the program was built in, numbers new temporaries and
+    /// labels of the optimiser
+    struct mCc_context *ctx;
 };
 
 /********************************** Quad Functions */
 
-struct mCc_tac_quad_entry mCc_tac_create_new_entry();
+struct mCc_tac_quad_entry mCc_tac_create_new_entry(struct mCc_context *ctx);
+
+struct mCc_tac_quad_entry mCc_tac_create_new_string(struct mCc_context *ctx);
 
-struct mCc_tac_quad_entry mCc_tac_create_new_string();
+struct mCc_tac_label mCc_tac_get_new_label(struct mCc_context *ctx);
 
-struct mCc_tac_label mCc_tac_get_new_label();
+/**
+ * @brief Restart the numbering of temporaries, strings and labels at 0.
+ *
+ * Called by #mCc_tac_build for every function, so that a function is
+ * numbered the same way no matter what was built before it.
+ */
+void mCc_tac_reset_numbering(struct mCc_context *ctx);
 
 struct mCc_tac_quad *mCc_tac_quad_new_assign(struct mCc_tac_quad_entry arg1,
                                              struct mCc_tac_quad_entry result);
@@ -204,6 +279,13 @@ struct mCc_tac_quad *
 mCc_tac_quad_new_jumpfalse(struct mCc_tac_quad_entry condition,
                            struct mCc_tac_label label);
 
+/**
+ * New quadruple in the style MCC_TAC_QUAD_JUMPTRUE condition Label -
+ */
+struct mCc_tac_quad *
+mCc_tac_quad_new_jumptrue(struct mCc_tac_quad_entry condition,
+                          struct mCc_tac_label label);
+
 struct mCc_tac_quad *mCc_tac_quad_new_label(struct mCc_tac_label label);
 
 /**
@@ -240,6 +322,44 @@ struct mCc_tac_quad *mCc_tac_quad_new_store(struct mCc_tac_quad_entry index,
                                             struct mCc_tac_quad_entry value,
                                             struct mCc_tac_quad_entry array);
 
+/**
+ * Branch-free conditional move, created by if-conversion
+ * @return a quadruple in the style MCC_TAC_QUAD_SELECT if_true if_false result
+ * with the condition in select_cond
+ */
+struct mCc_tac_quad *mCc_tac_quad_new_select(struct mCc_tac_quad_entry cond,
+                                             struct mCc_tac_quad_entry if_true,
+                                             struct mCc_tac_quad_entry if_false,
+                                             struct mCc_tac_quad_entry result);
+
+/**
+ * Vector quad created by the loop vectorizer, the entries which are not used
+ * by the type are ignored
+ * @return a quadruple of one of the MCC_TAC_QUAD_VECTOR_* types
+ */
+struct mCc_tac_quad *mCc_tac_quad_new_vector(enum mCc_tac_quad_type type,
+                                             struct mCc_tac_vector vector,
+                                             struct mCc_tac_quad_entry arg1,
+                                             struct mCc_tac_quad_entry arg2,
+                                             struct mCc_tac_quad_entry result);
+
+/**
+ * @brief Deep-copy a quad.
+ *
+ * Literals and function parameters are copied as well, the comment and string
+ * values are shared.
+ *
+ * @param self The quad to copy
+ *
+ * @return The copy, or NULL on memory error
+ */
+struct mCc_tac_quad *mCc_tac_quad_copy(const struct mCc_tac_quad *self);
+
+/**
+ * @brief The symbol of a binary operation as printed in the TAC, e.g. "<=".
+ */
+const char *mCc_tac_binary_op_symbol(enum mCc_tac_quad_binary_op op);
+
 /**
  * @brief Print a quad.
  * @param self
@@ -300,7 +420,9 @@ int mCc_tac_program_add_quad(struct mCc_tac_program *self,
  * @return 0 on success, non-zero on memory error
  */
 int mCc_tac_program_add_cfg(struct mCc_tac_program *self,
-                            char *from_label, int from_number, char *to_label, int to_number, char *label);
+                            const char *from_label, int from_number,
+                            const char *to_label, int to_number,
+                            const char *label);
 
 /**
  * @brief Print a program by serially printing it's quads.
@@ -310,6 +432,12 @@ int mCc_tac_program_add_cfg(struct mCc_tac_program *self,
  */
 void mCc_tac_program_print(struct mCc_tac_program *self, FILE *out);
 
+/**
+ * @brief Like #mCc_tac_program_print, but into a writer which is not flushed.
+ */
+void mCc_tac_program_write(struct mCc_tac_program *self,
+                           struct mCc_writer *out);
+
 /**
  * @brief Delete a program.
  *
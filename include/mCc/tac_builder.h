@@ -14,16 +14,72 @@ extern "C" {
 #include "ast.h"
 #include "tac.h"
 
+struct mCc_context;
+
+/// A variable, array or parameter of the function being built
+struct mCc_tac_builder_slot {
+    struct mCc_tac_quad_entry tmp; ///< The temporary holding it
+    unsigned int arr_size;         ///< Its declared size, if it is an array
+};
+
+/// State of the builder while converting a program, see #mCc_context
+struct mCc_tac_builder_state {
+    /// The strings of the program being built, handed over to it when done
+    struct mCc_tac_quad_entry *strings;
+    /// Number of entries in strings
+    unsigned int string_count;
+    /// Number of entries for which memory was allocated
+    unsigned int string_alloc_size;
+    /// Count of variables of the current function, for the assembly
+    unsigned int var_count;
+    /// The variables of the current function, indexed by the slots of
+    /// their identifiers
+    struct mCc_tac_builder_slot *slots;
+    /// Number of entries for which memory was allocated
+    unsigned int slot_alloc_size;
+    /// The current block of the control flow graph
+    struct mCc_cfg_block tmp_block;
+    unsigned int anonym_block_count;
+    /// Whether the else branch of the first if-else ended in a return
+    int return_in_else;
+    /// Labels of the previous functions, keeps the blocks of the control
+    /// flow graph apart
+    int label_base;
+};
+
 /**
  * @brief Build a TAC program from an AST.
  *
+ * @param ctx The context, numbers the temporaries and labels of every
+ *            function from 0
  * @param prog The program to convert
  *
  * @return A TAC program, or NULL on error
  */
-struct mCc_tac_program *mCc_tac_build(struct mCc_ast_program *prog);
+struct mCc_tac_program *mCc_tac_build(struct mCc_context *ctx,
+                                      struct mCc_ast_program *prog);
+
+/**
+ * @brief Build a TAC program of a single function, numbered the same way as
+ * in the program built by #mCc_tac_build.
+ *
+ * @param ctx The context
+ * @param fun_def The function, must be linked and type checked
+ *
+ * @return A TAC program, or NULL on error
+ */
+struct mCc_tac_program *
+mCc_tac_build_function(struct mCc_context *ctx,
+                       struct mCc_ast_function_def *fun_def);
 
-void mCc_tac_free_global_string_array();
+/**
+ * @brief Free the strings collected by a build that did not finish, and the
+ * slots of the builder.
+ *
+ * A successful build hands its strings to the program, which frees them in
+ * #mCc_tac_program_delete. Calling this afterwards is harmless.
+ */
+void mCc_tac_free_global_string_array(struct mCc_context *ctx);
 #ifdef __cplusplus
 }
 #endif
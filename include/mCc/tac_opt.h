@@ -0,0 +1,139 @@
+/**
+ * @file tac_opt.h
+ * @brief Declarations for the optimisation passes on the three-address code.
+ * @author bennett
+ * @date 2018-06-12
+ */
+#ifndef MCC_TAC_OPT_H
+#define MCC_TAC_OPT_H
+
+#include "tac.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Knobs of the optimisation passes
+struct mCc_tac_opt_options {
+    /// Optimisation level as given by -O, 0 disables all passes
+    unsigned int level;
+    /// Maximum number of quads if-conversion executes on both paths
+    unsigned int if_convert_max_speculated;
+    /// Maximum number of condition quads loop rotation duplicates
+    unsigned int loop_rotate_max_cond;
+    /// Number of body copies in a partially unrolled loop, 1 disables it
+    unsigned int unroll_factor;
+    /// Maximum trip count of a loop to unroll completely
+    unsigned int unroll_full_max_trip;
+    /// Maximum number of quads an unrolled loop body may have
+    unsigned int unroll_max_size;
+};
+
+/**
+ * @brief Get the default options for an optimisation level.
+ *
+ * @param level The optimisation level
+ *
+ * @return The options
+ */
+struct mCc_tac_opt_options mCc_tac_opt_default_options(unsigned int level);
+
+/**
+ * @brief Run all passes enabled by the options on a program.
+ *
+ * @param prog The program to optimise in place
+ * @param options The options, see #mCc_tac_opt_default_options
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+int mCc_tac_optimize(struct mCc_tac_program *prog,
+                     const struct mCc_tac_opt_options *options);
+
+/**
+ * @brief Replace small side-effect-free ifs by branch-free selects.
+ *
+ * Recognises triangles (if without else) and diamonds (if-else) whose
+ * branches only contain quads that are safe to execute speculatively, and
+ * rewrites them into straight-line code followed by one
+ * #MCC_TAC_QUAD_SELECT per variable assigned in a branch.
+ *
+ * @param prog The program to optimise in place
+ * @param max_speculated Maximum number of quads in both branches together
+ *
+ * @return The number of converted ifs, or -1 on memory error
+ */
+int mCc_tac_opt_if_convert(struct mCc_tac_program *prog,
+                           unsigned int max_speculated);
+
+/**
+ * @brief Vectorize element-wise array loops with SSE2.
+ *
+ * Counted loops with a step of one whose straight-line body only loads and
+ * stores array elements at the induction variable plus a constant, combines
+ * them with operations that have a packed instruction (int addition and
+ * subtraction, float arithmetic) or sums them up into an int variable are
+ * preceded by a copy working on #MCC_TAC_VECTOR_LANES elements at once. The
+ * original loop handles the remaining iterations. Stores and other accesses
+ * to the same array, or to any array parameter, must use the same index.
+ *
+ * @param prog The program to optimise in place
+ *
+ * @return The number of vectorized loops, or -1 on memory error
+ */
+int mCc_tac_opt_vectorize_loops(struct mCc_tac_program *prog);
+
+/**
+ * @brief Unroll counted loops.
+ *
+ * Recognises innermost while loops which compare an induction variable,
+ * updated by a constant step once per iteration, to a loop-invariant bound.
+ * Loops with a known trip count of at most
+ * #mCc_tac_opt_options.unroll_full_max_trip are replaced by copies of their
+ * body. Other loops with a monotonic condition get an unrolled copy with
+ * #mCc_tac_opt_options.unroll_factor bodies in front, which is left as soon as
+ * fewer iterations remain. The original loop handles the remainder. Loops
+ * whose unrolled body would exceed #mCc_tac_opt_options.unroll_max_size quads
+ * are left alone, as are remainder loops of vectorized or unrolled loops.
+ *
+ * @param prog The program to optimise in place
+ * @param options The options
+ *
+ * @return The number of unrolled loops, or -1 on memory error
+ */
+int mCc_tac_opt_unroll_loops(struct mCc_tac_program *prog,
+                             const struct mCc_tac_opt_options *options);
+
+/**
+ * @brief Rotate while loops into bottom-tested form.
+ *
+ * The condition is duplicated: once as guard before the loop and once at the
+ * bottom of the body, where a #MCC_TAC_QUAD_JUMPTRUE repeats the loop. The
+ * first quad of the body becomes an aligned loop header.
+ *
+ * @param prog The program to optimise in place
+ * @param max_cond Maximum number of quads in a condition to duplicate
+ *
+ * @return The number of rotated loops, or -1 on memory error
+ */
+int mCc_tac_opt_rotate_loops(struct mCc_tac_program *prog,
+                             unsigned int max_cond);
+
+/**
+ * @brief Static block placement without a profile.
+ *
+ * Ifs whose branch ends in a return are inverted and the returning path is
+ * moved behind the function, so that the hot path falls through and loop
+ * bodies stay contiguous. Afterwards, all targets of back edges are marked as
+ * loop headers.
+ *
+ * @param prog The program to optimise in place
+ *
+ * @return The number of moved blocks, or -1 on memory error
+ */
+int mCc_tac_opt_layout_blocks(struct mCc_tac_program *prog);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_TAC_OPT_H
@@ -34,26 +34,67 @@ struct mCc_typecheck_result {
 	struct mCc_ast_source_location err_loc;
 };
 
+struct mCc_context;
+
+/**
+ * @brief The state of the type checker, kept in a #mCc_context.
+ */
+struct mCc_typecheck_state {
+	struct mCc_typecheck_result result;     ///< The result so far
+	struct mCc_ast_function_def *curr_func; ///< The function being checked
+};
+
 /**
  * @brief Typecheck the given program.
+ * @param ctx The context of the compilation
  * @param program The program to typecheck
  * @param scope The scope for main function
  *
  * @return an #mCc_typecheck_result containing status, error and location.
  */
-struct mCc_typecheck_result mCc_typecheck(struct mCc_ast_program *program,
+struct mCc_typecheck_result mCc_typecheck(struct mCc_context *ctx,
+                                          struct mCc_ast_program *program,
                                           struct mCc_symtab_scope *scope);
+
+/**
+ * @brief Check that the root scope has a proper main function.
+ *
+ * The first part of #mCc_typecheck, for checking one function at a time
+ * with #mCc_typecheck_function afterwards.
+ *
+ * @param ctx The context
+ * @param scope The root scope
+ * @param source The source to resolve the error location in, or NULL
+ */
+struct mCc_typecheck_result mCc_typecheck_main(struct mCc_context *ctx,
+                                               struct mCc_symtab_scope *scope,
+                                               struct mCc_source *source);
+
+/**
+ * @brief Check a single linked function, like #mCc_typecheck does for each.
+ *
+ * @param ctx The context
+ * @param func The function
+ * @param source The source to resolve the error location in, or NULL
+ */
+struct mCc_typecheck_result
+mCc_typecheck_function(struct mCc_context *ctx,
+                       struct mCc_ast_function_def *func,
+                       struct mCc_source *source);
 /**
  * Dummy func for testing
  */
 struct mCc_typecheck_result
-mCc_typecheck_test_type_check(struct mCc_ast_expression *expression);
+mCc_typecheck_test_type_check(struct mCc_context *ctx,
+                              struct mCc_ast_expression *expression);
 
 struct mCc_typecheck_result
-mCc_typecheck_test_type_check_stmt(struct mCc_ast_statement *stmt);
+mCc_typecheck_test_type_check_stmt(struct mCc_context *ctx,
+                                   struct mCc_ast_statement *stmt);
 
 struct mCc_typecheck_result
-mCc_typecheck_test_type_check_program(struct mCc_ast_program *prog);
+mCc_typecheck_test_type_check_program(struct mCc_context *ctx,
+                                      struct mCc_ast_program *prog);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,123 @@
+/**
+ * @file writer.h
+ * @brief Buffered output shared by the code generator and the printers.
+ *
+ * A writer collects output in a fixed buffer inside the struct and hands it
+ * to its sink in large blocks, so emitting text neither parses format strings
+ * nor locks stdio per call. Sinks are a FILE, a file descriptor or a growing
+ * block of memory.
+ *
+ * @author richard
+ * @date 2018-06-24
+ */
+#ifndef MCC_WRITER_H
+#define MCC_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCC_WRITER_BUFFER_SIZE (16 * 1024)
+
+enum mCc_writer_sink {
+    MCC_WRITER_SINK_FILE,
+    MCC_WRITER_SINK_FD,
+    MCC_WRITER_SINK_MEMORY
+};
+
+struct mCc_writer {
+    enum mCc_writer_sink sink;
+    FILE *file;
+    int fd;
+    char *memory;           ///< Memory sink: the output flushed so far
+    size_t memory_size;
+    size_t memory_capacity;
+    bool error;             ///< A flush failed, further output is dropped
+    size_t len;             ///< Bytes used in buf
+    char buf[MCC_WRITER_BUFFER_SIZE];
+};
+
+/**
+ * @brief Initialise a writer on a FILE, which is not flushed or closed.
+ */
+void mCc_writer_init_file(struct mCc_writer *w, FILE *file);
+
+/**
+ * @brief Initialise a writer on a file descriptor, which is not closed.
+ */
+void mCc_writer_init_fd(struct mCc_writer *w, int fd);
+
+/**
+ * @brief Initialise a writer collecting the output in memory.
+ *
+ * The memory is obtained with #mCc_writer_take_memory or released by
+ * #mCc_writer_close.
+ */
+void mCc_writer_init_memory(struct mCc_writer *w);
+
+/**
+ * @brief Pass the buffered output to the sink.
+ *
+ * @return 0 on success, non-zero if this or an earlier flush failed
+ */
+int mCc_writer_flush(struct mCc_writer *w);
+
+/**
+ * @brief Flush and release the memory of a memory sink.
+ *
+ * @return 0 on success, non-zero if any output was lost
+ */
+int mCc_writer_close(struct mCc_writer *w);
+
+/**
+ * @brief Take the output of a memory sink, the writer starts over empty.
+ *
+ * @param w The writer
+ * @param size Set to the size of the output, without the terminating NUL
+ *
+ * @return The NUL-terminated output, to be freed by the caller, or NULL if
+ * output was lost
+ */
+char *mCc_writer_take_memory(struct mCc_writer *w, size_t *size);
+
+void mCc_writer_write(struct mCc_writer *w, const void *data, size_t size);
+
+static inline void mCc_writer_putc(struct mCc_writer *w, char c) {
+    if (w->len == MCC_WRITER_BUFFER_SIZE)
+        mCc_writer_flush(w);
+    w->buf[w->len++] = c;
+}
+
+static inline void mCc_writer_puts(struct mCc_writer *w, const char *s) {
+    mCc_writer_write(w, s, strlen(s));
+}
+
+/// Decimal integer like %d or %ld
+void mCc_writer_int(struct mCc_writer *w, long value);
+
+/// Decimal integer like %u or %lu
+void mCc_writer_uint(struct mCc_writer *w, unsigned long value);
+
+/// Pointer like %p
+void mCc_writer_ptr(struct mCc_writer *w, const void *ptr);
+
+/// Register operand in AT&T syntax, e.g. "eax" gives %eax
+void mCc_writer_reg(struct mCc_writer *w, const char *name);
+
+/// Memory operand in AT&T syntax, e.g. -8 and "ebp" give -8(%ebp)
+void mCc_writer_mem(struct mCc_writer *w, int disp, const char *base);
+
+/// Formatted output for everything without a specialised emitter
+void mCc_writer_printf(struct mCc_writer *w, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_WRITER_H
@@ -0,0 +1,41 @@
+/**
+ * @file x86_asm.h
+ * @brief Declarations for the integrated x86 assembler.
+ * @author richard
+ * @date 2018-06-20
+ */
+#ifndef MCC_X86_ASM_H
+#define MCC_X86_ASM_H
+
+#include <stdio.h>
+
+#include "elf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Assemble 32-bit x86 assembly in AT&T syntax into an object.
+ *
+ * Covers the instructions and directives emitted by #mCc_asm_generate_assembly
+ * and the usual general-purpose, x87 and SSE2 forms around them. Jumps and
+ * calls always use 32-bit displacements. Branches to labels of the same
+ * section are resolved directly, all other references become relocations.
+ * Symbols which are not defined in the input are global, as are symbols named
+ * by .global.
+ *
+ * @param in The assembly
+ * @param obj The object to add the sections and symbols to
+ * @param error Set to the offending line and a message on failure
+ *
+ * @return 0 on success, non-zero on failure
+ */
+int mCc_x86_assemble(FILE *in, struct mCc_elf_object *obj,
+                     struct mCc_elf_error *error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MCC_X86_ASM_H
@@ -0,0 +1,140 @@
+/**
+ * @file arena.c
+ * @brief Bump allocator for data that is released all at once.
+ * @author richard
+ * @date 2018-07-04
+ */
+#include "mCc/arena.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MCC_ARENA_ALIGN alignof(max_align_t)
+
+struct mCc_arena_block {
+    struct mCc_arena_block *next;
+    alignas(MCC_ARENA_ALIGN) char data[];
+};
+
+static size_t mCc_arena_round_up(size_t size) {
+    return (size + MCC_ARENA_ALIGN - 1) & ~(MCC_ARENA_ALIGN - 1);
+}
+
+/* Start a block with room for at least size bytes */
+static int mCc_arena_new_block(struct mCc_arena *arena, size_t size) {
+    size_t block_size = arena->next_block_size;
+    if (arena->next_block_size < MCC_ARENA_MAX_BLOCK_SIZE)
+        arena->next_block_size *= 2;
+
+    // Large allocations get a block of their own
+    if (size > block_size - sizeof(struct mCc_arena_block))
+        block_size = size + sizeof(struct mCc_arena_block);
+
+    struct mCc_arena_block *block = malloc(block_size);
+    if (!block)
+        return 1;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->pos = block->data;
+    arena->end = (char *)block + block_size;
+    return 0;
+}
+
+struct mCc_arena *mCc_arena_new(void) {
+    struct mCc_arena tmp = {
+        .blocks = NULL,
+        .last = NULL,
+        .next_block_size = MCC_ARENA_FIRST_BLOCK_SIZE,
+        .allocated = 0,
+    };
+    if (mCc_arena_new_block(&tmp, 0))
+        return NULL;
+
+    // The arena lives at the start of its first block
+    struct mCc_arena *arena = (struct mCc_arena *)tmp.pos;
+    *arena = tmp;
+    arena->pos += mCc_arena_round_up(sizeof(*arena));
+    return arena;
+}
+
+void mCc_arena_delete(struct mCc_arena *arena) {
+    if (!arena)
+        return;
+    struct mCc_arena_block *block = arena->blocks;
+    while (block) {
+        // The last block holds the arena, which is gone afterwards
+        struct mCc_arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void *mCc_arena_alloc(struct mCc_arena *arena, size_t size) {
+    size = mCc_arena_round_up(size ? size : 1);
+    if (size > (size_t)(arena->end - arena->pos) &&
+        mCc_arena_new_block(arena, size))
+        return NULL;
+
+    void *ptr = arena->pos;
+    arena->pos += size;
+    arena->last = ptr;
+    arena->allocated += size;
+    return ptr;
+}
+
+void *mCc_arena_realloc(struct mCc_arena *arena, void *ptr, size_t old_size,
+                        size_t new_size) {
+    if (!ptr)
+        return mCc_arena_alloc(arena, new_size);
+
+    old_size = mCc_arena_round_up(old_size ? old_size : 1);
+    new_size = mCc_arena_round_up(new_size ? new_size : 1);
+    if (new_size <= old_size)
+        return ptr;
+    if (ptr == arena->last &&
+        new_size - old_size <= (size_t)(arena->end - arena->pos)) {
+        arena->pos += new_size - old_size;
+        arena->allocated += new_size - old_size;
+        return ptr;
+    }
+
+    void *copy = mCc_arena_alloc(arena, new_size);
+    if (!copy)
+        return NULL;
+    memcpy(copy, ptr, old_size);
+    return copy;
+}
+
+char *mCc_arena_strdup(struct mCc_arena *arena, const char *str) {
+    size_t size = strlen(str) + 1;
+    char *copy = mCc_arena_alloc(arena, size);
+    if (copy)
+        memcpy(copy, str, size);
+    return copy;
+}
+
+struct mCc_arena_mark mCc_arena_mark(const struct mCc_arena *arena) {
+    struct mCc_arena_mark mark = {
+        .block = arena->blocks,
+        .pos = arena->pos,
+        .end = arena->end,
+        .last = arena->last,
+        .allocated = arena->allocated,
+    };
+    return mark;
+}
+
+void mCc_arena_release(struct mCc_arena *arena, struct mCc_arena_mark mark) {
+    // The block holding the arena is never newer than a mark
+    while (arena->blocks != mark.block) {
+        struct mCc_arena_block *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    arena->pos = mark.pos;
+    arena->end = mark.end;
+    arena->last = mark.last;
+    arena->allocated = mark.allocated;
+}
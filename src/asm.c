@@ -6,47 +6,92 @@
  */
 
 #include "mCc/asm.h"
+#include "mCc/context.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
-#define ARRAY_LENGTH 4096
-static struct mCc_asm_stack_pos position[ARRAY_LENGTH];
-static struct mCc_asm_stack_pos position_param[ARRAY_LENGTH];
-static struct mCc_asm_stack_pos position_fpu[ARRAY_LENGTH];
-
-static int current_elements_in_local_array = 0;
-static int current_elements_in_param_array = 0;
-static int current_elements_in_fpu = 0;
-static int current_frame_pointer = 0;
-static int current_param_pointer = 4;
-static int var_count = 0;
-
-static void mCc_asm_test_print(FILE *out) {
-    fprintf(out, "#=============== Local Stack\n");
-    for (int i = 0; i < current_elements_in_local_array; ++i) {
-        fprintf(out, "\n#Number: %d\n#Stack: %d\n#Enum Type: %d\n",
-                position[i].tac_number, position[i].stack_ptr,
-                position[i].lit_type);
+static const char *const internal_param_regs[MCC_ASM_INTERNAL_REG_PARAMS] = {
+    "%eax", "%edx", "%ecx"};
+
+/* Emit before, the local slot disp(%ebp) and after, the most common form */
+static void mCc_asm_emit_local(struct mCc_writer *out, const char *before,
+                               int disp, const char *after) {
+    mCc_writer_puts(out, before);
+    mCc_writer_mem(out, disp, "ebp");
+    mCc_writer_puts(out, after);
+}
+
+/* Emit before and the register operands %xmm<src>, %xmm<dst> */
+static void mCc_asm_emit_xmm(struct mCc_writer *out, const char *before,
+                             int src, int dst) {
+    mCc_writer_puts(out, before);
+    mCc_writer_puts(out, "%xmm");
+    mCc_writer_int(out, src);
+    mCc_writer_puts(out, ", %xmm");
+    mCc_writer_int(out, dst);
+    mCc_writer_putc(out, '\n');
+}
+
+/* Emit before, value and after, e.g. labels and immediates */
+static void mCc_asm_emit_int(struct mCc_writer *out, const char *before,
+                             int value, const char *after) {
+    mCc_writer_puts(out, before);
+    mCc_writer_int(out, value);
+    mCc_writer_puts(out, after);
+}
+
+/* Emit before, the label .<kind><value>.<function> and after. Local labels,
+ * floats and strings are numbered per function, so the name of the function
+ * keeps them apart. */
+static void mCc_asm_emit_label(struct mCc_asm_state *state,
+                               struct mCc_writer *out, const char *before,
+                               const char *kind, int value, const char *after) {
+    mCc_writer_puts(out, before);
+    mCc_writer_putc(out, '.');
+    mCc_writer_puts(out, kind);
+    mCc_writer_int(out, value);
+    mCc_writer_putc(out, '.');
+    mCc_writer_puts(out, state->function);
+    mCc_writer_puts(out, after);
+}
+
+static void mCc_asm_test_print(struct mCc_asm_state *state,
+                               struct mCc_writer *out) {
+    mCc_writer_puts(out, "#=============== Local Stack\n");
+    for (int i = 0; i < state->current_elements_in_local_array; ++i) {
+        mCc_writer_puts(out, "\n#Number: ");
+        mCc_writer_int(out, state->position[i].tac_number);
+        mCc_writer_puts(out, "\n#Stack: ");
+        mCc_writer_int(out, state->position[i].stack_ptr);
+        mCc_writer_puts(out, "\n#Enum Type: ");
+        mCc_writer_int(out, (int)state->position[i].lit_type);
+        mCc_writer_putc(out, '\n');
     }
 
-    fprintf(out, "#=============== Param Stack\n");
-    for (int i = 0; i < current_elements_in_param_array; ++i) {
-        fprintf(out, "\n#Number: %d\n#Stack: %d\n#Enum Type: %d\n",
-                position_param[i].tac_number, position_param[i].stack_ptr,
-                position_param[i].lit_type);
+    mCc_writer_puts(out, "#=============== Param Stack\n");
+    for (int i = 0; i < state->current_elements_in_param_array; ++i) {
+        mCc_writer_puts(out, "\n#Number: ");
+        mCc_writer_int(out, state->position_param[i].tac_number);
+        mCc_writer_puts(out, "\n#Stack: ");
+        mCc_writer_int(out, state->position_param[i].stack_ptr);
+        mCc_writer_puts(out, "\n#Enum Type: ");
+        mCc_writer_int(out, (int)state->position_param[i].lit_type);
+        mCc_writer_putc(out, '\n');
     }
 }
 
-static struct mCc_asm_stack_pos mCc_asm_get_stack_ptr_from_number(int number) {
-    for (int i = 0; i < current_elements_in_local_array; ++i) {
-        if (position[i].tac_number == number) {
-            return position[i];
+static struct mCc_asm_stack_pos
+mCc_asm_get_stack_ptr_from_number(struct mCc_asm_state *state,
+                                  int number) {
+    for (int i = 0; i < state->current_elements_in_local_array; ++i) {
+        if (state->position[i].tac_number == number) {
+            return state->position[i];
         }
     }
-    for (int i = 0; i < current_elements_in_param_array; ++i) {
-        if (position_param[i].tac_number == number)
-            return position_param[i];
+    for (int i = 0; i < state->current_elements_in_param_array; ++i) {
+        if (state->position_param[i].tac_number == number)
+            return state->position_param[i];
     }
     struct mCc_asm_stack_pos tmp;
     tmp.tac_number = -1;
@@ -79,118 +124,137 @@ static int mCc_asm_move_current_pointer(struct mCc_asm_stack_pos position,
         return -ret;
 }
 
-static void mCc_asm_print_assign_lit(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_assign_lit(struct mCc_asm_state *state,
+                                     struct mCc_tac_quad *quad,
+                                     struct mCc_writer *out) {
     struct mCc_tac_quad_literal *lit;
     lit = quad->literal;
 
     struct mCc_asm_stack_pos result =
-            mCc_asm_get_stack_ptr_from_number(quad->result.ref.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->result.ref.number);
 
     if (result.tac_number == -1) {
-        struct mCc_asm_stack_pos new_number;
+        struct mCc_asm_stack_pos new_number = { 0 };
         new_number.lit_type = lit->type;
-        current_frame_pointer +=
-                mCc_asm_move_current_pointer(new_number, current_frame_pointer);
+        state->current_frame_pointer += mCc_asm_move_current_pointer(
+                new_number, state->current_frame_pointer);
         new_number.tac_number = quad->result.ref.number;
-        new_number.stack_ptr = current_frame_pointer;
-        position[current_elements_in_local_array++] = new_number;
+        new_number.stack_ptr = state->current_frame_pointer;
+        state->position[state->current_elements_in_local_array++] = new_number;
         result = new_number;
     }
 
     switch (lit->type) {
         case MCC_TAC_QUAD_LIT_INT:
-            fprintf(out, "\tmovl\t$%d, %d(%%ebp)\n", lit->ival, result.stack_ptr);
+            mCc_writer_puts(out, "\tmovl\t$");
+            mCc_writer_int(out, lit->ival);
+            mCc_writer_puts(out, ", ");
+            mCc_writer_mem(out, result.stack_ptr, "ebp");
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_LIT_FLOAT:
-            fprintf(out, "\tflds\t.LC%d\n", current_elements_in_fpu);
-            fprintf(out, "\tfstps\t%d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_label(state, out, "\tflds\t", "LC",
+                               state->current_elements_in_fpu, "\n");
+            mCc_asm_emit_local(out, "\tfstps\t", result.stack_ptr, "\n");
             result.float_lit = lit->fval;
-            position_fpu[current_elements_in_fpu++] = result;
+            state->position_fpu[state->current_elements_in_fpu++] = result;
             break;
         case MCC_TAC_QUAD_LIT_BOOL:
-            fprintf(out, "\tmovl\t$%d, %d(%%ebp)\n", lit->bval ? 1 : 0,
-                    result.stack_ptr);
+            mCc_writer_puts(out, "\tmovl\t$");
+            mCc_writer_int(out, lit->bval ? 1 : 0);
+            mCc_writer_puts(out, ", ");
+            mCc_writer_mem(out, result.stack_ptr, "ebp");
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_LIT_STR:
-            fprintf(out, "\tmovl\t$S%d, %d(%%ebp)\n", lit->label_num,
-                    result.stack_ptr);
+            mCc_asm_emit_label(state, out, "\tmovl\t$", "LS", lit->label_num,
+                               ", ");
+            mCc_writer_mem(out, result.stack_ptr, "ebp");
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_LIT_VOID: break;
     }
 }
 
-static void mCc_asm_print_assign(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_assign(struct mCc_asm_state *state,
+                                 struct mCc_tac_quad *quad,
+                                 struct mCc_writer *out) {
     struct mCc_asm_stack_pos result =
-            mCc_asm_get_stack_ptr_from_number(quad->result.ref.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->result.ref.number);
     struct mCc_asm_stack_pos source =
-            mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
 
     if (result.tac_number == -1) {
-        current_frame_pointer +=
-                mCc_asm_move_current_pointer(source, current_frame_pointer);
-        struct mCc_asm_stack_pos new_number;
+        state->current_frame_pointer += mCc_asm_move_current_pointer(
+                source, state->current_frame_pointer);
+        struct mCc_asm_stack_pos new_number = { 0 };
         new_number.tac_number = quad->result.ref.number;
-        new_number.stack_ptr = current_frame_pointer;
+        new_number.stack_ptr = state->current_frame_pointer;
         new_number.lit_type = source.lit_type;
-        position[current_elements_in_local_array++] = new_number;
+        state->position[state->current_elements_in_local_array++] = new_number;
         result = new_number;
     }
     if (source.lit_type == MCC_TAC_QUAD_LIT_FLOAT) {
-        fprintf(out, "\tflds\t%d(%%ebp)\n", source.stack_ptr);
-        fprintf(out, "\tfstps\t%d(%%ebp)\n", result.stack_ptr);
+        mCc_asm_emit_local(out, "\tflds\t", source.stack_ptr, "\n");
+        mCc_asm_emit_local(out, "\tfstps\t", result.stack_ptr, "\n");
     } else {
-        fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", source.stack_ptr);
-        fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+        mCc_asm_emit_local(out, "\tmovl\t", source.stack_ptr, ", %eax\n");
+        mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
     }
 }
 
-static void mCc_asm_print_un_op(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_un_op(struct mCc_asm_state *state,
+                                struct mCc_tac_quad *quad,
+                                struct mCc_writer *out) {
     struct mCc_asm_stack_pos op1 =
-            mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
     struct mCc_asm_stack_pos result =
-            mCc_asm_get_stack_ptr_from_number(quad->result.ref.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->result.ref.number);
     if (result.tac_number == -1) {
-        current_frame_pointer +=
-                mCc_asm_move_current_pointer(op1, current_frame_pointer);
-        struct mCc_asm_stack_pos new_number;
+        state->current_frame_pointer +=
+                mCc_asm_move_current_pointer(op1, state->current_frame_pointer);
+        struct mCc_asm_stack_pos new_number = { 0 };
         new_number.tac_number = quad->result.ref.number;
-        new_number.stack_ptr = current_frame_pointer;
+        new_number.stack_ptr = state->current_frame_pointer;
         new_number.lit_type = op1.lit_type;
 
-        position[current_elements_in_local_array++] = new_number;
+        state->position[state->current_elements_in_local_array++] = new_number;
         result = new_number;
     }
     switch (quad->un_op) {
         case MCC_TAC_OP_UNARY_NEG:
             if (op1.lit_type == MCC_TAC_QUAD_LIT_FLOAT) {
-                fprintf(out, "\tflds\t%d(%%ebp)\n", op1.stack_ptr);
-                fprintf(out, "\tfchs\n");
-                fprintf(out, "\tfstps\t%d(%%ebp)\n", result.stack_ptr);
+                mCc_asm_emit_local(out, "\tflds\t", op1.stack_ptr, "\n");
+                mCc_writer_puts(out, "\tfchs\n");
+                mCc_asm_emit_local(out, "\tfstps\t", result.stack_ptr, "\n");
             } else {
-                fprintf(out, "\tnegl\t%d(%%ebp)\n", op1.stack_ptr);
+                mCc_asm_emit_local(out, "\tnegl\t", op1.stack_ptr, "\n");
             }
             break;
         case MCC_TAC_OP_UNARY_NOT:
-            fprintf(out, "\tandl\t$1, %d(%%ebp) # mask to 1 bit\n", op1.stack_ptr);
-            fprintf(out, "\txorl\t$1, %d(%%ebp)\n", op1.stack_ptr);
+            mCc_asm_emit_local(out, "\tandl\t$1, ", op1.stack_ptr,
+                               " # mask to 1 bit\n");
+            mCc_asm_emit_local(out, "\txorl\t$1, ", op1.stack_ptr, "\n");
             break;
     }
 }
 
-static void mCc_asm_print_bin_op(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_bin_op(struct mCc_asm_state *state,
+                                 struct mCc_tac_quad *quad,
+                                 struct mCc_writer *out) {
     struct mCc_asm_stack_pos result =
-            mCc_asm_get_stack_ptr_from_number(quad->result.ref.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->result.ref.number);
     struct mCc_asm_stack_pos op1 =
-            mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
     struct mCc_asm_stack_pos op2 =
-            mCc_asm_get_stack_ptr_from_number(quad->arg2.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg2.number);
 
     if (result.tac_number == -1) {
-        current_frame_pointer +=
-                mCc_asm_move_current_pointer(op1, current_frame_pointer);
-        struct mCc_asm_stack_pos new_number;
+        state->current_frame_pointer +=
+                mCc_asm_move_current_pointer(op1, state->current_frame_pointer);
+        struct mCc_asm_stack_pos new_number = { 0 };
         new_number.tac_number = quad->result.ref.number;
-        new_number.stack_ptr = current_frame_pointer;
+        new_number.stack_ptr = state->current_frame_pointer;
 
         // depending on the OP we got diff types
         switch (quad->bin_op) {
@@ -216,379 +280,728 @@ static void mCc_asm_print_bin_op(struct mCc_tac_quad *quad, FILE *out) {
                 break;
         }
 
-        position[current_elements_in_local_array++] = new_number;
+        state->position[state->current_elements_in_local_array++] = new_number;
         result = new_number;
     }
     switch (quad->bin_op) {
 
         case MCC_TAC_OP_BINARY_ADD:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%edx\n", op1.stack_ptr);
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\taddl\t%%edx,%%eax\n");
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %edx\n");
+            mCc_asm_emit_local(out, "\tmovl\t", op2.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\taddl\t%edx,%eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_SUB:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tsubl\t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tsubl\t", op2.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_MUL:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\timull\t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\timull\t", op2.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_DIV:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tcltd\n");
-            fprintf(out, "\tidivl\t%d(%%ebp)\n", op2.stack_ptr);
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\tcltd\n");
+            mCc_asm_emit_local(out, "\tidivl\t", op2.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_LT:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tcmpl\t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\tsetl\t%%al\n");
-            fprintf(out, "\tmovzx\t%%al, %%eax\n");
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tcmpl\t", op2.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\tsetl\t%al\n");
+            mCc_writer_puts(out, "\tmovzx\t%al, %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_GT:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tcmpl\t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\tsetg\t%%al\n");
-            fprintf(out, "\tmovzx\t%%al, %%eax\n");
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tcmpl\t", op2.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\tsetg\t%al\n");
+            mCc_writer_puts(out, "\tmovzx\t%al, %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_LEQ:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tcmpl\t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\tsetle\t%%al\n");
-            fprintf(out, "\tmovzx\t%%al, %%eax\n");
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tcmpl\t", op2.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\tsetle\t%al\n");
+            mCc_writer_puts(out, "\tmovzx\t%al, %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_GEQ:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tcmpl\t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\tsetge\t%%al\n");
-            fprintf(out, "\tmovzx\t%%al, %%eax\n");
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tcmpl\t", op2.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\tsetge\t%al\n");
+            mCc_writer_puts(out, "\tmovzx\t%al, %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_AND:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tmovl\t%d(%%ebp), %%ebx\n", op2.stack_ptr);
-            fprintf(out, "\tandl\t%%eax, %%ebx\n");
-            fprintf(out, "\tmovl\t%%ebx, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t", op2.stack_ptr, ", %ebx\n");
+            mCc_writer_puts(out, "\tandl\t%eax, %ebx\n");
+            mCc_asm_emit_local(out, "\tmovl\t%ebx, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_OR:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tmovl\t%d(%%ebp), %%ebx\n", op2.stack_ptr);
-            fprintf(out, "\torl\t%%eax, %%ebx\n");
-            fprintf(out, "\tmovl\t%%ebx, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t", op2.stack_ptr, ", %ebx\n");
+            mCc_writer_puts(out, "\torl\t%eax, %ebx\n");
+            mCc_asm_emit_local(out, "\tmovl\t%ebx, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_EQ:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tcmpl\t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\tsete\t%%al\n");
-            fprintf(out, "\tmovzx\t%%al, %%eax\n");
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tcmpl\t", op2.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\tsete\t%al\n");
+            mCc_writer_puts(out, "\tmovzx\t%al, %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_NEQ:
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", op1.stack_ptr);
-            fprintf(out, "\tcmpl \t%d(%%ebp), %%eax\n", op2.stack_ptr);
-            fprintf(out, "\tsetne\t%%al\n");
-            fprintf(out, "\tmovzx\t%%al, %%eax\n");
-            fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tmovl\t", op1.stack_ptr, ", %eax\n");
+            mCc_asm_emit_local(out, "\tcmpl \t", op2.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\tsetne\t%al\n");
+            mCc_writer_puts(out, "\tmovzx\t%al, %eax\n");
+            mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_FLOAT_ADD:
-            fprintf(out, "\tflds\t%d(%%ebp)\n", op1.stack_ptr);
-            fprintf(out, "\tfadds\t%d(%%ebp)\n", op2.stack_ptr);
-            fprintf(out, "\tfstps\t%d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tflds\t", op1.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tfadds\t", op2.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tfstps\t", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_FLOAT_SUB:
-            fprintf(out, "\tflds\t%d(%%ebp)\n", op1.stack_ptr);
-            fprintf(out, "\tfsubs\t%d(%%ebp)\n", op2.stack_ptr);
-            fprintf(out, "\tfstps\t%d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tflds\t", op1.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tfsubs\t", op2.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tfstps\t", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_FLOAT_MUL:
-            fprintf(out, "\tflds\t%d(%%ebp)\n", op1.stack_ptr);
-            fprintf(out, "\tfmuls\t%d(%%ebp)\n", op2.stack_ptr);
-            fprintf(out, "\tfstps\t%d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tflds\t", op1.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tfmuls\t", op2.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tfstps\t", result.stack_ptr, "\n");
             break;
         case MCC_TAC_OP_BINARY_FLOAT_DIV:
-            fprintf(out, "\tflds\t%d(%%ebp)\n", op1.stack_ptr);
-            fprintf(out, "\tfdivs\t%d(%%ebp)\n", op2.stack_ptr);
-            fprintf(out, "\tfstps\t%d(%%ebp)\n", result.stack_ptr);
+            mCc_asm_emit_local(out, "\tflds\t", op1.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tfdivs\t", op2.stack_ptr, "\n");
+            mCc_asm_emit_local(out, "\tfstps\t", result.stack_ptr, "\n");
             break;
     }
 }
 
-static void mCc_asm_print_label(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_select(struct mCc_asm_state *state,
+                                 struct mCc_tac_quad *quad,
+                                 struct mCc_writer *out) {
+    struct mCc_asm_stack_pos cond =
+            mCc_asm_get_stack_ptr_from_number(state, quad->select_cond);
+    struct mCc_asm_stack_pos if_true =
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
+    struct mCc_asm_stack_pos result =
+            mCc_asm_get_stack_ptr_from_number(state, quad->result.ref.number);
+
+    if (result.tac_number == -1) {
+        state->current_frame_pointer += mCc_asm_move_current_pointer(
+                if_true, state->current_frame_pointer);
+        struct mCc_asm_stack_pos new_number = { 0 };
+        new_number.tac_number = quad->result.ref.number;
+        new_number.stack_ptr = state->current_frame_pointer;
+        new_number.lit_type = if_true.lit_type;
+        state->position[state->current_elements_in_local_array++] = new_number;
+        result = new_number;
+    }
+    // An undefined false value is only possible if the result was
+    // uninitialised before the if, so keep whatever is in the result
+    struct mCc_asm_stack_pos if_false =
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg2.number);
+    if (if_false.tac_number == -1)
+        if_false = result;
+
+    // Floats are moved as raw 32-bit values, so this works for all types
+    mCc_asm_emit_local(out, "\tmovl\t", if_false.stack_ptr, ", %eax\n");
+    mCc_asm_emit_local(out, "\tcmpl\t$0, ", cond.stack_ptr, "\n");
+    mCc_asm_emit_local(out, "\tcmovne\t", if_true.stack_ptr, ", %eax\n");
+    mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
+}
+
+static void mCc_asm_print_label(struct mCc_asm_state *state,
+                                struct mCc_tac_quad *quad,
+                                struct mCc_writer *out) {
 
     if (quad->result.label.num > -1) {
-        fprintf(out, ".L%d:\n", quad->result.label.num);
+        if (quad->loop_header)
+            mCc_writer_puts(out, "\t.p2align\t4,,10\t# align loop header\n");
+        mCc_asm_emit_label(state, out, "", "L", quad->result.label.num, ":\n");
     } else {
-        current_frame_pointer = 0;
-        current_param_pointer = 4;
-
-        fprintf(out, ".global\t%s\n", quad->result.label.str);
-        fprintf(out, ".type\t%s, @function\n", quad->result.label.str);
-        fprintf(out, "%s:\n", quad->result.label.str);
-        fprintf(out, "\tpushl\t%%ebp\t# save ebp so it can be restored\n");
-        fprintf(out, "\tmovl\t%%esp, %%ebp\t# save stack in base so we can "
-                "grow it if needed\n");
+        state->current_frame_pointer = 0;
+        state->current_param_pointer = 4;
+
+        mCc_writer_puts(out, ".global\t");
+        mCc_writer_puts(out, quad->result.label.str);
+        mCc_writer_putc(out, '\n');
+        mCc_writer_puts(out, ".type\t");
+        mCc_writer_puts(out, quad->result.label.str);
+        mCc_writer_puts(out, ", @function\n");
+        mCc_writer_puts(out, quad->result.label.str);
+        mCc_writer_puts(out, ":\n");
+        mCc_writer_puts(out,
+                        "\tpushl\t%ebp\t# save ebp so it can be restored\n");
+        mCc_writer_puts(out, "\tmovl\t%esp, %ebp\t# save stack in base so we can "
+                             "grow it if needed\n");
         unsigned int i = 1;
         while (true) {
             if (quad->var_count < i) {
-                var_count =
+                state->var_count =
                         (quad->var_count * 4) - (quad->var_count * 4) % 16 + 16;
                 break;
             }
             i = i + 4;
         }
-        fprintf(out, "\tsubl\t$%d, %%esp\t# grow stack for local vars\n",
-                var_count);
-        fprintf(out, "\t# begin function body\n");
+        mCc_asm_emit_int(out, "\tsubl\t$", state->var_count,
+                         ", %esp\t# grow stack for local vars\n");
+
+        // Make every parameter addressable: register parameters are spilled
+        // into local slots, stack parameters are read from above %ebp
+        unsigned int stack_offset =
+                quad->call_conv == MCC_TAC_CALL_CONV_INTERNAL
+                        ? MCC_ASM_INTERNAL_REG_PARAMS
+                        : 0;
+        for (unsigned int p = 0; p < quad->param_count; ++p) {
+            struct mCc_asm_stack_pos new_number = { 0 };
+            new_number.tac_number = quad->params[p].number;
+            new_number.lit_type = quad->params[p].type;
+            if (quad->call_conv == MCC_TAC_CALL_CONV_INTERNAL &&
+                p < MCC_ASM_INTERNAL_REG_PARAMS) {
+                state->current_frame_pointer += mCc_asm_move_current_pointer(
+                        new_number, state->current_frame_pointer);
+                new_number.stack_ptr = state->current_frame_pointer;
+                new_number.indirect = quad->params[p].is_array;
+                state->position[state->current_elements_in_local_array++] =
+                        new_number;
+                mCc_writer_puts(out, "\tmovl\t");
+                mCc_writer_puts(out, internal_param_regs[p]);
+                mCc_writer_puts(out, ", ");
+                mCc_writer_mem(out, new_number.stack_ptr, "ebp");
+                mCc_writer_puts(out, "\t# spill param ");
+                mCc_writer_uint(out, p);
+                mCc_writer_putc(out, '\n');
+            } else {
+                new_number.stack_ptr = 8 + 4 * (p - stack_offset);
+                int slot = state->current_elements_in_param_array++;
+                state->position_param[slot] = new_number;
+            }
+        }
+        mCc_writer_puts(out, "\t# begin function body\n");
     }
 }
 
-static void mCc_asm_print_jump_false(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_jump_false(struct mCc_asm_state *state,
+                                     struct mCc_tac_quad *quad,
+                                     struct mCc_writer *out) {
     struct mCc_asm_stack_pos condition =
-            mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
-    fprintf(
-            out, "\tcmpl\t$0, %d(%%ebp)\n",
-            condition.stack_ptr); // compare with 0 because everything else is true
-    fprintf(out, "\tje\t.L%d\n", quad->result.label.num);
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
+    // compare with 0 because everything else is true
+    mCc_asm_emit_local(out, "\tcmpl\t$0, ", condition.stack_ptr, "\n");
+    mCc_asm_emit_label(state, out, "\tje\t", "L", quad->result.label.num,
+                       "\n");
 }
 
-static void mCc_asm_handle_load(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_jump_true(struct mCc_asm_state *state,
+                                    struct mCc_tac_quad *quad,
+                                    struct mCc_writer *out) {
+    struct mCc_asm_stack_pos condition =
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
+    mCc_asm_emit_local(out, "\tcmpl\t$0, ", condition.stack_ptr, "\n");
+    mCc_asm_emit_label(state, out, "\tjne\t", "L", quad->result.label.num,
+                       "\n");
+}
+
+static void mCc_asm_handle_load(struct mCc_asm_state *state,
+                                struct mCc_tac_quad *quad,
+                                struct mCc_writer *out) {
     // Load can either be a param or a load from array
     if (quad->arg1.array_size > 0) {
         struct mCc_asm_stack_pos index =
-                mCc_asm_get_stack_ptr_from_number(quad->arg2.number);
+                mCc_asm_get_stack_ptr_from_number(state, quad->arg2.number);
         struct mCc_asm_stack_pos result =
-                mCc_asm_get_stack_ptr_from_number(quad->result.ref.number);
+                mCc_asm_get_stack_ptr_from_number(
+                        state, quad->result.ref.number);
         struct mCc_asm_stack_pos array =
-                mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
+                mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
 
         if (result.tac_number == -1) {
-            struct mCc_asm_stack_pos new_number;
+            struct mCc_asm_stack_pos new_number = { 0 };
             new_number.lit_type = array.lit_type;
-            current_frame_pointer +=
-                    mCc_asm_move_current_pointer(new_number, current_frame_pointer);
+            state->current_frame_pointer += mCc_asm_move_current_pointer(
+                    new_number, state->current_frame_pointer);
             new_number.tac_number = quad->result.ref.number;
-            new_number.stack_ptr = current_frame_pointer;
-            position[current_elements_in_local_array++] = new_number;
+            new_number.stack_ptr = state->current_frame_pointer;
+            state->position[state->current_elements_in_local_array++] =
+                    new_number;
             result = new_number;
         }
-        fprintf(out, "\t#load from an array begins\n");
-        fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", index.stack_ptr);
+        mCc_writer_puts(out, "\t#load from an array begins\n");
+        mCc_asm_emit_local(out, "\tmovl\t", index.stack_ptr, ", %eax\n");
 
         // Else branch for params(not tested)
         int byte_to_add = (quad->arg1.array_size - 1) * 4;
-        if (array.stack_ptr < 0) {
-            fprintf(out, "\tmovl\t%d(%%ebp,%%eax,4), %%eax\n",
-                    -(byte_to_add - array.stack_ptr)); // four byte value
+        if (array.stack_ptr < 0 && !array.indirect) {
+            mCc_asm_emit_int(out, "\tmovl\t", -(byte_to_add - array.stack_ptr),
+                             "(%ebp,%eax,4), %eax\n"); // four byte value
         } else {
             // array as param
-            fprintf(out, "\tleal\t0(,%%eax,4), %%edx\n");
-            fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", array.stack_ptr);
-            fprintf(out, "\taddl\t%%edx, %%eax\n");
-            fprintf(out, "\tmovl\t(%%eax), %%eax\n");
+            mCc_writer_puts(out, "\tleal\t0(,%eax,4), %edx\n");
+            mCc_asm_emit_local(out, "\tmovl\t", array.stack_ptr, ", %eax\n");
+            mCc_writer_puts(out, "\taddl\t%edx, %eax\n");
+            mCc_writer_puts(out, "\tmovl\t(%eax), %eax\n");
         }
-        fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\n", result.stack_ptr);
-        fprintf(out, "\t#load from an array ends\n");
+        mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr, "\n");
+        mCc_writer_puts(out, "\t#load from an array ends\n");
 
     } else {
         struct mCc_asm_stack_pos result =
-                mCc_asm_get_stack_ptr_from_number(quad->result.ref.number);
+                mCc_asm_get_stack_ptr_from_number(
+                        state, quad->result.ref.number);
         if (result.tac_number == -1) {
-            struct mCc_asm_stack_pos new_number;
+            struct mCc_asm_stack_pos new_number = { 0 };
             new_number.lit_type = quad->result.ref.type;
-            current_param_pointer +=
-                    mCc_asm_move_current_pointer(new_number, current_param_pointer);
+            state->current_param_pointer += mCc_asm_move_current_pointer(
+                    new_number, state->current_param_pointer);
             new_number.tac_number = quad->result.ref.number;
-            new_number.stack_ptr = current_param_pointer;
-            position_param[current_elements_in_param_array++] = new_number;
+            new_number.stack_ptr = state->current_param_pointer;
+            state->position_param[state->current_elements_in_param_array++] =
+                    new_number;
         }
     }
 }
 
-static void mCc_asm_handle_store(struct mCc_tac_quad *quad, FILE *out) {
+/// Allocate a local array on its first use
+static struct mCc_asm_stack_pos
+mCc_asm_new_array(struct mCc_asm_state *state, struct mCc_tac_quad_entry array,
+                  enum mCc_tac_quad_literal_type type) {
+    struct mCc_asm_stack_pos new_number = { 0 };
+    new_number.lit_type = type;
+    state->current_frame_pointer += mCc_asm_move_current_pointer(
+            new_number, state->current_frame_pointer);
+    new_number.tac_number = array.number;
+    new_number.stack_ptr = state->current_frame_pointer;
+    state->position[state->current_elements_in_local_array++] = new_number;
+
+    if (state->current_frame_pointer < 0)
+        state->current_frame_pointer =
+                -((array.array_size - 1) * 4 - state->current_frame_pointer);
+    return new_number;
+}
+
+static void mCc_asm_handle_store(struct mCc_asm_state *state,
+                                 struct mCc_tac_quad *quad,
+                                 struct mCc_writer *out) {
     struct mCc_asm_stack_pos index =
-            mCc_asm_get_stack_ptr_from_number(quad->arg2.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg2.number);
     struct mCc_asm_stack_pos result =
-            mCc_asm_get_stack_ptr_from_number(quad->result.ref.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->result.ref.number);
     struct mCc_asm_stack_pos value =
-            mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
 
     int byte_to_add = (quad->result.ref.array_size - 1) * 4;
 
-    if (result.tac_number == -1) {
-        current_frame_pointer +=
-                mCc_asm_move_current_pointer(value, current_frame_pointer);
-        struct mCc_asm_stack_pos new_number;
-        new_number.tac_number = quad->result.ref.number;
-        new_number.stack_ptr = current_frame_pointer;
-        new_number.lit_type = value.lit_type;
-        position[current_elements_in_local_array++] = new_number;
-        result = new_number;
+    if (result.tac_number == -1)
+        result = mCc_asm_new_array(state, quad->result.ref, value.lit_type);
+    mCc_writer_puts(out, "\t#store into an array begins\n");
 
-        if (current_frame_pointer < 0)
-            current_frame_pointer = -(byte_to_add - current_frame_pointer);
+    mCc_asm_emit_local(out, "\tmovl\t", index.stack_ptr, ", %eax\n");
+
+    if (result.stack_ptr < 0 && !result.indirect) {
+        mCc_asm_emit_local(out, "\tmovl\t", value.stack_ptr, ", %edx\n");
+        mCc_asm_emit_int(out, "\tmovl\t%edx, ",
+                         -(byte_to_add - result.stack_ptr),
+                         "(%ebp,%eax,4)\n"); // four byte value
+    } else {
+        mCc_writer_puts(out, "\tleal\t0(,%eax,4), %edx\n"); // four byte value
+        mCc_asm_emit_local(out, "\tmovl\t", result.stack_ptr, ", %eax\n");
+        mCc_writer_puts(out, "\taddl\t%eax, %edx\n");
+        mCc_asm_emit_local(out, "\tmovl\t", value.stack_ptr, ", %eax\n");
+        mCc_writer_puts(out, "\tmovl\t%eax, (%edx)\n");
     }
-    fprintf(out, "\t#store into an array begins\n");
 
-    fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", index.stack_ptr);
+    mCc_writer_puts(out, "\t#store into an array ends\n");
+}
 
-    if (result.stack_ptr < 0) {
-        fprintf(out, "\tmovl\t%d(%%ebp), %%edx\n", value.stack_ptr);
-        fprintf(out, "\tmovl\t%%edx, %d(%%ebp,%%eax,4)\n",
-                -(byte_to_add - result.stack_ptr)); // four byte value
+/// Load the address of array[index] into %eax
+static void mCc_asm_print_element_address(struct mCc_asm_state *state,
+                                          struct mCc_tac_quad_entry array_entry,
+                                          int index_number,
+                                          enum mCc_tac_quad_literal_type type,
+                                          struct mCc_writer *out) {
+    struct mCc_asm_stack_pos index =
+            mCc_asm_get_stack_ptr_from_number(state, index_number);
+    struct mCc_asm_stack_pos array =
+            mCc_asm_get_stack_ptr_from_number(state, array_entry.number);
+    if (array.tac_number == -1)
+        array = mCc_asm_new_array(state, array_entry, type);
+
+    mCc_asm_emit_local(out, "\tmovl\t", index.stack_ptr, ", %edx\n");
+    if (array.stack_ptr < 0 && !array.indirect) {
+        int byte_to_add = (array_entry.array_size - 1) * 4;
+        mCc_asm_emit_int(out, "\tleal\t", -(byte_to_add - array.stack_ptr),
+                         "(%ebp,%edx,4), %eax\n");
     } else {
-        fprintf(out, "\tleal\t0(,%%eax,4), %%edx\n"); // four byte value
-        fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", result.stack_ptr);
-        fprintf(out, "\taddl\t%%eax, %%edx\n");
-        fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", value.stack_ptr);
-        fprintf(out, "\tmovl\t%%eax, (%%edx)\n");
+        // array as param
+        mCc_asm_emit_local(out, "\tmovl\t", array.stack_ptr, ", %eax\n");
+        mCc_writer_puts(out, "\tleal\t(%eax,%edx,4), %eax\n");
     }
+}
 
-    fprintf(out, "\t#store into an array ends\n");
+static void mCc_asm_print_vector(struct mCc_asm_state *state,
+                                 struct mCc_tac_quad *quad,
+                                 struct mCc_writer *out) {
+    const struct mCc_tac_vector *v = &quad->vector;
+    switch (quad->type) {
+        case MCC_TAC_QUAD_VECTOR_ZERO:
+            mCc_asm_emit_xmm(out, "\tpxor\t", v->dst, v->dst);
+            break;
+        case MCC_TAC_QUAD_VECTOR_SPLAT: {
+            struct mCc_asm_stack_pos value =
+                    mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
+            // Floats are moved as raw 32-bit values
+            mCc_asm_emit_local(out, "\tmovd\t", value.stack_ptr, ", %xmm");
+            mCc_asm_emit_int(out, "", v->dst, "\n");
+            mCc_asm_emit_xmm(out, "\tpshufd\t$0, ", v->dst, v->dst);
+            break;
+        }
+        case MCC_TAC_QUAD_VECTOR_LOAD:
+            mCc_asm_print_element_address(state, quad->arg1, quad->arg2.number,
+                                          quad->arg1.type, out);
+            mCc_asm_emit_int(out, "\tmovdqu\t(%eax), %xmm", v->dst, "\n");
+            break;
+        case MCC_TAC_QUAD_VECTOR_OP: {
+            const char *op;
+            switch (v->op) {
+                case MCC_TAC_OP_BINARY_ADD:
+                    op = "paddd";
+                    break;
+                case MCC_TAC_OP_BINARY_SUB:
+                    op = "psubd";
+                    break;
+                case MCC_TAC_OP_BINARY_FLOAT_ADD:
+                    op = "addps";
+                    break;
+                case MCC_TAC_OP_BINARY_FLOAT_SUB:
+                    op = "subps";
+                    break;
+                case MCC_TAC_OP_BINARY_FLOAT_MUL:
+                    op = "mulps";
+                    break;
+                case MCC_TAC_OP_BINARY_FLOAT_DIV:
+                    op = "divps";
+                    break;
+                default:
+                    mCc_writer_puts(out, "\t# unsupported vector operation\n");
+                    return;
+            }
+            // Two-operand form, the vectorizer never lets dst alias src2
+            if (v->dst != v->src1)
+                mCc_asm_emit_xmm(out, "\tmovdqa\t", v->src1, v->dst);
+            mCc_writer_putc(out, '\t');
+            mCc_writer_puts(out, op);
+            mCc_asm_emit_xmm(out, "\t", v->src2, v->dst);
+            break;
+        }
+        case MCC_TAC_QUAD_VECTOR_STORE: {
+            struct mCc_asm_stack_pos array =
+                    mCc_asm_get_stack_ptr_from_number(
+                            state, quad->result.ref.number);
+            mCc_asm_print_element_address(state, quad->result.ref,
+                                          quad->arg2.number,
+                                          array.tac_number == -1
+                                                  ? quad->result.ref.type
+                                                  : array.lit_type,
+                                          out);
+            mCc_asm_emit_int(out, "\tmovdqu\t%xmm", v->src1, ", (%eax)\n");
+            break;
+        }
+        case MCC_TAC_QUAD_VECTOR_REDUCE: {
+            struct mCc_asm_stack_pos result =
+                    mCc_asm_get_stack_ptr_from_number(
+                            state, quad->result.ref.number);
+            int tmp1 = (v->src1 + 1) % MCC_TAC_VECTOR_REGS;
+            int tmp2 = (v->src1 + 2) % MCC_TAC_VECTOR_REGS;
+            // Add the upper half to the lower one, then the two lanes left
+            mCc_asm_emit_xmm(out, "\tpshufd\t$0x4e, ", v->src1, tmp1);
+            mCc_asm_emit_xmm(out, "\tpaddd\t", v->src1, tmp1);
+            mCc_asm_emit_xmm(out, "\tpshufd\t$0xb1, ", tmp1, tmp2);
+            mCc_asm_emit_xmm(out, "\tpaddd\t", tmp2, tmp1);
+            mCc_asm_emit_int(out, "\tmovd\t%xmm", tmp1, ", %eax\n");
+            mCc_asm_emit_local(out, "\taddl\t%eax, ", result.stack_ptr, "\n");
+            break;
+        }
+        default:
+            break;
+    }
 }
 
-static void mCc_asm_print_return_void(FILE *out) {
-    fprintf(out,
-            "\tmovl\t$0, %%eax\t# return zero because of main --> exit code\n");
-    fprintf(out, "\t# epilogue (cleanup)\n");
-    fprintf(out, "\tleave\t # shrink stack and restore %%ebp\n");
-    fprintf(out, "\tret\n\n");
+static void mCc_asm_print_return_void(struct mCc_writer *out) {
+    mCc_writer_puts(out, "\tmovl\t$0, %eax\t# return zero because of main --> "
+                         "exit code\n");
+    mCc_writer_puts(out, "\t# epilogue (cleanup)\n");
+    mCc_writer_puts(out, "\tleave\t # shrink stack and restore %ebp\n");
+    mCc_writer_puts(out, "\tret\n\n");
 }
 
-static void mCc_asm_print_return(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_return(struct mCc_asm_state *state,
+                                 struct mCc_tac_quad *quad,
+                                 struct mCc_writer *out) {
     struct mCc_asm_stack_pos ret_val =
-            mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
-    fprintf(out, "\tmovl\t%d(%%ebp), %%eax\n", ret_val.stack_ptr);
-    fprintf(out, "\t# epilogue (cleanup)\n");
-    fprintf(out, "\tleave\t # shrink stack and restore %%ebp\n");
-    fprintf(out, "\tret\n\n");
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
+    mCc_asm_emit_local(out, "\tmovl\t", ret_val.stack_ptr, ", %eax\n");
+    mCc_writer_puts(out, "\t# epilogue (cleanup)\n");
+    mCc_writer_puts(out, "\tleave\t # shrink stack and restore %ebp\n");
+    mCc_writer_puts(out, "\tret\n\n");
 }
 
-static void mCc_asm_print_param(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_param(struct mCc_asm_state *state,
+                                struct mCc_tac_quad *quad,
+                                struct mCc_writer *out) {
     struct mCc_asm_stack_pos result =
-            mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
-    if (result.tac_number == -1) {
-        struct mCc_asm_stack_pos new_number;
-        current_frame_pointer +=
-                mCc_asm_move_current_pointer(new_number, current_frame_pointer);
-        new_number.tac_number = quad->result.ref.number;
-        new_number.stack_ptr = current_frame_pointer;
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
+    if (result.tac_number == -1 && quad->arg1.array_size > 0) {
+        // A local array passed before any other use
+        result = mCc_asm_new_array(state, quad->arg1, quad->arg1.type);
+    } else if (result.tac_number == -1) {
+        struct mCc_asm_stack_pos new_number = { 0 };
+        state->current_frame_pointer += mCc_asm_move_current_pointer(
+                new_number, state->current_frame_pointer);
+        new_number.tac_number = quad->arg1.number;
+        new_number.stack_ptr = state->current_frame_pointer;
 
-        position[current_elements_in_local_array++] = new_number;
+        state->position[state->current_elements_in_local_array++] = new_number;
         result = new_number;
     }
+    int stack_ptr = result.stack_ptr;
+    if (quad->arg1.array_size > 0)
+        stack_ptr = -(((quad->arg1.array_size - 1) * 4) - result.stack_ptr);
+
+    // Register arguments are loaded at the call, after all pushes
+    if (quad->call_conv == MCC_TAC_CALL_CONV_INTERNAL &&
+        quad->var_count < MCC_ASM_INTERNAL_REG_PARAMS) {
+        state->pending_reg_params[quad->var_count].used = true;
+        state->pending_reg_params[quad->var_count].stack_ptr = stack_ptr;
+        state->pending_reg_params[quad->var_count].address =
+                quad->arg1.array_size > 0;
+        return;
+    }
+
     if (quad->arg1.array_size > 0) {
-        fprintf(out, "\tleal\t%d(%%ebp), %%eax\n",
-                -(((quad->arg1.array_size - 1) * 4) - result.stack_ptr));
-        fprintf(out, "\tpushl\t%%eax\n");
+        mCc_asm_emit_local(out, "\tleal\t", stack_ptr, ", %eax\n");
+        mCc_writer_puts(out, "\tpushl\t%eax\n");
     } else {
-        fprintf(out, "\tpushl\t%d(%%ebp)\n", result.stack_ptr);
+        mCc_asm_emit_local(out, "\tpushl\t", stack_ptr, "\n");
     }
 }
 
-static void mCc_asm_print_call(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_print_call(struct mCc_asm_state *state,
+                               struct mCc_tac_quad *quad,
+                               struct mCc_writer *out) {
     struct mCc_asm_stack_pos result =
-            mCc_asm_get_stack_ptr_from_number(quad->arg1.number);
+            mCc_asm_get_stack_ptr_from_number(state, quad->arg1.number);
 
     if (result.tac_number == -1) {
-        struct mCc_asm_stack_pos new_number;
+        struct mCc_asm_stack_pos new_number = { 0 };
         new_number.lit_type = quad->result.label.type;
-        current_frame_pointer +=
-                mCc_asm_move_current_pointer(new_number, current_frame_pointer);
+        state->current_frame_pointer += mCc_asm_move_current_pointer(
+                new_number, state->current_frame_pointer);
         new_number.tac_number = quad->arg1.number;
-        new_number.stack_ptr = current_frame_pointer;
-        position[current_elements_in_local_array++] = new_number;
+        new_number.stack_ptr = state->current_frame_pointer;
+        state->position[state->current_elements_in_local_array++] = new_number;
         result = new_number;
     }
-    fprintf(out, "\tcall\t%s\n", quad->result.label.str);
-    if (quad->var_count)
-        fprintf(out, "\taddl\t$%d, %%esp\t# remove params from stack\n",
-                quad->var_count * 4);
-    fprintf(out, "\tmovl\t%%eax, %d(%%ebp)\t# save return value\n",
-            result.stack_ptr);
+    unsigned int stack_params = quad->var_count;
+    if (quad->call_conv == MCC_TAC_CALL_CONV_INTERNAL) {
+        for (int i = 0; i < MCC_ASM_INTERNAL_REG_PARAMS; ++i) {
+            if (!state->pending_reg_params[i].used)
+                continue;
+            mCc_writer_putc(out, '\t');
+            mCc_writer_puts(out, state->pending_reg_params[i].address ? "leal"
+                                                                      : "movl");
+            mCc_writer_putc(out, '\t');
+            mCc_writer_mem(out, state->pending_reg_params[i].stack_ptr, "ebp");
+            mCc_writer_puts(out, ", ");
+            mCc_writer_puts(out, internal_param_regs[i]);
+            mCc_writer_putc(out, '\n');
+            state->pending_reg_params[i].used = false;
+        }
+        stack_params = stack_params > MCC_ASM_INTERNAL_REG_PARAMS
+                       ? stack_params - MCC_ASM_INTERNAL_REG_PARAMS
+                       : 0;
+    }
+    mCc_writer_puts(out, "\tcall\t");
+    mCc_writer_puts(out, quad->result.label.str);
+    mCc_writer_putc(out, '\n');
+    if (stack_params)
+        mCc_asm_emit_int(out, "\taddl\t$", stack_params * 4,
+                         ", %esp\t# remove params from stack\n");
+    mCc_asm_emit_local(out, "\tmovl\t%eax, ", result.stack_ptr,
+                       "\t# save return value\n");
 }
 
-static void mCc_asm_assembly_from_quad(struct mCc_tac_quad *quad, FILE *out) {
+static void mCc_asm_assembly_from_quad(struct mCc_asm_state *state,
+                                       struct mCc_tac_quad *quad,
+                                       struct mCc_writer *out) {
 
     if (quad->comment) {
-        fprintf(out, "# %s\n", quad->comment);
+        mCc_writer_puts(out, "# ");
+        mCc_writer_puts(out, quad->comment);
+        mCc_writer_putc(out, '\n');
     }
 
-    // fprintf(out, "type: %d\n", quad->type);
+    // mCc_asm_emit_int(out, "type: ", quad->type, "\n");
     switch (quad->type) {
         case MCC_TAC_QUAD_ASSIGN:
-            mCc_asm_print_assign(quad, out);
+            mCc_asm_print_assign(state, quad, out);
             break;
         case MCC_TAC_QUAD_ASSIGN_LIT:
-            mCc_asm_print_assign_lit(quad, out);
+            mCc_asm_print_assign_lit(state, quad, out);
             break;
         case MCC_TAC_QUAD_OP_UNARY:
-            mCc_asm_print_un_op(quad, out);
+            mCc_asm_print_un_op(state, quad, out);
             break;
         case MCC_TAC_QUAD_OP_BINARY:
-            mCc_asm_print_bin_op(quad, out);
+            mCc_asm_print_bin_op(state, quad, out);
             break;
         case MCC_TAC_QUAD_JUMP:
-            fprintf(out, "\tjmp\t.L%d\n", quad->result.label.num);
+            mCc_asm_emit_label(state, out, "\tjmp\t", "L",
+                               quad->result.label.num, "\n");
             break;
         case MCC_TAC_QUAD_JUMPFALSE:
-            mCc_asm_print_jump_false(quad, out);
+            mCc_asm_print_jump_false(state, quad, out);
+            break;
+        case MCC_TAC_QUAD_JUMPTRUE:
+            mCc_asm_print_jump_true(state, quad, out);
             break;
         case MCC_TAC_QUAD_LABEL:
-            mCc_asm_print_label(quad, out);
+            mCc_asm_print_label(state, quad, out);
             break;
         case MCC_TAC_QUAD_PARAM:
-            mCc_asm_print_param(quad, out);
+            mCc_asm_print_param(state, quad, out);
             break;
         case MCC_TAC_QUAD_CALL:
-            mCc_asm_print_call(quad, out);
+            mCc_asm_print_call(state, quad, out);
             break;
         case MCC_TAC_QUAD_LOAD:
-            mCc_asm_handle_load(quad, out);
+            mCc_asm_handle_load(state, quad, out);
             break;
         case MCC_TAC_QUAD_STORE:
-            mCc_asm_handle_store(quad, out);
+            mCc_asm_handle_store(state, quad, out);
             break;
         case MCC_TAC_QUAD_RETURN:
-            mCc_asm_print_return(quad, out);
+            mCc_asm_print_return(state, quad, out);
             break;
         case MCC_TAC_QUAD_RETURN_VOID:
             mCc_asm_print_return_void(out);
             break;
+        case MCC_TAC_QUAD_SELECT:
+            mCc_asm_print_select(state, quad, out);
+            break;
+        case MCC_TAC_QUAD_VECTOR_ZERO:
+        case MCC_TAC_QUAD_VECTOR_SPLAT:
+        case MCC_TAC_QUAD_VECTOR_LOAD:
+        case MCC_TAC_QUAD_VECTOR_OP:
+        case MCC_TAC_QUAD_VECTOR_STORE:
+        case MCC_TAC_QUAD_VECTOR_REDUCE:
+            mCc_asm_print_vector(state, quad, out);
+            break;
     }
 }
 
-static void mCc_asm_print_string_literals(struct mCc_tac_program *prog,
-                                          FILE *out) {
-    for (unsigned int i = 0; i < prog->string_literal_count; ++i) {
-        fprintf(out, "S%d:\n", prog->string_literals[i].str_number);
-        fprintf(out, ".string \"%s\"\n", prog->string_literals[i].str_value);
+/* The strings of the function in [begin, end), which may be used more than
+ * once after loop unrolling */
+static void mCc_asm_print_string_literals(struct mCc_asm_state *state,
+                                          struct mCc_tac_program *prog,
+                                          unsigned int begin, unsigned int end,
+                                          struct mCc_writer *out) {
+    for (unsigned int i = begin; i < end; ++i) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        if (quad->type != MCC_TAC_QUAD_ASSIGN_LIT ||
+            quad->literal->type != MCC_TAC_QUAD_LIT_STR)
+            continue;
+        bool seen = false;
+        for (unsigned int j = begin; j < i && !seen; ++j)
+            seen = prog->quads[j]->type == MCC_TAC_QUAD_ASSIGN_LIT &&
+                   prog->quads[j]->literal->type == MCC_TAC_QUAD_LIT_STR &&
+                   prog->quads[j]->literal->label_num ==
+                           quad->literal->label_num;
+        if (seen)
+            continue;
+        mCc_asm_emit_label(state, out, "", "LS", quad->literal->label_num,
+                           ":\n");
+        mCc_writer_puts(out, ".string \"");
+        mCc_writer_puts(out, quad->literal->strval);
+        mCc_writer_puts(out, "\"\n");
     }
 }
 
-static void mCc_asm_print_fpu(FILE *out) {
-    for (int i = 0; i < current_elements_in_fpu; i++) {
-        fprintf(out, ".LC%d:\n", i);
-        fprintf(out, "\t.float\t%f\n", position_fpu[i].float_lit);
+static void mCc_asm_print_fpu(struct mCc_asm_state *state,
+                              struct mCc_writer *out) {
+    for (int i = 0; i < state->current_elements_in_fpu; i++) {
+        mCc_asm_emit_label(state, out, "", "LC", i, ":\n");
+        mCc_writer_printf(out, "\t.float\t%f\n",
+                          state->position_fpu[i].float_lit);
     }
 }
 
-void mCc_asm_generate_assembly(struct mCc_tac_program *prog, FILE *out,
-                               char *source_filename) {
-    fprintf(out, ".file\t\"%s\"\n", source_filename);
-    fprintf(out, ".text\n");
-    fprintf(out, ".section .rodata\n");
-    mCc_asm_print_string_literals(prog, out);
-    fprintf(out, ".text\n");
-    for (unsigned int i = 0; i < prog->quad_count; ++i) {
-        mCc_asm_assembly_from_quad(prog->quads[i], out);
+/* Forget the stack layout of the previous function */
+static void mCc_asm_reset(struct mCc_asm_state *state) {
+    state->current_elements_in_local_array = 0;
+    state->current_elements_in_param_array = 0;
+    state->current_elements_in_fpu = 0;
+    state->current_frame_pointer = 0;
+    state->current_param_pointer = 4;
+    state->var_count = 0;
+    memset(state->pending_reg_params, 0, sizeof(state->pending_reg_params));
+    state->function = "";
+}
+
+void mCc_asm_write_header(struct mCc_writer *out,
+                          const char *source_filename) {
+    mCc_writer_puts(out, ".file\t\"");
+    mCc_writer_puts(out, source_filename);
+    mCc_writer_puts(out, "\"\n");
+}
+
+void mCc_asm_write_function(struct mCc_context *ctx,
+                            struct mCc_tac_program *prog, unsigned int begin,
+                            unsigned int end, struct mCc_writer *out) {
+    struct mCc_asm_state *state = &ctx->assembly;
+    mCc_asm_reset(state);
+    const struct mCc_tac_quad *label = prog->quads[begin];
+    if (label->type == MCC_TAC_QUAD_LABEL && label->result.label.num < 0)
+        state->function = label->result.label.str;
+
+    mCc_writer_puts(out, ".section .rodata\n");
+    mCc_asm_print_string_literals(state, prog, begin, end, out);
+    mCc_writer_puts(out, ".text\n");
+    for (unsigned int i = begin; i < end; ++i) {
+        mCc_asm_assembly_from_quad(state, prog->quads[i], out);
+    }
+    mCc_asm_print_fpu(state, out);
+    mCc_asm_test_print(state, out);
+}
+
+void mCc_asm_write_assembly(struct mCc_context *ctx,
+                            struct mCc_tac_program *prog,
+                            struct mCc_writer *out, char *source_filename) {
+    mCc_asm_write_header(out, source_filename);
+    unsigned int begin = 0;
+    while (begin < prog->quad_count) {
+        unsigned int end = begin + 1;
+        while (end < prog->quad_count &&
+               !(prog->quads[end]->type == MCC_TAC_QUAD_LABEL &&
+                 prog->quads[end]->result.label.num < 0))
+            ++end;
+        mCc_asm_write_function(ctx, prog, begin, end, out);
+        begin = end;
     }
-    mCc_asm_print_fpu(out);
-    mCc_asm_test_print(out);
+}
+
+void mCc_asm_generate_assembly(struct mCc_context *ctx,
+                               struct mCc_tac_program *prog, FILE *out,
+                               char *source_filename) {
+    struct mCc_writer writer;
+    mCc_writer_init_file(&writer, out);
+    mCc_asm_write_assembly(ctx, prog, &writer, source_filename);
+    mCc_writer_flush(&writer);
 }
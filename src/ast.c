@@ -10,6 +10,76 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "mCc/arena.h"
+
+/* ------------------------------------------------------------------ Memory */
+
+/// Arena for the nodes created by this thread, or NULL
+static _Thread_local struct mCc_arena *current_arena;
+
+/// Interner for the text of the nodes created by this thread, or NULL
+static _Thread_local struct mCc_interner *current_interner;
+
+struct mCc_arena *mCc_ast_use_arena(struct mCc_arena *arena)
+{
+	struct mCc_arena *previous = current_arena;
+	current_arena = arena;
+	return previous;
+}
+
+struct mCc_interner *mCc_ast_use_interner(struct mCc_interner *interner)
+{
+	struct mCc_interner *previous = current_interner;
+	current_interner = interner;
+	return previous;
+}
+
+/* The interned text of a string belonging to a node, NULL if not interned */
+static char *mCc_ast_intern(const struct mCc_ast_node *owner, const char *str,
+                            size_t length, mCc_atom *atom)
+{
+	if (!owner->arena || !current_interner)
+		return NULL;
+	*atom = mCc_interner_intern(current_interner, str, length);
+	return (char *)mCc_interner_str(current_interner, *atom);
+}
+
+void mCc_ast_set_arena_root(struct mCc_ast_node *node)
+{
+	assert(node->arena);
+	node->arena_root = true;
+}
+
+void *mCc_ast_alloc_node(size_t size)
+{
+	struct mCc_ast_node *node = current_arena
+	                                ? mCc_arena_alloc(current_arena, size)
+	                                : malloc(size);
+	if (!node)
+		return NULL;
+
+	memset(node, 0, sizeof(*node));
+	node->arena = current_arena;
+	return node;
+}
+
+void *mCc_ast_realloc(const struct mCc_ast_node *owner, void *ptr,
+                      size_t old_size, size_t new_size)
+{
+	if (owner->arena)
+		return mCc_arena_realloc(owner->arena, ptr, old_size, new_size);
+	return realloc(ptr, new_size);
+}
+
+bool mCc_ast_delete_from_arena(struct mCc_ast_node *node)
+{
+	if (!node->arena)
+		return false;
+	if (node->arena_root)
+		mCc_arena_delete(node->arena);
+	return true;
+}
+
 /* ------------------------------------------------------------- Expressions */
 
 struct mCc_ast_expression *
@@ -17,7 +87,7 @@ mCc_ast_new_expression_literal(struct mCc_ast_literal *literal)
 {
 	assert(literal);
 
-	struct mCc_ast_expression *expr = malloc(sizeof(*expr));
+	struct mCc_ast_expression *expr = mCc_ast_alloc_node(sizeof(*expr));
 	if (!expr) {
 		return NULL;
 	}
@@ -32,7 +102,7 @@ struct mCc_ast_expression *
 mCc_ast_new_expression_identifier(struct mCc_ast_identifier *identifier)
 {
 	assert(identifier);
-	struct mCc_ast_expression *expr = malloc(sizeof(*expr));
+	struct mCc_ast_expression *expr = mCc_ast_alloc_node(sizeof(*expr));
 	if (!expr) {
 		return NULL;
 	}
@@ -49,7 +119,7 @@ mCc_ast_new_expression_unary_op(enum mCc_ast_unary_op op,
 {
 	assert(subexpression);
 
-	struct mCc_ast_expression *expr = malloc(sizeof(*expr));
+	struct mCc_ast_expression *expr = mCc_ast_alloc_node(sizeof(*expr));
 	if (!expr)
 		return NULL;
 
@@ -68,7 +138,7 @@ mCc_ast_new_expression_binary_op(enum mCc_ast_binary_op op,
 	assert(lhs);
 	assert(rhs);
 
-	struct mCc_ast_expression *expr = malloc(sizeof(*expr));
+	struct mCc_ast_expression *expr = mCc_ast_alloc_node(sizeof(*expr));
 	if (!expr) {
 		return NULL;
 	}
@@ -86,7 +156,7 @@ mCc_ast_new_expression_parenth(struct mCc_ast_expression *expression)
 {
 	assert(expression);
 
-	struct mCc_ast_expression *expr = malloc(sizeof(*expr));
+	struct mCc_ast_expression *expr = mCc_ast_alloc_node(sizeof(*expr));
 	if (!expr) {
 		return NULL;
 	}
@@ -103,13 +173,14 @@ mCc_ast_new_expression_call_expr(struct mCc_ast_identifier *identifier,
 {
 	assert(identifier);
 
-	struct mCc_ast_expression *expr = malloc(sizeof(*expr));
+	struct mCc_ast_expression *expr = mCc_ast_alloc_node(sizeof(*expr));
 	if (!expr)
 		return NULL;
 
 	expr->type = MCC_AST_EXPRESSION_TYPE_CALL_EXPR;
 	expr->f_name = identifier;
 	expr->arguments = arguments;
+	expr->callee = NULL;
 	expr->node.computed_type = MCC_AST_TYPE_VOID;
 	return expr;
 }
@@ -121,7 +192,7 @@ mCc_ast_new_expression_arr_subscr(struct mCc_ast_identifier *array_id,
 	assert(array_id);
 	assert(subscript_expr);
 
-	struct mCc_ast_expression *expr = malloc(sizeof(*expr));
+	struct mCc_ast_expression *expr = mCc_ast_alloc_node(sizeof(*expr));
 	if (!expr)
 		return NULL;
 
@@ -135,6 +206,8 @@ mCc_ast_new_expression_arr_subscr(struct mCc_ast_identifier *array_id,
 void mCc_ast_delete_expression(struct mCc_ast_expression *expression)
 {
 	assert(expression);
+	if (mCc_ast_delete_from_arena(&expression->node))
+		return;
 
 	switch (expression->type) {
 	case MCC_AST_EXPRESSION_TYPE_LITERAL:
@@ -175,21 +248,32 @@ void mCc_ast_delete_expression(struct mCc_ast_expression *expression)
 
 struct mCc_ast_identifier *mCc_ast_new_identifier(char *value)
 {
-	struct mCc_ast_identifier *id = malloc(sizeof(*id));
+	struct mCc_ast_identifier *id = mCc_ast_alloc_node(sizeof(*id));
 	if (!id) {
 		return NULL;
 	}
 
-	char *str = malloc((strlen(value) + 1) * sizeof(char));
-	strcpy(str, value);
+	size_t size = strlen(value) + 1;
 	id->symtab_ref = NULL;
-	id->id_value = str;
+	id->atom = MCC_ATOM_NONE;
+	id->slot = MCC_AST_SLOT_NONE;
+	if ((id->id_value = mCc_ast_intern(&id->node, value, size - 1, &id->atom)))
+		return id;
+
+	id->id_value = mCc_ast_realloc(&id->node, NULL, 0, size);
+	if (!id->id_value) {
+		mCc_ast_delete_identifier(id);
+		return NULL;
+	}
+	memcpy(id->id_value, value, size);
 	return id;
 }
 
 void mCc_ast_delete_identifier(struct mCc_ast_identifier *identifier)
 {
 	assert(identifier);
+	if (mCc_ast_delete_from_arena(&identifier->node))
+		return;
 	free(identifier->id_value);
 	free(identifier);
 }
@@ -198,7 +282,7 @@ void mCc_ast_delete_identifier(struct mCc_ast_identifier *identifier)
 
 struct mCc_ast_literal *mCc_ast_new_literal_int(long value)
 {
-	struct mCc_ast_literal *lit = malloc(sizeof(*lit));
+	struct mCc_ast_literal *lit = mCc_ast_alloc_node(sizeof(*lit));
 	if (!lit) {
 		return NULL;
 	}
@@ -210,7 +294,7 @@ struct mCc_ast_literal *mCc_ast_new_literal_int(long value)
 
 struct mCc_ast_literal *mCc_ast_new_literal_float(double value)
 {
-	struct mCc_ast_literal *lit = malloc(sizeof(*lit));
+	struct mCc_ast_literal *lit = mCc_ast_alloc_node(sizeof(*lit));
 	if (!lit) {
 		return NULL;
 	}
@@ -222,21 +306,31 @@ struct mCc_ast_literal *mCc_ast_new_literal_float(double value)
 
 struct mCc_ast_literal *mCc_ast_new_literal_string(char *value)
 {
-	struct mCc_ast_literal *lit = malloc(sizeof(*lit));
+	struct mCc_ast_literal *lit = mCc_ast_alloc_node(sizeof(*lit));
 	if (!lit) {
 		return NULL;
 	}
 
 	lit->type = MCC_AST_LITERAL_TYPE_STRING;
 	// Copy the string, removing the double quotes
-	value[strlen(value) - 1] = '\0';
-	lit->s_value = strdup(value + 1);
+	size_t size = strlen(value) - 1;
+	mCc_atom atom;
+	if ((lit->s_value = mCc_ast_intern(&lit->node, value + 1, size - 1, &atom)))
+		return lit;
+
+	lit->s_value = mCc_ast_realloc(&lit->node, NULL, 0, size);
+	if (!lit->s_value) {
+		mCc_ast_delete_literal(lit);
+		return NULL;
+	}
+	memcpy(lit->s_value, value + 1, size - 1);
+	lit->s_value[size - 1] = '\0';
 	return lit;
 }
 
 struct mCc_ast_literal *mCc_ast_new_literal_bool(bool value)
 {
-	struct mCc_ast_literal *lit = malloc(sizeof(*lit));
+	struct mCc_ast_literal *lit = mCc_ast_alloc_node(sizeof(*lit));
 	if (!lit) {
 		return NULL;
 	}
@@ -249,6 +343,8 @@ struct mCc_ast_literal *mCc_ast_new_literal_bool(bool value)
 void mCc_ast_delete_literal(struct mCc_ast_literal *literal)
 {
 	assert(literal);
+	if (mCc_ast_delete_from_arena(&literal->node))
+		return;
 	if (literal->type == MCC_AST_LITERAL_TYPE_STRING)
 		free(literal->s_value);
 	free(literal);
@@ -264,15 +360,17 @@ mCc_ast_new_arguments(struct mCc_ast_expression *expression)
 {
 	assert(expression);
 
-	struct mCc_ast_arguments *args = malloc(sizeof(*args));
+	struct mCc_ast_arguments *args = mCc_ast_alloc_node(sizeof(*args));
 	if (!args)
 		return NULL;
 
 	args->expression_count = 0;
 	args->expressions = NULL;
 
-	if (expression && (args->expressions = malloc(arguments_alloc_block_size *
-	                                              sizeof(args))) != NULL) {
+	if (expression &&
+	    (args->expressions = mCc_ast_realloc(
+	         &args->node, NULL, 0,
+	         arguments_alloc_block_size * sizeof(args))) != NULL) {
 		args->expression_count = 1;
 		args->arguments_alloc_block_size = arguments_alloc_block_size;
 		args->expressions[0] = expression;
@@ -294,9 +392,11 @@ mCc_ast_arguments_add(struct mCc_ast_arguments *self,
 	}
 
 	struct mCc_ast_expression **tmp;
+	size_t old_size = self->arguments_alloc_block_size * sizeof(*tmp);
 	self->arguments_alloc_block_size += arguments_alloc_block_size;
-	if ((tmp = realloc(self->expressions, self->arguments_alloc_block_size *
-	                                          sizeof(*tmp))) == NULL) {
+	if ((tmp = mCc_ast_realloc(&self->node, self->expressions, old_size,
+	                           self->arguments_alloc_block_size *
+	                               sizeof(*tmp))) == NULL) {
 		mCc_ast_delete_arguments(self);
 		return NULL;
 	}
@@ -308,7 +408,7 @@ mCc_ast_arguments_add(struct mCc_ast_arguments *self,
 
 void mCc_ast_delete_arguments(struct mCc_ast_arguments *arguments)
 {
-	if (arguments) {
+	if (arguments && !mCc_ast_delete_from_arena(&arguments->node)) {
 
 		for (unsigned int i = 0; i < arguments->expression_count; ++i)
 			mCc_ast_delete_expression(arguments->expressions[i]);
@@ -329,15 +429,16 @@ mCc_ast_new_parameters(struct mCc_ast_declaration *decl)
 {
 	assert(decl);
 
-	struct mCc_ast_parameters *args = malloc(sizeof(*args));
+	struct mCc_ast_parameters *args = mCc_ast_alloc_node(sizeof(*args));
 	if (!args)
 		return NULL;
 
 	args->decl_count = 0;
 	args->decl = NULL;
 
-	if (decl && (args->decl = malloc(parameter_alloc_block_size *
-	                                 sizeof(args))) != NULL) {
+	if (decl && (args->decl = mCc_ast_realloc(
+	                 &args->node, NULL, 0,
+	                 parameter_alloc_block_size * sizeof(args))) != NULL) {
 		args->decl_count = 1;
 		args->parameter_alloc_block_size = parameter_alloc_block_size;
 		args->decl[0] = decl;
@@ -359,9 +460,11 @@ mCc_ast_parameters_add(struct mCc_ast_parameters *self,
 	}
 
 	struct mCc_ast_declaration **tmp;
+	size_t old_size = self->parameter_alloc_block_size * sizeof(*tmp);
 	self->parameter_alloc_block_size += parameter_alloc_block_size;
-	if ((tmp = realloc(self->decl, self->parameter_alloc_block_size *
-	                                   sizeof(self))) == NULL) {
+	if ((tmp = mCc_ast_realloc(&self->node, self->decl, old_size,
+	                           self->parameter_alloc_block_size *
+	                               sizeof(*tmp))) == NULL) {
 		mCc_ast_delete_parameters(self);
 		return NULL;
 	}
@@ -373,7 +476,7 @@ mCc_ast_parameters_add(struct mCc_ast_parameters *self,
 
 void mCc_ast_delete_parameters(struct mCc_ast_parameters *parameter)
 {
-	if (parameter) {
+	if (parameter && !mCc_ast_delete_from_arena(&parameter->node)) {
 
 		for (unsigned int i = 0; i < parameter->decl_count; ++i)
 			mCc_ast_delete_declaration(parameter->decl[i]);
@@ -391,15 +494,19 @@ const unsigned int program_alloc_block_size = 10;
 struct mCc_ast_program *
 mCc_ast_new_program(struct mCc_ast_function_def *func_def)
 {
-	struct mCc_ast_program *program = malloc(sizeof(*program));
+	struct mCc_ast_program *program = mCc_ast_alloc_node(sizeof(*program));
 	if (!program)
 		return NULL;
 
 	program->func_def_count = 0;
 	program->func_defs = NULL;
+	program->interner = program->node.arena ? current_interner : NULL;
+	program->source = NULL;
 
-	if (func_def && (program->func_defs = malloc(parameter_alloc_block_size *
-	                                             sizeof(program))) != NULL) {
+	if (func_def &&
+	    (program->func_defs = mCc_ast_realloc(
+	         &program->node, NULL, 0,
+	         parameter_alloc_block_size * sizeof(program))) != NULL) {
 		program->func_def_count = 1;
 		program->func_def_alloc_size = parameter_alloc_block_size;
 		program->func_defs[0] = func_def;
@@ -421,9 +528,11 @@ mCc_ast_program_add(struct mCc_ast_program *self,
 	}
 
 	struct mCc_ast_function_def **tmp;
+	size_t old_size = self->func_def_alloc_size * sizeof(*tmp);
 	self->func_def_alloc_size += program_alloc_block_size;
-	if ((tmp = realloc(self->func_defs,
-	                   self->func_def_alloc_size * sizeof(self))) == NULL) {
+	if ((tmp = mCc_ast_realloc(&self->node, self->func_defs, old_size,
+	                           self->func_def_alloc_size * sizeof(*tmp))) ==
+	    NULL) {
 		mCc_ast_delete_program(self);
 		return NULL;
 	}
@@ -435,7 +544,7 @@ mCc_ast_program_add(struct mCc_ast_program *self,
 
 void mCc_ast_delete_program(struct mCc_ast_program *self)
 {
-	if (self) {
+	if (self && !mCc_ast_delete_from_arena(&self->node)) {
 
 		for (unsigned int i = 0; i < self->func_def_count; ++i)
 			mCc_ast_delete_func_def(self->func_defs[i]);
@@ -0,0 +1,756 @@
+/**
+ * @file ast_compact.c
+ * @brief Compact AST kept in contiguous arrays.
+ * @author richard
+ * @date 2018-07-06
+ */
+#include "mCc/ast_compact.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mCc/arena.h"
+
+static const uint32_t none = MCC_AST_COMPACT_NONE;
+
+/* Append n uninitialised elements to an array, returning the first index */
+static uint32_t mCc_ast_compact_reserve(void **data, uint32_t *count,
+                                        uint32_t *capacity, size_t size,
+                                        uint32_t n) {
+    if (*count > UINT32_MAX - 1 - n)
+        return none;
+    if (*count + n > *capacity) {
+        uint32_t new_capacity = *capacity ? *capacity : 64;
+        while (*count + n > new_capacity)
+            new_capacity *= 2;
+        void *new_data = realloc(*data, new_capacity * size);
+        if (!new_data)
+            return none;
+        *data = new_data;
+        *capacity = new_capacity;
+    }
+    uint32_t first = *count;
+    *count += n;
+    return first;
+}
+
+#define mCc_ast_compact_append(compact, array, n)                              \
+    mCc_ast_compact_reserve((void **)&(compact)->array.data,                   \
+                            &(compact)->array.count,                           \
+                            &(compact)->array.capacity,                        \
+                            sizeof(*(compact)->array.data), (n))
+
+void mCc_ast_compact_free(struct mCc_ast_compact *compact) {
+    free(compact->expressions.data);
+    free(compact->statements.data);
+    free(compact->literals.data);
+    free(compact->identifiers.data);
+    free(compact->declarations.data);
+    free(compact->functions.data);
+    free(compact->lists.data);
+    free(compact->chars.data);
+    free(compact->line_starts.data);
+    free(compact->functions_by_name.data);
+    memset(compact, 0, sizeof(*compact));
+}
+
+const char *mCc_ast_compact_name(const struct mCc_ast_compact *compact,
+                                 uint32_t identifier) {
+    return compact->chars.data + compact->identifiers.data[identifier].name;
+}
+
+/*********************************** Building */
+
+/// Bails out of a builder function if an index is missing
+#define check(index)                                                           \
+    do {                                                                       \
+        if ((index) == none)                                                   \
+            return none;                                                       \
+    } while (0)
+
+static uint32_t mCc_ast_compact_loc(const struct mCc_ast_node *node) {
+    return node->sloc.start_offset;
+}
+
+static uint32_t mCc_ast_compact_chars(struct mCc_ast_compact *compact,
+                                      const char *str) {
+    size_t size = strlen(str) + 1;
+    if (size > UINT32_MAX)
+        return none;
+    uint32_t offset = mCc_ast_compact_append(compact, chars, size);
+    check(offset);
+    memcpy(compact->chars.data + offset, str, size);
+    return offset;
+}
+
+/* Reserve a list of count elements, which the caller fills in */
+static uint32_t mCc_ast_compact_new_list(struct mCc_ast_compact *compact,
+                                         uint32_t count) {
+    uint32_t list = mCc_ast_compact_append(compact, lists, count + 1);
+    check(list);
+    compact->lists.data[list] = count;
+    return list;
+}
+
+static uint32_t
+mCc_ast_compact_identifier(struct mCc_ast_compact *compact,
+                           const struct mCc_ast_identifier *id) {
+    uint32_t name = mCc_ast_compact_chars(compact, id->id_value);
+    check(name);
+    uint32_t i = mCc_ast_compact_append(compact, identifiers, 1);
+    check(i);
+    compact->identifiers.data[i] = (struct mCc_ast_compact_identifier){
+        .loc = mCc_ast_compact_loc(&id->node),
+        .name = name,
+    };
+    return i;
+}
+
+static uint32_t mCc_ast_compact_literal(struct mCc_ast_compact *compact,
+                                        const struct mCc_ast_literal *lit) {
+    struct mCc_ast_compact_literal l = {
+        .type = lit->type,
+        .loc = mCc_ast_compact_loc(&lit->node),
+    };
+    switch (lit->type) {
+        case MCC_AST_LITERAL_TYPE_INT: l.i_value = lit->i_value; break;
+        case MCC_AST_LITERAL_TYPE_FLOAT: l.f_value = lit->f_value; break;
+        case MCC_AST_LITERAL_TYPE_BOOL: l.b_value = lit->b_value; break;
+        case MCC_AST_LITERAL_TYPE_STRING:
+            l.s_value = mCc_ast_compact_chars(compact, lit->s_value);
+            check(l.s_value);
+            break;
+    }
+    uint32_t i = mCc_ast_compact_append(compact, literals, 1);
+    check(i);
+    compact->literals.data[i] = l;
+    return i;
+}
+
+static uint32_t
+mCc_ast_compact_expression(struct mCc_ast_compact *compact,
+                           const struct mCc_ast_expression *expr) {
+    // Taken first, so the first sub-expression is the next one
+    uint32_t i = mCc_ast_compact_append(compact, expressions, 1);
+    check(i);
+    struct mCc_ast_compact_expression e = {
+        .type = expr->type,
+        .computed_type = expr->node.computed_type,
+        .loc = mCc_ast_compact_loc(&expr->node),
+        .a = none,
+        .b = none,
+    };
+
+    switch (expr->type) {
+        case MCC_AST_EXPRESSION_TYPE_LITERAL:
+            e.a = mCc_ast_compact_literal(compact, expr->literal);
+            check(e.a);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_IDENTIFIER:
+            e.a = mCc_ast_compact_identifier(compact, expr->identifier);
+            check(e.a);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_UNARY_OP:
+            e.op = expr->unary_op;
+            check(mCc_ast_compact_expression(compact, expr->unary_expression));
+            break;
+        case MCC_AST_EXPRESSION_TYPE_BINARY_OP:
+            e.op = expr->op;
+            check(mCc_ast_compact_expression(compact, expr->lhs));
+            e.b = mCc_ast_compact_expression(compact, expr->rhs);
+            check(e.b);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_PARENTH:
+            check(mCc_ast_compact_expression(compact, expr->expression));
+            break;
+        case MCC_AST_EXPRESSION_TYPE_CALL_EXPR:
+            e.a = mCc_ast_compact_identifier(compact, expr->f_name);
+            check(e.a);
+            if (expr->arguments) {
+                const struct mCc_ast_arguments *args = expr->arguments;
+                e.b = mCc_ast_compact_new_list(compact, args->expression_count);
+                check(e.b);
+                for (unsigned int j = 0; j < args->expression_count; ++j) {
+                    uint32_t arg = mCc_ast_compact_expression(
+                            compact, args->expressions[j]);
+                    check(arg);
+                    compact->lists.data[e.b + 1 + j] = arg;
+                }
+            }
+            break;
+        case MCC_AST_EXPRESSION_TYPE_ARR_SUBSCR:
+            e.a = mCc_ast_compact_identifier(compact, expr->array_id);
+            check(e.a);
+            check(mCc_ast_compact_expression(compact, expr->subscript_expr));
+            break;
+    }
+    compact->expressions.data[i] = e;
+    return i;
+}
+
+static uint32_t
+mCc_ast_compact_declaration(struct mCc_ast_compact *compact,
+                            const struct mCc_ast_declaration *decl) {
+    struct mCc_ast_compact_declaration d = {
+        .type = decl->decl_type,
+        .loc = mCc_ast_compact_loc(&decl->node),
+        .identifier = mCc_ast_compact_identifier(compact, decl->decl_id),
+        .array_size = none,
+    };
+    check(d.identifier);
+    if (decl->decl_array_size) {
+        d.array_size = mCc_ast_compact_literal(compact, decl->decl_array_size);
+        check(d.array_size);
+    }
+    uint32_t i = mCc_ast_compact_append(compact, declarations, 1);
+    check(i);
+    compact->declarations.data[i] = d;
+    return i;
+}
+
+static uint32_t
+mCc_ast_compact_statement(struct mCc_ast_compact *compact,
+                          const struct mCc_ast_statement *stmt) {
+    // Taken first, so the body of an if or while is the next statement
+    uint32_t i = mCc_ast_compact_append(compact, statements, 1);
+    check(i);
+    struct mCc_ast_compact_statement s = {
+        .type = stmt->type,
+        .computed_type = stmt->node.computed_type,
+        .loc = mCc_ast_compact_loc(&stmt->node),
+        .a = none,
+        .b = none,
+        .c = none,
+    };
+
+    switch (stmt->type) {
+        case MCC_AST_STATEMENT_TYPE_EXPR:
+            s.a = mCc_ast_compact_expression(compact, stmt->expression);
+            check(s.a);
+            break;
+        case MCC_AST_STATEMENT_TYPE_IF:
+        case MCC_AST_STATEMENT_TYPE_IFELSE:
+            s.a = mCc_ast_compact_expression(compact, stmt->if_cond);
+            check(s.a);
+            check(mCc_ast_compact_statement(compact, stmt->if_stmt));
+            if (stmt->type == MCC_AST_STATEMENT_TYPE_IFELSE) {
+                s.b = mCc_ast_compact_statement(compact, stmt->else_stmt);
+                check(s.b);
+            }
+            break;
+        case MCC_AST_STATEMENT_TYPE_WHILE:
+            s.a = mCc_ast_compact_expression(compact, stmt->while_cond);
+            check(s.a);
+            check(mCc_ast_compact_statement(compact, stmt->while_stmt));
+            break;
+        case MCC_AST_STATEMENT_TYPE_RET:
+            s.a = mCc_ast_compact_expression(compact, stmt->ret_val);
+            check(s.a);
+            break;
+        case MCC_AST_STATEMENT_TYPE_RET_VOID: break;
+        case MCC_AST_STATEMENT_TYPE_ASSGN:
+            s.a = mCc_ast_compact_identifier(compact, stmt->id_assgn);
+            check(s.a);
+            if (stmt->lhs_assgn) {
+                s.b = mCc_ast_compact_expression(compact, stmt->lhs_assgn);
+                check(s.b);
+            }
+            s.c = mCc_ast_compact_expression(compact, stmt->rhs_assgn);
+            check(s.c);
+            break;
+        case MCC_AST_STATEMENT_TYPE_DECL:
+            s.a = mCc_ast_compact_declaration(compact, stmt->declaration);
+            check(s.a);
+            break;
+        case MCC_AST_STATEMENT_TYPE_CMPND:
+            s.a = mCc_ast_compact_new_list(compact, stmt->compound_stmt_count);
+            check(s.a);
+            for (unsigned int j = 0; j < stmt->compound_stmt_count; ++j) {
+                uint32_t sub = mCc_ast_compact_statement(
+                        compact, stmt->compound_stmts[j]);
+                check(sub);
+                compact->lists.data[s.a + 1 + j] = sub;
+            }
+            break;
+    }
+    compact->statements.data[i] = s;
+    return i;
+}
+
+static uint32_t
+mCc_ast_compact_function(struct mCc_ast_compact *compact,
+                         const struct mCc_ast_function_def *fun_def) {
+    struct mCc_ast_compact_function f = {
+        .type = fun_def->func_type,
+        .loc = mCc_ast_compact_loc(&fun_def->node),
+        .identifier = mCc_ast_compact_identifier(compact, fun_def->identifier),
+        .parameters = none,
+        .body = none,
+        .first_expression = compact->expressions.count,
+        .first_statement = compact->statements.count,
+    };
+    check(f.identifier);
+    if (fun_def->para) {
+        const struct mCc_ast_parameters *para = fun_def->para;
+        f.parameters = mCc_ast_compact_new_list(compact, para->decl_count);
+        check(f.parameters);
+        for (unsigned int j = 0; j < para->decl_count; ++j) {
+            uint32_t decl = mCc_ast_compact_declaration(compact, para->decl[j]);
+            check(decl);
+            compact->lists.data[f.parameters + 1 + j] = decl;
+        }
+    }
+    if (fun_def->body) {
+        f.body = mCc_ast_compact_statement(compact, fun_def->body);
+        check(f.body);
+    }
+    uint32_t i = mCc_ast_compact_append(compact, functions, 1);
+    check(i);
+    compact->functions.data[i] = f;
+    return i;
+}
+
+/// A function and its name while sorting
+struct mCc_ast_compact_named {
+    const char *name;
+    uint32_t function;
+};
+
+static int mCc_ast_compact_compare_named(const void *a, const void *b) {
+    return strcmp(((const struct mCc_ast_compact_named *)a)->name,
+                  ((const struct mCc_ast_compact_named *)b)->name);
+}
+
+/* Fill in the functions sorted by name, 0 on success */
+static int mCc_ast_compact_sort_functions(struct mCc_ast_compact *compact) {
+    uint32_t count = compact->functions.count;
+    if (!count)
+        return 0;
+    struct mCc_ast_compact_named *named = malloc(count * sizeof(*named));
+    if (!named ||
+        mCc_ast_compact_append(compact, functions_by_name, count) == none) {
+        free(named);
+        return 1;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        named[i].name = mCc_ast_compact_name(
+                compact, compact->functions.data[i].identifier);
+        named[i].function = i;
+    }
+    qsort(named, count, sizeof(*named), mCc_ast_compact_compare_named);
+    for (uint32_t i = 0; i < count; ++i)
+        compact->functions_by_name.data[i] = named[i].function;
+    free(named);
+    return 0;
+}
+
+int mCc_ast_compact_build(struct mCc_ast_compact *compact,
+                          const struct mCc_ast_program *prog,
+                          const char *source, size_t size) {
+    memset(compact, 0, sizeof(*compact));
+    if (size > UINT32_MAX)
+        return 1;
+
+    if (mCc_ast_compact_append(compact, line_starts, 1) == none)
+        return 1;
+    compact->line_starts.data[0] = 0;
+    for (const char *nl = memchr(source, '\n', size); nl;
+         nl = memchr(nl + 1, '\n', size - (nl + 1 - source))) {
+        uint32_t line = mCc_ast_compact_append(compact, line_starts, 1);
+        if (line == none)
+            return 1;
+        compact->line_starts.data[line] = nl + 1 - source;
+    }
+
+    for (unsigned int i = 0; i < prog->func_def_count; ++i) {
+        if (mCc_ast_compact_function(compact, prog->func_defs[i]) == none)
+            return 1;
+    }
+    return mCc_ast_compact_sort_functions(compact);
+}
+
+#undef check
+
+/*********************************** Queries */
+
+struct mCc_ast_source_location
+mCc_ast_compact_location(const struct mCc_ast_compact *compact,
+                         uint32_t offset) {
+    // The last line starting at or before the offset
+    uint32_t low = 0, high = compact->line_starts.count;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (compact->line_starts.data[mid] <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+    int line = low + 1;
+    int col = offset - (high ? compact->line_starts.data[low] : 0) + 1;
+    return (struct mCc_ast_source_location){
+        .start_line = line,
+        .start_col = col,
+        .end_line = line,
+        .end_col = col,
+    };
+}
+
+uint32_t mCc_ast_compact_find_function(const struct mCc_ast_compact *compact,
+                                       const char *name) {
+    uint32_t low = 0, high = compact->functions_by_name.count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        uint32_t function = compact->functions_by_name.data[mid];
+        int cmp = strcmp(name,
+                         mCc_ast_compact_name(
+                                 compact,
+                                 compact->functions.data[function].identifier));
+        if (!cmp)
+            return function;
+        if (cmp < 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return none;
+}
+
+const uint32_t *mCc_ast_compact_list(const struct mCc_ast_compact *compact,
+                                     uint32_t list, uint32_t *count) {
+    if (list == none) {
+        *count = 0;
+        return NULL;
+    }
+    *count = compact->lists.data[list];
+    return compact->lists.data + list + 1;
+}
+
+/*********************************** Expansion */
+
+/// Bails out of an expansion function if a node is missing
+#define check(node)                                                            \
+    do {                                                                       \
+        if (!(node))                                                           \
+            return NULL;                                                       \
+    } while (0)
+
+static void mCc_ast_compact_set_loc(const struct mCc_ast_compact *compact,
+                                    struct mCc_ast_node *node,
+                                    uint32_t offset) {
+    node->sloc = mCc_ast_compact_location(compact, offset);
+    node->sloc.start_offset = offset;
+    node->sloc.end_offset = offset;
+}
+
+static struct mCc_ast_identifier *
+mCc_ast_compact_expand_identifier(const struct mCc_ast_compact *compact,
+                                  uint32_t i) {
+    const struct mCc_ast_compact_identifier *id = &compact->identifiers.data[i];
+    struct mCc_ast_identifier *result =
+            mCc_ast_new_identifier(compact->chars.data + id->name);
+    check(result);
+    mCc_ast_compact_set_loc(compact, &result->node, id->loc);
+    return result;
+}
+
+static struct mCc_ast_literal *
+mCc_ast_compact_expand_literal(const struct mCc_ast_compact *compact,
+                               struct mCc_arena *arena, uint32_t i) {
+    const struct mCc_ast_compact_literal *lit = &compact->literals.data[i];
+    struct mCc_ast_literal *result = NULL;
+    switch (lit->type) {
+        case MCC_AST_LITERAL_TYPE_INT:
+            result = mCc_ast_new_literal_int(lit->i_value);
+            break;
+        case MCC_AST_LITERAL_TYPE_FLOAT:
+            result = mCc_ast_new_literal_float(lit->f_value);
+            break;
+        case MCC_AST_LITERAL_TYPE_BOOL:
+            result = mCc_ast_new_literal_bool(lit->b_value);
+            break;
+        case MCC_AST_LITERAL_TYPE_STRING: {
+            // The constructor takes the literal as scanned, in quotes
+            const char *str = compact->chars.data + lit->s_value;
+            size_t len = strlen(str);
+            char *quoted = mCc_arena_alloc(arena, len + 3);
+            check(quoted);
+            quoted[0] = '"';
+            memcpy(quoted + 1, str, len);
+            quoted[len + 1] = '"';
+            quoted[len + 2] = '\0';
+            result = mCc_ast_new_literal_string(quoted);
+            break;
+        }
+    }
+    check(result);
+    mCc_ast_compact_set_loc(compact, &result->node, lit->loc);
+    return result;
+}
+
+static struct mCc_ast_expression *
+mCc_ast_compact_expand_expression(const struct mCc_ast_compact *compact,
+                                  struct mCc_arena *arena, uint32_t i) {
+    const struct mCc_ast_compact_expression *e = &compact->expressions.data[i];
+    struct mCc_ast_expression *result = NULL;
+    struct mCc_ast_expression *first = NULL;
+    struct mCc_ast_identifier *id = NULL;
+
+    switch ((enum mCc_ast_expression_type)e->type) {
+        case MCC_AST_EXPRESSION_TYPE_LITERAL: {
+            struct mCc_ast_literal *lit =
+                    mCc_ast_compact_expand_literal(compact, arena, e->a);
+            check(lit);
+            result = mCc_ast_new_expression_literal(lit);
+            break;
+        }
+        case MCC_AST_EXPRESSION_TYPE_IDENTIFIER:
+            id = mCc_ast_compact_expand_identifier(compact, e->a);
+            check(id);
+            result = mCc_ast_new_expression_identifier(id);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_UNARY_OP:
+            first = mCc_ast_compact_expand_expression(compact, arena, i + 1);
+            check(first);
+            result = mCc_ast_new_expression_unary_op(e->op, first);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_BINARY_OP: {
+            first = mCc_ast_compact_expand_expression(compact, arena, i + 1);
+            check(first);
+            struct mCc_ast_expression *rhs =
+                    mCc_ast_compact_expand_expression(compact, arena, e->b);
+            check(rhs);
+            result = mCc_ast_new_expression_binary_op(e->op, first, rhs);
+            break;
+        }
+        case MCC_AST_EXPRESSION_TYPE_PARENTH:
+            first = mCc_ast_compact_expand_expression(compact, arena, i + 1);
+            check(first);
+            result = mCc_ast_new_expression_parenth(first);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_CALL_EXPR: {
+            id = mCc_ast_compact_expand_identifier(compact, e->a);
+            check(id);
+            uint32_t count;
+            const uint32_t *args = mCc_ast_compact_list(compact, e->b, &count);
+            struct mCc_ast_arguments *arguments = NULL;
+            for (uint32_t j = 0; j < count; ++j) {
+                struct mCc_ast_expression *arg =
+                        mCc_ast_compact_expand_expression(compact, arena,
+                                                          args[j]);
+                check(arg);
+                arguments = arguments ? mCc_ast_arguments_add(arguments, arg)
+                                      : mCc_ast_new_arguments(arg);
+                check(arguments);
+            }
+            result = mCc_ast_new_expression_call_expr(id, arguments);
+            break;
+        }
+        case MCC_AST_EXPRESSION_TYPE_ARR_SUBSCR:
+            id = mCc_ast_compact_expand_identifier(compact, e->a);
+            check(id);
+            first = mCc_ast_compact_expand_expression(compact, arena, i + 1);
+            check(first);
+            result = mCc_ast_new_expression_arr_subscr(id, first);
+            break;
+    }
+    check(result);
+    result->node.computed_type = e->computed_type;
+    mCc_ast_compact_set_loc(compact, &result->node, e->loc);
+    return result;
+}
+
+static struct mCc_ast_declaration *
+mCc_ast_compact_expand_declaration(const struct mCc_ast_compact *compact,
+                                   struct mCc_arena *arena, uint32_t i) {
+    const struct mCc_ast_compact_declaration *d =
+            &compact->declarations.data[i];
+    struct mCc_ast_identifier *id =
+            mCc_ast_compact_expand_identifier(compact, d->identifier);
+    check(id);
+    struct mCc_ast_literal *size = NULL;
+    if (d->array_size != none) {
+        size = mCc_ast_compact_expand_literal(compact, arena, d->array_size);
+        check(size);
+    }
+    struct mCc_ast_declaration *result =
+            mCc_ast_new_declaration(d->type, size, id);
+    check(result);
+    mCc_ast_compact_set_loc(compact, &result->node, d->loc);
+    return result;
+}
+
+static struct mCc_ast_statement *
+mCc_ast_compact_expand_statement(const struct mCc_ast_compact *compact,
+                                 struct mCc_arena *arena, uint32_t i) {
+    const struct mCc_ast_compact_statement *s = &compact->statements.data[i];
+    struct mCc_ast_statement *result = NULL;
+
+    switch ((enum mCc_ast_statement_type)s->type) {
+        case MCC_AST_STATEMENT_TYPE_EXPR: {
+            struct mCc_ast_expression *expr =
+                    mCc_ast_compact_expand_expression(compact, arena, s->a);
+            check(expr);
+            result = mCc_ast_new_statement_expression(expr);
+            break;
+        }
+        case MCC_AST_STATEMENT_TYPE_IF:
+        case MCC_AST_STATEMENT_TYPE_IFELSE: {
+            struct mCc_ast_expression *cond =
+                    mCc_ast_compact_expand_expression(compact, arena, s->a);
+            check(cond);
+            struct mCc_ast_statement *then =
+                    mCc_ast_compact_expand_statement(compact, arena, i + 1);
+            check(then);
+            struct mCc_ast_statement *otherwise = NULL;
+            if (s->b != none) {
+                otherwise = mCc_ast_compact_expand_statement(compact, arena,
+                                                             s->b);
+                check(otherwise);
+            }
+            result = mCc_ast_new_statement_if(cond, then, otherwise);
+            break;
+        }
+        case MCC_AST_STATEMENT_TYPE_WHILE: {
+            struct mCc_ast_expression *cond =
+                    mCc_ast_compact_expand_expression(compact, arena, s->a);
+            check(cond);
+            struct mCc_ast_statement *body =
+                    mCc_ast_compact_expand_statement(compact, arena, i + 1);
+            check(body);
+            result = mCc_ast_new_statement_while(cond, body);
+            break;
+        }
+        case MCC_AST_STATEMENT_TYPE_RET: {
+            struct mCc_ast_expression *val =
+                    mCc_ast_compact_expand_expression(compact, arena, s->a);
+            check(val);
+            result = mCc_ast_new_statement_return(val);
+            break;
+        }
+        case MCC_AST_STATEMENT_TYPE_RET_VOID:
+            result = mCc_ast_new_statement_return(NULL);
+            break;
+        case MCC_AST_STATEMENT_TYPE_ASSGN: {
+            struct mCc_ast_identifier *id =
+                    mCc_ast_compact_expand_identifier(compact, s->a);
+            check(id);
+            struct mCc_ast_expression *lhs = NULL;
+            if (s->b != none) {
+                lhs = mCc_ast_compact_expand_expression(compact, arena, s->b);
+                check(lhs);
+            }
+            struct mCc_ast_expression *rhs =
+                    mCc_ast_compact_expand_expression(compact, arena, s->c);
+            check(rhs);
+            result = mCc_ast_new_statement_assgn(id, lhs, rhs);
+            break;
+        }
+        case MCC_AST_STATEMENT_TYPE_DECL: {
+            struct mCc_ast_declaration *decl =
+                    mCc_ast_compact_expand_declaration(compact, arena, s->a);
+            check(decl);
+            result = mCc_ast_new_statement_declaration(decl);
+            break;
+        }
+        case MCC_AST_STATEMENT_TYPE_CMPND: {
+            uint32_t count;
+            const uint32_t *subs = mCc_ast_compact_list(compact, s->a, &count);
+            for (uint32_t j = 0; j < count; ++j) {
+                struct mCc_ast_statement *sub =
+                        mCc_ast_compact_expand_statement(compact, arena,
+                                                         subs[j]);
+                check(sub);
+                result = result ? mCc_ast_compound_statement_add(result, sub)
+                                : mCc_ast_new_statement_compound(sub);
+                check(result);
+            }
+            if (!result)
+                result = mCc_ast_new_statement_compound(NULL);
+            break;
+        }
+    }
+    check(result);
+    result->node.computed_type = s->computed_type;
+    mCc_ast_compact_set_loc(compact, &result->node, s->loc);
+    return result;
+}
+
+static struct mCc_ast_function_def *
+mCc_ast_compact_expand_function(const struct mCc_ast_compact *compact,
+                                struct mCc_arena *arena, uint32_t i) {
+    const struct mCc_ast_compact_function *f = &compact->functions.data[i];
+    struct mCc_ast_identifier *id =
+            mCc_ast_compact_expand_identifier(compact, f->identifier);
+    check(id);
+
+    uint32_t count;
+    const uint32_t *decls = mCc_ast_compact_list(compact, f->parameters, &count);
+    struct mCc_ast_parameters *para = NULL;
+    for (uint32_t j = 0; j < count; ++j) {
+        struct mCc_ast_declaration *decl =
+                mCc_ast_compact_expand_declaration(compact, arena, decls[j]);
+        check(decl);
+        para = para ? mCc_ast_parameters_add(para, decl)
+                    : mCc_ast_new_parameters(decl);
+        check(para);
+    }
+
+    struct mCc_ast_statement *body = NULL;
+    if (f->body != none) {
+        body = mCc_ast_compact_expand_statement(compact, arena, f->body);
+        check(body);
+    }
+
+    struct mCc_ast_function_def *result =
+            f->type == MCC_AST_TYPE_VOID
+                    ? mCc_ast_new_function_def_void(id, para, body)
+                    : mCc_ast_new_function_def_type(f->type, id, para, body);
+    check(result);
+    mCc_ast_compact_set_loc(compact, &result->node, f->loc);
+    return result;
+}
+
+static struct mCc_ast_program *
+mCc_ast_compact_expand_program(const struct mCc_ast_compact *compact,
+                               struct mCc_arena *arena) {
+    struct mCc_ast_program *prog = NULL;
+    for (uint32_t i = 0; i < compact->functions.count; ++i) {
+        struct mCc_ast_function_def *fun_def =
+                mCc_ast_compact_expand_function(compact, arena, i);
+        check(fun_def);
+        prog = prog ? mCc_ast_program_add(prog, fun_def)
+                    : mCc_ast_new_program(fun_def);
+        check(prog);
+    }
+    return prog ? prog : mCc_ast_new_program(NULL);
+}
+
+#undef check
+
+struct mCc_ast_program *
+mCc_ast_compact_expand(const struct mCc_ast_compact *compact) {
+    struct mCc_arena *arena = mCc_arena_new();
+    if (!arena)
+        return NULL;
+    struct mCc_arena *previous = mCc_ast_use_arena(arena);
+    struct mCc_ast_program *prog =
+            mCc_ast_compact_expand_program(compact, arena);
+    mCc_ast_use_arena(previous);
+
+    if (!prog) {
+        mCc_arena_delete(arena);
+        return NULL;
+    }
+    mCc_ast_set_arena_root(&prog->node);
+    return prog;
+}
+
+int mCc_ast_compact_visit(const struct mCc_ast_compact *compact,
+                          struct mCc_ast_visitor *visitor) {
+    struct mCc_ast_program *prog = mCc_ast_compact_expand(compact);
+    if (!prog)
+        return 1;
+    mCc_ast_visit_program(prog, visitor);
+    mCc_ast_delete_program(prog);
+    return 0;
+}
@@ -9,6 +9,7 @@
 #include <assert.h>
 
 #include "mCc/ast_visit.h"
+#include "mCc/writer.h"
 
 #define LABEL_SIZE 64
 
@@ -56,36 +57,48 @@ const char *mCc_ast_print_binary_op(enum mCc_ast_binary_op op) {
 
 /* ------------------------------------------------------------- DOT Printer */
 
-static void print_dot_begin(FILE *out) {
-    assert(out);
+static void print_dot_begin(struct mCc_writer *out, FILE *file) {
+    assert(file);
 
-    fprintf(out, "digraph \"AST\" {\n");
-    fprintf(out, "\tnodesep=0.6\n");
+    mCc_writer_init_file(out, file);
+    mCc_writer_puts(out, "digraph \"AST\" {\n");
+    mCc_writer_puts(out, "\tnodesep=0.6\n");
 }
 
-static void print_dot_end(FILE *out) {
+static void print_dot_end(struct mCc_writer *out) {
     assert(out);
 
-    fprintf(out, "}\n");
+    mCc_writer_puts(out, "}\n");
+    mCc_writer_flush(out);
 }
 
-static void print_dot_node(FILE *out, const void *node, const char *label) {
+static void print_dot_node(struct mCc_writer *out, const void *node,
+                           const char *label) {
     assert(out);
     assert(node);
     assert(label);
 
-    fprintf(out, "\t\"%p\" [shape=box, label=\"%s\"];\n", node, label);
+    mCc_writer_puts(out, "\t\"");
+    mCc_writer_ptr(out, node);
+    mCc_writer_puts(out, "\" [shape=box, label=\"");
+    mCc_writer_puts(out, label);
+    mCc_writer_puts(out, "\"];\n");
 }
 
-static void print_dot_edge(FILE *out, const void *src_node,
+static void print_dot_edge(struct mCc_writer *out, const void *src_node,
                            const void *dst_node, const char *label) {
     assert(out);
     assert(src_node);
     assert(dst_node);
     assert(label);
 
-    fprintf(out, "\t\"%p\" -> \"%p\" [label=\"%s\"];\n", src_node, dst_node,
-            label);
+    mCc_writer_puts(out, "\t\"");
+    mCc_writer_ptr(out, src_node);
+    mCc_writer_puts(out, "\" -> \"");
+    mCc_writer_ptr(out, dst_node);
+    mCc_writer_puts(out, "\" [label=\"");
+    mCc_writer_puts(out, label);
+    mCc_writer_puts(out, "\"];\n");
 }
 
 static void print_dot_statement_expr(struct mCc_ast_statement *statement,
@@ -93,7 +106,7 @@ static void print_dot_statement_expr(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: expr");
     print_dot_edge(out, statement, statement->expression, "expression");
 }
@@ -103,7 +116,7 @@ static void print_dot_statement_if(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: if");
     print_dot_edge(out, statement, statement->if_cond, "condition");
     print_dot_edge(out, statement, statement->if_stmt, "if stmt");
@@ -114,7 +127,7 @@ static void print_dot_statement_ifelse(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: ifelse");
     print_dot_edge(out, statement, statement->if_cond, "condition");
     print_dot_edge(out, statement, statement->if_stmt, "if stmt");
@@ -126,7 +139,7 @@ static void print_dot_statement_assgn(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: =");
     print_dot_edge(out, statement, statement->id_assgn, "id");
     if (statement->lhs_assgn)
@@ -139,7 +152,7 @@ static void print_dot_statement_while(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: while");
     print_dot_edge(out, statement, statement->while_cond, "condition");
     print_dot_edge(out, statement, statement->while_stmt, "while stmt");
@@ -150,7 +163,7 @@ static void print_dot_statement_return(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: return");
     print_dot_edge(out, statement, statement->ret_val, "return value");
 }
@@ -160,7 +173,7 @@ static void print_dot_statement_return_void(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: return");
 }
 
@@ -169,7 +182,7 @@ static void print_dot_statement_compound(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: cmpnd");
     for (unsigned int i = 0; i < statement->compound_stmt_count; ++i)
         print_dot_edge(out, statement, statement->compound_stmts[i],
@@ -181,7 +194,7 @@ static void print_dot_statement_decl(struct mCc_ast_statement *statement,
     assert(statement);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, statement, "stmt: decl");
     print_dot_edge(out, statement, statement->declaration, "declaration");
 }
@@ -191,7 +204,7 @@ static void print_dot_expression_literal(struct mCc_ast_expression *expression,
     assert(expression);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, expression, "expr: lit");
     print_dot_edge(out, expression, expression->literal, "literal");
 }
@@ -202,7 +215,7 @@ print_dot_expression_identifier(struct mCc_ast_expression *expression,
     assert(expression);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, expression, "expr: id");
     print_dot_edge(out, expression, expression->identifier, "id");
 }
@@ -215,7 +228,7 @@ static void print_dot_expression_unary_op(struct mCc_ast_expression *expression,
     char label[LABEL_SIZE] = {0};
     snprintf(label, sizeof(label), "expr: %s",
              mCc_ast_print_unary_op(expression->unary_op));
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, expression, label);
     print_dot_edge(out, expression, expression->unary_expression,
                    "subexpression");
@@ -231,7 +244,7 @@ print_dot_expression_binary_op(struct mCc_ast_expression *expression,
     snprintf(label, sizeof(label), "expr: %s",
              mCc_ast_print_binary_op(expression->op));
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, expression, label);
     print_dot_edge(out, expression, expression->lhs, "lhs");
     print_dot_edge(out, expression, expression->rhs, "rhs");
@@ -242,7 +255,7 @@ static void print_dot_expression_parenth(struct mCc_ast_expression *expression,
     assert(expression);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, expression, "( )");
     print_dot_edge(out, expression, expression->expression, "expression");
 }
@@ -253,7 +266,7 @@ print_dot_expression_call_expr(struct mCc_ast_expression *expression,
     assert(expression);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, expression, "expr: call");
     print_dot_edge(out, expression, expression->f_name, "fName");
     if (expression->arguments != NULL)
@@ -266,7 +279,7 @@ print_dot_expression_arr_subscr(struct mCc_ast_expression *expression,
     assert(expression);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, expression, "expr: arr");
     print_dot_edge(out, expression, expression->array_id, "id");
     print_dot_edge(out, expression, expression->subscript_expr, "index");
@@ -279,7 +292,7 @@ static void print_dot_literal_int(struct mCc_ast_literal *literal, void *data) {
     char label[LABEL_SIZE] = {0};
     snprintf(label, sizeof(label), "%ld", literal->i_value);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, literal, label);
 }
 
@@ -290,7 +303,7 @@ static void print_dot_literal_float(struct mCc_ast_literal *literal, void *data)
     char label[LABEL_SIZE] = {0};
     snprintf(label, sizeof(label), "%f", literal->f_value);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, literal, label);
 }
 
@@ -302,7 +315,7 @@ static void print_dot_literal_string(struct mCc_ast_literal *literal,
     char label[LABEL_SIZE] = {0};
     snprintf(label, sizeof(label), "%s", literal->s_value);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, literal, label);
 }
 
@@ -313,7 +326,7 @@ static void print_dot_literal_bool(struct mCc_ast_literal *literal, void *data)
     char label[LABEL_SIZE] = {0};
     snprintf(label, sizeof(label), "%s", literal->b_value ? "true" : "false");
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, literal, label);
 }
 
@@ -325,7 +338,7 @@ static void print_dot_identifier(struct mCc_ast_identifier *identifier,
     char label[LABEL_SIZE] = {0};
     snprintf(label, sizeof(label), "%s", identifier->id_value);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, identifier, label);
 }
 
@@ -333,7 +346,7 @@ static void print_dot_arguments(struct mCc_ast_arguments *arguments, void *data)
     assert(arguments);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, arguments, "args: expr");
     for (unsigned int i = 0; i < arguments->expression_count; ++i)
         print_dot_edge(out, arguments, arguments->expressions[i], "expression");
@@ -344,7 +357,7 @@ static void print_dot_parameter(struct mCc_ast_parameters *parameter,
     assert(parameter);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, parameter, "args: decl");
     for (unsigned int i = 0; i < parameter->decl_count; ++i)
         print_dot_edge(out, parameter, parameter->decl[i], "declaration");
@@ -354,7 +367,7 @@ static void print_dot_declaration(struct mCc_ast_declaration *decl, void *data)
     assert(decl);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     switch (decl->decl_type) {
         case MCC_AST_TYPE_BOOL:
             print_dot_node(out, decl, "declaration bool");
@@ -383,7 +396,7 @@ static void print_dot_function_def(struct mCc_ast_function_def *func,
     assert(func);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     switch (func->func_type) {
         case MCC_AST_TYPE_BOOL:
             print_dot_node(out, func, "bool function");
@@ -414,13 +427,13 @@ static void print_dot_program(struct mCc_ast_program *prog, void *data) {
     assert(prog);
     assert(data);
 
-    FILE *out = data;
+    struct mCc_writer *out = data;
     print_dot_node(out, prog, "program");
     for (unsigned int i = 0; i < prog->func_def_count; ++i)
         print_dot_edge(out, prog, prog->func_defs[i], "func def");
 }
 
-static struct mCc_ast_visitor print_dot_visitor(FILE *out) {
+static struct mCc_ast_visitor print_dot_visitor(struct mCc_writer *out) {
     assert(out);
 
     return (struct mCc_ast_visitor) {
@@ -466,24 +479,26 @@ void mCc_ast_print_dot_statement(FILE *out, struct mCc_ast_statement *statement)
     assert(out);
     assert(statement);
 
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_statement(statement, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
 
 void mCc_ast_print_dot_arguments(FILE *out, struct mCc_ast_arguments *arguments) {
     assert(out);
     assert(arguments);
 
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_arguments(arguments, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
 
 void mCc_ast_print_dot_parameter(FILE *out,
@@ -491,24 +506,26 @@ void mCc_ast_print_dot_parameter(FILE *out,
     assert(out);
     assert(parameter);
 
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_parameter(parameter, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
 
 void mCc_ast_print_dot_declaration(FILE *out, struct mCc_ast_declaration *decl) {
     assert(out);
     assert(decl);
 
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_declaration(decl, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
 
 void mCc_ast_print_dot_expression(FILE *out,
@@ -516,24 +533,26 @@ void mCc_ast_print_dot_expression(FILE *out,
     assert(out);
     assert(expression);
 
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_expression(expression, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
 
 void mCc_ast_print_dot_literal(FILE *out, struct mCc_ast_literal *literal) {
     assert(out);
     assert(literal);
 
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_literal(literal, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
 
 void mCc_ast_print_dot_identifier(FILE *out,
@@ -541,33 +560,36 @@ void mCc_ast_print_dot_identifier(FILE *out,
     assert(out);
     assert(identifier);
 
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_identifier(identifier, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
 
 void mCc_ast_print_dot_function_def(FILE *out,
                                     struct mCc_ast_function_def *func) {
     assert(out);
     assert(func);
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_function_def(func, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
 
 void mCc_ast_print_dot_program(FILE *out, struct mCc_ast_program *prog) {
     assert(out);
     assert(prog);
-    print_dot_begin(out);
+    struct mCc_writer writer;
+    print_dot_begin(&writer, out);
 
-    struct mCc_ast_visitor visitor = print_dot_visitor(out);
+    struct mCc_ast_visitor visitor = print_dot_visitor(&writer);
     mCc_ast_visit_program(prog, &visitor);
 
-    print_dot_end(out);
+    print_dot_end(&writer);
 }
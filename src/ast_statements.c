@@ -21,7 +21,7 @@ mCc_ast_new_statement_expression(struct mCc_ast_expression *expression)
 {
 	assert(expression);
 
-	struct mCc_ast_statement *stmt = malloc(sizeof(*stmt));
+	struct mCc_ast_statement *stmt = mCc_ast_alloc_node(sizeof(*stmt));
 	if (!stmt)
 		return NULL;
 
@@ -38,7 +38,7 @@ mCc_ast_new_statement_if(struct mCc_ast_expression *if_cond,
 	assert(if_cond);
 	assert(if_stmt);
 
-	struct mCc_ast_statement *stmt = malloc(sizeof(*stmt));
+	struct mCc_ast_statement *stmt = mCc_ast_alloc_node(sizeof(*stmt));
 	if (!stmt)
 		return NULL;
 
@@ -60,7 +60,7 @@ mCc_ast_new_statement_while(struct mCc_ast_expression *while_cond,
 	assert(while_cond);
 	assert(while_stmt);
 
-	struct mCc_ast_statement *stmt = malloc(sizeof(*stmt));
+	struct mCc_ast_statement *stmt = mCc_ast_alloc_node(sizeof(*stmt));
 	if (!stmt)
 		return NULL;
 
@@ -75,7 +75,7 @@ struct mCc_ast_statement *
 mCc_ast_new_statement_return(struct mCc_ast_expression *ret_val)
 {
 
-	struct mCc_ast_statement *stmt = malloc(sizeof(*stmt));
+	struct mCc_ast_statement *stmt = mCc_ast_alloc_node(sizeof(*stmt));
 	if (!stmt)
 		return NULL;
 	if (!ret_val) {
@@ -90,7 +90,7 @@ mCc_ast_new_statement_return(struct mCc_ast_expression *ret_val)
 struct mCc_ast_statement *
 mCc_ast_new_statement_compound(struct mCc_ast_statement *substatement)
 {
-	struct mCc_ast_statement *stmt = malloc(sizeof(*stmt));
+	struct mCc_ast_statement *stmt = mCc_ast_alloc_node(sizeof(*stmt));
 	if (!stmt)
 		return NULL;
 
@@ -100,8 +100,9 @@ mCc_ast_new_statement_compound(struct mCc_ast_statement *substatement)
 	stmt->node.outside_if = true;
 
 	if (substatement &&
-	    (stmt->compound_stmts =
-	         malloc(compound_stmt_alloc_block_size * sizeof(stmt))) != NULL) {
+	    (stmt->compound_stmts = mCc_ast_realloc(
+	         &stmt->node, NULL, 0,
+	         compound_stmt_alloc_block_size * sizeof(stmt))) != NULL) {
 		stmt->compound_stmt_count = 1;
 		stmt->compound_stmt_alloc_size = compound_stmt_alloc_block_size;
 		stmt->compound_stmts[0] = substatement;
@@ -124,9 +125,11 @@ mCc_ast_compound_statement_add(struct mCc_ast_statement *self,
 
 	// Allocate additional memory if necessary
 	struct mCc_ast_statement **tmp;
+	size_t old_size = self->compound_stmt_alloc_size * sizeof(*tmp);
 	self->compound_stmt_alloc_size += compound_stmt_alloc_block_size;
-	if ((tmp = realloc(self->compound_stmts, self->compound_stmt_alloc_size *
-	                                             sizeof(self))) == NULL) {
+	if ((tmp = mCc_ast_realloc(&self->node, self->compound_stmts, old_size,
+	                           self->compound_stmt_alloc_size *
+	                               sizeof(*tmp))) == NULL) {
 		mCc_ast_delete_statement(self);
 		return NULL;
 	}
@@ -144,7 +147,7 @@ mCc_ast_new_statement_assgn(struct mCc_ast_identifier *id_assgn,
 	assert(id_assgn);
 	assert(rhs_assgn);
 
-	struct mCc_ast_statement *stmt = malloc(sizeof(*stmt));
+	struct mCc_ast_statement *stmt = mCc_ast_alloc_node(sizeof(*stmt));
 	if (!stmt)
 		return NULL;
 
@@ -164,7 +167,7 @@ mCc_ast_new_statement_declaration(struct mCc_ast_declaration *decl)
 {
 
 	assert(decl);
-	struct mCc_ast_statement *stmt = malloc(sizeof(*stmt));
+	struct mCc_ast_statement *stmt = mCc_ast_alloc_node(sizeof(*stmt));
 	if (!stmt)
 		return NULL;
 	stmt->type = MCC_AST_STATEMENT_TYPE_DECL;
@@ -175,6 +178,8 @@ mCc_ast_new_statement_declaration(struct mCc_ast_declaration *decl)
 void mCc_ast_delete_statement(struct mCc_ast_statement *statement)
 {
 	assert(statement);
+	if (mCc_ast_delete_from_arena(&statement->node))
+		return;
 
 	switch (statement->type) {
 	case MCC_AST_STATEMENT_TYPE_EXPR:
@@ -231,7 +236,7 @@ mCc_ast_new_declaration(enum mCc_ast_type type, struct mCc_ast_literal *val,
 {
 	assert(id);
 
-	struct mCc_ast_declaration *decl = malloc(sizeof(*decl));
+	struct mCc_ast_declaration *decl = mCc_ast_alloc_node(sizeof(*decl));
 	if (!decl)
 		return NULL;
 
@@ -248,6 +253,8 @@ mCc_ast_new_declaration(enum mCc_ast_type type, struct mCc_ast_literal *val,
 
 void mCc_ast_delete_declaration(struct mCc_ast_declaration *decl)
 {
+	if (mCc_ast_delete_from_arena(&decl->node))
+		return;
 	mCc_ast_delete_identifier(decl->decl_id);
 	if (decl->decl_array_size)
 		mCc_ast_delete_literal(decl->decl_array_size);
@@ -263,13 +270,15 @@ mCc_ast_new_function_def_void(struct mCc_ast_identifier *id,
                               struct mCc_ast_statement *body)
 {
 	assert(id);
-	struct mCc_ast_function_def *func = malloc(sizeof(*func));
+	struct mCc_ast_function_def *func = mCc_ast_alloc_node(sizeof(*func));
 	if (!func) {
 		return NULL;
 	}
 
 	func->func_type = MCC_AST_TYPE_VOID;
 	func->identifier = id;
+	func->slot_count = 0;
+	func->built_in = false;
 	if (para) {
 		func->para = para;
 	} else {
@@ -291,13 +300,15 @@ struct mCc_ast_function_def *mCc_ast_new_function_def_type(
 	assert(id);
 	//	assert(body);
 
-	struct mCc_ast_function_def *func = malloc(sizeof(*func));
+	struct mCc_ast_function_def *func = mCc_ast_alloc_node(sizeof(*func));
 	if (!func) {
 		return NULL;
 	}
 
 	func->func_type = type;
 	func->identifier = id;
+	func->slot_count = 0;
+	func->built_in = false;
 	if (para) {
 		func->para = para;
 	} else {
@@ -314,6 +325,8 @@ struct mCc_ast_function_def *mCc_ast_new_function_def_type(
 void mCc_ast_delete_func_def(struct mCc_ast_function_def *func)
 {
 	assert(func);
+	if (mCc_ast_delete_from_arena(&func->node))
+		return;
 	mCc_ast_delete_identifier(func->identifier);
 	if (func->body) {
 		mCc_ast_delete_statement(func->body);
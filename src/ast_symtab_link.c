@@ -5,11 +5,11 @@
  * @date 2018-04-17
  */
 #include "mCc/ast_symtab_link.h"
+#include "mCc/context.h"
+#include "mCc/source.h"
 #include "mCc/symtab.h"
 #include <assert.h>
 
-static struct mCc_ast_symtab_build_result tmp_result = { 0 };
-
 // Important!
 #define MCC_AST_VISIT_SYMTAB_MODE
 #include "mCc/ast_visit.h"
@@ -22,60 +22,62 @@ static void no_op() {}
 
 static void handle_assign(struct mCc_ast_statement *stmt, void *data)
 {
-	if (tmp_result.status)
-		return; // Return if an error happened
 	struct mCc_symtab_scope *scope = (struct mCc_symtab_scope *)data;
+	struct mCc_ast_symtab_build_result *result = &scope->ctx->symtab_link;
+	if (result->status)
+		return; // Return if an error happened
 
 	enum MCC_SYMTAB_SCOPE_LINK_ERROR retval =
 	    mCc_symtab_scope_link_ref_assignment(scope, stmt);
 	switch (retval) {
 	case MCC_SYMTAB_SCOPE_LINK_ERR_OK: return;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_UNDECLARED_ID:
-		if ((snprintf(tmp_result.err_msg, err_len, "Use of undeclared id: '%s'",
+		if ((snprintf(result->err_msg, err_len, "Use of undeclared id: '%s'",
 		              stmt->id_assgn->id_value) == -1)) {
-			strcpy(tmp_result.err_msg, "Use of undeclared id");
+			strcpy(result->err_msg, "Use of undeclared id");
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_ASSIGN_TO_FUNCTION:
-		if ((snprintf(tmp_result.err_msg, err_len,
+		if ((snprintf(result->err_msg, err_len,
 		              "Assignment to function name: '%s'",
 		              stmt->id_assgn->id_value)) == -1) {
-			strcpy(tmp_result.err_msg, "Assignment to function name");
+			strcpy(result->err_msg, "Assignment to function name");
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_VAR:
-		if ((snprintf(tmp_result.err_msg, err_len,
+		if ((snprintf(result->err_msg, err_len,
 		              "Use of subscript on variable: '%s'",
 		              stmt->id_assgn->id_value) == -1)) {
-			strcpy(tmp_result.err_msg, "Use of subscript on variable");
+			strcpy(result->err_msg, "Use of subscript on variable");
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_ARR_WITHOUT_BRACKS:
-		if ((snprintf(tmp_result.err_msg, err_len,
+		if ((snprintf(result->err_msg, err_len,
 		              "Use of array without subscript: '%s'",
 		              stmt->id_assgn->id_value) == -1)) {
-			strcpy(tmp_result.err_msg, "Use of array without subscript");
+			strcpy(result->err_msg, "Use of array without subscript");
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_FUN_WITHOUT_CALL: /* Fallthrough */
 	case MCC_SYMTAB_SCOPE_LINK_ERROR_INVALID_AST_OBJECT:
-		strcpy(tmp_result.err_msg,
+		strcpy(result->err_msg,
 		       "Development error! This error should not have happened here.");
 		break;
 	}
 
 	// If an error happened, set status
-	if (tmp_result.err_msg[0]) {
-		tmp_result.err_loc = stmt->node.sloc;
-		tmp_result.status = 1;
+	if (result->err_msg[0]) {
+		result->err_loc = stmt->node.sloc;
+		result->status = 1;
 	}
 }
 
 static void handle_expression(struct mCc_ast_expression *expr, void *data)
 {
-	if (tmp_result.status)
-		return; // Return if an error happened
 	struct mCc_symtab_scope *scope = (struct mCc_symtab_scope *)data;
+	struct mCc_ast_symtab_build_result *result = &scope->ctx->symtab_link;
+	if (result->status)
+		return; // Return if an error happened
 
 	enum MCC_SYMTAB_SCOPE_LINK_ERROR retval =
 	    mCc_symtab_scope_link_ref_expression(scope, expr);
@@ -83,61 +85,61 @@ static void handle_expression(struct mCc_ast_expression *expr, void *data)
 	case MCC_SYMTAB_SCOPE_LINK_ERR_OK: return;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_UNDECLARED_ID:
 		if (expr->type == MCC_AST_EXPRESSION_TYPE_IDENTIFIER) {
-			if ((snprintf(tmp_result.err_msg, err_len,
+			if ((snprintf(result->err_msg, err_len,
 			              "Use of undeclared id: '%s'",
 			              expr->identifier->id_value) == -1)) {
-				strcpy(tmp_result.err_msg, "Snprintf error");
+				strcpy(result->err_msg, "Snprintf error");
 			}
 		} else if (expr->type == MCC_AST_EXPRESSION_TYPE_CALL_EXPR) {
-			if ((snprintf(tmp_result.err_msg, err_len,
+			if ((snprintf(result->err_msg, err_len,
 			              "Use of undeclared id: '%s'",
 			              expr->f_name->id_value) == -1)) {
-				strcpy(tmp_result.err_msg, "Snprintf error");
+				strcpy(result->err_msg, "Snprintf error");
 			}
 		} else { // MCC_AST_EXPRESSION_TYPE_ARR_SUBSCR
-			if ((snprintf(tmp_result.err_msg, err_len,
+			if ((snprintf(result->err_msg, err_len,
 			              "Use of undeclared id: '%s'",
 			              expr->array_id->id_value) == -1)) {
-				strcpy(tmp_result.err_msg, "Snprintf error");
+				strcpy(result->err_msg, "Snprintf error");
 			}
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_ASSIGN_TO_FUNCTION:
-		if ((snprintf(tmp_result.err_msg, err_len,
+		if ((snprintf(result->err_msg, err_len,
 		              "Assignment to function name: '%s'",
 		              expr->identifier->id_value) == -1)) {
-			strcpy(tmp_result.err_msg, "Snprintf error");
+			strcpy(result->err_msg, "Snprintf error");
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_FUN_WITHOUT_CALL:
-		if (snprintf(tmp_result.err_msg, err_len,
+		if (snprintf(result->err_msg, err_len,
 		             "Use of a function without a call: '%d'", expr->type)) {
-			strcpy(tmp_result.err_msg, "Snprintf error");
+			strcpy(result->err_msg, "Snprintf error");
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_ARR_WITHOUT_BRACKS:
-		if ((snprintf(tmp_result.err_msg, err_len,
+		if ((snprintf(result->err_msg, err_len,
 		              "Use of an array without brackets: '%d'",
 		              expr->type) == -1)) {
-			strcpy(tmp_result.err_msg, "Snprintf error");
+			strcpy(result->err_msg, "Snprintf error");
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERR_VAR:
-		if ((snprintf(tmp_result.err_msg, err_len,
+		if ((snprintf(result->err_msg, err_len,
 		              "Use of undeclared variable: '%d'", expr->type) == -1)) {
-			strcpy(tmp_result.err_msg, "Snprintf error");
+			strcpy(result->err_msg, "Snprintf error");
 		}
 		break;
 	case MCC_SYMTAB_SCOPE_LINK_ERROR_INVALID_AST_OBJECT:
-		strcpy(tmp_result.err_msg,
+		strcpy(result->err_msg,
 		       "Development error! This error should not haave happened here.");
 		break;
 	}
 
 	// If an error happened, set status
-	if (tmp_result.err_msg[0]) {
-		tmp_result.err_loc = expr->node.sloc;
-		tmp_result.status = 1;
+	if (result->err_msg[0]) {
+		result->err_loc = expr->node.sloc;
+		result->status = 1;
 	}
 }
 
@@ -145,24 +147,25 @@ static void handle_expression(struct mCc_ast_expression *expr, void *data)
 
 static void handle_declaration(struct mCc_ast_declaration *decl, void *data)
 {
-	if (tmp_result.status)
-		return; // Return if an error happened
 	struct mCc_symtab_scope *scope = (struct mCc_symtab_scope *)data;
+	struct mCc_ast_symtab_build_result *result = &scope->ctx->symtab_link;
+	if (result->status)
+		return; // Return if an error happened
 	int retval = mCc_symtab_scope_add_decl(scope, decl);
 	switch (retval) {
 	case 1:
-		if (snprintf(tmp_result.err_msg, err_len, "Redeclared id: '%s'",
+		if (snprintf(result->err_msg, err_len, "Redeclared id: '%s'",
 		             decl->decl_id->id_value) == -1) {
-			strcpy(tmp_result.err_msg, "Redeclared id");
+			strcpy(result->err_msg, "Redeclared id");
 		};
 		break;
-	case -1: strcpy(tmp_result.err_msg, "Memory allocation error"); break;
+	case -1: strcpy(result->err_msg, "Memory allocation error"); break;
 	default: break;
 	}
 
-	if (tmp_result.err_msg[0]) {
-		tmp_result.err_loc = decl->node.sloc;
-		tmp_result.status = 1;
+	if (result->err_msg[0]) {
+		result->err_loc = decl->node.sloc;
+		result->status = 1;
 	}
 }
 
@@ -206,47 +209,90 @@ symtab_visitor(struct mCc_symtab_scope *curr_scope_ptr)
 		                             .literal_bool = no_op };
 }
 
-struct mCc_ast_symtab_build_result
-mCc_ast_symtab_build(struct mCc_ast_program *program)
+/* Open the root scope and enter all functions of the program, 0 on success */
+static int declare_functions(struct mCc_context *ctx,
+                             struct mCc_ast_program *program)
 {
-	// To allow unit tests, reset globals
-	memset(&tmp_result, 0, sizeof(tmp_result));
-	struct mCc_symtab_scope *root_scope = mCc_symtab_new_scope_in(NULL, "");
+	// The callbacks find the result through the context of their scope
+	struct mCc_ast_symtab_build_result *result = &ctx->symtab_link;
+	memset(result, 0, sizeof(*result));
+	mCc_symtab_set_interner(ctx, program->interner);
+	mCc_symtab_set_source(ctx, program->source);
+	struct mCc_symtab_scope *root_scope = mCc_symtab_new_root_scope(ctx, "");
 	if (root_scope == NULL) {
-		strcpy(tmp_result.err_msg, "Memory error");
-		tmp_result.status = 1;
-		goto end;
+		strcpy(result->err_msg, "Memory error");
+		result->status = 1;
+		return 1;
 	}
 
-	// This will be used by the callbacks to store the scope they are currently
-	// in
-	struct mCc_symtab_scope *curr_scope_ptr = root_scope;
-
 	// Before visiting, enter all functions into the symbol table because they
 	// can be used before their declaration
 	for (unsigned int i = 0; i < program->func_def_count; ++i) {
 		int retval =
 		    mCc_symtab_scope_add_func_def(root_scope, program->func_defs[i]);
 		if (retval == 1)
-			snprintf(tmp_result.err_msg, err_len, "Redefined function: %s",
+			snprintf(result->err_msg, err_len, "Redefined function: %s",
 			         program->func_defs[i]->identifier->id_value);
 		if (retval == -1)
-			strcpy(tmp_result.err_msg, "Memory error");
+			strcpy(result->err_msg, "Memory error");
 		if (retval) {
-			tmp_result.err_loc = program->func_defs[i]->node.sloc;
-			tmp_result.status = 1;
-			goto end;
+			result->err_loc = program->func_defs[i]->node.sloc;
+			result->status = 1;
+			return 1;
 		}
 	}
 
-	tmp_result.root_symtab = root_scope;
-	struct mCc_ast_visitor visitor = symtab_visitor(curr_scope_ptr);
-	mCc_ast_visit_program(program, &visitor);
+	result->root_symtab = root_scope;
+	return 0;
+}
 
-end:
-	if (tmp_result.status) {
-		mCc_symtab_delete_all_scopes();
-		tmp_result.root_symtab = NULL;
+/* Link the body of a function in the root scope */
+static void link_function(struct mCc_context *ctx,
+                          struct mCc_ast_function_def *func)
+{
+	// The callbacks store the scope they are currently in here
+	struct mCc_ast_visitor visitor =
+	    symtab_visitor(ctx->symtab_link.root_symtab);
+	mCc_ast_visit_function_def(func, &visitor);
+	// Its variables were numbered from 0 in the order of declaration
+	func->slot_count = ctx->symtab.slot_count;
+}
+
+/* The result, with the scopes deleted on error */
+static struct mCc_ast_symtab_build_result finish(struct mCc_context *ctx)
+{
+	struct mCc_ast_symtab_build_result *result = &ctx->symtab_link;
+	if (result->status) {
+		mCc_source_resolve(ctx->symtab.source, &result->err_loc);
+		mCc_symtab_delete_all_scopes(ctx);
+		result->root_symtab = NULL;
 	}
-	return tmp_result;
+	return *result;
+}
+
+struct mCc_ast_symtab_build_result
+mCc_ast_symtab_build(struct mCc_context *ctx, struct mCc_ast_program *program)
+{
+	if (declare_functions(ctx, program) == 0) {
+		for (unsigned int i = 0; i < program->func_def_count; ++i)
+			link_function(ctx, program->func_defs[i]);
+	}
+	return finish(ctx);
+}
+
+struct mCc_ast_symtab_build_result
+mCc_ast_symtab_declare(struct mCc_context *ctx, struct mCc_ast_program *program)
+{
+	declare_functions(ctx, program);
+	return finish(ctx);
+}
+
+struct mCc_ast_symtab_build_result
+mCc_ast_symtab_build_function(struct mCc_context *ctx,
+                              struct mCc_ast_function_def *func)
+{
+	assert(ctx->symtab_link.root_symtab);
+	mCc_symtab_delete_function_scopes(ctx);
+	link_function(ctx, func);
+	return finish(ctx);
 }
@@ -94,8 +94,7 @@ void mCc_ast_visit_statement(struct mCc_ast_statement *statement,
 
 		// Only execute when linking symbol table
 		if (visitor->mode == MCC_AST_VISIT_MODE_SYMTAB_REF) {
-			struct mCc_symtab_scope *tmp = visitor->userdata;
-			visitor->userdata = tmp->parent;
+			visitor->userdata = mCc_symtab_scope_leave(visitor->userdata);
 		}
 		break;
 
@@ -286,8 +285,7 @@ void mCc_ast_visit_function_def(struct mCc_ast_function_def *func,
 
 	// Only execute when linking symbol table
 	if (visitor->mode == MCC_AST_VISIT_MODE_SYMTAB_REF) {
-		struct mCc_symtab_scope *tmp = visitor->userdata;
-		visitor->userdata = tmp->parent;
+		visitor->userdata = mCc_symtab_scope_leave(visitor->userdata);
 	}
 }
 
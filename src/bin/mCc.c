@@ -1,6 +1,10 @@
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,47 +17,797 @@
 #include "mCc/asm.h"
 #include "mCc/ast.h"
 #include "mCc/ast_symtab_link.h"
+#include "mCc/cache.h"
+#include "mCc/compile.h"
+#include "mCc/context.h"
+#include "mCc/func_cache.h"
 #include "mCc/parser.h"
+#include "mCc/server.h"
+#include "mCc/source.h"
 #include "mCc/tac_builder.h"
+#include "mCc/tac_opt.h"
 #include "mCc/typecheck.h"
 #include "mCc/cfg_print.h"
+#include "mCc/x86_asm.h"
 
 static const char* VERSION = "0.3.0";
 
 static void print_usage(const char *prg)
 {
-	printf("usage: %s [options] <FILE>\n\n", prg);
+	printf("usage: %s [options] <FILE>...\n\n", prg);
 	puts("Options:");
 	printf("  <FILE>                  Input file, or - for stdin\n");
+	printf("  -j|--jobs <N>           Compile several files with N threads, default is one per CPU\n");
 	printf("  -h|--help               Print this message\n");
 	printf("  -v|--version            Print the version\n");
 	printf("  -o|--output <FILE>      Path to generated executable, default is a.out\n");
-	printf("  -O|--optimize           Prints optimization in doc/optimisation.md and cfg in doc/images\n");
+	printf("  -c|--compile-only       Generate a relocatable object, default is a.o\n");
+	printf("  --use-gcc               Assemble and link with gcc instead of the integrated assembler\n");
+	printf("  -O|--optimize[=LEVEL]   Optimisation level 0-3, default 0, 2 if LEVEL is omitted\n");
+	printf("  --optimize-report       Prints optimization in doc/optimisation.md and cfg in doc/images\n");
 	printf("  --print-symtab[=FILE]   Print the symbol tables\n");
 	printf("  --print-tac[=FILE]      Print the three-address code\n");
 	printf("  --print-asm[=FILE]      Print the assembler code\n");
 	printf("  --print-cfg[=FILE]      Print the control-flow graphs in DOT format\n");
+	printf("  --server <SOCKET>       Serve compile requests on a Unix domain socket with -j threads\n");
+	printf("  --client <SOCKET>       Compile on the server at SOCKET, then assemble and link here\n");
+	printf("  --cache[=DIR]           Reuse the outputs of earlier compilations of the same source\n");
+	printf("  --cache-stats[=DIR]     Print the statistics of the cache and exit\n");
+	printf("  --parser <NAME>         Parse with bison or descent, the hand-written parser\n");
+	printf("  --stream                Compile each function as soon as it is parsed, then free it\n");
+	printf("                          (not with --client)\n");
 	printf("\nPrinting anything disables compilation. Printing without specifying a file prints to stdout.\n");
+	printf("With several files, each gets its own output named after it without extension.\n");
+	printf("-o then names a directory, or a pattern in which %% is replaced by that name.\n");
+	printf("Executables are linked against mC_runtime.o next to mCc, or $MCC_RUNTIME if set.\n");
+	printf("Without it, or if the integrated assembler fails, gcc is used instead.\n");
+	printf("gcc links libmC_builtins.a or mC_builtins.o next to mCc, or $MCC_BUILTINS if set.\n");
+	printf("The cache is in $MCC_CACHE_DIR, or $XDG_CACHE_HOME/mCc, or ~/.cache/mCc, and\n");
+	printf("keeps $MCC_CACHE_SIZE MiB, default 256. It is not used with --client or printing.\n");
 }
 
-static int compile(char *source, char *executable)
+/* Locate a prebuilt support file: $<env>, or next to the executable */
+static int find_support_file(const char *env_name, const char *name,
+                             char *path, size_t size)
 {
-	int pid;
-	if ((pid = fork()) == 0) {
-		execlp("gcc", "gcc", "-m32", source, "../src/mC_builtins.c", "-o",
-		       executable, (char *)NULL);
+	const char *env = getenv(env_name);
+	if (env && *env) {
+		snprintf(path, size, "%s", env);
+		return access(path, R_OK);
+	}
+	char exe[PATH_MAX];
+	ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (len < 0)
+		return -1;
+	exe[len] = '\0';
+	snprintf(path, size, "%s/%s", dirname(exe), name);
+	return access(path, R_OK);
+}
+
+/* Read a stream up to its end into memory, NULL with errno set on error */
+static char *read_stream(FILE *in, size_t *size)
+{
+	char *data = NULL;
+	size_t capacity = 0, len = 0, n;
+	do {
+		if (len == capacity) {
+			capacity = capacity ? 2 * capacity : 4096;
+			char *tmp = realloc(data, capacity);
+			if (!tmp) {
+				free(data);
+				errno = ENOMEM;
+				return NULL;
+			}
+			data = tmp;
+		}
+		len += n = fread(data + len, 1, capacity - len, in);
+	} while (n);
+
+	if (ferror(in)) {
+		free(data);
+		return NULL;
+	}
+	*size = len;
+	return data;
+}
+
+/* Read a whole file, or stdin for -, into memory */
+static char *read_file(const char *path, size_t *size)
+{
+	if (strcmp("-", path) == 0)
+		return read_stream(stdin, size);
+	FILE *in = fopen(path, "rb");
+	if (!in)
+		return NULL;
+	char *data = read_stream(in, size);
+	int err = errno;
+	fclose(in);
+	errno = err;
+	return data;
+}
+
+/* The runtime object of the integrated linker, read once for all inputs */
+struct runtime {
+	char path[PATH_MAX];
+	char *data; ///< NULL if it is not available
+	size_t size;
+};
+
+static void load_runtime(struct runtime *rt)
+{
+	rt->data = NULL;
+	if (!find_support_file("MCC_RUNTIME", "mC_runtime.o", rt->path,
+	                       sizeof(rt->path)))
+		rt->data = read_file(rt->path, &rt->size);
+}
+
+/* Assemble and link without external tools, non-zero means use gcc instead */
+static int compile_integrated(char *assembly, size_t size, const char *source,
+                              const char *output, int object_only,
+                              const struct runtime *runtime)
+{
+	struct mCc_elf_error error;
+	struct mCc_elf_object *objs[2] = { NULL, NULL };
+	FILE *in = NULL, *out = NULL;
+	int ret = 1;
+
+	if (!object_only && !runtime->data)
+		return 1;
+	if (!(in = fmemopen(assembly, size, "r"))) {
+		perror("fmemopen");
+		return 1;
+	}
+	if (!(objs[0] = mCc_elf_object_new()))
+		goto out;
+	if (mCc_x86_assemble(in, objs[0], &error)) {
+		fprintf(stderr, "%s: assembly line %u: %s, falling back to gcc\n",
+		        source, error.line, error.msg);
+		goto out;
+	}
+	if (!object_only) {
+		FILE *rt = fmemopen(runtime->data, runtime->size, "rb");
+		if (!rt) {
+			perror("fmemopen");
+			goto out;
+		}
+		objs[1] = mCc_elf_read_object(rt, &error);
+		fclose(rt);
+		if (!objs[1]) {
+			fprintf(stderr, "%s: %s, falling back to gcc\n", runtime->path,
+			        error.msg);
+			goto out;
+		}
+	}
+
+	unlink(output);
+	int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+	              object_only ? 0666 : 0777);
+	if (fd < 0 || !(out = fdopen(fd, "wb"))) {
+		perror(output);
+		if (fd >= 0)
+			close(fd);
+		goto out;
+	}
+	if (object_only) {
+		ret = mCc_elf_write_object(objs[0], out);
+	} else if ((ret = mCc_elf_link(objs, 2, out, &error))) {
+		fprintf(stderr, "%s: %s, falling back to gcc\n", output, error.msg);
+	}
+	if (fclose(out) && !ret) {
+		perror(output);
+		ret = 1;
+	}
+out:
+	fclose(in);
+	mCc_elf_object_delete(objs[0]);
+	mCc_elf_object_delete(objs[1]);
+	return ret;
+}
+
+/* Start gcc reading the assembly from its stdin, returns the write end */
+static int gcc_start(const char *output, int object_only, pid_t *pid)
+{
+	// Link the prebuilt built-ins instead of compiling them every time
+	char builtins[PATH_MAX];
+	if (!object_only &&
+	    find_support_file("MCC_BUILTINS", "libmC_builtins.a", builtins,
+	                      sizeof(builtins)) &&
+	    find_support_file("MCC_BUILTINS", "mC_builtins.o", builtins,
+	                      sizeof(builtins))) {
+		fprintf(stderr, "%s: %s, set MCC_BUILTINS to libmC_builtins.a\n",
+		        builtins, strerror(errno));
+		return -1;
+	}
+
+	// Both ends are closed on exec, or a gcc started by another thread would
+	// keep this pipe open and never let this gcc see the end of its input
+	static pthread_mutex_t pipe_lock = PTHREAD_MUTEX_INITIALIZER;
+	int fds[2];
+	pthread_mutex_lock(&pipe_lock);
+	if (pipe(fds)) {
+		pthread_mutex_unlock(&pipe_lock);
+		perror("pipe");
+		return -1;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	pthread_mutex_unlock(&pipe_lock);
+
+	if ((*pid = fork()) == 0) {
+		dup2(fds[0], STDIN_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		if (object_only)
+			execlp("gcc", "gcc", "-m32", "-c", "-x", "assembler", "-", "-o",
+			       output, (char *)NULL);
+		else
+			execlp("gcc", "gcc", "-m32", "-x", "assembler", "-", "-x",
+			       "none", builtins, "-o", output, (char *)NULL);
 		// exec* only returns on error
 		perror("gcc");
-		exit(errno);
-	} else { // parent
-		int wstatus;
-		if (waitpid(pid, &wstatus, 0) < 0) {
-			perror("waitpid");
+		_exit(errno);
+	}
+	close(fds[0]);
+	if (*pid < 0) {
+		perror("fork");
+		close(fds[1]);
+		return -1;
+	}
+	// A failing gcc is reported by its exit status, not by SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+	return fds[1];
+}
+
+/* Close the pipe to gcc and return its exit status */
+static int gcc_finish(int fd, pid_t pid)
+{
+	close(fd);
+	int wstatus;
+	if (waitpid(pid, &wstatus, 0) < 0) {
+		perror("waitpid");
+		return EXIT_FAILURE;
+	}
+	return WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : EXIT_FAILURE;
+}
+
+/* Pass assembly in memory to gcc */
+static int compile_gcc(char *assembly, size_t size, const char *output,
+                       int object_only)
+{
+	pid_t pid;
+	int fd = gcc_start(output, object_only, &pid);
+	if (fd < 0)
+		return EXIT_FAILURE;
+	struct mCc_writer writer;
+	mCc_writer_init_fd(&writer, fd);
+	mCc_writer_write(&writer, assembly, size);
+	mCc_writer_flush(&writer);
+	return gcc_finish(fd, pid);
+}
+
+/* Turn assembly into an executable or object, with gcc if needed */
+static int assemble(char *assembly, size_t size, const char *source,
+                    const char *output, int object_only, int use_gcc,
+                    const struct runtime *runtime)
+{
+	if (!use_gcc && compile_integrated(assembly, size, source, output,
+	                                   object_only, runtime) == 0)
+		return EXIT_SUCCESS;
+	return compile_gcc(assembly, size, output, object_only);
+}
+
+/* Generate the assembly and turn it into an executable or object */
+static int compile(struct mCc_context *ctx, struct mCc_tac_program *tac,
+                   char *filename, const char *output, int object_only,
+                   int use_gcc)
+{
+	struct mCc_writer writer;
+
+	// The integrated assembler works in memory, no temporary files
+	if (!use_gcc) {
+		char *assembly;
+		size_t size;
+		mCc_writer_init_memory(&writer);
+		mCc_asm_write_assembly(ctx, tac, &writer, filename);
+		if (!(assembly = mCc_writer_take_memory(&writer, &size))) {
+			fputs("Memory error while generating the assembly!\n", stderr);
 			return EXIT_FAILURE;
 		}
-		// return gcc's exit status
-		return WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : EXIT_FAILURE;
+		struct runtime runtime = { .data = NULL };
+		if (!object_only)
+			load_runtime(&runtime);
+		int ret = assemble(assembly, size, filename, output, object_only,
+		                   use_gcc, &runtime);
+		free(runtime.data);
+		free(assembly);
+		return ret;
 	}
+
+	// gcc assembles while the code is generated
+	pid_t pid;
+	int fd = gcc_start(output, object_only, &pid);
+	if (fd < 0)
+		return EXIT_FAILURE;
+	mCc_writer_init_fd(&writer, fd);
+	mCc_asm_write_assembly(ctx, tac, &writer, filename);
+	mCc_writer_flush(&writer);
+	return gcc_finish(fd, pid);
+}
+
+/* An input of a multi-file compilation */
+struct job {
+	const char *path;      ///< As given on the command line
+	char output[PATH_MAX]; ///< The executable or object
+};
+
+/* State shared by the workers of a multi-file compilation */
+struct job_pool {
+	struct job *jobs;
+	unsigned int count;
+	unsigned int next; ///< The next job to take, under lock
+	int failed;        ///< Whether any job failed, under lock
+	pthread_mutex_t lock;
+	unsigned int opt_level;
+	int object_only;
+	int use_gcc;
+	int stream;         ///< See mCc_compile_stream
+	enum mCc_parser_kind parser;
+	const char *server; ///< Socket of a compile server, or NULL
+	struct runtime runtime;
+	struct mCc_cache *cache;          ///< Or NULL
+	struct mCc_cache_key cache_base; ///< The common start of every key
+	struct mCc_func_cache *func_cache; ///< Backed by cache, or NULL
+};
+
+/* Name the output of path after the input without directory and extension,
+ * in the working directory, the directory out or the pattern out */
+static int job_output(const char *path, const char *out, int object_only,
+                      char *output, size_t size)
+{
+	char name[PATH_MAX];
+	snprintf(name, sizeof(name), "%s", path);
+	char *stem = basename(name);
+	char *ext = strrchr(stem, '.');
+	if (ext && ext != stem)
+		*ext = '\0';
+
+	const char *suffix = object_only ? ".o" : "";
+	const char *percent = out ? strchr(out, '%') : NULL;
+	int len;
+	if (!out)
+		len = snprintf(output, size, "%s%s", stem, suffix);
+	else if (percent)
+		len = snprintf(output, size, "%.*s%s%s", (int)(percent - out), out,
+		               stem, percent + 1);
+	else
+		len = snprintf(output, size, "%s/%s%s", out, stem, suffix);
+	return len < 0 || (size_t)len >= size;
+}
+
+static void print_diagnostics(const char *path, const struct mCc_output *output)
+{
+	for (unsigned int i = 0; i < output->diagnostic_count; ++i) {
+		const struct mCc_compile_diagnostic *diag = &output->diagnostics[i];
+		const struct mCc_ast_source_location *loc = &diag->loc;
+		if (diag->text)
+			fprintf(stderr,
+			        "Error in %s at %d:%d - %d:%d at \e[4m%s\e[24m: %s\n",
+			        path, loc->start_line, loc->start_col, loc->end_line,
+			        loc->end_col, diag->text, diag->message);
+		else if (loc->start_line)
+			fprintf(stderr, "Error in %s at %d:%d - %d:%d: %s\n", path,
+			        loc->start_line, loc->start_col, loc->end_line,
+			        loc->end_col, diag->message);
+		else
+			fprintf(stderr, "Error in %s: %s\n", path, diag->message);
+	}
+	if (output->status != MCC_COMPILE_STATUS_OK && !output->diagnostic_count)
+		fprintf(stderr, "Error in %s: Memory error!\n", path);
+}
+
+/* Compile one function after the other, then assemble */
+static int compile_stream(struct mCc_source *source, char *filename,
+                          const char *path, unsigned int opt_level,
+                          enum mCc_parser_kind parser, const char *output,
+                          int object_only, int use_gcc)
+{
+	struct mCc_context *ctx = mCc_context_new();
+	if (!ctx) {
+		fputs("Memory error while creating the context!\n", stderr);
+		return EXIT_FAILURE;
+	}
+	struct mCc_compile_options options =
+	    mCc_compile_default_options(opt_level);
+	options.source_name = filename;
+	options.parser = parser;
+
+	// Nothing is assembled unless all functions compile
+	struct mCc_writer writer;
+	struct mCc_output diagnostics;
+	mCc_writer_init_memory(&writer);
+	mCc_compile_stream(ctx, source, &options, &writer, &diagnostics);
+	mCc_context_delete(ctx);
+	size_t size;
+	char *assembly = mCc_writer_take_memory(&writer, &size);
+	print_diagnostics(path, &diagnostics);
+
+	int ret = EXIT_FAILURE;
+	if (diagnostics.status == MCC_COMPILE_STATUS_OK && !assembly) {
+		fputs("Memory error while generating the assembly!\n", stderr);
+	} else if (diagnostics.status == MCC_COMPILE_STATUS_OK) {
+		struct runtime runtime = { .data = NULL };
+		if (!object_only && !use_gcc)
+			load_runtime(&runtime);
+		ret = assemble(assembly, size, filename, output, object_only,
+		               use_gcc, &runtime);
+		free(runtime.data);
+	}
+	free(assembly);
+	mCc_output_free(&diagnostics);
+	return ret;
+}
+
+/* Add what identifies this compiler to a key: every file mapped as code,
+ * i.e. mCc, libmCc if it is shared and the C library */
+static void add_compiler_identity(struct mCc_cache_key *key)
+{
+	FILE *maps = fopen("/proc/self/maps", "r");
+	if (!maps)
+		return;
+	char line[PATH_MAX + 128];
+	while (fgets(line, sizeof(line), maps)) {
+		char perms[5];
+		int path = 0;
+		struct stat st;
+		line[strcspn(line, "\n")] = '\0';
+		if (sscanf(line, "%*s %4s %*s %*s %*s %n", perms, &path) != 1 ||
+		    perms[2] != 'x' || line[path] != '/' || stat(line + path, &st))
+			continue;
+		mCc_cache_key_add_string(key, line + path);
+		mCc_cache_key_add_uint(key, st.st_ino);
+		mCc_cache_key_add_uint(key, st.st_size);
+		mCc_cache_key_add_uint(key, st.st_mtim.tv_sec);
+		mCc_cache_key_add_uint(key, st.st_mtim.tv_nsec);
+	}
+	fclose(maps);
+}
+
+/* Write a cached output in place of compiling, 0 on a hit */
+static int restore_output(struct job_pool *pool,
+                          const struct mCc_cache_key *key, const struct job *job)
+{
+	char *data;
+	size_t size;
+	if (mCc_cache_get(pool->cache, key, &data, &size))
+		return 1;
+
+	// Like the integrated linker, replace the file instead of writing into
+	// one that may be running
+	unlink(job->output);
+	int fd = open(job->output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+	              pool->object_only ? 0666 : 0777);
+	int ret = fd < 0;
+	if (fd >= 0) {
+		struct mCc_writer writer;
+		mCc_writer_init_fd(&writer, fd);
+		mCc_writer_write(&writer, data, size);
+		ret = mCc_writer_flush(&writer) | close(fd);
+	}
+	if (ret)
+		perror(job->output);
+	free(data);
+	return ret;
+}
+
+/* Add a fresh output to the cache, failing to is not an error */
+static void store_output(struct mCc_cache *cache,
+                         const struct mCc_cache_key *key, const struct job *job)
+{
+	size_t size;
+	char *data = read_file(job->output, &size);
+	if (data)
+		mCc_cache_put(cache, key, data, size);
+	free(data);
+}
+
+/* Compile one input all the way to its output, on the server connected by
+ * *server_fd if there is one, which is -1 until the first input */
+static int compile_job(struct job_pool *pool, const struct job *job,
+                       int *server_fd)
+{
+	if (pool->server && *server_fd < 0 &&
+	    (*server_fd = mCc_client_connect(pool->server)) < 0) {
+		fprintf(stderr, "%s: %s\n", pool->server, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	size_t len;
+	char *src = read_file(job->path, &len);
+	if (!src) {
+		fprintf(stderr, "%s: %s\n", job->path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	char name[PATH_MAX];
+	snprintf(name, sizeof(name), "%s", job->path);
+	struct mCc_compile_options options =
+	    mCc_compile_default_options(pool->opt_level);
+	options.source_name =
+	    strcmp("-", job->path) == 0 ? "read from stdin" : basename(name);
+	options.func_cache = pool->func_cache;
+	options.stream = pool->stream;
+	options.parser = pool->parser;
+
+	// The name ends up in the assembly, so it is part of the key
+	struct mCc_cache_key key;
+	int cached = 0;
+	if (pool->cache) {
+		mCc_cache_key_init(&key);
+		mCc_cache_key_add(&key, pool->cache_base.data, pool->cache_base.size);
+		mCc_cache_key_add_string(&key, options.source_name);
+		mCc_cache_key_add_source(&key, src, len);
+		if (mCc_cache_key_finish(&key))
+			mCc_cache_key_free(&key);
+		else
+			cached = 1;
+	}
+	if (cached && !restore_output(pool, &key, job)) {
+		mCc_cache_key_free(&key);
+		free(src);
+		return EXIT_SUCCESS;
+	}
+
+	struct mCc_output output;
+	if (!pool->server) {
+		mCc_compile_string(src, len, &options, &output);
+	} else if (mCc_client_compile(*server_fd, src, len, &options, &output) ==
+	           MCC_COMPILE_STATUS_SERVER_ERROR) {
+		close(*server_fd);
+		*server_fd = -1;
+	}
+	free(src);
+	print_diagnostics(job->path, &output);
+
+	int ret = EXIT_FAILURE;
+	if (output.status == MCC_COMPILE_STATUS_OK)
+		ret = assemble(output.data, output.size, job->path, job->output,
+		               pool->object_only, pool->use_gcc, &pool->runtime);
+	mCc_output_free(&output);
+	if (cached) {
+		if (ret == EXIT_SUCCESS)
+			store_output(pool->cache, &key, job);
+		mCc_cache_key_free(&key);
+	}
+	return ret;
+}
+
+static void *compile_worker(void *arg)
+{
+	struct job_pool *pool = arg;
+	int server_fd = -1;
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		unsigned int i = pool->next < pool->count ? pool->next++ : pool->count;
+		pthread_mutex_unlock(&pool->lock);
+		if (i == pool->count)
+			break;
+
+		if (compile_job(pool, &pool->jobs[i], &server_fd) != EXIT_SUCCESS) {
+			pthread_mutex_lock(&pool->lock);
+			pool->failed = 1;
+			pthread_mutex_unlock(&pool->lock);
+		}
+	}
+	if (server_fd >= 0)
+		close(server_fd);
+	return NULL;
+}
+
+/* Compile the jobs of a pool with as many threads, using the cache in dir
+ * unless dir is NULL */
+static int run_jobs(struct job_pool *pool, unsigned int threads,
+                    const char *cache_dir)
+{
+	// Linking reuses the runtime that was read once
+	if (!pool->use_gcc && !pool->object_only)
+		load_runtime(&pool->runtime);
+	signal(SIGPIPE, SIG_IGN);
+	pthread_mutex_init(&pool->lock, NULL);
+
+	// Everything but the source that the output depends on; the server may
+	// be another build, so its outputs are not cached
+	struct mCc_cache cache;
+	if (cache_dir && !pool->server) {
+		const char *env = getenv("MCC_CACHE_SIZE");
+		uint64_t max_size = env && *env ? strtoull(env, NULL, 10) << 20
+		                                : MCC_CACHE_DEFAULT_MAX_SIZE;
+		struct mCc_cache_key *base = &pool->cache_base;
+		mCc_cache_key_init(base);
+		mCc_cache_key_add_string(base, "mCc");
+		mCc_cache_key_add_string(base, VERSION);
+		add_compiler_identity(base);
+		mCc_cache_key_add_uint(base, pool->opt_level);
+		mCc_cache_key_add_uint(base, pool->object_only);
+		mCc_cache_key_add_uint(base, pool->use_gcc);
+		mCc_cache_key_add_uint(base, pool->runtime.data
+		                       ? mCc_cache_hash(pool->runtime.data,
+		                                        pool->runtime.size)
+		                       : 0);
+		if (mCc_cache_key_finish(base)) {
+			mCc_cache_key_free(base);
+		} else if (mCc_cache_open(&cache, cache_dir, max_size)) {
+			fprintf(stderr, "%s: %s, not caching\n", cache_dir,
+			        strerror(errno));
+			mCc_cache_key_free(base);
+		} else {
+			pool->cache = &cache;
+		}
+	}
+
+	// The functions of a changed file are still found in the cache. Their
+	// assembly only depends on the compiler besides their fingerprint.
+	struct mCc_func_cache func_cache;
+	struct mCc_cache_key func_base;
+	if (pool->cache) {
+		mCc_cache_key_init(&func_base);
+		mCc_cache_key_add_string(&func_base, "mCc");
+		mCc_cache_key_add_string(&func_base, VERSION);
+		add_compiler_identity(&func_base);
+		if (!mCc_cache_key_finish(&func_base) &&
+		    !mCc_func_cache_init(&func_cache, pool->cache, &func_base))
+			pool->func_cache = &func_cache;
+		mCc_cache_key_free(&func_base);
+	}
+
+	// The main thread is one of the workers
+	if (threads > pool->count)
+		threads = pool->count;
+	pthread_t *workers = calloc(threads, sizeof(*workers));
+	unsigned int started = 0;
+	while (workers && started + 1 < threads &&
+	       !pthread_create(&workers[started], NULL, compile_worker, pool))
+		++started;
+	compile_worker(pool);
+	for (unsigned int i = 0; i < started; ++i)
+		pthread_join(workers[i], NULL);
+	free(workers);
+
+	if (pool->func_cache)
+		mCc_func_cache_free(pool->func_cache);
+	if (pool->cache) {
+		mCc_cache_close(pool->cache);
+		mCc_cache_key_free(&pool->cache_base);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->runtime.data);
+	return pool->failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Compile every input to its own output */
+static int compile_files(struct job_pool *pool, char **paths,
+                         unsigned int count, const char *out,
+                         unsigned int threads, const char *cache_dir)
+{
+	struct stat st;
+	if (out && !strchr(out, '%') && (stat(out, &st) || !S_ISDIR(st.st_mode))) {
+		fprintf(stderr, "With several files, -o must be a directory or "
+		                "contain %%: %s\n", out);
+		return EXIT_FAILURE;
+	}
+
+	if (!(pool->jobs = calloc(count, sizeof(*pool->jobs)))) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+	pool->count = count;
+	int ret = EXIT_FAILURE;
+	for (unsigned int i = 0; i < count; ++i) {
+		struct job *job = &pool->jobs[i];
+		job->path = paths[i];
+		if (strcmp("-", paths[i]) == 0) {
+			fputs("stdin can only be compiled on its own\n", stderr);
+			goto out;
+		}
+		if (job_output(paths[i], out, pool->object_only, job->output,
+		               sizeof(job->output))) {
+			fprintf(stderr, "%s: output name too long\n", paths[i]);
+			goto out;
+		}
+		for (unsigned int j = 0; j < i; ++j) {
+			if (strcmp(pool->jobs[j].output, job->output) == 0) {
+				fprintf(stderr, "%s and %s would both be written to %s\n",
+				        pool->jobs[j].path, paths[i], job->output);
+				goto out;
+			}
+		}
+	}
+	ret = run_jobs(pool, threads, cache_dir);
+
+out:
+	free(pool->jobs);
+	return ret;
+}
+
+/* The cache directory: $MCC_CACHE_DIR, $XDG_CACHE_HOME/mCc or ~/.cache/mCc */
+static const char *default_cache_dir(char *dir, size_t size)
+{
+	const char *env = getenv("MCC_CACHE_DIR");
+	if (env && *env)
+		return env;
+	if ((env = getenv("XDG_CACHE_HOME")) && *env)
+		snprintf(dir, size, "%s/mCc", env);
+	else if ((env = getenv("HOME")) && *env)
+		snprintf(dir, size, "%s/.cache/mCc", env);
+	else
+		return NULL;
+	return dir;
+}
+
+static int print_cache_stats(const char *dir)
+{
+	struct mCc_cache_stats stats;
+	if (mCc_cache_read_stats(dir, &stats)) {
+		perror(dir);
+		return EXIT_FAILURE;
+	}
+	printf("cache directory %s\n", dir);
+	printf("hits            %" PRIu64 "\n", stats.hits);
+	printf("misses          %" PRIu64 "\n", stats.misses);
+	printf("stores          %" PRIu64 "\n", stats.stores);
+	printf("entries         %" PRIu64 "\n", stats.entries);
+	printf("size            %" PRIu64 " bytes\n", stats.size);
+	return EXIT_SUCCESS;
+}
+
+/* Compile one input on a server, print or assemble and link the result */
+static int compile_client(const char *server, const char *path,
+                          unsigned int opt_level, enum mCc_parser_kind parser,
+                          FILE *asm_out, const char *out, int object_only,
+                          int use_gcc)
+{
+	size_t len;
+	char *src = read_file(path, &len);
+	if (!src) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	int fd = mCc_client_connect(server);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", server, strerror(errno));
+		free(src);
+		return EXIT_FAILURE;
+	}
+
+	char name[PATH_MAX];
+	snprintf(name, sizeof(name), "%s", path);
+	struct mCc_compile_options options = mCc_compile_default_options(opt_level);
+	options.source_name =
+	    strcmp("-", path) == 0 ? "read from stdin" : basename(name);
+	options.parser = parser;
+	struct mCc_output output;
+	mCc_client_compile(fd, src, len, &options, &output);
+	close(fd);
+	free(src);
+	print_diagnostics(path, &output);
+
+	int ret = EXIT_FAILURE;
+	if (output.status != MCC_COMPILE_STATUS_OK) {
+		// Reported above
+	} else if (asm_out) {
+		if (fwrite(output.data, 1, output.size, asm_out) == output.size)
+			ret = EXIT_SUCCESS;
+		else
+			perror("fwrite");
+	} else {
+		struct runtime runtime = { .data = NULL };
+		if (!use_gcc && !object_only)
+			load_runtime(&runtime);
+		ret = assemble(output.data, output.size, path, out, object_only,
+		               use_gcc, &runtime);
+		free(runtime.data);
+	}
+	mCc_output_free(&output);
+	return ret;
 }
 
 int main(int argc, char *argv[])
@@ -75,15 +829,22 @@ int main(int argc, char *argv[])
 
     FILE *op_out = NULL;
     int print_op = 0;
-	char str[100];
+	unsigned int opt_level = 0;
 
-	FILE *asm_out = fopen("a.s", "w");
+	FILE *asm_out = NULL;
 	int print_asm = 0;
-	if (!asm_out) {
-		perror("fopen");
-		return EXIT_FAILURE;
-	}
-	char *executable = "a.out";
+	char *executable = NULL;
+	int object_only = 0;
+	int use_gcc = 0;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	const char *server = NULL;
+	const char *client = NULL;
+	char cache_buf[PATH_MAX];
+	const char *cache_dir = NULL;
+	int use_cache = 0;
+	int cache_stats = 0;
+	int stream = 0;
+	enum mCc_parser_kind parser = MCC_PARSER_KIND_DEFAULT;
     char *optimization ="../doc/optimisation.md";
 
 	while (1) {
@@ -94,12 +855,22 @@ int main(int argc, char *argv[])
 			{ "print-tac", optional_argument, 0, 't' },
 			{ "print-symtab", optional_argument, 0, 's' },
 			{ "print-asm", optional_argument, 0, 'a' },
-			{ "print-cfg", optional_argument, 0, 'c' },
+			{ "print-cfg", optional_argument, 0, 'g' },
 			{ "output", required_argument, 0, 'o' },
-			{ "optimize", no_argument, 0, 'O' },
+			{ "compile-only", no_argument, 0, 'c' },
+			{ "use-gcc", no_argument, 0, 'G' },
+			{ "optimize", optional_argument, 0, 'O' },
+			{ "optimize-report", no_argument, 0, 'r' },
+			{ "jobs", required_argument, 0, 'j' },
+			{ "server", required_argument, 0, 'S' },
+			{ "client", required_argument, 0, 'C' },
+			{ "cache", optional_argument, 0, 'K' },
+			{ "cache-stats", optional_argument, 0, 'k' },
+			{ "parser", required_argument, 0, 'P' },
+			{ "stream", no_argument, 0, 'T' },
 			{ 0, 0, 0, 0 }
 		};
-		if ((c = getopt_long(argc, argv, "hvoOt:", long_options, NULL)) == -1)
+		if ((c = getopt_long(argc, argv, "hvo:cO::t:j:", long_options, NULL)) == -1)
 			break;
 
 		switch (c) {
@@ -113,7 +884,59 @@ int main(int argc, char *argv[])
 		case 'o':
 			executable = optarg;
 			break;
-        case 'O':
+		case 'c':
+			object_only = 1;
+			break;
+		case 'G':
+			use_gcc = 1;
+			break;
+		case 'S':
+			server = optarg;
+			break;
+		case 'C':
+			client = optarg;
+			break;
+		case 'K':
+		case 'k':
+			if (optarg)
+				cache_dir = optarg;
+			use_cache |= c == 'K';
+			cache_stats |= c == 'k';
+			break;
+		case 'P':
+			if (strcmp(optarg, "bison") == 0) {
+				parser = MCC_PARSER_KIND_BISON;
+			} else if (strcmp(optarg, "descent") == 0) {
+				parser = MCC_PARSER_KIND_DESCENT;
+			} else {
+				fprintf(stderr, "Invalid parser: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'T':
+			stream = 1;
+			break;
+		case 'j': {
+			char *end;
+			jobs = strtol(optarg, &end, 10);
+			if (*end || jobs < 1) {
+				fprintf(stderr, "Invalid number of jobs: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		}
+		case 'O':
+			if (!optarg) {
+				opt_level = 2;
+			} else if (strlen(optarg) != 1 || optarg[0] < '0' ||
+			           optarg[0] > '3') {
+				fprintf(stderr, "Invalid optimisation level: %s\n", optarg);
+				return EXIT_FAILURE;
+			} else {
+				opt_level = optarg[0] - '0';
+			}
+			break;
+        case 'r':
             if (!(op_out = fopen(optimization, "w"))) {
                 perror("fopen");
                 return EXIT_FAILURE;
@@ -147,7 +970,7 @@ int main(int argc, char *argv[])
 			}
 			print_asm = 1;
 			break;
-		case 'c':
+		case 'g':
 			if (!optarg || strcmp("-", optarg) == 0) {
 				cfg_out = stdout;
 			} else if (!(cfg_out = fopen(optarg, "w"))) {
@@ -158,40 +981,114 @@ int main(int argc, char *argv[])
 			break;
 		}
 	}
+	if (jobs < 1)
+		jobs = 1;
+	if (stream && client) {
+		// The server compiles whole programs for its function cache
+		fputs("--stream cannot be used with --client\n", stderr);
+		return EXIT_FAILURE;
+	}
+	if ((use_cache || cache_stats) && !cache_dir &&
+	    !(cache_dir = default_cache_dir(cache_buf, sizeof(cache_buf)))) {
+		fputs("No cache directory, set MCC_CACHE_DIR\n", stderr);
+		return EXIT_FAILURE;
+	}
+	if (cache_stats)
+		return print_cache_stats(cache_dir);
+	if (!use_cache)
+		cache_dir = NULL;
+	if (server) {
+		int fd = mCc_server_listen(server);
+		if (fd < 0) {
+			perror(server);
+			return EXIT_FAILURE;
+		}
+		int ret = mCc_server_run(fd, jobs);
+		close(fd);
+		return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
 	// Now, first non-option arg is in argv[optind]
 	if (optind >= argc) {
 		fputs("Missing required positional argument: <FILE>\n", stderr);
 		return EXIT_FAILURE;
 	}
+	const char *output = executable ? executable
+	                                : object_only ? "a.o" : "a.out";
+	int printing = print_st || print_tac || print_cfg || print_asm || print_op;
+	struct job_pool pool = {
+		.opt_level = opt_level,
+		.object_only = object_only,
+		.use_gcc = use_gcc,
+		.stream = stream,
+		.parser = parser,
+		.server = client,
+	};
+	if (argc - optind > 1) {
+		if (printing) {
+			fputs("Printing needs a single <FILE>\n", stderr);
+			return EXIT_FAILURE;
+		}
+		return compile_files(&pool, argv + optind, argc - optind, executable,
+		                     jobs, cache_dir);
+	}
+	if (cache_dir && !client && !printing) {
+		struct job job = { .path = argv[optind] };
+		if (snprintf(job.output, sizeof(job.output), "%s", output) >=
+		    (int)sizeof(job.output)) {
+			fprintf(stderr, "%s: output name too long\n", output);
+			return EXIT_FAILURE;
+		}
+		pool.jobs = &job;
+		pool.count = 1;
+		return run_jobs(&pool, 1, cache_dir);
+	}
+	if (client) {
+		if (print_st || print_tac || print_cfg || print_op) {
+			fputs("Only --print-asm can be used with --client\n", stderr);
+			return EXIT_FAILURE;
+		}
+		int ret = compile_client(client, argv[optind], opt_level, parser,
+		                         asm_out, output, object_only, use_gcc);
+		if (asm_out && asm_out != stdout)
+			fclose(asm_out);
+		return ret;
+	}
 
 	/* determine input source */
 	char *filename;
-	FILE *in;
-	if (strcmp("-", argv[optind]) == 0) {
-		in = stdin;
+	struct mCc_source source;
+	if (strcmp("-", argv[optind]) == 0)
 		filename = "read from stdin";
-	} else {
+	else
 		filename = basename(argv[optind]);
-		in = fopen(argv[optind], "r");
-		if (!in) {
-			perror("fopen");
-			return EXIT_FAILURE;
-		}
+	if (mCc_source_open(&source, argv[optind])) {
+		perror(argv[optind]);
+		return EXIT_FAILURE;
+	}
+	if (stream && !printing) {
+		int ret = compile_stream(&source, filename, argv[optind], opt_level,
+		                         parser, output, object_only, use_gcc);
+		mCc_source_close(&source);
+		return ret;
 	}
 
 	struct mCc_ast_program *prog = NULL;
 
 	/* parsing phase */
 	{
-		struct mCc_parser_result result = mCc_parser_parse_file(in);
+		struct mCc_parser_result result = mCc_parser_parse_source(&source, parser);
 		if(print_op){
-			rewind(in);
 			fprintf(op_out,"---------------------The input program---------------------\n");
-            while (fgets(str, 100, in) != NULL){
-                fprintf(op_out, "%s\n", str);
+            // In pieces of at most 99 characters, each ending a line
+            for (size_t pos = 0, n; pos < source.size; pos += n) {
+                n = source.size - pos < 99 ? source.size - pos : 99;
+                const char *nl = memchr(source.data + pos, '\n', n);
+                if (nl)
+                    n = nl + 1 - (source.data + pos);
+                fprintf(op_out, "%.*s\n", (int)n, source.data + pos);
 			}
 		}
-		fclose(in);
 		if (result.status != MCC_PARSER_STATUS_OK) {
 			fprintf(stderr,
 			        "Error in %s at %d:%d - %d:%d at \e[4m%s\e[24m: %s\n",
@@ -200,35 +1097,45 @@ int main(int argc, char *argv[])
 			        result.err_loc.end_col, result.err_text, result.err_msg);
 			free((void *)result.err_msg);
 			free((void *)result.err_text);
+			mCc_source_close(&source);
 
 			return EXIT_FAILURE;
 		}
 		if (result.program == NULL) {
 			fprintf(stderr, "Error in %s: Top-level is not a program!\n", argv[1]);
+			mCc_source_close(&source);
 			return EXIT_FAILURE;
 		}
 		prog = result.program;
 	}
 
+	struct mCc_context *ctx = mCc_context_new();
+	if (!ctx) {
+		fputs("Memory error while creating the context!\n", stderr);
+		mCc_ast_delete_program(prog);
+		return EXIT_FAILURE;
+	}
+
 	/* build symbol table */
-	struct mCc_ast_symtab_build_result link_result = mCc_ast_symtab_build(prog);
+	struct mCc_ast_symtab_build_result link_result =
+	    mCc_ast_symtab_build(ctx, prog);
 	if (link_result.status) {
 		fprintf(stderr, "Error in %s at %d:%d - %d:%d: %s\n", argv[1],
 		        link_result.err_loc.start_line, link_result.err_loc.start_col,
 		        link_result.err_loc.end_line, link_result.err_loc.end_col,
 		        link_result.err_msg);
-		mCc_symtab_delete_all_scopes();
+		mCc_context_delete(ctx);
 		mCc_ast_delete_program(prog);
 		return EXIT_FAILURE;
 	}
 	if (print_st)
-		mCc_symtab_print_all_scopes(st_out);
+		mCc_symtab_print_all_scopes(ctx, st_out);
 	if (st_out && st_out != stdout)
 		fclose(st_out);
 
 	/* type checking */
 	struct mCc_typecheck_result check_result =
-	    mCc_typecheck(prog, link_result.root_symtab);
+	    mCc_typecheck(ctx, prog, link_result.root_symtab);
 
 	if (check_result.status) {
 		fprintf(stderr, "Error in %s at %d:%d - %d:%d: %s\n", argv[1],
@@ -236,19 +1143,22 @@ int main(int argc, char *argv[])
 		        check_result.err_loc.end_line, check_result.err_loc.end_col,
 		        check_result.err_msg);
 
-		mCc_symtab_delete_all_scopes();
+		mCc_context_delete(ctx);
 		mCc_ast_delete_program(prog);
 		return EXIT_FAILURE;
 	}
+	/* the calls know their callees, the symbol tables can go */
+	mCc_symtab_delete_all_scopes(ctx);
+
 	/* three-addess code generation */
-	struct mCc_tac_program *tac = mCc_tac_build(prog);
+	struct mCc_tac_program *tac = mCc_tac_build(ctx, prog);
 	if (print_tac && tac)
 		mCc_tac_program_print(tac, tac_out);
 	else if (!tac) {
 		fputs("Memory error while building the TAC!\n", stderr);
 		if (tac_out && tac_out != stdout)
 			fclose(tac_out);
-		mCc_symtab_delete_all_scopes();
+		mCc_context_delete(ctx);
 		mCc_ast_delete_program(prog);
 		return EXIT_FAILURE;
 	}
@@ -297,26 +1207,38 @@ int main(int argc, char *argv[])
         fprintf(op_out, "---------------------The Three Address Code before optimizations---------------------\n");
         mCc_tac_program_print(tac, op_out);
     }
-	/*    TODO
-	 * - do some optimisations
-	 */
-
-	/* Assembler code generation */
-	mCc_asm_generate_assembly(tac, asm_out, filename);
-
-	if (asm_out && asm_out != stdout)
-		fclose(asm_out);
+	/* optimisations */
+	struct mCc_tac_opt_options opt_options =
+	    mCc_tac_opt_default_options(opt_level);
+	if (mCc_tac_optimize(tac, &opt_options)) {
+		fputs("Memory error while optimising the TAC!\n", stderr);
+		mCc_tac_program_delete(tac);
+		mCc_context_delete(ctx);
+		mCc_ast_delete_program(prog);
+		return EXIT_FAILURE;
+	}
+	if (print_op) {
+		fprintf(op_out, "---------------------The Three Address Code after optimizations---------------------\n");
+		mCc_tac_program_print(tac, op_out);
+		fclose(op_out);
+	}
 
+	/* Assembler code generation, only compile if nothing was printed */
 	int exit_status = EXIT_SUCCESS;
-	// Only compile if nothing was printed
-	if (!(print_st || print_tac || print_asm || print_cfg))
-		exit_status = compile("a.s", executable);
+	if (print_asm) {
+		mCc_asm_generate_assembly(ctx, tac, asm_out, filename);
+		if (asm_out != stdout)
+			fclose(asm_out);
+	} else if (!(print_st || print_tac || print_cfg)) {
+		exit_status = compile(ctx, tac, filename, output, object_only,
+		                      use_gcc);
+	}
 
 	/* cleanup */
 	mCc_tac_program_delete(tac);
-	mCc_tac_free_global_string_array();
-	mCc_symtab_delete_all_scopes();
+	mCc_context_delete(ctx);
 	mCc_ast_delete_program(prog);
+	mCc_source_close(&source);
 
 	return exit_status;
 }
@@ -0,0 +1,485 @@
+/**
+ * @file cache.c
+ * @brief Content-addressed on-disk cache of compiler outputs.
+ * @author richard
+ * @date 2018-06-29
+ */
+#include "mCc/cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/// Starts every entry, followed by the key size, the key and the data
+static const char entry_magic[] = "mCc cache 1\n";
+
+static const char entry_suffix[] = ".entry";
+
+/// Temporary files older than this were left by a crashed compiler
+static const time_t stale_tmp_seconds = 3600;
+
+uint64_t mCc_cache_hash(const void *data, size_t size) {
+    // 64-bit FNV-1a
+    const unsigned char *p = data;
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+/*********************************** Normalisation */
+
+/*
+ * End of a comment starting at i, or 0 if there is none. The lexer matches
+ * "/" "*" ([^*] | \*[^/])* "*" "/" and takes the longest match, so this
+ * follows the three states of that pattern to its last accepting position.
+ */
+static size_t mCc_cache_comment_end(const char *src, size_t i, size_t len) {
+    if (i + 1 >= len || src[i + 1] != '*')
+        return 0;
+
+    bool body = true;   // Before a [^*], a pair or the closing
+    bool pair = false;  // After the star of \*[^/]
+    bool close = false; // After the star of the closing
+    size_t end = 0;
+    for (size_t j = i + 2; j < len && (body || pair || close); ++j) {
+        char c = src[j];
+        if (close && c == '/')
+            end = j + 1;
+        bool next_body = (body && c != '*') || (pair && c != '/');
+        pair = close = body && c == '*';
+        body = next_body;
+    }
+    return end;
+}
+
+static bool mCc_cache_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* Tokens that are never part of a longer one, no space is needed next to
+ * them */
+static bool mCc_cache_is_delimiter(char c) {
+    return c && strchr(";,(){}[]", c);
+}
+
+size_t mCc_cache_normalise(const char *src, size_t len, char *out) {
+    size_t i = 0, n = 0;
+    bool space = false; // Tokens are separated here
+    while (i < len) {
+        size_t end;
+        if (mCc_cache_is_space(src[i])) {
+            space = true;
+            ++i;
+            continue;
+        }
+        if (src[i] == '/' && (end = mCc_cache_comment_end(src, i, len))) {
+            space = true;
+            i = end;
+            continue;
+        }
+
+        if (space && n && !mCc_cache_is_delimiter(out[n - 1]) &&
+            !mCc_cache_is_delimiter(src[i]))
+            out[n++] = ' ';
+        space = false;
+        if (src[i] == '"') {
+            // Copied as is, up to the end if it is not terminated
+            const char *quote = memchr(src + i + 1, '"', len - i - 1);
+            end = quote ? (size_t)(quote - src) + 1 : len;
+            memcpy(out + n, src + i, end - i);
+            n += end - i;
+            i = end;
+        } else {
+            out[n++] = src[i++];
+        }
+    }
+    return n;
+}
+
+/*********************************** Keys */
+
+void mCc_cache_key_init(struct mCc_cache_key *key) {
+    mCc_writer_init_memory(&key->writer);
+    key->data = NULL;
+    key->size = 0;
+    key->hash = 0;
+}
+
+void mCc_cache_key_add(struct mCc_cache_key *key, const void *data,
+                       size_t size) {
+    uint64_t size64 = size;
+    mCc_writer_write(&key->writer, &size64, sizeof(size64));
+    mCc_writer_write(&key->writer, data, size);
+}
+
+void mCc_cache_key_add_string(struct mCc_cache_key *key, const char *str) {
+    mCc_cache_key_add(key, str, strlen(str));
+}
+
+void mCc_cache_key_add_uint(struct mCc_cache_key *key, uint64_t value) {
+    mCc_cache_key_add(key, &value, sizeof(value));
+}
+
+void mCc_cache_key_add_source(struct mCc_cache_key *key, const char *src,
+                              size_t len) {
+    char *normal = malloc(len ? len : 1);
+    if (!normal) {
+        key->writer.error = true;
+        return;
+    }
+    mCc_cache_key_add(key, normal, mCc_cache_normalise(src, len, normal));
+    free(normal);
+}
+
+int mCc_cache_key_finish(struct mCc_cache_key *key) {
+    if (!(key->data = mCc_writer_take_memory(&key->writer, &key->size)))
+        return 1;
+    key->hash = mCc_cache_hash(key->data, key->size);
+    return 0;
+}
+
+void mCc_cache_key_free(struct mCc_cache_key *key) {
+    mCc_writer_close(&key->writer);
+    free(key->data);
+    key->data = NULL;
+}
+
+/*********************************** Files */
+
+/* The path of name in the cache directory, NULL if out of memory */
+static char *mCc_cache_path(const char *dir, const char *name) {
+    size_t size = strlen(dir) + strlen(name) + 2;
+    char *path = malloc(size);
+    if (path)
+        snprintf(path, size, "%s/%s", dir, name);
+    return path;
+}
+
+static char *mCc_cache_entry_path(const char *dir, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 "%s", hash, entry_suffix);
+    return mCc_cache_path(dir, name);
+}
+
+static bool mCc_cache_is_entry(const char *name) {
+    size_t len = strlen(name), suffix_len = strlen(entry_suffix);
+    return len > suffix_len &&
+           strcmp(name + len - suffix_len, entry_suffix) == 0;
+}
+
+static int mCc_cache_write_all(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size) {
+        ssize_t ret = write(fd, p, size);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return 1;
+        p += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+/* Read a whole file, NULL on error */
+static char *mCc_cache_read_all(int fd, size_t *size) {
+    struct stat st;
+    if (fstat(fd, &st))
+        return NULL;
+    char *data = malloc(st.st_size + 1);
+    if (!data)
+        return NULL;
+    size_t len = 0;
+    while (len < (size_t)st.st_size) {
+        ssize_t ret = read(fd, data + len, st.st_size - len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        len += ret;
+    }
+    if (len != (size_t)st.st_size) {
+        free(data);
+        return NULL;
+    }
+    *size = len;
+    return data;
+}
+
+/* mkdir -p */
+static int mCc_cache_make_dirs(const char *dir) {
+    char *path = strdup(dir);
+    if (!path)
+        return -1;
+    for (char *p = path + 1; *p; ++p) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        if (mkdir(path, 0777) && errno != EEXIST) {
+            free(path);
+            return -1;
+        }
+        *p = '/';
+    }
+    free(path);
+
+    struct stat st;
+    if (mkdir(dir, 0777) && errno != EEXIST)
+        return -1;
+    if (stat(dir, &st))
+        return -1;
+    if (!S_ISDIR(st.st_mode)) {
+        errno = ENOTDIR;
+        return -1;
+    }
+    return 0;
+}
+
+/*********************************** Cache */
+
+int mCc_cache_open(struct mCc_cache *cache, const char *dir,
+                   uint64_t max_size) {
+    if (mCc_cache_make_dirs(dir))
+        return -1;
+    if (!(cache->dir = strdup(dir)))
+        return -1;
+    cache->max_size = max_size;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    pthread_mutex_init(&cache->lock, NULL);
+    return 0;
+}
+
+static void mCc_cache_count(struct mCc_cache *cache, uint64_t *counter) {
+    pthread_mutex_lock(&cache->lock);
+    ++*counter;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int mCc_cache_get(struct mCc_cache *cache, const struct mCc_cache_key *key,
+                  char **data, size_t *size) {
+    char *path = mCc_cache_entry_path(cache->dir, key->hash);
+    int fd = path ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    free(path);
+
+    size_t entry_size;
+    char *entry = fd < 0 ? NULL : mCc_cache_read_all(fd, &entry_size);
+    size_t header = sizeof(entry_magic) - 1 + sizeof(uint64_t);
+    uint64_t key_size = 0;
+    if (entry && entry_size >= header)
+        memcpy(&key_size, entry + header - sizeof(key_size), sizeof(key_size));
+    if (!entry || entry_size < header ||
+        memcmp(entry, entry_magic, sizeof(entry_magic) - 1) ||
+        key_size != key->size || entry_size - header < key->size ||
+        memcmp(entry + header, key->data, key->size)) {
+        // Missing, damaged or a different key with the same hash
+        free(entry);
+        if (fd >= 0)
+            close(fd);
+        mCc_cache_count(cache, &cache->stats.misses);
+        return 1;
+    }
+
+    // Now the most recently used
+    futimens(fd, NULL);
+    close(fd);
+
+    *size = entry_size - header - key->size;
+    memmove(entry, entry + header + key->size, *size);
+    entry[*size] = '\0';
+    *data = entry;
+    mCc_cache_count(cache, &cache->stats.hits);
+    return 0;
+}
+
+int mCc_cache_put(struct mCc_cache *cache, const struct mCc_cache_key *key,
+                  const void *data, size_t size) {
+    char *tmp = mCc_cache_path(cache->dir, "tmp.XXXXXX");
+    char *path = mCc_cache_entry_path(cache->dir, key->hash);
+    int fd = tmp && path ? mkstemp(tmp) : -1;
+    if (fd < 0) {
+        free(tmp);
+        free(path);
+        return 1;
+    }
+
+    uint64_t key_size = key->size;
+    int ret = mCc_cache_write_all(fd, entry_magic, sizeof(entry_magic) - 1) ||
+              mCc_cache_write_all(fd, &key_size, sizeof(key_size)) ||
+              mCc_cache_write_all(fd, key->data, key->size) ||
+              mCc_cache_write_all(fd, data, size);
+    ret = close(fd) || ret;
+    // Readers see the old entry or the new one, never a part
+    if (ret || rename(tmp, path)) {
+        unlink(tmp);
+        ret = 1;
+    }
+    free(tmp);
+    free(path);
+
+    if (!ret)
+        mCc_cache_count(cache, &cache->stats.stores);
+    return ret;
+}
+
+/* Parse the statistics file, missing counters are 0 */
+static void mCc_cache_parse_stats(const char *text,
+                                  struct mCc_cache_stats *stats) {
+    sscanf(text, "hits %" SCNu64 " misses %" SCNu64 " stores %" SCNu64,
+           &stats->hits, &stats->misses, &stats->stores);
+}
+
+/* Add the counters of this process to the statistics file */
+static void mCc_cache_save_stats(struct mCc_cache *cache) {
+    char *path = mCc_cache_path(cache->dir, "stats");
+    int fd = path ? open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666) : -1;
+    free(path);
+    if (fd < 0)
+        return;
+
+    // Other compilers update it at the same time
+    struct flock lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+    if (fcntl(fd, F_SETLKW, &lock)) {
+        close(fd);
+        return;
+    }
+    size_t size;
+    char *text = mCc_cache_read_all(fd, &size);
+    struct mCc_cache_stats stats = {0};
+    if (text) {
+        text[size] = '\0';
+        mCc_cache_parse_stats(text, &stats);
+        free(text);
+    }
+    stats.hits += cache->stats.hits;
+    stats.misses += cache->stats.misses;
+    stats.stores += cache->stats.stores;
+
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf),
+                       "hits %" PRIu64 "\nmisses %" PRIu64 "\nstores %" PRIu64
+                       "\n",
+                       stats.hits, stats.misses, stats.stores);
+    if (!ftruncate(fd, 0) && lseek(fd, 0, SEEK_SET) == 0)
+        mCc_cache_write_all(fd, buf, len);
+    close(fd); // Releases the lock
+}
+
+struct mCc_cache_file {
+    char *name;
+    off_t size;
+    struct timespec mtime;
+};
+
+static int mCc_cache_compare_age(const void *a, const void *b) {
+    const struct mCc_cache_file *x = a, *y = b;
+    if (x->mtime.tv_sec != y->mtime.tv_sec)
+        return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+    if (x->mtime.tv_nsec != y->mtime.tv_nsec)
+        return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+/* Evict the least recently used entries until 90% of the limit are left,
+ * and remove stale temporary files */
+static void mCc_cache_trim(struct mCc_cache *cache) {
+    DIR *dir = opendir(cache->dir);
+    if (!dir)
+        return;
+
+    struct mCc_cache_file *files = NULL;
+    size_t count = 0, capacity = 0;
+    uint64_t total = 0;
+    time_t now = time(NULL);
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        struct stat st;
+        if (fstatat(dirfd(dir), ent->d_name, &st, 0) || !S_ISREG(st.st_mode))
+            continue;
+        if (strncmp(ent->d_name, "tmp.", 4) == 0) {
+            if (now - st.st_mtime > stale_tmp_seconds)
+                unlinkat(dirfd(dir), ent->d_name, 0);
+            continue;
+        }
+        if (!mCc_cache_is_entry(ent->d_name))
+            continue;
+        if (count == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            struct mCc_cache_file *tmp =
+                    realloc(files, capacity * sizeof(*tmp));
+            if (!tmp)
+                goto out;
+            files = tmp;
+        }
+        if (!(files[count].name = strdup(ent->d_name)))
+            goto out;
+        files[count].size = st.st_size;
+        files[count].mtime = st.st_mtim;
+        total += st.st_size;
+        ++count;
+    }
+
+    if (total > cache->max_size) {
+        qsort(files, count, sizeof(*files), mCc_cache_compare_age);
+        uint64_t target = cache->max_size - cache->max_size / 10;
+        for (size_t i = 0; i < count && total > target; ++i) {
+            if (!unlinkat(dirfd(dir), files[i].name, 0))
+                total -= files[i].size;
+        }
+    }
+
+out:
+    for (size_t i = 0; i < count; ++i)
+        free(files[i].name);
+    free(files);
+    closedir(dir);
+}
+
+void mCc_cache_close(struct mCc_cache *cache) {
+    if (cache->stats.hits || cache->stats.misses || cache->stats.stores)
+        mCc_cache_save_stats(cache);
+    if (cache->stats.stores)
+        mCc_cache_trim(cache);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->dir);
+    cache->dir = NULL;
+}
+
+int mCc_cache_read_stats(const char *dir, struct mCc_cache_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    DIR *d = opendir(dir);
+    if (!d)
+        return -1;
+
+    int fd = openat(dirfd(d), "stats", O_RDONLY | O_CLOEXEC);
+    size_t size;
+    char *text = fd < 0 ? NULL : mCc_cache_read_all(fd, &size);
+    if (text) {
+        text[size] = '\0';
+        mCc_cache_parse_stats(text, stats);
+        free(text);
+    }
+    if (fd >= 0)
+        close(fd);
+
+    struct dirent *ent;
+    while ((ent = readdir(d))) {
+        struct stat st;
+        if (mCc_cache_is_entry(ent->d_name) &&
+            !fstatat(dirfd(d), ent->d_name, &st, 0)) {
+            ++stats->entries;
+            stats->size += st.st_size;
+        }
+    }
+    closedir(d);
+    return 0;
+}
@@ -1,22 +1,31 @@
 #include "mCc/cfg_print.h"
 
-static int first_func = 1;
-
 void mCc_cfg_program_print(struct mCc_tac_program *self, FILE *out) {
     assert(self);
     assert(out);
+    struct mCc_writer writer;
+    mCc_writer_init_file(&writer, out);
+    mCc_cfg_program_write(self, &writer);
+    mCc_writer_flush(&writer);
+}
+
+void mCc_cfg_program_write(struct mCc_tac_program *self,
+                           struct mCc_writer *out) {
+    assert(self);
+    assert(out);
+    int first_func = 1;
     for (unsigned int i = 0; i < self->quad_count; i++) {
-        mCc_cfg_quad_print(self, self->quads[i], out);
+        mCc_cfg_quad_print(self, self->quads[i], out, &first_func);
     }
-        fprintf(out, "\"];\n");
+        mCc_writer_puts(out, "\"];\n");
     mCc_cfg_print_connections(self, out);
-    fprintf(out, "}\n");
-    first_func = 1;
+    mCc_writer_puts(out, "}\n");
 }
 
-void mCc_cfg_print_connections(struct mCc_tac_program *self, FILE *out) {
+void mCc_cfg_print_connections(struct mCc_tac_program *self,
+                               struct mCc_writer *out) {
     for (unsigned int i = 0; i < self->cfg_count; i++) {
-        fprintf(out, "%s", self->cfgs[i]);
+        mCc_writer_puts(out, self->cfgs[i]);
     }
 }
 
@@ -31,120 +40,76 @@ int mCc_cfg_has_connection(struct mCc_tac_program *prog, struct mCc_tac_quad *qu
     return 0;
 }
 
-void mCc_cfg_print_literal(struct mCc_tac_quad *self, FILE *out) {
+/* Emit text followed by a number, e.g. a temporary */
+static void mCc_cfg_print_num(struct mCc_writer *out, const char *text,
+                              int number) {
+    mCc_writer_puts(out, text);
+    mCc_writer_int(out, number);
+}
+
+/* Emit the start of the node label, e.g. L3 [shape=box label=" */
+static void mCc_cfg_print_node(struct mCc_tac_quad *quad,
+                               struct mCc_writer *out) {
+    mCc_writer_puts(out, quad->cfg_node.label_name);
+    mCc_writer_int(out, quad->cfg_node.number);
+    mCc_writer_puts(out, " [shape=box label=\"");
+}
+
+void mCc_cfg_print_literal(struct mCc_tac_quad *self, struct mCc_writer *out) {
+    if (self->literal->type == MCC_TAC_QUAD_LIT_VOID)
+        return;
+    mCc_cfg_print_num(out, "t", self->result.ref.number);
     switch (self->literal->type) {
         case MCC_TAC_QUAD_LIT_INT:
-            fprintf(out, "t%d = %d\\l", self->result.ref.number,
-                    self->literal->ival);
+            mCc_cfg_print_num(out, " = ", self->literal->ival);
             break;
         case MCC_TAC_QUAD_LIT_FLOAT:
-            fprintf(out, "t%d = %f\\l", self->result.ref.number,
-                    self->literal->fval);
+            mCc_writer_printf(out, " = %f", self->literal->fval);
             break;
         case MCC_TAC_QUAD_LIT_BOOL:
-            fprintf(out, "t%d = %s\\l", self->result.ref.number,
-                    self->literal->bval ? "true" : "false");
+            mCc_writer_puts(out, self->literal->bval ? " = true" : " = false");
             break;
         case MCC_TAC_QUAD_LIT_STR:
-            fprintf(out, "t%d = \\\"%s\\\"\\l", self->result.ref.number,
-                    self->literal->strval);
+            mCc_writer_puts(out, " = \\\"");
+            mCc_writer_puts(out, self->literal->strval);
+            mCc_writer_puts(out, "\\\"");
             break;
         case MCC_TAC_QUAD_LIT_VOID:
             break;
     }
-    return;
+    mCc_writer_puts(out, "\\l");
 }
 
-void mCc_cfg_print_unary_op(struct mCc_tac_quad *self, FILE *out) {
+void mCc_cfg_print_unary_op(struct mCc_tac_quad *self, struct mCc_writer *out) {
+    mCc_cfg_print_num(out, "t", self->result.ref.number);
     switch (self->un_op) {
         case MCC_TAC_OP_UNARY_NEG:
-            fprintf(out, "t%d = -t%d\\l", self->result.ref.number,
-                    self->arg1.number);
+            mCc_cfg_print_num(out, " = -t", self->arg1.number);
             break;
         case MCC_TAC_OP_UNARY_NOT:
-            fprintf(out, "t%d = !t%d\\l", self->result.ref.number,
-                    self->arg1.number);
+            mCc_cfg_print_num(out, " = !t", self->arg1.number);
             break;
     }
-    return;
+    mCc_writer_puts(out, "\\l");
 }
 
-void mCc_cfg_print_bin_op(struct mCc_tac_quad *self, FILE *out) {
-    switch (self->bin_op) {
-        case MCC_TAC_OP_BINARY_ADD:
-            fprintf(out, "\tt%d = t%d + t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_SUB:
-            fprintf(out, "\tt%d = t%d - t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_MUL:
-            fprintf(out, "\tt%d = t%d * t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_DIV:
-            fprintf(out, "t%d = t%d / t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_LT:
-            fprintf(out, "t%d = t%d < t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_GT:
-            fprintf(out, "t%d = t%d > t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_LEQ:
-            fprintf(out, "t%d = t%d <= t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_GEQ:
-            fprintf(out, "t%d = t%d >= t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_AND:
-            fprintf(out, "t%d = t%d && t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_OR:
-            fprintf(out, "t%d = t%d || t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_EQ:
-            fprintf(out, "t%d = t%d == t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_NEQ:
-            fprintf(out, "t%d = t%d != t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_FLOAT_ADD:
-            fprintf(out, "t%d = t%d + t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_FLOAT_SUB:
-            fprintf(out, "t%d = t%d - t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_FLOAT_MUL:
-            fprintf(out, "t%d = t%d * t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_FLOAT_DIV:
-            fprintf(out, "t%d = t%d / t%d\\l", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-    }
-    return;
+void mCc_cfg_print_bin_op(struct mCc_tac_quad *self, struct mCc_writer *out) {
+    mCc_cfg_print_num(out, "t", self->result.ref.number);
+    mCc_cfg_print_num(out, " = t", self->arg1.number);
+    mCc_writer_putc(out, ' ');
+    mCc_writer_puts(out, mCc_tac_binary_op_symbol(self->bin_op));
+    mCc_cfg_print_num(out, " t", self->arg2.number);
+    mCc_writer_puts(out, "\\l");
 }
 
-void mCc_cfg_quad_print(struct mCc_tac_program *prog, struct mCc_tac_quad *quad, FILE *out) {
+void mCc_cfg_quad_print(struct mCc_tac_program *prog, struct mCc_tac_quad *quad,
+                        struct mCc_writer *out, int *first_func) {
 
     switch (quad->type) {
         case MCC_TAC_QUAD_ASSIGN:
-            fprintf(out, "t%d = t%d\\l", quad->result.ref.number,
-                    quad->arg1.number);
+            mCc_cfg_print_num(out, "t", quad->result.ref.number);
+            mCc_cfg_print_num(out, " = t", quad->arg1.number);
+            mCc_writer_puts(out, "\\l");
             break;
         case MCC_TAC_QUAD_ASSIGN_LIT:
             mCc_cfg_print_literal(quad, out);
@@ -162,53 +127,78 @@ void mCc_cfg_quad_print(struct mCc_tac_program *prog, struct mCc_tac_quad *quad,
             if (quad->result.label.num > -1) {
                 if(mCc_cfg_has_connection(prog, quad)){
 
-                    fprintf(out, "\"];\n");
-                    fprintf(out, "%s%d [shape=box label=\"", quad->cfg_node.label_name, quad->cfg_node.number);
+                    mCc_writer_puts(out, "\"];\n");
+                    mCc_cfg_print_node(quad, out);
                 }
             } else {
-                if (first_func) {
-                    first_func = 0;
-                    fprintf(out, "strict digraph \"%s\" {\n", quad->result.label.str);
-                    fprintf(out, "%s [label=\"Start %s\"];\n", quad->result.label.str,
-                            quad->result.label.str);
-
+                if (*first_func) {
+                    *first_func = 0;
+                    mCc_writer_puts(out, "strict digraph \"");
+                    mCc_writer_puts(out, quad->result.label.str);
+                    mCc_writer_puts(out, "\" {\n");
                 } else {
-                    fprintf(out, "\"];\n%s [label=\"Start %s\"];\n", quad->result.label.str,
-                            quad->result.label.str);
-
+                    mCc_writer_puts(out, "\"];\n");
                 }
-                fprintf(out, "%s%d [shape=box label=\"", quad->cfg_node.label_name, quad->cfg_node.number);
+                mCc_writer_puts(out, quad->result.label.str);
+                mCc_writer_puts(out, " [label=\"Start ");
+                mCc_writer_puts(out, quad->result.label.str);
+                mCc_writer_puts(out, "\"];\n");
+                mCc_cfg_print_node(quad, out);
             }
 
             break;
         case MCC_TAC_QUAD_JUMP:
             break;
         case MCC_TAC_QUAD_JUMPFALSE:
-            fprintf(out, "\"];\n");
-            fprintf(out, "%s%d [shape=box label=\"", quad->cfg_node.label_name, quad->cfg_node.number);
+        case MCC_TAC_QUAD_JUMPTRUE:
+            mCc_writer_puts(out, "\"];\n");
+            mCc_cfg_print_node(quad, out);
             break;
         case MCC_TAC_QUAD_PARAM:
-            fprintf(out, "param t%d\\l", quad->arg1.number);
+            mCc_cfg_print_num(out, "param t", quad->arg1.number);
+            mCc_writer_puts(out, "\\l");
             break;
         case MCC_TAC_QUAD_LOAD:
-            fprintf(out, "t%d = t%d[t%d]\\l", quad->result.ref.number,
-                    quad->arg1.number, quad->arg2.number);
+            mCc_cfg_print_num(out, "t", quad->result.ref.number);
+            mCc_cfg_print_num(out, " = t", quad->arg1.number);
+            mCc_cfg_print_num(out, "[t", quad->arg2.number);
+            mCc_writer_puts(out, "]\\l");
             break;
         case MCC_TAC_QUAD_STORE:
-            fprintf(out, "t%d[t%d] = t%d\\l", quad->result.ref.number,
-                    quad->arg2.number, quad->arg1.number);
+            mCc_cfg_print_num(out, "t", quad->result.ref.number);
+            mCc_cfg_print_num(out, "[t", quad->arg2.number);
+            mCc_cfg_print_num(out, "] = t", quad->arg1.number);
+            mCc_writer_puts(out, "\\l");
             break;
         case MCC_TAC_QUAD_CALL:
-            if (quad->arg1.number >= 0)
-                fprintf(out, "t%d = call %s\\l", quad->arg1.number, quad->result.label.str);
-            else
-                fprintf(out, "call %s\\l", quad->result.label.str);
+            if (quad->arg1.number >= 0) {
+                mCc_cfg_print_num(out, "t", quad->arg1.number);
+                mCc_writer_puts(out, " = ");
+            }
+            mCc_writer_puts(out, "call ");
+            mCc_writer_puts(out, quad->result.label.str);
+            mCc_writer_puts(out, "\\l");
             break;
         case MCC_TAC_QUAD_RETURN:
-            fprintf(out, "return t%d", quad->arg1.number);
+            mCc_cfg_print_num(out, "return t", quad->arg1.number);
             break;
         case MCC_TAC_QUAD_RETURN_VOID:
-            fprintf(out, "return");
+            mCc_writer_puts(out, "return");
+            break;
+        case MCC_TAC_QUAD_SELECT:
+            mCc_cfg_print_num(out, "t", quad->result.ref.number);
+            mCc_cfg_print_num(out, " = t", quad->select_cond);
+            mCc_cfg_print_num(out, " ? t", quad->arg1.number);
+            mCc_cfg_print_num(out, " : t", quad->arg2.number);
+            mCc_writer_puts(out, "\\l");
+            break;
+        case MCC_TAC_QUAD_VECTOR_ZERO:
+        case MCC_TAC_QUAD_VECTOR_SPLAT:
+        case MCC_TAC_QUAD_VECTOR_LOAD:
+        case MCC_TAC_QUAD_VECTOR_OP:
+        case MCC_TAC_QUAD_VECTOR_STORE:
+        case MCC_TAC_QUAD_VECTOR_REDUCE:
+            // Only created by optimisations, after the CFG is printed
             break;
     }
 
@@ -0,0 +1,468 @@
+/**
+ * @file compile.c
+ * @brief In-process compilation of a source buffer.
+ * @author richard
+ * @date 2018-06-26
+ */
+#include "mCc/compile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mCc/asm.h"
+#include "mCc/ast_symtab_link.h"
+#include "mCc/context.h"
+#include "mCc/elf.h"
+#include "mCc/func_cache.h"
+#include "mCc/parser.h"
+#include "mCc/source.h"
+#include "mCc/symtab.h"
+#include "mCc/tac_builder.h"
+#include "mCc/tac_opt.h"
+#include "mCc/typecheck.h"
+#include "mCc/x86_asm.h"
+
+struct mCc_compile_options mCc_compile_default_options(unsigned int opt_level) {
+    struct mCc_compile_options options = {
+        .source_name = "<string>",
+        .opt_level = opt_level,
+        .output_kind = MCC_COMPILE_OUTPUT_ASSEMBLY,
+        .parser = MCC_PARSER_KIND_DEFAULT,
+        .func_cache = NULL,
+        .stream = 0,
+    };
+    return options;
+}
+
+/* Record a diagnostic, the strings are copied. Returns its status. */
+static enum mCc_compile_status
+mCc_compile_diagnose(struct mCc_output *output, enum mCc_compile_status status,
+                     struct mCc_ast_source_location loc, const char *message,
+                     const char *text) {
+    struct mCc_compile_diagnostic *tmp =
+        realloc(output->diagnostics,
+                (output->diagnostic_count + 1) * sizeof(*tmp));
+    if (!tmp)
+        return output->status = MCC_COMPILE_STATUS_MEMORY_ERROR;
+    output->diagnostics = tmp;
+
+    struct mCc_compile_diagnostic *diag = &tmp[output->diagnostic_count++];
+    diag->status = status;
+    diag->loc = loc;
+    diag->message = strdup(message ? message : "");
+    diag->text = text ? strdup(text) : NULL;
+    if (output->status == MCC_COMPILE_STATUS_OK)
+        output->status = status;
+    return output->status;
+}
+
+static enum mCc_compile_status
+mCc_compile_out_of_memory(struct mCc_output *output, const char *stage) {
+    struct mCc_ast_source_location loc = {0};
+    char message[64];
+    snprintf(message, sizeof(message), "Memory error while %s", stage);
+    return mCc_compile_diagnose(output, MCC_COMPILE_STATUS_MEMORY_ERROR, loc,
+                                message, NULL);
+}
+
+/* The program of a parse, or NULL after recording why there is none */
+static struct mCc_ast_program *
+mCc_compile_parsed(struct mCc_parser_result result, struct mCc_output *output) {
+    if (result.status != MCC_PARSER_STATUS_OK) {
+        mCc_compile_diagnose(output, MCC_COMPILE_STATUS_PARSE_ERROR,
+                             result.err_loc,
+                             result.err_msg ? result.err_msg
+                                            : "Unable to parse the input",
+                             result.err_text);
+        free((void *)result.err_msg);
+        free((void *)result.err_text);
+        if (result.program)
+            mCc_ast_delete_program(result.program);
+        return NULL;
+    }
+    if (!result.program) {
+        struct mCc_ast_source_location loc = {0};
+        mCc_compile_diagnose(output, MCC_COMPILE_STATUS_PARSE_ERROR, loc,
+                             "Top-level is not a program", NULL);
+        if (result.statement)
+            mCc_ast_delete_statement(result.statement);
+        if (result.expression)
+            mCc_ast_delete_expression(result.expression);
+    }
+    return result.program;
+}
+
+static struct mCc_ast_program *mCc_compile_parse(const char *src, size_t len,
+                                                 enum mCc_parser_kind kind,
+                                                 struct mCc_output *output) {
+    return mCc_compile_parsed(mCc_parser_parse_buffer(src, len, kind), output);
+}
+
+/* Assemble in memory and serialise the object into output */
+static enum mCc_compile_status
+mCc_compile_object(char *assembly, size_t size, struct mCc_output *output) {
+    struct mCc_elf_error error;
+    struct mCc_elf_object *obj = NULL;
+    FILE *in = NULL, *out = NULL;
+    char *data = NULL;
+    size_t data_size = 0;
+
+    if (!(in = fmemopen(assembly, size, "r")) ||
+        !(obj = mCc_elf_object_new()) ||
+        !(out = open_memstream(&data, &data_size))) {
+        mCc_compile_out_of_memory(output, "assembling");
+        goto out;
+    }
+    if (mCc_x86_assemble(in, obj, &error)) {
+        struct mCc_ast_source_location loc = {0};
+        char message[sizeof(error.msg) + 32];
+        snprintf(message, sizeof(message), "assembly line %u: %s", error.line,
+                 error.msg);
+        mCc_compile_diagnose(output, MCC_COMPILE_STATUS_ASSEMBLER_ERROR, loc,
+                             message, NULL);
+        goto out;
+    }
+    int ret = mCc_elf_write_object(obj, out);
+    if (fclose(out) || ret) {
+        out = NULL;
+        mCc_compile_out_of_memory(output, "writing the object");
+        goto out;
+    }
+    out = NULL;
+    output->data = data;
+    output->size = data_size;
+    data = NULL;
+
+out:
+    if (out)
+        fclose(out);
+    free(data);
+    if (in)
+        fclose(in);
+    if (obj)
+        mCc_elf_object_delete(obj);
+    return output->status;
+}
+
+/* Write the assembly of a checked function, returns what failed or NULL */
+static const char *
+mCc_compile_function(struct mCc_context *ctx,
+                     struct mCc_ast_function_def *fun_def,
+                     const struct mCc_tac_opt_options *opt_options,
+                     struct mCc_writer *writer) {
+    struct mCc_tac_program *tac = mCc_tac_build_function(ctx, fun_def);
+    if (!tac)
+        return "building the TAC";
+    if (mCc_tac_optimize(tac, opt_options)) {
+        mCc_tac_program_delete(tac);
+        return "optimising the TAC";
+    }
+    if (tac->quad_count)
+        mCc_asm_write_function(ctx, tac, 0, tac->quad_count, writer);
+    mCc_tac_program_delete(tac);
+    return NULL;
+}
+
+/* Write the assembly of a checked program, returns what failed or NULL */
+static const char *
+mCc_compile_assembly(struct mCc_context *ctx, struct mCc_ast_program *prog,
+                     const struct mCc_compile_options *options,
+                     struct mCc_writer *writer) {
+    struct mCc_tac_opt_options opt_options =
+        mCc_tac_opt_default_options(options->opt_level);
+    if (options->func_cache)
+        return mCc_func_cache_write_assembly(options->func_cache, ctx, prog,
+                                             &opt_options, writer,
+                                             options->source_name)
+                   ? "generating a function"
+                   : NULL;
+
+    struct mCc_tac_program *tac = mCc_tac_build(ctx, prog);
+    if (!tac)
+        return "building the TAC";
+    if (mCc_tac_optimize(tac, &opt_options)) {
+        mCc_tac_program_delete(tac);
+        return "optimising the TAC";
+    }
+    mCc_asm_write_assembly(ctx, tac, writer, (char *)options->source_name);
+    mCc_tac_program_delete(tac);
+    return NULL;
+}
+
+static enum mCc_compile_status
+mCc_compile_program(struct mCc_context *ctx, struct mCc_ast_program *prog,
+                    const struct mCc_compile_options *options,
+                    struct mCc_output *output) {
+    struct mCc_ast_symtab_build_result link_result =
+        mCc_ast_symtab_build(ctx, prog);
+    if (link_result.status)
+        return mCc_compile_diagnose(output, MCC_COMPILE_STATUS_SYMTAB_ERROR,
+                                    link_result.err_loc, link_result.err_msg,
+                                    NULL);
+
+    struct mCc_typecheck_result check_result =
+        mCc_typecheck(ctx, prog, link_result.root_symtab);
+    if (check_result.status)
+        return mCc_compile_diagnose(output, MCC_COMPILE_STATUS_TYPE_ERROR,
+                                    check_result.err_loc, check_result.err_msg,
+                                    NULL);
+    // The calls know their callees, nothing after this needs the scopes
+    mCc_symtab_delete_all_scopes(ctx);
+
+    struct mCc_writer *writer = malloc(sizeof(*writer));
+    if (!writer)
+        return mCc_compile_out_of_memory(output, "generating the assembly");
+    mCc_writer_init_memory(writer);
+    const char *error = mCc_compile_assembly(ctx, prog, options, writer);
+    if (error) {
+        mCc_writer_close(writer);
+        free(writer);
+        return mCc_compile_out_of_memory(output, error);
+    }
+
+    size_t size;
+    char *assembly = mCc_writer_take_memory(writer, &size);
+    free(writer);
+    if (!assembly)
+        return mCc_compile_out_of_memory(output, "generating the assembly");
+
+    if (options->output_kind == MCC_COMPILE_OUTPUT_OBJECT) {
+        mCc_compile_object(assembly, size, output);
+        free(assembly);
+    } else {
+        output->data = assembly;
+        output->size = size;
+    }
+    return output->status;
+}
+
+/* A compilation handed the functions one at a time by the parser */
+struct mCc_compile_stream {
+    struct mCc_context *ctx;
+    struct mCc_source *source;
+    const struct mCc_compile_options *options;
+    struct mCc_tac_opt_options opt_options;
+    struct mCc_writer *writer;
+    struct mCc_output *output;
+    unsigned int written; ///< Number of functions written so far
+};
+
+/* Declare the functions and start the assembly, 0 on success */
+static int mCc_compile_stream_signatures(struct mCc_ast_program *prog,
+                                         void *userdata) {
+    struct mCc_compile_stream *stream = userdata;
+    struct mCc_ast_symtab_build_result link_result =
+        mCc_ast_symtab_declare(stream->ctx, prog);
+    if (link_result.status)
+        return mCc_compile_diagnose(stream->output,
+                                    MCC_COMPILE_STATUS_SYMTAB_ERROR,
+                                    link_result.err_loc, link_result.err_msg,
+                                    NULL);
+
+    struct mCc_typecheck_result check_result = mCc_typecheck_main(
+        stream->ctx, link_result.root_symtab, stream->source);
+    if (check_result.status)
+        return mCc_compile_diagnose(stream->output,
+                                    MCC_COMPILE_STATUS_TYPE_ERROR,
+                                    check_result.err_loc, check_result.err_msg,
+                                    NULL);
+
+    mCc_asm_write_header(stream->writer, stream->options->source_name);
+    return 0;
+}
+
+/* Compile a function and free it, 0 on success */
+static int mCc_compile_stream_function(struct mCc_ast_function_def *func,
+                                       void *userdata) {
+    struct mCc_compile_stream *stream = userdata;
+    struct mCc_ast_symtab_build_result link_result =
+        mCc_ast_symtab_build_function(stream->ctx, func);
+    if (link_result.status) {
+        mCc_ast_delete_func_def(func);
+        return mCc_compile_diagnose(stream->output,
+                                    MCC_COMPILE_STATUS_SYMTAB_ERROR,
+                                    link_result.err_loc, link_result.err_msg,
+                                    NULL);
+    }
+
+    struct mCc_typecheck_result check_result =
+        mCc_typecheck_function(stream->ctx, func, stream->source);
+    if (check_result.status) {
+        mCc_ast_delete_func_def(func);
+        return mCc_compile_diagnose(stream->output,
+                                    MCC_COMPILE_STATUS_TYPE_ERROR,
+                                    check_result.err_loc, check_result.err_msg,
+                                    NULL);
+    }
+    mCc_symtab_delete_function_scopes(stream->ctx);
+
+    const char *error = mCc_compile_function(stream->ctx, func,
+                                             &stream->opt_options,
+                                             stream->writer);
+    mCc_ast_delete_func_def(func);
+    if (error)
+        return mCc_compile_out_of_memory(stream->output, error);
+    ++stream->written;
+    return 0;
+}
+
+/* Compile the functions that were not streamed from a whole parse */
+static void mCc_compile_stream_rest(struct mCc_compile_stream *stream) {
+    struct mCc_context *ctx = stream->ctx;
+    struct mCc_output *output = stream->output;
+    struct mCc_ast_program *prog =
+        mCc_compile_parsed(mCc_parser_parse_source(
+                               stream->source, stream->options->parser),
+                           output);
+    if (!prog)
+        return;
+
+    struct mCc_ast_symtab_build_result link_result =
+        mCc_ast_symtab_build(ctx, prog);
+    struct mCc_typecheck_result check_result;
+    if (link_result.status) {
+        mCc_compile_diagnose(output, MCC_COMPILE_STATUS_SYMTAB_ERROR,
+                             link_result.err_loc, link_result.err_msg, NULL);
+    } else if ((check_result = mCc_typecheck(ctx, prog,
+                                             link_result.root_symtab))
+                   .status) {
+        mCc_compile_diagnose(output, MCC_COMPILE_STATUS_TYPE_ERROR,
+                             check_result.err_loc, check_result.err_msg, NULL);
+    } else {
+        mCc_symtab_delete_all_scopes(ctx);
+        for (unsigned int i = stream->written; i < prog->func_def_count; ++i) {
+            const char *error = mCc_compile_function(
+                ctx, prog->func_defs[i], &stream->opt_options, stream->writer);
+            if (error) {
+                mCc_compile_out_of_memory(output, error);
+                break;
+            }
+        }
+    }
+    mCc_ast_delete_program(prog);
+}
+
+enum mCc_compile_status
+mCc_compile_stream(struct mCc_context *ctx, struct mCc_source *source,
+                   const struct mCc_compile_options *options,
+                   struct mCc_writer *writer, struct mCc_output *output) {
+    struct mCc_compile_options default_options = mCc_compile_default_options(0);
+    if (!options)
+        options = &default_options;
+    memset(output, 0, sizeof(*output));
+
+    struct mCc_compile_stream stream = {
+        .ctx = ctx,
+        .source = source,
+        .options = options,
+        .opt_options = mCc_tac_opt_default_options(options->opt_level),
+        .writer = writer,
+        .output = output,
+        .written = 0,
+    };
+    struct mCc_parser_stream callbacks = {
+        .signatures = mCc_compile_stream_signatures,
+        .function = mCc_compile_stream_function,
+        .userdata = &stream,
+    };
+    struct mCc_parser_result result =
+        mCc_parser_parse_source_stream(source, &callbacks);
+
+    // The scopes still refer to the signatures
+    struct mCc_ast_program *signatures = NULL;
+    if (result.status == MCC_PARSER_STATUS_TOO_DEEP)
+        mCc_compile_stream_rest(&stream);
+    else if (output->status == MCC_COMPILE_STATUS_OK)
+        signatures = mCc_compile_parsed(result, output);
+    else
+        signatures = result.program;
+
+    mCc_context_reset(ctx);
+    if (signatures)
+        mCc_ast_delete_program(signatures);
+    return output->status;
+}
+
+/* Stream a source buffer into the output */
+static enum mCc_compile_status
+mCc_compile_string_stream(struct mCc_context *ctx, const char *src, size_t len,
+                          const struct mCc_compile_options *options,
+                          struct mCc_output *output) {
+    struct mCc_source source;
+    struct mCc_writer *writer = malloc(sizeof(*writer));
+    if (!writer || mCc_source_init(&source, src, len, NULL)) {
+        free(writer);
+        memset(output, 0, sizeof(*output));
+        return mCc_compile_out_of_memory(output, "reading the source");
+    }
+    mCc_writer_init_memory(writer);
+    mCc_compile_stream(ctx, &source, options, writer, output);
+    mCc_source_close(&source);
+
+    size_t size;
+    char *assembly = mCc_writer_take_memory(writer, &size);
+    free(writer);
+    if (output->status != MCC_COMPILE_STATUS_OK) {
+        free(assembly);
+        return output->status;
+    }
+    if (!assembly)
+        return mCc_compile_out_of_memory(output, "generating the assembly");
+
+    if (options->output_kind == MCC_COMPILE_OUTPUT_OBJECT) {
+        mCc_compile_object(assembly, size, output);
+        free(assembly);
+    } else {
+        output->data = assembly;
+        output->size = size;
+    }
+    return output->status;
+}
+
+enum mCc_compile_status
+mCc_compile_string_in_context(struct mCc_context *ctx, const char *src,
+                              size_t len,
+                              const struct mCc_compile_options *options,
+                              struct mCc_output *output) {
+    struct mCc_compile_options default_options = mCc_compile_default_options(0);
+    if (!options)
+        options = &default_options;
+    if (options->stream && !options->func_cache)
+        return mCc_compile_string_stream(ctx, src, len, options, output);
+    memset(output, 0, sizeof(*output));
+
+    struct mCc_ast_program *prog =
+        mCc_compile_parse(src, len, options->parser, output);
+    if (!prog)
+        return output->status;
+
+    mCc_compile_program(ctx, prog, options, output);
+    mCc_ast_delete_program(prog);
+    mCc_context_reset(ctx);
+    return output->status;
+}
+
+enum mCc_compile_status
+mCc_compile_string(const char *src, size_t len,
+                   const struct mCc_compile_options *options,
+                   struct mCc_output *output) {
+    struct mCc_context *ctx = mCc_context_new();
+    if (!ctx) {
+        memset(output, 0, sizeof(*output));
+        return mCc_compile_out_of_memory(output, "creating the context");
+    }
+    mCc_compile_string_in_context(ctx, src, len, options, output);
+    mCc_context_delete(ctx);
+    return output->status;
+}
+
+void mCc_output_free(struct mCc_output *output) {
+    for (unsigned int i = 0; i < output->diagnostic_count; ++i) {
+        free(output->diagnostics[i].message);
+        free(output->diagnostics[i].text);
+    }
+    free(output->diagnostics);
+    free(output->data);
+    memset(output, 0, sizeof(*output));
+}
@@ -0,0 +1,27 @@
+/**
+ * @file context.c
+ * @brief The state of one compilation.
+ * @author richard
+ * @date 2018-06-27
+ */
+#include "mCc/context.h"
+
+#include <stdlib.h>
+
+struct mCc_context *mCc_context_new(void) {
+    // Every phase resets the parts it uses when it starts
+    return calloc(1, sizeof(struct mCc_context));
+}
+
+void mCc_context_delete(struct mCc_context *ctx) {
+    if (!ctx)
+        return;
+    mCc_symtab_delete_all_scopes(ctx);
+    mCc_tac_free_global_string_array(ctx);
+    free(ctx);
+}
+
+void mCc_context_reset(struct mCc_context *ctx) {
+    mCc_symtab_delete_scopes(ctx);
+    mCc_tac_free_global_string_array(ctx);
+}
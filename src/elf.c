@@ -0,0 +1,923 @@
+/**
+ * @file elf.c
+ * @brief Writing, reading and static linking of 32-bit ELF objects.
+ * @author richard
+ * @date 2018-06-20
+ */
+#include "mCc/elf.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ELF_HEADER_SIZE (52)
+#define ELF_PROGRAM_HEADER_SIZE (32)
+#define ELF_SECTION_HEADER_SIZE (40)
+#define ELF_SYMBOL_SIZE (16)
+#define ELF_REL_SIZE (8)
+
+#define ET_REL (1)
+#define ET_EXEC (2)
+#define EM_386 (3)
+
+#define SHT_SYMTAB (2)
+#define SHT_STRTAB (3)
+#define SHT_RELA (4)
+#define SHT_NOTE (7)
+#define SHT_REL (9)
+
+#define SHN_UNDEF (0)
+#define SHN_ABS (0xfff1)
+#define SHN_COMMON (0xfff2)
+
+#define STB_LOCAL (0)
+#define STB_GLOBAL (1)
+#define STT_NOTYPE (0)
+#define STT_SECTION (3)
+
+#define PT_LOAD (1)
+#define PT_GNU_STACK (0x6474e551)
+#define PF_X (1)
+#define PF_W (2)
+#define PF_R (4)
+
+/// Load address of the executable, as used by the GNU linker
+#define LINK_BASE (0x08048000u)
+#define LINK_PAGE (0x1000u)
+
+/*********************************** Helpers */
+
+static uint32_t mCc_elf_align(uint32_t value, uint32_t align) {
+    return align > 1 ? (value + align - 1) & ~(align - 1) : value;
+}
+
+static void mCc_elf_put16(unsigned char *p, uint32_t value) {
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+}
+
+static void mCc_elf_put32(unsigned char *p, uint32_t value) {
+    mCc_elf_put16(p, value);
+    mCc_elf_put16(p + 2, value >> 16);
+}
+
+static uint32_t mCc_elf_get16(const unsigned char *p) {
+    return p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t mCc_elf_get32(const unsigned char *p) {
+    return mCc_elf_get16(p) | mCc_elf_get16(p + 2) << 16;
+}
+
+static void mCc_elf_set_error(struct mCc_elf_error *error, const char *fmt,
+                              ...) {
+    if (!error)
+        return;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(error->msg, sizeof(error->msg), fmt, args);
+    va_end(args);
+    error->line = 0;
+}
+
+/// Growable byte buffer used to assemble output files
+struct mCc_elf_buffer {
+    unsigned char *data;
+    uint32_t size;
+    uint32_t capacity;
+};
+
+/// Grow a buffer to at least size bytes, new bytes are zero
+static int mCc_elf_buffer_resize(struct mCc_elf_buffer *buf, uint32_t size) {
+    if (size > buf->capacity) {
+        uint32_t capacity = buf->capacity ? buf->capacity : 256;
+        while (capacity < size)
+            capacity *= 2;
+        unsigned char *tmp = realloc(buf->data, capacity);
+        if (!tmp)
+            return 1;
+        buf->data = tmp;
+        buf->capacity = capacity;
+    }
+    if (size > buf->size)
+        memset(buf->data + buf->size, 0, size - buf->size);
+    buf->size = size;
+    return 0;
+}
+
+/// Append bytes, returns the offset or -1 on memory error
+static int64_t mCc_elf_buffer_append(struct mCc_elf_buffer *buf,
+                                     const void *data, uint32_t size) {
+    uint32_t offset = buf->size;
+    if (mCc_elf_buffer_resize(buf, offset + size))
+        return -1;
+    if (data && size)
+        memcpy(buf->data + offset, data, size);
+    return offset;
+}
+
+/// Append a string including its terminator to a string table
+static int64_t mCc_elf_buffer_append_str(struct mCc_elf_buffer *buf,
+                                         const char *str) {
+    return mCc_elf_buffer_append(buf, str, strlen(str) + 1);
+}
+
+/*********************************** Objects in memory */
+
+struct mCc_elf_object *mCc_elf_object_new(void) {
+    return calloc(1, sizeof(struct mCc_elf_object));
+}
+
+void mCc_elf_object_delete(struct mCc_elf_object *obj) {
+    if (!obj)
+        return;
+    for (unsigned int i = 0; i < obj->section_count; ++i) {
+        free(obj->sections[i].name);
+        free(obj->sections[i].data);
+        free(obj->sections[i].relocs);
+    }
+    for (unsigned int i = 0; i < obj->symbol_count; ++i)
+        free(obj->symbols[i].name);
+    free(obj->sections);
+    free(obj->symbols);
+    free(obj->symbol_hash);
+    free(obj);
+}
+
+static int mCc_elf_add_section(struct mCc_elf_object *obj, const char *name,
+                               uint32_t type, uint32_t flags) {
+    struct mCc_elf_section *tmp = realloc(
+        obj->sections, (obj->section_count + 1) * sizeof(*obj->sections));
+    if (!tmp)
+        return -1;
+    obj->sections = tmp;
+
+    struct mCc_elf_section *section = &obj->sections[obj->section_count];
+    memset(section, 0, sizeof(*section));
+    if (!(section->name = strdup(name)))
+        return -1;
+    section->type = type;
+    section->flags = flags;
+    section->align = 1;
+    return obj->section_count++;
+}
+
+int mCc_elf_get_section(struct mCc_elf_object *obj, const char *name,
+                        uint32_t type, uint32_t flags) {
+    for (unsigned int i = 0; i < obj->section_count; ++i) {
+        if (strcmp(obj->sections[i].name, name) == 0)
+            return i;
+    }
+    return mCc_elf_add_section(obj, name, type, flags);
+}
+
+int mCc_elf_section_append(struct mCc_elf_section *section, const void *data,
+                           uint32_t size) {
+    if (section->type == MCC_ELF_SHT_NOBITS) {
+        section->size += size;
+        return 0;
+    }
+    struct mCc_elf_buffer buf = {section->data, section->size,
+                                 section->capacity};
+    if (mCc_elf_buffer_append(&buf, data, size) < 0)
+        return 1;
+    section->data = buf.data;
+    section->capacity = buf.capacity;
+    section->size = buf.size;
+    return 0;
+}
+
+static uint32_t mCc_elf_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name)
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    return hash;
+}
+
+/// Slot of a name in the hash, which is either free or holds the name
+static unsigned int mCc_elf_hash_slot(const struct mCc_elf_object *obj,
+                                      const char *name) {
+    unsigned int mask = obj->symbol_hash_size - 1;
+    unsigned int slot = mCc_elf_hash(name) & mask;
+    while (obj->symbol_hash[slot] >= 0 &&
+           strcmp(obj->symbols[obj->symbol_hash[slot]].name, name) != 0)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static int mCc_elf_hash_insert(struct mCc_elf_object *obj, unsigned int index) {
+    if (2 * (obj->symbol_count + 1) > obj->symbol_hash_size) {
+        unsigned int size =
+            obj->symbol_hash_size ? 2 * obj->symbol_hash_size : 64;
+        int *hash = malloc(size * sizeof(*hash));
+        if (!hash)
+            return 1;
+        for (unsigned int i = 0; i < size; ++i)
+            hash[i] = -1;
+        free(obj->symbol_hash);
+        obj->symbol_hash = hash;
+        obj->symbol_hash_size = size;
+        for (unsigned int i = 0; i < index; ++i) {
+            unsigned int slot = mCc_elf_hash_slot(obj, obj->symbols[i].name);
+            if (hash[slot] < 0)
+                hash[slot] = i;
+        }
+    }
+    unsigned int slot = mCc_elf_hash_slot(obj, obj->symbols[index].name);
+    if (obj->symbol_hash[slot] < 0)
+        obj->symbol_hash[slot] = index;
+    return 0;
+}
+
+/// Append a symbol, names need not be unique
+static int mCc_elf_add_symbol(struct mCc_elf_object *obj, const char *name,
+                              int section, uint32_t value) {
+    if (obj->symbol_count == obj->symbol_capacity) {
+        unsigned int capacity =
+            obj->symbol_capacity ? 2 * obj->symbol_capacity : 64;
+        struct mCc_elf_symbol *tmp =
+            realloc(obj->symbols, capacity * sizeof(*tmp));
+        if (!tmp)
+            return -1;
+        obj->symbols = tmp;
+        obj->symbol_capacity = capacity;
+    }
+    struct mCc_elf_symbol *symbol = &obj->symbols[obj->symbol_count];
+    memset(symbol, 0, sizeof(*symbol));
+    if (!(symbol->name = strdup(name)))
+        return -1;
+    symbol->section = section;
+    symbol->value = value;
+    if (mCc_elf_hash_insert(obj, obj->symbol_count)) {
+        free(symbol->name);
+        return -1;
+    }
+    return obj->symbol_count++;
+}
+
+int mCc_elf_get_symbol(struct mCc_elf_object *obj, const char *name) {
+    if (obj->symbol_hash_size) {
+        int index = obj->symbol_hash[mCc_elf_hash_slot(obj, name)];
+        if (index >= 0)
+            return index;
+    }
+    return mCc_elf_add_symbol(obj, name, MCC_ELF_UNDEF, 0);
+}
+
+int mCc_elf_add_reloc(struct mCc_elf_section *section, uint32_t offset,
+                      enum mCc_elf_reloc_type type, unsigned int symbol) {
+    if (section->reloc_count == section->reloc_capacity) {
+        unsigned int capacity =
+            section->reloc_capacity ? 2 * section->reloc_capacity : 32;
+        struct mCc_elf_reloc *tmp =
+            realloc(section->relocs, capacity * sizeof(*tmp));
+        if (!tmp)
+            return 1;
+        section->relocs = tmp;
+        section->reloc_capacity = capacity;
+    }
+    section->relocs[section->reloc_count].offset = offset;
+    section->relocs[section->reloc_count].type = type;
+    section->relocs[section->reloc_count].symbol = symbol;
+    ++section->reloc_count;
+    return 0;
+}
+
+/*********************************** Relocatable files */
+
+/// Local labels of the assembler, which are not written to the symbol table
+static bool mCc_elf_is_local_label(const struct mCc_elf_symbol *symbol) {
+    return strncmp(symbol->name, ".L", 2) == 0;
+}
+
+static void mCc_elf_put_section_header(unsigned char *p, uint32_t name,
+                                       uint32_t type, uint32_t flags,
+                                       uint32_t offset, uint32_t size,
+                                       uint32_t link, uint32_t info,
+                                       uint32_t align, uint32_t entsize) {
+    mCc_elf_put32(p, name);
+    mCc_elf_put32(p + 4, type);
+    mCc_elf_put32(p + 8, flags);
+    mCc_elf_put32(p + 12, 0); // address
+    mCc_elf_put32(p + 16, offset);
+    mCc_elf_put32(p + 20, size);
+    mCc_elf_put32(p + 24, link);
+    mCc_elf_put32(p + 28, info);
+    mCc_elf_put32(p + 32, align);
+    mCc_elf_put32(p + 36, entsize);
+}
+
+static void mCc_elf_put_symbol(unsigned char *p, uint32_t name, uint32_t value,
+                               unsigned int binding, unsigned int type,
+                               uint32_t shndx) {
+    mCc_elf_put32(p, name);
+    mCc_elf_put32(p + 4, value);
+    mCc_elf_put32(p + 8, 0); // size
+    p[12] = (binding << 4) | type;
+    p[13] = 0;
+    mCc_elf_put16(p + 14, shndx);
+}
+
+static void mCc_elf_put_header(unsigned char *p, uint32_t type, uint32_t entry,
+                               uint32_t phnum, uint32_t shoff, uint32_t shnum,
+                               uint32_t shstrndx) {
+    static const unsigned char ident[16] = {0x7f, 'E', 'L', 'F', 1, 1, 1};
+    memcpy(p, ident, sizeof(ident));
+    mCc_elf_put16(p + 16, type);
+    mCc_elf_put16(p + 18, EM_386);
+    mCc_elf_put32(p + 20, 1); // version
+    mCc_elf_put32(p + 24, entry);
+    mCc_elf_put32(p + 28, phnum ? ELF_HEADER_SIZE : 0);
+    mCc_elf_put32(p + 32, shoff);
+    mCc_elf_put32(p + 36, 0); // flags
+    mCc_elf_put16(p + 40, ELF_HEADER_SIZE);
+    mCc_elf_put16(p + 42, ELF_PROGRAM_HEADER_SIZE);
+    mCc_elf_put16(p + 44, phnum);
+    mCc_elf_put16(p + 46, ELF_SECTION_HEADER_SIZE);
+    mCc_elf_put16(p + 48, shnum);
+    mCc_elf_put16(p + 50, shstrndx);
+}
+
+int mCc_elf_write_object(const struct mCc_elf_object *obj, FILE *out) {
+    struct mCc_elf_buffer file = {0}, symtab = {0}, strtab = {0},
+                          shstrtab = {0}, headers = {0};
+    unsigned int count = obj->section_count;
+    // Index of the symbols in the file, or of the section symbol for locals
+    unsigned int *map = malloc((obj->symbol_count + 1) * sizeof(*map));
+    uint32_t *offsets = malloc((2 * count + 1) * sizeof(*offsets));
+    int ret = 1;
+    if (!map || !offsets)
+        goto out;
+
+    /* symbols: null, section symbols, named locals, globals */
+    unsigned int symbol_count = 1 + count;
+    if (mCc_elf_buffer_resize(&symtab, symbol_count * ELF_SYMBOL_SIZE) ||
+        mCc_elf_buffer_append_str(&strtab, "") < 0)
+        goto out;
+    for (unsigned int i = 0; i < count; ++i)
+        mCc_elf_put_symbol(symtab.data + (i + 1) * ELF_SYMBOL_SIZE, 0, 0,
+                           STB_LOCAL, STT_SECTION, i + 1);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (unsigned int i = 0; i < obj->symbol_count; ++i) {
+            const struct mCc_elf_symbol *symbol = &obj->symbols[i];
+            bool global = symbol->global || symbol->section == MCC_ELF_UNDEF;
+            if (symbol->is_section) {
+                map[i] = symbol->section + 1;
+                continue;
+            }
+            if (global != (pass == 1))
+                continue;
+            if (!global && symbol->section >= 0) {
+                map[i] = symbol->section + 1;
+                if (mCc_elf_is_local_label(symbol))
+                    continue;
+            } else {
+                map[i] = symbol_count;
+            }
+            int64_t name = mCc_elf_buffer_append_str(&strtab, symbol->name);
+            int64_t entry = mCc_elf_buffer_append(&symtab, NULL,
+                                                  ELF_SYMBOL_SIZE);
+            if (name < 0 || entry < 0)
+                goto out;
+            uint32_t shndx = symbol->section >= 0 ? symbol->section + 1
+                             : symbol->section == MCC_ELF_ABS ? SHN_ABS
+                                                             : SHN_UNDEF;
+            mCc_elf_put_symbol(symtab.data + entry, name, symbol->value,
+                               global ? STB_GLOBAL : STB_LOCAL, STT_NOTYPE,
+                               shndx);
+            ++symbol_count;
+        }
+        if (pass == 0)
+            offsets[2 * count] = symbol_count; // first global
+    }
+
+    /* section contents and relocations */
+    if (mCc_elf_buffer_resize(&file, ELF_HEADER_SIZE) ||
+        mCc_elf_buffer_append_str(&shstrtab, "") < 0)
+        goto out;
+    for (unsigned int i = 0; i < count; ++i) {
+        const struct mCc_elf_section *section = &obj->sections[i];
+        offsets[i] = mCc_elf_align(file.size, section->align);
+        if (section->type == MCC_ELF_SHT_NOBITS)
+            continue;
+        if (mCc_elf_buffer_resize(&file, offsets[i]) ||
+            mCc_elf_buffer_append(&file, section->data, section->size) < 0)
+            goto out;
+        // Relocations against local symbols use the section symbol
+        for (unsigned int j = 0; j < section->reloc_count; ++j) {
+            const struct mCc_elf_symbol *symbol =
+                &obj->symbols[section->relocs[j].symbol];
+            if (!symbol->global && symbol->section >= 0) {
+                unsigned char *p = file.data + offsets[i] +
+                                   section->relocs[j].offset;
+                mCc_elf_put32(p, mCc_elf_get32(p) + symbol->value);
+            }
+        }
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        const struct mCc_elf_section *section = &obj->sections[i];
+        offsets[count + i] = mCc_elf_align(file.size, 4);
+        if (mCc_elf_buffer_resize(&file, offsets[count + i]))
+            goto out;
+        for (unsigned int j = 0; j < section->reloc_count; ++j) {
+            unsigned char rel[ELF_REL_SIZE];
+            mCc_elf_put32(rel, section->relocs[j].offset);
+            mCc_elf_put32(rel + 4, map[section->relocs[j].symbol] << 8 |
+                                       section->relocs[j].type);
+            if (mCc_elf_buffer_append(&file, rel, sizeof(rel)) < 0)
+                goto out;
+        }
+    }
+    uint32_t symtab_offset = mCc_elf_align(file.size, 4);
+    if (mCc_elf_buffer_resize(&file, symtab_offset) ||
+        mCc_elf_buffer_append(&file, symtab.data, symtab.size) < 0)
+        goto out;
+    int64_t strtab_offset =
+        mCc_elf_buffer_append(&file, strtab.data, strtab.size);
+    if (strtab_offset < 0)
+        goto out;
+
+    /* section headers: null, sections, relocations, note, tables */
+    if (mCc_elf_buffer_resize(&headers, ELF_SECTION_HEADER_SIZE))
+        goto out;
+    for (unsigned int i = 0; i < count; ++i) {
+        const struct mCc_elf_section *section = &obj->sections[i];
+        int64_t name = mCc_elf_buffer_append_str(&shstrtab, section->name);
+        int64_t entry =
+            mCc_elf_buffer_append(&headers, NULL, ELF_SECTION_HEADER_SIZE);
+        if (name < 0 || entry < 0)
+            goto out;
+        mCc_elf_put_section_header(headers.data + entry, name, section->type,
+                                   section->flags, offsets[i], section->size,
+                                   0, 0, section->align, 0);
+    }
+    // The note marking the stack non-executable precedes the symbol table
+    unsigned int symtab_index = count + 2;
+    for (unsigned int i = 0; i < count; ++i)
+        symtab_index += obj->sections[i].reloc_count > 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        const struct mCc_elf_section *section = &obj->sections[i];
+        if (!section->reloc_count)
+            continue;
+        int64_t name = mCc_elf_buffer_append(&shstrtab, ".rel", 4);
+        int64_t entry =
+            mCc_elf_buffer_append(&headers, NULL, ELF_SECTION_HEADER_SIZE);
+        if (name < 0 || entry < 0 ||
+            mCc_elf_buffer_append_str(&shstrtab, section->name) < 0)
+            goto out;
+        mCc_elf_put_section_header(headers.data + entry, name, SHT_REL, 0,
+                                   offsets[count + i],
+                                   section->reloc_count * ELF_REL_SIZE,
+                                   symtab_index, i + 1, 4, ELF_REL_SIZE);
+    }
+    int64_t note = mCc_elf_buffer_append_str(&shstrtab, ".note.GNU-stack");
+    int64_t name_symtab = mCc_elf_buffer_append_str(&shstrtab, ".symtab");
+    int64_t name_strtab = mCc_elf_buffer_append_str(&shstrtab, ".strtab");
+    int64_t name_shstrtab = mCc_elf_buffer_append_str(&shstrtab, ".shstrtab");
+    int64_t entry =
+        mCc_elf_buffer_append(&headers, NULL, 4 * ELF_SECTION_HEADER_SIZE);
+    int64_t shstrtab_offset =
+        mCc_elf_buffer_append(&file, shstrtab.data, shstrtab.size);
+    if (note < 0 || name_symtab < 0 || name_strtab < 0 || name_shstrtab < 0 ||
+        entry < 0 || shstrtab_offset < 0)
+        goto out;
+    unsigned char *p = headers.data + entry;
+    mCc_elf_put_section_header(p, note, MCC_ELF_SHT_PROGBITS, 0,
+                               shstrtab_offset, 0, 0, 0, 1, 0);
+    mCc_elf_put_section_header(p + ELF_SECTION_HEADER_SIZE, name_symtab,
+                               SHT_SYMTAB, 0, symtab_offset, symtab.size,
+                               symtab_index + 1, offsets[2 * count], 4,
+                               ELF_SYMBOL_SIZE);
+    mCc_elf_put_section_header(p + 2 * ELF_SECTION_HEADER_SIZE, name_strtab,
+                               SHT_STRTAB, 0, strtab_offset, strtab.size, 0, 0,
+                               1, 0);
+    mCc_elf_put_section_header(p + 3 * ELF_SECTION_HEADER_SIZE, name_shstrtab,
+                               SHT_STRTAB, 0, shstrtab_offset, shstrtab.size,
+                               0, 0, 1, 0);
+
+    uint32_t shoff = mCc_elf_align(file.size, 4);
+    if (mCc_elf_buffer_resize(&file, shoff) ||
+        mCc_elf_buffer_append(&file, headers.data, headers.size) < 0)
+        goto out;
+    mCc_elf_put_header(file.data, ET_REL, 0, 0, shoff,
+                       headers.size / ELF_SECTION_HEADER_SIZE,
+                       symtab_index + 2);
+
+    ret = fwrite(file.data, 1, file.size, out) != file.size;
+out:
+    free(map);
+    free(offsets);
+    free(file.data);
+    free(symtab.data);
+    free(strtab.data);
+    free(shstrtab.data);
+    free(headers.data);
+    return ret;
+}
+
+/// Read a whole file, which may be a pipe
+static unsigned char *mCc_elf_read_file(FILE *in, uint32_t *size) {
+    struct mCc_elf_buffer buf = {0};
+    size_t n;
+    do {
+        if (mCc_elf_buffer_resize(&buf, buf.size + 4096)) {
+            free(buf.data);
+            return NULL;
+        }
+        n = fread(buf.data + buf.size - 4096, 1, 4096, in);
+        buf.size -= 4096 - n;
+    } while (n == 4096);
+    *size = buf.size;
+    return buf.data;
+}
+
+/// Pointer to the name of a string table entry, or NULL if out of bounds
+static const char *mCc_elf_string(const unsigned char *data, uint32_t size,
+                                  const unsigned char *table, uint32_t index) {
+    uint32_t offset = mCc_elf_get32(table + 16) + index;
+    uint32_t end = mCc_elf_get32(table + 16) + mCc_elf_get32(table + 20);
+    if (end > size || offset >= end || !memchr(data + offset, 0, end - offset))
+        return NULL;
+    return (const char *)data + offset;
+}
+
+struct mCc_elf_object *mCc_elf_read_object(FILE *in,
+                                           struct mCc_elf_error *error) {
+    static const unsigned char ident[7] = {0x7f, 'E', 'L', 'F', 1, 1, 1};
+    uint32_t size;
+    unsigned char *data = mCc_elf_read_file(in, &size);
+    struct mCc_elf_object *obj = mCc_elf_object_new();
+    int *map = NULL;
+    if (!data || !obj) {
+        mCc_elf_set_error(error, "memory error");
+        goto fail;
+    }
+    if (size < ELF_HEADER_SIZE || memcmp(data, ident, sizeof(ident)) != 0 ||
+        mCc_elf_get16(data + 16) != ET_REL ||
+        mCc_elf_get16(data + 18) != EM_386) {
+        mCc_elf_set_error(error, "not a 32-bit x86 relocatable object");
+        goto fail;
+    }
+    uint32_t shoff = mCc_elf_get32(data + 32);
+    uint32_t shnum = mCc_elf_get16(data + 48);
+    uint32_t shstrndx = mCc_elf_get16(data + 50);
+    if (mCc_elf_get16(data + 46) != ELF_SECTION_HEADER_SIZE ||
+        shoff > size || shnum > (size - shoff) / ELF_SECTION_HEADER_SIZE ||
+        shstrndx >= shnum) {
+        mCc_elf_set_error(error, "invalid section headers");
+        goto fail;
+    }
+    const unsigned char *headers = data + shoff;
+    const unsigned char *shstrtab =
+        headers + shstrndx * ELF_SECTION_HEADER_SIZE;
+    if (!(map = malloc(shnum * sizeof(*map)))) {
+        mCc_elf_set_error(error, "memory error");
+        goto fail;
+    }
+
+    /* allocated sections */
+    const unsigned char *symtab = NULL;
+    for (uint32_t i = 0; i < shnum; ++i) {
+        const unsigned char *sh = headers + i * ELF_SECTION_HEADER_SIZE;
+        const char *name =
+            mCc_elf_string(data, size, shstrtab, mCc_elf_get32(sh));
+        uint32_t type = mCc_elf_get32(sh + 4);
+        uint32_t flags = mCc_elf_get32(sh + 8);
+        uint32_t offset = mCc_elf_get32(sh + 16);
+        uint32_t sec_size = mCc_elf_get32(sh + 20);
+        map[i] = -1;
+        if (type == SHT_SYMTAB)
+            symtab = sh;
+        if (i == 0 || !(flags & MCC_ELF_SHF_ALLOC))
+            continue;
+        if (!name || (type != MCC_ELF_SHT_PROGBITS && type != SHT_NOTE &&
+                      type != MCC_ELF_SHT_NOBITS)) {
+            mCc_elf_set_error(error, "unsupported section %s",
+                              name ? name : "");
+            goto fail;
+        }
+        if (type != MCC_ELF_SHT_NOBITS &&
+            (offset > size || sec_size > size - offset)) {
+            mCc_elf_set_error(error, "section %s out of bounds", name);
+            goto fail;
+        }
+        map[i] = mCc_elf_add_section(obj, name,
+                                     type == MCC_ELF_SHT_NOBITS
+                                         ? MCC_ELF_SHT_NOBITS
+                                         : MCC_ELF_SHT_PROGBITS,
+                                     flags);
+        if (map[i] < 0 ||
+            mCc_elf_section_append(&obj->sections[map[i]],
+                                   type == MCC_ELF_SHT_NOBITS ? NULL
+                                                              : data + offset,
+                                   sec_size)) {
+            mCc_elf_set_error(error, "memory error");
+            goto fail;
+        }
+        uint32_t align = mCc_elf_get32(sh + 32);
+        obj->sections[map[i]].align = align ? align : 1;
+    }
+    if (!symtab) {
+        mCc_elf_set_error(error, "missing symbol table");
+        goto fail;
+    }
+
+    /* symbols, with the same indices as in the file */
+    uint32_t sym_offset = mCc_elf_get32(symtab + 16);
+    uint32_t sym_count = mCc_elf_get32(symtab + 20) / ELF_SYMBOL_SIZE;
+    uint32_t strndx = mCc_elf_get32(symtab + 24);
+    if (sym_offset > size || sym_count > (size - sym_offset) / ELF_SYMBOL_SIZE ||
+        strndx >= shnum) {
+        mCc_elf_set_error(error, "invalid symbol table");
+        goto fail;
+    }
+    const unsigned char *strtab = headers + strndx * ELF_SECTION_HEADER_SIZE;
+    for (uint32_t i = 0; i < sym_count; ++i) {
+        const unsigned char *sym = data + sym_offset + i * ELF_SYMBOL_SIZE;
+        uint32_t shndx = mCc_elf_get16(sym + 14);
+        unsigned int binding = sym[12] >> 4;
+        const char *name =
+            (sym[12] & 0xf) == STT_SECTION && shndx < shnum
+                ? mCc_elf_string(data, size, shstrtab,
+                                 mCc_elf_get32(headers + shndx *
+                                                   ELF_SECTION_HEADER_SIZE))
+                : mCc_elf_string(data, size, strtab, mCc_elf_get32(sym));
+        if (!name || shndx == SHN_COMMON) {
+            mCc_elf_set_error(error, "unsupported symbol %u", i);
+            goto fail;
+        }
+        int section = shndx == SHN_UNDEF                     ? MCC_ELF_UNDEF
+                      : shndx < shnum && map[shndx] >= 0     ? map[shndx]
+                                                             : MCC_ELF_ABS;
+        int index =
+            mCc_elf_add_symbol(obj, name, section, mCc_elf_get32(sym + 4));
+        if (index < 0) {
+            mCc_elf_set_error(error, "memory error");
+            goto fail;
+        }
+        obj->symbols[index].global = binding != STB_LOCAL;
+        obj->symbols[index].is_section = (sym[12] & 0xf) == STT_SECTION;
+    }
+
+    /* relocations of allocated sections */
+    for (uint32_t i = 1; i < shnum; ++i) {
+        const unsigned char *sh = headers + i * ELF_SECTION_HEADER_SIZE;
+        uint32_t type = mCc_elf_get32(sh + 4);
+        uint32_t target = mCc_elf_get32(sh + 28);
+        if ((type != SHT_REL && type != SHT_RELA) || target >= shnum ||
+            map[target] < 0)
+            continue;
+        struct mCc_elf_section *section = &obj->sections[map[target]];
+        uint32_t offset = mCc_elf_get32(sh + 16);
+        uint32_t count = mCc_elf_get32(sh + 20) / ELF_REL_SIZE;
+        if (type == SHT_RELA || offset > size ||
+            count > (size - offset) / ELF_REL_SIZE) {
+            mCc_elf_set_error(error, "unsupported relocations for %s",
+                              section->name);
+            goto fail;
+        }
+        for (uint32_t j = 0; j < count; ++j) {
+            const unsigned char *rel = data + offset + j * ELF_REL_SIZE;
+            uint32_t info = mCc_elf_get32(rel + 4);
+            uint32_t rel_type = info & 0xff;
+            if ((rel_type != MCC_ELF_R_386_32 &&
+                 rel_type != MCC_ELF_R_386_PC32 &&
+                 rel_type != MCC_ELF_R_386_PLT32) ||
+                (info >> 8) >= sym_count || section->size < 4 ||
+                mCc_elf_get32(rel) > section->size - 4) {
+                mCc_elf_set_error(error, "unsupported relocation in %s",
+                                  section->name);
+                goto fail;
+            }
+            if (mCc_elf_add_reloc(section, mCc_elf_get32(rel), rel_type,
+                                  info >> 8)) {
+                mCc_elf_set_error(error, "memory error");
+                goto fail;
+            }
+        }
+    }
+    free(map);
+    free(data);
+    return obj;
+
+fail:
+    free(map);
+    free(data);
+    mCc_elf_object_delete(obj);
+    return NULL;
+}
+
+/*********************************** Static linking */
+
+/// A defined global symbol of one of the linked objects
+struct mCc_elf_global {
+    const char *name;
+    uint32_t address;
+};
+
+static int mCc_elf_global_cmp(const void *a, const void *b) {
+    return strcmp(((const struct mCc_elf_global *)a)->name,
+                  ((const struct mCc_elf_global *)b)->name);
+}
+
+/// Classes of sections, in the order they are placed
+enum mCc_elf_link_class {
+    MCC_ELF_LINK_TEXT,
+    MCC_ELF_LINK_RODATA,
+    MCC_ELF_LINK_DATA,
+    MCC_ELF_LINK_BSS,
+    MCC_ELF_LINK_NONE
+};
+
+static enum mCc_elf_link_class
+mCc_elf_link_class(const struct mCc_elf_section *section) {
+    if (!(section->flags & MCC_ELF_SHF_ALLOC))
+        return MCC_ELF_LINK_NONE;
+    if (section->type == MCC_ELF_SHT_NOBITS)
+        return MCC_ELF_LINK_BSS;
+    if (section->flags & MCC_ELF_SHF_EXECINSTR)
+        return MCC_ELF_LINK_TEXT;
+    if (section->flags & MCC_ELF_SHF_WRITE)
+        return MCC_ELF_LINK_DATA;
+    return MCC_ELF_LINK_RODATA;
+}
+
+/// Resolve the address of a symbol, returns non-zero if undefined
+static int mCc_elf_link_resolve(const struct mCc_elf_object *obj,
+                                const struct mCc_elf_symbol *symbol,
+                                const struct mCc_elf_global *globals,
+                                unsigned int global_count, uint32_t *address) {
+    if (symbol->section >= 0) {
+        *address = obj->sections[symbol->section].addr + symbol->value;
+        return 0;
+    }
+    if (symbol->section == MCC_ELF_ABS) {
+        *address = symbol->value;
+        return 0;
+    }
+    struct mCc_elf_global key = {symbol->name, 0};
+    const struct mCc_elf_global *global = bsearch(
+        &key, globals, global_count, sizeof(key), mCc_elf_global_cmp);
+    if (!global)
+        return 1;
+    *address = global->address;
+    return 0;
+}
+
+static void mCc_elf_put_program_header(unsigned char *p, uint32_t type,
+                                       uint32_t offset, uint32_t addr,
+                                       uint32_t filesz, uint32_t memsz,
+                                       uint32_t flags, uint32_t align) {
+    mCc_elf_put32(p, type);
+    mCc_elf_put32(p + 4, offset);
+    mCc_elf_put32(p + 8, addr);
+    mCc_elf_put32(p + 12, addr);
+    mCc_elf_put32(p + 16, filesz);
+    mCc_elf_put32(p + 20, memsz);
+    mCc_elf_put32(p + 24, flags);
+    mCc_elf_put32(p + 28, align);
+}
+
+int mCc_elf_link(struct mCc_elf_object **objs, unsigned int count, FILE *out,
+                 struct mCc_elf_error *error) {
+    const unsigned int phnum = 3;
+    struct mCc_elf_buffer file = {0};
+    struct mCc_elf_global *globals = NULL;
+    unsigned int global_count = 0;
+    int ret = 1;
+
+    /* layout: headers, text and rodata in the first segment */
+    uint32_t offset = ELF_HEADER_SIZE + phnum * ELF_PROGRAM_HEADER_SIZE;
+    for (int cls = MCC_ELF_LINK_TEXT; cls <= MCC_ELF_LINK_RODATA; ++cls) {
+        for (unsigned int i = 0; i < count; ++i) {
+            for (unsigned int j = 0; j < objs[i]->section_count; ++j) {
+                struct mCc_elf_section *section = &objs[i]->sections[j];
+                if (mCc_elf_link_class(section) != (enum mCc_elf_link_class)cls)
+                    continue;
+                offset = mCc_elf_align(offset, section->align);
+                section->addr = LINK_BASE + offset;
+                offset += section->size;
+            }
+        }
+    }
+    uint32_t text_size = offset;
+    // data and bss on the following page, at the same offset within the page
+    uint32_t data_addr =
+        mCc_elf_align(LINK_BASE + text_size, LINK_PAGE) + text_size % LINK_PAGE;
+    uint32_t addr = data_addr;
+    uint32_t data_size = 0;
+    for (int cls = MCC_ELF_LINK_DATA; cls <= MCC_ELF_LINK_BSS; ++cls) {
+        for (unsigned int i = 0; i < count; ++i) {
+            for (unsigned int j = 0; j < objs[i]->section_count; ++j) {
+                struct mCc_elf_section *section = &objs[i]->sections[j];
+                if (mCc_elf_link_class(section) != (enum mCc_elf_link_class)cls)
+                    continue;
+                addr = mCc_elf_align(addr, section->align);
+                section->addr = addr;
+                addr += section->size;
+                if (cls == MCC_ELF_LINK_DATA)
+                    data_size = addr - data_addr;
+            }
+        }
+    }
+    uint32_t mem_size = addr - data_addr;
+
+    /* global symbols */
+    for (unsigned int i = 0; i < count; ++i)
+        global_count += objs[i]->symbol_count;
+    if (global_count &&
+        !(globals = malloc(global_count * sizeof(*globals)))) {
+        mCc_elf_set_error(error, "memory error");
+        goto out;
+    }
+    global_count = 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        for (unsigned int j = 0; j < objs[i]->symbol_count; ++j) {
+            const struct mCc_elf_symbol *symbol = &objs[i]->symbols[j];
+            if (!symbol->global || symbol->section == MCC_ELF_UNDEF)
+                continue;
+            globals[global_count].name = symbol->name;
+            mCc_elf_link_resolve(objs[i], symbol, NULL, 0,
+                                 &globals[global_count].address);
+            ++global_count;
+        }
+    }
+    qsort(globals, global_count, sizeof(*globals), mCc_elf_global_cmp);
+    for (unsigned int i = 1; i < global_count; ++i) {
+        if (strcmp(globals[i - 1].name, globals[i].name) == 0) {
+            mCc_elf_set_error(error, "multiple definition of `%s'",
+                              globals[i].name);
+            goto out;
+        }
+    }
+
+    /* contents */
+    if (mCc_elf_buffer_resize(&file, text_size + data_size)) {
+        mCc_elf_set_error(error, "memory error");
+        goto out;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        for (unsigned int j = 0; j < objs[i]->section_count; ++j) {
+            const struct mCc_elf_section *section = &objs[i]->sections[j];
+            enum mCc_elf_link_class cls = mCc_elf_link_class(section);
+            if (cls == MCC_ELF_LINK_NONE)
+                continue;
+            if (cls == MCC_ELF_LINK_BSS) {
+                if (section->reloc_count) {
+                    mCc_elf_set_error(error, "relocation in %s",
+                                      section->name);
+                    goto out;
+                }
+                continue;
+            }
+            uint32_t base = cls == MCC_ELF_LINK_DATA
+                                ? text_size + section->addr - data_addr
+                                : section->addr - LINK_BASE;
+            memcpy(file.data + base, section->data, section->size);
+            for (unsigned int k = 0; k < section->reloc_count; ++k) {
+                const struct mCc_elf_reloc *reloc = &section->relocs[k];
+                const struct mCc_elf_symbol *symbol =
+                    &objs[i]->symbols[reloc->symbol];
+                uint32_t target;
+                if (mCc_elf_link_resolve(objs[i], symbol, globals,
+                                         global_count, &target)) {
+                    mCc_elf_set_error(error, "undefined reference to `%s'",
+                                      symbol->name);
+                    goto out;
+                }
+                unsigned char *p = file.data + base + reloc->offset;
+                uint32_t value = target + mCc_elf_get32(p);
+                if (reloc->type != MCC_ELF_R_386_32)
+                    value -= section->addr + reloc->offset;
+                mCc_elf_put32(p, value);
+            }
+        }
+    }
+
+    /* headers */
+    struct mCc_elf_symbol start = {(char *)"_start", MCC_ELF_UNDEF, 0, true, false};
+    uint32_t entry;
+    if (mCc_elf_link_resolve(NULL, &start, globals, global_count, &entry)) {
+        mCc_elf_set_error(error, "undefined entry point _start");
+        goto out;
+    }
+    mCc_elf_put_header(file.data, ET_EXEC, entry, phnum, 0, 0, 0);
+    unsigned char *ph = file.data + ELF_HEADER_SIZE;
+    mCc_elf_put_program_header(ph, PT_LOAD, 0, LINK_BASE, text_size,
+                               text_size, PF_R | PF_X, LINK_PAGE);
+    mCc_elf_put_program_header(ph + ELF_PROGRAM_HEADER_SIZE, PT_LOAD, text_size,
+                               data_addr, data_size, mem_size, PF_R | PF_W,
+                               LINK_PAGE);
+    mCc_elf_put_program_header(ph + 2 * ELF_PROGRAM_HEADER_SIZE, PT_GNU_STACK,
+                               0, 0, 0, 0, PF_R | PF_W, 16);
+
+    if (fwrite(file.data, 1, file.size, out) != file.size) {
+        mCc_elf_set_error(error, "write error");
+        goto out;
+    }
+    ret = 0;
+out:
+    free(globals);
+    free(file.data);
+    return ret;
+}
@@ -0,0 +1,589 @@
+/**
+ * @file func_cache.c
+ * @brief Cache of the optimised assembly of single functions.
+ * @author richard
+ * @date 2018-07-02
+ */
+#include "mCc/func_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/uthash.h"
+#include "mCc/asm.h"
+#include "mCc/context.h"
+#include "mCc/source.h"
+#include "mCc/symtab.h"
+#include "mCc/tac_builder.h"
+
+struct mCc_func_cache_entry {
+    char *key; ///< The whole fingerprint, so collisions are harmless
+    size_t key_size;
+    char *assembly;
+    size_t size;
+    uint64_t last_used; ///< Generation of the last compilation using it
+    UT_hash_handle hh;
+};
+
+/// Stands for a missing optional node
+static const uint64_t none = UINT64_MAX;
+
+/*********************************** Fingerprint */
+
+static void mCc_func_cache_add_expression(struct mCc_cache_key *key,
+                                          const struct mCc_ast_expression *exp);
+
+static void mCc_func_cache_add_literal(struct mCc_cache_key *key,
+                                       const struct mCc_ast_literal *lit) {
+    if (!lit) {
+        mCc_cache_key_add_uint(key, none);
+        return;
+    }
+    mCc_cache_key_add_uint(key, lit->type);
+    switch (lit->type) {
+        case MCC_AST_LITERAL_TYPE_INT:
+            mCc_cache_key_add_uint(key, (uint64_t)lit->i_value);
+            break;
+        case MCC_AST_LITERAL_TYPE_FLOAT:
+            mCc_cache_key_add(key, &lit->f_value, sizeof(lit->f_value));
+            break;
+        case MCC_AST_LITERAL_TYPE_BOOL:
+            mCc_cache_key_add_uint(key, lit->b_value);
+            break;
+        case MCC_AST_LITERAL_TYPE_STRING:
+            mCc_cache_key_add_string(key, lit->s_value);
+            break;
+    }
+}
+
+static void mCc_func_cache_add_declaration(
+        struct mCc_cache_key *key, const struct mCc_ast_declaration *decl) {
+    mCc_cache_key_add_uint(key, decl->decl_type);
+    mCc_func_cache_add_literal(key, decl->decl_array_size);
+    mCc_cache_key_add_string(key, decl->decl_id->id_value);
+}
+
+static void
+mCc_func_cache_add_parameters(struct mCc_cache_key *key,
+                              const struct mCc_ast_parameters *para) {
+    if (!para) {
+        mCc_cache_key_add_uint(key, 0);
+        return;
+    }
+    mCc_cache_key_add_uint(key, para->decl_count);
+    for (unsigned int i = 0; i < para->decl_count; ++i)
+        mCc_func_cache_add_declaration(key, para->decl[i]);
+}
+
+/* The call and the signature of the callee, which decides how the arguments
+ * are passed and what is returned */
+static void mCc_func_cache_add_call(struct mCc_cache_key *key,
+                                    const struct mCc_ast_expression *exp) {
+    mCc_cache_key_add_string(key, exp->f_name->id_value);
+    const struct mCc_ast_function_def *callee = exp->callee;
+    if (callee) {
+        mCc_cache_key_add_uint(key, callee->built_in);
+        mCc_cache_key_add_uint(key, callee->func_type);
+        mCc_func_cache_add_parameters(key, callee->para);
+    } else {
+        mCc_cache_key_add_uint(key, none);
+    }
+
+    const struct mCc_ast_arguments *args = exp->arguments;
+    mCc_cache_key_add_uint(key, args ? args->expression_count : 0);
+    for (unsigned int i = 0; args && i < args->expression_count; ++i)
+        mCc_func_cache_add_expression(key, args->expressions[i]);
+}
+
+static void mCc_func_cache_add_expression(struct mCc_cache_key *key,
+                                          const struct mCc_ast_expression *exp) {
+    if (!exp) {
+        mCc_cache_key_add_uint(key, none);
+        return;
+    }
+    mCc_cache_key_add_uint(key, exp->type);
+    mCc_cache_key_add_uint(key, exp->node.computed_type);
+    switch (exp->type) {
+        case MCC_AST_EXPRESSION_TYPE_LITERAL:
+            mCc_func_cache_add_literal(key, exp->literal);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_IDENTIFIER:
+            mCc_cache_key_add_string(key, exp->identifier->id_value);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_UNARY_OP:
+            mCc_cache_key_add_uint(key, exp->unary_op);
+            mCc_func_cache_add_expression(key, exp->unary_expression);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_BINARY_OP:
+            mCc_cache_key_add_uint(key, exp->op);
+            mCc_func_cache_add_expression(key, exp->lhs);
+            mCc_func_cache_add_expression(key, exp->rhs);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_PARENTH:
+            mCc_func_cache_add_expression(key, exp->expression);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_CALL_EXPR:
+            mCc_func_cache_add_call(key, exp);
+            break;
+        case MCC_AST_EXPRESSION_TYPE_ARR_SUBSCR:
+            mCc_cache_key_add_string(key, exp->array_id->id_value);
+            mCc_func_cache_add_expression(key, exp->subscript_expr);
+            break;
+    }
+}
+
+static void mCc_func_cache_add_statement(struct mCc_cache_key *key,
+                                         const struct mCc_ast_statement *stmt) {
+    if (!stmt) {
+        mCc_cache_key_add_uint(key, none);
+        return;
+    }
+    mCc_cache_key_add_uint(key, stmt->type);
+    switch (stmt->type) {
+        case MCC_AST_STATEMENT_TYPE_IF:
+            mCc_func_cache_add_expression(key, stmt->if_cond);
+            mCc_func_cache_add_statement(key, stmt->if_stmt);
+            break;
+        case MCC_AST_STATEMENT_TYPE_IFELSE:
+            mCc_func_cache_add_expression(key, stmt->if_cond);
+            mCc_func_cache_add_statement(key, stmt->if_stmt);
+            mCc_func_cache_add_statement(key, stmt->else_stmt);
+            break;
+        case MCC_AST_STATEMENT_TYPE_RET:
+            mCc_func_cache_add_expression(key, stmt->ret_val);
+            break;
+        case MCC_AST_STATEMENT_TYPE_RET_VOID:
+            break;
+        case MCC_AST_STATEMENT_TYPE_WHILE:
+            mCc_func_cache_add_expression(key, stmt->while_cond);
+            mCc_func_cache_add_statement(key, stmt->while_stmt);
+            break;
+        case MCC_AST_STATEMENT_TYPE_DECL:
+            mCc_func_cache_add_declaration(key, stmt->declaration);
+            break;
+        case MCC_AST_STATEMENT_TYPE_ASSGN:
+            mCc_cache_key_add_string(key, stmt->id_assgn->id_value);
+            mCc_func_cache_add_expression(key, stmt->lhs_assgn);
+            mCc_func_cache_add_expression(key, stmt->rhs_assgn);
+            break;
+        case MCC_AST_STATEMENT_TYPE_EXPR:
+            mCc_func_cache_add_expression(key, stmt->expression);
+            break;
+        case MCC_AST_STATEMENT_TYPE_CMPND:
+            mCc_cache_key_add_uint(key, stmt->compound_stmt_count);
+            for (unsigned int i = 0; i < stmt->compound_stmt_count; ++i)
+                mCc_func_cache_add_statement(key, stmt->compound_stmts[i]);
+            break;
+    }
+}
+
+static void
+mCc_func_cache_add_options(struct mCc_cache_key *key,
+                           const struct mCc_tac_opt_options *options) {
+    mCc_cache_key_add_string(key, "function");
+    mCc_cache_key_add_uint(key, options->level);
+    mCc_cache_key_add_uint(key, options->if_convert_max_speculated);
+    mCc_cache_key_add_uint(key, options->loop_rotate_max_cond);
+    mCc_cache_key_add_uint(key, options->unroll_factor);
+    mCc_cache_key_add_uint(key, options->unroll_full_max_trip);
+    mCc_cache_key_add_uint(key, options->unroll_max_size);
+}
+
+void mCc_func_cache_fingerprint(struct mCc_cache_key *key,
+                                const struct mCc_ast_function_def *fun_def,
+                                const struct mCc_tac_opt_options *options) {
+    mCc_func_cache_add_options(key, options);
+    mCc_cache_key_add_string(key, fun_def->identifier->id_value);
+    mCc_cache_key_add_uint(key, fun_def->func_type);
+    mCc_func_cache_add_parameters(key, fun_def->para);
+    mCc_func_cache_add_statement(key, fun_def->body);
+}
+
+/*********************************** Fingerprint of the compact AST */
+
+/* The same bytes as above, but the expressions and statements of a function
+ * are read front to back: in pre-order, the children of a node are the nodes
+ * following it, so a count of the nodes still to come replaces the recursion.
+ */
+
+/// Reads the nodes of one function in order
+struct mCc_func_cache_scan {
+    struct mCc_cache_key *key;
+    const struct mCc_ast_compact *compact;
+    uint32_t expression; ///< The next expression
+    uint32_t statement;  ///< The next statement
+};
+
+static void mCc_func_cache_scan_literal(struct mCc_func_cache_scan *scan,
+                                        uint32_t i) {
+    if (i == MCC_AST_COMPACT_NONE) {
+        mCc_cache_key_add_uint(scan->key, none);
+        return;
+    }
+    const struct mCc_ast_compact_literal *lit =
+            &scan->compact->literals.data[i];
+    mCc_cache_key_add_uint(scan->key, lit->type);
+    switch (lit->type) {
+        case MCC_AST_LITERAL_TYPE_INT:
+            mCc_cache_key_add_uint(scan->key, (uint64_t)lit->i_value);
+            break;
+        case MCC_AST_LITERAL_TYPE_FLOAT:
+            mCc_cache_key_add(scan->key, &lit->f_value, sizeof(lit->f_value));
+            break;
+        case MCC_AST_LITERAL_TYPE_BOOL:
+            mCc_cache_key_add_uint(scan->key, lit->b_value);
+            break;
+        case MCC_AST_LITERAL_TYPE_STRING:
+            mCc_cache_key_add_string(scan->key, scan->compact->chars.data +
+                                                        lit->s_value);
+            break;
+    }
+}
+
+static void mCc_func_cache_scan_declaration(struct mCc_func_cache_scan *scan,
+                                            uint32_t i) {
+    const struct mCc_ast_compact_declaration *decl =
+            &scan->compact->declarations.data[i];
+    mCc_cache_key_add_uint(scan->key, decl->type);
+    mCc_func_cache_scan_literal(scan, decl->array_size);
+    mCc_cache_key_add_string(scan->key,
+                             mCc_ast_compact_name(scan->compact,
+                                                  decl->identifier));
+}
+
+static void mCc_func_cache_scan_parameters(struct mCc_func_cache_scan *scan,
+                                           uint32_t list) {
+    uint32_t count;
+    const uint32_t *decls = mCc_ast_compact_list(scan->compact, list, &count);
+    mCc_cache_key_add_uint(scan->key, count);
+    for (uint32_t i = 0; i < count; ++i)
+        mCc_func_cache_scan_declaration(scan, decls[i]);
+}
+
+/* The signature of a callee, which linking found among the functions of the
+ * program or the built-ins */
+static void mCc_func_cache_scan_callee(struct mCc_func_cache_scan *scan,
+                                       const char *name) {
+    uint32_t function = mCc_ast_compact_find_function(scan->compact, name);
+    const struct mCc_ast_function_def *built_in;
+    if (function != MCC_AST_COMPACT_NONE) {
+        const struct mCc_ast_compact_function *f =
+                &scan->compact->functions.data[function];
+        mCc_cache_key_add_uint(scan->key, false);
+        mCc_cache_key_add_uint(scan->key, f->type);
+        mCc_func_cache_scan_parameters(scan, f->parameters);
+    } else if ((built_in = mCc_symtab_built_in(name))) {
+        mCc_cache_key_add_uint(scan->key, true);
+        mCc_cache_key_add_uint(scan->key, built_in->func_type);
+        mCc_func_cache_add_parameters(scan->key, built_in->para);
+    } else {
+        mCc_cache_key_add_uint(scan->key, none);
+    }
+}
+
+/* An expression and its sub-expressions */
+static void mCc_func_cache_scan_expression(struct mCc_func_cache_scan *scan) {
+    struct mCc_cache_key *key = scan->key;
+    for (uint32_t pending = 1; pending; --pending) {
+        const struct mCc_ast_compact_expression *exp =
+                &scan->compact->expressions.data[scan->expression++];
+        mCc_cache_key_add_uint(key, exp->type);
+        mCc_cache_key_add_uint(key, exp->computed_type);
+        switch ((enum mCc_ast_expression_type)exp->type) {
+            case MCC_AST_EXPRESSION_TYPE_LITERAL:
+                mCc_func_cache_scan_literal(scan, exp->a);
+                break;
+            case MCC_AST_EXPRESSION_TYPE_IDENTIFIER:
+                mCc_cache_key_add_string(
+                        key, mCc_ast_compact_name(scan->compact, exp->a));
+                break;
+            case MCC_AST_EXPRESSION_TYPE_UNARY_OP:
+                mCc_cache_key_add_uint(key, exp->op);
+                pending += 1;
+                break;
+            case MCC_AST_EXPRESSION_TYPE_BINARY_OP:
+                mCc_cache_key_add_uint(key, exp->op);
+                pending += 2;
+                break;
+            case MCC_AST_EXPRESSION_TYPE_PARENTH:
+                pending += 1;
+                break;
+            case MCC_AST_EXPRESSION_TYPE_CALL_EXPR: {
+                const char *name = mCc_ast_compact_name(scan->compact, exp->a);
+                mCc_cache_key_add_string(key, name);
+                mCc_func_cache_scan_callee(scan, name);
+                uint32_t count;
+                mCc_ast_compact_list(scan->compact, exp->b, &count);
+                mCc_cache_key_add_uint(key, count);
+                pending += count;
+                break;
+            }
+            case MCC_AST_EXPRESSION_TYPE_ARR_SUBSCR:
+                mCc_cache_key_add_string(
+                        key, mCc_ast_compact_name(scan->compact, exp->a));
+                pending += 1;
+                break;
+        }
+    }
+}
+
+/* A statement and its sub-statements */
+static void mCc_func_cache_scan_statement(struct mCc_func_cache_scan *scan) {
+    struct mCc_cache_key *key = scan->key;
+    for (uint32_t pending = 1; pending; --pending) {
+        const struct mCc_ast_compact_statement *stmt =
+                &scan->compact->statements.data[scan->statement++];
+        mCc_cache_key_add_uint(key, stmt->type);
+        switch ((enum mCc_ast_statement_type)stmt->type) {
+            case MCC_AST_STATEMENT_TYPE_IF:
+                mCc_func_cache_scan_expression(scan);
+                pending += 1;
+                break;
+            case MCC_AST_STATEMENT_TYPE_IFELSE:
+                mCc_func_cache_scan_expression(scan);
+                pending += 2;
+                break;
+            case MCC_AST_STATEMENT_TYPE_RET:
+                mCc_func_cache_scan_expression(scan);
+                break;
+            case MCC_AST_STATEMENT_TYPE_RET_VOID:
+                break;
+            case MCC_AST_STATEMENT_TYPE_WHILE:
+                mCc_func_cache_scan_expression(scan);
+                pending += 1;
+                break;
+            case MCC_AST_STATEMENT_TYPE_DECL:
+                mCc_func_cache_scan_declaration(scan, stmt->a);
+                break;
+            case MCC_AST_STATEMENT_TYPE_ASSGN:
+                mCc_cache_key_add_string(
+                        key, mCc_ast_compact_name(scan->compact, stmt->a));
+                if (stmt->b == MCC_AST_COMPACT_NONE)
+                    mCc_cache_key_add_uint(key, none);
+                else
+                    mCc_func_cache_scan_expression(scan);
+                mCc_func_cache_scan_expression(scan);
+                break;
+            case MCC_AST_STATEMENT_TYPE_EXPR:
+                mCc_func_cache_scan_expression(scan);
+                break;
+            case MCC_AST_STATEMENT_TYPE_CMPND: {
+                uint32_t count;
+                mCc_ast_compact_list(scan->compact, stmt->a, &count);
+                mCc_cache_key_add_uint(key, count);
+                pending += count;
+                break;
+            }
+        }
+    }
+}
+
+void mCc_func_cache_fingerprint_compact(
+        struct mCc_cache_key *key, const struct mCc_ast_compact *compact,
+        uint32_t function, const struct mCc_tac_opt_options *options) {
+    const struct mCc_ast_compact_function *f =
+            &compact->functions.data[function];
+    struct mCc_func_cache_scan scan = {
+        .key = key,
+        .compact = compact,
+        .expression = f->first_expression,
+        .statement = f->body,
+    };
+    mCc_func_cache_add_options(key, options);
+    mCc_cache_key_add_string(key, mCc_ast_compact_name(compact, f->identifier));
+    mCc_cache_key_add_uint(key, f->type);
+    mCc_func_cache_scan_parameters(&scan, f->parameters);
+    if (f->body == MCC_AST_COMPACT_NONE)
+        mCc_cache_key_add_uint(key, none);
+    else
+        mCc_func_cache_scan_statement(&scan);
+}
+
+/*********************************** Cache */
+
+int mCc_func_cache_init(struct mCc_func_cache *cache, struct mCc_cache *disk,
+                        const struct mCc_cache_key *prefix) {
+    memset(cache, 0, sizeof(*cache));
+    cache->disk = disk;
+    if (disk && prefix && prefix->size) {
+        if (!(cache->prefix = malloc(prefix->size)))
+            return 1;
+        memcpy(cache->prefix, prefix->data, prefix->size);
+        cache->prefix_size = prefix->size;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    return 0;
+}
+
+static void mCc_func_cache_delete_entry(struct mCc_func_cache *cache,
+                                        struct mCc_func_cache_entry *entry) {
+    HASH_DEL(cache->entries, entry);
+    free(entry->key);
+    free(entry->assembly);
+    free(entry);
+}
+
+void mCc_func_cache_free(struct mCc_func_cache *cache) {
+    struct mCc_func_cache_entry *entry, *tmp;
+    HASH_ITER(hh, cache->entries, entry, tmp)
+        mCc_func_cache_delete_entry(cache, entry);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->prefix);
+    cache->prefix = NULL;
+}
+
+/* Copy a function from memory to out, under the lock */
+static int mCc_func_cache_lookup(struct mCc_func_cache *cache,
+                                 const struct mCc_cache_key *key,
+                                 struct mCc_writer *out) {
+    struct mCc_func_cache_entry *entry;
+    HASH_FIND(hh, cache->entries, key->data, key->size, entry);
+    if (!entry)
+        return 1;
+    entry->last_used = cache->generation;
+    mCc_writer_write(out, entry->assembly, entry->size);
+    return 0;
+}
+
+/* Add a function to memory, which takes the assembly, under the lock */
+static void mCc_func_cache_insert(struct mCc_func_cache *cache,
+                                  const struct mCc_cache_key *key,
+                                  char *assembly, size_t size) {
+    struct mCc_func_cache_entry *entry;
+    HASH_FIND(hh, cache->entries, key->data, key->size, entry);
+    if (entry) {
+        // Another thread generated it at the same time
+        free(assembly);
+        return;
+    }
+    entry = calloc(1, sizeof(*entry));
+    if (entry)
+        entry->key = malloc(key->size);
+    if (!entry || !entry->key) {
+        free(entry);
+        free(assembly);
+        return;
+    }
+    memcpy(entry->key, key->data, key->size);
+    entry->key_size = key->size;
+    entry->assembly = assembly;
+    entry->size = size;
+    entry->last_used = cache->generation;
+    HASH_ADD_KEYPTR(hh, cache->entries, entry->key, entry->key_size, entry);
+}
+
+/* Build, optimise and generate a single function */
+static char *mCc_func_cache_generate(struct mCc_context *ctx,
+                                     struct mCc_ast_function_def *fun_def,
+                                     const struct mCc_tac_opt_options *options,
+                                     size_t *size) {
+    struct mCc_tac_program *tac = mCc_tac_build_function(ctx, fun_def);
+    if (!tac)
+        return NULL;
+    if (mCc_tac_optimize(tac, options)) {
+        mCc_tac_program_delete(tac);
+        return NULL;
+    }
+
+    struct mCc_writer *writer = malloc(sizeof(*writer));
+    if (!writer) {
+        mCc_tac_program_delete(tac);
+        return NULL;
+    }
+    mCc_writer_init_memory(writer);
+    if (tac->quad_count)
+        mCc_asm_write_function(ctx, tac, 0, tac->quad_count, writer);
+    mCc_tac_program_delete(tac);
+    char *assembly = mCc_writer_take_memory(writer, size);
+    free(writer);
+    return assembly;
+}
+
+/* Write a single function from memory, disk or by generating it */
+static int mCc_func_cache_write_function(
+        struct mCc_func_cache *cache, struct mCc_context *ctx,
+        const struct mCc_ast_compact *compact, uint32_t function,
+        struct mCc_ast_function_def *fun_def,
+        const struct mCc_tac_opt_options *options, struct mCc_writer *out) {
+    struct mCc_cache_key key;
+    mCc_cache_key_init(&key);
+    if (cache->disk)
+        mCc_cache_key_add(&key, cache->prefix, cache->prefix_size);
+    mCc_func_cache_fingerprint_compact(&key, compact, function, options);
+    if (mCc_cache_key_finish(&key)) {
+        mCc_cache_key_free(&key);
+        return 1;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    int miss = mCc_func_cache_lookup(cache, &key, out);
+    if (!miss)
+        ++cache->stats.hits;
+    pthread_mutex_unlock(&cache->lock);
+    if (!miss) {
+        mCc_cache_key_free(&key);
+        return 0;
+    }
+
+    char *assembly = NULL;
+    size_t size;
+    int from_disk = cache->disk &&
+                    !mCc_cache_get(cache->disk, &key, &assembly, &size);
+    if (!from_disk &&
+        !(assembly = mCc_func_cache_generate(ctx, fun_def, options, &size))) {
+        mCc_cache_key_free(&key);
+        return 1;
+    }
+    mCc_writer_write(out, assembly, size);
+    if (cache->disk && !from_disk)
+        mCc_cache_put(cache->disk, &key, assembly, size);
+
+    pthread_mutex_lock(&cache->lock);
+    if (from_disk)
+        ++cache->stats.hits;
+    else
+        ++cache->stats.misses;
+    mCc_func_cache_insert(cache, &key, assembly, size);
+    pthread_mutex_unlock(&cache->lock);
+    mCc_cache_key_free(&key);
+    return 0;
+}
+
+/* Forget the functions that were not used for a while, under the lock */
+static void mCc_func_cache_evict(struct mCc_func_cache *cache) {
+    struct mCc_func_cache_entry *entry, *tmp;
+    HASH_ITER(hh, cache->entries, entry, tmp) {
+        if (entry->last_used + MCC_FUNC_CACHE_MAX_AGE < cache->generation)
+            mCc_func_cache_delete_entry(cache, entry);
+    }
+}
+
+int mCc_func_cache_write_assembly(struct mCc_func_cache *cache,
+                                  struct mCc_context *ctx,
+                                  struct mCc_ast_program *prog,
+                                  const struct mCc_tac_opt_options *options,
+                                  struct mCc_writer *out,
+                                  const char *source_filename) {
+    pthread_mutex_lock(&cache->lock);
+    ++cache->generation;
+    mCc_func_cache_evict(cache);
+    pthread_mutex_unlock(&cache->lock);
+
+    // The fingerprints are taken from the compact form of the program
+    struct mCc_ast_compact compact;
+    const struct mCc_source *source = prog->source;
+    if (mCc_ast_compact_build(&compact, prog, source ? source->data : "",
+                              source ? source->size : 0)) {
+        mCc_ast_compact_free(&compact);
+        return 1;
+    }
+
+    mCc_asm_write_header(out, source_filename);
+    int result = 0;
+    for (unsigned int i = 0; i < prog->func_def_count && !result; ++i)
+        result = mCc_func_cache_write_function(cache, ctx, &compact, i,
+                                               prog->func_defs[i], options,
+                                               out);
+    mCc_ast_compact_free(&compact);
+    return result;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file intern.c
+ * @brief String interning.
+ * @author richard
+ * @date 2018-07-08
+ */
+#include "mCc/intern.h"
+
+#include <string.h>
+
+#include "mCc/arena.h"
+
+/// Strings are packed into chunks of this size, longer ones get their own
+#define MCC_INTERNER_CHARS_SIZE (4096)
+
+/* FNV-1a */
+static uint32_t mCc_interner_hash(const char *str, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* The slot holding a string, or the empty slot where it belongs */
+static mCc_atom *mCc_interner_slot(const struct mCc_interner *interner,
+                                   const char *str, size_t length,
+                                   uint32_t hash) {
+    uint32_t mask = interner->capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        mCc_atom *slot = &interner->slots[i];
+        if (*slot == MCC_ATOM_NONE)
+            return slot;
+        const struct mCc_interner_string *s = &interner->strings[*slot];
+        if (s->hash == hash && s->length == length &&
+            memcmp(s->str, str, length) == 0)
+            return slot;
+    }
+}
+
+/* Double the hash table, 0 on success */
+static int mCc_interner_grow(struct mCc_interner *interner) {
+    uint32_t capacity = interner->capacity * 2;
+    mCc_atom *slots =
+            mCc_arena_alloc(interner->arena, capacity * sizeof(*slots));
+    if (!slots)
+        return 1;
+    memset(slots, 0, capacity * sizeof(*slots));
+
+    // The old table stays in the arena, at most as large as the new one
+    interner->slots = slots;
+    interner->capacity = capacity;
+    for (mCc_atom atom = 1; atom < interner->count; ++atom) {
+        uint32_t i = interner->strings[atom].hash & (capacity - 1);
+        while (slots[i] != MCC_ATOM_NONE)
+            i = (i + 1) & (capacity - 1);
+        slots[i] = atom;
+    }
+    return 0;
+}
+
+/* Copy a string into the chunk of characters, NULL on memory error */
+static char *mCc_interner_copy(struct mCc_interner *interner, const char *str,
+                               size_t length) {
+    char *copy;
+    if (length + 1 > MCC_INTERNER_CHARS_SIZE / 4) {
+        copy = mCc_arena_alloc(interner->arena, length + 1);
+    } else {
+        if ((size_t)(interner->chars_end - interner->chars) < length + 1) {
+            interner->chars =
+                    mCc_arena_alloc(interner->arena, MCC_INTERNER_CHARS_SIZE);
+            if (!interner->chars) {
+                interner->chars_end = NULL;
+                return NULL;
+            }
+            interner->chars_end = interner->chars + MCC_INTERNER_CHARS_SIZE;
+        }
+        copy = interner->chars;
+        interner->chars += length + 1;
+    }
+    if (!copy)
+        return NULL;
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+struct mCc_interner *mCc_interner_new(struct mCc_arena *arena) {
+    bool own_arena = !arena;
+    if (own_arena && !(arena = mCc_arena_new()))
+        return NULL;
+
+    struct mCc_interner *interner = mCc_arena_alloc(arena, sizeof(*interner));
+    mCc_atom *slots = mCc_arena_alloc(
+            arena, MCC_INTERNER_FIRST_CAPACITY * sizeof(*slots));
+    struct mCc_interner_string *strings = mCc_arena_alloc(
+            arena, MCC_INTERNER_FIRST_CAPACITY / 2 * sizeof(*strings));
+    if (!interner || !slots || !strings) {
+        if (own_arena)
+            mCc_arena_delete(arena);
+        return NULL;
+    }
+    memset(slots, 0, MCC_INTERNER_FIRST_CAPACITY * sizeof(*slots));
+    strings[MCC_ATOM_NONE] = (struct mCc_interner_string){NULL, 0, 0};
+
+    *interner = (struct mCc_interner){
+            .arena = arena,
+            .own_arena = own_arena,
+            .slots = slots,
+            .capacity = MCC_INTERNER_FIRST_CAPACITY,
+            .strings = strings,
+            .count = 1,
+            .strings_capacity = MCC_INTERNER_FIRST_CAPACITY / 2,
+            .chars = NULL,
+            .chars_end = NULL,
+    };
+    return interner;
+}
+
+void mCc_interner_delete(struct mCc_interner *interner) {
+    if (interner && interner->own_arena)
+        mCc_arena_delete(interner->arena);
+}
+
+mCc_atom mCc_interner_intern(struct mCc_interner *interner, const char *str,
+                             size_t length) {
+    uint32_t hash = mCc_interner_hash(str, length);
+    mCc_atom *slot = mCc_interner_slot(interner, str, length, hash);
+    if (*slot != MCC_ATOM_NONE)
+        return *slot;
+
+    // Keep the table at most half full
+    if (interner->count > interner->capacity / 2) {
+        if (mCc_interner_grow(interner))
+            return MCC_ATOM_NONE;
+        slot = mCc_interner_slot(interner, str, length, hash);
+    }
+    if (interner->count == interner->strings_capacity) {
+        uint32_t capacity = interner->strings_capacity * 2;
+        struct mCc_interner_string *strings = mCc_arena_realloc(
+                interner->arena, interner->strings,
+                interner->strings_capacity * sizeof(*strings),
+                capacity * sizeof(*strings));
+        if (!strings)
+            return MCC_ATOM_NONE;
+        interner->strings = strings;
+        interner->strings_capacity = capacity;
+    }
+
+    char *copy = mCc_interner_copy(interner, str, length);
+    if (!copy)
+        return MCC_ATOM_NONE;
+    mCc_atom atom = interner->count++;
+    interner->strings[atom] =
+            (struct mCc_interner_string){copy, (uint32_t)length, hash};
+    *slot = atom;
+    return atom;
+}
+
+mCc_atom mCc_interner_find(const struct mCc_interner *interner,
+                           const char *str, size_t length) {
+    return *mCc_interner_slot(interner, str, length,
+                              mCc_interner_hash(str, length));
+}
+
+const char *mCc_interner_str(const struct mCc_interner *interner,
+                             mCc_atom atom) {
+    if (atom >= interner->count)
+        return NULL;
+    return interner->strings[atom].str;
+}
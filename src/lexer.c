@@ -0,0 +1,448 @@
+/**
+ * @file lexer.c
+ * @brief Hand-written lexer.
+ * @author richard
+ * @date 2018-07-11
+ */
+#include "mCc/lexer.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mCc/source.h"
+#include "parser.tab.h"
+
+#define YYSTYPE MCC_PARSER_STYPE
+#define YYLTYPE MCC_PARSER_LTYPE
+#include "scanner.h"
+
+/*********************************** Characters */
+
+static inline bool mCc_lexer_is_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool mCc_lexer_is_digit(unsigned char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+static inline bool mCc_lexer_is_alpha(unsigned char c) {
+    return (unsigned char)((c | 0x20) - 'a') < 26 || c == '_';
+}
+
+#if defined(__AVX2__)
+#define MCC_LEXER_VECTOR_SIZE (32)
+typedef __m256i mCc_lexer_vector;
+#define mCc_lexer_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define mCc_lexer_eq(v, c) _mm256_cmpeq_epi8((v), _mm256_set1_epi8(c))
+#define mCc_lexer_or(a, b) _mm256_or_si256((a), (b))
+#define mCc_lexer_mask(v) ((uint32_t)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__)
+#define MCC_LEXER_VECTOR_SIZE (16)
+typedef __m128i mCc_lexer_vector;
+#define mCc_lexer_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define mCc_lexer_eq(v, c) _mm_cmpeq_epi8((v), _mm_set1_epi8(c))
+#define mCc_lexer_or(a, b) _mm_or_si128((a), (b))
+#define mCc_lexer_mask(v) ((uint32_t)_mm_movemask_epi8(v))
+#endif
+
+/* The first byte that is not whitespace */
+static char *mCc_lexer_skip_space(char *p, const char *end) {
+#ifdef MCC_LEXER_VECTOR_SIZE
+    // Most runs are a single space or a newline and indentation
+    if (!mCc_lexer_is_space(*p))
+        return p;
+    const uint32_t all = (uint32_t)((1ull << MCC_LEXER_VECTOR_SIZE) - 1);
+    while (end - p >= MCC_LEXER_VECTOR_SIZE) {
+        mCc_lexer_vector v = mCc_lexer_load(p);
+        mCc_lexer_vector space =
+                mCc_lexer_or(mCc_lexer_or(mCc_lexer_eq(v, ' '),
+                                          mCc_lexer_eq(v, '\t')),
+                             mCc_lexer_or(mCc_lexer_eq(v, '\n'),
+                                          mCc_lexer_eq(v, '\r')));
+        uint32_t other = ~mCc_lexer_mask(space) & all;
+        if (other)
+            return p + __builtin_ctz(other);
+        p += MCC_LEXER_VECTOR_SIZE;
+    }
+#endif
+    while (p < end && mCc_lexer_is_space(*p))
+        ++p;
+    return p;
+}
+
+/* The first star, end if there is none */
+static char *mCc_lexer_find_star(char *p, const char *end) {
+#ifdef MCC_LEXER_VECTOR_SIZE
+    while (end - p >= MCC_LEXER_VECTOR_SIZE) {
+        uint32_t star = mCc_lexer_mask(mCc_lexer_eq(mCc_lexer_load(p), '*'));
+        if (star)
+            return p + __builtin_ctz(star);
+        p += MCC_LEXER_VECTOR_SIZE;
+    }
+#endif
+    while (p < end && *p != '*')
+        ++p;
+    return p;
+}
+
+/* The end of a comment whose text starts at p, NULL if it is not closed.
+ *
+ * Like the rule in scanner.l, a star that does not close the comment also
+ * takes the byte after it, so an even run of stars before the slash does not
+ * close it. */
+static char *mCc_lexer_skip_comment(char *p, char *end) {
+    for (;;) {
+        p = mCc_lexer_find_star(p, end);
+        if (end - p < 2)
+            return NULL;
+        if (p[1] == '/')
+            return p + 2;
+        p += 2;
+    }
+}
+
+/*********************************** Keywords */
+
+struct mCc_lexer_keyword {
+    const char *word;
+    unsigned int length;
+    int kind;
+    int value; ///< The type or the bool
+};
+
+/// Perfect hash of the keywords, see #mCc_lexer_keywords
+#define mCc_lexer_keyword_hash(s, n)                                           \
+    (((unsigned char)(s)[0] + 12 * (unsigned char)(s)[(n)-1] + (n)) & 15)
+
+/// The keywords by their hash
+static const struct mCc_lexer_keyword mCc_lexer_keywords[16] = {
+    [0] = {"return", 6, TK_RETURN, 0},
+    [3] = {"if", 2, TK_IF, 0},
+    [4] = {"true", 4, TK_BOOL_LITERAL, true},
+    [5] = {"else", 4, TK_ELSE, 0},
+    [6] = {"bool", 4, TK_TYPE, MCC_AST_TYPE_BOOL},
+    [7] = {"false", 5, TK_BOOL_LITERAL, false},
+    [8] = {"while", 5, TK_WHILE, 0},
+    [10] = {"void", 4, TK_VOID, 0},
+    [11] = {"float", 5, TK_TYPE, MCC_AST_TYPE_FLOAT},
+    [12] = {"int", 3, TK_TYPE, MCC_AST_TYPE_INT},
+    [13] = {"string", 6, TK_TYPE, MCC_AST_TYPE_STRING},
+};
+
+/* The keyword spelled by an identifier, NULL if it is none */
+static const struct mCc_lexer_keyword *
+mCc_lexer_keyword(const char *s, unsigned int length) {
+    if (length < 2 || length > 6)
+        return NULL;
+    const struct mCc_lexer_keyword *k =
+            &mCc_lexer_keywords[mCc_lexer_keyword_hash(s, length)];
+    if (k->length != length || memcmp(k->word, s, length) != 0)
+        return NULL;
+    return k;
+}
+
+/*********************************** Literals */
+
+/// Powers of ten that are exact doubles
+static const double mCc_lexer_powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* The value of the digits up to end, saturated like by strtol */
+static long mCc_lexer_int(const char *p, const char *end) {
+    long value = 0;
+    for (; p < end; ++p) {
+        int digit = *p - '0';
+        if (value > (LONG_MAX - digit) / 10)
+            return LONG_MAX;
+        value = 10 * value + digit;
+    }
+    return value;
+}
+
+/* The value of a NUL-terminated [0-9]+\.[0-9]+, rounded like by strtod.
+ *
+ * The digits and the power of ten are exact doubles if there are few enough
+ * of them, so one division gives the correctly rounded value. Longer
+ * literals are left to strtod. */
+static double mCc_lexer_float(const char *p) {
+    const char *start = p;
+    uint64_t mantissa = 0;
+    unsigned int fraction = 0;
+    bool in_fraction = false;
+    for (; *p; ++p) {
+        if (*p == '.') {
+            in_fraction = true;
+            continue;
+        }
+        if (mantissa >= (1ull << 53) / 10)
+            return strtod(start, NULL);
+        mantissa = 10 * mantissa + (*p - '0');
+        fraction += in_fraction;
+    }
+    if (fraction >= sizeof(mCc_lexer_powers) / sizeof(*mCc_lexer_powers))
+        return strtod(start, NULL);
+    return (double)mantissa / mCc_lexer_powers[fraction];
+}
+
+/*********************************** Scanning */
+
+void mCc_lexer_init(struct mCc_lexer *lexer, struct mCc_source *source) {
+    *lexer = (struct mCc_lexer){
+            .source = source,
+            .cur = source->data,
+            .end = source->data + source->size,
+            .text = source->data + source->size,
+            .held = NULL,
+            .held_char = '\0',
+            .last_start = 0,
+            .last_end = 0,
+    };
+}
+
+void mCc_lexer_close(struct mCc_lexer *lexer) {
+    if (lexer->held)
+        *lexer->held = lexer->held_char;
+    lexer->held = NULL;
+}
+
+/* Record the range of a match */
+static void mCc_lexer_match(struct mCc_lexer *lexer, const char *start,
+                            const char *end) {
+    lexer->last_start = start - lexer->source->data;
+    lexer->last_end = end - lexer->source->data;
+}
+
+/* Finish a token from start to end */
+static int mCc_lexer_token(struct mCc_lexer *lexer,
+                           struct mCc_lexer_token *token, int kind,
+                           char *start, char *end) {
+    mCc_lexer_match(lexer, start, end);
+    token->kind = kind;
+    token->start_offset = lexer->last_start;
+    token->end_offset = lexer->last_end;
+    token->text = lexer->text = start;
+    lexer->held = end;
+    lexer->held_char = *end;
+    *end = '\0';
+    lexer->cur = end;
+    return kind;
+}
+
+int mCc_lexer_next(struct mCc_lexer *lexer, struct mCc_lexer_token *token) {
+    mCc_lexer_close(lexer);
+    char *p = lexer->cur;
+    char *end = lexer->end;
+
+    for (;;) {
+        char *start = p;
+        switch (*p) {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                p = mCc_lexer_skip_space(p + 1, end);
+                mCc_lexer_match(lexer, start, p);
+                continue;
+
+            case '/':
+                if (p[1] == '*') {
+                    char *comment_end = mCc_lexer_skip_comment(p + 2, end);
+                    if (comment_end) {
+                        p = comment_end;
+                        mCc_lexer_match(lexer, start, p);
+                        continue;
+                    }
+                }
+                return mCc_lexer_token(lexer, token, TK_SLASH, p, p + 1);
+
+            case '"': {
+                char *quote = memchr(p + 1, '"', end - (p + 1));
+                if (!quote)
+                    break;
+                return mCc_lexer_token(lexer, token, TK_STRING_LITERAL, p,
+                                       quote + 1);
+            }
+
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9':
+                while (mCc_lexer_is_digit(*++p))
+                    ;
+                if (*p == '.' && mCc_lexer_is_digit(p[1])) {
+                    while (mCc_lexer_is_digit(*++p))
+                        ;
+                    mCc_lexer_token(lexer, token, TK_FLOAT_LITERAL, start, p);
+                    token->f_value = mCc_lexer_float(start);
+                    return TK_FLOAT_LITERAL;
+                }
+                token->i_value = mCc_lexer_int(start, p);
+                return mCc_lexer_token(lexer, token, TK_INT_LITERAL, start, p);
+
+            case '+': return mCc_lexer_token(lexer, token, TK_PLUS, p, p + 1);
+            case '-': return mCc_lexer_token(lexer, token, TK_MINUS, p, p + 1);
+            case '*': return mCc_lexer_token(lexer, token, TK_ASTER, p, p + 1);
+            case ';':
+                return mCc_lexer_token(lexer, token, TK_SEMICOLON, p, p + 1);
+            case ',': return mCc_lexer_token(lexer, token, TK_COMMA, p, p + 1);
+            case '(':
+                return mCc_lexer_token(lexer, token, TK_LPARENTH, p, p + 1);
+            case ')':
+                return mCc_lexer_token(lexer, token, TK_RPARENTH, p, p + 1);
+            case '{': return mCc_lexer_token(lexer, token, TK_LBRACE, p, p + 1);
+            case '}': return mCc_lexer_token(lexer, token, TK_RBRACE, p, p + 1);
+            case '[': return mCc_lexer_token(lexer, token, TK_LBRACK, p, p + 1);
+            case ']': return mCc_lexer_token(lexer, token, TK_RBRACK, p, p + 1);
+
+            case '<':
+                if (p[1] == '=')
+                    return mCc_lexer_token(lexer, token, TK_LESS_EQ, p, p + 2);
+                return mCc_lexer_token(lexer, token, TK_LESS, p, p + 1);
+            case '>':
+                if (p[1] == '=')
+                    return mCc_lexer_token(lexer, token, TK_GREATER_EQ, p,
+                                           p + 2);
+                return mCc_lexer_token(lexer, token, TK_GREATER, p, p + 1);
+            case '=':
+                if (p[1] == '=')
+                    return mCc_lexer_token(lexer, token, TK_EQUALS, p, p + 2);
+                return mCc_lexer_token(lexer, token, TK_ASSGN, p, p + 1);
+            case '!':
+                if (p[1] == '=')
+                    return mCc_lexer_token(lexer, token, TK_NOT_EQUALS, p,
+                                           p + 2);
+                return mCc_lexer_token(lexer, token, TK_NOT, p, p + 1);
+            case '&':
+                if (p[1] == '&')
+                    return mCc_lexer_token(lexer, token, TK_AND, p, p + 2);
+                break;
+            case '|':
+                if (p[1] == '|')
+                    return mCc_lexer_token(lexer, token, TK_OR, p, p + 2);
+                break;
+
+            case '\0':
+                if (p < end)
+                    break;
+                // The end keeps the range of the last match
+                token->kind = TK_END;
+                token->start_offset = lexer->last_start;
+                token->end_offset = lexer->last_end;
+                token->text = lexer->text = end;
+                lexer->cur = end;
+                return TK_END;
+
+            default:
+                if (!mCc_lexer_is_alpha(*p))
+                    break;
+                while (mCc_lexer_is_alpha(*++p) || mCc_lexer_is_digit(*p))
+                    ;
+                const struct mCc_lexer_keyword *keyword =
+                        mCc_lexer_keyword(start, p - start);
+                if (!keyword)
+                    return mCc_lexer_token(lexer, token, TK_IDENTIFIER, start,
+                                           p);
+                if (keyword->kind == TK_TYPE)
+                    token->type = keyword->value;
+                else if (keyword->kind == TK_BOOL_LITERAL)
+                    token->b_value = keyword->value;
+                return mCc_lexer_token(lexer, token, keyword->kind, start, p);
+        }
+
+        // Like the catch-all rule of the flex scanner
+        fprintf(stderr, "invalid character '%c'\n", *start);
+        p = start + 1;
+        mCc_lexer_match(lexer, start, p);
+    }
+}
+
+/*********************************** Comparison */
+
+/* Append a token, 0 on success */
+static int mCc_lexer_append(struct mCc_lexer_token **tokens,
+                            unsigned int *count, unsigned int *capacity,
+                            const struct mCc_lexer_token *token) {
+    if (*count == *capacity) {
+        unsigned int new_capacity = *capacity ? 2 * *capacity : 1024;
+        struct mCc_lexer_token *tmp =
+                realloc(*tokens, new_capacity * sizeof(*tmp));
+        if (!tmp)
+            return 1;
+        *tokens = tmp;
+        *capacity = new_capacity;
+    }
+    (*tokens)[(*count)++] = *token;
+    (*tokens)[*count - 1].text = NULL;
+    return 0;
+}
+
+static struct mCc_lexer_token *
+mCc_lexer_flex_tokens(struct mCc_source *source, unsigned int *count) {
+    struct mCc_lexer_token *tokens = NULL, token;
+    unsigned int capacity = 0;
+    yyscan_t scanner;
+    if (mCc_parser_lex_init_extra(source, &scanner))
+        return NULL;
+    if (!mCc_parser__scan_buffer(source->data, source->size + 2, scanner)) {
+        mCc_parser_lex_destroy(scanner);
+        return NULL;
+    }
+
+    MCC_PARSER_STYPE value;
+    MCC_PARSER_LTYPE loc = {0, 0};
+    do {
+        token.kind = mCc_parser_lex(&value, &loc, scanner);
+        token.start_offset = loc.first_offset;
+        token.end_offset = loc.last_offset;
+        token.i_value = 0;
+        switch (token.kind) {
+            case TK_INT_LITERAL: token.i_value = value.TK_INT_LITERAL; break;
+            case TK_FLOAT_LITERAL:
+                token.f_value = value.TK_FLOAT_LITERAL;
+                break;
+            case TK_BOOL_LITERAL: token.b_value = value.TK_BOOL_LITERAL; break;
+            case TK_TYPE: token.type = value.TK_TYPE; break;
+        }
+        if (mCc_lexer_append(&tokens, count, &capacity, &token)) {
+            free(tokens);
+            tokens = NULL;
+            break;
+        }
+    } while (token.kind != TK_END);
+
+    mCc_parser_lex_destroy(scanner);
+    return tokens;
+}
+
+struct mCc_lexer_token *mCc_lexer_tokens(struct mCc_source *source,
+                                         enum mCc_lexer_kind kind,
+                                         unsigned int *count) {
+    *count = 0;
+    if (kind == MCC_LEXER_KIND_FLEX)
+        return mCc_lexer_flex_tokens(source, count);
+
+    struct mCc_lexer_token *tokens = NULL, token;
+    unsigned int capacity = 0;
+    struct mCc_lexer lexer;
+    mCc_lexer_init(&lexer, source);
+    do {
+        token.i_value = 0;
+        mCc_lexer_next(&lexer, &token);
+        if (mCc_lexer_append(&tokens, count, &capacity, &token)) {
+            free(tokens);
+            tokens = NULL;
+            break;
+        }
+    } while (token.kind != TK_END);
+    mCc_lexer_close(&lexer);
+    return tokens;
+}
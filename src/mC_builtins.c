@@ -1,4 +1,20 @@
-#include <stdio.h>
+/**
+ * @file mC_builtins.c
+ * @brief The built-in functions of mC.
+ *
+ * One implementation for both ways of linking a program: built as is, it
+ * writes and reads through the C library for linking with gcc. Built with
+ * -DMCC_FREESTANDING -m32 -ffreestanding it becomes mC_runtime.o, which uses
+ * Linux system calls and brings its own start-up code, so that the integrated
+ * linker needs no C library (see meson.build). Only the I/O shim below
+ * differs; numbers are formatted and parsed by the same code, so both print
+ * floats exactly like printf("%f").
+ *
+ * @author richard
+ * @date 2018-06-20
+ */
+
+typedef unsigned long long u64;
 
 void __attribute__((cdecl)) print(const char *msg);
 void __attribute__((cdecl)) print_nl(void);
@@ -7,40 +23,326 @@ void __attribute__((cdecl)) print_float(float x);
 long __attribute__((cdecl)) read_int(void);
 long __attribute__((cdecl)) read_float(void);
 
+/* ------------------------------------------------------------------ I/O shim
+ * put_char buffers a character of output, get_char returns the next character
+ * of input or -1 at the end, unget_char puts back what get_char returned. */
+
+#ifdef MCC_FREESTANDING
+
+#define SYS_EXIT (1)
+#define SYS_READ (3)
+#define SYS_WRITE (4)
+
+extern int main(void);
+
+static char out_buf[4096];
+static int out_len;
+static char in_buf[4096];
+static int in_len;
+static int in_pos;
+
+static int syscall3(int number, int a, int b, int c)
+{
+	int ret;
+	__asm__ volatile("int $0x80"
+	                 : "=a"(ret)
+	                 : "a"(number), "b"(a), "c"(b), "d"(c)
+	                 : "memory");
+	return ret;
+}
+
+static void flush(void)
+{
+	int done = 0;
+	while (done < out_len) {
+		int ret = syscall3(SYS_WRITE, 1, (int)(out_buf + done),
+		                   out_len - done);
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+	out_len = 0;
+}
+
+static void put_char(char c)
+{
+	if (out_len == sizeof(out_buf))
+		flush();
+	out_buf[out_len++] = c;
+}
+
+/* Output is flushed before waiting for input */
+static int get_char(void)
+{
+	if (in_pos == in_len) {
+		flush();
+		in_len = syscall3(SYS_READ, 0, (int)in_buf, sizeof(in_buf));
+		in_pos = 0;
+		if (in_len <= 0) {
+			in_len = 0;
+			return -1;
+		}
+	}
+	return (unsigned char)in_buf[in_pos++];
+}
+
+static void unget_char(int c)
+{
+	if (c >= 0)
+		--in_pos;
+}
+
+#else
+
+#include <stdio.h>
+
+static void put_char(char c)
+{
+	putchar(c);
+}
+
+static int get_char(void)
+{
+	return getchar();
+}
+
+static void unget_char(int c)
+{
+	if (c >= 0)
+		ungetc(c, stdin);
+}
+
+#endif
+
+/* ------------------------------------------------------------------- Output */
+
+static void put_string(const char *s)
+{
+	while (*s)
+		put_char(*s++);
+}
+
+/* Arbitrary-precision unsigned integer in base 2^16, least significant limb
+ * first. Large enough for any float times 10^6. Limbs are kept small so that
+ * the division by ten needs no 64-bit helpers from libgcc. */
+#define BIG_LIMBS (12)
+
+struct big {
+	unsigned int limb[BIG_LIMBS];
+};
+
+static void big_shift_left(struct big *b, int shift)
+{
+	for (; shift > 0; --shift) {
+		unsigned int carry = 0;
+		for (int i = 0; i < BIG_LIMBS; ++i) {
+			unsigned int v = b->limb[i] << 1 | carry;
+			carry = v >> 16;
+			b->limb[i] = v & 0xffff;
+		}
+	}
+}
+
+static int big_is_zero(const struct big *b)
+{
+	for (int i = 0; i < BIG_LIMBS; ++i)
+		if (b->limb[i])
+			return 0;
+	return 1;
+}
+
+static unsigned int big_div10(struct big *b)
+{
+	unsigned int rem = 0;
+	for (int i = BIG_LIMBS - 1; i >= 0; --i) {
+		unsigned int v = rem << 16 | b->limb[i];
+		b->limb[i] = v / 10;
+		rem = v % 10;
+	}
+	return rem;
+}
+
+/* Print value / 10^decimals with the given number of decimals */
+static void put_big(struct big *b, int decimals)
+{
+	char digits[64];
+	int count = 0;
+	do
+		digits[count++] = '0' + big_div10(b);
+	while (!big_is_zero(b) || count <= decimals);
+	while (count) {
+		if (count == decimals)
+			put_char('.');
+		put_char(digits[--count]);
+	}
+}
+
 void print(const char *msg)
 {
-	printf("%s", msg);
+	put_string(msg);
 }
 
 void print_nl(void)
 {
-	printf("\n");
+	put_char('\n');
 }
 
 void print_int(long x)
 {
-	printf("%ld", x);
+	struct big b = { { 0 } };
+	unsigned long v = x;
+	if (x < 0) {
+		put_char('-');
+		v = -v;
+	}
+	for (int i = 0; v; ++i, v >>= 16)
+		b.limb[i] = v & 0xffff;
+	put_big(&b, 0);
 }
 
+/* Exact decimal expansion like printf("%f"), rounding half to even */
 void print_float(float x)
 {
-	printf("%f", x);
+	union {
+		float f;
+		unsigned int u;
+	} bits = { x };
+	if (bits.u >> 31)
+		put_char('-');
+	unsigned int exponent = (bits.u >> 23) & 0xff;
+	unsigned int mantissa = bits.u & 0x7fffff;
+	if (exponent == 0xff) {
+		put_string(mantissa ? "nan" : "inf");
+		return;
+	}
+	int shift;
+	if (exponent) {
+		mantissa |= 0x800000;
+		shift = (int)exponent - 150;
+	} else {
+		shift = -149;
+	}
+
+	/* value = mantissa * 2^shift, print round(value * 10^6) / 10^6 */
+	u64 scaled = (u64)mantissa * 1000000;
+	struct big b = { { 0 } };
+	if (shift < 0) {
+		int right = -shift;
+		if (right >= 64) {
+			scaled = 0;
+		} else {
+			u64 rem = scaled & ((1ULL << right) - 1);
+			u64 half = 1ULL << (right - 1);
+			scaled >>= right;
+			if (rem > half || (rem == half && (scaled & 1)))
+				++scaled;
+		}
+		shift = 0;
+	}
+	for (int i = 0; i < 4; ++i)
+		b.limb[i] = (scaled >> (16 * i)) & 0xffff;
+	big_shift_left(&b, shift);
+	put_big(&b, 6);
+}
+
+/* -------------------------------------------------------------------- Input */
+
+static int skip_space(void)
+{
+	int c;
+	do
+		c = get_char();
+	while (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+	       c == '\f');
+	return c;
 }
 
 long read_int(void)
 {
-	long ret = 0;
-	scanf("%ld", &ret);
-	return ret;
+	int c = skip_space();
+	int negative = 0;
+	unsigned long value = 0;
+	if (c == '-' || c == '+') {
+		negative = c == '-';
+		c = get_char();
+	}
+	while (c >= '0' && c <= '9') {
+		value = value * 10 + (c - '0');
+		c = get_char();
+	}
+	unget_char(c);
+	return negative ? -(long)value : (long)value;
 }
 
 long read_float(void)
 {
+	int c = skip_space();
+	int negative = 0;
+	double value = 0;
+	double scale = 1;
+	if (c == '-' || c == '+') {
+		negative = c == '-';
+		c = get_char();
+	}
+	while (c >= '0' && c <= '9') {
+		value = value * 10 + (c - '0');
+		c = get_char();
+	}
+	if (c == '.') {
+		c = get_char();
+		while (c >= '0' && c <= '9') {
+			value = value * 10 + (c - '0');
+			scale *= 10;
+			c = get_char();
+		}
+	}
+	if (c == 'e' || c == 'E') {
+		int exp_negative = 0;
+		int exponent = 0;
+		c = get_char();
+		if (c == '-' || c == '+') {
+			exp_negative = c == '-';
+			c = get_char();
+		}
+		while (c >= '0' && c <= '9') {
+			if (exponent < 100)
+				exponent = exponent * 10 + (c - '0');
+			c = get_char();
+		}
+		for (; exponent > 0; --exponent) {
+			if (exp_negative)
+				scale *= 10;
+			else
+				value *= 10;
+		}
+	}
+	unget_char(c);
+
 	union {
 		float asfloat;
 		long aslong;
 	} tmp;
-	/* float ret = 0.0f; */
-	scanf("%f", &tmp.asfloat);
+	tmp.asfloat = (float)((negative ? -value : value) / scale);
 	return tmp.aslong;
 }
+
+/* ----------------------------------------------------------------- Start-up */
+
+#ifdef MCC_FREESTANDING
+
+void __attribute__((noreturn, used)) mC_runtime_start(void)
+{
+	int status = main();
+	flush();
+	syscall3(SYS_EXIT, status, 0, 0);
+	__builtin_unreachable();
+}
+
+/* Align the stack like the start-up code of the C library does */
+__asm__(".text\n"
+        ".global _start\n"
+        "_start:\n"
+        "\tandl $-16, %esp\n"
+        "\tcall mC_runtime_start\n");
+
+#endif
@@ -8,9 +8,16 @@
 %define parse.error verbose
 %verbose
 %locations
+%define api.location.type {struct mCc_parser_location}
 
 %code requires {
 #include "mCc/parser.h"
+
+/// Location of a token or rule, the lines and columns are looked up later
+struct mCc_parser_location {
+	uint32_t first_offset; ///< Offset of the first byte
+	uint32_t last_offset;  ///< Offset after the last byte
+};
 }
 
 %{
@@ -22,12 +29,29 @@
 
 /* Idea to pass start and end location taken from group 16 */
 #define loc(ast_node, yylloc_start, yylloc_end) \
-        (ast_node)->node.sloc.start_col  = (yylloc_start).first_column; \
-        (ast_node)->node.sloc.start_line = (yylloc_start).first_line; \
-        (ast_node)->node.sloc.end_col    = (yylloc_end).last_column - 1; \
-        (ast_node)->node.sloc.end_line   = (yylloc_end).last_line;
-
+        (ast_node)->node.sloc.start_offset = (yylloc_start).first_offset; \
+        (ast_node)->node.sloc.end_offset   = (yylloc_end).last_offset;
+
+/* A rule spans its symbols, an empty one starts where the previous ended */
+#define YYLLOC_DEFAULT(Current, Rhs, N) \
+        do { \
+                if (N) { \
+                        (Current).first_offset = YYRHSLOC(Rhs, 1).first_offset; \
+                        (Current).last_offset  = YYRHSLOC(Rhs, N).last_offset; \
+                } else { \
+                        (Current).first_offset = YYRHSLOC(Rhs, 0).last_offset; \
+                        (Current).last_offset  = YYRHSLOC(Rhs, 0).last_offset; \
+                } \
+        } while (0)
+
+#ifdef MCC_LEXER_HAND
+/* Tokens come from the hand-written lexer instead of flex, see mCc/lexer.h */
+#undef yylex
+#define yylex mCc_parser_lex_hand
+static int mCc_parser_lex_hand();
+#else
 int mCc_parser_lex();
+#endif
 void mCc_parser_error();
 %}
 
@@ -72,7 +96,7 @@ void mCc_parser_error();
 %token VOID "void"
 %token SEMICOLON ";"
 %token COMMA ","
-%token <char*> TYPE "type"
+%token <enum mCc_ast_type> TYPE "type"
 
 /* TYPES */
 %type <enum mCc_ast_unary_op>  unary_op
@@ -120,12 +144,7 @@ toplevel : expression { result->expression = $1; }
          | program    { result->program    = $1; }
          ;
 
-type : TYPE {
-        if (!strcmp("bool", $1) )       $$ = MCC_AST_TYPE_BOOL;
-        else if (!strcmp("int", $1))    $$ = MCC_AST_TYPE_INT;
-        else if (!strcmp("float", $1))  $$ = MCC_AST_TYPE_FLOAT;
-        else if (!strcmp("string", $1)) $$ = MCC_AST_TYPE_STRING;
-     }
+type : TYPE { $$ = $1; }
      ;
 
 literal : INT_LITERAL    { $$ = mCc_ast_new_literal_int($1);    loc($$, @1, @1); }
@@ -214,61 +233,250 @@ program : function_def         { $$ = mCc_ast_new_program($1);     loc($$, @1, @
 
 #include <assert.h>
 
+#include "mCc/arena.h"
+#include "mCc/intern.h"
+#include "mCc/parser_descent.h"
+#include "mCc/source.h"
+#ifdef MCC_LEXER_HAND
+#include "mCc/lexer.h"
+
+static int mCc_parser_lex_hand(MCC_PARSER_STYPE *yylval, MCC_PARSER_LTYPE *yylloc,
+                               struct mCc_lexer *lexer)
+{
+	struct mCc_lexer_token token;
+	int kind = mCc_lexer_next(lexer, &token);
+	yylloc->first_offset = token.start_offset;
+	yylloc->last_offset = token.end_offset;
+	switch (kind) {
+	case TK_INT_LITERAL:    yylval->TK_INT_LITERAL = token.i_value; break;
+	case TK_FLOAT_LITERAL:  yylval->TK_FLOAT_LITERAL = token.f_value; break;
+	case TK_BOOL_LITERAL:   yylval->TK_BOOL_LITERAL = token.b_value; break;
+	case TK_TYPE:           yylval->TK_TYPE = token.type; break;
+	case TK_STRING_LITERAL: yylval->TK_STRING_LITERAL = token.text; break;
+	case TK_IDENTIFIER:     yylval->TK_IDENTIFIER = token.text; break;
+	}
+	return kind;
+}
+#else
 #include "scanner.h"
+#endif
 
-void mCc_parser_error(struct MCC_PARSER_LTYPE *yylloc, yyscan_t *scanner,
+void mCc_parser_error(struct mCc_parser_location *yylloc, void *scanner,
                       void *result, const char *msg)
 {
-	UNUSED(scanner);
 	struct mCc_parser_result *r = result;
 
 	r->status = MCC_PARSER_STATUS_PARSE_ERROR;
 	r->err_msg = strdup(msg);
+#ifdef MCC_LEXER_HAND
+	struct mCc_lexer *lexer = (struct mCc_lexer *)scanner;
+	r->err_text = strdup(lexer->text);
+	struct mCc_source *source = lexer->source;
+#else
 	r->err_text = strdup(mCc_parser_get_text(scanner));
+	struct mCc_source *source = mCc_parser_get_extra(scanner);
+#endif
 
 	// Copy error location to result
-	r->err_loc.start_line = yylloc->first_line;
-	r->err_loc.end_line   = yylloc->last_line;
-	r->err_loc.start_col  = yylloc->first_column;
-	r->err_loc.end_col    = yylloc->last_column - 1;
+	r->err_loc = mCc_source_locate(source, yylloc->first_offset,
+	                               yylloc->last_offset);
 }
 
 struct mCc_parser_result mCc_parser_parse_string(const char *input)
 {
 	assert(input);
 
-	struct mCc_parser_result result = { 0 };
+	return mCc_parser_parse_buffer(input, strlen(input),
+	                               MCC_PARSER_KIND_DEFAULT);
+}
 
-	FILE *in = fmemopen((void *)input, strlen(input), "r");
-	if (!in) {
-		result.status = MCC_PARSER_STATUS_UNABLE_TO_OPEN_STREAM;
+/* Parse a source with the parser generated by bison */
+static void mCc_parser_parse_bison(struct mCc_source *source,
+                                   struct mCc_parser_result *result)
+{
+#ifdef MCC_LEXER_HAND
+	struct mCc_lexer lexer, *scanner = &lexer;
+	mCc_lexer_init(&lexer, source);
+#else
+	yyscan_t scanner;
+	if (mCc_parser_lex_init_extra(source, &scanner)) {
+		result->status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+		return;
+	}
+	// Scanned in place, the text is followed by the two NULs flex expects
+	if (!mCc_parser__scan_buffer(source->data, source->size + 2, scanner)) {
+		mCc_parser_lex_destroy(scanner);
+		result->status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+		return;
+	}
+#endif
+
+	if (yyparse(scanner, result) != 0 && result->status == MCC_PARSER_STATUS_OK) {
+		result->status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+	}
+
+#ifdef MCC_LEXER_HAND
+	mCc_lexer_close(&lexer);
+#else
+	mCc_parser_lex_destroy(scanner);
+#endif
+}
+
+/* Parse a source into a tree in an arena, which is deleted unless it holds
+ * the tree */
+static struct mCc_parser_result mCc_parser_parse_in(struct mCc_source *source,
+                                                    struct mCc_arena *arena,
+                                                    enum mCc_parser_kind kind)
+{
+	if (kind == MCC_PARSER_KIND_DEFAULT) {
+#ifdef MCC_PARSER_DESCENT
+		kind = MCC_PARSER_KIND_DESCENT;
+#else
+		kind = MCC_PARSER_KIND_BISON;
+#endif
+	}
+
+	struct mCc_parser_result result = {
+		.status = MCC_PARSER_STATUS_OK,
+	};
+
+	// The names and strings are interned in the arena of the tree
+	struct mCc_interner *interner = mCc_interner_new(arena);
+	if (!interner) {
+		mCc_arena_delete(arena);
+		result.status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
 		return result;
 	}
+	struct mCc_arena *previous = mCc_ast_use_arena(arena);
+	struct mCc_interner *previous_interner = mCc_ast_use_interner(interner);
 
-	result = mCc_parser_parse_file(in);
+	// Statements nested too deeply for the descent parser are left to bison
+	if (kind != MCC_PARSER_KIND_DESCENT ||
+	    mCc_parser_descent_parse(source, &result) != 0) {
+		mCc_parser_parse_bison(source, &result);
+	}
 
-	fclose(in);
+	mCc_ast_use_interner(previous_interner);
+	mCc_ast_use_arena(previous);
+
+	if (result.status == MCC_PARSER_STATUS_OK && result.expression) {
+		mCc_ast_set_arena_root(&result.expression->node);
+	} else if (result.status == MCC_PARSER_STATUS_OK && result.statement) {
+		mCc_ast_set_arena_root(&result.statement->node);
+	} else if (result.status == MCC_PARSER_STATUS_OK && result.program) {
+		mCc_ast_set_arena_root(&result.program->node);
+		result.program->source = source;
+	} else {
+		// Bison may have reduced the toplevel before running into the error
+		mCc_arena_delete(arena);
+		result.expression = NULL;
+		result.statement = NULL;
+		result.program = NULL;
+	}
 
 	return result;
 }
 
+struct mCc_parser_result mCc_parser_parse_buffer(const char *input, size_t len,
+                                                 enum mCc_parser_kind kind)
+{
+	assert(input);
+
+	struct mCc_parser_result result = { 0 };
+
+	// The tree keeps a copy of the text to resolve its locations
+	struct mCc_arena *arena = mCc_arena_new();
+	struct mCc_source *source =
+	    arena ? mCc_arena_alloc(arena, sizeof(*source)) : NULL;
+	if (!source || mCc_source_init(source, input, len, arena)) {
+		mCc_arena_delete(arena);
+		result.status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+		return result;
+	}
+	return mCc_parser_parse_in(source, arena, kind);
+}
+
 struct mCc_parser_result mCc_parser_parse_file(FILE *input)
 {
 	assert(input);
 
-	yyscan_t scanner;
-	mCc_parser_lex_init(&scanner);
-	mCc_parser_set_in(input, scanner);
+	struct mCc_parser_result result = { 0 };
+
+	// Read once, like a buffer
+	struct mCc_arena *arena = mCc_arena_new();
+	struct mCc_source *source =
+	    arena ? mCc_arena_alloc(arena, sizeof(*source)) : NULL;
+	if (!source || mCc_source_read(source, input, arena)) {
+		mCc_arena_delete(arena);
+		result.status = MCC_PARSER_STATUS_UNABLE_TO_OPEN_STREAM;
+		return result;
+	}
+	return mCc_parser_parse_in(source, arena, MCC_PARSER_KIND_DEFAULT);
+}
+
+struct mCc_parser_result mCc_parser_parse_source(struct mCc_source *source,
+                                                 enum mCc_parser_kind kind)
+{
+	assert(source);
+
+	struct mCc_parser_result result = { 0 };
+
+	struct mCc_arena *arena = mCc_arena_new();
+	if (!arena) {
+		result.status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+		return result;
+	}
+	return mCc_parser_parse_in(source, arena, kind);
+}
+
+struct mCc_parser_result
+mCc_parser_parse_source_stream(struct mCc_source *source,
+                               const struct mCc_parser_stream *stream)
+{
+	assert(source);
+	assert(stream);
 
 	struct mCc_parser_result result = {
 		.status = MCC_PARSER_STATUS_OK,
 	};
 
-	if (yyparse(scanner, &result) != 0 && result.status == MCC_PARSER_STATUS_OK) {
+	// The signatures with the names they intern
+	struct mCc_arena *arena = mCc_arena_new();
+	struct mCc_interner *interner = arena ? mCc_interner_new(arena) : NULL;
+	if (!interner) {
+		mCc_arena_delete(arena);
 		result.status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+		return result;
+	}
+	struct mCc_arena *previous = mCc_ast_use_arena(arena);
+	struct mCc_interner *previous_interner = mCc_ast_use_interner(interner);
+	int ret = mCc_parser_descent_scan_signatures(source, &result);
+	mCc_ast_use_interner(previous_interner);
+	mCc_ast_use_arena(previous);
+
+	// Whatever it is, the whole parse finds out
+	if (ret != 0) {
+		mCc_arena_delete(arena);
+		free((void *)result.err_msg);
+		free((void *)result.err_text);
+		result = mCc_parser_parse_source(source, MCC_PARSER_KIND_DEFAULT);
+		if (result.status == MCC_PARSER_STATUS_OK && result.program) {
+			mCc_ast_delete_program(result.program);
+			result.program = NULL;
+			result.status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+		}
+		return result;
 	}
 
-	mCc_parser_lex_destroy(scanner);
+	struct mCc_ast_program *program = result.program;
+	mCc_ast_set_arena_root(&program->node);
+	program->source = source;
+	if (stream->signatures(program, stream->userdata) == 0)
+		mCc_parser_descent_parse_stream(source, &result, stream);
 
+	if (result.status != MCC_PARSER_STATUS_OK) {
+		mCc_ast_delete_program(program);
+		result.program = NULL;
+	}
 	return result;
 }
@@ -0,0 +1,981 @@
+/**
+ * @file parser_descent.c
+ * @brief Hand-written parser, recursive descent with precedence climbing.
+ * @author richard
+ * @date 2018-07-14
+ */
+#include "mCc/parser_descent.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mCc/arena.h"
+#include "mCc/intern.h"
+#include "mCc/lexer.h"
+#include "mCc/source.h"
+#include "parser.tab.h"
+
+/* Every node gets the locations the actions in parser.y give it */
+#define loc(ast_node, start, end) \
+    (ast_node)->node.sloc.start_offset = (start); \
+    (ast_node)->node.sloc.end_offset = (end);
+
+#define start_of(ast_node) ((ast_node)->node.sloc.start_offset)
+#define end_of(ast_node) ((ast_node)->node.sloc.end_offset)
+
+/// An operator, or an opening bracket, waiting for its operands
+struct mCc_parser_descent_frame {
+    enum {
+        MCC_PARSER_DESCENT_FRAME_BINARY,
+        MCC_PARSER_DESCENT_FRAME_UNARY,
+        MCC_PARSER_DESCENT_FRAME_PARENTH, ///< `(` of a parenthesised expression
+        MCC_PARSER_DESCENT_FRAME_CALL,    ///< `(` of the arguments of a call
+        MCC_PARSER_DESCENT_FRAME_SUBSCR,  ///< `[` of an array subscript
+    } kind;
+    int op;                  ///< The binary or unary operator
+    unsigned int precedence; ///< Of the binary operator
+    uint32_t start_offset;   ///< Of the unary operator or bracket
+    struct mCc_ast_identifier *identifier; ///< Of the call or array
+    struct mCc_ast_arguments *arguments;   ///< Of the call so far
+};
+
+struct mCc_parser_descent {
+    struct mCc_lexer lexer;
+    struct mCc_lexer_token token; ///< The lookahead
+    struct mCc_parser_result *result;
+    unsigned int depth; ///< Nesting of the current statement
+    bool too_deep;
+    bool skip_bodies; ///< Only read the signatures of functions
+
+    /* The stacks of the expression being parsed */
+    struct mCc_ast_expression **operands;
+    unsigned int operand_count;
+    unsigned int operand_alloc;
+    struct mCc_parser_descent_frame *frames;
+    unsigned int frame_count;
+    unsigned int frame_alloc;
+};
+
+/*********************************** Tokens and errors */
+
+/* The name of a token in messages, like bison would print it */
+static const char *mCc_parser_descent_token_name(int kind) {
+    switch (kind) {
+    case TK_END: return "EOF";
+    case TK_INT_LITERAL: return "integer literal";
+    case TK_FLOAT_LITERAL: return "float literal";
+    case TK_STRING_LITERAL: return "string literal";
+    case TK_BOOL_LITERAL: return "bool literal";
+    case TK_IDENTIFIER: return "identifier";
+    case TK_LPARENTH: return "(";
+    case TK_RPARENTH: return ")";
+    case TK_LBRACE: return "{";
+    case TK_RBRACE: return "}";
+    case TK_LBRACK: return "[";
+    case TK_RBRACK: return "]";
+    case TK_NOT: return "!";
+    case TK_PLUS: return "PLUS";
+    case TK_MINUS: return "MINUS";
+    case TK_ASTER: return "ASTER";
+    case TK_SLASH: return "SLASH";
+    case TK_LESS: return "LESS";
+    case TK_GREATER: return "GREATER";
+    case TK_LESS_EQ: return "<=";
+    case TK_GREATER_EQ: return ">=";
+    case TK_AND: return "&&";
+    case TK_OR: return "||";
+    case TK_EQUALS: return "==";
+    case TK_NOT_EQUALS: return "!=";
+    case TK_ASSGN: return "=";
+    case TK_IF: return "if";
+    case TK_ELSE: return "else";
+    case TK_WHILE: return "while";
+    case TK_RETURN: return "return";
+    case TK_VOID: return "void";
+    case TK_SEMICOLON: return ";";
+    case TK_COMMA: return "\",\"";
+    case TK_TYPE: return "type";
+    }
+    return "invalid token";
+}
+
+static bool mCc_parser_descent_failed(struct mCc_parser_descent *parser) {
+    return parser->too_deep ||
+           parser->result->status != MCC_PARSER_STATUS_OK;
+}
+
+/* A syntax error at the lookahead, expecting a token of the kind if it is
+ * not negative */
+static void mCc_parser_descent_error(struct mCc_parser_descent *parser,
+                                     int expected) {
+    if (mCc_parser_descent_failed(parser))
+        return;
+
+    struct mCc_parser_result *result = parser->result;
+    struct mCc_lexer_token *token = &parser->token;
+    char msg[128];
+    if (expected >= 0)
+        snprintf(msg, sizeof(msg), "syntax error, unexpected %s, expecting %s",
+                 mCc_parser_descent_token_name(token->kind),
+                 mCc_parser_descent_token_name(expected));
+    else
+        snprintf(msg, sizeof(msg), "syntax error, unexpected %s",
+                 mCc_parser_descent_token_name(token->kind));
+
+    result->status = MCC_PARSER_STATUS_PARSE_ERROR;
+    result->err_msg = strdup(msg);
+    result->err_text = strdup(token->text);
+    result->err_loc = mCc_source_locate(parser->lexer.source,
+                                        token->start_offset, token->end_offset);
+}
+
+static void mCc_parser_descent_next(struct mCc_parser_descent *parser) {
+    mCc_lexer_next(&parser->lexer, &parser->token);
+}
+
+/* Skip a token of the kind, storing where it ends */
+static bool mCc_parser_descent_expect(struct mCc_parser_descent *parser,
+                                      int kind, uint32_t *end_offset) {
+    if (parser->token.kind != kind) {
+        mCc_parser_descent_error(parser, kind);
+        return false;
+    }
+    if (end_offset)
+        *end_offset = parser->token.end_offset;
+    mCc_parser_descent_next(parser);
+    return true;
+}
+
+/*********************************** Leaves */
+
+static struct mCc_ast_literal *
+mCc_parser_descent_literal(struct mCc_parser_descent *parser) {
+    struct mCc_lexer_token *token = &parser->token;
+    struct mCc_ast_literal *literal;
+    switch (token->kind) {
+    case TK_INT_LITERAL:
+        literal = mCc_ast_new_literal_int(token->i_value);
+        break;
+    case TK_FLOAT_LITERAL:
+        literal = mCc_ast_new_literal_float(token->f_value);
+        break;
+    case TK_STRING_LITERAL:
+        literal = mCc_ast_new_literal_string(token->text);
+        break;
+    case TK_BOOL_LITERAL:
+        literal = mCc_ast_new_literal_bool(token->b_value);
+        break;
+    default:
+        mCc_parser_descent_error(parser, -1);
+        return NULL;
+    }
+    loc(literal, token->start_offset, token->end_offset);
+    mCc_parser_descent_next(parser);
+    return literal;
+}
+
+/* The identifier is built before the next token is scanned, which moves the
+ * NUL ending its text */
+static struct mCc_ast_identifier *
+mCc_parser_descent_identifier(struct mCc_parser_descent *parser) {
+    struct mCc_lexer_token *token = &parser->token;
+    if (token->kind != TK_IDENTIFIER) {
+        mCc_parser_descent_error(parser, TK_IDENTIFIER);
+        return NULL;
+    }
+    struct mCc_ast_identifier *identifier = mCc_ast_new_identifier(token->text);
+    loc(identifier, token->start_offset, token->end_offset);
+    mCc_parser_descent_next(parser);
+    return identifier;
+}
+
+/*********************************** Expressions */
+
+static bool mCc_parser_descent_push_operand(struct mCc_parser_descent *parser,
+                                            struct mCc_ast_expression *expr) {
+    if (parser->operand_count == parser->operand_alloc) {
+        unsigned int alloc = parser->operand_alloc ? 2 * parser->operand_alloc
+                                                   : 32;
+        void *operands =
+            realloc(parser->operands, alloc * sizeof(*parser->operands));
+        if (!operands) {
+            parser->result->status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+            return false;
+        }
+        parser->operands = operands;
+        parser->operand_alloc = alloc;
+    }
+    parser->operands[parser->operand_count++] = expr;
+    return true;
+}
+
+static struct mCc_parser_descent_frame *
+mCc_parser_descent_push_frame(struct mCc_parser_descent *parser, int kind,
+                              uint32_t start_offset) {
+    if (parser->frame_count == parser->frame_alloc) {
+        unsigned int alloc = parser->frame_alloc ? 2 * parser->frame_alloc
+                                                 : 32;
+        void *frames = realloc(parser->frames, alloc * sizeof(*parser->frames));
+        if (!frames) {
+            parser->result->status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+            return NULL;
+        }
+        parser->frames = frames;
+        parser->frame_alloc = alloc;
+    }
+    struct mCc_parser_descent_frame *frame =
+        &parser->frames[parser->frame_count++];
+    frame->kind = kind;
+    frame->start_offset = start_offset;
+    frame->identifier = NULL;
+    frame->arguments = NULL;
+    return frame;
+}
+
+static struct mCc_parser_descent_frame *
+mCc_parser_descent_top(struct mCc_parser_descent *parser) {
+    return parser->frame_count ? &parser->frames[parser->frame_count - 1]
+                               : NULL;
+}
+
+/* The binary operator of a token and its precedence, 0 if it is none */
+static unsigned int mCc_parser_descent_binary_op(int kind,
+                                                 enum mCc_ast_binary_op *op) {
+    switch (kind) {
+    case TK_OR: *op = MCC_AST_BINARY_OP_OR; return 1;
+    case TK_AND: *op = MCC_AST_BINARY_OP_AND; return 2;
+    case TK_LESS: *op = MCC_AST_BINARY_OP_LT; return 3;
+    case TK_GREATER: *op = MCC_AST_BINARY_OP_GT; return 3;
+    case TK_LESS_EQ: *op = MCC_AST_BINARY_OP_LEQ; return 3;
+    case TK_GREATER_EQ: *op = MCC_AST_BINARY_OP_GEQ; return 3;
+    case TK_EQUALS: *op = MCC_AST_BINARY_OP_EQ; return 3;
+    case TK_NOT_EQUALS: *op = MCC_AST_BINARY_OP_NEQ; return 3;
+    case TK_PLUS: *op = MCC_AST_BINARY_OP_ADD; return 4;
+    case TK_MINUS: *op = MCC_AST_BINARY_OP_SUB; return 4;
+    case TK_ASTER: *op = MCC_AST_BINARY_OP_MUL; return 5;
+    case TK_SLASH: *op = MCC_AST_BINARY_OP_DIV; return 5;
+    }
+    return 0;
+}
+
+/* Apply the binary operators on top binding at least as tightly as the
+ * precedence, all of them are left-associative */
+static void mCc_parser_descent_reduce(struct mCc_parser_descent *parser,
+                                      unsigned int precedence) {
+    struct mCc_parser_descent_frame *frame;
+    while ((frame = mCc_parser_descent_top(parser)) &&
+           frame->kind == MCC_PARSER_DESCENT_FRAME_BINARY &&
+           frame->precedence >= precedence) {
+        struct mCc_ast_expression **operands = parser->operands;
+        struct mCc_ast_expression *rhs = operands[--parser->operand_count];
+        struct mCc_ast_expression *lhs = operands[parser->operand_count - 1];
+        struct mCc_ast_expression *expr =
+            mCc_ast_new_expression_binary_op(frame->op, lhs, rhs);
+        loc(expr, start_of(lhs), end_of(rhs));
+        operands[parser->operand_count - 1] = expr;
+        parser->frame_count--;
+    }
+}
+
+/* Push a complete single_expr, applying the unary operators before it */
+static bool mCc_parser_descent_single(struct mCc_parser_descent *parser,
+                                      struct mCc_ast_expression *expr) {
+    struct mCc_parser_descent_frame *frame;
+    while ((frame = mCc_parser_descent_top(parser)) &&
+           frame->kind == MCC_PARSER_DESCENT_FRAME_UNARY) {
+        struct mCc_ast_expression *unary =
+            mCc_ast_new_expression_unary_op(frame->op, expr);
+        loc(unary, frame->start_offset, end_of(expr));
+        expr = unary;
+        parser->frame_count--;
+    }
+    return mCc_parser_descent_push_operand(parser, expr);
+}
+
+/*
+ * Where an operand is expected: push it if it is complete and return 1, push
+ * the frame of a unary operator or opening bracket and return 0, or return -1
+ * on error. An identifier that was already scanned is passed in.
+ */
+static int mCc_parser_descent_operand(struct mCc_parser_descent *parser,
+                                      struct mCc_ast_identifier *identifier) {
+    struct mCc_lexer_token *token = &parser->token;
+    struct mCc_parser_descent_frame *frame;
+
+    if (!identifier) {
+        switch (token->kind) {
+        case TK_INT_LITERAL:
+        case TK_FLOAT_LITERAL:
+        case TK_STRING_LITERAL:
+        case TK_BOOL_LITERAL: {
+            struct mCc_ast_literal *literal =
+                mCc_parser_descent_literal(parser);
+            struct mCc_ast_expression *expr =
+                mCc_ast_new_expression_literal(literal);
+            loc(expr, start_of(literal), end_of(literal));
+            return mCc_parser_descent_single(parser, expr) ? 1 : -1;
+        }
+        case TK_NOT:
+        case TK_MINUS:
+            if (!(frame = mCc_parser_descent_push_frame(
+                      parser, MCC_PARSER_DESCENT_FRAME_UNARY,
+                      token->start_offset)))
+                return -1;
+            frame->op = token->kind == TK_NOT ? MCC_AST_UNARY_OP_NOT
+                                              : MCC_AST_UNARY_OP_NEG;
+            mCc_parser_descent_next(parser);
+            return 0;
+        case TK_LPARENTH:
+            if (!mCc_parser_descent_push_frame(
+                    parser, MCC_PARSER_DESCENT_FRAME_PARENTH,
+                    token->start_offset))
+                return -1;
+            mCc_parser_descent_next(parser);
+            return 0;
+        case TK_IDENTIFIER:
+            identifier = mCc_parser_descent_identifier(parser);
+            break;
+        default:
+            mCc_parser_descent_error(parser, -1);
+            return -1;
+        }
+    }
+
+    switch (token->kind) {
+    case TK_LBRACK:
+        if (!(frame = mCc_parser_descent_push_frame(
+                  parser, MCC_PARSER_DESCENT_FRAME_SUBSCR,
+                  start_of(identifier))))
+            return -1;
+        frame->identifier = identifier;
+        mCc_parser_descent_next(parser);
+        return 0;
+    case TK_LPARENTH:
+        mCc_parser_descent_next(parser);
+        if (token->kind == TK_RPARENTH) {
+            struct mCc_ast_expression *call =
+                mCc_ast_new_expression_call_expr(identifier, NULL);
+            loc(call, start_of(identifier), token->end_offset);
+            mCc_parser_descent_next(parser);
+            return mCc_parser_descent_single(parser, call) ? 1 : -1;
+        }
+        if (!(frame = mCc_parser_descent_push_frame(
+                  parser, MCC_PARSER_DESCENT_FRAME_CALL,
+                  start_of(identifier))))
+            return -1;
+        frame->identifier = identifier;
+        return 0;
+    default: {
+        struct mCc_ast_expression *expr =
+            mCc_ast_new_expression_identifier(identifier);
+        loc(expr, start_of(identifier), end_of(identifier));
+        return mCc_parser_descent_single(parser, expr) ? 1 : -1;
+    }
+    }
+}
+
+/* Add the operand on top to the arguments of the call */
+static void
+mCc_parser_descent_argument(struct mCc_parser_descent *parser,
+                            struct mCc_parser_descent_frame *frame) {
+    struct mCc_ast_expression *expr = parser->operands[--parser->operand_count];
+    if (!frame->arguments) {
+        frame->arguments = mCc_ast_new_arguments(expr);
+        loc(frame->arguments, start_of(expr), end_of(expr));
+    } else {
+        frame->arguments = mCc_ast_arguments_add(frame->arguments, expr);
+        loc(frame->arguments, start_of(frame->arguments), end_of(expr));
+    }
+}
+
+/*
+ * Parse an expression up to the first token that cannot continue it. The
+ * parse may start after an identifier or a first operand that were already
+ * scanned.
+ */
+static struct mCc_ast_expression *
+mCc_parser_descent_expression(struct mCc_parser_descent *parser,
+                              struct mCc_ast_identifier *identifier,
+                              struct mCc_ast_expression *operand) {
+    struct mCc_lexer_token *token = &parser->token;
+    parser->operand_count = 0;
+    parser->frame_count = 0;
+
+    bool expect_operand = true;
+    if (operand) {
+        if (!mCc_parser_descent_push_operand(parser, operand))
+            return NULL;
+        expect_operand = false;
+    }
+
+    for (;;) {
+        if (expect_operand) {
+            int complete = mCc_parser_descent_operand(parser, identifier);
+            if (complete < 0)
+                return NULL;
+            identifier = NULL;
+            expect_operand = !complete;
+            continue;
+        }
+
+        enum mCc_ast_binary_op op;
+        unsigned int precedence =
+            mCc_parser_descent_binary_op(token->kind, &op);
+        if (precedence) {
+            mCc_parser_descent_reduce(parser, precedence);
+            struct mCc_parser_descent_frame *frame =
+                mCc_parser_descent_push_frame(parser,
+                                              MCC_PARSER_DESCENT_FRAME_BINARY,
+                                              token->start_offset);
+            if (!frame)
+                return NULL;
+            frame->op = op;
+            frame->precedence = precedence;
+            mCc_parser_descent_next(parser);
+            expect_operand = true;
+            continue;
+        }
+
+        // Anything else closes a bracket or ends the expression
+        mCc_parser_descent_reduce(parser, 0);
+        struct mCc_parser_descent_frame *frame = mCc_parser_descent_top(parser);
+        if (!frame)
+            break;
+
+        struct mCc_ast_expression *expr = NULL;
+        switch (token->kind) {
+        case TK_RPARENTH:
+            if (frame->kind == MCC_PARSER_DESCENT_FRAME_PARENTH) {
+                expr = mCc_ast_new_expression_parenth(
+                    parser->operands[--parser->operand_count]);
+                loc(expr, frame->start_offset, token->end_offset);
+            } else if (frame->kind == MCC_PARSER_DESCENT_FRAME_CALL) {
+                mCc_parser_descent_argument(parser, frame);
+                expr = mCc_ast_new_expression_call_expr(frame->identifier,
+                                                        frame->arguments);
+                loc(expr, frame->start_offset, token->end_offset);
+            }
+            break;
+        case TK_RBRACK:
+            if (frame->kind == MCC_PARSER_DESCENT_FRAME_SUBSCR) {
+                expr = mCc_ast_new_expression_arr_subscr(
+                    frame->identifier,
+                    parser->operands[--parser->operand_count]);
+                loc(expr, frame->start_offset, token->end_offset);
+            }
+            break;
+        case TK_COMMA:
+            if (frame->kind == MCC_PARSER_DESCENT_FRAME_CALL) {
+                mCc_parser_descent_argument(parser, frame);
+                mCc_parser_descent_next(parser);
+                expect_operand = true;
+                continue;
+            }
+            break;
+        }
+        if (!expr) {
+            bool subscr = frame->kind == MCC_PARSER_DESCENT_FRAME_SUBSCR;
+            mCc_parser_descent_error(parser, subscr ? TK_RBRACK : TK_RPARENTH);
+            return NULL;
+        }
+        parser->frame_count--;
+        mCc_parser_descent_next(parser);
+        if (!mCc_parser_descent_single(parser, expr))
+            return NULL;
+    }
+
+    return parser->operands[--parser->operand_count];
+}
+
+/*********************************** Statements */
+
+/* A declaration after its type */
+static struct mCc_ast_declaration *
+mCc_parser_descent_declaration(struct mCc_parser_descent *parser,
+                               enum mCc_ast_type type, uint32_t start_offset) {
+    struct mCc_ast_literal *size = NULL;
+    if (parser->token.kind == TK_LBRACK) {
+        mCc_parser_descent_next(parser);
+        if (!(size = mCc_parser_descent_literal(parser)) ||
+            !mCc_parser_descent_expect(parser, TK_RBRACK, NULL))
+            return NULL;
+    }
+    struct mCc_ast_identifier *identifier =
+        mCc_parser_descent_identifier(parser);
+    if (!identifier)
+        return NULL;
+
+    struct mCc_ast_declaration *decl =
+        mCc_ast_new_declaration(type, size, identifier);
+    loc(decl, start_offset, end_of(identifier));
+    return decl;
+}
+
+static struct mCc_ast_statement *
+mCc_parser_descent_declaration_statement(struct mCc_parser_descent *parser,
+                                         struct mCc_ast_declaration *decl,
+                                         uint32_t *end_offset) {
+    if (!decl || !mCc_parser_descent_expect(parser, TK_SEMICOLON, end_offset))
+        return NULL;
+    struct mCc_ast_statement *stmt = mCc_ast_new_statement_declaration(decl);
+    loc(stmt, start_of(decl), *end_offset);
+    return stmt;
+}
+
+/* An expression followed by a semicolon, or by the end if it may be the
+ * whole input, which is returned in bare instead */
+static struct mCc_ast_statement *
+mCc_parser_descent_expression_statement(struct mCc_parser_descent *parser,
+                                        struct mCc_ast_expression *expr,
+                                        uint32_t *end_offset,
+                                        struct mCc_ast_expression **bare) {
+    if (!expr)
+        return NULL;
+    if (bare && parser->token.kind == TK_END) {
+        *bare = expr;
+        return NULL;
+    }
+    if (!mCc_parser_descent_expect(parser, TK_SEMICOLON, end_offset))
+        return NULL;
+    struct mCc_ast_statement *stmt = mCc_ast_new_statement_expression(expr);
+    loc(stmt, start_of(expr), *end_offset);
+    return stmt;
+}
+
+static struct mCc_ast_statement *
+mCc_parser_descent_statement(struct mCc_parser_descent *parser,
+                             uint32_t *end_offset,
+                             struct mCc_ast_expression **bare);
+
+/* The statements of a block up to the closing brace, spanning them */
+static struct mCc_ast_statement *
+mCc_parser_descent_compound(struct mCc_parser_descent *parser) {
+    struct mCc_ast_statement *compound = NULL;
+    do {
+        uint32_t end_offset;
+        struct mCc_ast_statement *stmt =
+            mCc_parser_descent_statement(parser, &end_offset, NULL);
+        if (!stmt)
+            return NULL;
+        if (!compound) {
+            compound = mCc_ast_new_statement_compound(stmt);
+            loc(compound, start_of(stmt), end_offset);
+        } else {
+            compound = mCc_ast_compound_statement_add(compound, stmt);
+            loc(compound, start_of(compound), end_offset);
+        }
+    } while (parser->token.kind != TK_RBRACE);
+    return compound;
+}
+
+/* The parts of if and while statements in parentheses */
+static struct mCc_ast_expression *
+mCc_parser_descent_condition(struct mCc_parser_descent *parser) {
+    mCc_parser_descent_next(parser);
+    if (!mCc_parser_descent_expect(parser, TK_LPARENTH, NULL))
+        return NULL;
+    struct mCc_ast_expression *cond =
+        mCc_parser_descent_expression(parser, NULL, NULL);
+    if (!cond || !mCc_parser_descent_expect(parser, TK_RPARENTH, NULL))
+        return NULL;
+    return cond;
+}
+
+/*
+ * A statement, storing where its last token ends, which is also where the
+ * statement ends except for a return statement with a value.
+ */
+static struct mCc_ast_statement *
+mCc_parser_descent_statement_in(struct mCc_parser_descent *parser,
+                                uint32_t *end_offset,
+                                struct mCc_ast_expression **bare) {
+    struct mCc_lexer_token *token = &parser->token;
+    uint32_t start_offset = token->start_offset;
+    struct mCc_ast_statement *stmt = NULL;
+
+    switch (token->kind) {
+    case TK_IF: {
+        struct mCc_ast_expression *cond = mCc_parser_descent_condition(parser);
+        struct mCc_ast_statement *then_stmt, *else_stmt = NULL;
+        if (!cond || !(then_stmt = mCc_parser_descent_statement(
+                           parser, end_offset, NULL)))
+            return NULL;
+        // The else belongs to the innermost if
+        if (token->kind == TK_ELSE) {
+            mCc_parser_descent_next(parser);
+            if (!(else_stmt =
+                      mCc_parser_descent_statement(parser, end_offset, NULL)))
+                return NULL;
+        }
+        stmt = mCc_ast_new_statement_if(cond, then_stmt, else_stmt);
+        break;
+    }
+    case TK_WHILE: {
+        struct mCc_ast_expression *cond = mCc_parser_descent_condition(parser);
+        struct mCc_ast_statement *body;
+        if (!cond ||
+            !(body = mCc_parser_descent_statement(parser, end_offset, NULL)))
+            return NULL;
+        stmt = mCc_ast_new_statement_while(cond, body);
+        break;
+    }
+    case TK_LBRACE:
+        mCc_parser_descent_next(parser);
+        if (token->kind == TK_RBRACE)
+            stmt = mCc_ast_new_statement_compound(NULL);
+        else if (!(stmt = mCc_parser_descent_compound(parser)))
+            return NULL;
+        if (!mCc_parser_descent_expect(parser, TK_RBRACE, end_offset))
+            return NULL;
+        break;
+    case TK_RETURN: {
+        uint32_t return_end = token->end_offset;
+        mCc_parser_descent_next(parser);
+        if (token->kind == TK_SEMICOLON) {
+            stmt = mCc_ast_new_statement_return(NULL);
+            *end_offset = token->end_offset;
+            mCc_parser_descent_next(parser);
+            break;
+        }
+        struct mCc_ast_expression *value =
+            mCc_parser_descent_expression(parser, NULL, NULL);
+        if (!value ||
+            !mCc_parser_descent_expect(parser, TK_SEMICOLON, end_offset))
+            return NULL;
+        // Located at the keyword only
+        stmt = mCc_ast_new_statement_return(value);
+        loc(stmt, start_offset, return_end);
+        return stmt;
+    }
+    case TK_TYPE: {
+        enum mCc_ast_type type = token->type;
+        mCc_parser_descent_next(parser);
+        return mCc_parser_descent_declaration_statement(
+            parser, mCc_parser_descent_declaration(parser, type, start_offset),
+            end_offset);
+    }
+    case TK_IDENTIFIER: {
+        // An assignment, or the start of an expression
+        struct mCc_ast_identifier *identifier =
+            mCc_parser_descent_identifier(parser);
+        struct mCc_ast_expression *index = NULL, *value;
+        if (token->kind == TK_LBRACK) {
+            mCc_parser_descent_next(parser);
+            uint32_t index_end;
+            if (!(index = mCc_parser_descent_expression(parser, NULL, NULL)) ||
+                !mCc_parser_descent_expect(parser, TK_RBRACK, &index_end))
+                return NULL;
+            if (token->kind != TK_ASSGN) {
+                struct mCc_ast_expression *expr =
+                    mCc_ast_new_expression_arr_subscr(identifier, index);
+                loc(expr, start_offset, index_end);
+                return mCc_parser_descent_expression_statement(
+                    parser, mCc_parser_descent_expression(parser, NULL, expr),
+                    end_offset, bare);
+            }
+        } else if (token->kind != TK_ASSGN) {
+            return mCc_parser_descent_expression_statement(
+                parser, mCc_parser_descent_expression(parser, identifier, NULL),
+                end_offset, bare);
+        }
+        mCc_parser_descent_next(parser);
+        if (!(value = mCc_parser_descent_expression(parser, NULL, NULL)) ||
+            !mCc_parser_descent_expect(parser, TK_SEMICOLON, end_offset))
+            return NULL;
+        stmt = mCc_ast_new_statement_assgn(identifier, index, value);
+        break;
+    }
+    case TK_INT_LITERAL:
+    case TK_FLOAT_LITERAL:
+    case TK_STRING_LITERAL:
+    case TK_BOOL_LITERAL:
+    case TK_NOT:
+    case TK_MINUS:
+    case TK_LPARENTH:
+        return mCc_parser_descent_expression_statement(
+            parser, mCc_parser_descent_expression(parser, NULL, NULL),
+            end_offset, bare);
+    default:
+        mCc_parser_descent_error(parser, -1);
+        return NULL;
+    }
+
+    loc(stmt, start_offset, *end_offset);
+    return stmt;
+}
+
+static struct mCc_ast_statement *
+mCc_parser_descent_statement(struct mCc_parser_descent *parser,
+                             uint32_t *end_offset,
+                             struct mCc_ast_expression **bare) {
+    if (parser->depth == MCC_PARSER_DESCENT_MAX_DEPTH) {
+        parser->too_deep = true;
+        return NULL;
+    }
+    parser->depth++;
+    struct mCc_ast_statement *stmt =
+        mCc_parser_descent_statement_in(parser, end_offset, bare);
+    parser->depth--;
+    return stmt;
+}
+
+/*********************************** Functions */
+
+/* Skip the body of a function after its `{` up to the matching `}`, storing
+ * where that ends */
+static bool mCc_parser_descent_skip_body(struct mCc_parser_descent *parser,
+                                         uint32_t *end_offset) {
+    struct mCc_lexer_token *token = &parser->token;
+    for (unsigned int depth = 1; depth;) {
+        if (token->kind == TK_END) {
+            mCc_parser_descent_error(parser, TK_RBRACE);
+            return false;
+        }
+        if (token->kind == TK_LBRACE)
+            ++depth;
+        else if (token->kind == TK_RBRACE)
+            --depth;
+        *end_offset = token->end_offset;
+        mCc_parser_descent_next(parser);
+    }
+    return true;
+}
+
+/* A function definition after its return type and name */
+static struct mCc_ast_function_def *
+mCc_parser_descent_function_def(struct mCc_parser_descent *parser, bool is_void,
+                                enum mCc_ast_type type, uint32_t start_offset,
+                                struct mCc_ast_identifier *identifier) {
+    struct mCc_lexer_token *token = &parser->token;
+    if (!identifier || !mCc_parser_descent_expect(parser, TK_LPARENTH, NULL))
+        return NULL;
+
+    struct mCc_ast_parameters *params = NULL;
+    while (token->kind != TK_RPARENTH || params) {
+        if (params && !mCc_parser_descent_expect(parser, TK_COMMA, NULL))
+            return NULL;
+        if (token->kind != TK_TYPE) {
+            mCc_parser_descent_error(parser, TK_TYPE);
+            return NULL;
+        }
+        enum mCc_ast_type param_type = token->type;
+        uint32_t param_start = token->start_offset;
+        mCc_parser_descent_next(parser);
+        struct mCc_ast_declaration *decl =
+            mCc_parser_descent_declaration(parser, param_type, param_start);
+        if (!decl)
+            return NULL;
+        if (!params) {
+            params = mCc_ast_new_parameters(decl);
+            loc(params, start_of(decl), end_of(decl));
+        } else {
+            params = mCc_ast_parameters_add(params, decl);
+            loc(params, start_of(params), end_of(decl));
+        }
+        if (token->kind == TK_RPARENTH)
+            break;
+    }
+    mCc_parser_descent_next(parser);
+
+    struct mCc_ast_statement *body = NULL;
+    uint32_t end_offset;
+    if (!mCc_parser_descent_expect(parser, TK_LBRACE, NULL))
+        return NULL;
+    if (parser->skip_bodies) {
+        if (!mCc_parser_descent_skip_body(parser, &end_offset))
+            return NULL;
+    } else if ((token->kind != TK_RBRACE &&
+                !(body = mCc_parser_descent_compound(parser))) ||
+               !mCc_parser_descent_expect(parser, TK_RBRACE, &end_offset)) {
+        return NULL;
+    }
+
+    struct mCc_ast_function_def *func =
+        is_void ? mCc_ast_new_function_def_void(identifier, params, body)
+                : mCc_ast_new_function_def_type(type, identifier, params, body);
+    loc(func, start_offset, end_offset);
+    return func;
+}
+
+/* A function definition from its return type on */
+static struct mCc_ast_function_def *
+mCc_parser_descent_function(struct mCc_parser_descent *parser) {
+    struct mCc_lexer_token *token = &parser->token;
+    bool is_void = token->kind == TK_VOID;
+    if (!is_void && token->kind != TK_TYPE) {
+        mCc_parser_descent_error(parser, -1);
+        return NULL;
+    }
+    enum mCc_ast_type type = token->type;
+    uint32_t start_offset = token->start_offset;
+    mCc_parser_descent_next(parser);
+    return mCc_parser_descent_function_def(
+        parser, is_void, type, start_offset,
+        mCc_parser_descent_identifier(parser));
+}
+
+/* The function definitions after the first one up to the end */
+static struct mCc_ast_program *
+mCc_parser_descent_program(struct mCc_parser_descent *parser,
+                           struct mCc_ast_function_def *func) {
+    struct mCc_lexer_token *token = &parser->token;
+    if (!func)
+        return NULL;
+    struct mCc_ast_program *program = mCc_ast_new_program(func);
+    loc(program, start_of(func), end_of(func));
+
+    while (token->kind != TK_END) {
+        func = mCc_parser_descent_function(parser);
+        if (!func)
+            return NULL;
+        program = mCc_ast_program_add(program, func);
+        loc(program, start_of(program), end_of(func));
+    }
+    return program;
+}
+
+/* An expression, a statement or a program, like the toplevel rule */
+static void mCc_parser_descent_toplevel(struct mCc_parser_descent *parser) {
+    struct mCc_lexer_token *token = &parser->token;
+    struct mCc_parser_result *result = parser->result;
+    struct mCc_ast_statement *stmt;
+    uint32_t end_offset;
+
+    switch (token->kind) {
+    case TK_END:
+        result->program = mCc_ast_new_program(NULL);
+        return;
+    case TK_VOID: {
+        uint32_t start_offset = token->start_offset;
+        mCc_parser_descent_next(parser);
+        result->program = mCc_parser_descent_program(
+            parser, mCc_parser_descent_function_def(
+                        parser, true, MCC_AST_TYPE_INT, start_offset,
+                        mCc_parser_descent_identifier(parser)));
+        return;
+    }
+    case TK_TYPE: {
+        // A function definition, or a declaration if no parenthesis follows
+        enum mCc_ast_type type = token->type;
+        uint32_t start_offset = token->start_offset;
+        mCc_parser_descent_next(parser);
+        struct mCc_ast_declaration *decl;
+        if (token->kind == TK_IDENTIFIER) {
+            struct mCc_ast_identifier *identifier =
+                mCc_parser_descent_identifier(parser);
+            if (token->kind == TK_LPARENTH) {
+                result->program = mCc_parser_descent_program(
+                    parser, mCc_parser_descent_function_def(
+                                parser, false, type, start_offset, identifier));
+                return;
+            }
+            decl = mCc_ast_new_declaration(type, NULL, identifier);
+            loc(decl, start_offset, end_of(identifier));
+        } else {
+            decl = mCc_parser_descent_declaration(parser, type, start_offset);
+        }
+        stmt = mCc_parser_descent_declaration_statement(parser, decl,
+                                                        &end_offset);
+        break;
+    }
+    default: {
+        struct mCc_ast_expression *bare = NULL;
+        stmt = mCc_parser_descent_statement(parser, &end_offset, &bare);
+        if (bare) {
+            result->expression = bare;
+            return;
+        }
+        break;
+    }
+    }
+
+    if (stmt && mCc_parser_descent_expect(parser, TK_END, NULL))
+        result->statement = stmt;
+}
+
+int mCc_parser_descent_parse(struct mCc_source *source,
+                             struct mCc_parser_result *result) {
+    struct mCc_parser_descent parser = {
+        .result = result,
+    };
+    mCc_lexer_init(&parser.lexer, source);
+    mCc_parser_descent_next(&parser);
+
+    mCc_parser_descent_toplevel(&parser);
+
+    mCc_lexer_close(&parser.lexer);
+    free(parser.operands);
+    free(parser.frames);
+
+    return parser.too_deep ? -1 : 0;
+}
+
+int mCc_parser_descent_scan_signatures(struct mCc_source *source,
+                                       struct mCc_parser_result *result) {
+    struct mCc_parser_descent parser = {
+        .result = result,
+        .skip_bodies = true,
+    };
+    mCc_lexer_init(&parser.lexer, source);
+    mCc_parser_descent_next(&parser);
+
+    // Only the toplevel of a program, without the bodies
+    struct mCc_ast_program *program = NULL;
+    if (parser.token.kind == TK_END) {
+        program = mCc_ast_new_program(NULL);
+    } else {
+        struct mCc_ast_function_def *func =
+            mCc_parser_descent_function(&parser);
+        program = mCc_parser_descent_program(&parser, func);
+    }
+    if (!program && result->status == MCC_PARSER_STATUS_OK)
+        result->status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+    result->program = program;
+
+    mCc_lexer_close(&parser.lexer);
+    return result->status == MCC_PARSER_STATUS_OK ? 0 : -1;
+}
+
+int mCc_parser_descent_parse_stream(struct mCc_source *source,
+                                    struct mCc_parser_result *result,
+                                    const struct mCc_parser_stream *stream) {
+    struct mCc_parser_descent parser = {
+        .result = result,
+    };
+    mCc_lexer_init(&parser.lexer, source);
+    mCc_parser_descent_next(&parser);
+
+    while (parser.token.kind != TK_END) {
+        // Every function with its names and strings in an arena of its own
+        struct mCc_arena *arena = mCc_arena_new();
+        struct mCc_interner *interner = arena ? mCc_interner_new(arena) : NULL;
+        if (!interner) {
+            mCc_arena_delete(arena);
+            result->status = MCC_PARSER_STATUS_UNKNOWN_ERROR;
+            break;
+        }
+        struct mCc_arena *previous = mCc_ast_use_arena(arena);
+        struct mCc_interner *previous_interner = mCc_ast_use_interner(interner);
+        struct mCc_ast_function_def *func =
+            mCc_parser_descent_function(&parser);
+        mCc_ast_use_interner(previous_interner);
+        mCc_ast_use_arena(previous);
+
+        if (!func || mCc_parser_descent_failed(&parser)) {
+            mCc_arena_delete(arena);
+            break;
+        }
+        mCc_ast_set_arena_root(&func->node);
+        if (stream->function(func, stream->userdata))
+            break;
+    }
+    if (parser.too_deep && result->status == MCC_PARSER_STATUS_OK)
+        result->status = MCC_PARSER_STATUS_TOO_DEEP;
+
+    mCc_lexer_close(&parser.lexer);
+    free(parser.operands);
+    free(parser.frames);
+
+    return parser.too_deep ? -1 : 0;
+}
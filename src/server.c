@@ -0,0 +1,360 @@
+/**
+ * @file server.c
+ * @brief Compile server on a Unix domain socket, and its client.
+ * @author richard
+ * @date 2018-06-28
+ */
+#include "mCc/server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "mCc/context.h"
+#include "mCc/func_cache.h"
+#include "mCc/writer.h"
+
+/* Send all bytes, a closed peer is an error instead of SIGPIPE */
+static int mCc_server_send(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size) {
+        ssize_t ret = send(fd, p, size, MSG_NOSIGNAL);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return 1;
+        p += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+/* Receive exactly size bytes, the end of the stream is an error */
+static int mCc_server_recv(int fd, void *data, size_t size) {
+    char *p = data;
+    while (size) {
+        ssize_t ret = recv(fd, p, size, 0);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return 1;
+        p += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+/* Send a message collected in a memory writer, which is emptied */
+static int mCc_server_send_writer(int fd, struct mCc_writer *w) {
+    size_t size;
+    char *message = mCc_writer_take_memory(w, &size);
+    if (!message)
+        return 1;
+    int ret = mCc_server_send(fd, message, size);
+    free(message);
+    return ret;
+}
+
+static int mCc_server_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return 1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/*********************************** Server */
+
+static int mCc_server_respond(int fd, const struct mCc_output *output) {
+    struct mCc_writer w;
+    mCc_writer_init_memory(&w);
+
+    struct mCc_server_response response = {
+        .status = output->status,
+        .data_size = output->data ? output->size : 0,
+        .diagnostic_count = output->diagnostic_count,
+    };
+    mCc_writer_write(&w, &response, sizeof(response));
+    mCc_writer_write(&w, output->data, response.data_size);
+    for (unsigned int i = 0; i < output->diagnostic_count; ++i) {
+        const struct mCc_compile_diagnostic *diag = &output->diagnostics[i];
+        struct mCc_server_diagnostic header = {
+            .status = diag->status,
+            .start_line = diag->loc.start_line,
+            .start_col = diag->loc.start_col,
+            .end_line = diag->loc.end_line,
+            .end_col = diag->loc.end_col,
+            .message_size = strlen(diag->message),
+            .text_size = diag->text ? strlen(diag->text) : MCC_SERVER_NO_TEXT,
+        };
+        mCc_writer_write(&w, &header, sizeof(header));
+        mCc_writer_write(&w, diag->message, header.message_size);
+        if (diag->text)
+            mCc_writer_write(&w, diag->text, header.text_size);
+    }
+    return mCc_server_send_writer(fd, &w);
+}
+
+/* Answer the requests on a connection until it is closed or broken */
+static void mCc_server_serve(struct mCc_context *ctx,
+                             struct mCc_func_cache *cache, int fd) {
+    struct mCc_server_request request;
+    char *buf = NULL; // The name and source, reused by every request
+    size_t capacity = 0;
+
+    while (!mCc_server_recv(fd, &request, sizeof(request))) {
+        if (request.name_size > MCC_SERVER_MAX_SIZE ||
+            request.source_size > MCC_SERVER_MAX_SIZE ||
+            request.output_kind > MCC_COMPILE_OUTPUT_OBJECT ||
+            request.parser > MCC_PARSER_KIND_DESCENT)
+            break;
+
+        size_t size = (size_t)request.name_size + 1 + request.source_size;
+        if (size > capacity) {
+            char *tmp = realloc(buf, size);
+            if (!tmp)
+                break;
+            buf = tmp;
+            capacity = size;
+        }
+        char *src = buf + request.name_size + 1;
+        if (mCc_server_recv(fd, buf, request.name_size) ||
+            mCc_server_recv(fd, src, request.source_size))
+            break;
+        buf[request.name_size] = '\0';
+
+        struct mCc_compile_options options = mCc_compile_default_options(
+                request.opt_level > 3 ? 3 : request.opt_level);
+        options.source_name = buf;
+        options.output_kind = request.output_kind;
+        options.parser = request.parser;
+        options.func_cache = cache;
+
+        struct mCc_output output;
+        mCc_compile_string_in_context(ctx, src, request.source_size, &options,
+                                      &output);
+        int ret = mCc_server_respond(fd, &output);
+        mCc_output_free(&output);
+        if (ret)
+            break;
+    }
+    free(buf);
+    close(fd);
+}
+
+/// What the workers of a server share
+struct mCc_server_workers {
+    int listen_fd;
+    struct mCc_func_cache cache; ///< Functions of all requests
+};
+
+static void *mCc_server_worker(void *arg) {
+    struct mCc_server_workers *shared = arg;
+    struct mCc_context *ctx = mCc_context_new();
+    if (!ctx)
+        return NULL;
+
+    while (1) {
+        int fd = accept(shared->listen_fd, NULL, NULL);
+        if (fd >= 0)
+            mCc_server_serve(ctx, &shared->cache, fd);
+        else if (errno != EINTR && errno != ECONNABORTED)
+            break;
+    }
+    mCc_context_delete(ctx);
+    return arg;
+}
+
+/* Remove a socket at path that no server listens on any more. Anything else
+ * at path is left alone: fails with EEXIST for other files and EADDRINUSE
+ * for a live server. */
+static int mCc_server_remove_stale(const char *path,
+                                   const struct sockaddr_un *addr) {
+    struct stat st;
+    if (lstat(path, &st))
+        return errno == ENOENT ? 0 : -1;
+    if (!S_ISSOCK(st.st_mode)) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    int live = connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+    int err = errno;
+    close(fd);
+    if (live) {
+        errno = EADDRINUSE;
+        return -1;
+    }
+    if (err != ECONNREFUSED) {
+        errno = err;
+        return -1;
+    }
+    return unlink(path);
+}
+
+int mCc_server_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (mCc_server_address(path, &addr) || mCc_server_remove_stale(path, &addr))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(fd, SOMAXCONN)) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+int mCc_server_run(int fd, unsigned int threads) {
+    struct mCc_server_workers shared = {.listen_fd = fd};
+    if (mCc_func_cache_init(&shared.cache, NULL, NULL))
+        return -1;
+
+    pthread_t *workers = calloc(threads, sizeof(*workers));
+    unsigned int started = 0;
+    while (workers && started + 1 < threads &&
+           !pthread_create(&workers[started], NULL, mCc_server_worker,
+                           &shared))
+        ++started;
+
+    // A worker returns NULL if it could not serve at all
+    int served = mCc_server_worker(&shared) != NULL;
+    for (unsigned int i = 0; i < started; ++i) {
+        void *ret;
+        pthread_join(workers[i], &ret);
+        served |= ret != NULL;
+    }
+    free(workers);
+    mCc_func_cache_free(&shared.cache);
+    return served ? 0 : -1;
+}
+
+/*********************************** Client */
+
+int mCc_client_connect(const char *path) {
+    struct sockaddr_un addr;
+    if (mCc_server_address(path, &addr))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+/* Receive a string of the given size, NUL-terminated */
+static char *mCc_client_recv_string(int fd, uint32_t size) {
+    if (size > MCC_SERVER_MAX_SIZE)
+        return NULL;
+    char *str = malloc((size_t)size + 1);
+    if (!str)
+        return NULL;
+    if (mCc_server_recv(fd, str, size)) {
+        free(str);
+        return NULL;
+    }
+    str[size] = '\0';
+    return str;
+}
+
+static int mCc_client_recv_output(int fd, struct mCc_output *output) {
+    struct mCc_server_response response;
+    if (mCc_server_recv(fd, &response, sizeof(response)) ||
+        response.status > MCC_COMPILE_STATUS_SERVER_ERROR)
+        return 1;
+    output->status = response.status;
+
+    if (response.status == MCC_COMPILE_STATUS_OK &&
+        !(output->data = mCc_client_recv_string(fd, response.data_size)))
+        return 1;
+    output->size = response.data_size;
+
+    if (response.diagnostic_count > MCC_SERVER_MAX_SIZE ||
+        (response.diagnostic_count &&
+         !(output->diagnostics = calloc(response.diagnostic_count,
+                                        sizeof(*output->diagnostics)))))
+        return 1;
+    for (uint32_t i = 0; i < response.diagnostic_count; ++i) {
+        struct mCc_compile_diagnostic *diag = &output->diagnostics[i];
+        struct mCc_server_diagnostic header;
+        if (mCc_server_recv(fd, &header, sizeof(header)))
+            return 1;
+        output->diagnostic_count++;
+        diag->status = header.status;
+        diag->loc.start_line = header.start_line;
+        diag->loc.start_col = header.start_col;
+        diag->loc.end_line = header.end_line;
+        diag->loc.end_col = header.end_col;
+        if (!(diag->message = mCc_client_recv_string(fd, header.message_size)))
+            return 1;
+        if (header.text_size != MCC_SERVER_NO_TEXT &&
+            !(diag->text = mCc_client_recv_string(fd, header.text_size)))
+            return 1;
+    }
+    return 0;
+}
+
+enum mCc_compile_status
+mCc_client_compile(int fd, const char *src, size_t len,
+                   const struct mCc_compile_options *options,
+                   struct mCc_output *output) {
+    struct mCc_compile_options default_options = mCc_compile_default_options(0);
+    if (!options)
+        options = &default_options;
+    memset(output, 0, sizeof(*output));
+
+    const char *name = options->source_name ? options->source_name : "";
+    struct mCc_server_request request = {
+        .opt_level = options->opt_level,
+        .output_kind = options->output_kind,
+        .parser = options->parser,
+        .name_size = strlen(name),
+        .source_size = len,
+    };
+    const char *message = "Request too large for the compile server";
+    if (len <= MCC_SERVER_MAX_SIZE && request.name_size <= MCC_SERVER_MAX_SIZE) {
+        struct mCc_writer w;
+        mCc_writer_init_memory(&w);
+        mCc_writer_write(&w, &request, sizeof(request));
+        mCc_writer_write(&w, name, request.name_size);
+        mCc_writer_write(&w, src, len);
+        message = "Lost the connection to the compile server";
+        if (!mCc_server_send_writer(fd, &w) &&
+            !mCc_client_recv_output(fd, output))
+            return output->status;
+    }
+
+    // Replace a partial response by the error
+    mCc_output_free(output);
+    struct mCc_compile_diagnostic *diag = calloc(1, sizeof(*diag));
+    if (diag && (diag->message = strdup(message))) {
+        diag->status = MCC_COMPILE_STATUS_SERVER_ERROR;
+        output->diagnostics = diag;
+        output->diagnostic_count = 1;
+    } else {
+        free(diag);
+    }
+    return output->status = MCC_COMPILE_STATUS_SERVER_ERROR;
+}
@@ -0,0 +1,229 @@
+/**
+ * @file source.c
+ * @brief The text of a program and the lines and columns in it.
+ * @author richard
+ * @date 2018-07-10
+ */
+#include "mCc/source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mCc/arena.h"
+
+/// NUL bytes after the text, the end of a buffer for flex
+#define MCC_SOURCE_PADDING (2)
+
+static void *mCc_source_alloc(struct mCc_arena *arena, size_t size) {
+    return arena ? mCc_arena_alloc(arena, size) : malloc(size);
+}
+
+/* Take over a malloc'd text, moving it into the arena if there is one */
+static int mCc_source_adopt(struct mCc_source *source, char *data,
+                            size_t size, struct mCc_arena *arena) {
+    if (size > UINT32_MAX) {
+        free(data);
+        errno = EFBIG;
+        return -1;
+    }
+    if (arena) {
+        char *copy = mCc_arena_alloc(arena, size + MCC_SOURCE_PADDING);
+        if (copy)
+            memcpy(copy, data, size);
+        free(data);
+        if (!copy) {
+            errno = ENOMEM;
+            return -1;
+        }
+        data = copy;
+    }
+    memset(data + size, 0, MCC_SOURCE_PADDING);
+    *source = (struct mCc_source){
+            .data = data,
+            .size = size,
+            .mapped_size = 0,
+            .arena = arena,
+            .line_starts = NULL,
+            .line_count = 0,
+    };
+    return 0;
+}
+
+int mCc_source_read(struct mCc_source *source, FILE *in,
+                    struct mCc_arena *arena) {
+    char *data = NULL;
+    size_t capacity = 0, size = 0, n;
+    do {
+        if (capacity - size < MCC_SOURCE_PADDING + 1) {
+            capacity = capacity ? 2 * capacity : 4096;
+            char *tmp = realloc(data, capacity);
+            if (!tmp) {
+                free(data);
+                errno = ENOMEM;
+                return -1;
+            }
+            data = tmp;
+        }
+        size += n = fread(data + size, 1, capacity - size - MCC_SOURCE_PADDING,
+                          in);
+    } while (n);
+
+    if (ferror(in)) {
+        free(data);
+        errno = EIO;
+        return -1;
+    }
+    return mCc_source_adopt(source, data, size, arena);
+}
+
+int mCc_source_init(struct mCc_source *source, const char *data, size_t size,
+                    struct mCc_arena *arena) {
+    if (size > UINT32_MAX) {
+        errno = EFBIG;
+        return -1;
+    }
+    char *copy = mCc_source_alloc(arena, size + MCC_SOURCE_PADDING);
+    if (!copy) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(copy, data, size);
+    memset(copy + size, 0, MCC_SOURCE_PADDING);
+    *source = (struct mCc_source){
+            .data = copy,
+            .size = size,
+            .mapped_size = 0,
+            .arena = arena,
+            .line_starts = NULL,
+            .line_count = 0,
+    };
+    return 0;
+}
+
+int mCc_source_open(struct mCc_source *source, const char *path) {
+    if (strcmp("-", path) == 0)
+        return mCc_source_read(source, stdin, NULL);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    // The bytes after the end of the file up to the end of its last page are
+    // zero, which gives the NULs, unless the file fills its last page
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = st.st_size;
+    if (S_ISREG(st.st_mode) && size > 0 && size <= UINT32_MAX &&
+        size % page != 0 && size % page <= page - MCC_SOURCE_PADDING) {
+        void *data = mmap(NULL, size + MCC_SOURCE_PADDING,
+                          PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+            *source = (struct mCc_source){
+                    .data = data,
+                    .size = size,
+                    .mapped_size = size + MCC_SOURCE_PADDING,
+                    .arena = NULL,
+                    .line_starts = NULL,
+                    .line_count = 0,
+            };
+            return 0;
+        }
+    }
+
+    FILE *in = fdopen(fd, "rb");
+    if (!in) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    int ret = mCc_source_read(source, in, NULL);
+    int err = errno;
+    fclose(in);
+    errno = err;
+    return ret;
+}
+
+void mCc_source_close(struct mCc_source *source) {
+    if (!source || source->arena)
+        return;
+    if (source->mapped_size)
+        munmap(source->data, source->mapped_size);
+    else
+        free(source->data);
+    free(source->line_starts);
+    source->data = NULL;
+    source->line_starts = NULL;
+    source->line_count = 0;
+}
+
+/* Build the table of line starts, 0 on success */
+static int mCc_source_lines(struct mCc_source *source) {
+    uint32_t count = 1;
+    const char *end = source->data + source->size;
+    for (const char *nl = memchr(source->data, '\n', source->size); nl;
+         nl = memchr(nl + 1, '\n', end - (nl + 1)))
+        ++count;
+
+    uint32_t *starts =
+            mCc_source_alloc(source->arena, count * sizeof(*starts));
+    if (!starts)
+        return 1;
+    starts[0] = 0;
+    uint32_t line = 1;
+    for (const char *nl = memchr(source->data, '\n', source->size); nl;
+         nl = memchr(nl + 1, '\n', end - (nl + 1)))
+        starts[line++] = nl + 1 - source->data;
+
+    source->line_starts = starts;
+    source->line_count = count;
+    return 0;
+}
+
+/* The line and column of an offset, both from 1 */
+static void mCc_source_position(const struct mCc_source *source,
+                                uint32_t offset, int *line, int *col) {
+    // The last line starting at or before the offset
+    uint32_t low = 0, high = source->line_count;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (source->line_starts[mid] <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+    *line = low + 1;
+    *col = offset - source->line_starts[low] + 1;
+}
+
+struct mCc_ast_source_location mCc_source_locate(struct mCc_source *source,
+                                                 uint32_t start, uint32_t end) {
+    struct mCc_ast_source_location loc = {
+            .start_offset = start,
+            .end_offset = end,
+    };
+    if (!source->line_starts && mCc_source_lines(source))
+        return loc;
+    mCc_source_position(source, start, &loc.start_line, &loc.start_col);
+    mCc_source_position(source, end, &loc.end_line, &loc.end_col);
+    --loc.end_col;
+    return loc;
+}
+
+void mCc_source_resolve(struct mCc_source *source,
+                        struct mCc_ast_source_location *loc) {
+    if (source && loc->end_offset > loc->start_offset)
+        *loc = mCc_source_locate(source, loc->start_offset, loc->end_offset);
+}
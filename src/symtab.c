@@ -5,234 +5,426 @@
  * @date 2018-04-07
  */
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "mCc/arena.h"
 #include "mCc/ast.h"
 #include "mCc/ast_statements.h"
+#include "mCc/context.h"
+#include "mCc/intern.h"
+#include "mCc/source.h"
 #include "mCc/symtab.h"
+#include "mCc/writer.h"
 
-static void mCc_symtab_delete_scope(struct mCc_symtab_scope *scope);
+/// Block size by which to increase the scope array when reallocating
+static const unsigned int scope_block_size = 15;
 
-static void mCc_symtab_delete_entry(struct mCc_symtab_entry *entry);
+/// Initial size of the undo log and the bindings
+static const unsigned int log_block_size = 64;
 
-/*********************************** Global array of scopes for print and gc */
-
-/// Block size by which to increase array when reallocating
-static const unsigned int global_scope_gc_block_size = 15;
-/// Number of entries for which memory was allocated
-static unsigned int global_scope_gc_alloc_size = 0;
-/// Number of entries currently in array
-static unsigned int global_scope_gc_count = 0;
-
-/// All scopes ever created, to use when printing or freeing
-static struct mCc_symtab_scope **global_scope_gc_arr = NULL;
+/*********************************** File-static helpers */
 
-/*********************************** Global array of built-ins and helper for
- * deleting */
+/* The atom of the name of an identifier, MCC_ATOM_NONE if it was never
+ * interned in the interner of the scopes */
+static mCc_atom mCc_symtab_find_atom(const struct mCc_symtab_state *state,
+                                     const struct mCc_ast_identifier *id) {
+    // An atom of another interner has a different text
+    if (id->atom != MCC_ATOM_NONE &&
+        mCc_interner_str(state->interner, id->atom) == id->id_value)
+        return id->atom;
+    return mCc_interner_find(state->interner, id->id_value,
+                             strlen(id->id_value));
+}
 
-/// Number of entries currently in array
-static unsigned int built_in_count = 0;
+/* Like mCc_symtab_find_atom, but interns new names, MCC_ATOM_NONE on memory
+ * error */
+static mCc_atom mCc_symtab_intern(struct mCc_symtab_state *state,
+                                  const struct mCc_ast_identifier *id) {
+    if (id->atom != MCC_ATOM_NONE &&
+        mCc_interner_str(state->interner, id->atom) == id->id_value)
+        return id->atom;
+    return mCc_interner_intern(state->interner, id->id_value,
+                               strlen(id->id_value));
+}
 
-/// All built_in functions ever created, to use when freeing
-static struct mCc_ast_function_def *built_in_arr[6];
+/* The innermost entry bound to an atom, or NULL */
+static inline struct mCc_symtab_entry *
+mCc_symtab_binding(const struct mCc_symtab_state *state, mCc_atom atom) {
+    return atom < state->binding_count ? state->bindings[atom] : NULL;
+}
 
-/*********************************** File-static helpers */
+/* Create the arena and interner of the scopes if needed, 0 on success */
+static int mCc_symtab_prepare(struct mCc_symtab_state *state) {
+    if (!state->interner && !state->own_interner &&
+        !(state->own_interner = mCc_interner_new(NULL)))
+        return 1;
+    if (!state->interner)
+        state->interner = state->own_interner;
+    if (!state->arena && !(state->arena = mCc_arena_new()))
+        return 1;
+    return 0;
+}
 
 static int mCc_symtab_add_scope_to_gc(struct mCc_symtab_scope *scope) {
     assert(scope);
+    struct mCc_symtab_state *state = &scope->ctx->symtab;
 
-    if (global_scope_gc_count < global_scope_gc_alloc_size) {
-        global_scope_gc_arr[global_scope_gc_count++] = scope;
+    if (state->scope_count < state->scope_alloc_size) {
+        state->scopes[state->scope_count++] = scope;
         return 0;
     }
 
     struct mCc_symtab_scope **tmp;
-    global_scope_gc_alloc_size += global_scope_gc_block_size;
-    if ((tmp = realloc(global_scope_gc_arr,
-                       global_scope_gc_alloc_size * sizeof(*tmp))) == NULL) {
+    state->scope_alloc_size += scope_block_size;
+    if ((tmp = realloc(state->scopes,
+                       state->scope_alloc_size * sizeof(*tmp))) == NULL) {
         return 1; // Caller must delete all scopes if wanted
     }
 
-    global_scope_gc_arr = tmp;
-    global_scope_gc_arr[global_scope_gc_count++] = scope;
+    state->scopes = tmp;
+    state->scopes[state->scope_count++] = scope;
     return 0;
 }
 
+/// A built-in function as constant AST nodes, see #mCc_symtab_built_ins
+struct mCc_symtab_built_in {
+    struct mCc_ast_function_def def;
+    struct mCc_ast_identifier id;
+    struct mCc_ast_parameters params;
+    struct mCc_ast_declaration *param_list[1];
+    struct mCc_ast_declaration param;
+    struct mCc_ast_identifier param_id;
+};
+
+static const struct mCc_symtab_built_in
+        mCc_symtab_built_ins[MCC_SYMTAB_BUILT_IN_COUNT];
+
+#define MCC_SYMTAB_BUILT_IN_NODE(i, member, type) \
+    ((struct type *) &mCc_symtab_built_ins[i].member)
+
+/// The entry of a built-in without parameters
+#define MCC_SYMTAB_BUILT_IN(i, name, type)                                  \
+    [i] = {                                                                \
+        .def = {.func_type = (type),                                       \
+                .identifier = MCC_SYMTAB_BUILT_IN_NODE(i, id,              \
+                                                       mCc_ast_identifier), \
+                .para = NULL,                                              \
+                .body = NULL,                                              \
+                .built_in = true},                                         \
+        .id = {.id_value = (name), .atom = MCC_ATOM_NONE,                  \
+               .slot = MCC_AST_SLOT_NONE},                                 \
+    }
+
+/// The entry of a built-in with one parameter
+#define MCC_SYMTAB_BUILT_IN_PARAM(i, name, type, param_name, param_type)     \
+    [i] = {                                                                \
+        .def = {.func_type = (type),                                       \
+                .identifier = MCC_SYMTAB_BUILT_IN_NODE(i, id,              \
+                                                       mCc_ast_identifier), \
+                .para = MCC_SYMTAB_BUILT_IN_NODE(i, params,                \
+                                                 mCc_ast_parameters),      \
+                .body = NULL,                                              \
+                .built_in = true},                                         \
+        .id = {.id_value = (name), .atom = MCC_ATOM_NONE,                  \
+               .slot = MCC_AST_SLOT_NONE},                                 \
+        .params = {.decl_count = 1,                                        \
+                   .decl = (struct mCc_ast_declaration **)                 \
+                           mCc_symtab_built_ins[i].param_list},            \
+        .param_list = {MCC_SYMTAB_BUILT_IN_NODE(i, param,                  \
+                                                mCc_ast_declaration)},     \
+        .param = {.decl_type = (param_type),                               \
+                  .decl_array_size = NULL,                                 \
+                  .decl_id = MCC_SYMTAB_BUILT_IN_NODE(i, param_id,         \
+                                                      mCc_ast_identifier)}, \
+        .param_id = {.id_value = (param_name), .atom = MCC_ATOM_NONE,      \
+                     .slot = MCC_AST_SLOT_NONE},                           \
+    }
+
 /**
- * @brief Adds the build-in function headers into the first scope.
+ * @brief The built-in functions, implemented in mC_builtins.c.
  *
- * @param scope The scope where the functions are added to
- * @param func_name  The name of the built-in function
- * @param param_name The name of the parameter for the function
- * @param func_type  The return type of the function
- * @param param_type  The type of the parameter
+ * Every root scope refers to these nodes, which are shared by all contexts
+ * and never written, so entering the built-ins allocates nothing but their
+ * entries. A new built-in is one more line here and in
+ * #MCC_SYMTAB_BUILT_IN_COUNT.
  */
-static inline void mCc_symtab_add_built_in_function(
-        struct mCc_symtab_scope *scope, char *func_name, char *param_name,
-        enum mCc_ast_type func_type, enum mCc_ast_type param_type) {
-    assert(scope);
-
-    struct mCc_ast_identifier *func_id = mCc_ast_new_identifier(func_name);
-    struct mCc_ast_identifier *param_id = NULL;
-    struct mCc_ast_declaration *decl = NULL;
-    struct mCc_ast_parameters *para = NULL;
-    struct mCc_ast_function_def *built_in;
-
-    if (param_name) {
-        param_id = mCc_ast_new_identifier(param_name);
-        decl = mCc_ast_new_declaration(param_type, NULL, param_id);
-        para = mCc_ast_new_parameters(decl);
+static const struct mCc_symtab_built_in
+        mCc_symtab_built_ins[MCC_SYMTAB_BUILT_IN_COUNT] = {
+        MCC_SYMTAB_BUILT_IN_PARAM(0, "print", MCC_AST_TYPE_VOID, "msg",
+                                  MCC_AST_TYPE_STRING),
+        MCC_SYMTAB_BUILT_IN(1, "print_nl", MCC_AST_TYPE_VOID),
+        MCC_SYMTAB_BUILT_IN_PARAM(2, "print_int", MCC_AST_TYPE_VOID, "x",
+                                  MCC_AST_TYPE_INT),
+        MCC_SYMTAB_BUILT_IN_PARAM(3, "print_float", MCC_AST_TYPE_VOID, "x",
+                                  MCC_AST_TYPE_FLOAT),
+        MCC_SYMTAB_BUILT_IN(4, "read_int", MCC_AST_TYPE_INT),
+        MCC_SYMTAB_BUILT_IN(5, "read_float", MCC_AST_TYPE_FLOAT),
+};
+
+const struct mCc_ast_function_def *mCc_symtab_built_in(const char *name) {
+    for (unsigned int i = 0; i < MCC_SYMTAB_BUILT_IN_COUNT; ++i) {
+        if (!strcmp(mCc_symtab_built_ins[i].id.id_value, name))
+            return &mCc_symtab_built_ins[i].def;
     }
+    return NULL;
+}
 
-    if (func_type == MCC_AST_TYPE_VOID)
-        built_in = mCc_ast_new_function_def_void(func_id, para, NULL);
-    else
-        built_in =
-                mCc_ast_new_function_def_type(func_type, func_id, para, NULL);
-
-    built_in->node.sloc.start_line = 0;
-    built_in->node.sloc.end_line = 0;
-    built_in->node.sloc.start_col = 0;
-    built_in->node.sloc.end_col = 0;
-    mCc_symtab_scope_add_func_def(scope, built_in);
+/* Enter the built-in functions into a root scope, 0 on success */
+static int mCc_symtab_add_built_ins(struct mCc_symtab_scope *scope) {
+    for (unsigned int i = 0; i < MCC_SYMTAB_BUILT_IN_COUNT; ++i) {
+        if (mCc_symtab_scope_add_func_def(
+                    scope,
+                    MCC_SYMTAB_BUILT_IN_NODE(i, def, mCc_ast_function_def)))
+            return 1;
+    }
+    return 0;
+}
 
-    built_in_arr[built_in_count++] = built_in;
+/* Leave the open scopes inside a scope, which becomes the innermost one */
+static void mCc_symtab_leave_inner_scopes(struct mCc_symtab_scope *scope) {
+    struct mCc_symtab_state *state = &scope->ctx->symtab;
+    assert(scope->open);
+    while (state->current != scope)
+        mCc_symtab_scope_leave(state->current);
 }
 
 /**
  * @brief Symbol table (scope) constructor.
  *
+ * The new scope is opened inside its parent, which must be the innermost
+ * open scope.
+ *
+ * @param ctx The context owning the new scope
  * @param parent The parent scope, to be inserted.
- * @param name The name suffix of the new scope
+ * @param name The name suffix of the new scope, in the arena of the scopes
  *
  * @return The new scope
  */
 static struct mCc_symtab_scope *
-mCc_symtab_new_scope(struct mCc_symtab_scope *parent, char *name) {
+mCc_symtab_new_scope(struct mCc_context *ctx, struct mCc_symtab_scope *parent,
+                     char *name) {
     assert(name);
 
-    struct mCc_symtab_scope *new_scope = malloc(sizeof(*new_scope));
+    struct mCc_symtab_state *state = &ctx->symtab;
+    struct mCc_symtab_scope *new_scope =
+            mCc_arena_alloc(state->arena, sizeof(*new_scope));
     if (!new_scope)
         return NULL;
 
     new_scope->parent = parent;
-    new_scope->hash_table = NULL; // Important for uthash to function properly
+    new_scope->ctx = ctx;
     new_scope->name = name;
+    new_scope->depth = parent ? parent->depth + 1 : 0;
+    new_scope->log_start = state->log_count;
+    new_scope->open = true;
+    new_scope->first_entry = NULL;
+    new_scope->last_entry = NULL;
+    if (parent && !parent->parent)
+        state->slot_count = 0; // A function
+    if (mCc_symtab_add_scope_to_gc(new_scope))
+        return NULL;
+    state->current = new_scope;
+
+    if (!parent && mCc_symtab_add_built_ins(new_scope))
+        return NULL;
+    return new_scope;
+}
 
-    if (!parent) {
-        mCc_symtab_add_built_in_function(
-                new_scope, "print", "msg", MCC_AST_TYPE_VOID, MCC_AST_TYPE_STRING);
-        mCc_symtab_add_built_in_function(new_scope, "print_nl", NULL,
-                                         MCC_AST_TYPE_VOID, MCC_AST_TYPE_VOID);
-        mCc_symtab_add_built_in_function(new_scope, "print_int", "x",
-                                         MCC_AST_TYPE_VOID, MCC_AST_TYPE_INT);
-        mCc_symtab_add_built_in_function(new_scope, "print_float", "x",
-                                         MCC_AST_TYPE_VOID, MCC_AST_TYPE_FLOAT);
-        mCc_symtab_add_built_in_function(new_scope, "read_int", NULL,
-                                         MCC_AST_TYPE_INT, MCC_AST_TYPE_VOID);
-        mCc_symtab_add_built_in_function(new_scope, "read_float", NULL,
-                                         MCC_AST_TYPE_FLOAT, MCC_AST_TYPE_VOID);
+/* Make room for binding an atom and for one more entry in the undo log,
+ * 0 on success */
+static int mCc_symtab_reserve(struct mCc_symtab_state *state, mCc_atom atom) {
+    if (atom >= state->binding_count) {
+        unsigned int count = state->binding_count ? state->binding_count * 2
+                                                  : log_block_size;
+        while (count <= atom)
+            count *= 2;
+        struct mCc_symtab_entry **tmp =
+                realloc(state->bindings, count * sizeof(*tmp));
+        if (!tmp)
+            return 1;
+        memset(tmp + state->binding_count, 0,
+               (count - state->binding_count) * sizeof(*tmp));
+        state->bindings = tmp;
+        state->binding_count = count;
     }
 
-    if (mCc_symtab_add_scope_to_gc(new_scope)) {
-        mCc_symtab_delete_scope(new_scope);
-        return NULL;
+    if (state->log_count == state->log_alloc_size) {
+        unsigned int alloc_size = state->log_alloc_size
+                                          ? state->log_alloc_size * 2
+                                          : log_block_size;
+        struct mCc_symtab_entry **tmp =
+                realloc(state->log, alloc_size * sizeof(*tmp));
+        if (!tmp)
+            return 1;
+        state->log = tmp;
+        state->log_alloc_size = alloc_size;
     }
-    return new_scope;
+    return 0;
 }
 
 /**
- * @brief Symbol table entry constructor.
+ * @brief Declare a name in a scope.
+ *
+ * Creates the entry, binds it in place of the one it shadows and records it
+ * in the undo log.
  *
- * @param scope The containing scope
+ * @param self The scope to declare the name in
  * @param entry_type The type of the entry
  * @param sloc The source code location of the declaration
- * @param identifier The identifier (hash table key!)
- * @param decl_type The primitive type of the declaration
- * @param optarg Array size or #mCc_ast_parameters* if required by entry_type
+ * @param identifier The identifier (key of the binding!)
+ * @param primitive_type The primitive type of the declaration
+ * @param optarg Array size or #mCc_ast_function_def* if required by entry_type
+ * @param result Set to the new entry
  *
- * @return The new symtab entry, ready to be inserted
+ * @return 0 on success, 1 if the ID was already declared in this scope, -1 on
+ * memory error.
  */
-static struct mCc_symtab_entry *mCc_symtab_new_entry(
-        struct mCc_symtab_scope *scope, enum mCc_symtab_entry_type entry_type,
+static int mCc_symtab_scope_declare(
+        struct mCc_symtab_scope *self, enum mCc_symtab_entry_type entry_type,
         struct mCc_ast_source_location sloc, struct mCc_ast_identifier *identifier,
-        enum mCc_ast_type primitive_type, void *optarg) {
-    assert(scope);
+        enum mCc_ast_type primitive_type, void *optarg,
+        struct mCc_symtab_entry **result) {
+    assert(self);
     assert(identifier);
+    struct mCc_symtab_state *state = &self->ctx->symtab;
+    mCc_symtab_leave_inner_scopes(self);
 
-    struct mCc_symtab_entry *new_entry = malloc(sizeof(*new_entry));
+    mCc_atom atom = mCc_symtab_intern(state, identifier);
+    if (atom == MCC_ATOM_NONE || mCc_symtab_reserve(state, atom))
+        return -1;
+
+    // Check whether the ID was declared in the same scope
+    struct mCc_symtab_entry *shadowed = state->bindings[atom];
+    if (shadowed && shadowed->scope == self)
+        return 1;
+
+    struct mCc_symtab_entry *new_entry =
+            mCc_arena_alloc(state->arena, sizeof(*new_entry));
     if (!new_entry)
-        return NULL;
+        return -1;
 
-    new_entry->scope = scope;
+    new_entry->scope = self;
+    new_entry->shadowed = shadowed;
+    new_entry->next_in_scope = NULL;
     new_entry->entry_type = entry_type;
     new_entry->sloc = sloc;
     new_entry->identifier = identifier;
+    new_entry->atom = atom;
     new_entry->primitive_type = primitive_type;
+    new_entry->built_in = false;
+    new_entry->slot = entry_type == MCC_SYMTAB_ENTRY_TYPE_FUNC
+                              ? MCC_AST_SLOT_NONE
+                              : state->slot_count++;
 
     switch (entry_type) {
         case MCC_SYMTAB_ENTRY_TYPE_ARR:
-            new_entry->arr_size = (unsigned int) optarg;
+            new_entry->arr_size = (unsigned int) (uintptr_t) optarg;
             break;
         case MCC_SYMTAB_ENTRY_TYPE_FUNC:
-            new_entry->params = optarg;
+            new_entry->func_def = optarg;
+            new_entry->params = new_entry->func_def->para;
+            new_entry->built_in = new_entry->func_def->built_in;
             break;
         case MCC_SYMTAB_ENTRY_TYPE_VAR:
             break;
     }
 
-    return new_entry;
-}
+    if (self->last_entry)
+        self->last_entry->next_in_scope = new_entry;
+    else
+        self->first_entry = new_entry;
+    self->last_entry = new_entry;
 
-/**
- * @brief Add an entry to a symbol table.
- *
- * Wraps around #HASH_ADD_KEYPTR
- *
- * @param self The scope to whose hash table the entry will be added
- * @param entry The entry to add
- */
-static inline void mCc_symtab_scope_add_entry(struct mCc_symtab_scope *self,
-                                              struct mCc_symtab_entry *entry) {
-    HASH_ADD_KEYPTR(hh, self->hash_table, entry->identifier->id_value,
-                    strlen(entry->identifier->id_value), entry);
+    state->bindings[atom] = new_entry;
+    state->log[state->log_count++] = new_entry;
+    *result = new_entry;
+    return 0;
 }
 
 struct mCc_symtab_entry *
 mCc_symtab_scope_lookup_id(struct mCc_symtab_scope *scope,
                            struct mCc_ast_identifier *id) {
-    struct mCc_symtab_entry *entry = NULL;
-    HASH_FIND(hh, scope->hash_table, id->id_value, strlen(id->id_value), entry);
+    const struct mCc_symtab_state *state = &scope->ctx->symtab;
+    assert(scope->open);
 
-    // Recursively lookup until top scope
-    if (!entry && scope->parent)
-        return mCc_symtab_scope_lookup_id(scope->parent, id);
+    // A name that was never interned is not declared anywhere
+    mCc_atom atom = mCc_symtab_find_atom(state, id);
+    if (atom == MCC_ATOM_NONE)
+        return NULL;
+
+    // The open scopes form a chain, so the entries of scopes inside this one
+    // are exactly those that are deeper
+    struct mCc_symtab_entry *entry = mCc_symtab_binding(state, atom);
+    while (entry && entry->scope->depth > scope->depth)
+        entry = entry->shadowed;
     return entry;
 }
 
 /******************************* Public Functions */
 
+struct mCc_symtab_scope *mCc_symtab_new_root_scope(struct mCc_context *ctx,
+                                                   const char *name) {
+    assert(name);
+
+    struct mCc_symtab_state *state = &ctx->symtab;
+    struct mCc_symtab_scope *root = state->current;
+    if (root) {
+        while (root->parent)
+            root = root->parent;
+        mCc_symtab_scope_leave(root);
+    }
+
+    // The functions of the scopes before are kept until all are deleted
+    state->function_scope_start = 0;
+
+    char *copy;
+    if (mCc_symtab_prepare(state) ||
+        !(copy = mCc_arena_strdup(state->arena, name)))
+        return NULL;
+    return mCc_symtab_new_scope(ctx, NULL, copy);
+}
+
 struct mCc_symtab_scope *mCc_symtab_new_scope_in(struct mCc_symtab_scope *self,
                                                  const char *childscope_name) {
+    assert(self);
     assert(childscope_name);
+    mCc_symtab_leave_inner_scopes(self);
 
-    // create the scope name by concatenating it to the parent scope's name
-    char *name;
-    if (!self) {
-        name = malloc(strlen(childscope_name) + 1);
-        strcpy(name, childscope_name);
-    } else {
-        name = malloc(strlen(self->name) + strlen(childscope_name) +
-                      2); // _ + null byte
-        if (!name)
-            return NULL;
-        strcpy(name, self->name);
-        strcat(name, "_");
-        strcat(name, childscope_name);
+    // Everything of the functions is allocated after this
+    struct mCc_symtab_state *state = &self->ctx->symtab;
+    if (!self->parent && !state->function_scope_start) {
+        state->function_scope_start = state->scope_count;
+        state->function_mark = mCc_arena_mark(state->arena);
     }
+
+    // create the scope name by concatenating it to the parent scope's name
+    size_t length = strlen(self->name);
+    char *name = mCc_arena_alloc(state->arena,
+                                 length + strlen(childscope_name) +
+                                         2); // _ + null byte
+    if (!name)
+        return NULL;
+    memcpy(name, self->name, length);
+    name[length] = '_';
+    strcpy(name + length + 1, childscope_name);
     // create scope
-    return mCc_symtab_new_scope(self, name);
+    return mCc_symtab_new_scope(self->ctx, self, name);
+}
+
+struct mCc_symtab_scope *mCc_symtab_scope_leave(struct mCc_symtab_scope *self) {
+    struct mCc_symtab_state *state = &self->ctx->symtab;
+    mCc_symtab_leave_inner_scopes(self);
+
+    // Undo the bindings made since the scope was opened
+    while (state->log_count > self->log_start) {
+        struct mCc_symtab_entry *entry = state->log[--state->log_count];
+        state->bindings[entry->atom] = entry->shadowed;
+    }
+    self->open = false;
+    state->current = self->parent;
+    return self->parent;
 }
 
 int mCc_symtab_scope_add_decl(struct mCc_symtab_scope *self,
@@ -245,48 +437,24 @@ int mCc_symtab_scope_add_decl(struct mCc_symtab_scope *self,
         array_size = (void *) decl->decl_array_size->i_value;
     }
 
-    struct mCc_symtab_entry *entry =
-            mCc_symtab_new_entry(self, entry_type, decl->node.sloc, decl->decl_id,
-                                 decl->decl_type, array_size);
-    if (!entry)
-        return -1;
-
-    // Check whether the ID was declared in the same scope
-    struct mCc_symtab_entry *tmp = NULL;
-    HASH_FIND(hh, self->hash_table, decl->decl_id->id_value,
-              strlen(decl->decl_id->id_value), tmp);
-
-    if (tmp) {
-        mCc_symtab_delete_entry(entry);
-        return 1;
-    }
-    mCc_symtab_scope_add_entry(self, entry);
+    struct mCc_symtab_entry *entry;
+    int retval = mCc_symtab_scope_declare(self, entry_type, decl->node.sloc,
+                                          decl->decl_id, decl->decl_type,
+                                          array_size, &entry);
+    if (retval)
+        return retval;
     decl->decl_id->symtab_ref = entry;
+    decl->decl_id->slot = entry->slot;
 
     return 0;
 }
 
 int mCc_symtab_scope_add_func_def(struct mCc_symtab_scope *self,
                                   struct mCc_ast_function_def *func_def) {
-    enum mCc_symtab_entry_type entry_type = MCC_SYMTAB_ENTRY_TYPE_FUNC;
-    struct mCc_symtab_entry *entry = mCc_symtab_new_entry(
-            self, entry_type, func_def->node.sloc, func_def->identifier,
-            func_def->func_type, func_def->para);
-    if (!entry)
-        return -1;
-
-    // Check whether the ID was declared in the same scope
-    struct mCc_symtab_entry *tmp = NULL;
-    HASH_FIND(hh, self->hash_table, func_def->identifier->id_value,
-              strlen(func_def->identifier->id_value), tmp);
-    if (tmp) {
-        mCc_symtab_delete_entry(entry);
-        return 1;
-    }
-
-    mCc_symtab_scope_add_entry(self, entry);
-
-    return 0;
+    struct mCc_symtab_entry *entry;
+    return mCc_symtab_scope_declare(
+            self, MCC_SYMTAB_ENTRY_TYPE_FUNC, func_def->node.sloc,
+            func_def->identifier, func_def->func_type, func_def, &entry);
 }
 
 enum MCC_SYMTAB_SCOPE_LINK_ERROR
@@ -330,6 +498,10 @@ mCc_symtab_scope_link_ref_expression(struct mCc_symtab_scope *self,
     }
     // Link in identifier
     id->symtab_ref = entry;
+    id->slot = entry->slot;
+    if (expr->type == MCC_AST_EXPRESSION_TYPE_CALL_EXPR &&
+        entry->entry_type == MCC_SYMTAB_ENTRY_TYPE_FUNC)
+        expr->callee = entry->func_def;
     return MCC_SYMTAB_SCOPE_LINK_ERR_OK;
 }
 
@@ -371,58 +543,83 @@ mCc_symtab_scope_link_ref_assignment(struct mCc_symtab_scope *self,
     }
     // Link in identifier
     id->symtab_ref = entry;
+    id->slot = entry->slot;
     return MCC_SYMTAB_SCOPE_LINK_ERR_OK;
 }
 
 /******************************* Destructors */
-static void mCc_symtab_delete_scope(struct mCc_symtab_scope *scope) {
-    // Free all entries in the hash table
-    struct mCc_symtab_entry *e, *tmp;
-    HASH_ITER(hh, scope->hash_table, e, tmp)
-    {
-        HASH_DEL(scope->hash_table, e);
-        mCc_symtab_delete_entry(e);
-    }
-
-    free(scope->name);
-    free(scope);
+void mCc_symtab_delete_all_scopes(struct mCc_context *ctx) {
+    mCc_symtab_delete_scopes(ctx);
 }
 
-static void mCc_symtab_delete_entry(struct mCc_symtab_entry *entry) {
-    free(entry);
-}
+void mCc_symtab_delete_scopes(struct mCc_context *ctx) {
+    struct mCc_symtab_state *state = &ctx->symtab;
+    // The scopes, their names and entries are in the arena
+    mCc_arena_delete(state->arena);
+    state->arena = NULL;
+    state->current = NULL;
 
-static void mCc_symtab_delete_built_ins(void) {
-    for (unsigned int i = 0; i < built_in_count; ++i) {
-        mCc_ast_delete_func_def(built_in_arr[i]);
+    if (state->scopes) {
+        free(state->scopes);
+        state->scopes = NULL;
     }
-    built_in_count = 0;
-}
 
-void mCc_symtab_delete_all_scopes(void) {
-    mCc_symtab_delete_built_ins();
-    for (unsigned int i = 0; i < global_scope_gc_count; ++i) {
-        mCc_symtab_delete_scope(global_scope_gc_arr[i]);
-    }
+    state->scope_count = 0;
+    state->scope_alloc_size = 0;
+    state->function_scope_start = 0;
+
+    free(state->bindings);
+    state->bindings = NULL;
+    state->binding_count = 0;
+    free(state->log);
+    state->log = NULL;
+    state->log_count = 0;
+    state->log_alloc_size = 0;
+
+    // The names of the built-ins are interned again for the next root scope
+    mCc_interner_delete(state->own_interner);
+    state->own_interner = NULL;
+    state->interner = NULL;
+    state->source = NULL;
+}
 
-    if (global_scope_gc_arr) {
-        free(global_scope_gc_arr);
-        global_scope_gc_arr = NULL;
+void mCc_symtab_delete_function_scopes(struct mCc_context *ctx) {
+    struct mCc_symtab_state *state = &ctx->symtab;
+    if (!state->function_scope_start)
+        return;
+
+    // Their entries are bound until they are left
+    if (state->scope_count > state->function_scope_start) {
+        struct mCc_symtab_scope *root =
+                state->scopes[state->function_scope_start]->parent;
+        if (root->open)
+            mCc_symtab_leave_inner_scopes(root);
     }
+    state->scope_count = state->function_scope_start;
+    state->function_scope_start = 0;
+    mCc_arena_release(state->arena, state->function_mark);
+}
 
-    global_scope_gc_count = 0;
-    global_scope_gc_alloc_size = 0;
+void mCc_symtab_set_interner(struct mCc_context *ctx,
+                             struct mCc_interner *interner) {
+    ctx->symtab.interner = interner ? interner : ctx->symtab.own_interner;
 }
 
-void mCc_symtab_print_all_scopes(FILE *out) {
-    fputs("| Table | Symbol | Entry | Type | Location |\n", out);
-    fputs("| ---   |  ---   | ---   | ---  |    ---   |\n", out);
+void mCc_symtab_set_source(struct mCc_context *ctx, struct mCc_source *source) {
+    ctx->symtab.source = source;
+}
 
-    struct mCc_symtab_entry *e, *tmp;
-    for (unsigned int i = 0; i < global_scope_gc_count; ++i) {
-        HASH_ITER(hh, global_scope_gc_arr[i]->hash_table, e, tmp)
-        {
-            char *entry_type;
+void mCc_symtab_print_all_scopes(struct mCc_context *ctx, FILE *file) {
+    struct mCc_symtab_state *state = &ctx->symtab;
+    struct mCc_writer writer, *out = &writer;
+    mCc_writer_init_file(out, file);
+    mCc_writer_puts(out, "| Table | Symbol | Entry | Type | Location |\n");
+    mCc_writer_puts(out, "| ---   |  ---   | ---   | ---  |    ---   |\n");
+
+    for (unsigned int i = 0; i < state->scope_count; ++i) {
+        for (struct mCc_symtab_entry *e = state->scopes[i]->first_entry; e;
+             e = e->next_in_scope) {
+            char *entry_type = "?";
             switch (e->entry_type) {
                 case MCC_SYMTAB_ENTRY_TYPE_VAR:
                     entry_type = "var";
@@ -434,7 +631,7 @@ void mCc_symtab_print_all_scopes(FILE *out) {
                     entry_type = "func";
                     break;
             }
-            char *prim_type;
+            char *prim_type = "?";
             switch (e->primitive_type) {
                 case MCC_AST_TYPE_BOOL:
                     prim_type = "bool";
@@ -453,10 +650,26 @@ void mCc_symtab_print_all_scopes(FILE *out) {
                     break;
             }
 
-            fprintf(out, "| %s | %s | %s | %s | %d:%d - %d:%d | \n",
-                    global_scope_gc_arr[i]->name, e->identifier->id_value,
-                    entry_type, prim_type, e->sloc.start_line,
-                    e->sloc.start_col, e->sloc.end_line, e->sloc.end_col);
+            mCc_writer_puts(out, "| ");
+            mCc_writer_puts(out, state->scopes[i]->name);
+            mCc_writer_puts(out, " | ");
+            mCc_writer_puts(out, e->identifier->id_value);
+            mCc_writer_puts(out, " | ");
+            mCc_writer_puts(out, entry_type);
+            mCc_writer_puts(out, " | ");
+            mCc_writer_puts(out, prim_type);
+            mCc_writer_puts(out, " | ");
+            struct mCc_ast_source_location loc = e->sloc;
+            mCc_source_resolve(state->source, &loc);
+            mCc_writer_int(out, loc.start_line);
+            mCc_writer_putc(out, ':');
+            mCc_writer_int(out, loc.start_col);
+            mCc_writer_puts(out, " - ");
+            mCc_writer_int(out, loc.end_line);
+            mCc_writer_putc(out, ':');
+            mCc_writer_int(out, loc.end_col);
+            mCc_writer_puts(out, " | \n");
         }
     }
+    mCc_writer_flush(out);
 }
@@ -7,38 +7,37 @@
  */
 #include "mCc/tac.h"
 #include "mCc/ast.h"
+#include "mCc/context.h"
 #include <assert.h>
 #include <string.h>
 
-struct mCc_tac_quad_entry mCc_tac_create_new_entry() {
-    static int current_var = 0;
+void mCc_tac_reset_numbering(struct mCc_context *ctx) {
+    ctx->tac_numbering.next_var = 0;
+    ctx->tac_numbering.next_string = 0;
+    ctx->tac_numbering.next_label = 0;
+}
 
+struct mCc_tac_quad_entry mCc_tac_create_new_entry(struct mCc_context *ctx) {
     struct mCc_tac_quad_entry entry;
 
-    entry.number = current_var;
-    current_var++;
+    entry.number = ctx->tac_numbering.next_var++;
     entry.array_size = 0;
 
     return entry;
 }
 
-struct mCc_tac_quad_entry mCc_tac_create_new_string() {
-    static int current_string = 0;
-    struct mCc_tac_quad_entry entry = mCc_tac_create_new_entry();
+struct mCc_tac_quad_entry mCc_tac_create_new_string(struct mCc_context *ctx) {
+    struct mCc_tac_quad_entry entry = mCc_tac_create_new_entry(ctx);
 
-    entry.str_number = current_string;
-    current_string++;
+    entry.str_number = ctx->tac_numbering.next_string++;
 
     return entry;
 }
 
-struct mCc_tac_label mCc_tac_get_new_label() {
-    static int current_lab = 0;
-
+struct mCc_tac_label mCc_tac_get_new_label(struct mCc_context *ctx) {
     struct mCc_tac_label label = {0};
 
-    label.num = current_lab;
-    current_lab++;
+    label.num = ctx->tac_numbering.next_label++;
     return label;
 }
 
@@ -140,6 +139,22 @@ mCc_tac_quad_new_jumpfalse(struct mCc_tac_quad_entry condition,
     return quad;
 }
 
+struct mCc_tac_quad *
+mCc_tac_quad_new_jumptrue(struct mCc_tac_quad_entry condition,
+                          struct mCc_tac_label label) {
+    struct mCc_tac_quad *quad = malloc(sizeof(*quad));
+
+    if (!quad) {
+        return NULL;
+    }
+
+    quad->comment = NULL;
+    quad->type = MCC_TAC_QUAD_JUMPTRUE;
+    quad->arg1 = condition;
+    quad->result.label = label;
+    return quad;
+}
+
 struct mCc_tac_quad *mCc_tac_quad_new_label(struct mCc_tac_label label) {
 
     struct mCc_tac_quad *quad = malloc(sizeof(*quad));
@@ -151,6 +166,12 @@ struct mCc_tac_quad *mCc_tac_quad_new_label(struct mCc_tac_label label) {
     quad->comment = NULL;
     quad->type = MCC_TAC_QUAD_LABEL;
     quad->result.label = label;
+    quad->call_conv = MCC_TAC_CALL_CONV_CDECL;
+    quad->params = NULL;
+    quad->param_count = 0;
+    quad->loop_header = false;
+    quad->remainder_loop = false;
+    memset(&quad->numbering, 0, sizeof(quad->numbering));
     return quad;
 }
 
@@ -164,6 +185,8 @@ struct mCc_tac_quad *mCc_tac_quad_new_param(struct mCc_tac_quad_entry value) {
     quad->comment = NULL;
     quad->type = MCC_TAC_QUAD_PARAM;
     quad->arg1 = value;
+    quad->var_count = 0;
+    quad->call_conv = MCC_TAC_CALL_CONV_CDECL;
 
     return quad;
 }
@@ -184,6 +207,7 @@ struct mCc_tac_quad *mCc_tac_quad_new_call(struct mCc_tac_label label,
     quad->result.label = label;
     quad->result.label.type = result.type;
     quad->var_count = param_count;
+    quad->call_conv = MCC_TAC_CALL_CONV_CDECL;
     return quad;
 }
 
@@ -252,133 +276,181 @@ mCc_tac_quad_new_return(struct mCc_tac_quad_entry ret_value) {
     return quad;
 }
 
-static inline void mCc_tac_print_label(struct mCc_tac_label label, FILE *out) {
-    if (label.str[0]) {
-        fputs(label.str, out);
+struct mCc_tac_quad *mCc_tac_quad_new_select(struct mCc_tac_quad_entry cond,
+                                             struct mCc_tac_quad_entry if_true,
+                                             struct mCc_tac_quad_entry if_false,
+                                             struct mCc_tac_quad_entry result) {
+    struct mCc_tac_quad *quad = malloc(sizeof(*quad));
+
+    if (!quad) {
+        return NULL;
+    }
+
+    quad->comment = NULL;
+    quad->type = MCC_TAC_QUAD_SELECT;
+    quad->select_cond = cond.number;
+    quad->arg1 = if_true;
+    quad->arg2 = if_false;
+    quad->result.ref = result;
+
+    return quad;
+}
+
+struct mCc_tac_quad *mCc_tac_quad_new_vector(enum mCc_tac_quad_type type,
+                                             struct mCc_tac_vector vector,
+                                             struct mCc_tac_quad_entry arg1,
+                                             struct mCc_tac_quad_entry arg2,
+                                             struct mCc_tac_quad_entry result) {
+    struct mCc_tac_quad *quad = malloc(sizeof(*quad));
+
+    if (!quad) {
+        return NULL;
+    }
+
+    quad->comment = NULL;
+    quad->type = type;
+    quad->vector = vector;
+    quad->arg1 = arg1;
+    quad->arg2 = arg2;
+    quad->result.ref = result;
+
+    return quad;
+}
+
+struct mCc_tac_quad *mCc_tac_quad_copy(const struct mCc_tac_quad *self) {
+    assert(self);
+
+    struct mCc_tac_quad *quad = malloc(sizeof(*quad));
+
+    if (!quad) {
+        return NULL;
+    }
+
+    *quad = *self;
+    if (self->type == MCC_TAC_QUAD_ASSIGN_LIT) {
+        quad->literal = malloc(sizeof(*quad->literal));
+        if (!quad->literal) {
+            free(quad);
+            return NULL;
+        }
+        *quad->literal = *self->literal;
+    } else if (self->type == MCC_TAC_QUAD_LABEL && self->param_count) {
+        quad->params = malloc(self->param_count * sizeof(*quad->params));
+        if (!quad->params) {
+            free(quad);
+            return NULL;
+        }
+        memcpy(quad->params, self->params,
+               self->param_count * sizeof(*quad->params));
+    }
+    return quad;
+}
+
+static inline void mCc_tac_print_label(struct mCc_tac_label label,
+                                       struct mCc_writer *out) {
+    if (label.str) {
+        mCc_writer_puts(out, label.str);
     } else {
-        fprintf(out, "L%d", label.num);
+        mCc_writer_putc(out, 'L');
+        mCc_writer_int(out, label.num);
     }
 }
 
-static void mCc_tac_print_bin_op(struct mCc_tac_quad *self, FILE *out) {
-    switch (self->bin_op) {
+/* Emit text followed by a number, e.g. a temporary */
+static inline void mCc_tac_print_num(struct mCc_writer *out, const char *text,
+                                     int number) {
+    mCc_writer_puts(out, text);
+    mCc_writer_int(out, number);
+}
+
+const char *mCc_tac_binary_op_symbol(enum mCc_tac_quad_binary_op op) {
+    switch (op) {
         case MCC_TAC_OP_BINARY_ADD:
-            fprintf(out, "\tt%d = t%d + t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_SUB:
-            fprintf(out, "\tt%d = t%d - t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_MUL:
-            fprintf(out, "\tt%d = t%d * t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_DIV:
-            fprintf(out, "\t%d = t%d / t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_LT:
-            fprintf(out, "\tt%d = t%d < t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_GT:
-            fprintf(out, "\tt%d = t%d > t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_LEQ:
-            fprintf(out, "\tt%d = t%d <= t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_GEQ:
-            fprintf(out, "\tt%d = t%d >= t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_AND:
-            fprintf(out, "\tt%d = t%d && t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_OR:
-            fprintf(out, "\tt%d = t%d || t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_EQ:
-            fprintf(out, "\tt%d = t%d == t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
-        case MCC_TAC_OP_BINARY_NEQ:
-            fprintf(out, "\tt%d = t%d != t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
         case MCC_TAC_OP_BINARY_FLOAT_ADD:
-            fprintf(out, "\tt%d = t%d + t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
+            return "+";
+        case MCC_TAC_OP_BINARY_SUB:
         case MCC_TAC_OP_BINARY_FLOAT_SUB:
-            fprintf(out, "\tt%d = t%d - t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
+            return "-";
+        case MCC_TAC_OP_BINARY_MUL:
         case MCC_TAC_OP_BINARY_FLOAT_MUL:
-            fprintf(out, "\tt%d = t%d * t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
+            return "*";
+        case MCC_TAC_OP_BINARY_DIV:
         case MCC_TAC_OP_BINARY_FLOAT_DIV:
-            fprintf(out, "\tt%d = t%d / t%d\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
-            break;
+            return "/";
+        case MCC_TAC_OP_BINARY_LT: return "<";
+        case MCC_TAC_OP_BINARY_GT: return ">";
+        case MCC_TAC_OP_BINARY_LEQ: return "<=";
+        case MCC_TAC_OP_BINARY_GEQ: return ">=";
+        case MCC_TAC_OP_BINARY_AND: return "&&";
+        case MCC_TAC_OP_BINARY_OR: return "||";
+        case MCC_TAC_OP_BINARY_EQ: return "==";
+        case MCC_TAC_OP_BINARY_NEQ: return "!=";
     }
-    return;
+    return "?";
 }
 
-static void mCc_tac_print_unary_op(struct mCc_tac_quad *self, FILE *out) {
+static void mCc_tac_print_bin_op(struct mCc_tac_quad *self,
+                                 struct mCc_writer *out) {
+    mCc_tac_print_num(out, "\tt", self->result.ref.number);
+    mCc_tac_print_num(out, " = t", self->arg1.number);
+    mCc_writer_putc(out, ' ');
+    mCc_writer_puts(out, mCc_tac_binary_op_symbol(self->bin_op));
+    mCc_tac_print_num(out, " t", self->arg2.number);
+    mCc_writer_putc(out, '\n');
+}
+
+static void mCc_tac_print_unary_op(struct mCc_tac_quad *self,
+                                   struct mCc_writer *out) {
+    mCc_tac_print_num(out, "\tt", self->result.ref.number);
     switch (self->un_op) {
         case MCC_TAC_OP_UNARY_NEG:
-            fprintf(out, "\tt%d = -t%d\n", self->result.ref.number,
-                    self->arg1.number);
+            mCc_tac_print_num(out, " = -t", self->arg1.number);
             break;
         case MCC_TAC_OP_UNARY_NOT:
-            fprintf(out, "\tt%d = !t%d\n", self->result.ref.number,
-                    self->arg1.number);
+            mCc_tac_print_num(out, " = !t", self->arg1.number);
             break;
     }
-    return;
+    mCc_writer_putc(out, '\n');
 }
 
-static void mCc_tac_print_literal(struct mCc_tac_quad *self, FILE *out) {
+static void mCc_tac_print_literal(struct mCc_tac_quad *self,
+                                  struct mCc_writer *out) {
+    if (self->literal->type == MCC_TAC_QUAD_LIT_VOID)
+        return;
+    mCc_tac_print_num(out, "\tt", self->result.ref.number);
     switch (self->literal->type) {
         case MCC_TAC_QUAD_LIT_INT:
-            fprintf(out, "\tt%d = %d\n", self->result.ref.number,
-                    self->literal->ival);
+            mCc_tac_print_num(out, " = ", self->literal->ival);
             break;
         case MCC_TAC_QUAD_LIT_FLOAT:
-            fprintf(out, "\tt%d = %f\n", self->result.ref.number,
-                    self->literal->fval);
+            mCc_writer_printf(out, " = %f", self->literal->fval);
             break;
         case MCC_TAC_QUAD_LIT_BOOL:
-            fprintf(out, "\tt%d = %s\n", self->result.ref.number,
-                    self->literal->bval ? "true" : "false");
+            mCc_writer_puts(out, self->literal->bval ? " = true" : " = false");
             break;
         case MCC_TAC_QUAD_LIT_STR:
-            fprintf(out, "\tt%d = \"%s\"\n", self->result.ref.number,
-                    self->literal->strval);
+            mCc_writer_puts(out, " = \"");
+            mCc_writer_puts(out, self->literal->strval);
+            mCc_writer_putc(out, '"');
             break;
         case MCC_TAC_QUAD_LIT_VOID:
             break;
     }
-    return;
+    mCc_writer_putc(out, '\n');
 }
 
-void mCc_tac_quad_print(struct mCc_tac_quad *self, FILE *out) {
-
-    assert(self);
-    assert(out);
+static void mCc_tac_quad_write(struct mCc_tac_quad *self,
+                               struct mCc_writer *out) {
     if (self->comment) {
-        fprintf(out, "; %s\n", self->comment);
+        mCc_writer_puts(out, "; ");
+        mCc_writer_puts(out, self->comment);
+        mCc_writer_putc(out, '\n');
     }
     switch (self->type) {
         case MCC_TAC_QUAD_ASSIGN:
-            fprintf(out, "\tt%d = t%d\n", self->result.ref.number,
-                    self->arg1.number);
+            mCc_tac_print_num(out, "\tt", self->result.ref.number);
+            mCc_tac_print_num(out, " = t", self->arg1.number);
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_ASSIGN_LIT:
             mCc_tac_print_literal(self, out);
@@ -390,46 +462,122 @@ void mCc_tac_quad_print(struct mCc_tac_quad *self, FILE *out) {
             mCc_tac_print_bin_op(self, out);
             break;
         case MCC_TAC_QUAD_JUMP:
-            fputs("\tjump ", out);
+            mCc_writer_puts(out, "\tjump ");
             mCc_tac_print_label(self->result.label, out);
-            fputc('\n', out);
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_JUMPFALSE:
-            fprintf(out, "\tjumpfalse t%d ", self->arg1.number);
+            mCc_tac_print_num(out, "\tjumpfalse t", self->arg1.number);
+            mCc_writer_putc(out, ' ');
             mCc_tac_print_label(self->result.label, out);
-            fputc('\n', out);
+            mCc_writer_putc(out, '\n');
+            break;
+        case MCC_TAC_QUAD_JUMPTRUE:
+            mCc_tac_print_num(out, "\tjumptrue t", self->arg1.number);
+            mCc_writer_putc(out, ' ');
+            mCc_tac_print_label(self->result.label, out);
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_LABEL:
             mCc_tac_print_label(self->result.label, out);
-            fputs(":\n", out);
+            mCc_writer_puts(out, ":\n");
+            if (self->param_count) {
+                mCc_writer_puts(out, "; params");
+                for (unsigned int i = 0; i < self->param_count; ++i)
+                    mCc_tac_print_num(out, " t", self->params[i].number);
+                mCc_writer_puts(out,
+                                self->call_conv == MCC_TAC_CALL_CONV_INTERNAL
+                                        ? " (internal)\n"
+                                        : " (cdecl)\n");
+            }
             break;
         case MCC_TAC_QUAD_PARAM:
-            fprintf(out, "\tparam t%d\n", self->arg1.number);
+            mCc_tac_print_num(out, "\tparam t", self->arg1.number);
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_CALL:
-            if (self->arg1.number >= 0)
-                fprintf(out, "\tt%d = call ", self->arg1.number);
-            else
-                fputs("\tcall ", out);
+            if (self->arg1.number >= 0) {
+                mCc_tac_print_num(out, "\tt", self->arg1.number);
+                mCc_writer_puts(out, " = call ");
+            } else {
+                mCc_writer_puts(out, "\tcall ");
+            }
             mCc_tac_print_label(self->result.label, out);
-            fputc('\n', out);
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_LOAD:
-            fprintf(out, "\tt%d = t%d[t%d]\n", self->result.ref.number,
-                    self->arg1.number, self->arg2.number);
+            mCc_tac_print_num(out, "\tt", self->result.ref.number);
+            mCc_tac_print_num(out, " = t", self->arg1.number);
+            mCc_tac_print_num(out, "[t", self->arg2.number);
+            mCc_writer_puts(out, "]\n");
             break;
         case MCC_TAC_QUAD_STORE:
-            fprintf(out, "\tt%d[t%d] = t%d\n", self->result.ref.number,
-                    self->arg2.number, self->arg1.number);
+            mCc_tac_print_num(out, "\tt", self->result.ref.number);
+            mCc_tac_print_num(out, "[t", self->arg2.number);
+            mCc_tac_print_num(out, "] = t", self->arg1.number);
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_RETURN:
-            fprintf(out, "\treturn t%d\n", self->arg1.number);
+            mCc_tac_print_num(out, "\treturn t", self->arg1.number);
+            mCc_writer_putc(out, '\n');
             break;
         case MCC_TAC_QUAD_RETURN_VOID:
-            fprintf(out, "\treturn \n");
+            mCc_writer_puts(out, "\treturn \n");
+            break;
+        case MCC_TAC_QUAD_SELECT:
+            mCc_tac_print_num(out, "\tt", self->result.ref.number);
+            mCc_tac_print_num(out, " = t", self->select_cond);
+            mCc_tac_print_num(out, " ? t", self->arg1.number);
+            mCc_tac_print_num(out, " : t", self->arg2.number);
+            mCc_writer_putc(out, '\n');
+            break;
+        case MCC_TAC_QUAD_VECTOR_ZERO:
+            mCc_tac_print_num(out, "\tv", self->vector.dst);
+            mCc_writer_puts(out, " = 0\n");
+            break;
+        case MCC_TAC_QUAD_VECTOR_SPLAT:
+            mCc_tac_print_num(out, "\tv", self->vector.dst);
+            mCc_tac_print_num(out, " = splat t", self->arg1.number);
+            mCc_writer_putc(out, '\n');
+            break;
+        case MCC_TAC_QUAD_VECTOR_LOAD:
+            mCc_tac_print_num(out, "\tv", self->vector.dst);
+            mCc_tac_print_num(out, " = t", self->arg1.number);
+            mCc_tac_print_num(out, "[t", self->arg2.number);
+            mCc_tac_print_num(out, ":", MCC_TAC_VECTOR_LANES);
+            mCc_writer_puts(out, "]\n");
+            break;
+        case MCC_TAC_QUAD_VECTOR_OP:
+            mCc_tac_print_num(out, "\tv", self->vector.dst);
+            mCc_tac_print_num(out, " = v", self->vector.src1);
+            mCc_writer_putc(out, ' ');
+            mCc_writer_puts(out, mCc_tac_binary_op_symbol(self->vector.op));
+            mCc_tac_print_num(out, " v", self->vector.src2);
+            mCc_writer_putc(out, '\n');
+            break;
+        case MCC_TAC_QUAD_VECTOR_STORE:
+            mCc_tac_print_num(out, "\tt", self->result.ref.number);
+            mCc_tac_print_num(out, "[t", self->arg2.number);
+            mCc_tac_print_num(out, ":", MCC_TAC_VECTOR_LANES);
+            mCc_tac_print_num(out, "] = v", self->vector.src1);
+            mCc_writer_putc(out, '\n');
+            break;
+        case MCC_TAC_QUAD_VECTOR_REDUCE:
+            mCc_tac_print_num(out, "\tt", self->result.ref.number);
+            mCc_tac_print_num(out, " = t", self->result.ref.number);
+            mCc_tac_print_num(out, " + sum v", self->vector.src1);
+            mCc_writer_putc(out, '\n');
             break;
     }
-    return;
+}
+
+void mCc_tac_quad_print(struct mCc_tac_quad *self, FILE *out) {
+    assert(self);
+    assert(out);
+    struct mCc_writer writer;
+    mCc_writer_init_file(&writer, out);
+    mCc_tac_quad_write(self, &writer);
+    mCc_writer_flush(&writer);
 }
 
 void mCc_tac_quad_delete(struct mCc_tac_quad *self) {
@@ -449,7 +597,10 @@ void mCc_tac_quad_delete(struct mCc_tac_quad *self) {
             break;
         case MCC_TAC_QUAD_JUMPFALSE:
             break;
+        case MCC_TAC_QUAD_JUMPTRUE:
+            break;
         case MCC_TAC_QUAD_LABEL:
+            free(self->params);
             break;
         case MCC_TAC_QUAD_PARAM:
             break;
@@ -463,6 +614,15 @@ void mCc_tac_quad_delete(struct mCc_tac_quad *self) {
             break;
         case MCC_TAC_QUAD_RETURN_VOID:
             break;
+        case MCC_TAC_QUAD_SELECT:
+            break;
+        case MCC_TAC_QUAD_VECTOR_ZERO:
+        case MCC_TAC_QUAD_VECTOR_SPLAT:
+        case MCC_TAC_QUAD_VECTOR_LOAD:
+        case MCC_TAC_QUAD_VECTOR_OP:
+        case MCC_TAC_QUAD_VECTOR_STORE:
+        case MCC_TAC_QUAD_VECTOR_REDUCE:
+            break;
     }
     // Don't free comment because that is a string literal
 
@@ -485,6 +645,12 @@ struct mCc_tac_program *mCc_tac_program_new(int quad_alloc_size) {
     program->quad_alloc_size = quad_alloc_size;
     program->quad_count = 0;
     program->quads = NULL;
+    program->string_literals = NULL;
+    program->string_literal_count = 0;
+    program->cfgs = NULL;
+    program->cfg_alloc_size = 0;
+    program->cfg_count = 0;
+    program->ctx = NULL;
 
     if (quad_alloc_size > 0) { // allocate memory if specified
         if ((program->quads =
@@ -538,7 +704,9 @@ int mCc_tac_program_add_quad(struct mCc_tac_program *self,
 }
 
 int mCc_tac_program_add_cfg(struct mCc_tac_program *self,
-                            char *from_label, int from_number, char *to_label, int to_number, char *label) {
+                            const char *from_label, int from_number,
+                            const char *to_label, int to_number,
+                            const char *label) {
     assert(self);
     char connection[MAX_NAME_LENGTH];
 
@@ -575,8 +743,18 @@ int mCc_tac_program_add_cfg(struct mCc_tac_program *self,
 void mCc_tac_program_print(struct mCc_tac_program *self, FILE *out) {
     assert(self);
     assert(out);
+    struct mCc_writer writer;
+    mCc_writer_init_file(&writer, out);
+    mCc_tac_program_write(self, &writer);
+    mCc_writer_flush(&writer);
+}
+
+void mCc_tac_program_write(struct mCc_tac_program *self,
+                           struct mCc_writer *out) {
+    assert(self);
+    assert(out);
     for (unsigned int i = 0; i < self->quad_count; i++) {
-        mCc_tac_quad_print(self->quads[i], out);
+        mCc_tac_quad_write(self->quads[i], out);
     }
 }
 
@@ -586,5 +764,10 @@ void mCc_tac_program_delete(struct mCc_tac_program *self) {
         mCc_tac_quad_delete(self->quads[i]);
     }
     free(self->quads);
+    free(self->string_literals);
+    for (unsigned int i = 0; i < self->cfg_count; i++) {
+        free(self->cfgs[i]);
+    }
+    free(self->cfgs);
     free(self);
 }
@@ -5,25 +5,10 @@
  * @date 2018-04-27
  */
 #include "mCc/tac_builder.h"
-#include "mCc/symtab.h"
+#include "mCc/context.h"
 
-/*********************************** Global array of strings */
-
-/// Block size by which to increase array when reallocating
-static const unsigned int global_string_block_size = 10;
-/// Number of entries for which memory was allocated
-static unsigned int global_string_alloc_size = 0;
-/// Number of entries currently in array
-static unsigned int global_string_count = 0;
-/// count variables for assembly
-static unsigned int global_var_count = 0;
-
-/// struct for cfg
-static struct mCc_cfg_block tmp_block;
-static unsigned int anonym_block_count = 0;
-
-/// All strings ever created, to use for generating assembly
-static struct mCc_tac_quad_entry *global_string_arr = NULL;
+/// Block size by which to increase the string array when reallocating
+static const unsigned int string_block_size = 10;
 
 static struct mCc_tac_quad_entry
 mCc_tac_from_expression(struct mCc_tac_program *prog,
@@ -53,45 +38,70 @@ mCc_tac_type_from_ast_type(enum mCc_ast_type ast_type) {
     }
 }
 
-static int mCc_tac_string_from_assgn(struct mCc_tac_quad_entry entry,
+static int mCc_tac_string_from_assgn(struct mCc_context *ctx,
+                                     struct mCc_tac_quad_entry entry,
                                      struct mCc_tac_quad_literal *lit) {
-    strcpy(entry.str_value, lit->strval);
-    if (global_string_count < global_string_alloc_size) {
-        global_string_arr[global_string_count++] = entry;
+    struct mCc_tac_builder_state *state = &ctx->tac_builder;
+    entry.str_value = lit->strval;
+    if (state->string_count < state->string_alloc_size) {
+        state->strings[state->string_count++] = entry;
         return 1;
     }
 
     struct mCc_tac_quad_entry *tmp;
-    global_string_alloc_size += global_string_block_size;
-    if ((tmp = realloc(global_string_arr,
-                       global_string_alloc_size * sizeof(*tmp))) == NULL)
+    state->string_alloc_size += string_block_size;
+    if ((tmp = realloc(state->strings,
+                       state->string_alloc_size * sizeof(*tmp))) == NULL)
         return 1;
 
-    global_string_arr = tmp;
-    global_string_arr[global_string_count++] = entry;
+    state->strings = tmp;
+    state->strings[state->string_count++] = entry;
     return 0;
 }
 
-static void mCc_tac_entry_from_declaration(struct mCc_ast_declaration *decl) {
+/* Bind the variable of a declaration to a temporary */
+static void mCc_tac_bind_slot(struct mCc_context *ctx,
+                              struct mCc_ast_declaration *decl,
+                              struct mCc_tac_quad_entry entry) {
+    assert(decl->decl_id->slot < ctx->tac_builder.slot_alloc_size);
+    struct mCc_tac_builder_slot *slot =
+            &ctx->tac_builder.slots[decl->decl_id->slot];
+    slot->tmp = entry;
+    slot->arr_size =
+            decl->decl_array_size ? decl->decl_array_size->i_value : 0;
+}
+
+static void mCc_tac_entry_from_declaration(struct mCc_context *ctx,
+                                           struct mCc_ast_declaration *decl) {
     struct mCc_tac_quad_entry entry;
 
-    entry = mCc_tac_create_new_entry();
+    entry = mCc_tac_create_new_entry(ctx);
+    entry.type = mCc_tac_type_from_ast_type(decl->decl_type);
 
     if (decl->decl_array_size) {
-        global_var_count += decl->decl_array_size->i_value;
+        ctx->tac_builder.var_count += decl->decl_array_size->i_value;
         entry.array_size = decl->decl_array_size->i_value;
     }
-    decl->decl_id->symtab_ref->tac_tmp = entry;
+    mCc_tac_bind_slot(ctx, decl, entry);
+}
+
+static struct mCc_tac_builder_slot *
+mCc_get_slot_from_id(struct mCc_tac_builder_state *state,
+                     struct mCc_ast_identifier *id) {
+    assert(id->slot < state->slot_alloc_size);
+    return &state->slots[id->slot];
 }
 
 static struct mCc_tac_quad_entry
-mCc_get_var_from_id(struct mCc_ast_identifier *id) {
-    return id->symtab_ref->tac_tmp;
+mCc_get_var_from_id(struct mCc_tac_builder_state *state,
+                    struct mCc_ast_identifier *id) {
+    return mCc_get_slot_from_id(state, id)->tmp;
 }
 
 static struct mCc_tac_quad_entry
 mCc_tac_from_expression_binary(struct mCc_tac_program *prog,
                                struct mCc_ast_expression *expr) {
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
     struct mCc_tac_quad_entry result1 =
             mCc_tac_from_expression(prog, expr->lhs);
     struct mCc_tac_quad_entry result2 =
@@ -145,13 +155,13 @@ mCc_tac_from_expression_binary(struct mCc_tac_program *prog,
             break;
     }
 
-    struct mCc_tac_quad_entry new_result = mCc_tac_create_new_entry();
-    global_var_count++;
+    struct mCc_tac_quad_entry new_result = mCc_tac_create_new_entry(prog->ctx);
+    state->var_count++;
 
     struct mCc_tac_quad *binary_op =
             mCc_tac_quad_new_op_binary(op, result1, result2, new_result);
-    binary_op->cfg_node.number = tmp_block.number;
-    binary_op->cfg_node.label_name = tmp_block.label_name;
+    binary_op->cfg_node.number = state->tmp_block.number;
+    binary_op->cfg_node.label_name = state->tmp_block.label_name;
     mCc_tac_program_add_quad(prog, binary_op);
 
     return new_result;
@@ -160,6 +170,7 @@ mCc_tac_from_expression_binary(struct mCc_tac_program *prog,
 static struct mCc_tac_quad_entry
 mCc_tac_from_expression_unary(struct mCc_tac_program *prog,
                               struct mCc_ast_expression *expr) {
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
     assert(expr);
 
     enum mCc_tac_quad_unary_op op = -1;
@@ -178,37 +189,64 @@ mCc_tac_from_expression_unary(struct mCc_tac_program *prog,
     struct mCc_tac_quad *result_quad =
             mCc_tac_quad_new_op_unary(op, result, result);
     mCc_tac_program_add_quad(prog, result_quad);
-    result_quad->cfg_node.number = tmp_block.number;
-    result_quad->cfg_node.label_name = tmp_block.label_name;
+    result_quad->cfg_node.number = state->tmp_block.number;
+    result_quad->cfg_node.label_name = state->tmp_block.label_name;
     return result;
 }
 
 static struct mCc_tac_quad_entry
 mCc_tac_from_expression_arr_subscr(struct mCc_tac_program *prog,
                                    struct mCc_ast_expression *expr) {
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
     // rec. create mCc_tac_program for array index
     // create quad [load, result_of_prog]
 
-    struct mCc_tac_quad_entry result = mCc_tac_create_new_entry();
-    struct mCc_tac_quad_entry array = mCc_get_var_from_id(expr->array_id);
-    array.array_size = expr->identifier->symtab_ref->arr_size;
+    struct mCc_tac_quad_entry result = mCc_tac_create_new_entry(prog->ctx);
+    struct mCc_tac_quad_entry array = mCc_get_var_from_id(state, expr->array_id);
+    array.array_size = mCc_get_slot_from_id(state, expr->array_id)->arr_size;
     struct mCc_tac_quad_entry index =
             mCc_tac_from_expression(prog, expr->subscript_expr); // array subscript
     struct mCc_tac_quad *array_subscr =
             mCc_tac_quad_new_load(array, index, result);
-    array_subscr->cfg_node.number = tmp_block.number;
-    array_subscr->cfg_node.label_name = tmp_block.label_name;
+    array_subscr->cfg_node.number = state->tmp_block.number;
+    array_subscr->cfg_node.label_name = state->tmp_block.label_name;
     if (mCc_tac_program_add_quad(prog, array_subscr)) {
         // TODO error handling
     }
     return result;
 }
 
+/**
+ * @brief Choose the calling convention for a function.
+ *
+ * main and the built-ins are called from C and use cdecl, every other mC
+ * function is internal to the program and may use the register convention.
+ *
+ * @param name The name of the function
+ * @param built_in Whether the function is a built-in
+ *
+ * @return The calling convention
+ */
+static enum mCc_tac_call_conv mCc_tac_call_conv_of(const char *name,
+                                                   bool built_in) {
+    if (built_in || !strcmp(name, "main"))
+        return MCC_TAC_CALL_CONV_CDECL;
+    return MCC_TAC_CALL_CONV_INTERNAL;
+}
+
+/* The block of the control flow graph starting at a label, labels are
+ * numbered per function but the blocks of the whole program are printed
+ * together */
+static int mCc_tac_cfg_label(const struct mCc_tac_builder_state *state,
+                             struct mCc_tac_label label) {
+    return state->label_base + label.num;
+}
+
 struct mCc_tac_label
 mCc_get_label_from_fun_name(struct mCc_ast_identifier *f_name) {
 
-    struct mCc_tac_label label;
-    strcpy(label.str, f_name->id_value);
+    struct mCc_tac_label label = {.str = f_name->id_value,
+                                   .name = f_name->atom};
     label.num =
             -1; // for assembly to distinguish if we have a label or func. name
 
@@ -218,39 +256,50 @@ mCc_get_label_from_fun_name(struct mCc_ast_identifier *f_name) {
 static struct mCc_tac_quad_entry
 mCc_tac_from_expression_call(struct mCc_tac_program *prog,
                              struct mCc_ast_expression *expr) {
-    // Compute all params in reverse order and push them
-    // them. That would make this far more annoying - use variable-length array
-    // to store results maybe?
-    if (expr->arguments) {
-        for (int i = expr->arguments->expression_count - 1; i >= 0; --i) {
-            struct mCc_tac_quad_entry param_temporary =
-                    mCc_tac_from_expression(prog, expr->arguments->expressions[i]);
-            struct mCc_tac_quad *param =
-                    mCc_tac_quad_new_param(param_temporary);
-            //param->cfg_node.number=global_block_count;
-            mCc_tac_program_add_quad(prog, param);
-        }
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
+    const struct mCc_ast_function_def *callee = expr->callee;
+    enum mCc_tac_call_conv call_conv =
+            mCc_tac_call_conv_of(expr->f_name->id_value, callee->built_in);
+    unsigned int arg_count =
+            expr->arguments ? expr->arguments->expression_count : 0;
+
+    // Compute all arguments in reverse order first, so that the params are
+    // consecutive and the backend can move them into registers at the call
+    struct mCc_tac_quad_entry *args = NULL;
+    if (arg_count) {
+        args = malloc(arg_count * sizeof(*args));
+        if (!args)
+            return mCc_tac_create_new_entry(prog->ctx);
+        for (int i = arg_count - 1; i >= 0; --i)
+            args[i] = mCc_tac_from_expression(prog,
+                                              expr->arguments->expressions[i]);
+    }
+    for (int i = arg_count - 1; i >= 0; --i) {
+        struct mCc_tac_quad *param = mCc_tac_quad_new_param(args[i]);
+        param->var_count = i;
+        param->call_conv = call_conv;
+        mCc_tac_program_add_quad(prog, param);
     }
+    free(args);
 
     struct mCc_tac_label label_fun = mCc_get_label_from_fun_name(expr->f_name);
-    struct mCc_tac_quad_entry retval = mCc_tac_create_new_entry();
-    retval.type =
-            mCc_tac_type_from_ast_type(expr->f_name->symtab_ref->primitive_type);
-    struct mCc_tac_quad *jump_to_fun = mCc_tac_quad_new_call(
-            label_fun,
-            expr->arguments ? expr->arguments->expression_count : (unsigned int) 0,
-            retval);
-    jump_to_fun->cfg_node.number = tmp_block.number;
-    jump_to_fun->cfg_node.label_name = tmp_block.label_name;
+    struct mCc_tac_quad_entry retval = mCc_tac_create_new_entry(prog->ctx);
+    retval.type = mCc_tac_type_from_ast_type(callee->func_type);
+    struct mCc_tac_quad *jump_to_fun =
+            mCc_tac_quad_new_call(label_fun, arg_count, retval);
+    jump_to_fun->call_conv = call_conv;
+    jump_to_fun->cfg_node.number = state->tmp_block.number;
+    jump_to_fun->cfg_node.label_name = state->tmp_block.label_name;
     mCc_tac_program_add_quad(prog, jump_to_fun);
-    global_var_count++;
+    state->var_count++;
     return retval;
 }
 
 static int mCc_tac_from_statement_if(struct mCc_tac_program *prog,
                                      struct mCc_ast_statement *stmt) {
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
 
-    struct mCc_tac_label label_after_if = mCc_tac_get_new_label();
+    struct mCc_tac_label label_after_if = mCc_tac_get_new_label(prog->ctx);
 
     struct mCc_tac_quad_entry cond =
             mCc_tac_from_expression(prog, stmt->if_cond);
@@ -260,23 +309,24 @@ static int mCc_tac_from_statement_if(struct mCc_tac_program *prog,
     jump_after_if->comment = "Evaluate if condition";
 
     //jump to anon block
-    mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                            "", anonym_block_count, "True");
+    mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                            "", state->anonym_block_count, "True");
 
     //jump to label
-    mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                            "L", label_after_if.num, "False");
+    mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                            "L", mCc_tac_cfg_label(state, label_after_if),
+                            "False");
 
 
-    jump_after_if->cfg_node.number = anonym_block_count;
+    jump_after_if->cfg_node.number = state->anonym_block_count;
 
     jump_after_if->cfg_node.label_name = "";
 
 
-    tmp_block.number = anonym_block_count;
-    tmp_block.label_name = "";
+    state->tmp_block.number = state->anonym_block_count;
+    state->tmp_block.label_name = "";
 
-    ++anonym_block_count;
+    ++state->anonym_block_count;
 
     if (mCc_tac_program_add_quad(prog, jump_after_if))
         return 1;
@@ -287,7 +337,8 @@ static int mCc_tac_from_statement_if(struct mCc_tac_program *prog,
     mCc_tac_from_stmt(prog, stmt->if_stmt);
 
     label_after_if_quad->comment = "End of if";
-    label_after_if_quad->cfg_node.number = label_after_if_quad->result.label.num;
+    label_after_if_quad->cfg_node.number =
+            mCc_tac_cfg_label(state, label_after_if);
 
 
     label_after_if_quad->cfg_node.label_name = "L";
@@ -295,8 +346,9 @@ static int mCc_tac_from_statement_if(struct mCc_tac_program *prog,
     //if to result connection
     if (prog->quads[prog->quad_count - 1]->type != MCC_TAC_QUAD_RETURN_VOID &&
         prog->quads[prog->quad_count - 1]->type != MCC_TAC_QUAD_RETURN) {
-        mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                                "L", label_after_if.num, "");
+        mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                                "L", mCc_tac_cfg_label(state, label_after_if),
+                                "");
     }
 
 
@@ -304,17 +356,18 @@ static int mCc_tac_from_statement_if(struct mCc_tac_program *prog,
         return 1;
 
 
-    tmp_block.label_name = "L";
-    tmp_block.number = label_after_if.num;
+    state->tmp_block.label_name = "L";
+    state->tmp_block.number = mCc_tac_cfg_label(state, label_after_if);
 
     return 0;
 }
 
 static int mCc_tac_from_statement_if_else(struct mCc_tac_program *prog,
                                           struct mCc_ast_statement *stmt) {
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
 
-    struct mCc_tac_label label_else = mCc_tac_get_new_label();
-    struct mCc_tac_label label_after_if = mCc_tac_get_new_label();
+    struct mCc_tac_label label_else = mCc_tac_get_new_label(prog->ctx);
+    struct mCc_tac_label label_after_if = mCc_tac_get_new_label(prog->ctx);
 
     // Compute condition
     struct mCc_tac_quad_entry cond =
@@ -323,24 +376,24 @@ static int mCc_tac_from_statement_if_else(struct mCc_tac_program *prog,
             mCc_tac_quad_new_jumpfalse(cond, label_else);
     jump_to_else->comment = "Evaluate if condition";
 
-    jump_to_else->cfg_node.number = anonym_block_count;
+    jump_to_else->cfg_node.number = state->anonym_block_count;
     jump_to_else->cfg_node.label_name = "";
 
     //if connection
-    mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                            "", anonym_block_count, "True");
+    mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                            "", state->anonym_block_count, "True");
 
     //else connection
-    mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                            "L", label_else.num, "False");
+    mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                            "L", mCc_tac_cfg_label(state, label_else), "False");
 
     if (mCc_tac_program_add_quad(prog, jump_to_else))
         return 1;
 
-    tmp_block.label_name = "";
-    tmp_block.number = anonym_block_count;
+    state->tmp_block.label_name = "";
+    state->tmp_block.number = state->anonym_block_count;
 
-    ++anonym_block_count;
+    ++state->anonym_block_count;
 
     //go into if branch
     mCc_tac_from_stmt(prog, stmt->if_stmt);
@@ -349,14 +402,15 @@ static int mCc_tac_from_statement_if_else(struct mCc_tac_program *prog,
     if (prog->quads[prog->quad_count - 1]->type != MCC_TAC_QUAD_RETURN_VOID &&
         prog->quads[prog->quad_count - 1]->type != MCC_TAC_QUAD_RETURN) {
 
-        mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                                "L", label_after_if.num, "");
+        mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                                "L", mCc_tac_cfg_label(state, label_after_if),
+                                "");
     }
 
     struct mCc_tac_quad *jump_after_if = mCc_tac_quad_new_jump(label_after_if);
     jump_after_if->comment = "Jump after if";
 
-    jump_after_if->cfg_node.number = tmp_block.number;
+    jump_after_if->cfg_node.number = state->tmp_block.number;
     jump_after_if->cfg_node.label_name = "";
 
     if (mCc_tac_program_add_quad(prog, jump_after_if))
@@ -366,80 +420,82 @@ static int mCc_tac_from_statement_if_else(struct mCc_tac_program *prog,
     struct mCc_tac_quad *label_else_quad = mCc_tac_quad_new_label(label_else);
     label_else_quad->comment = "Else branch";
 
-    label_else_quad->cfg_node.number = label_else.num;
+    label_else_quad->cfg_node.number = mCc_tac_cfg_label(state, label_else);
     label_else_quad->cfg_node.label_name = "L";
 
     if (mCc_tac_program_add_quad(prog, label_else_quad))
         return 1;
 
-    tmp_block.label_name = "L";
-    tmp_block.number = label_else.num;
+    state->tmp_block.label_name = "L";
+    state->tmp_block.number = mCc_tac_cfg_label(state, label_else);
 
-    static int return_in_else = -1;
     //Go into else branch
     mCc_tac_from_stmt(prog, stmt->else_stmt);
 
-    if (return_in_else == -1 &&
+    if (state->return_in_else == -1 &&
         (prog->quads[prog->quad_count - 1]->type != MCC_TAC_QUAD_RETURN ||
         prog->quads[prog->quad_count - 1]->type != MCC_TAC_QUAD_RETURN_VOID)){
-        return_in_else = prog->quads[prog->quad_count - 1]->type;
+        state->return_in_else = prog->quads[prog->quad_count - 1]->type;
     }
 
     //else to result connection
-    if (return_in_else != MCC_TAC_QUAD_RETURN_VOID &&
-        return_in_else != MCC_TAC_QUAD_RETURN) {
+    if (state->return_in_else != MCC_TAC_QUAD_RETURN_VOID &&
+        state->return_in_else != MCC_TAC_QUAD_RETURN) {
 
-        mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                                "L", label_after_if.num, "");
+        mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                                "L", mCc_tac_cfg_label(state, label_after_if),
+                                "");
     }
 
     struct mCc_tac_quad *label_after_if_quad =
             mCc_tac_quad_new_label(label_after_if);
     label_after_if_quad->comment = "End of if";
 
-    label_after_if_quad->cfg_node.number = jump_after_if->result.label.num;
+    label_after_if_quad->cfg_node.number =
+            mCc_tac_cfg_label(state, label_after_if);
     label_after_if_quad->cfg_node.label_name = "L";
 
     if (mCc_tac_program_add_quad(prog, label_after_if_quad))
         return 1;
 
-    tmp_block.number = label_after_if.num;
+    state->tmp_block.number = mCc_tac_cfg_label(state, label_after_if);
 
     return 0;
 }
 
 static int mCc_tac_entry_from_assg(struct mCc_tac_program *prog,
                                    struct mCc_ast_statement *stmt) {
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
     struct mCc_tac_quad *new_quad;
-    struct mCc_tac_quad_entry result = mCc_get_var_from_id(stmt->id_assgn);
+    struct mCc_tac_quad_entry result = mCc_get_var_from_id(state, stmt->id_assgn);
 
     struct mCc_tac_quad_entry result_lhs;
     struct mCc_tac_quad_entry result_rhs;
     if (stmt->lhs_assgn)
         result_lhs = mCc_tac_from_expression(prog, stmt->lhs_assgn);
 
-    if (stmt->rhs_assgn->type == MCC_AST_EXPRESSION_TYPE_LITERAL) {
+    // Assigned strings are entered once more, which keeps the numbering of
+    // the string labels stable
+    if (stmt->rhs_assgn->type == MCC_AST_EXPRESSION_TYPE_LITERAL &&
+        stmt->rhs_assgn->literal->type == MCC_AST_LITERAL_TYPE_STRING) {
         struct mCc_tac_quad_literal *lit_result =
                 mCc_get_quad_literal(stmt->rhs_assgn->literal);
-        new_quad = mCc_tac_quad_new_assign_lit(lit_result, result);
-        if (stmt->rhs_assgn->literal->type == MCC_AST_LITERAL_TYPE_STRING) {
-            struct mCc_tac_quad_entry string = mCc_tac_create_new_string();
-            mCc_tac_string_from_assgn(string, lit_result);
-            lit_result->label_num = string.str_number;
-        }
+        struct mCc_tac_quad_entry string = mCc_tac_create_new_string(prog->ctx);
+        mCc_tac_string_from_assgn(prog->ctx, string, lit_result);
+        mCc_tac_quad_literal_delete(lit_result);
     }
     if (stmt->lhs_assgn) {
         result_rhs = mCc_tac_from_expression(prog, stmt->rhs_assgn);
         new_quad = mCc_tac_quad_new_store(result_lhs, result_rhs, result);
-        global_var_count += 2; // lhs && rhs
+        state->var_count += 2; // lhs && rhs
     } else {
         result_rhs = mCc_tac_from_expression(prog, stmt->rhs_assgn);
         new_quad = mCc_tac_quad_new_assign(result_rhs, result);
-        global_var_count++; // rhs
+        state->var_count++; // rhs
     }
-    global_var_count++; // result
-    new_quad->cfg_node.label_name = tmp_block.label_name;
-    new_quad->cfg_node.number = tmp_block.number;
+    state->var_count++; // result
+    new_quad->cfg_node.label_name = state->tmp_block.label_name;
+    new_quad->cfg_node.number = state->tmp_block.number;
     if (!new_quad || mCc_tac_program_add_quad(prog, new_quad))
         return 1;
     return 0;
@@ -447,6 +503,7 @@ static int mCc_tac_entry_from_assg(struct mCc_tac_program *prog,
 
 static int mCc_tac_from_statement_return(struct mCc_tac_program *prog,
                                          struct mCc_ast_statement *stmt) {
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
     struct mCc_tac_quad_entry entry;
     struct mCc_tac_quad *new_quad;
     if (stmt->ret_val) {
@@ -456,7 +513,7 @@ static int mCc_tac_from_statement_return(struct mCc_tac_program *prog,
         new_quad = mCc_tac_quad_new_return(entry);
     else
         new_quad = mCc_tac_quad_new_return_void();
-    new_quad->cfg_node.label_name = tmp_block.label_name;
+    new_quad->cfg_node.label_name = state->tmp_block.label_name;
     if (!new_quad || mCc_tac_program_add_quad(prog, new_quad))
         return 1;
     return 0;
@@ -464,18 +521,19 @@ static int mCc_tac_from_statement_return(struct mCc_tac_program *prog,
 
 static int mCc_tac_from_statement_while(struct mCc_tac_program *prog,
                                         struct mCc_ast_statement *stmt) {
-    struct mCc_tac_label label_cond = mCc_tac_get_new_label();
-    struct mCc_tac_label label_after_while = mCc_tac_get_new_label();
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
+    struct mCc_tac_label label_cond = mCc_tac_get_new_label(prog->ctx);
+    struct mCc_tac_label label_after_while = mCc_tac_get_new_label(prog->ctx);
     struct mCc_tac_quad *label_cond_quad = mCc_tac_quad_new_label(label_cond);
     struct mCc_tac_quad *label_after_while_quad =
             mCc_tac_quad_new_label(label_after_while);
     label_after_while_quad->comment = "End of while";
 
-    label_cond_quad->cfg_node.number = label_cond.num;
+    label_cond_quad->cfg_node.number = mCc_tac_cfg_label(state, label_cond);
     label_cond_quad->cfg_node.label_name = "L";
 
-    mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                            "L", label_cond.num, "");
+    mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                            "L", mCc_tac_cfg_label(state, label_cond), "");
 
 
     mCc_tac_program_add_quad(prog, label_cond_quad);
@@ -484,126 +542,139 @@ static int mCc_tac_from_statement_while(struct mCc_tac_program *prog,
     struct mCc_tac_quad *jump_after_while =
             mCc_tac_quad_new_jumpfalse(cond, label_after_while);
     jump_after_while->comment = "Evaluate while condition";
-    jump_after_while->cfg_node.number = anonym_block_count;
+    jump_after_while->cfg_node.number = state->anonym_block_count;
     jump_after_while->cfg_node.label_name = "";
 
     if (mCc_tac_program_add_quad(prog, jump_after_while))
         return 1;
 
-    tmp_block.label_name = "";
-    tmp_block.number = anonym_block_count;
+    state->tmp_block.label_name = "";
+    state->tmp_block.number = state->anonym_block_count;
 
-    mCc_tac_program_add_cfg(prog, "L", label_cond.num,
-                            "", tmp_block.number, "True");
+    mCc_tac_program_add_cfg(prog, "L", mCc_tac_cfg_label(state, label_cond),
+                            "", state->tmp_block.number, "True");
 
-    ++anonym_block_count;
+    ++state->anonym_block_count;
     mCc_tac_from_stmt(prog, stmt->while_stmt);
 
     if (prog->quads[prog->quad_count - 1]->type != MCC_TAC_QUAD_RETURN_VOID &&
         prog->quads[prog->quad_count - 1]->type != MCC_TAC_QUAD_RETURN) {
 
-        mCc_tac_program_add_cfg(prog, tmp_block.label_name, tmp_block.number,
-                                "L", label_cond.num, "");
+        mCc_tac_program_add_cfg(prog, state->tmp_block.label_name, state->tmp_block.number,
+                                "L", mCc_tac_cfg_label(state, label_cond), "");
     }
     struct mCc_tac_quad *jump_to_cond = mCc_tac_quad_new_jump(label_cond);
     jump_to_cond->comment = "Repeat Loop";
-    jump_to_cond->cfg_node.number = anonym_block_count;
+    jump_to_cond->cfg_node.number = state->anonym_block_count;
     jump_to_cond->cfg_node.label_name = "";
 
     if (mCc_tac_program_add_quad(prog, jump_to_cond))
         return 1;
 
-    label_after_while_quad->cfg_node.number = label_after_while.num;
+    label_after_while_quad->cfg_node.number =
+            mCc_tac_cfg_label(state, label_after_while);
     label_after_while_quad->cfg_node.label_name = "L";
     if (mCc_tac_program_add_quad(prog, label_after_while_quad))
         return 1;
 
-    mCc_tac_program_add_cfg(prog, "L", label_cond.num,
-                            "L", label_after_while.num, "False");
+    mCc_tac_program_add_cfg(prog, "L", mCc_tac_cfg_label(state, label_cond),
+                            "L", mCc_tac_cfg_label(state, label_after_while),
+                            "False");
 
-    tmp_block.label_name = "L";
-    tmp_block.number = label_after_while.num;
+    state->tmp_block.label_name = "L";
+    state->tmp_block.number = mCc_tac_cfg_label(state, label_after_while);
+
+    return 0;
+}
 
+/* Make room for the slots of a function, 0 on success */
+static int mCc_tac_reserve_slots(struct mCc_tac_builder_state *state,
+                                 unsigned int count) {
+    if (count <= state->slot_alloc_size)
+        return 0;
+    struct mCc_tac_builder_slot *tmp =
+            realloc(state->slots, count * sizeof(*tmp));
+    if (!tmp)
+        return 1;
+    state->slots = tmp;
+    state->slot_alloc_size = count;
     return 0;
 }
 
 static int mCc_tac_from_function_def(struct mCc_tac_program *prog,
                                      struct mCc_ast_function_def *fun_def) {
-    global_var_count = 0;
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
+    if (mCc_tac_reserve_slots(state, fun_def->slot_count))
+        return 1;
+    state->var_count = 0;
+    mCc_tac_reset_numbering(prog->ctx);
     struct mCc_tac_label label_fun =
             mCc_get_label_from_fun_name(fun_def->identifier);
 
     struct mCc_tac_quad *label_fun_quad = mCc_tac_quad_new_label(label_fun);
 
-    tmp_block.label_name = label_fun.str;
-    tmp_block.number = anonym_block_count;
+    state->tmp_block.label_name = label_fun.str;
+    state->tmp_block.number = state->anonym_block_count;
 
     mCc_tac_program_add_cfg(prog, label_fun.str, 0,
-                            "", anonym_block_count, "");
+                            "", state->anonym_block_count, "");
 
-    ++anonym_block_count;
+    ++state->anonym_block_count;
 
-    tmp_block.label_name = "";
-    label_fun_quad->cfg_node.label_name = tmp_block.label_name;
-    label_fun_quad->cfg_node.number = tmp_block.number;
+    state->tmp_block.label_name = "";
+    label_fun_quad->cfg_node.label_name = state->tmp_block.label_name;
+    label_fun_quad->cfg_node.number = state->tmp_block.number;
 
     if (mCc_tac_program_add_quad(prog, label_fun_quad)) {
         return 1;
     };
-    // Copy arguments to new temporaries
-    struct mCc_tac_quad_entry virtual_pointer_to_arguments = {.number = -1};
+    // Bind every parameter to a new temporary. The backend copies them from
+    // registers or the stack into the temporaries in the prologue.
+    label_fun_quad->call_conv =
+            mCc_tac_call_conv_of(fun_def->identifier->id_value, false);
     if (fun_def->para) {
+        label_fun_quad->param_count = fun_def->para->decl_count;
+        label_fun_quad->params = malloc(label_fun_quad->param_count *
+                                        sizeof(*label_fun_quad->params));
+        if (!label_fun_quad->params)
+            return 1;
+
         for (unsigned int i = 0; i < fun_def->para->decl_count; ++i) {
-            // Load argument index into a quad
-            struct mCc_tac_quad_literal *lit = malloc(sizeof(*lit));
-            lit->type =
-                    mCc_tac_type_from_ast_type(fun_def->para->decl[i]->decl_type);
-
-            lit->ival = i; // For the correct stack ptr in tac
-
-            struct mCc_tac_quad_entry entry = mCc_tac_create_new_entry();
-            struct mCc_tac_quad *quad = mCc_tac_quad_new_assign_lit(lit, entry);
-            global_var_count++;
-            quad->cfg_node.label_name = tmp_block.label_name;
-            if (mCc_tac_program_add_quad(prog, quad))
-                return 1;
-
-            // Load argument from stack into new temporary
-            struct mCc_tac_quad_entry new_entry = mCc_tac_create_new_entry();
-            entry.type = lit->type;
-            new_entry.array_size = 0;
-            struct mCc_tac_quad *load_param = mCc_tac_quad_new_load(
-                    virtual_pointer_to_arguments, entry, new_entry);
-
-            load_param->comment = "load param from stack to temporary";
-            if (mCc_tac_program_add_quad(prog, load_param))
-                return 1;
-
-            fun_def->para->decl[i]->decl_id->symtab_ref->tac_tmp = new_entry;
+            struct mCc_ast_declaration *decl = fun_def->para->decl[i];
+            struct mCc_tac_quad_entry entry = mCc_tac_create_new_entry(prog->ctx);
+            entry.type = mCc_tac_type_from_ast_type(decl->decl_type);
+            entry.array_size = 0; // Array parameters are pointers
+            state->var_count++;
+
+            label_fun_quad->params[i].number = entry.number;
+            label_fun_quad->params[i].type = entry.type;
+            label_fun_quad->params[i].is_array = decl->decl_array_size != NULL;
+
+            mCc_tac_bind_slot(prog->ctx, decl, entry);
         }
     }
-    // if there is an empty body for a void func
-    // add a return stmt at the end
-    if (!fun_def->body && fun_def->func_type == MCC_AST_TYPE_VOID)
-        fun_def->body =
-                mCc_ast_new_statement_compound(mCc_ast_new_statement_return(NULL));
-
-    if (fun_def->body) {
-        tmp_block.label_name = "";
-        if (fun_def->func_type == MCC_AST_TYPE_VOID &&
-            fun_def->body
-                    ->compound_stmts[fun_def->body->compound_stmt_count - 1]
-                    ->type != MCC_AST_STATEMENT_TYPE_RET_VOID) {
-            fun_def->body = mCc_ast_compound_statement_add(
-                    fun_def->body, mCc_ast_new_statement_return(NULL));
-        }
-        if (mCc_tac_from_stmt(prog, fun_def->body)) {
+    state->tmp_block.label_name = "";
+    if (fun_def->body && mCc_tac_from_stmt(prog, fun_def->body))
+        return 1;
+
+    // a void func gets a return stmt at the end, without changing the AST,
+    // which may live in an arena
+    if (fun_def->func_type == MCC_AST_TYPE_VOID &&
+        (!fun_def->body || fun_def->body->compound_stmt_count == 0 ||
+         fun_def->body->compound_stmts[fun_def->body->compound_stmt_count - 1]
+                         ->type != MCC_AST_STATEMENT_TYPE_RET_VOID)) {
+        struct mCc_ast_statement ret = {
+            .type = MCC_AST_STATEMENT_TYPE_RET_VOID,
+            .ret_val = NULL,
+        };
+        if (mCc_tac_from_stmt(prog, &ret))
             return 1;
-        }
     }
-    label_fun_quad->var_count = global_var_count;
-    /* fprintf(stderr, "global_var_count: %s %d\n",
-     * fun_def->identifier->id_value, global_var_count); */
+    label_fun_quad->var_count = state->var_count;
+    label_fun_quad->numbering = prog->ctx->tac_numbering;
+    state->label_base += prog->ctx->tac_numbering.next_label;
+    /* fprintf(stderr, "state->var_count: %s %d\n",
+     * fun_def->identifier->id_value, state->var_count); */
     return 0;
 }
 
@@ -649,7 +720,7 @@ static int mCc_tac_from_stmt(struct mCc_tac_program *prog,
         case MCC_AST_STATEMENT_TYPE_WHILE:
             return mCc_tac_from_statement_while(prog, stmt);
         case MCC_AST_STATEMENT_TYPE_DECL:
-            mCc_tac_entry_from_declaration(stmt->declaration);
+            mCc_tac_entry_from_declaration(prog->ctx, stmt->declaration);
             return 0;
         case MCC_AST_STATEMENT_TYPE_ASSGN:
             return mCc_tac_entry_from_assg(prog, stmt);
@@ -670,6 +741,7 @@ static int mCc_tac_from_stmt(struct mCc_tac_program *prog,
 static struct mCc_tac_quad_entry
 mCc_tac_from_expression(struct mCc_tac_program *prog,
                         struct mCc_ast_expression *exp) {
+    struct mCc_tac_builder_state *state = &prog->ctx->tac_builder;
     assert(prog);
     assert(exp);
     struct mCc_tac_quad_entry entry;
@@ -681,29 +753,29 @@ mCc_tac_from_expression(struct mCc_tac_program *prog,
             if (exp->literal->type != MCC_AST_LITERAL_TYPE_STRING) {
                 struct mCc_tac_quad_literal *lit =
                         mCc_get_quad_literal(exp->literal);
-                entry = mCc_tac_create_new_entry();
+                entry = mCc_tac_create_new_entry(prog->ctx);
                 struct mCc_tac_quad *lit_quad =
                         mCc_tac_quad_new_assign_lit(lit, entry);
-                global_var_count++;
-                lit_quad->cfg_node.number = tmp_block.number;
-                lit_quad->cfg_node.label_name = tmp_block.label_name;
+                state->var_count++;
+                lit_quad->cfg_node.number = state->tmp_block.number;
+                lit_quad->cfg_node.label_name = state->tmp_block.label_name;
                 mCc_tac_program_add_quad(prog, lit_quad);
             } else {
                 struct mCc_tac_quad_literal *lit =
                         mCc_get_quad_literal(exp->literal);
-                entry = mCc_tac_create_new_string();
-                mCc_tac_string_from_assgn(entry, lit);
+                entry = mCc_tac_create_new_string(prog->ctx);
+                mCc_tac_string_from_assgn(prog->ctx, entry, lit);
                 lit->label_num = entry.str_number;
                 struct mCc_tac_quad *lit_quad =
                         mCc_tac_quad_new_assign_lit(lit, entry);
-                global_var_count++;
-                lit_quad->cfg_node.number = tmp_block.number;
-                lit_quad->cfg_node.label_name = tmp_block.label_name;
+                state->var_count++;
+                lit_quad->cfg_node.number = state->tmp_block.number;
+                lit_quad->cfg_node.label_name = state->tmp_block.label_name;
                 mCc_tac_program_add_quad(prog, lit_quad);
             }
             break;
         case MCC_AST_EXPRESSION_TYPE_IDENTIFIER:
-            entry = exp->identifier->symtab_ref->tac_tmp;
+            entry = mCc_get_var_from_id(state, exp->identifier);
             break;
         case MCC_AST_EXPRESSION_TYPE_UNARY_OP:
             entry = mCc_tac_from_expression_unary(prog, exp);
@@ -724,8 +796,37 @@ mCc_tac_from_expression(struct mCc_tac_program *prog,
     return entry;
 }
 
-struct mCc_tac_program *mCc_tac_build(struct mCc_ast_program *prog) {
+/* Start every build from the same state, whatever was built before */
+static void mCc_tac_reset_builder(struct mCc_context *ctx) {
+    struct mCc_tac_builder_state *state = &ctx->tac_builder;
+    mCc_tac_free_global_string_array(ctx);
+    state->var_count = 0;
+    memset(&state->tmp_block, 0, sizeof(state->tmp_block));
+    state->anonym_block_count = 0;
+    state->return_in_else = -1;
+    state->label_base = 0;
+    mCc_tac_reset_numbering(ctx);
+}
+
+/* The program owns its strings from now on */
+static void mCc_tac_hand_over_strings(struct mCc_context *ctx,
+                                      struct mCc_tac_program *tac) {
+    struct mCc_tac_builder_state *state = &ctx->tac_builder;
+    tac->string_literals = state->strings;
+    tac->string_literal_count = state->string_count;
+    state->strings = NULL;
+    state->string_count = 0;
+    state->string_alloc_size = 0;
+}
+
+struct mCc_tac_program *mCc_tac_build(struct mCc_context *ctx,
+                                      struct mCc_ast_program *prog) {
+    mCc_tac_reset_builder(ctx);
+
     struct mCc_tac_program *tac = mCc_tac_program_new(42);
+    if (!tac)
+        return NULL;
+    tac->ctx = ctx;
     tac = mCc_tac_new_cfg(tac, 10);
 
     if (!tac)
@@ -734,15 +835,45 @@ struct mCc_tac_program *mCc_tac_build(struct mCc_ast_program *prog) {
     for (unsigned int i = 0; i < prog->func_def_count; ++i) {
         if (mCc_tac_from_function_def(tac, prog->func_defs[i])) {
             mCc_tac_program_delete(tac);
+            mCc_tac_free_global_string_array(ctx);
             return NULL;
         }
     }
 
-    tac->string_literals = global_string_arr;
-    tac->string_literal_count = global_string_count;
+    mCc_tac_hand_over_strings(ctx, tac);
+    return tac;
+}
+
+struct mCc_tac_program *
+mCc_tac_build_function(struct mCc_context *ctx,
+                       struct mCc_ast_function_def *fun_def) {
+    mCc_tac_reset_builder(ctx);
+
+    struct mCc_tac_program *tac = mCc_tac_program_new(42);
+    if (!tac)
+        return NULL;
+    tac->ctx = ctx;
+    tac = mCc_tac_new_cfg(tac, 10);
+
+    if (!tac)
+        return NULL;
+
+    if (mCc_tac_from_function_def(tac, fun_def)) {
+        mCc_tac_program_delete(tac);
+        mCc_tac_free_global_string_array(ctx);
+        return NULL;
+    }
+    mCc_tac_hand_over_strings(ctx, tac);
     return tac;
 }
 
-void mCc_tac_free_global_string_array() {
-    free(global_string_arr);
+void mCc_tac_free_global_string_array(struct mCc_context *ctx) {
+    struct mCc_tac_builder_state *state = &ctx->tac_builder;
+    free(state->strings);
+    state->strings = NULL;
+    state->string_count = 0;
+    state->string_alloc_size = 0;
+    free(state->slots);
+    state->slots = NULL;
+    state->slot_alloc_size = 0;
 }
@@ -0,0 +1,1952 @@
+/**
+ * @file tac_opt.c
+ * @brief Implementation of the optimisation passes on the three-address code.
+ * @author bennett
+ * @date 2018-06-12
+ */
+#include "mCc/tac_opt.h"
+#include "mCc/context.h"
+
+#include <string.h>
+
+/// Default for #mCc_tac_opt_options.if_convert_max_speculated
+static const unsigned int if_convert_max_speculated = 4;
+/// Default for #mCc_tac_opt_options.loop_rotate_max_cond
+static const unsigned int loop_rotate_max_cond = 8;
+/// Default for #mCc_tac_opt_options.unroll_factor
+static const unsigned int unroll_factor = 4;
+/// Default for #mCc_tac_opt_options.unroll_full_max_trip
+static const unsigned int unroll_full_max_trip = 16;
+/// Default for #mCc_tac_opt_options.unroll_max_size
+static const unsigned int unroll_max_size = 128;
+
+/*********************************** Helpers shared by the passes */
+
+static bool mCc_tac_opt_is_function_label(const struct mCc_tac_quad *quad) {
+    return quad->type == MCC_TAC_QUAD_LABEL && quad->result.label.num == -1;
+}
+
+/// Whether a quad jumps to an anonymous label
+static bool mCc_tac_opt_is_jump(const struct mCc_tac_quad *quad) {
+    return quad->type == MCC_TAC_QUAD_JUMP ||
+           quad->type == MCC_TAC_QUAD_JUMPFALSE ||
+           quad->type == MCC_TAC_QUAD_JUMPTRUE;
+}
+
+/// Whether a quad ends or starts a basic block
+static bool mCc_tac_opt_is_block_boundary(const struct mCc_tac_quad *quad) {
+    return quad->type == MCC_TAC_QUAD_LABEL || mCc_tac_opt_is_jump(quad) ||
+           quad->type == MCC_TAC_QUAD_RETURN ||
+           quad->type == MCC_TAC_QUAD_RETURN_VOID;
+}
+
+/**
+ * @brief Get the temporary written by a quad.
+ *
+ * @return The number of the temporary, or -1 if the quad writes none
+ */
+static int mCc_tac_opt_quad_def(const struct mCc_tac_quad *quad) {
+    switch (quad->type) {
+        case MCC_TAC_QUAD_ASSIGN:
+        case MCC_TAC_QUAD_ASSIGN_LIT:
+        case MCC_TAC_QUAD_OP_UNARY:
+        case MCC_TAC_QUAD_OP_BINARY:
+        case MCC_TAC_QUAD_LOAD:
+        case MCC_TAC_QUAD_SELECT:
+        case MCC_TAC_QUAD_VECTOR_REDUCE:
+            return quad->result.ref.number;
+        case MCC_TAC_QUAD_CALL:
+            return quad->arg1.number;
+        default:
+            return -1;
+    }
+}
+
+/// Whether a quad reads the given temporary
+static bool mCc_tac_opt_quad_reads(const struct mCc_tac_quad *quad,
+                                   int number) {
+    switch (quad->type) {
+        case MCC_TAC_QUAD_ASSIGN:
+        case MCC_TAC_QUAD_OP_UNARY:
+        case MCC_TAC_QUAD_JUMPFALSE:
+        case MCC_TAC_QUAD_JUMPTRUE:
+        case MCC_TAC_QUAD_PARAM:
+        case MCC_TAC_QUAD_RETURN:
+            return quad->arg1.number == number;
+        case MCC_TAC_QUAD_OP_BINARY:
+        case MCC_TAC_QUAD_LOAD:
+            return quad->arg1.number == number || quad->arg2.number == number;
+        case MCC_TAC_QUAD_STORE:
+            return quad->arg1.number == number ||
+                   quad->arg2.number == number ||
+                   quad->result.ref.number == number;
+        case MCC_TAC_QUAD_SELECT:
+            return quad->select_cond == number ||
+                   quad->arg1.number == number || quad->arg2.number == number;
+        case MCC_TAC_QUAD_VECTOR_SPLAT:
+            return quad->arg1.number == number;
+        case MCC_TAC_QUAD_VECTOR_LOAD:
+            return quad->arg1.number == number || quad->arg2.number == number;
+        case MCC_TAC_QUAD_VECTOR_STORE:
+            return quad->arg2.number == number ||
+                   quad->result.ref.number == number;
+        case MCC_TAC_QUAD_VECTOR_REDUCE:
+            return quad->result.ref.number == number;
+        default:
+            return false;
+    }
+}
+
+/// Replace every read of temporary from by temporary to
+static void mCc_tac_opt_rename_reads(struct mCc_tac_quad *quad, int from,
+                                     int to) {
+    switch (quad->type) {
+        case MCC_TAC_QUAD_SELECT:
+            if (quad->select_cond == from)
+                quad->select_cond = to;
+            // fallthrough
+        case MCC_TAC_QUAD_OP_BINARY:
+        case MCC_TAC_QUAD_LOAD:
+            if (quad->arg2.number == from)
+                quad->arg2.number = to;
+            // fallthrough
+        case MCC_TAC_QUAD_ASSIGN:
+        case MCC_TAC_QUAD_OP_UNARY:
+        case MCC_TAC_QUAD_JUMPFALSE:
+        case MCC_TAC_QUAD_JUMPTRUE:
+        case MCC_TAC_QUAD_PARAM:
+        case MCC_TAC_QUAD_RETURN:
+            if (quad->arg1.number == from)
+                quad->arg1.number = to;
+            break;
+        case MCC_TAC_QUAD_STORE:
+            if (quad->arg1.number == from)
+                quad->arg1.number = to;
+            if (quad->arg2.number == from)
+                quad->arg2.number = to;
+            if (quad->result.ref.number == from)
+                quad->result.ref.number = to;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Find the function containing a quad.
+ *
+ * @param prog The program
+ * @param pos Position of the quad
+ * @param begin Set to the position of the function label
+ * @param end Set to the position after the last quad of the function
+ */
+static void mCc_tac_opt_function_bounds(const struct mCc_tac_program *prog,
+                                        unsigned int pos, unsigned int *begin,
+                                        unsigned int *end) {
+    *begin = pos;
+    while (*begin > 0 && !mCc_tac_opt_is_function_label(prog->quads[*begin]))
+        --*begin;
+    *end = pos + 1;
+    while (*end < prog->quad_count &&
+           !mCc_tac_opt_is_function_label(prog->quads[*end]))
+        ++*end;
+}
+
+/// Count the jumps to an anonymous label
+static unsigned int mCc_tac_opt_label_refs(const struct mCc_tac_program *prog,
+                                           int label_num) {
+    unsigned int refs = 0;
+    for (unsigned int i = 0; i < prog->quad_count; ++i) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        if (mCc_tac_opt_is_jump(quad) && quad->result.label.num == label_num)
+            ++refs;
+    }
+    return refs;
+}
+
+/**
+ * @brief Replace the quad pointers in [begin, end) by new ones.
+ *
+ * The old quads are neither deleted nor otherwise touched, the caller has to
+ * reuse or delete them.
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+static int mCc_tac_opt_replace_range(struct mCc_tac_program *prog,
+                                     unsigned int begin, unsigned int end,
+                                     struct mCc_tac_quad **quads,
+                                     unsigned int count) {
+    unsigned int new_count = prog->quad_count - (end - begin) + count;
+    if (new_count > prog->quad_alloc_size) {
+        unsigned int new_alloc_size = new_count + quad_alloc_block_size;
+        struct mCc_tac_quad **tmp =
+                realloc(prog->quads, new_alloc_size * sizeof(*tmp));
+        if (!tmp)
+            return 1;
+        prog->quads = tmp;
+        prog->quad_alloc_size = new_alloc_size;
+    }
+    memmove(prog->quads + begin + count, prog->quads + end,
+            (prog->quad_count - end) * sizeof(*prog->quads));
+    memcpy(prog->quads + begin, quads, count * sizeof(*quads));
+    prog->quad_count = new_count;
+    return 0;
+}
+
+/// A pass over a program holding a single function
+typedef int (*mCc_tac_opt_pass)(struct mCc_tac_program *prog,
+                                const struct mCc_tac_opt_options *options);
+
+/**
+ * @brief Run a pass on every function of a program on its own.
+ *
+ * Temporaries and labels are numbered from 0 in every function, so a pass
+ * must only see one function and continue the numbering stored in its label.
+ *
+ * @return The sum of the results of the pass, or -1 on memory error
+ */
+static int
+mCc_tac_opt_each_function(struct mCc_tac_program *prog, mCc_tac_opt_pass pass,
+                          const struct mCc_tac_opt_options *options) {
+    struct mCc_context *ctx = prog->ctx;
+    struct mCc_tac_numbering numbering = ctx->tac_numbering;
+    int result = 0;
+    unsigned int begin = 0;
+    while (begin < prog->quad_count) {
+        unsigned int fun_begin, fun_end;
+        mCc_tac_opt_function_bounds(prog, begin, &fun_begin, &fun_end);
+        struct mCc_tac_quad *label = prog->quads[fun_begin];
+        struct mCc_tac_program fun = *prog;
+        fun.quad_count = fun_end - fun_begin;
+        fun.quad_alloc_size = fun.quad_count;
+        fun.quads = malloc(fun.quad_count * sizeof(*fun.quads));
+        if (!fun.quads) {
+            result = -1;
+            break;
+        }
+        memcpy(fun.quads, prog->quads + fun_begin,
+               fun.quad_count * sizeof(*fun.quads));
+
+        if (mCc_tac_opt_is_function_label(label))
+            ctx->tac_numbering = label->numbering;
+        int ret = pass(&fun, options);
+        if (fun.quad_count && mCc_tac_opt_is_function_label(fun.quads[0]))
+            fun.quads[0]->numbering = ctx->tac_numbering;
+
+        if (mCc_tac_opt_replace_range(prog, fun_begin, fun_end, fun.quads,
+                                      fun.quad_count)) {
+            // Keep the program consistent, without the function
+            for (unsigned int i = 0; i < fun.quad_count; ++i)
+                mCc_tac_quad_delete(fun.quads[i]);
+            mCc_tac_opt_replace_range(prog, fun_begin, fun_end, NULL, 0);
+            ret = -1;
+        }
+        free(fun.quads);
+        if (ret < 0) {
+            result = -1;
+            break;
+        }
+        result += ret;
+        begin = fun_begin + fun.quad_count;
+    }
+    ctx->tac_numbering = numbering;
+    return result;
+}
+
+/*********************************** If-conversion */
+
+/// A temporary written in a branch and the fresh one replacing it
+struct mCc_tac_opt_rename {
+    int from;
+    int to;
+    const struct mCc_tac_quad *def; ///< The last quad writing it
+};
+
+/// Whether a quad may be executed on a path where it was not before
+static bool mCc_tac_opt_is_speculatable(const struct mCc_tac_quad *quad) {
+    switch (quad->type) {
+        case MCC_TAC_QUAD_ASSIGN:
+        case MCC_TAC_QUAD_ASSIGN_LIT:
+        case MCC_TAC_QUAD_SELECT:
+        case MCC_TAC_QUAD_LOAD: // See mCc_tac_opt_load_is_safe
+            return true;
+        case MCC_TAC_QUAD_OP_BINARY:
+            return quad->bin_op != MCC_TAC_OP_BINARY_DIV; // May trap
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Check whether a load can be speculated above a branch.
+ *
+ * That is the case if the same element is loaded unconditionally in the
+ * block ending with the branch, since its address is known to be valid then.
+ */
+static bool mCc_tac_opt_load_is_safe(const struct mCc_tac_program *prog,
+                                     unsigned int branch,
+                                     const struct mCc_tac_quad *load) {
+    for (unsigned int i = branch; i-- > 0;) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        if (mCc_tac_opt_is_block_boundary(quad))
+            return false;
+        if (quad->type == MCC_TAC_QUAD_LOAD &&
+            quad->arg1.number == load->arg1.number &&
+            quad->arg2.number == load->arg2.number)
+            return true;
+        if (mCc_tac_opt_quad_def(quad) == load->arg2.number)
+            return false;
+    }
+    return false;
+}
+
+/// Find the end of the speculatable quads starting at begin
+static unsigned int mCc_tac_opt_branch_end(const struct mCc_tac_program *prog,
+                                           unsigned int begin) {
+    while (begin < prog->quad_count &&
+           mCc_tac_opt_is_speculatable(prog->quads[begin]))
+        ++begin;
+    return begin;
+}
+
+/// Check the branch [begin, end) guarded by the jumpfalse at branch
+static bool mCc_tac_opt_branch_is_safe(const struct mCc_tac_program *prog,
+                                       unsigned int branch, unsigned int begin,
+                                       unsigned int end) {
+    int cond = prog->quads[branch]->arg1.number;
+    for (unsigned int i = begin; i < end; ++i) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        // The selects need the original condition
+        if (mCc_tac_opt_quad_def(quad) == cond)
+            return false;
+        if (quad->type != MCC_TAC_QUAD_LOAD)
+            continue;
+        for (unsigned int j = begin; j < i; ++j)
+            if (mCc_tac_opt_quad_def(prog->quads[j]) == quad->arg2.number)
+                return false;
+        if (!mCc_tac_opt_load_is_safe(prog, branch, quad))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Make the branch [begin, end) write fresh temporaries only.
+ *
+ * @return The number of entries added to map
+ */
+static unsigned int mCc_tac_opt_rename_branch(struct mCc_tac_program *prog,
+                                              unsigned int begin,
+                                              unsigned int end,
+                                              struct mCc_tac_opt_rename *map) {
+    unsigned int count = 0;
+    for (unsigned int i = begin; i < end; ++i) {
+        struct mCc_tac_quad *quad = prog->quads[i];
+        for (unsigned int m = 0; m < count; ++m)
+            mCc_tac_opt_rename_reads(quad, map[m].from, map[m].to);
+
+        int from = quad->result.ref.number;
+        quad->result.ref.number = mCc_tac_create_new_entry(prog->ctx).number;
+
+        unsigned int m = 0;
+        while (m < count && map[m].from != from)
+            ++m;
+        if (m == count)
+            ++count;
+        map[m].from = from;
+        map[m].to = quad->result.ref.number;
+        map[m].def = quad;
+    }
+    return count;
+}
+
+/// Look up the fresh temporary for from, or from itself if not renamed
+static int mCc_tac_opt_renamed(const struct mCc_tac_opt_rename *map,
+                               unsigned int count, int from) {
+    for (unsigned int m = 0; m < count; ++m)
+        if (map[m].from == from)
+            return map[m].to;
+    return from;
+}
+
+/// Whether a temporary is read in the function outside of [begin, end)
+static bool mCc_tac_opt_read_outside(const struct mCc_tac_program *prog,
+                                     unsigned int fun_begin,
+                                     unsigned int fun_end, unsigned int begin,
+                                     unsigned int end, int number) {
+    for (unsigned int i = fun_begin; i < fun_end; ++i) {
+        if (i == begin)
+            i = end;
+        if (i < fun_end && mCc_tac_opt_quad_reads(prog->quads[i], number))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Try to if-convert the if whose condition is checked at branch.
+ *
+ * @return 1 if converted, 0 if not, -1 on memory error
+ */
+static int mCc_tac_opt_try_if_convert(struct mCc_tac_program *prog,
+                                      unsigned int branch,
+                                      unsigned int max_speculated) {
+    struct mCc_tac_quad *guard = prog->quads[branch];
+
+    // Triangle:  jumpfalse c L1; then; L1:
+    // Diamond:   jumpfalse c L1; then; jump L2; L1: else; L2:
+    unsigned int then_begin = branch + 1;
+    unsigned int then_end = mCc_tac_opt_branch_end(prog, then_begin);
+    unsigned int else_begin = then_end;
+    unsigned int else_end = then_end;
+    if (then_end >= prog->quad_count)
+        return 0;
+
+    struct mCc_tac_quad *after_then = prog->quads[then_end];
+    if (after_then->type == MCC_TAC_QUAD_JUMP &&
+        then_end + 1 < prog->quad_count &&
+        prog->quads[then_end + 1]->type == MCC_TAC_QUAD_LABEL &&
+        prog->quads[then_end + 1]->result.label.num ==
+                guard->result.label.num) {
+        else_begin = then_end + 2;
+        else_end = mCc_tac_opt_branch_end(prog, else_begin);
+        if (else_end >= prog->quad_count ||
+            prog->quads[else_end]->type != MCC_TAC_QUAD_LABEL ||
+            prog->quads[else_end]->result.label.num !=
+                    after_then->result.label.num ||
+            mCc_tac_opt_label_refs(prog, after_then->result.label.num) != 1)
+            return 0;
+    } else if (after_then->type != MCC_TAC_QUAD_LABEL ||
+               after_then->result.label.num != guard->result.label.num) {
+        return 0;
+    }
+    unsigned int region_end = else_end + 1;
+
+    // Profitability: both branches are executed on every path
+    unsigned int then_count = then_end - then_begin;
+    unsigned int else_count = else_end - else_begin;
+    if (then_count + else_count > max_speculated)
+        return 0;
+
+    if (mCc_tac_opt_label_refs(prog, guard->result.label.num) != 1 ||
+        !mCc_tac_opt_branch_is_safe(prog, branch, then_begin, then_end) ||
+        !mCc_tac_opt_branch_is_safe(prog, branch, else_begin, else_end))
+        return 0;
+
+    struct mCc_tac_opt_rename *map =
+            malloc((then_count + else_count + 1) * sizeof(*map));
+    struct mCc_tac_quad **quads =
+            malloc(2 * (then_count + else_count + 1) * sizeof(*quads));
+    if (!map || !quads) {
+        free(map);
+        free(quads);
+        return -1;
+    }
+    unsigned int then_renamed =
+            mCc_tac_opt_rename_branch(prog, then_begin, then_end, map);
+    unsigned int else_renamed = mCc_tac_opt_rename_branch(
+            prog, else_begin, else_end, map + then_renamed);
+
+    unsigned int fun_begin, fun_end;
+    mCc_tac_opt_function_bounds(prog, branch, &fun_begin, &fun_end);
+
+    // The speculated branches, followed by one select per live variable
+    unsigned int count = 0;
+    for (unsigned int i = then_begin; i < then_end; ++i)
+        quads[count++] = prog->quads[i];
+    for (unsigned int i = else_begin; i < else_end; ++i)
+        quads[count++] = prog->quads[i];
+
+    unsigned int branch_count = count;
+    for (unsigned int m = 0; m < then_renamed + else_renamed; ++m) {
+        int var = map[m].from;
+        // Variables written in both branches are handled by the then part
+        if (m >= then_renamed &&
+            mCc_tac_opt_renamed(map, then_renamed, var) != var)
+            continue;
+        if (!mCc_tac_opt_read_outside(prog, fun_begin, fun_end, branch,
+                                      region_end, var))
+            continue;
+
+        struct mCc_tac_quad_entry result = map[m].def->result.ref;
+        struct mCc_tac_quad_entry if_true = result;
+        struct mCc_tac_quad_entry if_false = result;
+        result.number = var;
+        if_true.number = mCc_tac_opt_renamed(map, then_renamed, var);
+        if_false.number = mCc_tac_opt_renamed(map + then_renamed,
+                                              else_renamed, var);
+
+        struct mCc_tac_quad *select =
+                mCc_tac_quad_new_select(guard->arg1, if_true, if_false, result);
+        if (!select) {
+            for (unsigned int i = branch_count; i < count; ++i)
+                mCc_tac_quad_delete(quads[i]);
+            free(map);
+            free(quads);
+            return -1;
+        }
+        select->cfg_node = guard->cfg_node;
+        quads[count++] = select;
+    }
+    if (count > branch_count)
+        quads[branch_count]->comment = "If-converted branch";
+
+    // Reserve stack slots for the fresh temporaries
+    prog->quads[fun_begin]->var_count += then_renamed + else_renamed;
+
+    struct mCc_tac_quad *dropped[] = {guard, after_then,
+                                      prog->quads[else_begin - 1],
+                                      prog->quads[else_end]};
+    unsigned int dropped_count = else_begin == then_end ? 2 : 4;
+    if (mCc_tac_opt_replace_range(prog, branch, region_end, quads, count)) {
+        free(map);
+        free(quads);
+        return -1;
+    }
+    for (unsigned int i = 0; i < dropped_count; ++i)
+        mCc_tac_quad_delete(dropped[i]);
+
+    free(map);
+    free(quads);
+    return 1;
+}
+
+static int
+mCc_tac_opt_if_convert_function(struct mCc_tac_program *prog,
+                                const struct mCc_tac_opt_options *options) {
+    unsigned int max_speculated = options->if_convert_max_speculated;
+    int converted = 0;
+    bool changed = true;
+    // Repeat, since converting an inner if may make the outer one convertible
+    while (changed) {
+        changed = false;
+        for (unsigned int i = 0; i < prog->quad_count; ++i) {
+            if (prog->quads[i]->type != MCC_TAC_QUAD_JUMPFALSE)
+                continue;
+            int ret = mCc_tac_opt_try_if_convert(prog, i, max_speculated);
+            if (ret < 0)
+                return -1;
+            if (ret) {
+                ++converted;
+                changed = true;
+            }
+        }
+    }
+    return converted;
+}
+
+/*********************************** Counted loops */
+
+/// A counted while loop in the top-tested form of the TAC builder
+struct mCc_tac_opt_loop {
+    unsigned int header; ///< Position of the label starting the condition
+    unsigned int guard;  ///< Position of the jumpfalse leaving the loop
+    unsigned int latch;  ///< Position of the jump back to the header
+
+    int iv;                ///< The induction variable
+    int step;              ///< Added to iv once per iteration
+    unsigned int step_pos; ///< Position of the quad updating iv
+    int cond;              ///< Temporary with the result of the comparison
+    int bound;             ///< Temporary the induction variable is compared to
+    enum mCc_tac_quad_binary_op cmp; ///< Normalised to iv cmp bound
+
+    bool bound_const; ///< Whether bound_value is known
+    int bound_value;
+    bool init_const; ///< Whether init_value is known
+    int init_value;  ///< Value of iv on entry
+};
+
+/// Whether a quad modifies the given temporary
+static bool mCc_tac_opt_quad_writes(const struct mCc_tac_quad *quad,
+                                    int number) {
+    // Unary operators are computed in place on their operand
+    return mCc_tac_opt_quad_def(quad) == number ||
+           (quad->type == MCC_TAC_QUAD_OP_UNARY && quad->arg1.number == number);
+}
+
+/**
+ * @brief Find the int value of a temporary at pos.
+ *
+ * Only the straight-line code before pos is considered, through copies.
+ *
+ * @return Whether the value is known
+ */
+static bool mCc_tac_opt_entry_value(const struct mCc_tac_program *prog,
+                                    unsigned int pos, int number, int *value) {
+    for (unsigned int i = pos; i-- > 0;) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        if (mCc_tac_opt_is_block_boundary(quad))
+            return false;
+        if (!mCc_tac_opt_quad_writes(quad, number))
+            continue;
+        if (quad->type == MCC_TAC_QUAD_ASSIGN)
+            return mCc_tac_opt_entry_value(prog, i, quad->arg1.number, value);
+        if (quad->type != MCC_TAC_QUAD_ASSIGN_LIT ||
+            quad->literal->type != MCC_TAC_QUAD_LIT_INT)
+            return false;
+        *value = quad->literal->ival;
+        return true;
+    }
+    return false;
+}
+
+/// Mirror a comparison, so that a cmp b == b cmp' a
+static bool mCc_tac_opt_mirror_cmp(enum mCc_tac_quad_binary_op *cmp) {
+    switch (*cmp) {
+        case MCC_TAC_OP_BINARY_LT:
+            *cmp = MCC_TAC_OP_BINARY_GT;
+            return true;
+        case MCC_TAC_OP_BINARY_GT:
+            *cmp = MCC_TAC_OP_BINARY_LT;
+            return true;
+        case MCC_TAC_OP_BINARY_LEQ:
+            *cmp = MCC_TAC_OP_BINARY_GEQ;
+            return true;
+        case MCC_TAC_OP_BINARY_GEQ:
+            *cmp = MCC_TAC_OP_BINARY_LEQ;
+            return true;
+        case MCC_TAC_OP_BINARY_NEQ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Evaluate iv cmp bound
+static bool mCc_tac_opt_eval_cmp(enum mCc_tac_quad_binary_op cmp, long iv,
+                                 long bound) {
+    switch (cmp) {
+        case MCC_TAC_OP_BINARY_LT:
+            return iv < bound;
+        case MCC_TAC_OP_BINARY_GT:
+            return iv > bound;
+        case MCC_TAC_OP_BINARY_LEQ:
+            return iv <= bound;
+        case MCC_TAC_OP_BINARY_GEQ:
+            return iv >= bound;
+        case MCC_TAC_OP_BINARY_NEQ:
+            return iv != bound;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Recognise a counted loop starting at header.
+ *
+ * The loop must be innermost and single-entry, its condition must compare an
+ * induction variable to a loop-invariant bound without side effects, and the
+ * induction variable must be updated by a constant step exactly once, in the
+ * last block of the body.
+ *
+ * @return Whether loop was filled in
+ */
+static bool mCc_tac_opt_find_counted_loop(const struct mCc_tac_program *prog,
+                                          unsigned int header,
+                                          struct mCc_tac_opt_loop *loop) {
+    const struct mCc_tac_quad *label = prog->quads[header];
+    if (label->type != MCC_TAC_QUAD_LABEL || label->result.label.num < 0)
+        return false;
+    loop->header = header;
+
+    // Condition: side-effect-free straight-line code, then the guard
+    unsigned int guard = header + 1;
+    while (guard < prog->quad_count &&
+           mCc_tac_opt_is_speculatable(prog->quads[guard]))
+        ++guard;
+    if (guard >= prog->quad_count ||
+        prog->quads[guard]->type != MCC_TAC_QUAD_JUMPFALSE)
+        return false;
+    loop->guard = guard;
+    int exit_num = prog->quads[guard]->result.label.num;
+
+    // Body up to the back edge, with no nested loops or side entries
+    unsigned int latch = guard + 1;
+    for (; latch < prog->quad_count; ++latch) {
+        const struct mCc_tac_quad *quad = prog->quads[latch];
+        if (mCc_tac_opt_is_function_label(quad))
+            return false;
+        if (quad->type == MCC_TAC_QUAD_JUMP &&
+            quad->result.label.num == label->result.label.num)
+            break;
+    }
+    if (latch + 1 >= prog->quad_count ||
+        prog->quads[latch + 1]->type != MCC_TAC_QUAD_LABEL ||
+        prog->quads[latch + 1]->result.label.num != exit_num ||
+        mCc_tac_opt_label_refs(prog, label->result.label.num) != 1)
+        return false;
+    for (unsigned int i = header + 1; i <= latch; ++i) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        if (quad->type != MCC_TAC_QUAD_LABEL)
+            continue;
+        unsigned int inner_refs = 0;
+        for (unsigned int j = header; j <= latch; ++j) {
+            if (!mCc_tac_opt_is_jump(prog->quads[j]) ||
+                prog->quads[j]->result.label.num != quad->result.label.num)
+                continue;
+            if (j > i)
+                return false; // back edge of a nested loop
+            ++inner_refs;
+        }
+        if (inner_refs != mCc_tac_opt_label_refs(prog, quad->result.label.num))
+            return false;
+    }
+    loop->latch = latch;
+
+    // Comparison of the induction variable with the bound
+    const struct mCc_tac_quad *cmp = prog->quads[guard - 1];
+    enum mCc_tac_quad_binary_op mirrored = cmp->bin_op;
+    if (guard - 1 <= header || cmp->type != MCC_TAC_QUAD_OP_BINARY ||
+        cmp->result.ref.number != prog->quads[guard]->arg1.number ||
+        !mCc_tac_opt_mirror_cmp(&mirrored))
+        return false;
+    loop->cond = cmp->result.ref.number;
+    loop->cmp = cmp->bin_op;
+    loop->iv = cmp->arg1.number;
+    loop->bound = cmp->arg2.number;
+    for (unsigned int i = guard + 1; i < latch; ++i) {
+        if (mCc_tac_opt_quad_writes(prog->quads[i], loop->bound)) {
+            loop->iv = cmp->arg2.number;
+            loop->bound = cmp->arg1.number;
+            loop->cmp = mirrored;
+            break;
+        }
+    }
+
+    // The bound is invariant and the induction variable has a single update
+    loop->step_pos = 0;
+    for (unsigned int i = guard + 1; i < latch; ++i) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        if (mCc_tac_opt_quad_writes(quad, loop->bound))
+            return false;
+        if (!mCc_tac_opt_quad_writes(quad, loop->iv))
+            continue;
+        if (loop->step_pos || quad->type != MCC_TAC_QUAD_ASSIGN)
+            return false;
+        loop->step_pos = i;
+    }
+    if (!loop->step_pos)
+        return false;
+    for (unsigned int i = header + 1; i < guard; ++i)
+        if (mCc_tac_opt_quad_writes(prog->quads[i], loop->iv))
+            return false;
+    for (unsigned int i = loop->step_pos; i < latch; ++i)
+        if (mCc_tac_opt_is_block_boundary(prog->quads[i]))
+            return false;
+
+    // iv = t;  with  t = iv + c,  t = c + iv  or  t = iv - c
+    int sum = prog->quads[loop->step_pos]->arg1.number;
+    const struct mCc_tac_quad *add = NULL;
+    unsigned int add_pos = loop->step_pos;
+    while (add_pos-- > guard + 1) {
+        if (mCc_tac_opt_quad_writes(prog->quads[add_pos], sum)) {
+            add = prog->quads[add_pos];
+            break;
+        }
+    }
+    if (!add || add->type != MCC_TAC_QUAD_OP_BINARY)
+        return false;
+    for (unsigned int i = add_pos; i < loop->step_pos; ++i)
+        if (mCc_tac_opt_is_block_boundary(prog->quads[i]))
+            return false;
+    int step_tmp;
+    if (add->bin_op == MCC_TAC_OP_BINARY_ADD && add->arg1.number == loop->iv)
+        step_tmp = add->arg2.number;
+    else if (add->bin_op == MCC_TAC_OP_BINARY_ADD &&
+             add->arg2.number == loop->iv)
+        step_tmp = add->arg1.number;
+    else if (add->bin_op == MCC_TAC_OP_BINARY_SUB &&
+             add->arg1.number == loop->iv)
+        step_tmp = add->arg2.number;
+    else
+        return false;
+    if (!mCc_tac_opt_entry_value(prog, add_pos, step_tmp, &loop->step) ||
+        !loop->step)
+        return false;
+    if (add->bin_op == MCC_TAC_OP_BINARY_SUB)
+        loop->step = -loop->step;
+
+    // Values on entry, if known
+    bool bound_in_cond = false;
+    for (unsigned int i = header + 1; i < guard; ++i)
+        bound_in_cond |= mCc_tac_opt_quad_writes(prog->quads[i], loop->bound);
+    loop->bound_const = mCc_tac_opt_entry_value(
+            prog, bound_in_cond ? guard - 1 : header, loop->bound,
+            &loop->bound_value);
+    loop->init_const =
+            mCc_tac_opt_entry_value(prog, header, loop->iv, &loop->init_value);
+    return true;
+}
+
+/**
+ * @brief Compute the trip count of a counted loop.
+ *
+ * @return The trip count, or -1 if it is unknown or larger than limit
+ */
+static long mCc_tac_opt_trip_count(const struct mCc_tac_opt_loop *loop,
+                                   long limit) {
+    if (!loop->init_const || !loop->bound_const)
+        return -1;
+    long iv = loop->init_value;
+    long trips = 0;
+    while (mCc_tac_opt_eval_cmp(loop->cmp, iv, loop->bound_value)) {
+        if (++trips > limit)
+            return -1;
+        iv += loop->step;
+    }
+    return trips;
+}
+
+/*********************************** Loop unrolling */
+
+/**
+ * @brief Append copies of the quads in [begin, end) to quads.
+ *
+ * Labels inside the range are replaced by fresh ones in every copy.
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+static int mCc_tac_opt_copy_range(const struct mCc_tac_program *prog,
+                                  unsigned int begin, unsigned int end,
+                                  unsigned int copies,
+                                  struct mCc_tac_quad **quads,
+                                  unsigned int *count) {
+    for (unsigned int c = 0; c < copies; ++c) {
+        unsigned int copy_begin = *count;
+        for (unsigned int i = begin; i < end; ++i) {
+            if (!(quads[*count] = mCc_tac_quad_copy(prog->quads[i])))
+                return 1;
+            ++*count;
+        }
+        for (unsigned int i = copy_begin; i < *count; ++i) {
+            if (quads[i]->type != MCC_TAC_QUAD_LABEL)
+                continue;
+            int old_num = quads[i]->result.label.num;
+            int new_num = mCc_tac_get_new_label(prog->ctx).num;
+            for (unsigned int j = copy_begin; j < *count; ++j)
+                if ((quads[j]->type == MCC_TAC_QUAD_LABEL ||
+                     mCc_tac_opt_is_jump(quads[j])) &&
+                    quads[j]->result.label.num == old_num)
+                    quads[j]->result.label.num = new_num;
+        }
+    }
+    return 0;
+}
+
+/// Create an int literal quad for a fresh temporary
+static struct mCc_tac_quad *
+mCc_tac_opt_new_int_lit(struct mCc_context *ctx, int value,
+                        struct mCc_tac_quad_entry *result) {
+    struct mCc_tac_quad_literal *lit = malloc(sizeof(*lit));
+    if (!lit)
+        return NULL;
+    lit->type = MCC_TAC_QUAD_LIT_INT;
+    lit->ival = value;
+    *result = mCc_tac_create_new_entry(ctx);
+    result->type = MCC_TAC_QUAD_LIT_INT;
+    struct mCc_tac_quad *quad = mCc_tac_quad_new_assign_lit(lit, *result);
+    if (!quad)
+        free(lit);
+    return quad;
+}
+
+/**
+ * @brief Build the header of a partially unrolled loop.
+ *
+ *   Lu: cond; t1 = (factor - 1) * step; t2 = iv + t1; t3 = t2 cmp bound;
+ *       jumpfalse t3 Lc
+ *
+ * so that the unrolled body is only entered if all of its iterations run.
+ *
+ * @return 0 on success, non-zero on memory error
+ */
+static int mCc_tac_opt_unrolled_header(const struct mCc_tac_program *prog,
+                                       const struct mCc_tac_opt_loop *loop,
+                                       unsigned int factor,
+                                       struct mCc_tac_label label_unrolled,
+                                       char *comment,
+                                       struct mCc_tac_quad **quads,
+                                       unsigned int *count) {
+    const struct mCc_tac_quad *cmp = prog->quads[loop->guard - 1];
+    struct mCc_tac_quad *label = mCc_tac_quad_new_label(label_unrolled);
+    if (!label)
+        return 1;
+    label->comment = comment;
+    label->cfg_node = prog->quads[loop->header]->cfg_node;
+    quads[(*count)++] = label;
+
+    // Recompute the bound, if it is defined in the condition
+    for (unsigned int i = loop->header + 1; i < loop->guard - 1; ++i)
+        if (!(quads[(*count)++] = mCc_tac_quad_copy(prog->quads[i])))
+            return 1;
+
+    struct mCc_tac_quad_entry offset, last, cond;
+    if (!(quads[*count] = mCc_tac_opt_new_int_lit(prog->ctx,
+                                                  (int)(factor - 1) *
+                                                          loop->step,
+                                                  &offset)))
+        return 1;
+    ++*count;
+
+    struct mCc_tac_quad_entry iv = cmp->arg1;
+    iv.number = loop->iv;
+    last = mCc_tac_create_new_entry(prog->ctx);
+    last.type = MCC_TAC_QUAD_LIT_INT;
+    if (!(quads[*count] = mCc_tac_quad_new_op_binary(MCC_TAC_OP_BINARY_ADD,
+                                                     iv, offset, last)))
+        return 1;
+    ++*count;
+
+    struct mCc_tac_quad_entry bound = cmp->arg2;
+    bound.number = loop->bound;
+    cond = mCc_tac_create_new_entry(prog->ctx);
+    cond.type = MCC_TAC_QUAD_LIT_BOOL;
+    if (!(quads[*count] =
+                  mCc_tac_quad_new_op_binary(loop->cmp, last, bound, cond)))
+        return 1;
+    ++*count;
+    return 0;
+}
+
+/**
+ * @brief Try to unroll the counted loop starting at header.
+ *
+ * @param consumed Set to the number of quads replacing the loop
+ *
+ * @return 1 if unrolled, 0 if not, -1 on memory error
+ */
+static int mCc_tac_opt_try_unroll_loop(struct mCc_tac_program *prog,
+                                       unsigned int header,
+                                       const struct mCc_tac_opt_options *options,
+                                       unsigned int *consumed) {
+    struct mCc_tac_opt_loop loop;
+    if (!mCc_tac_opt_find_counted_loop(prog, header, &loop))
+        return 0;
+
+    unsigned int body_begin = loop.guard + 1;
+    unsigned int body_size = loop.latch - body_begin;
+    unsigned int fun_begin, fun_end;
+    mCc_tac_opt_function_bounds(prog, header, &fun_begin, &fun_end);
+
+    long trips = mCc_tac_opt_trip_count(&loop, options->unroll_full_max_trip);
+    bool full = trips >= 0 &&
+                (unsigned long)trips * body_size <= options->unroll_max_size;
+    bool partial = !full && options->unroll_factor > 1 &&
+                   options->unroll_factor * body_size <=
+                           options->unroll_max_size &&
+                   (((loop.cmp == MCC_TAC_OP_BINARY_LT ||
+                      loop.cmp == MCC_TAC_OP_BINARY_LEQ) &&
+                     loop.step > 0) ||
+                    ((loop.cmp == MCC_TAC_OP_BINARY_GT ||
+                      loop.cmp == MCC_TAC_OP_BINARY_GEQ) &&
+                     loop.step < 0));
+    if (!full && !partial)
+        return 0;
+    // Don't bother for loops that run at most factor times anyway
+    if (partial && ((trips >= 0 && trips <= (long)options->unroll_factor) ||
+                    prog->quads[header]->remainder_loop))
+        return 0;
+
+    unsigned int alloc = full ? trips * body_size + 1
+                              : options->unroll_factor * body_size +
+                                        (loop.guard - header) + 6;
+    struct mCc_tac_quad **quads = malloc(alloc * sizeof(*quads));
+    if (!quads)
+        return -1;
+    unsigned int count = 0;
+    int ret = 0;
+
+    if (full) {
+        // Only the bodies remain, the condition is known for each iteration
+        ret = mCc_tac_opt_copy_range(prog, body_begin, loop.latch, trips,
+                                     quads, &count);
+    } else {
+        // Unrolled loop, followed by the original loop for the remainder
+        struct mCc_tac_label label_unrolled = mCc_tac_get_new_label(prog->ctx);
+        struct mCc_tac_quad *guard = NULL, *back = NULL;
+        ret = mCc_tac_opt_unrolled_header(prog, &loop, options->unroll_factor,
+                                          label_unrolled, "Unrolled loop",
+                                          quads, &count);
+        if (!ret) {
+            guard = mCc_tac_quad_new_jumpfalse(
+                    quads[count - 1]->result.ref,
+                    prog->quads[header]->result.label);
+            ret = !guard;
+        }
+        if (!ret) {
+            guard->comment = "Leave for the remainder loop";
+            quads[count++] = guard;
+            ret = mCc_tac_opt_copy_range(prog, body_begin, loop.latch,
+                                         options->unroll_factor, quads, &count);
+        }
+        if (!ret) {
+            back = mCc_tac_quad_new_jump(label_unrolled);
+            ret = !back;
+        }
+        if (!ret) {
+            quads[count++] = back;
+            // New temporaries of the header
+            prog->quads[fun_begin]->var_count += 3;
+        }
+    }
+    if (ret) {
+        for (unsigned int i = 0; i < count; ++i)
+            mCc_tac_quad_delete(quads[i]);
+        free(quads);
+        return -1;
+    }
+
+    if (full) {
+        struct mCc_tac_quad **old = prog->quads + header;
+        unsigned int old_count = loop.latch + 1 - header;
+        struct mCc_tac_quad **dropped = malloc(old_count * sizeof(*dropped));
+        if (!dropped ||
+            (memcpy(dropped, old, old_count * sizeof(*dropped)),
+             mCc_tac_opt_replace_range(prog, header, loop.latch + 1, quads,
+                                       count))) {
+            free(dropped);
+            for (unsigned int i = 0; i < count; ++i)
+                mCc_tac_quad_delete(quads[i]);
+            free(quads);
+            return -1;
+        }
+        for (unsigned int i = 0; i < old_count; ++i)
+            mCc_tac_quad_delete(dropped[i]);
+        free(dropped);
+        *consumed = count;
+    } else {
+        if (mCc_tac_opt_replace_range(prog, header, header, quads, count)) {
+            for (unsigned int i = 0; i < count; ++i)
+                mCc_tac_quad_delete(quads[i]);
+            free(quads);
+            return -1;
+        }
+        prog->quads[header + count]->remainder_loop = true;
+        *consumed = count + loop.latch + 1 - header;
+    }
+    free(quads);
+    return 1;
+}
+
+static int
+mCc_tac_opt_unroll_loops_function(struct mCc_tac_program *prog,
+                                  const struct mCc_tac_opt_options *options) {
+    int unrolled = 0;
+    for (unsigned int i = 0; i < prog->quad_count; ++i) {
+        unsigned int consumed = 0;
+        int ret = mCc_tac_opt_try_unroll_loop(prog, i, options, &consumed);
+        if (ret < 0)
+            return -1;
+        if (ret) {
+            ++unrolled;
+            i += consumed - 1;
+        }
+    }
+    return unrolled;
+}
+
+/*********************************** Loop vectorization */
+
+/// How the lanes of a value in a vectorized loop body differ
+enum mCc_tac_opt_lanes {
+    MCC_TAC_OPT_LANES_INVARIANT, ///< The same scalar in every lane
+    MCC_TAC_OPT_LANES_INDEX,     ///< The induction variable plus a constant
+    MCC_TAC_OPT_LANES_VECTOR,    ///< One value per lane, in a vector register
+};
+
+/// A temporary of a vectorized loop body
+struct mCc_tac_opt_lane_value {
+    int number;
+    enum mCc_tac_opt_lanes lanes;
+    int offset; ///< Only for indices
+    int reg;    ///< Only for vectors
+};
+
+/// An array access of a vectorized loop body
+struct mCc_tac_opt_access {
+    int array;
+    int offset; ///< Index relative to the induction variable
+    bool store;
+    bool param; ///< Parameters may point to the same array
+};
+
+/// State of the vectorization of a single loop
+struct mCc_tac_opt_vectorizer {
+    const struct mCc_tac_program *prog;
+    const struct mCc_tac_opt_loop *loop;
+    unsigned int fun_begin;
+
+    struct mCc_tac_opt_lane_value *values;
+    unsigned int value_count;
+    struct mCc_tac_opt_access *accesses;
+    unsigned int access_count;
+
+    /// Temporary held by each vector register, -1 if free
+    int reg_owner[MCC_TAC_VECTOR_REGS];
+    /// The accumulator of the reduction, never allocated otherwise
+    int reg_sum;
+    int reduction; ///< The temporary summed up, -1 if none
+
+    struct mCc_tac_quad **quads; ///< The vectorized body
+    unsigned int count;
+};
+
+/// Look up how a temporary read at pos in the loop body is computed
+static bool mCc_tac_opt_lane_value(const struct mCc_tac_opt_vectorizer *vec,
+                                   int number,
+                                   struct mCc_tac_opt_lane_value *value) {
+    for (unsigned int v = vec->value_count; v-- > 0;) {
+        if (vec->values[v].number == number) {
+            *value = vec->values[v];
+            return true;
+        }
+    }
+    // Not defined in the body so far, so it must be loop-invariant
+    for (unsigned int i = vec->loop->header + 1; i < vec->loop->latch; ++i)
+        if (mCc_tac_opt_quad_writes(vec->prog->quads[i], number))
+            return false;
+    value->number = number;
+    value->lanes = MCC_TAC_OPT_LANES_INVARIANT;
+    return true;
+}
+
+static void mCc_tac_opt_add_lane_value(struct mCc_tac_opt_vectorizer *vec,
+                                       int number, enum mCc_tac_opt_lanes lanes,
+                                       int offset, int reg) {
+    struct mCc_tac_opt_lane_value *value = &vec->values[vec->value_count++];
+    value->number = number;
+    value->lanes = lanes;
+    value->offset = offset;
+    value->reg = reg;
+}
+
+/**
+ * @brief Allocate a vector register for a value defined at pos.
+ *
+ * Registers of vectors which are not read at or after pos are reused, so
+ * the result of a quad never shares a register with its operands.
+ *
+ * @return The register, or -1 if all are in use
+ */
+static int mCc_tac_opt_alloc_reg(struct mCc_tac_opt_vectorizer *vec,
+                                 unsigned int pos, int owner) {
+    for (int r = 0; r < MCC_TAC_VECTOR_REGS; ++r) {
+        if (r == vec->reg_sum)
+            continue;
+        bool free = vec->reg_owner[r] == -1;
+        if (!free) {
+            free = true;
+            for (unsigned int i = pos; i < vec->loop->latch && free; ++i)
+                free = !mCc_tac_opt_quad_reads(vec->prog->quads[i],
+                                               vec->reg_owner[r]);
+        }
+        if (free) {
+            vec->reg_owner[r] = owner;
+            return r;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Get the vector register holding a value read at pos.
+ *
+ * Invariant scalars are broadcast into a register, which is released after
+ * the quad at pos.
+ *
+ * @return The register, -1 if the value cannot be vectorized, or -2 on memory
+ *         error
+ */
+static int mCc_tac_opt_vector_reg(struct mCc_tac_opt_vectorizer *vec,
+                                  unsigned int pos,
+                                  const struct mCc_tac_quad_entry *entry) {
+    struct mCc_tac_opt_lane_value value;
+    if (!mCc_tac_opt_lane_value(vec, entry->number, &value) ||
+        value.lanes == MCC_TAC_OPT_LANES_INDEX)
+        return -1;
+    if (value.lanes == MCC_TAC_OPT_LANES_VECTOR)
+        return value.reg;
+
+    // The register is free again as soon as the reading quad is done
+    int reg = mCc_tac_opt_alloc_reg(vec, pos, -1);
+    if (reg < 0)
+        return -1;
+    vec->reg_owner[reg] = entry->number;
+    struct mCc_tac_vector splat = {.dst = reg};
+    struct mCc_tac_quad *quad = mCc_tac_quad_new_vector(
+            MCC_TAC_QUAD_VECTOR_SPLAT, splat, *entry, *entry, *entry);
+    if (!quad)
+        return -2;
+    vec->quads[vec->count++] = quad;
+    return reg;
+}
+
+/// Record an array access at index, fail if the index is not affine in iv
+static bool mCc_tac_opt_add_access(struct mCc_tac_opt_vectorizer *vec,
+                                   const struct mCc_tac_quad_entry *array,
+                                   int index, bool store) {
+    // Array parameters have no size in stores, they are pointers
+    bool param = false;
+    const struct mCc_tac_quad *fun = vec->prog->quads[vec->fun_begin];
+    for (unsigned int p = 0; p < fun->param_count; ++p)
+        if (fun->params[p].number == array->number)
+            param = fun->params[p].is_array;
+
+    struct mCc_tac_opt_lane_value value;
+    if ((array->array_size <= 0 && !param) ||
+        !mCc_tac_opt_lane_value(vec, index, &value) ||
+        value.lanes != MCC_TAC_OPT_LANES_INDEX)
+        return false;
+
+    struct mCc_tac_opt_access *access = &vec->accesses[vec->access_count++];
+    access->array = array->number;
+    access->offset = value.offset;
+    access->store = store;
+    access->param = param;
+    return true;
+}
+
+/**
+ * @brief Check that no iteration depends on an earlier one.
+ *
+ * All accesses are relative to the induction variable, so a store and another
+ * access to the same array are only independent if they hit the same element
+ * in every iteration.
+ */
+static bool mCc_tac_opt_accesses_independent(
+        const struct mCc_tac_opt_vectorizer *vec) {
+    for (unsigned int s = 0; s < vec->access_count; ++s) {
+        const struct mCc_tac_opt_access *store = &vec->accesses[s];
+        if (!store->store)
+            continue;
+        for (unsigned int a = 0; a < vec->access_count; ++a) {
+            const struct mCc_tac_opt_access *access = &vec->accesses[a];
+            bool may_alias = access->array == store->array ||
+                             (access->param && store->param);
+            if (may_alias && access->offset != store->offset)
+                return false;
+        }
+    }
+    return true;
+}
+
+/// Emit a vector quad into the body
+static int mCc_tac_opt_emit_vector(struct mCc_tac_opt_vectorizer *vec,
+                                   enum mCc_tac_quad_type type,
+                                   struct mCc_tac_vector vector,
+                                   const struct mCc_tac_quad *scalar) {
+    struct mCc_tac_quad *quad = mCc_tac_quad_new_vector(
+            type, vector, scalar->arg1, scalar->arg2, scalar->result.ref);
+    if (!quad)
+        return -2;
+    quad->cfg_node = scalar->cfg_node;
+    vec->quads[vec->count++] = quad;
+    return 0;
+}
+
+/// Whether a binary operation has a packed SSE2 instruction
+static bool mCc_tac_opt_has_vector_op(enum mCc_tac_quad_binary_op op) {
+    switch (op) {
+        case MCC_TAC_OP_BINARY_ADD:
+        case MCC_TAC_OP_BINARY_SUB:
+        case MCC_TAC_OP_BINARY_FLOAT_ADD:
+        case MCC_TAC_OP_BINARY_FLOAT_SUB:
+        case MCC_TAC_OP_BINARY_FLOAT_MUL:
+        case MCC_TAC_OP_BINARY_FLOAT_DIV:
+            return true;
+        default:
+            return false; // Packed 32-bit multiplication needs SSE4.1
+    }
+}
+
+/**
+ * @brief Check for  t = s + v; s = t;  at pos, summing up a vector v in s.
+ *
+ * Only int sums are vectorized, reassociating float additions would change
+ * the rounding.
+ */
+static bool mCc_tac_opt_is_reduction(const struct mCc_tac_opt_vectorizer *vec,
+                                     unsigned int pos, int *sum, int *vector) {
+    const struct mCc_tac_program *prog = vec->prog;
+    const struct mCc_tac_quad *add = prog->quads[pos];
+    if (pos + 1 >= vec->loop->latch)
+        return false;
+    const struct mCc_tac_quad *assign = prog->quads[pos + 1];
+    if (add->type != MCC_TAC_QUAD_OP_BINARY ||
+        add->bin_op != MCC_TAC_OP_BINARY_ADD ||
+        assign->type != MCC_TAC_QUAD_ASSIGN ||
+        assign->arg1.number != add->result.ref.number)
+        return false;
+    *sum = assign->result.ref.number;
+    if (add->arg1.number == *sum)
+        *vector = add->arg2.number;
+    else if (add->arg2.number == *sum)
+        *vector = add->arg1.number;
+    else
+        return false;
+
+    // The sum is not used otherwise in the loop
+    for (unsigned int i = vec->loop->header + 1; i < vec->loop->latch; ++i) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        if (i != pos && mCc_tac_opt_quad_reads(quad, *sum))
+            return false;
+        if (i != pos + 1 && mCc_tac_opt_quad_writes(quad, *sum))
+            return false;
+    }
+    struct mCc_tac_opt_lane_value value;
+    return mCc_tac_opt_lane_value(vec, *vector, &value) &&
+           value.lanes == MCC_TAC_OPT_LANES_VECTOR;
+}
+
+/**
+ * @brief Vectorize the quad at pos of the loop body.
+ *
+ * @return The number of quads consumed, 0 if the quad cannot be vectorized,
+ *         or -2 on memory error
+ */
+static int mCc_tac_opt_vectorize_quad(struct mCc_tac_opt_vectorizer *vec,
+                                      unsigned int pos) {
+    const struct mCc_tac_quad *quad = vec->prog->quads[pos];
+    struct mCc_tac_opt_lane_value a1, a2;
+    struct mCc_tac_vector vector = {.dst = -1, .src1 = -1, .src2 = -1};
+    int sum, summand, def = mCc_tac_opt_quad_def(quad);
+
+    switch (quad->type) {
+        case MCC_TAC_QUAD_ASSIGN_LIT:
+            mCc_tac_opt_add_lane_value(vec, def, MCC_TAC_OPT_LANES_INVARIANT,
+                                       0, -1);
+            break;
+        case MCC_TAC_QUAD_ASSIGN:
+            if (!mCc_tac_opt_lane_value(vec, quad->arg1.number, &a1) ||
+                a1.lanes == MCC_TAC_OPT_LANES_VECTOR)
+                return 0;
+            mCc_tac_opt_add_lane_value(vec, def, a1.lanes, a1.offset, -1);
+            break;
+        case MCC_TAC_QUAD_OP_BINARY:
+            if (vec->reduction < 0 &&
+                mCc_tac_opt_is_reduction(vec, pos, &sum, &summand)) {
+                mCc_tac_opt_lane_value(vec, summand, &a1);
+                vec->reduction = sum;
+                vector.op = MCC_TAC_OP_BINARY_ADD;
+                vector.dst = vec->reg_sum;
+                vector.src1 = vec->reg_sum;
+                vector.src2 = a1.reg;
+                return mCc_tac_opt_emit_vector(vec, MCC_TAC_QUAD_VECTOR_OP,
+                                               vector, quad)
+                               ? -2
+                               : 2;
+            }
+            if (!mCc_tac_opt_lane_value(vec, quad->arg1.number, &a1) ||
+                !mCc_tac_opt_lane_value(vec, quad->arg2.number, &a2))
+                return 0;
+            if (a1.lanes == MCC_TAC_OPT_LANES_INVARIANT &&
+                a2.lanes == MCC_TAC_OPT_LANES_INVARIANT) {
+                mCc_tac_opt_add_lane_value(vec, def,
+                                           MCC_TAC_OPT_LANES_INVARIANT, 0, -1);
+                break;
+            }
+
+            // Index arithmetic stays scalar, it is done once per vector
+            int c;
+            if (a1.lanes == MCC_TAC_OPT_LANES_INDEX &&
+                a2.lanes == MCC_TAC_OPT_LANES_INVARIANT &&
+                (quad->bin_op == MCC_TAC_OP_BINARY_ADD ||
+                 quad->bin_op == MCC_TAC_OP_BINARY_SUB) &&
+                mCc_tac_opt_entry_value(vec->prog, pos, a2.number, &c)) {
+                mCc_tac_opt_add_lane_value(
+                        vec, def, MCC_TAC_OPT_LANES_INDEX,
+                        quad->bin_op == MCC_TAC_OP_BINARY_ADD ? a1.offset + c
+                                                              : a1.offset - c,
+                        -1);
+                break;
+            }
+            if (a2.lanes == MCC_TAC_OPT_LANES_INDEX &&
+                a1.lanes == MCC_TAC_OPT_LANES_INVARIANT &&
+                quad->bin_op == MCC_TAC_OP_BINARY_ADD &&
+                mCc_tac_opt_entry_value(vec->prog, pos, a1.number, &c)) {
+                mCc_tac_opt_add_lane_value(vec, def, MCC_TAC_OPT_LANES_INDEX,
+                                           a2.offset + c, -1);
+                break;
+            }
+
+            if (!mCc_tac_opt_has_vector_op(quad->bin_op))
+                return 0;
+            vector.op = quad->bin_op;
+            vector.src1 = mCc_tac_opt_vector_reg(vec, pos, &quad->arg1);
+            if (vector.src1 < 0)
+                return vector.src1 == -2 ? -2 : 0;
+            vector.src2 = mCc_tac_opt_vector_reg(vec, pos, &quad->arg2);
+            if (vector.src2 < 0)
+                return vector.src2 == -2 ? -2 : 0;
+            vector.dst = mCc_tac_opt_alloc_reg(vec, pos, def);
+            if (vector.dst < 0)
+                return 0;
+            mCc_tac_opt_add_lane_value(vec, def, MCC_TAC_OPT_LANES_VECTOR, 0,
+                                       vector.dst);
+            return mCc_tac_opt_emit_vector(vec, MCC_TAC_QUAD_VECTOR_OP, vector,
+                                           quad)
+                           ? -2
+                           : 1;
+        case MCC_TAC_QUAD_LOAD:
+            if (!mCc_tac_opt_add_access(vec, &quad->arg1, quad->arg2.number,
+                                        false))
+                return 0;
+            vector.dst = mCc_tac_opt_alloc_reg(vec, pos, def);
+            if (vector.dst < 0)
+                return 0;
+            mCc_tac_opt_add_lane_value(vec, def, MCC_TAC_OPT_LANES_VECTOR, 0,
+                                       vector.dst);
+            return mCc_tac_opt_emit_vector(vec, MCC_TAC_QUAD_VECTOR_LOAD,
+                                           vector, quad)
+                           ? -2
+                           : 1;
+        case MCC_TAC_QUAD_STORE:
+            if (!mCc_tac_opt_add_access(vec, &quad->result.ref,
+                                        quad->arg2.number, true))
+                return 0;
+            vector.src1 = mCc_tac_opt_vector_reg(vec, pos, &quad->arg1);
+            if (vector.src1 < 0)
+                return vector.src1 == -2 ? -2 : 0;
+            return mCc_tac_opt_emit_vector(vec, MCC_TAC_QUAD_VECTOR_STORE,
+                                           vector, quad)
+                           ? -2
+                           : 1;
+        default:
+            return 0;
+    }
+
+    // Scalar quads are kept as they are
+    struct mCc_tac_quad *copy = mCc_tac_quad_copy(quad);
+    if (!copy)
+        return -2;
+    copy->comment = NULL;
+    vec->quads[vec->count++] = copy;
+    return 1;
+}
+
+/**
+ * @brief Vectorize the body of a counted loop.
+ *
+ * @return 1 on success, 0 if the body cannot be vectorized, -1 on memory
+ *         error
+ */
+static int mCc_tac_opt_vectorize_body(struct mCc_tac_opt_vectorizer *vec) {
+    const struct mCc_tac_opt_loop *loop = vec->loop;
+    const struct mCc_tac_program *prog = vec->prog;
+    unsigned int add_pos = loop->step_pos - 1;
+    int sum = prog->quads[loop->step_pos]->arg1.number;
+    while (!mCc_tac_opt_quad_writes(prog->quads[add_pos], sum))
+        --add_pos;
+
+    mCc_tac_opt_add_lane_value(vec, loop->iv, MCC_TAC_OPT_LANES_INDEX, 0, -1);
+    for (unsigned int i = loop->guard + 1; i < loop->latch;) {
+        const struct mCc_tac_quad *quad = prog->quads[i];
+        // The update of the induction variable is replaced afterwards
+        if (i == add_pos || i == loop->step_pos) {
+            ++i;
+            continue;
+        }
+        if (mCc_tac_opt_quad_reads(quad, sum))
+            return 0;
+        int consumed = mCc_tac_opt_vectorize_quad(vec, i);
+        if (consumed < 0)
+            return -1;
+        if (!consumed)
+            return 0;
+
+        // Release the registers of broadcast scalars
+        for (int r = 0; r < MCC_TAC_VECTOR_REGS; ++r) {
+            struct mCc_tac_opt_lane_value value;
+            if (vec->reg_owner[r] >= 0 &&
+                (!mCc_tac_opt_lane_value(vec, vec->reg_owner[r], &value) ||
+                 value.lanes != MCC_TAC_OPT_LANES_VECTOR))
+                vec->reg_owner[r] = -1;
+        }
+        i += consumed;
+    }
+    return mCc_tac_opt_accesses_independent(vec) &&
+           (vec->access_count || vec->reduction >= 0);
+}
+
+/**
+ * @brief Try to vectorize the counted loop starting at header.
+ *
+ * The loop is preceded by a vectorized copy, which runs as long as at least
+ * #MCC_TAC_VECTOR_LANES iterations are left:
+ *
+ *   [v7 = 0]; Lv: cond; t1 = iv + 3; t2 = t1 cmp bound; jumpfalse t2 Lx;
+ *   vector body; iv = iv + 4; jump Lv; Lx: [s = s + sum v7]; original loop
+ *
+ * @param consumed Set to the number of quads up to the end of the loop
+ *
+ * @return 1 if vectorized, 0 if not, -1 on memory error
+ */
+static int mCc_tac_opt_try_vectorize_loop(struct mCc_tac_program *prog,
+                                          unsigned int header,
+                                          unsigned int *consumed) {
+    struct mCc_tac_opt_loop loop;
+    if (!mCc_tac_opt_find_counted_loop(prog, header, &loop) ||
+        loop.step != 1 ||
+        (loop.cmp != MCC_TAC_OP_BINARY_LT && loop.cmp != MCC_TAC_OP_BINARY_LEQ))
+        return 0;
+    long trips = mCc_tac_opt_trip_count(&loop, 2 * MCC_TAC_VECTOR_LANES);
+    if (trips >= 0)
+        return 0; // Too short
+    for (unsigned int i = loop.guard + 1; i < loop.latch; ++i)
+        if (mCc_tac_opt_is_block_boundary(prog->quads[i]))
+            return 0;
+    if (loop.step_pos != loop.latch - 1)
+        return 0;
+
+    unsigned int fun_end;
+    struct mCc_tac_opt_vectorizer vec = {.prog = prog, .loop = &loop};
+    mCc_tac_opt_function_bounds(prog, header, &vec.fun_begin, &fun_end);
+
+    unsigned int body_size = loop.latch - loop.guard - 1;
+    vec.values = malloc((body_size + 1) * sizeof(*vec.values));
+    vec.accesses = malloc(body_size * sizeof(*vec.accesses));
+    unsigned int alloc = 3 * body_size + (loop.guard - header) + 12;
+    vec.quads = malloc(alloc * sizeof(*vec.quads));
+    int ret = 0;
+    if (!vec.values || !vec.accesses || !vec.quads) {
+        ret = -1;
+        goto cleanup;
+    }
+    for (int r = 0; r < MCC_TAC_VECTOR_REGS; ++r)
+        vec.reg_owner[r] = -1;
+    vec.reg_sum = MCC_TAC_VECTOR_REGS - 1;
+    vec.reduction = -1;
+
+    // Header of the vectorized loop, the body goes after it
+    struct mCc_tac_label label_vector = mCc_tac_get_new_label(prog->ctx);
+    struct mCc_tac_label label_exit = mCc_tac_get_new_label(prog->ctx);
+    if (mCc_tac_opt_unrolled_header(prog, &loop, MCC_TAC_VECTOR_LANES,
+                                    label_vector, "Vectorized loop", vec.quads,
+                                    &vec.count)) {
+        ret = -1;
+        goto cleanup;
+    }
+    struct mCc_tac_quad *guard = mCc_tac_quad_new_jumpfalse(
+            vec.quads[vec.count - 1]->result.ref, label_exit);
+    if (!guard) {
+        ret = -1;
+        goto cleanup;
+    }
+    guard->comment = "Leave for the remainder loop";
+    vec.quads[vec.count++] = guard;
+
+    ret = mCc_tac_opt_vectorize_body(&vec);
+    if (ret <= 0)
+        goto cleanup;
+
+    // Only the induction variable and the sum may be live after the loop
+    for (unsigned int i = loop.guard + 1; i < loop.latch; ++i) {
+        int def = mCc_tac_opt_quad_def(prog->quads[i]);
+        if (def >= 0 && def != loop.iv && def != vec.reduction &&
+            mCc_tac_opt_read_outside(prog, vec.fun_begin, fun_end,
+                                     loop.guard + 1, loop.latch, def)) {
+            ret = 0;
+            goto cleanup;
+        }
+    }
+
+    // iv = iv + lanes
+    const struct mCc_tac_quad *step = prog->quads[loop.step_pos];
+    struct mCc_tac_quad_entry lanes, next;
+    struct mCc_tac_quad *quad = mCc_tac_opt_new_int_lit(prog->ctx,
+                                                        MCC_TAC_VECTOR_LANES,
+                                                        &lanes);
+    if (!quad) {
+        ret = -1;
+        goto cleanup;
+    }
+    vec.quads[vec.count++] = quad;
+    next = mCc_tac_create_new_entry(prog->ctx);
+    next.type = MCC_TAC_QUAD_LIT_INT;
+    if (!(quad = mCc_tac_quad_new_op_binary(MCC_TAC_OP_BINARY_ADD,
+                                            step->result.ref, lanes, next))) {
+        ret = -1;
+        goto cleanup;
+    }
+    vec.quads[vec.count++] = quad;
+    if (!(quad = mCc_tac_quad_new_assign(next, step->result.ref)) ||
+        (vec.quads[vec.count++] = quad,
+         !(quad = mCc_tac_quad_new_jump(label_vector))) ||
+        (vec.quads[vec.count++] = quad,
+         !(quad = mCc_tac_quad_new_label(label_exit)))) {
+        ret = -1;
+        goto cleanup;
+    }
+    vec.quads[vec.count++] = quad;
+
+    // Sum up the lanes of the accumulator after the loop
+    if (vec.reduction >= 0) {
+        struct mCc_tac_vector vector = {.dst = vec.reg_sum,
+                                        .src1 = vec.reg_sum};
+        struct mCc_tac_quad_entry sum = step->result.ref;
+        sum.number = vec.reduction;
+        struct mCc_tac_quad *zero = mCc_tac_quad_new_vector(
+                MCC_TAC_QUAD_VECTOR_ZERO, vector, sum, sum, sum);
+        struct mCc_tac_quad *reduce = mCc_tac_quad_new_vector(
+                MCC_TAC_QUAD_VECTOR_REDUCE, vector, sum, sum, sum);
+        if (!zero || !reduce) {
+            free(zero);
+            free(reduce);
+            ret = -1;
+            goto cleanup;
+        }
+        vec.quads[vec.count++] = reduce;
+        memmove(vec.quads + 1, vec.quads, (vec.count) * sizeof(*vec.quads));
+        vec.quads[0] = zero;
+        ++vec.count;
+    }
+
+    if (mCc_tac_opt_replace_range(prog, header, header, vec.quads,
+                                  vec.count)) {
+        ret = -1;
+        goto cleanup;
+    }
+    prog->quads[header + vec.count]->remainder_loop = true;
+    // New temporaries of the header and the update of iv
+    prog->quads[vec.fun_begin]->var_count += 5;
+    *consumed = vec.count + loop.latch + 1 - header;
+    vec.count = 0;
+
+cleanup:
+    for (unsigned int i = 0; i < vec.count; ++i)
+        mCc_tac_quad_delete(vec.quads[i]);
+    free(vec.values);
+    free(vec.accesses);
+    free(vec.quads);
+    return ret;
+}
+
+static int mCc_tac_opt_vectorize_loops_function(
+        struct mCc_tac_program *prog,
+        const struct mCc_tac_opt_options *options) {
+    (void)options;
+    int vectorized = 0;
+    for (unsigned int i = 0; i < prog->quad_count; ++i) {
+        unsigned int consumed = 0;
+        int ret = mCc_tac_opt_try_vectorize_loop(prog, i, &consumed);
+        if (ret < 0)
+            return -1;
+        if (ret) {
+            ++vectorized;
+            i += consumed - 1;
+        }
+    }
+    return vectorized;
+}
+
+/*********************************** Loop rotation */
+
+/**
+ * @brief Try to rotate the while loop whose condition starts at header.
+ *
+ * Turns  Lc: cond; jumpfalse c Le; body; jump Lc; Le:
+ * into   cond; jumpfalse c Le; Lb: body; cond; jumptrue c Lb; Le:
+ * which saves the unconditional jump in every iteration.
+ *
+ * @return 1 if rotated, 0 if not, -1 on memory error
+ */
+static int mCc_tac_opt_try_rotate_loop(struct mCc_tac_program *prog,
+                                       unsigned int header,
+                                       unsigned int max_cond) {
+    struct mCc_tac_quad *label_cond = prog->quads[header];
+    int cond_num = label_cond->result.label.num;
+
+    unsigned int cond_begin = header + 1;
+    unsigned int guard = cond_begin;
+    while (guard < prog->quad_count &&
+           !mCc_tac_opt_is_block_boundary(prog->quads[guard]) &&
+           !mCc_tac_opt_is_function_label(prog->quads[guard]))
+        ++guard;
+    if (guard >= prog->quad_count ||
+        prog->quads[guard]->type != MCC_TAC_QUAD_JUMPFALSE ||
+        guard - cond_begin > max_cond)
+        return 0;
+    int end_num = prog->quads[guard]->result.label.num;
+
+    // Find the back edge directly followed by the exit label
+    unsigned int fun_begin, fun_end;
+    mCc_tac_opt_function_bounds(prog, header, &fun_begin, &fun_end);
+    unsigned int back = guard + 1;
+    while (back + 1 < fun_end &&
+           !(prog->quads[back]->type == MCC_TAC_QUAD_JUMP &&
+             prog->quads[back]->result.label.num == cond_num &&
+             prog->quads[back + 1]->type == MCC_TAC_QUAD_LABEL &&
+             prog->quads[back + 1]->result.label.num == end_num))
+        ++back;
+    if (back + 1 >= fun_end)
+        return 0;
+
+    unsigned int cond_count = guard - cond_begin;
+    unsigned int body_count = back - guard - 1;
+    bool keep_label_cond = mCc_tac_opt_label_refs(prog, cond_num) > 1;
+    unsigned int count = cond_count + 2 + body_count + keep_label_cond +
+                         cond_count + 1;
+    struct mCc_tac_quad **quads = malloc(count * sizeof(*quads));
+    struct mCc_tac_quad *label_body =
+            mCc_tac_quad_new_label(mCc_tac_get_new_label(prog->ctx));
+    struct mCc_tac_quad *repeat = mCc_tac_quad_new_jumptrue(
+            prog->quads[guard]->arg1, label_body->result.label);
+    if (!quads || !label_body || !repeat)
+        goto memory_error;
+    label_body->loop_header = true;
+    label_body->cfg_node = prog->quads[guard]->cfg_node;
+    repeat->comment = "Repeat loop while the condition holds";
+    repeat->cfg_node = prog->quads[back]->cfg_node;
+
+    count = 0;
+    for (unsigned int i = cond_begin; i <= guard; ++i)
+        quads[count++] = prog->quads[i];
+    quads[count++] = label_body;
+    for (unsigned int i = guard + 1; i < back; ++i)
+        quads[count++] = prog->quads[i];
+    if (keep_label_cond)
+        quads[count++] = label_cond;
+    unsigned int copies_begin = count;
+    for (unsigned int i = cond_begin; i < guard; ++i) {
+        if (!(quads[count] = mCc_tac_quad_copy(prog->quads[i]))) {
+            for (unsigned int j = copies_begin; j < count; ++j)
+                mCc_tac_quad_delete(quads[j]);
+            goto memory_error;
+        }
+        quads[count++]->comment = NULL;
+    }
+    quads[count++] = repeat;
+
+    struct mCc_tac_quad *back_jump = prog->quads[back];
+    if (mCc_tac_opt_replace_range(prog, header, back + 1, quads, count)) {
+        for (unsigned int j = copies_begin; j < count - 1; ++j)
+            mCc_tac_quad_delete(quads[j]);
+        goto memory_error;
+    }
+    mCc_tac_quad_delete(back_jump);
+    if (!keep_label_cond)
+        mCc_tac_quad_delete(label_cond);
+    free(quads);
+    return 1;
+
+memory_error:
+    free(quads);
+    if (label_body)
+        mCc_tac_quad_delete(label_body);
+    if (repeat)
+        mCc_tac_quad_delete(repeat);
+    return -1;
+}
+
+static int
+mCc_tac_opt_rotate_loops_function(struct mCc_tac_program *prog,
+                                  const struct mCc_tac_opt_options *options) {
+    unsigned int max_cond = options->loop_rotate_max_cond;
+    int rotated = 0;
+    for (unsigned int i = 0; i < prog->quad_count; ++i) {
+        struct mCc_tac_quad *quad = prog->quads[i];
+        if (quad->type != MCC_TAC_QUAD_LABEL || quad->result.label.num < 0)
+            continue;
+        int ret = mCc_tac_opt_try_rotate_loop(prog, i, max_cond);
+        if (ret < 0)
+            return -1;
+        rotated += ret;
+    }
+    return rotated;
+}
+
+/*********************************** Block layout */
+
+/**
+ * @brief Find an if-branch at branch that leaves the function.
+ *
+ * Matches  jumpfalse c L; straight-line code; return; [jump ...;] L:
+ *
+ * @return The position of L, or 0 if there is no such branch
+ */
+static unsigned int mCc_tac_opt_returning_branch_end(
+        const struct mCc_tac_program *prog, unsigned int branch) {
+    const struct mCc_tac_quad *guard = prog->quads[branch];
+    if (guard->type != MCC_TAC_QUAD_JUMPFALSE)
+        return 0;
+
+    unsigned int i = branch + 1;
+    while (i < prog->quad_count &&
+           !mCc_tac_opt_is_block_boundary(prog->quads[i]))
+        ++i;
+    if (i >= prog->quad_count ||
+        (prog->quads[i]->type != MCC_TAC_QUAD_RETURN &&
+         prog->quads[i]->type != MCC_TAC_QUAD_RETURN_VOID))
+        return 0;
+    ++i;
+    // The builder may leave a dead jump over the else branch
+    if (i < prog->quad_count && prog->quads[i]->type == MCC_TAC_QUAD_JUMP)
+        ++i;
+    if (i >= prog->quad_count ||
+        prog->quads[i]->type != MCC_TAC_QUAD_LABEL ||
+        prog->quads[i]->result.label.num != guard->result.label.num)
+        return 0;
+    return i;
+}
+
+/// Lay out the function [begin, end), see #mCc_tac_opt_layout_blocks
+static int mCc_tac_opt_layout_function(struct mCc_tac_program *prog,
+                                       unsigned int begin, unsigned int end,
+                                       int *moved) {
+    unsigned int count = end - begin;
+    struct mCc_tac_quad **hot = malloc(count * 2 * sizeof(*hot));
+    struct mCc_tac_quad **cold = malloc(count * 2 * sizeof(*cold));
+    if (!hot || !cold) {
+        free(hot);
+        free(cold);
+        return 1;
+    }
+
+    unsigned int hot_count = 0, cold_count = 0;
+    for (unsigned int i = begin; i < end; ++i) {
+        unsigned int join = mCc_tac_opt_returning_branch_end(prog, i);
+        if (!join || join >= end) {
+            hot[hot_count++] = prog->quads[i];
+            continue;
+        }
+
+        // Invert the branch and move the returning path behind the function
+        struct mCc_tac_quad *label_cold =
+                mCc_tac_quad_new_label(mCc_tac_get_new_label(prog->ctx));
+        if (!label_cold) {
+            free(hot);
+            free(cold);
+            return 1;
+        }
+        label_cold->comment = "Out-of-line return path";
+        label_cold->cfg_node = prog->quads[i]->cfg_node;
+
+        struct mCc_tac_quad *guard = prog->quads[i];
+        guard->type = MCC_TAC_QUAD_JUMPTRUE;
+        guard->result.label = label_cold->result.label;
+        hot[hot_count++] = guard;
+
+        cold[cold_count++] = label_cold;
+        for (unsigned int j = i + 1; j < join; ++j)
+            cold[cold_count++] = prog->quads[j];
+        i = join - 1;
+        ++*moved;
+    }
+
+    memcpy(hot + hot_count, cold, cold_count * sizeof(*cold));
+    int ret = mCc_tac_opt_replace_range(prog, begin, end, hot,
+                                        hot_count + cold_count);
+    free(hot);
+    free(cold);
+    return ret;
+}
+
+static int
+mCc_tac_opt_layout_blocks_function(struct mCc_tac_program *prog,
+                                   const struct mCc_tac_opt_options *options) {
+    (void)options;
+    int moved = 0;
+    if (mCc_tac_opt_layout_function(prog, 0, prog->quad_count, &moved))
+        return -1;
+
+    // Align the targets of back edges
+    for (unsigned int i = 0; i < prog->quad_count; ++i) {
+        struct mCc_tac_quad *jump = prog->quads[i];
+        if (!mCc_tac_opt_is_jump(jump))
+            continue;
+        for (unsigned int j = i + 1; j-- > 0;) {
+            struct mCc_tac_quad *label = prog->quads[j];
+            if (mCc_tac_opt_is_function_label(label))
+                break;
+            if (label->type == MCC_TAC_QUAD_LABEL &&
+                label->result.label.num == jump->result.label.num) {
+                label->loop_header = true;
+                break;
+            }
+        }
+    }
+    return moved;
+}
+
+/*********************************** Driver */
+
+struct mCc_tac_opt_options mCc_tac_opt_default_options(unsigned int level) {
+    struct mCc_tac_opt_options options;
+    options.level = level;
+    options.if_convert_max_speculated = if_convert_max_speculated;
+    options.loop_rotate_max_cond = loop_rotate_max_cond;
+    options.unroll_factor = unroll_factor;
+    options.unroll_full_max_trip = unroll_full_max_trip;
+    options.unroll_max_size = unroll_max_size;
+    return options;
+}
+
+int mCc_tac_opt_if_convert(struct mCc_tac_program *prog,
+                           unsigned int max_speculated) {
+    assert(prog);
+
+    struct mCc_tac_opt_options options = mCc_tac_opt_default_options(1);
+    options.if_convert_max_speculated = max_speculated;
+    return mCc_tac_opt_each_function(prog, mCc_tac_opt_if_convert_function,
+                                     &options);
+}
+
+int mCc_tac_opt_vectorize_loops(struct mCc_tac_program *prog) {
+    assert(prog);
+
+    struct mCc_tac_opt_options options = mCc_tac_opt_default_options(3);
+    return mCc_tac_opt_each_function(
+            prog, mCc_tac_opt_vectorize_loops_function, &options);
+}
+
+int mCc_tac_opt_unroll_loops(struct mCc_tac_program *prog,
+                             const struct mCc_tac_opt_options *options) {
+    assert(prog);
+    assert(options);
+
+    return mCc_tac_opt_each_function(prog, mCc_tac_opt_unroll_loops_function,
+                                     options);
+}
+
+int mCc_tac_opt_rotate_loops(struct mCc_tac_program *prog,
+                             unsigned int max_cond) {
+    assert(prog);
+
+    struct mCc_tac_opt_options options = mCc_tac_opt_default_options(2);
+    options.loop_rotate_max_cond = max_cond;
+    return mCc_tac_opt_each_function(prog, mCc_tac_opt_rotate_loops_function,
+                                     &options);
+}
+
+int mCc_tac_opt_layout_blocks(struct mCc_tac_program *prog) {
+    assert(prog);
+
+    struct mCc_tac_opt_options options = mCc_tac_opt_default_options(2);
+    return mCc_tac_opt_each_function(
+            prog, mCc_tac_opt_layout_blocks_function, &options);
+}
+
+/* All passes enabled by the options, on a single function */
+static int mCc_tac_opt_function(struct mCc_tac_program *prog,
+                                const struct mCc_tac_opt_options *options) {
+    if (options->level >= 1 &&
+        mCc_tac_opt_if_convert_function(prog, options) < 0)
+        return -1;
+    if (options->level >= 3 &&
+        (mCc_tac_opt_vectorize_loops_function(prog, options) < 0 ||
+         mCc_tac_opt_unroll_loops_function(prog, options) < 0))
+        return -1;
+    if (options->level >= 2 &&
+        (mCc_tac_opt_rotate_loops_function(prog, options) < 0 ||
+         mCc_tac_opt_layout_blocks_function(prog, options) < 0))
+        return -1;
+    return 0;
+}
+
+int mCc_tac_optimize(struct mCc_tac_program *prog,
+                     const struct mCc_tac_opt_options *options) {
+    assert(prog);
+    assert(options);
+
+    return mCc_tac_opt_each_function(prog, mCc_tac_opt_function, options) < 0;
+}
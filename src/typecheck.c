@@ -7,26 +7,25 @@
 
 #include "mCc/typecheck.h"
 #include "mCc/ast_visit.h"
+#include "mCc/context.h"
+#include "mCc/source.h"
 #include <stdio.h>
-
-/// Global Var to save the current func we're in
-static struct mCc_ast_function_def *curr_func;
-
-static struct mCc_typecheck_result typecheck_result = {
-        MCC_TYPECHECK_STATUS_OK
-};
+#include <string.h>
 
 /// Forward declarations
 static inline enum mCc_ast_type
-mCc_check_expression(struct mCc_ast_expression *expr);
+mCc_check_expression(struct mCc_typecheck_state *state,
+                     struct mCc_ast_expression *expr);
 
-static inline bool mCc_check_statement(struct mCc_ast_statement *stmt);
+static inline bool mCc_check_statement(struct mCc_typecheck_state *state,
+                                       struct mCc_ast_statement *stmt);
 
 static inline void set_not_matching_types_error(
-        char *expected_as_string, enum mCc_ast_type expected_as_type,
+        struct mCc_typecheck_state *state, char *expected_as_string,
+        enum mCc_ast_type expected_as_type,
         enum mCc_ast_type given_type, struct mCc_ast_source_location sloc) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_OK) {
-        typecheck_result.err_loc = sloc;
+    if (state->result.status == MCC_TYPECHECK_STATUS_OK) {
+        state->result.err_loc = sloc;
 
         if ((int) expected_as_type != -1) {
             switch (expected_as_type) {
@@ -73,10 +72,10 @@ static inline void set_not_matching_types_error(
                 given = "UNDEFINED";
                 break;
         }
-        snprintf(typecheck_result.err_msg, err_len,
+        snprintf(state->result.err_msg, err_len,
                  "Expected type %s, but found %s", expected_as_string, given);
 
-        typecheck_result.status = MCC_TYPECHECK_STATUS_ERROR;
+        state->result.status = MCC_TYPECHECK_STATUS_ERROR;
     }
     return;
 }
@@ -103,26 +102,27 @@ convert_literal_type_to_type(enum mCc_ast_literal_type lit_type) {
 /************** EXPRESSIONS */
 
 static inline enum mCc_ast_type
-mCc_check_unary(struct mCc_ast_expression *unary) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+mCc_check_unary(struct mCc_typecheck_state *state,
+                struct mCc_ast_expression *unary) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return MCC_AST_TYPE_VOID;
 
     enum mCc_ast_type computed_type =
-            mCc_check_expression(unary->unary_expression);
+            mCc_check_expression(state, unary->unary_expression);
 
     switch (unary->unary_op) {
         case MCC_AST_UNARY_OP_NEG:
             if ((computed_type != MCC_AST_TYPE_INT) &&
                 (computed_type != MCC_AST_TYPE_FLOAT)) {
-                set_not_matching_types_error("Integer or Float", -1, computed_type,
-                                             unary->node.sloc);
+                set_not_matching_types_error(state, "Integer or Float", -1,
+                                             computed_type, unary->node.sloc);
                 return MCC_AST_TYPE_VOID;
             }
             break;
 
         case MCC_AST_UNARY_OP_NOT:
             if (computed_type != MCC_AST_TYPE_BOOL) {
-                set_not_matching_types_error("Bool", -1, computed_type,
+                set_not_matching_types_error(state, "Bool", -1, computed_type,
                                              unary->node.sloc);
                 return MCC_AST_TYPE_VOID;
             }
@@ -136,16 +136,19 @@ mCc_check_unary(struct mCc_ast_expression *unary) {
 }
 
 static inline enum mCc_ast_type
-mCc_check_binary(struct mCc_ast_expression *binary) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+mCc_check_binary(struct mCc_typecheck_state *state,
+                 struct mCc_ast_expression *binary) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return MCC_AST_TYPE_VOID;
 
-    enum mCc_ast_type computed_type_left = mCc_check_expression(binary->lhs);
-    enum mCc_ast_type computed_type_right = mCc_check_expression(binary->rhs);
+    enum mCc_ast_type computed_type_left =
+            mCc_check_expression(state, binary->lhs);
+    enum mCc_ast_type computed_type_right =
+            mCc_check_expression(state, binary->rhs);
 
     if (computed_type_left != computed_type_right) {
 
-        set_not_matching_types_error(NULL, computed_type_left,
+        set_not_matching_types_error(state, NULL, computed_type_left,
                                      computed_type_right, binary->node.sloc);
 
         return MCC_AST_TYPE_VOID;
@@ -159,8 +162,9 @@ mCc_check_binary(struct mCc_ast_expression *binary) {
         case MCC_AST_BINARY_OP_DIV:
             if ((computed_type_left != MCC_AST_TYPE_INT) &&
                 (computed_type_left != MCC_AST_TYPE_FLOAT)) {
-                set_not_matching_types_error("Integer or Float", -1,
-                                             computed_type_left, binary->node.sloc);
+                set_not_matching_types_error(state, "Integer or Float", -1,
+                                             computed_type_left,
+                                             binary->node.sloc);
                 return MCC_AST_TYPE_VOID;
             }
             break;
@@ -170,8 +174,9 @@ mCc_check_binary(struct mCc_ast_expression *binary) {
         case MCC_AST_BINARY_OP_LEQ:
         case MCC_AST_BINARY_OP_GEQ:
             if (computed_type_left == MCC_AST_TYPE_BOOL) {
-                set_not_matching_types_error("Integer, Float or String", -1,
-                                             computed_type_left, binary->node.sloc);
+                set_not_matching_types_error(state, "Integer, Float or String",
+                                             -1, computed_type_left,
+                                             binary->node.sloc);
                 return MCC_AST_TYPE_VOID;
             }
             return MCC_AST_TYPE_BOOL;
@@ -179,8 +184,8 @@ mCc_check_binary(struct mCc_ast_expression *binary) {
         case MCC_AST_BINARY_OP_AND:
         case MCC_AST_BINARY_OP_OR:
             if (computed_type_left != MCC_AST_TYPE_BOOL) {
-                set_not_matching_types_error("Bool", computed_type_left, -1,
-                                             binary->node.sloc);
+                set_not_matching_types_error(state, "Bool", computed_type_left,
+                                             -1, binary->node.sloc);
                 return MCC_AST_TYPE_VOID;
             }
             return MCC_AST_TYPE_BOOL;
@@ -197,15 +202,16 @@ mCc_check_binary(struct mCc_ast_expression *binary) {
 }
 
 static inline enum mCc_ast_type
-mCc_check_arr_subscr(struct mCc_ast_expression *arr_subscr) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+mCc_check_arr_subscr(struct mCc_typecheck_state *state,
+                     struct mCc_ast_expression *arr_subscr) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return MCC_AST_TYPE_VOID;
 
     enum mCc_ast_type subscript_type =
-            mCc_check_expression(arr_subscr->subscript_expr);
+            mCc_check_expression(state, arr_subscr->subscript_expr);
 
     if (subscript_type != MCC_AST_TYPE_INT) {
-        set_not_matching_types_error("Integer", -1, subscript_type,
+        set_not_matching_types_error(state, "Integer", -1, subscript_type,
                                      arr_subscr->subscript_expr->node.sloc);
         return MCC_AST_TYPE_VOID;
     }
@@ -213,10 +219,11 @@ mCc_check_arr_subscr(struct mCc_ast_expression *arr_subscr) {
     return arr_subscr->array_id->symtab_ref->primitive_type;
 }
 
-static inline bool mCc_check_paramaters(struct mCc_ast_arguments *args,
+static inline bool mCc_check_paramaters(struct mCc_typecheck_state *state,
+                                        struct mCc_ast_arguments *args,
                                         struct mCc_ast_parameters *params,
                                         struct mCc_ast_source_location sloc) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return MCC_AST_TYPE_VOID;
 
     if ((!params || params->decl_count == 0) &&
@@ -227,26 +234,28 @@ static inline bool mCc_check_paramaters(struct mCc_ast_arguments *args,
         params->decl_count == args->expression_count) {
         for (unsigned int i = 0; i < params->decl_count; ++i) {
             enum mCc_ast_type computed_type =
-                    mCc_check_expression(args->expressions[i]);
+                    mCc_check_expression(state, args->expressions[i]);
             if (params->decl[i]->decl_type != computed_type) {
-                set_not_matching_types_error(NULL, params->decl[i]->decl_type,
+                set_not_matching_types_error(state, NULL,
+                                             params->decl[i]->decl_type,
                                              computed_type, sloc);
                 return false;
             }
         }
         return true;
     }
-    set_not_matching_types_error(NULL, MCC_AST_TYPE_VOID, MCC_AST_TYPE_VOID,
-                                 sloc);
-    snprintf(typecheck_result.err_msg, err_len,
+    set_not_matching_types_error(state, NULL, MCC_AST_TYPE_VOID,
+                                 MCC_AST_TYPE_VOID, sloc);
+    snprintf(state->result.err_msg, err_len,
              "Mismatched number of arguments");
-    typecheck_result.err_loc = sloc;
+    state->result.err_loc = sloc;
     return false;
 }
 
 static inline enum mCc_ast_type
-mCc_check_func_type(struct mCc_ast_function_def *func) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+mCc_check_func_type(struct mCc_typecheck_state *state,
+                    struct mCc_ast_function_def *func) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return MCC_AST_TYPE_VOID;
 
     enum mCc_ast_type func_type = func->identifier->symtab_ref->primitive_type;
@@ -254,19 +263,22 @@ mCc_check_func_type(struct mCc_ast_function_def *func) {
 }
 
 static inline enum mCc_ast_type
-mCc_check_call_expr(struct mCc_ast_expression *call) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+mCc_check_call_expr(struct mCc_typecheck_state *state,
+                    struct mCc_ast_expression *call) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return MCC_AST_TYPE_VOID;
 
-    if (mCc_check_paramaters(call->arguments, call->f_name->symtab_ref->params,
+    if (mCc_check_paramaters(state, call->arguments,
+                             call->f_name->symtab_ref->params,
                              call->node.sloc))
         return call->f_name->symtab_ref->primitive_type;
     return MCC_AST_TYPE_VOID;
 }
 
 static inline enum mCc_ast_type
-mCc_check_expression(struct mCc_ast_expression *expr) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR) {
+mCc_check_expression(struct mCc_typecheck_state *state,
+                     struct mCc_ast_expression *expr) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR) {
         expr->node.computed_type = MCC_AST_TYPE_VOID;
         return MCC_AST_TYPE_VOID;
     }
@@ -282,51 +294,54 @@ mCc_check_expression(struct mCc_ast_expression *expr) {
             break;
 
         case MCC_AST_EXPRESSION_TYPE_UNARY_OP:
-            expr->node.computed_type = mCc_check_unary(expr);
+            expr->node.computed_type = mCc_check_unary(state, expr);
             break;
 
         case MCC_AST_EXPRESSION_TYPE_BINARY_OP:
-            expr->node.computed_type = mCc_check_binary(expr);
+            expr->node.computed_type = mCc_check_binary(state, expr);
             break;
 
         case MCC_AST_EXPRESSION_TYPE_PARENTH:
-            expr->node.computed_type = mCc_check_expression(expr->expression);
+            expr->node.computed_type =
+                    mCc_check_expression(state, expr->expression);
             break;
 
         case MCC_AST_EXPRESSION_TYPE_ARR_SUBSCR:
-            expr->node.computed_type = mCc_check_arr_subscr(expr);
+            expr->node.computed_type = mCc_check_arr_subscr(state, expr);
             break;
 
         case MCC_AST_EXPRESSION_TYPE_CALL_EXPR:
-            expr->node.computed_type = mCc_check_call_expr(expr);
+            expr->node.computed_type = mCc_check_call_expr(state, expr);
             break;
 
         default:
             // Should i even be here?
             break;
     }
-    typecheck_result.type = expr->node.computed_type;
+    state->result.type = expr->node.computed_type;
     return expr->node.computed_type;
 }
 
 /************** STATEMENTS */
 
-static inline bool mCc_check_if(struct mCc_ast_statement *stmt) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_if(struct mCc_typecheck_state *state,
+                                struct mCc_ast_statement *stmt) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
-    enum mCc_ast_type computed_type = mCc_check_expression(stmt->if_cond);
+    enum mCc_ast_type computed_type =
+            mCc_check_expression(state, stmt->if_cond);
     if (computed_type != MCC_AST_TYPE_BOOL) {
-        set_not_matching_types_error("Bool", -1, computed_type,
+        set_not_matching_types_error(state, "Bool", -1, computed_type,
                                      stmt->node.sloc);
         return false;
     }
 
-    bool if_type = mCc_check_statement(stmt->if_stmt);
+    bool if_type = mCc_check_statement(state, stmt->if_stmt);
     bool else_type = true;
 
     if (stmt->type == MCC_AST_STATEMENT_TYPE_IFELSE)
-        else_type = mCc_check_statement(stmt->else_stmt);
+        else_type = mCc_check_statement(state, stmt->else_stmt);
 
     if (if_type && else_type)
         return true;
@@ -334,64 +349,71 @@ static inline bool mCc_check_if(struct mCc_ast_statement *stmt) {
     return false;
 }
 
-static inline bool mCc_check_ret(struct mCc_ast_statement *stmt) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_ret(struct mCc_typecheck_state *state,
+                                 struct mCc_ast_statement *stmt) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
-    enum mCc_ast_type ret_type = mCc_check_expression(stmt->ret_val);
+    enum mCc_ast_type ret_type = mCc_check_expression(state, stmt->ret_val);
 
-    if (ret_type != curr_func->func_type) {
-        set_not_matching_types_error(NULL, curr_func->func_type, ret_type,
-                                     stmt->node.sloc);
+    if (ret_type != state->curr_func->func_type) {
+        set_not_matching_types_error(state, NULL, state->curr_func->func_type,
+                                     ret_type, stmt->node.sloc);
         return false;
     }
     return true;
 }
 
-static inline bool mCc_check_ret_void(struct mCc_ast_statement *stmt) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_ret_void(struct mCc_typecheck_state *state,
+                                      struct mCc_ast_statement *stmt) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
     enum mCc_ast_type ret_type = MCC_AST_TYPE_VOID;
-    if (ret_type != curr_func->func_type) {
-        set_not_matching_types_error(NULL, curr_func->func_type, ret_type,
-                                     stmt->node.sloc);
+    if (ret_type != state->curr_func->func_type) {
+        set_not_matching_types_error(state, NULL, state->curr_func->func_type,
+                                     ret_type, stmt->node.sloc);
         return false;
     }
     return true;
 }
 
-static inline bool mCc_check_while(struct mCc_ast_statement *stmt) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_while(struct mCc_typecheck_state *state,
+                                   struct mCc_ast_statement *stmt) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
-    enum mCc_ast_type computed_type = mCc_check_expression(stmt->while_cond);
+    enum mCc_ast_type computed_type =
+            mCc_check_expression(state, stmt->while_cond);
     if (computed_type != MCC_AST_TYPE_BOOL) {
-        set_not_matching_types_error("Bool", -1, computed_type,
+        set_not_matching_types_error(state, "Bool", -1, computed_type,
                                      stmt->node.sloc);
         return false;
     }
 
-    bool while_type = mCc_check_statement(stmt->while_stmt);
+    bool while_type = mCc_check_statement(state, stmt->while_stmt);
     return while_type;
 }
 
-static inline bool mCc_check_assign(struct mCc_ast_statement *stmt) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_assign(struct mCc_typecheck_state *state,
+                                    struct mCc_ast_statement *stmt) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
     enum mCc_ast_type id_type = stmt->id_assgn->symtab_ref->primitive_type;
-    enum mCc_ast_type rhs_type = mCc_check_expression(stmt->rhs_assgn);
+    enum mCc_ast_type rhs_type = mCc_check_expression(state, stmt->rhs_assgn);
 
     if (id_type != rhs_type) {
-        set_not_matching_types_error(NULL, id_type, rhs_type, stmt->node.sloc);
+        set_not_matching_types_error(state, NULL, id_type, rhs_type,
+                                     stmt->node.sloc);
         return false;
     }
 
     if (stmt->lhs_assgn) {
-        enum mCc_ast_type lhs_type = mCc_check_expression(stmt->lhs_assgn);
+        enum mCc_ast_type lhs_type =
+                mCc_check_expression(state, stmt->lhs_assgn);
         if (lhs_type != MCC_AST_TYPE_INT) {
-            set_not_matching_types_error("Integer", -1, lhs_type,
+            set_not_matching_types_error(state, "Integer", -1, lhs_type,
                                          stmt->node.sloc);
             return false;
         }
@@ -400,13 +422,14 @@ static inline bool mCc_check_assign(struct mCc_ast_statement *stmt) {
     return true;
 }
 
-static inline bool mCc_check_cmpnd(struct mCc_ast_statement *stmt) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_cmpnd(struct mCc_typecheck_state *state,
+                                   struct mCc_ast_statement *stmt) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
     bool all_correct = true;
 
     for (unsigned int i = 0; i < stmt->compound_stmt_count; ++i) {
-        if (!mCc_check_statement(stmt->compound_stmts[i])) {
+        if (!mCc_check_statement(state, stmt->compound_stmts[i])) {
             all_correct = false;
             break;
         }
@@ -459,8 +482,9 @@ static inline bool mCc_check_for_return(struct mCc_ast_statement *stmt){
     return (if_return && else_return);
 }
 
-static inline bool mCc_check_cmpnd_return(struct mCc_ast_statement *stmt) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_cmpnd_return(struct mCc_typecheck_state *state,
+                                          struct mCc_ast_statement *stmt) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
     bool all_way_return = false;
@@ -474,28 +498,29 @@ static inline bool mCc_check_cmpnd_return(struct mCc_ast_statement *stmt) {
     return all_way_return;
 }
 
-static inline bool mCc_check_function(struct mCc_ast_function_def *func) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_function(struct mCc_typecheck_state *state,
+                                      struct mCc_ast_function_def *func) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
     if ((func->func_type == MCC_AST_TYPE_VOID) && !func->body) {
         return true;
     } else if ((func->func_type != MCC_AST_TYPE_VOID) && !func->body) {
-        set_not_matching_types_error(NULL, func->func_type, func->func_type,
-                                     func->node.sloc);
-        snprintf(typecheck_result.err_msg, err_len,
+        set_not_matching_types_error(state, NULL, func->func_type,
+                                     func->func_type, func->node.sloc);
+        snprintf(state->result.err_msg, err_len,
                  "Function %s needs a return statement",
                  func->identifier->id_value);
         return false;
     }
 
     //check functions for correct returns
-    bool check_func_for_return = mCc_check_cmpnd_return(func->body);
+    bool check_func_for_return = mCc_check_cmpnd_return(state, func->body);
     bool general_ret = false;
 
 
     //checks the function in general, if types etc are correct
-    bool check_func = mCc_check_statement(func->body);
+    bool check_func = mCc_check_statement(state, func->body);
 
 
     if (func->func_type == MCC_AST_TYPE_VOID) {
@@ -511,55 +536,58 @@ static inline bool mCc_check_function(struct mCc_ast_function_def *func) {
         }
     }
 
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
 
 
     if (!(check_func && (check_func_for_return || general_ret))) {
-        typecheck_result.status = MCC_TYPECHECK_STATUS_ERROR;
-        snprintf(typecheck_result.err_msg, err_len,
+        state->result.status = MCC_TYPECHECK_STATUS_ERROR;
+        snprintf(state->result.err_msg, err_len,
                  "Function %s may not reach a return",
                  func->identifier->id_value);
-        typecheck_result.err_loc = func->node.sloc;
+        state->result.err_loc = func->node.sloc;
     }
     return (check_func && (check_func_for_return || general_ret));
 }
 
-static inline bool mCc_check_statement(struct mCc_ast_statement *stmt) {
-    if (typecheck_result.status == MCC_TYPECHECK_STATUS_ERROR)
+static inline bool mCc_check_statement(struct mCc_typecheck_state *state,
+                                       struct mCc_ast_statement *stmt) {
+    if (state->result.status == MCC_TYPECHECK_STATUS_ERROR)
         return false;
 
     switch (stmt->type) {
         case MCC_AST_STATEMENT_TYPE_IF:
         case MCC_AST_STATEMENT_TYPE_IFELSE:
-            return mCc_check_if(stmt);
+            return mCc_check_if(state, stmt);
 
         case MCC_AST_STATEMENT_TYPE_RET:
-            return mCc_check_ret(stmt);
+            return mCc_check_ret(state, stmt);
 
         case MCC_AST_STATEMENT_TYPE_RET_VOID:
-            return mCc_check_ret_void(stmt);
+            return mCc_check_ret_void(state, stmt);
 
         case MCC_AST_STATEMENT_TYPE_WHILE:
-            return mCc_check_while(stmt);
+            return mCc_check_while(state, stmt);
 
         case MCC_AST_STATEMENT_TYPE_DECL:
             return true;
 
         case MCC_AST_STATEMENT_TYPE_ASSGN:
-            return mCc_check_assign(stmt);
+            return mCc_check_assign(state, stmt);
 
         case MCC_AST_STATEMENT_TYPE_EXPR:
             if ((stmt->expression->type == MCC_AST_EXPRESSION_TYPE_CALL_EXPR) &&
-                (mCc_check_expression(stmt->expression) == MCC_AST_TYPE_VOID))
+                (mCc_check_expression(state, stmt->expression) ==
+                 MCC_AST_TYPE_VOID))
                 return true;
-            if (mCc_check_expression(stmt->expression) == MCC_AST_TYPE_VOID)
+            if (mCc_check_expression(state, stmt->expression) ==
+                MCC_AST_TYPE_VOID)
                 return false;
             return true;
 
         case MCC_AST_STATEMENT_TYPE_CMPND:
-            return mCc_check_cmpnd(stmt);
+            return mCc_check_cmpnd(state, stmt);
 
         default:
             // Should not be here
@@ -568,9 +596,9 @@ static inline bool mCc_check_statement(struct mCc_ast_statement *stmt) {
     return false; ///< Should never be here
 }
 
-int mCc_typecheck_check_main_properties(struct mCc_symtab_scope *scope) {
-    struct mCc_ast_identifier id;
-    id.id_value = "main";
+int mCc_typecheck_check_main_properties(struct mCc_typecheck_state *state,
+                                        struct mCc_symtab_scope *scope) {
+    struct mCc_ast_identifier id = {.id_value = "main", .atom = MCC_ATOM_NONE};
 
     struct mCc_symtab_entry *entry = mCc_symtab_scope_lookup_id(scope, &id);
 
@@ -580,65 +608,102 @@ int mCc_typecheck_check_main_properties(struct mCc_symtab_scope *scope) {
                 return 0; /// if all properties are full filled
             }
         }
-        set_not_matching_types_error(NULL, MCC_AST_TYPE_VOID, MCC_AST_TYPE_VOID,
-                                     entry->sloc);
+        set_not_matching_types_error(state, NULL, MCC_AST_TYPE_VOID,
+                                     MCC_AST_TYPE_VOID, entry->sloc);
         snprintf(
-                typecheck_result.err_msg, err_len,
+                state->result.err_msg, err_len,
                 "Main function has to be void and does not take any arguments");
         return -1;
     }
-    typecheck_result.status = MCC_TYPECHECK_STATUS_ERROR;
-    snprintf(typecheck_result.err_msg, err_len,
+    state->result.status = MCC_TYPECHECK_STATUS_ERROR;
+    snprintf(state->result.err_msg, err_len,
              "Main function has to be present");
     return -1;
 }
 
-struct mCc_typecheck_result mCc_typecheck(struct mCc_ast_program *program,
+struct mCc_typecheck_result mCc_typecheck(struct mCc_context *ctx,
+                                          struct mCc_ast_program *program,
                                           struct mCc_symtab_scope *scope) {
+    struct mCc_typecheck_state *state = &ctx->typecheck;
+    memset(&state->result, 0, sizeof(state->result));
+    state->curr_func = NULL;
 
-    if (mCc_typecheck_check_main_properties(scope) == -1) {
-        return typecheck_result;
+    if (mCc_typecheck_check_main_properties(state, scope) == -1) {
+        mCc_source_resolve(program->source, &state->result.err_loc);
+        return state->result;
     }
 
     bool all_correct = true;
     for (unsigned int i = 0; i < program->func_def_count; i++) {
-        curr_func = program->func_defs[i];
-        all_correct = mCc_check_function(curr_func);
+        state->curr_func = program->func_defs[i];
+        all_correct = mCc_check_function(state, state->curr_func);
         if (!all_correct)
             break;
     }
 
-    return typecheck_result;
+    mCc_source_resolve(program->source, &state->result.err_loc);
+    return state->result;
+}
+
+struct mCc_typecheck_result mCc_typecheck_main(struct mCc_context *ctx,
+                                               struct mCc_symtab_scope *scope,
+                                               struct mCc_source *source) {
+    struct mCc_typecheck_state *state = &ctx->typecheck;
+    memset(&state->result, 0, sizeof(state->result));
+    state->curr_func = NULL;
+
+    mCc_typecheck_check_main_properties(state, scope);
+    mCc_source_resolve(source, &state->result.err_loc);
+    return state->result;
+}
+
+struct mCc_typecheck_result
+mCc_typecheck_function(struct mCc_context *ctx,
+                       struct mCc_ast_function_def *func,
+                       struct mCc_source *source) {
+    struct mCc_typecheck_state *state = &ctx->typecheck;
+    memset(&state->result, 0, sizeof(state->result));
+    state->curr_func = func;
+
+    mCc_check_function(state, func);
+    mCc_source_resolve(source, &state->result.err_loc);
+    return state->result;
 }
 
 /**
  * Dummy Functions for testing
  */
 struct mCc_typecheck_result
-mCc_typecheck_test_type_check(struct mCc_ast_expression *expression) {
-    typecheck_result.status = MCC_TYPECHECK_STATUS_OK;
-    typecheck_result.type = mCc_check_expression(expression);
-    return typecheck_result;
+mCc_typecheck_test_type_check(struct mCc_context *ctx,
+                              struct mCc_ast_expression *expression) {
+    struct mCc_typecheck_state *state = &ctx->typecheck;
+    state->result.status = MCC_TYPECHECK_STATUS_OK;
+    state->result.type = mCc_check_expression(state, expression);
+    return state->result;
 }
 
 struct mCc_typecheck_result
-mCc_typecheck_test_type_check_stmt(struct mCc_ast_statement *stmt) {
-    typecheck_result.status = MCC_TYPECHECK_STATUS_OK;
-    if (!mCc_check_statement(stmt))
-        typecheck_result.status = MCC_TYPECHECK_STATUS_ERROR;
-    return typecheck_result;
+mCc_typecheck_test_type_check_stmt(struct mCc_context *ctx,
+                                   struct mCc_ast_statement *stmt) {
+    struct mCc_typecheck_state *state = &ctx->typecheck;
+    state->result.status = MCC_TYPECHECK_STATUS_OK;
+    if (!mCc_check_statement(state, stmt))
+        state->result.status = MCC_TYPECHECK_STATUS_ERROR;
+    return state->result;
 }
 
 struct mCc_typecheck_result
-mCc_typecheck_test_type_check_program(struct mCc_ast_program *prog) {
-    typecheck_result.status = MCC_TYPECHECK_STATUS_OK;
+mCc_typecheck_test_type_check_program(struct mCc_context *ctx,
+                                      struct mCc_ast_program *prog) {
+    struct mCc_typecheck_state *state = &ctx->typecheck;
+    state->result.status = MCC_TYPECHECK_STATUS_OK;
 
     bool all_correct = true;
     for (unsigned int i = 0; i < prog->func_def_count; i++) {
-        curr_func = prog->func_defs[i];
-        all_correct = mCc_check_function(curr_func);
+        state->curr_func = prog->func_defs[i];
+        all_correct = mCc_check_function(state, state->curr_func);
         if (!all_correct)
             break;
     }
-    return typecheck_result;
+    return state->result;
 }
@@ -0,0 +1,196 @@
+/**
+ * @file writer.c
+ * @brief Buffered output shared by the code generator and the printers.
+ * @author richard
+ * @date 2018-06-24
+ */
+#include "mCc/writer.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void mCc_writer_init(struct mCc_writer *w, enum mCc_writer_sink sink) {
+    w->sink = sink;
+    w->file = NULL;
+    w->fd = -1;
+    w->memory = NULL;
+    w->memory_size = 0;
+    w->memory_capacity = 0;
+    w->error = false;
+    w->len = 0;
+}
+
+void mCc_writer_init_file(struct mCc_writer *w, FILE *file) {
+    mCc_writer_init(w, MCC_WRITER_SINK_FILE);
+    w->file = file;
+}
+
+void mCc_writer_init_fd(struct mCc_writer *w, int fd) {
+    mCc_writer_init(w, MCC_WRITER_SINK_FD);
+    w->fd = fd;
+}
+
+void mCc_writer_init_memory(struct mCc_writer *w) {
+    mCc_writer_init(w, MCC_WRITER_SINK_MEMORY);
+}
+
+/* Append to the memory sink, keeping room for a terminating NUL */
+static int mCc_writer_append_memory(struct mCc_writer *w, const char *data,
+                                    size_t size) {
+    if (w->memory_size + size + 1 > w->memory_capacity) {
+        size_t capacity = w->memory_capacity ? w->memory_capacity : 4096;
+        while (w->memory_size + size + 1 > capacity)
+            capacity *= 2;
+        char *memory = realloc(w->memory, capacity);
+        if (!memory)
+            return 1;
+        w->memory = memory;
+        w->memory_capacity = capacity;
+    }
+    memcpy(w->memory + w->memory_size, data, size);
+    w->memory_size += size;
+    return 0;
+}
+
+static int mCc_writer_sink(struct mCc_writer *w, const char *data,
+                           size_t size) {
+    switch (w->sink) {
+        case MCC_WRITER_SINK_FILE:
+            return fwrite(data, 1, size, w->file) != size;
+        case MCC_WRITER_SINK_FD:
+            while (size) {
+                ssize_t ret = write(w->fd, data, size);
+                if (ret < 0 && errno == EINTR)
+                    continue;
+                if (ret <= 0)
+                    return 1;
+                data += ret;
+                size -= ret;
+            }
+            return 0;
+        case MCC_WRITER_SINK_MEMORY:
+            return mCc_writer_append_memory(w, data, size);
+    }
+    return 1;
+}
+
+int mCc_writer_flush(struct mCc_writer *w) {
+    if (w->len && !w->error && mCc_writer_sink(w, w->buf, w->len))
+        w->error = true;
+    w->len = 0;
+    return w->error;
+}
+
+int mCc_writer_close(struct mCc_writer *w) {
+    int ret = mCc_writer_flush(w);
+    free(w->memory);
+    w->memory = NULL;
+    w->memory_size = w->memory_capacity = 0;
+    return ret;
+}
+
+char *mCc_writer_take_memory(struct mCc_writer *w, size_t *size) {
+    if (mCc_writer_flush(w) || mCc_writer_append_memory(w, "", 0)) {
+        mCc_writer_close(w);
+        return NULL;
+    }
+    char *memory = w->memory;
+    memory[w->memory_size] = '\0';
+    *size = w->memory_size;
+    w->memory = NULL;
+    w->memory_size = w->memory_capacity = 0;
+    return memory;
+}
+
+void mCc_writer_write(struct mCc_writer *w, const void *data, size_t size) {
+    if (size <= MCC_WRITER_BUFFER_SIZE - w->len) {
+        memcpy(w->buf + w->len, data, size);
+        w->len += size;
+        return;
+    }
+    mCc_writer_flush(w);
+    if (size < MCC_WRITER_BUFFER_SIZE) {
+        memcpy(w->buf, data, size);
+        w->len = size;
+    } else if (!w->error && mCc_writer_sink(w, data, size)) {
+        w->error = true;
+    }
+}
+
+void mCc_writer_uint(struct mCc_writer *w, unsigned long value) {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    mCc_writer_write(w, p, digits + sizeof(digits) - p);
+}
+
+void mCc_writer_int(struct mCc_writer *w, long value) {
+    if (value < 0) {
+        mCc_writer_putc(w, '-');
+        mCc_writer_uint(w, -(unsigned long)value);
+    } else {
+        mCc_writer_uint(w, value);
+    }
+}
+
+void mCc_writer_ptr(struct mCc_writer *w, const void *ptr) {
+    static const char hex[] = "0123456789abcdef";
+    if (!ptr) {
+        mCc_writer_puts(w, "(nil)");
+        return;
+    }
+    char digits[2 + 2 * sizeof(void *)];
+    char *p = digits + sizeof(digits);
+    for (size_t value = (size_t)ptr; value; value >>= 4)
+        *--p = hex[value & 0xf];
+    *--p = 'x';
+    *--p = '0';
+    mCc_writer_write(w, p, digits + sizeof(digits) - p);
+}
+
+void mCc_writer_reg(struct mCc_writer *w, const char *name) {
+    mCc_writer_putc(w, '%');
+    mCc_writer_puts(w, name);
+}
+
+void mCc_writer_mem(struct mCc_writer *w, int disp, const char *base) {
+    mCc_writer_int(w, disp);
+    mCc_writer_putc(w, '(');
+    mCc_writer_reg(w, base);
+    mCc_writer_putc(w, ')');
+}
+
+void mCc_writer_printf(struct mCc_writer *w, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(w->buf + w->len, MCC_WRITER_BUFFER_SIZE - w->len,
+                        format, args);
+    va_end(args);
+    if (len < 0 || (size_t)len < MCC_WRITER_BUFFER_SIZE - w->len) {
+        if (len > 0)
+            w->len += len;
+        return;
+    }
+
+    // Did not fit, retry in an empty buffer or a temporary one
+    mCc_writer_flush(w);
+    char *tmp = w->buf;
+    if ((size_t)len >= MCC_WRITER_BUFFER_SIZE && !(tmp = malloc(len + 1))) {
+        w->error = true;
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(tmp, len + 1, format, args);
+    va_end(args);
+    if (tmp == w->buf) {
+        w->len = len;
+    } else {
+        mCc_writer_write(w, tmp, len);
+        free(tmp);
+    }
+}
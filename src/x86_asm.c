@@ -0,0 +1,955 @@
+/**
+ * @file x86_asm.c
+ * @brief Integrated assembler for 32-bit x86 in AT&T syntax.
+ * @author richard
+ * @date 2018-06-20
+ */
+#include "mCc/x86_asm.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_OPERANDS (3)
+
+enum mCc_x86_operand_kind {
+    MCC_X86_REG,  ///< 32-bit general-purpose register
+    MCC_X86_REG8, ///< 8-bit register
+    MCC_X86_XMM,  ///< SSE register
+    MCC_X86_IMM,  ///< Immediate, $value or $symbol
+    MCC_X86_MEM   ///< Memory, or the target of a jump or call
+};
+
+struct mCc_x86_operand {
+    enum mCc_x86_operand_kind kind;
+    int reg;       ///< Register number
+    int32_t value; ///< Immediate or displacement
+    int symbol;    ///< Symbol added to value, or -1
+    int base;      ///< Base register, or -1
+    int index;     ///< Index register, or -1
+    int scale;
+};
+
+/// Branch to a label, resolved at the end of the input
+struct mCc_x86_fixup {
+    int section;
+    uint32_t offset;
+    unsigned int symbol;
+};
+
+struct mCc_x86_state {
+    struct mCc_elf_object *obj;
+    struct mCc_elf_error *error;
+    int section;
+    struct mCc_x86_fixup *fixups;
+    unsigned int fixup_count;
+    unsigned int fixup_capacity;
+    bool in_string; ///< Inside a string literal continued from the last line
+};
+
+static const char *const reg32_names[] = {"eax", "ecx", "edx", "ebx",
+                                          "esp", "ebp", "esi", "edi"};
+static const char *const reg8_names[] = {"al", "cl", "dl", "bl",
+                                         "ah", "ch", "dh", "bh"};
+
+/// Condition codes of j<cc>, set<cc> and cmov<cc>
+static const struct {
+    const char *name;
+    unsigned char code;
+} condition_codes[] = {
+    {"o", 0x0},  {"no", 0x1},  {"b", 0x2},  {"c", 0x2},   {"nae", 0x2},
+    {"ae", 0x3}, {"nb", 0x3},  {"nc", 0x3}, {"e", 0x4},   {"z", 0x4},
+    {"ne", 0x5}, {"nz", 0x5},  {"be", 0x6}, {"na", 0x6},  {"a", 0x7},
+    {"nbe", 0x7}, {"s", 0x8},  {"ns", 0x9}, {"p", 0xa},   {"pe", 0xa},
+    {"np", 0xb}, {"po", 0xb},  {"l", 0xc},  {"nge", 0xc}, {"ge", 0xd},
+    {"nl", 0xd}, {"le", 0xe},  {"ng", 0xe}, {"g", 0xf},   {"nle", 0xf},
+};
+
+/// Integer instructions with the opcode extension of their group
+static const struct {
+    const char *name;
+    enum {
+        MCC_X86_ALU,   ///< add, or, ..., cmp
+        MCC_X86_UNARY, ///< Group 3: not, neg, mul, imul, div, idiv
+        MCC_X86_SHIFT, ///< Group 2
+        MCC_X86_INCDEC ///< Group 5: inc, dec
+    } group;
+    unsigned char ext;
+} integer_ops[] = {
+    {"add", MCC_X86_ALU, 0},    {"or", MCC_X86_ALU, 1},
+    {"adc", MCC_X86_ALU, 2},    {"sbb", MCC_X86_ALU, 3},
+    {"and", MCC_X86_ALU, 4},    {"sub", MCC_X86_ALU, 5},
+    {"xor", MCC_X86_ALU, 6},    {"cmp", MCC_X86_ALU, 7},
+    {"not", MCC_X86_UNARY, 2},  {"neg", MCC_X86_UNARY, 3},
+    {"mul", MCC_X86_UNARY, 4},  {"imul", MCC_X86_UNARY, 5},
+    {"div", MCC_X86_UNARY, 6},  {"idiv", MCC_X86_UNARY, 7},
+    {"rol", MCC_X86_SHIFT, 0},  {"ror", MCC_X86_SHIFT, 1},
+    {"shl", MCC_X86_SHIFT, 4},  {"sal", MCC_X86_SHIFT, 4},
+    {"shr", MCC_X86_SHIFT, 5},  {"sar", MCC_X86_SHIFT, 7},
+    {"inc", MCC_X86_INCDEC, 0}, {"dec", MCC_X86_INCDEC, 1},
+};
+
+/// x87 instructions on a single precision memory operand: opcode and /digit
+static const struct {
+    const char *name;
+    unsigned char opcode;
+    unsigned char ext;
+} x87_mem_ops[] = {
+    {"flds", 0xd9, 0},  {"fsts", 0xd9, 2},   {"fstps", 0xd9, 3},
+    {"fadds", 0xd8, 0}, {"fmuls", 0xd8, 1},  {"fcoms", 0xd8, 2},
+    {"fcomps", 0xd8, 3}, {"fsubs", 0xd8, 4}, {"fsubrs", 0xd8, 5},
+    {"fdivs", 0xd8, 6}, {"fdivrs", 0xd8, 7}, {"fildl", 0xdb, 0},
+    {"fistl", 0xdb, 2}, {"fistpl", 0xdb, 3},
+};
+
+/// Instructions without operands
+static const struct {
+    const char *name;
+    unsigned char bytes[2];
+    unsigned char size;
+} plain_ops[] = {
+    {"cltd", {0x99}, 1}, {"cdq", {0x99}, 1},         {"leave", {0xc9}, 1},
+    {"ret", {0xc3}, 1},  {"nop", {0x90}, 1},         {"hlt", {0xf4}, 1},
+    {"fchs", {0xd9, 0xe0}, 2}, {"fabs", {0xd9, 0xe1}, 2},
+};
+
+/// SSE instructions from xmm/m128 to xmm: mandatory prefix (or 0), opcode
+static const struct {
+    const char *name;
+    unsigned char prefix;
+    unsigned char opcode;
+} sse_ops[] = {
+    {"pxor", 0x66, 0xef},  {"por", 0x66, 0xeb},   {"pand", 0x66, 0xdb},
+    {"paddd", 0x66, 0xfe}, {"psubd", 0x66, 0xfa}, {"addps", 0, 0x58},
+    {"subps", 0, 0x5c},    {"mulps", 0, 0x59},    {"divps", 0, 0x5e},
+    {"xorps", 0, 0x57},
+};
+
+/*********************************** Errors and output */
+
+static int mCc_x86_error(struct mCc_x86_state *state, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(state->error->msg, sizeof(state->error->msg), fmt, args);
+    va_end(args);
+    return 1;
+}
+
+static struct mCc_elf_section *mCc_x86_section(struct mCc_x86_state *state) {
+    return &state->obj->sections[state->section];
+}
+
+static int mCc_x86_emit(struct mCc_x86_state *state, const void *bytes,
+                        uint32_t size) {
+    if (mCc_elf_section_append(mCc_x86_section(state), bytes, size))
+        return mCc_x86_error(state, "memory error");
+    return 0;
+}
+
+static int mCc_x86_emit_byte(struct mCc_x86_state *state, unsigned int byte) {
+    unsigned char b = byte;
+    return mCc_x86_emit(state, &b, 1);
+}
+
+/// Emit a 32-bit value, relocated against symbol unless it is -1
+static int mCc_x86_emit32(struct mCc_x86_state *state, uint32_t value,
+                          int symbol) {
+    unsigned char bytes[4] = {value & 0xff, (value >> 8) & 0xff,
+                              (value >> 16) & 0xff, value >> 24};
+    struct mCc_elf_section *section = mCc_x86_section(state);
+    if (symbol >= 0 && mCc_elf_add_reloc(section, section->size,
+                                         MCC_ELF_R_386_32, symbol))
+        return mCc_x86_error(state, "memory error");
+    return mCc_x86_emit(state, bytes, sizeof(bytes));
+}
+
+/// Emit a ModRM byte, with SIB byte and displacement for memory operands
+static int mCc_x86_emit_modrm(struct mCc_x86_state *state, unsigned int reg,
+                              const struct mCc_x86_operand *rm) {
+    reg = (reg & 7) << 3;
+    if (rm->kind != MCC_X86_MEM)
+        return mCc_x86_emit_byte(state, 0xc0 | reg | rm->reg);
+
+    if (rm->base < 0 && rm->index < 0) {
+        return mCc_x86_emit_byte(state, 0x05 | reg) ||
+               mCc_x86_emit32(state, rm->value, rm->symbol);
+    }
+    unsigned int mod;
+    if (rm->base < 0 || rm->symbol >= 0 || rm->value < -128 ||
+        rm->value > 127)
+        mod = 0x80;
+    else if (rm->value != 0 || rm->base == 5) // %ebp needs a displacement
+        mod = 0x40;
+    else
+        mod = 0x00;
+
+    int ret;
+    if (rm->index >= 0 || rm->base == 4) { // SIB byte
+        static const unsigned char scales[9] = {0, 0, 1, 0, 2, 0, 0, 0, 3};
+        unsigned int index = rm->index >= 0 ? rm->index : 4;
+        unsigned int base = rm->base >= 0 ? rm->base : 5;
+        if (rm->base < 0)
+            mod = 0x00; // disp32 without base
+        ret = mCc_x86_emit_byte(state, mod | reg | 4) ||
+              mCc_x86_emit_byte(state, scales[rm->scale] << 6 | index << 3 |
+                                           base);
+    } else {
+        ret = mCc_x86_emit_byte(state, mod | reg | rm->base);
+    }
+    if (ret)
+        return ret;
+    if (mod == 0x40)
+        return mCc_x86_emit_byte(state, rm->value & 0xff);
+    if (mod == 0x80 || rm->base < 0)
+        return mCc_x86_emit32(state, rm->value, rm->symbol);
+    return 0;
+}
+
+static int mCc_x86_emit_fixup(struct mCc_x86_state *state,
+                              const struct mCc_x86_operand *target) {
+    if (target->kind != MCC_X86_MEM || target->symbol < 0 ||
+        target->base >= 0 || target->index >= 0)
+        return mCc_x86_error(state, "expected a label");
+    if (state->fixup_count == state->fixup_capacity) {
+        unsigned int capacity =
+            state->fixup_capacity ? 2 * state->fixup_capacity : 64;
+        struct mCc_x86_fixup *tmp =
+            realloc(state->fixups, capacity * sizeof(*tmp));
+        if (!tmp)
+            return mCc_x86_error(state, "memory error");
+        state->fixups = tmp;
+        state->fixup_capacity = capacity;
+    }
+    struct mCc_x86_fixup *fixup = &state->fixups[state->fixup_count++];
+    fixup->section = state->section;
+    fixup->offset = mCc_x86_section(state)->size;
+    fixup->symbol = target->symbol;
+    return mCc_x86_emit32(state, target->value, -1);
+}
+
+/*********************************** Parsing */
+
+static char *mCc_x86_skip_space(char *s) {
+    while (isspace((unsigned char)*s))
+        ++s;
+    return s;
+}
+
+static bool mCc_x86_is_symbol_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+/// Length of the symbol at s, 0 if there is none
+static size_t mCc_x86_symbol_length(const char *s) {
+    if (!isalpha((unsigned char)*s) && *s != '_' && *s != '.')
+        return 0;
+    size_t len = 1;
+    while (mCc_x86_is_symbol_char(s[len]))
+        ++len;
+    return len;
+}
+
+/// Parse a number or a symbol, optionally followed by + or - and a number
+static int mCc_x86_parse_value(struct mCc_x86_state *state, char **s,
+                               int32_t *value, int *symbol) {
+    *value = 0;
+    *symbol = -1;
+    size_t len = mCc_x86_symbol_length(*s);
+    if (len) {
+        char saved = (*s)[len];
+        (*s)[len] = '\0';
+        *symbol = mCc_elf_get_symbol(state->obj, *s);
+        (*s)[len] = saved;
+        if (*symbol < 0)
+            return mCc_x86_error(state, "memory error");
+        *s += len;
+        if (**s != '+' && **s != '-')
+            return 0;
+    }
+    char *end;
+    long long number = strtoll(*s, &end, 0);
+    if (end == *s || number < INT32_MIN || number > UINT32_MAX)
+        return mCc_x86_error(state, "invalid number");
+    *value = (int32_t)(uint32_t)number;
+    *s = end;
+    return 0;
+}
+
+static int mCc_x86_parse_register(struct mCc_x86_state *state, char **s,
+                                  struct mCc_x86_operand *op) {
+    char *name = ++*s;
+    size_t len = 0;
+    while (isalnum((unsigned char)name[len]))
+        ++len;
+    *s += len;
+    for (int i = 0; i < 8; ++i) {
+        if (strlen(reg32_names[i]) == len &&
+            strncmp(name, reg32_names[i], len) == 0) {
+            op->kind = MCC_X86_REG;
+            op->reg = i;
+            return 0;
+        }
+        if (strlen(reg8_names[i]) == len &&
+            strncmp(name, reg8_names[i], len) == 0) {
+            op->kind = MCC_X86_REG8;
+            op->reg = i;
+            return 0;
+        }
+    }
+    if (len == 4 && strncmp(name, "xmm", 3) == 0 && name[3] >= '0' &&
+        name[3] <= '7') {
+        op->kind = MCC_X86_XMM;
+        op->reg = name[3] - '0';
+        return 0;
+    }
+    return mCc_x86_error(state, "unknown register %%%.*s", (int)len, name);
+}
+
+static int mCc_x86_parse_operand(struct mCc_x86_state *state, char *s,
+                                 struct mCc_x86_operand *op) {
+    memset(op, 0, sizeof(*op));
+    op->symbol = op->base = op->index = -1;
+    op->scale = 1;
+    if (*s == '%') {
+        if (mCc_x86_parse_register(state, &s, op))
+            return 1;
+    } else if (*s == '$') {
+        ++s;
+        op->kind = MCC_X86_IMM;
+        if (mCc_x86_parse_value(state, &s, &op->value, &op->symbol))
+            return 1;
+    } else {
+        op->kind = MCC_X86_MEM;
+        if (*s != '(' &&
+            mCc_x86_parse_value(state, &s, &op->value, &op->symbol))
+            return 1;
+        if (*s == '(') {
+            struct mCc_x86_operand reg;
+            s = mCc_x86_skip_space(s + 1);
+            if (*s == '%') {
+                if (mCc_x86_parse_register(state, &s, &reg))
+                    return 1;
+                if (reg.kind != MCC_X86_REG)
+                    return mCc_x86_error(state, "invalid base register");
+                op->base = reg.reg;
+            }
+            s = mCc_x86_skip_space(s);
+            if (*s == ',') {
+                s = mCc_x86_skip_space(s + 1);
+                if (*s != '%')
+                    return mCc_x86_error(state, "expected index register");
+                if (mCc_x86_parse_register(state, &s, &reg))
+                    return 1;
+                if (reg.kind != MCC_X86_REG || reg.reg == 4)
+                    return mCc_x86_error(state, "invalid index register");
+                op->index = reg.reg;
+                s = mCc_x86_skip_space(s);
+                if (*s == ',') {
+                    op->scale = strtol(s + 1, &s, 10);
+                    if (op->scale != 1 && op->scale != 2 && op->scale != 4 &&
+                        op->scale != 8)
+                        return mCc_x86_error(state, "invalid scale");
+                }
+            }
+            s = mCc_x86_skip_space(s);
+            if (*s++ != ')')
+                return mCc_x86_error(state, "expected )");
+        }
+    }
+    if (*mCc_x86_skip_space(s))
+        return mCc_x86_error(state, "junk after operand");
+    return 0;
+}
+
+/// Split comma-separated operands outside of parentheses, trims them in place
+static int mCc_x86_split_operands(struct mCc_x86_state *state, char *s,
+                                  char **ops) {
+    int count = 0, depth = 0;
+    s = mCc_x86_skip_space(s);
+    if (!*s)
+        return 0;
+    ops[count++] = s;
+    for (; *s; ++s) {
+        if (*s == '(') {
+            ++depth;
+        } else if (*s == ')') {
+            --depth;
+        } else if (*s == ',' && depth == 0) {
+            if (count == MAX_OPERANDS) {
+                mCc_x86_error(state, "too many operands");
+                return -1;
+            }
+            *s = '\0';
+            ops[count++] = mCc_x86_skip_space(s + 1);
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        char *end = ops[i] + strlen(ops[i]);
+        while (end > ops[i] && isspace((unsigned char)end[-1]))
+            *--end = '\0';
+    }
+    return count;
+}
+
+/*********************************** Instructions */
+
+static bool mCc_x86_is_rm(const struct mCc_x86_operand *op) {
+    return op->kind == MCC_X86_REG || op->kind == MCC_X86_MEM;
+}
+
+static bool mCc_x86_is_imm8(const struct mCc_x86_operand *op) {
+    return op->symbol < 0 && op->value >= -128 && op->value <= 127;
+}
+
+/// Condition code of a mnemonic suffix, or -1
+static int mCc_x86_condition(const char *name) {
+    for (size_t i = 0; i < sizeof(condition_codes) / sizeof(*condition_codes);
+         ++i) {
+        if (strcmp(name, condition_codes[i].name) == 0)
+            return condition_codes[i].code;
+    }
+    return -1;
+}
+
+static int mCc_x86_integer_op(struct mCc_x86_state *state, int i, int n,
+                              struct mCc_x86_operand *op) {
+    unsigned int ext = integer_ops[i].ext;
+    switch (integer_ops[i].group) {
+    case MCC_X86_ALU:
+        if (n != 2)
+            break;
+        if (op[0].kind == MCC_X86_IMM && mCc_x86_is_rm(&op[1])) {
+            if (mCc_x86_is_imm8(&op[0]))
+                return mCc_x86_emit_byte(state, 0x83) ||
+                       mCc_x86_emit_modrm(state, ext, &op[1]) ||
+                       mCc_x86_emit_byte(state, op[0].value & 0xff);
+            return mCc_x86_emit_byte(state, 0x81) ||
+                   mCc_x86_emit_modrm(state, ext, &op[1]) ||
+                   mCc_x86_emit32(state, op[0].value, op[0].symbol);
+        }
+        if (op[0].kind == MCC_X86_REG && mCc_x86_is_rm(&op[1]))
+            return mCc_x86_emit_byte(state, 0x01 + 8 * ext) ||
+                   mCc_x86_emit_modrm(state, op[0].reg, &op[1]);
+        if (op[0].kind == MCC_X86_MEM && op[1].kind == MCC_X86_REG)
+            return mCc_x86_emit_byte(state, 0x03 + 8 * ext) ||
+                   mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+        break;
+    case MCC_X86_UNARY:
+        if (n == 1 && mCc_x86_is_rm(&op[0]))
+            return mCc_x86_emit_byte(state, 0xf7) ||
+                   mCc_x86_emit_modrm(state, ext, &op[0]);
+        if (ext == 5 && n == 2 && mCc_x86_is_rm(&op[0]) &&
+            op[1].kind == MCC_X86_REG) // imul r/m32, r32
+            return mCc_x86_emit_byte(state, 0x0f) ||
+                   mCc_x86_emit_byte(state, 0xaf) ||
+                   mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+        break;
+    case MCC_X86_SHIFT:
+        if (n == 2 && op[0].kind == MCC_X86_IMM && mCc_x86_is_imm8(&op[0]) &&
+            mCc_x86_is_rm(&op[1]))
+            return mCc_x86_emit_byte(state, 0xc1) ||
+                   mCc_x86_emit_modrm(state, ext, &op[1]) ||
+                   mCc_x86_emit_byte(state, op[0].value & 0xff);
+        if (n == 2 && op[0].kind == MCC_X86_REG8 && op[0].reg == 1 &&
+            mCc_x86_is_rm(&op[1]))
+            return mCc_x86_emit_byte(state, 0xd3) ||
+                   mCc_x86_emit_modrm(state, ext, &op[1]);
+        break;
+    case MCC_X86_INCDEC:
+        if (n == 1 && mCc_x86_is_rm(&op[0]))
+            return mCc_x86_emit_byte(state, 0xff) ||
+                   mCc_x86_emit_modrm(state, ext, &op[0]);
+        break;
+    }
+    return mCc_x86_error(state, "invalid operands for %s",
+                         integer_ops[i].name);
+}
+
+static int mCc_x86_mov(struct mCc_x86_state *state, int n,
+                       struct mCc_x86_operand *op) {
+    if (n != 2)
+        return mCc_x86_error(state, "invalid operands for mov");
+    if (op[0].kind == MCC_X86_IMM && op[1].kind == MCC_X86_REG)
+        return mCc_x86_emit_byte(state, 0xb8 + op[1].reg) ||
+               mCc_x86_emit32(state, op[0].value, op[0].symbol);
+    if (op[0].kind == MCC_X86_IMM && op[1].kind == MCC_X86_MEM)
+        return mCc_x86_emit_byte(state, 0xc7) ||
+               mCc_x86_emit_modrm(state, 0, &op[1]) ||
+               mCc_x86_emit32(state, op[0].value, op[0].symbol);
+    if (op[0].kind == MCC_X86_REG && mCc_x86_is_rm(&op[1]))
+        return mCc_x86_emit_byte(state, 0x89) ||
+               mCc_x86_emit_modrm(state, op[0].reg, &op[1]);
+    if (op[0].kind == MCC_X86_MEM && op[1].kind == MCC_X86_REG)
+        return mCc_x86_emit_byte(state, 0x8b) ||
+               mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+    return mCc_x86_error(state, "invalid operands for mov");
+}
+
+/// Instructions on general-purpose registers, with or without an l suffix
+static int mCc_x86_general_op(struct mCc_x86_state *state, const char *name,
+                              int n, struct mCc_x86_operand *op) {
+    for (size_t i = 0; i < sizeof(integer_ops) / sizeof(*integer_ops); ++i) {
+        if (strcmp(name, integer_ops[i].name) == 0)
+            return mCc_x86_integer_op(state, i, n, op);
+    }
+    if (strcmp(name, "mov") == 0)
+        return mCc_x86_mov(state, n, op);
+    if (strcmp(name, "lea") == 0 && n == 2 && op[0].kind == MCC_X86_MEM &&
+        op[1].kind == MCC_X86_REG)
+        return mCc_x86_emit_byte(state, 0x8d) ||
+               mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+    if (strcmp(name, "test") == 0 && n == 2 && mCc_x86_is_rm(&op[1])) {
+        if (op[0].kind == MCC_X86_REG)
+            return mCc_x86_emit_byte(state, 0x85) ||
+                   mCc_x86_emit_modrm(state, op[0].reg, &op[1]);
+        if (op[0].kind == MCC_X86_IMM)
+            return mCc_x86_emit_byte(state, 0xf7) ||
+                   mCc_x86_emit_modrm(state, 0, &op[1]) ||
+                   mCc_x86_emit32(state, op[0].value, op[0].symbol);
+    }
+    if (strcmp(name, "push") == 0 && n == 1) {
+        if (op[0].kind == MCC_X86_REG)
+            return mCc_x86_emit_byte(state, 0x50 + op[0].reg);
+        if (op[0].kind == MCC_X86_MEM)
+            return mCc_x86_emit_byte(state, 0xff) ||
+                   mCc_x86_emit_modrm(state, 6, &op[0]);
+        if (op[0].kind == MCC_X86_IMM)
+            return mCc_x86_emit_byte(state, 0x68) ||
+                   mCc_x86_emit32(state, op[0].value, op[0].symbol);
+    }
+    if (strcmp(name, "pop") == 0 && n == 1) {
+        if (op[0].kind == MCC_X86_REG)
+            return mCc_x86_emit_byte(state, 0x58 + op[0].reg);
+        if (op[0].kind == MCC_X86_MEM)
+            return mCc_x86_emit_byte(state, 0x8f) ||
+                   mCc_x86_emit_modrm(state, 0, &op[0]);
+    }
+    if (strncmp(name, "cmov", 4) == 0 && mCc_x86_condition(name + 4) >= 0 &&
+        n == 2 && mCc_x86_is_rm(&op[0]) && op[1].kind == MCC_X86_REG)
+        return mCc_x86_emit_byte(state, 0x0f) ||
+               mCc_x86_emit_byte(state, 0x40 + mCc_x86_condition(name + 4)) ||
+               mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+    return -1;
+}
+
+static int mCc_x86_sse_op(struct mCc_x86_state *state, const char *name, int n,
+                          struct mCc_x86_operand *op) {
+    for (size_t i = 0; i < sizeof(sse_ops) / sizeof(*sse_ops); ++i) {
+        if (strcmp(name, sse_ops[i].name) != 0)
+            continue;
+        if (n != 2 || op[1].kind != MCC_X86_XMM ||
+            (op[0].kind != MCC_X86_XMM && op[0].kind != MCC_X86_MEM))
+            return mCc_x86_error(state, "invalid operands for %s", name);
+        return (sse_ops[i].prefix &&
+                mCc_x86_emit_byte(state, sse_ops[i].prefix)) ||
+               mCc_x86_emit_byte(state, 0x0f) ||
+               mCc_x86_emit_byte(state, sse_ops[i].opcode) ||
+               mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+    }
+    bool aligned = strcmp(name, "movdqa") == 0;
+    if (aligned || strcmp(name, "movdqu") == 0) {
+        unsigned int prefix = aligned ? 0x66 : 0xf3;
+        if (n == 2 && op[1].kind == MCC_X86_XMM &&
+            (op[0].kind == MCC_X86_XMM || op[0].kind == MCC_X86_MEM))
+            return mCc_x86_emit_byte(state, prefix) ||
+                   mCc_x86_emit_byte(state, 0x0f) ||
+                   mCc_x86_emit_byte(state, 0x6f) ||
+                   mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+        if (n == 2 && op[0].kind == MCC_X86_XMM && op[1].kind == MCC_X86_MEM)
+            return mCc_x86_emit_byte(state, prefix) ||
+                   mCc_x86_emit_byte(state, 0x0f) ||
+                   mCc_x86_emit_byte(state, 0x7f) ||
+                   mCc_x86_emit_modrm(state, op[0].reg, &op[1]);
+        return mCc_x86_error(state, "invalid operands for %s", name);
+    }
+    if (strcmp(name, "movd") == 0) {
+        if (n == 2 && mCc_x86_is_rm(&op[0]) && op[1].kind == MCC_X86_XMM)
+            return mCc_x86_emit_byte(state, 0x66) ||
+                   mCc_x86_emit_byte(state, 0x0f) ||
+                   mCc_x86_emit_byte(state, 0x6e) ||
+                   mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+        if (n == 2 && op[0].kind == MCC_X86_XMM && mCc_x86_is_rm(&op[1]))
+            return mCc_x86_emit_byte(state, 0x66) ||
+                   mCc_x86_emit_byte(state, 0x0f) ||
+                   mCc_x86_emit_byte(state, 0x7e) ||
+                   mCc_x86_emit_modrm(state, op[0].reg, &op[1]);
+        return mCc_x86_error(state, "invalid operands for movd");
+    }
+    if (strcmp(name, "pshufd") == 0) {
+        if (n == 3 && op[0].kind == MCC_X86_IMM && op[0].symbol < 0 &&
+            op[0].value >= 0 && op[0].value <= 255 &&
+            (op[1].kind == MCC_X86_XMM || op[1].kind == MCC_X86_MEM) &&
+            op[2].kind == MCC_X86_XMM)
+            return mCc_x86_emit_byte(state, 0x66) ||
+                   mCc_x86_emit_byte(state, 0x0f) ||
+                   mCc_x86_emit_byte(state, 0x70) ||
+                   mCc_x86_emit_modrm(state, op[2].reg, &op[1]) ||
+                   mCc_x86_emit_byte(state, op[0].value & 0xff);
+        return mCc_x86_error(state, "invalid operands for pshufd");
+    }
+    return -1;
+}
+
+static int mCc_x86_instruction(struct mCc_x86_state *state, const char *name,
+                               char *operands) {
+    char *texts[MAX_OPERANDS];
+    struct mCc_x86_operand op[MAX_OPERANDS];
+    int n = mCc_x86_split_operands(state, operands, texts);
+    if (n < 0)
+        return 1;
+    for (int i = 0; i < n; ++i) {
+        if (mCc_x86_parse_operand(state, texts[i], &op[i]))
+            return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(plain_ops) / sizeof(*plain_ops); ++i) {
+        if (strcmp(name, plain_ops[i].name) != 0)
+            continue;
+        if (n != 0)
+            return mCc_x86_error(state, "%s takes no operands", name);
+        return mCc_x86_emit(state, plain_ops[i].bytes, plain_ops[i].size);
+    }
+    if (strcmp(name, "call") == 0 && n == 1)
+        return mCc_x86_emit_byte(state, 0xe8) ||
+               mCc_x86_emit_fixup(state, &op[0]);
+    if (strcmp(name, "jmp") == 0 && n == 1)
+        return mCc_x86_emit_byte(state, 0xe9) ||
+               mCc_x86_emit_fixup(state, &op[0]);
+    if (name[0] == 'j' && mCc_x86_condition(name + 1) >= 0 && n == 1)
+        return mCc_x86_emit_byte(state, 0x0f) ||
+               mCc_x86_emit_byte(state, 0x80 + mCc_x86_condition(name + 1)) ||
+               mCc_x86_emit_fixup(state, &op[0]);
+    if (strncmp(name, "set", 3) == 0 && mCc_x86_condition(name + 3) >= 0) {
+        if (n != 1 || (op[0].kind != MCC_X86_REG8 && op[0].kind != MCC_X86_MEM))
+            return mCc_x86_error(state, "invalid operands for %s", name);
+        return mCc_x86_emit_byte(state, 0x0f) ||
+               mCc_x86_emit_byte(state, 0x90 + mCc_x86_condition(name + 3)) ||
+               mCc_x86_emit_modrm(state, 0, &op[0]);
+    }
+    if (strcmp(name, "movzx") == 0 || strcmp(name, "movzbl") == 0) {
+        if (n != 2 ||
+            (op[0].kind != MCC_X86_REG8 && op[0].kind != MCC_X86_MEM) ||
+            op[1].kind != MCC_X86_REG)
+            return mCc_x86_error(state, "invalid operands for %s", name);
+        return mCc_x86_emit_byte(state, 0x0f) ||
+               mCc_x86_emit_byte(state, 0xb6) ||
+               mCc_x86_emit_modrm(state, op[1].reg, &op[0]);
+    }
+    for (size_t i = 0; i < sizeof(x87_mem_ops) / sizeof(*x87_mem_ops); ++i) {
+        if (strcmp(name, x87_mem_ops[i].name) != 0)
+            continue;
+        if (n != 1 || op[0].kind != MCC_X86_MEM)
+            return mCc_x86_error(state, "invalid operands for %s", name);
+        return mCc_x86_emit_byte(state, x87_mem_ops[i].opcode) ||
+               mCc_x86_emit_modrm(state, x87_mem_ops[i].ext, &op[0]);
+    }
+    int ret = mCc_x86_sse_op(state, name, n, op);
+    if (ret >= 0)
+        return ret;
+
+    // General-purpose instructions, where gas also accepts an l suffix
+    if ((ret = mCc_x86_general_op(state, name, n, op)) >= 0)
+        return ret;
+    char base[16];
+    size_t len = strlen(name);
+    if (len > 1 && len < sizeof(base) && name[len - 1] == 'l') {
+        memcpy(base, name, len - 1);
+        base[len - 1] = '\0';
+        if ((ret = mCc_x86_general_op(state, base, n, op)) >= 0)
+            return ret;
+    }
+    return mCc_x86_error(state, "unknown instruction %s", name);
+}
+
+/*********************************** Directives */
+
+static int mCc_x86_switch_section(struct mCc_x86_state *state,
+                                  const char *name) {
+    uint32_t type = MCC_ELF_SHT_PROGBITS, flags = MCC_ELF_SHF_ALLOC;
+    if (strncmp(name, ".text", 5) == 0)
+        flags |= MCC_ELF_SHF_EXECINSTR;
+    else if (strncmp(name, ".data", 5) == 0)
+        flags |= MCC_ELF_SHF_WRITE;
+    else if (strncmp(name, ".bss", 4) == 0) {
+        type = MCC_ELF_SHT_NOBITS;
+        flags |= MCC_ELF_SHF_WRITE;
+    } else if (strncmp(name, ".rodata", 7) != 0)
+        return mCc_x86_error(state, "unsupported section %s", name);
+    if ((state->section =
+             mCc_elf_get_section(state->obj, name, type, flags)) < 0)
+        return mCc_x86_error(state, "memory error");
+    return 0;
+}
+
+static int mCc_x86_align(struct mCc_x86_state *state, char *args) {
+    // .p2align power[,fill[,max]]
+    char *ops[MAX_OPERANDS] = {0};
+    int n = mCc_x86_split_operands(state, args, ops);
+    if (n < 0)
+        return 1;
+    if (n == 0)
+        return mCc_x86_error(state, "missing alignment");
+    long power = strtol(ops[0], NULL, 0);
+    long max = n > 2 ? strtol(ops[2], NULL, 0) : 0;
+    if (power < 0 || power > 12)
+        return mCc_x86_error(state, "invalid alignment");
+
+    struct mCc_elf_section *section = mCc_x86_section(state);
+    uint32_t align = 1u << power;
+    uint32_t pad = (align - section->size % align) % align;
+    if (max > 0 && pad > (uint32_t)max)
+        return 0;
+    if (align > section->align)
+        section->align = align;
+    if (!(section->flags & MCC_ELF_SHF_EXECINSTR) || (n > 1 && *ops[1]))
+        return mCc_x86_emit(state, NULL, pad);
+
+    // Recommended multi-byte NOPs
+    static const unsigned char nops[9][9] = {
+        {0x90},
+        {0x66, 0x90},
+        {0x0f, 0x1f, 0x00},
+        {0x0f, 0x1f, 0x40, 0x00},
+        {0x0f, 0x1f, 0x44, 0x00, 0x00},
+        {0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00},
+        {0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00},
+        {0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00}};
+    while (pad) {
+        uint32_t size = pad > 9 ? 9 : pad;
+        if (mCc_x86_emit(state, nops[size - 1], size))
+            return 1;
+        pad -= size;
+    }
+    return 0;
+}
+
+/**
+ * Emit the characters of string literals starting at s up to the closing
+ * quote. Unterminated literals continue on the next line with a newline, like
+ * the GNU assembler does.
+ */
+static int mCc_x86_string(struct mCc_x86_state *state, char *s) {
+    while (true) {
+        if (!state->in_string) {
+            s = mCc_x86_skip_space(s);
+            if (*s != '"')
+                return mCc_x86_error(state, "expected string");
+            ++s;
+            state->in_string = true;
+        }
+        for (; *s && *s != '"'; ++s) {
+            unsigned int c = (unsigned char)*s;
+            if (c == '\n')
+                break;
+            if (c == '\\' && s[1]) {
+                c = (unsigned char)*++s;
+                switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'f': c = '\f'; break;
+                case 'b': c = '\b'; break;
+                case 'x':
+                    c = strtoul(s + 1, &s, 16) & 0xff;
+                    --s;
+                    break;
+                default:
+                    if (c >= '0' && c <= '7') {
+                        c = 0;
+                        for (int i = 0; i < 3 && *s >= '0' && *s <= '7'; ++i)
+                            c = c * 8 + (*s++ - '0');
+                        --s;
+                    }
+                    break;
+                }
+            }
+            if (mCc_x86_emit_byte(state, c))
+                return 1;
+        }
+        if (*s != '"') // continued on the next line
+            return mCc_x86_emit_byte(state, '\n');
+        state->in_string = false;
+        if (mCc_x86_emit_byte(state, 0))
+            return 1;
+        s = mCc_x86_skip_space(s + 1);
+        if (!*s)
+            return 0;
+        if (*s++ != ',')
+            return mCc_x86_error(state, "junk after string");
+    }
+}
+
+static int mCc_x86_directive(struct mCc_x86_state *state, const char *name,
+                             char *args) {
+    args = mCc_x86_skip_space(args);
+    if (strcmp(name, ".file") == 0 || strcmp(name, ".type") == 0 ||
+        strcmp(name, ".size") == 0 || strcmp(name, ".ident") == 0)
+        return 0;
+    if (strcmp(name, ".text") == 0 || strcmp(name, ".data") == 0 ||
+        strcmp(name, ".bss") == 0)
+        return mCc_x86_switch_section(state, name);
+    if (strcmp(name, ".section") == 0) {
+        size_t len = mCc_x86_symbol_length(args);
+        if (!len)
+            return mCc_x86_error(state, "missing section name");
+        args[len] = '\0';
+        return mCc_x86_switch_section(state, args);
+    }
+    if (strcmp(name, ".global") == 0 || strcmp(name, ".globl") == 0) {
+        size_t len = mCc_x86_symbol_length(args);
+        if (!len)
+            return mCc_x86_error(state, "missing symbol");
+        args[len] = '\0';
+        int symbol = mCc_elf_get_symbol(state->obj, args);
+        if (symbol < 0)
+            return mCc_x86_error(state, "memory error");
+        state->obj->symbols[symbol].global = true;
+        return 0;
+    }
+    if (strcmp(name, ".p2align") == 0)
+        return mCc_x86_align(state, args);
+    if (strcmp(name, ".string") == 0 || strcmp(name, ".asciz") == 0)
+        return mCc_x86_string(state, args);
+    if (strcmp(name, ".float") == 0 || strcmp(name, ".long") == 0 ||
+        strcmp(name, ".int") == 0) {
+        char *ops[MAX_OPERANDS];
+        int n = mCc_x86_split_operands(state, args, ops);
+        if (n < 0)
+            return 1;
+        for (int i = 0; i < n; ++i) {
+            char *end = ops[i];
+            int32_t value;
+            int symbol = -1;
+            if (name[1] == 'f') {
+                union {
+                    float f;
+                    uint32_t u;
+                } bits = {strtof(ops[i], &end)};
+                value = bits.u;
+            } else if (mCc_x86_parse_value(state, &end, &value, &symbol)) {
+                return 1;
+            }
+            if (end == ops[i] || *end)
+                return mCc_x86_error(state, "invalid value %s", ops[i]);
+            if (mCc_x86_emit32(state, value, symbol))
+                return 1;
+        }
+        return 0;
+    }
+    if (strcmp(name, ".zero") == 0 || strcmp(name, ".skip") == 0) {
+        char *end;
+        long size = strtol(args, &end, 0);
+        if (end == args || size < 0)
+            return mCc_x86_error(state, "invalid size");
+        return mCc_x86_emit(state, NULL, size);
+    }
+    return mCc_x86_error(state, "unknown directive %s", name);
+}
+
+/*********************************** Driver */
+
+static int mCc_x86_define_label(struct mCc_x86_state *state, char *name) {
+    int symbol = mCc_elf_get_symbol(state->obj, name);
+    if (symbol < 0)
+        return mCc_x86_error(state, "memory error");
+    struct mCc_elf_symbol *sym = &state->obj->symbols[symbol];
+    if (sym->section != MCC_ELF_UNDEF)
+        return mCc_x86_error(state, "symbol %s is already defined", name);
+    sym->section = state->section;
+    sym->value = mCc_x86_section(state)->size;
+    return 0;
+}
+
+static int mCc_x86_line(struct mCc_x86_state *state, char *line) {
+    if (state->in_string)
+        return mCc_x86_string(state, line);
+
+    // Strip the comment
+    bool quoted = false;
+    for (char *c = line; *c; ++c) {
+        if (*c == '"' && (c == line || c[-1] != '\\'))
+            quoted = !quoted;
+        else if (*c == '#' && !quoted) {
+            *c = '\0';
+            break;
+        }
+    }
+
+    char *s = mCc_x86_skip_space(line);
+    while (true) {
+        size_t len = mCc_x86_symbol_length(s);
+        if (!len)
+            return *s ? mCc_x86_error(state, "syntax error") : 0;
+        char *rest = s + len;
+        if (*rest == ':') { // label
+            *rest = '\0';
+            if (mCc_x86_define_label(state, s))
+                return 1;
+            s = mCc_x86_skip_space(rest + 1);
+            continue;
+        }
+        if (*rest && !isspace((unsigned char)*rest))
+            return mCc_x86_error(state, "syntax error");
+        if (*rest)
+            *rest++ = '\0';
+        if (s[0] == '.')
+            return mCc_x86_directive(state, s, rest);
+        return mCc_x86_instruction(state, s, rest);
+    }
+}
+
+/// Resolve branches within a section, relocate the others
+static int mCc_x86_resolve_fixups(struct mCc_x86_state *state) {
+    for (unsigned int i = 0; i < state->fixup_count; ++i) {
+        const struct mCc_x86_fixup *fixup = &state->fixups[i];
+        const struct mCc_elf_symbol *symbol =
+            &state->obj->symbols[fixup->symbol];
+        struct mCc_elf_section *section = &state->obj->sections[fixup->section];
+        unsigned char *p = section->data + fixup->offset;
+        uint32_t value = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+        if (symbol->section == fixup->section) {
+            value += symbol->value - (fixup->offset + 4);
+        } else {
+            value -= 4;
+            if (mCc_elf_add_reloc(section, fixup->offset, MCC_ELF_R_386_PC32,
+                                  fixup->symbol))
+                return mCc_x86_error(state, "memory error");
+        }
+        p[0] = value & 0xff;
+        p[1] = (value >> 8) & 0xff;
+        p[2] = (value >> 16) & 0xff;
+        p[3] = value >> 24;
+    }
+    return 0;
+}
+
+int mCc_x86_assemble(FILE *in, struct mCc_elf_object *obj,
+                     struct mCc_elf_error *error) {
+    struct mCc_x86_state state = {obj, error, 0, NULL, 0, 0, false};
+    char *line = NULL;
+    size_t capacity = 0;
+    int ret = 0;
+
+    error->line = 0;
+    error->msg[0] = '\0';
+    ret = mCc_x86_switch_section(&state, ".text");
+    while (!ret && getline(&line, &capacity, in) != -1) {
+        ++error->line;
+        ret = mCc_x86_line(&state, line);
+    }
+    if (!ret && state.in_string)
+        ret = mCc_x86_error(&state, "unterminated string");
+    if (!ret) {
+        error->line = 0;
+        ret = mCc_x86_resolve_fixups(&state);
+    }
+    for (unsigned int i = 0; !ret && i < obj->symbol_count; ++i) {
+        if (obj->symbols[i].section == MCC_ELF_UNDEF)
+            obj->symbols[i].global = true;
+    }
+    free(line);
+    free(state.fixups);
+    return ret;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file examples.h
+ * @brief Sources and compile helpers shared by the unit tests.
+ */
+#ifndef MCC_TEST_EXAMPLES_H
+#define MCC_TEST_EXAMPLES_H
+
+#include <gtest/gtest.h>
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mCc/compile.h"
+
+// A small program calling built-ins with a string and a branch
+static const char hello[] = "void main() { string s; s = \"hi\"; print(s); "
+                            "if (1 < 2) { print_int(3); } else { print_nl(); }"
+                            " }";
+
+// The sources of all examples, sorted by file name
+inline std::vector<std::string> read_examples()
+{
+	std::vector<std::string> names;
+	DIR *dir = opendir(MCC_EXAMPLES_DIR);
+	EXPECT_NE(nullptr, dir);
+	if (!dir)
+		return {};
+	while (struct dirent *entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, ".mC") == 0)
+			names.push_back(name);
+	}
+	closedir(dir);
+	std::sort(names.begin(), names.end());
+
+	std::vector<std::string> sources;
+	for (auto &name : names) {
+		std::ifstream in(std::string(MCC_EXAMPLES_DIR) + "/" + name);
+		std::stringstream buf;
+		buf << in.rdbuf();
+		sources.push_back(buf.str());
+	}
+	return sources;
+}
+
+// The assembly of a source that has to compile without diagnostics
+inline std::string compile(const std::string &src,
+                           const struct mCc_compile_options *options)
+{
+	struct mCc_output output;
+	EXPECT_EQ(MCC_COMPILE_STATUS_OK,
+	          mCc_compile_string(src.data(), src.size(), options, &output));
+	EXPECT_EQ(0u, output.diagnostic_count);
+	std::string result(output.data ? output.data : "", output.size);
+	mCc_output_free(&output);
+	return result;
+}
+
+inline std::string compile(const std::string &src, unsigned int opt_level = 0,
+                           int stream = 0)
+{
+	struct mCc_compile_options options =
+	    mCc_compile_default_options(opt_level);
+	options.stream = stream;
+	return compile(src, &options);
+}
+
+#endif
@@ -28,8 +28,7 @@ TEST(Parser, Identifier_2)
 	free((void *)result.err_msg);
 	free((void *)result.err_text);
 	ASSERT_NE(MCC_PARSER_STATUS_OK, result.status);
-
-	mCc_ast_delete_expression(result.expression);
+	ASSERT_EQ(nullptr, result.expression);
 }
 
 TEST(Parser, Identifier_3)
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "mCc/arena.h"
+#include "mCc/ast.h"
+#include "mCc/parser.h"
+
+TEST(Arena, Alloc)
+{
+	struct mCc_arena *arena = mCc_arena_new();
+	ASSERT_NE(nullptr, arena);
+
+	char *a = (char *)mCc_arena_alloc(arena, 3);
+	char *b = (char *)mCc_arena_alloc(arena, 5);
+	ASSERT_NE(nullptr, a);
+	ASSERT_NE(nullptr, b);
+	ASSERT_EQ(0u, (uintptr_t)b % alignof(max_align_t));
+	ASSERT_LE(a + 3, b);
+
+	// Larger than a block
+	char *big = (char *)mCc_arena_alloc(arena, 10 * MCC_ARENA_MAX_BLOCK_SIZE);
+	ASSERT_NE(nullptr, big);
+	memset(big, 1, 10 * MCC_ARENA_MAX_BLOCK_SIZE);
+
+	for (int i = 0; i < 100000; ++i)
+		ASSERT_NE(nullptr, mCc_arena_alloc(arena, 24));
+
+	char *str = mCc_arena_strdup(arena, "fib");
+	ASSERT_STREQ("fib", str);
+	mCc_arena_delete(arena);
+}
+
+TEST(Arena, Realloc)
+{
+	struct mCc_arena *arena = mCc_arena_new();
+	ASSERT_NE(nullptr, arena);
+
+	int *last = (int *)mCc_arena_realloc(arena, nullptr, 0, sizeof(int));
+	*last = 42;
+	int *grown =
+	    (int *)mCc_arena_realloc(arena, last, sizeof(int), 8 * sizeof(int));
+	ASSERT_EQ(last, grown);
+
+	mCc_arena_alloc(arena, 1);
+	int *copy = (int *)mCc_arena_realloc(arena, grown, 8 * sizeof(int),
+	                                     64 * sizeof(int));
+	ASSERT_NE(grown, copy);
+	ASSERT_EQ(42, *copy);
+	mCc_arena_delete(arena);
+}
+
+TEST(Arena, Release)
+{
+	struct mCc_arena *arena = mCc_arena_new();
+	ASSERT_NE(nullptr, arena);
+	char *kept = mCc_arena_strdup(arena, "kept");
+
+	// The memory after a mark is handed out again, in new blocks or not
+	for (int round = 0; round < 3; ++round) {
+		struct mCc_arena_mark mark = mCc_arena_mark(arena);
+		size_t allocated = arena->allocated;
+		char *first = (char *)mCc_arena_alloc(arena, 16);
+		for (int i = 0; i < 10000; ++i)
+			ASSERT_NE(nullptr, mCc_arena_alloc(arena, 64));
+		ASSERT_NE(nullptr, mCc_arena_alloc(arena, MCC_ARENA_MAX_BLOCK_SIZE));
+		mCc_arena_release(arena, mark);
+		ASSERT_EQ(allocated, arena->allocated);
+		ASSERT_EQ(first, mCc_arena_alloc(arena, 16));
+		mCc_arena_release(arena, mark);
+	}
+	ASSERT_STREQ("kept", kept);
+	mCc_arena_delete(arena);
+}
+
+TEST(Arena, ParsedTree)
+{
+	const char input[] = "void main() { int a; a = 1; f(a, 2, 3, 4, 5, 6, 7, "
+	                     "8, 9, 10, 11, 12); print(\"hi\"); }";
+	auto result = mCc_parser_parse_string(input);
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+
+	auto prog = result.program;
+	ASSERT_NE(nullptr, prog->node.arena);
+	ASSERT_TRUE(prog->node.arena_root);
+
+	auto body = prog->func_defs[0]->body;
+	ASSERT_EQ(prog->node.arena, body->node.arena);
+	ASSERT_FALSE(body->node.arena_root);
+	ASSERT_EQ(4u, body->compound_stmt_count);
+
+	auto call = body->compound_stmts[2]->expression;
+	ASSERT_EQ(12u, call->arguments->expression_count);
+	ASSERT_EQ(12, call->arguments->expressions[11]->literal->i_value);
+	ASSERT_STREQ("hi", body->compound_stmts[3]
+	                       ->expression->arguments->expressions[0]
+	                       ->literal->s_value);
+
+	// Deleting a subtree leaves it alone
+	mCc_ast_delete_statement(body);
+	ASSERT_STREQ("main", prog->func_defs[0]->identifier->id_value);
+
+	mCc_ast_delete_program(prog);
+}
+
+TEST(Arena, OnlyWhileParsing)
+{
+	auto result = mCc_parser_parse_string("1 + 2");
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+
+	// Nodes built by hand are still malloc'd
+	auto lit = mCc_ast_new_literal_int(3);
+	ASSERT_EQ(nullptr, lit->node.arena);
+	auto expr = mCc_ast_new_expression_binary_op(
+	    MCC_AST_BINARY_OP_MUL, result.expression,
+	    mCc_ast_new_expression_literal(lit));
+	ASSERT_EQ(nullptr, expr->node.arena);
+
+	// Deletes the hand-built nodes and the arena of the parsed ones
+	mCc_ast_delete_expression(expr);
+}
+
+TEST(Arena, ParseError)
+{
+	auto result = mCc_parser_parse_string("void main() { a = ; }");
+	ASSERT_EQ(MCC_PARSER_STATUS_PARSE_ERROR, result.status);
+	ASSERT_EQ(nullptr, result.program);
+	free((void *)result.err_msg);
+	free((void *)result.err_text);
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "mCc/ast_compact.h"
+#include "examples.h"
+#include "mCc/ast_print.h"
+#include "mCc/parser.h"
+
+// The DOT output with the node addresses numbered in order of appearance
+static std::string dot(struct mCc_ast_program *prog)
+{
+	char *data;
+	size_t size;
+	FILE *out = open_memstream(&data, &size);
+	mCc_ast_print_dot_program(out, prog);
+	fclose(out);
+	std::string text(data, size);
+	free(data);
+
+	std::regex address("0x[0-9a-f]+");
+	std::map<std::string, int> ids;
+	std::string result;
+	auto last = text.cbegin();
+	for (std::sregex_iterator it(text.begin(), text.end(), address), end;
+	     it != end; ++it) {
+		result.append(last, (*it)[0].first);
+		auto id = ids.emplace(it->str(), ids.size()).first->second;
+		result += "n" + std::to_string(id);
+		last = (*it)[0].second;
+	}
+	result.append(last, text.cend());
+	return result;
+}
+
+TEST(AstCompact, ExpandsToSameTree)
+{
+	auto sources = read_examples();
+	ASSERT_LT(0u, sources.size());
+	for (auto &src : sources) {
+		auto result = mCc_parser_parse_string(src.c_str());
+		ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+
+		struct mCc_ast_compact compact;
+		ASSERT_EQ(0, mCc_ast_compact_build(&compact, result.program,
+		                                   src.data(), src.size()));
+		struct mCc_ast_program *expanded = mCc_ast_compact_expand(&compact);
+		ASSERT_NE(nullptr, expanded);
+		ASSERT_EQ(dot(result.program), dot(expanded));
+
+		mCc_ast_delete_program(expanded);
+		mCc_ast_compact_free(&compact);
+		mCc_ast_delete_program(result.program);
+	}
+}
+
+TEST(AstCompact, Layout)
+{
+	const std::string src = "int f(int a, int b)\n"
+	                        "{\n"
+	                        "\tif (a < -b) return (a + 1) * b;\n"
+	                        "\twhile (a > 0) a = a - 1;\n"
+	                        "\treturn g(a, \"s\", 2.5);\n"
+	                        "}\n"
+	                        "void main() { f(1, 2); }\n";
+	auto result = mCc_parser_parse_string(src.c_str());
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	struct mCc_ast_compact compact;
+	ASSERT_EQ(0, mCc_ast_compact_build(&compact, result.program, src.data(),
+	                                   src.size()));
+
+	ASSERT_EQ(2u, compact.functions.count);
+	auto &f = compact.functions.data[0];
+	auto &main = compact.functions.data[1];
+	ASSERT_STREQ("f", compact.chars.data +
+	                      compact.identifiers.data[f.identifier].name);
+	ASSERT_EQ(0u, f.first_expression);
+	ASSERT_EQ(0u, f.first_statement);
+
+	uint32_t count;
+	mCc_ast_compact_list(&compact, f.parameters, &count);
+	ASSERT_EQ(2u, count);
+	mCc_ast_compact_list(&compact, main.parameters, &count);
+	ASSERT_EQ(0u, count);
+
+	// Pre-order: the if is followed by its body
+	auto &body = compact.statements.data[f.body];
+	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_CMPND, body.type);
+	const uint32_t *stmts = mCc_ast_compact_list(&compact, body.a, &count);
+	ASSERT_EQ(3u, count);
+	auto &if_stmt = compact.statements.data[stmts[0]];
+	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_IF, if_stmt.type);
+	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_RET,
+	          compact.statements.data[stmts[0] + 1].type);
+
+	// a < -b: lhs follows, rhs is a unary op followed by its operand
+	auto &cond = compact.expressions.data[if_stmt.a];
+	ASSERT_EQ(MCC_AST_BINARY_OP_LT, cond.op);
+	ASSERT_EQ(MCC_AST_EXPRESSION_TYPE_IDENTIFIER,
+	          compact.expressions.data[if_stmt.a + 1].type);
+	ASSERT_EQ(MCC_AST_EXPRESSION_TYPE_UNARY_OP,
+	          compact.expressions.data[cond.b].type);
+	ASSERT_EQ(if_stmt.a + 2, cond.b);
+
+	// The statements and expressions of main come after those of f
+	ASSERT_EQ(compact.statements.data[main.body].type,
+	          MCC_AST_STATEMENT_TYPE_CMPND);
+	ASSERT_LT(stmts[2], main.first_statement);
+	ASSERT_EQ(MCC_AST_EXPRESSION_TYPE_CALL_EXPR,
+	          compact.expressions.data[main.first_expression].type);
+
+	// Source locations
+	auto loc = mCc_ast_compact_location(&compact, cond.loc);
+	ASSERT_EQ(3, loc.start_line);
+	ASSERT_EQ(6, loc.start_col);
+	loc = mCc_ast_compact_location(&compact, main.loc);
+	ASSERT_EQ(7, loc.start_line);
+	ASSERT_EQ(1, loc.start_col);
+
+	mCc_ast_compact_free(&compact);
+	mCc_ast_delete_program(result.program);
+}
+
+static void count_call(struct mCc_ast_expression *, void *data)
+{
+	++*(int *)data;
+}
+
+TEST(AstCompact, Visit)
+{
+	const char src[] = "void main() { print_int(f(1) + f(g())); }";
+	auto result = mCc_parser_parse_string(src);
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	struct mCc_ast_compact compact;
+	ASSERT_EQ(0, mCc_ast_compact_build(&compact, result.program, src,
+	                                   sizeof(src) - 1));
+
+	int calls = 0;
+	struct mCc_ast_visitor visitor = {};
+	visitor.traversal = MCC_AST_VISIT_DEPTH_FIRST;
+	visitor.order = MCC_AST_VISIT_PRE_ORDER;
+	visitor.userdata = &calls;
+	visitor.expression_call_expr = count_call;
+	ASSERT_EQ(0, mCc_ast_compact_visit(&compact, &visitor));
+	ASSERT_EQ(4, calls);
+
+	// The same as a scan of the expressions
+	int scanned = 0;
+	for (uint32_t i = 0; i < compact.expressions.count; ++i)
+		scanned += compact.expressions.data[i].type ==
+		           MCC_AST_EXPRESSION_TYPE_CALL_EXPR;
+	ASSERT_EQ(calls, scanned);
+
+	mCc_ast_compact_free(&compact);
+	mCc_ast_delete_program(result.program);
+}
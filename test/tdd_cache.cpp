@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mCc/cache.h"
+
+static std::string normalise(const std::string &src)
+{
+	std::string out(src.size(), '\0');
+	out.resize(mCc_cache_normalise(src.data(), src.size(), &out[0]));
+	return out;
+}
+
+TEST(Cache, Normalise)
+{
+	ASSERT_EQ("int a;a = 1;", normalise("  int   a;\n\ta =\r\n1;\n"));
+	ASSERT_EQ("f(a,b[1]){}", normalise("f ( a , b [ 1 ] ) { }"));
+	ASSERT_EQ("a < = b", normalise("a < = b"));
+	ASSERT_EQ("a b", normalise("a/* comment */b"));
+	ASSERT_EQ("a / b", normalise("a /\n b"));
+	ASSERT_EQ("print(\"x  /* y */ z\");",
+	          normalise("print(\"x  /* y */ z\");"));
+	ASSERT_EQ("print(\"unterminated  ", normalise("print(\"unterminated  "));
+
+	// Like the lexer, a star pairs with the next character, so "**/" does
+	// not end a comment
+	ASSERT_EQ("a /* b **/ c", normalise("a /* b **/ c"));
+	ASSERT_EQ("a d", normalise("a /* b **/ c */ d"));
+	ASSERT_EQ("a c */ d", normalise("a /* b */ c */ d"));
+	ASSERT_EQ("a /* b", normalise("a /* b"));
+}
+
+/* A cache in a fresh directory, removed at the end of the test */
+class CacheDir : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		char tmp[] = "/tmp/mCc_cache_XXXXXX";
+		ASSERT_NE(nullptr, mkdtemp(tmp));
+		dir = std::string(tmp) + "/nested/cache";
+	}
+
+	void TearDown() override
+	{
+		std::string cmd = "rm -rf " + dir.substr(0, dir.size() - 13);
+		ASSERT_EQ(0, system(cmd.c_str()));
+	}
+
+	static void key(struct mCc_cache_key *k, const char *src)
+	{
+		mCc_cache_key_init(k);
+		mCc_cache_key_add_string(k, "test");
+		mCc_cache_key_add_uint(k, 2);
+		mCc_cache_key_add_source(k, src, strlen(src));
+		ASSERT_EQ(0, mCc_cache_key_finish(k));
+	}
+
+	static std::string get(struct mCc_cache *cache, const char *src)
+	{
+		struct mCc_cache_key k;
+		key(&k, src);
+		char *data;
+		size_t size;
+		std::string result = "miss";
+		if (mCc_cache_get(cache, &k, &data, &size) == 0) {
+			result = std::string(data, size);
+			free(data);
+		}
+		mCc_cache_key_free(&k);
+		return result;
+	}
+
+	static void put(struct mCc_cache *cache, const char *src,
+	                const std::string &data)
+	{
+		struct mCc_cache_key k;
+		key(&k, src);
+		ASSERT_EQ(0, mCc_cache_put(cache, &k, data.data(), data.size()));
+		mCc_cache_key_free(&k);
+	}
+
+	std::string dir;
+};
+
+TEST_F(CacheDir, HitsAndMisses)
+{
+	struct mCc_cache cache;
+	ASSERT_EQ(0, mCc_cache_open(&cache, dir.c_str(),
+	                            MCC_CACHE_DEFAULT_MAX_SIZE));
+	ASSERT_EQ("miss", get(&cache, "void main() { }"));
+	put(&cache, "void main() { }", "assembly");
+	ASSERT_EQ("assembly", get(&cache, "void main() {}"));
+	ASSERT_EQ("assembly", get(&cache, "/* x */ void  main()\n{ }\n"));
+	ASSERT_EQ("miss", get(&cache, "void main() { print(\"\"); }"));
+	put(&cache, "void main() { }", "replaced");
+	ASSERT_EQ("replaced", get(&cache, "void main() { }"));
+	mCc_cache_close(&cache);
+
+	struct mCc_cache_stats stats;
+	ASSERT_EQ(0, mCc_cache_read_stats(dir.c_str(), &stats));
+	ASSERT_EQ(3u, stats.hits);
+	ASSERT_EQ(2u, stats.misses);
+	ASSERT_EQ(2u, stats.stores);
+	ASSERT_EQ(1u, stats.entries);
+
+	// Statistics add up across processes
+	ASSERT_EQ(0, mCc_cache_open(&cache, dir.c_str(),
+	                            MCC_CACHE_DEFAULT_MAX_SIZE));
+	ASSERT_EQ("replaced", get(&cache, "void main() { }"));
+	mCc_cache_close(&cache);
+	ASSERT_EQ(0, mCc_cache_read_stats(dir.c_str(), &stats));
+	ASSERT_EQ(4u, stats.hits);
+}
+
+TEST_F(CacheDir, Damaged)
+{
+	struct mCc_cache cache;
+	ASSERT_EQ(0, mCc_cache_open(&cache, dir.c_str(),
+	                            MCC_CACHE_DEFAULT_MAX_SIZE));
+	put(&cache, "void main() { }", "assembly");
+
+	// Truncate the only entry
+	DIR *d = opendir(dir.c_str());
+	ASSERT_NE(nullptr, d);
+	struct dirent *ent;
+	while ((ent = readdir(d))) {
+		if (strstr(ent->d_name, ".entry")) {
+			ASSERT_EQ(0, truncate((dir + "/" + ent->d_name).c_str(), 20));
+		}
+	}
+	closedir(d);
+	ASSERT_EQ("miss", get(&cache, "void main() { }"));
+	mCc_cache_close(&cache);
+}
+
+TEST_F(CacheDir, EvictsLeastRecentlyUsed)
+{
+	std::string big(1000, 'x');
+	struct mCc_cache cache;
+	ASSERT_EQ(0, mCc_cache_open(&cache, dir.c_str(), 2500));
+	put(&cache, "void a() {}", big);
+	put(&cache, "void b() {}", big);
+	sleep(1);
+	ASSERT_EQ(big, get(&cache, "void a() {}"));
+	put(&cache, "void c() {}", big);
+	mCc_cache_close(&cache);
+
+	ASSERT_EQ(0, mCc_cache_open(&cache, dir.c_str(), 2500));
+	ASSERT_EQ("miss", get(&cache, "void b() {}"));
+	ASSERT_EQ(big, get(&cache, "void a() {}"));
+	ASSERT_EQ(big, get(&cache, "void c() {}"));
+	mCc_cache_close(&cache);
+}
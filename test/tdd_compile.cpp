@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "examples.h"
+#include "mCc/compile.h"
+#include "mCc/context.h"
+#include "mCc/parser_descent.h"
+
+TEST(Compile, Assembly)
+{
+	std::string assembly = compile(hello);
+	ASSERT_NE(std::string::npos, assembly.find(".file\t\"<string>\""));
+	ASSERT_NE(std::string::npos, assembly.find("main:"));
+	ASSERT_NE(std::string::npos, assembly.find("call\tprint"));
+}
+
+TEST(Compile, Repeatable)
+{
+	// Numbering of labels, strings and stack slots starts over every time
+	std::string first = compile(hello);
+	ASSERT_EQ(first, compile(hello));
+	compile("void main() { float f; f = 1.5; print_float(f); }", 3);
+	ASSERT_EQ(first, compile(hello));
+}
+
+TEST(Compile, ReusedContext)
+{
+	// The built-ins are kept, everything else starts over
+	struct mCc_context *ctx = mCc_context_new();
+	ASSERT_NE(nullptr, ctx);
+	const char floats[] = "void main() { float f; f = 1.5; print_float(f); }";
+	const char undeclared[] = "void main() { b = 1; }";
+	const char *sources[] = { hello, floats, undeclared, hello };
+	for (const char *src : sources) {
+		struct mCc_output output;
+		mCc_compile_string_in_context(ctx, src, strlen(src), nullptr,
+		                              &output);
+		if (src == undeclared) {
+			ASSERT_EQ(MCC_COMPILE_STATUS_SYMTAB_ERROR, output.status);
+		} else {
+			ASSERT_EQ(MCC_COMPILE_STATUS_OK, output.status);
+			ASSERT_EQ(compile(src), std::string(output.data, output.size));
+		}
+		mCc_output_free(&output);
+	}
+	mCc_context_delete(ctx);
+}
+
+TEST(Compile, NotTerminated)
+{
+	// Only the first len bytes are compiled
+	std::string src = std::string(hello) + "garbage";
+	struct mCc_output output;
+	ASSERT_EQ(MCC_COMPILE_STATUS_OK,
+	          mCc_compile_string(src.data(), strlen(hello), nullptr, &output));
+	ASSERT_EQ(compile(hello), std::string(output.data, output.size));
+	mCc_output_free(&output);
+}
+
+TEST(Compile, Object)
+{
+	struct mCc_compile_options options = mCc_compile_default_options(2);
+	options.output_kind = MCC_COMPILE_OUTPUT_OBJECT;
+	struct mCc_output output;
+	ASSERT_EQ(MCC_COMPILE_STATUS_OK,
+	          mCc_compile_string(hello, strlen(hello), &options, &output));
+	ASSERT_LT(52u, output.size);
+	ASSERT_EQ(0, memcmp("\x7f" "ELF", output.data, 4));
+	mCc_output_free(&output);
+}
+
+TEST(Compile, Diagnostics)
+{
+	const char parse_error[] = "void main() {\n  int a\n}";
+	struct mCc_output output;
+	ASSERT_EQ(MCC_COMPILE_STATUS_PARSE_ERROR,
+	          mCc_compile_string(parse_error, strlen(parse_error), nullptr,
+	                             &output));
+	ASSERT_EQ(nullptr, output.data);
+	ASSERT_EQ(1u, output.diagnostic_count);
+	ASSERT_EQ(MCC_COMPILE_STATUS_PARSE_ERROR, output.diagnostics[0].status);
+	ASSERT_EQ(3, output.diagnostics[0].loc.start_line);
+	ASSERT_STREQ("}", output.diagnostics[0].text);
+	mCc_output_free(&output);
+
+	const char type_error[] = "void main() {\n  int a;\n  a = 1.5;\n}";
+	ASSERT_EQ(MCC_COMPILE_STATUS_TYPE_ERROR,
+	          mCc_compile_string(type_error, strlen(type_error), nullptr,
+	                             &output));
+	ASSERT_EQ(1u, output.diagnostic_count);
+	ASSERT_EQ(3, output.diagnostics[0].loc.start_line);
+	ASSERT_NE(nullptr, output.diagnostics[0].message);
+	mCc_output_free(&output);
+
+	const char symtab_error[] = "void main() { b = 1; }";
+	ASSERT_EQ(MCC_COMPILE_STATUS_SYMTAB_ERROR,
+	          mCc_compile_string(symtab_error, strlen(symtab_error), nullptr,
+	                             &output));
+	mCc_output_free(&output);
+
+	// Errors do not leak into the next compilation
+	compile(hello);
+}
+
+TEST(Compile, ParserKinds)
+{
+	// Either parser, selected per compilation
+	struct mCc_compile_options bison = mCc_compile_default_options(2);
+	bison.parser = MCC_PARSER_KIND_BISON;
+	struct mCc_compile_options descent = mCc_compile_default_options(2);
+	descent.parser = MCC_PARSER_KIND_DESCENT;
+	for (auto &src : read_examples())
+		ASSERT_EQ(compile(src, &bison), compile(src, &descent));
+}
+
+TEST(Compile, StreamSameAsWhole)
+{
+	auto sources = read_examples();
+	ASSERT_LT(0u, sources.size());
+	for (auto &src : sources) {
+		for (unsigned int opt_level : { 0, 2, 3 })
+			ASSERT_EQ(compile(src, opt_level),
+			          compile(src, opt_level, 1));
+	}
+	ASSERT_EQ(compile(hello), compile(hello, 0, 1));
+}
+
+TEST(Compile, StreamDiagnostics)
+{
+	struct mCc_compile_options options = mCc_compile_default_options(0);
+	options.stream = 1;
+	struct mCc_output output;
+
+	// In the order of the source: the first function is rejected before the
+	// syntax error in the second one is parsed
+	const char undeclared[] = "int f() { return x; }\n"
+	                          "void main() { f() }";
+	ASSERT_EQ(MCC_COMPILE_STATUS_SYMTAB_ERROR,
+	          mCc_compile_string(undeclared, strlen(undeclared), &options,
+	                             &output));
+	ASSERT_EQ(nullptr, output.data);
+	ASSERT_EQ(1u, output.diagnostic_count);
+	ASSERT_EQ(1, output.diagnostics[0].loc.start_line);
+	mCc_output_free(&output);
+
+	// Functions are declared by their signatures before any body is linked
+	const char later[] = "int f() { return g(); }\n"
+	                     "void main() { f(); }\n"
+	                     "int g() { return 1.5; }";
+	ASSERT_EQ(MCC_COMPILE_STATUS_TYPE_ERROR,
+	          mCc_compile_string(later, strlen(later), &options, &output));
+	ASSERT_EQ(1u, output.diagnostic_count);
+	ASSERT_EQ(3, output.diagnostics[0].loc.start_line);
+	mCc_output_free(&output);
+
+	const char redefined[] = "void main() { }\nvoid main() { }";
+	ASSERT_EQ(MCC_COMPILE_STATUS_SYMTAB_ERROR,
+	          mCc_compile_string(redefined, strlen(redefined), &options,
+	                             &output));
+	ASSERT_EQ(2, output.diagnostics[0].loc.start_line);
+	mCc_output_free(&output);
+
+	const char no_main[] = "void f() { }";
+	ASSERT_EQ(MCC_COMPILE_STATUS_TYPE_ERROR,
+	          mCc_compile_string(no_main, strlen(no_main), &options,
+	                             &output));
+	mCc_output_free(&output);
+
+	// A broken signature is reported like without streaming
+	const char signature[] = "void main() { }\nvoid f(int) { }";
+	ASSERT_EQ(MCC_COMPILE_STATUS_PARSE_ERROR,
+	          mCc_compile_string(signature, strlen(signature), &options,
+	                             &output));
+	ASSERT_EQ(2, output.diagnostics[0].loc.start_line);
+	mCc_output_free(&output);
+
+	const char expression[] = "1 + 2";
+	ASSERT_EQ(MCC_COMPILE_STATUS_PARSE_ERROR,
+	          mCc_compile_string(expression, strlen(expression), &options,
+	                             &output));
+	mCc_output_free(&output);
+
+	compile(hello, 0, 1);
+}
+
+TEST(Compile, StreamTooDeep)
+{
+	// The rest of the program is compiled as a whole from the deep function
+	int depth = MCC_PARSER_DESCENT_MAX_DEPTH + 1;
+	std::string src = "int f(int a) { return a; }\n"
+	                  "void main() { int x; " +
+	                  std::string(depth, '{') + "x = f(3);" +
+	                  std::string(depth, '}') +
+	                  " print_int(x); }\n"
+	                  "int g() { return 1; }";
+	ASSERT_EQ(compile(src), compile(src, 0, 1));
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "examples.h"
+#include "mCc/compile.h"
+
+TEST(Context, ParallelCompilation)
+{
+	const unsigned int thread_count = 8;
+	const unsigned int opt_levels[] = { 0, 3 };
+
+	std::vector<std::string> sources = read_examples();
+	ASSERT_LT(10u, sources.size());
+
+	// Reference output, one compilation at a time
+	std::vector<std::string> expected;
+	for (unsigned int opt_level : opt_levels)
+		for (auto &src : sources)
+			expected.push_back(compile(src, opt_level));
+
+	// Every thread compiles the whole corpus, starting at a different file
+	std::vector<std::vector<std::string>> results(thread_count);
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < thread_count; ++t) {
+		threads.emplace_back([&, t] {
+			results[t].resize(expected.size());
+			for (size_t i = 0; i < expected.size(); ++i) {
+				size_t n = (i + t * 7) % expected.size();
+				results[t][n] =
+				    compile(sources[n % sources.size()],
+				            opt_levels[n / sources.size()]);
+			}
+		});
+	}
+	for (auto &thread : threads)
+		thread.join();
+
+	for (unsigned int t = 0; t < thread_count; ++t) {
+		for (size_t i = 0; i < expected.size(); ++i) {
+			ASSERT_EQ(expected[i], results[t][i])
+			    << "thread " << t << ", compilation " << i;
+		}
+	}
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "examples.h"
+#include "mCc/ast_symtab_link.h"
+#include "mCc/compile.h"
+#include "mCc/context.h"
+#include "mCc/func_cache.h"
+#include "mCc/parser.h"
+#include "mCc/typecheck.h"
+
+static std::string compile(const std::string &src, unsigned int opt_level,
+                           struct mCc_func_cache *cache)
+{
+	struct mCc_compile_options options =
+	    mCc_compile_default_options(opt_level);
+	options.func_cache = cache;
+	return compile(src, &options);
+}
+
+TEST(FuncCache, SameAsWholeProgram)
+{
+	auto sources = read_examples();
+	ASSERT_LT(0u, sources.size());
+	for (unsigned int opt_level = 0; opt_level <= 3; ++opt_level) {
+		struct mCc_func_cache cache;
+		ASSERT_EQ(0, mCc_func_cache_init(&cache, nullptr, nullptr));
+		for (auto &src : sources) {
+			std::string expected = compile(src, opt_level, nullptr);
+			uint64_t lookups = cache.stats.hits + cache.stats.misses;
+			EXPECT_EQ(expected, compile(src, opt_level, &cache));
+			uint64_t functions =
+			    cache.stats.hits + cache.stats.misses - lookups;
+
+			// Every function is found the second time
+			uint64_t hits = cache.stats.hits;
+			EXPECT_EQ(expected, compile(src, opt_level, &cache));
+			EXPECT_EQ(hits + functions, cache.stats.hits);
+		}
+		mCc_func_cache_free(&cache);
+	}
+}
+
+TEST(FuncCache, FunctionLocalNumbering)
+{
+	// The assembly of a function does not depend on the functions in front
+	const std::string fib = "int fib(int n) { if (n < 2) return n;"
+	                        "return fib(n - 1) + fib(n - 2); }"
+	                        "void main() { print(\"fib\"); print_nl();"
+	                        "print_int(fib(10)); }";
+	const std::string other = "float half(float x) { string s; s = \"x\";"
+	                          "while (x > 1.0) x = x / 2.0; return x; }";
+	for (unsigned int opt_level = 0; opt_level <= 3; ++opt_level) {
+		std::string alone = compile(fib, opt_level, nullptr);
+		std::string after = compile(other + fib, opt_level, nullptr);
+		ASSERT_NE("error", alone);
+		alone = alone.substr(alone.find('\n') + 1);
+		ASSERT_LT(alone.size(), after.size());
+		ASSERT_EQ(alone, after.substr(after.size() - alone.size()));
+	}
+}
+
+TEST(FuncCache, OnlyChangedFunctions)
+{
+	const std::string before = "int sq(int x) { return x * x; }"
+	                           "int twice(int x) { return 2 * x; }"
+	                           "void main() { print_int(sq(twice(3))); }";
+	const std::string after = "int sq(int x) { return x * x; }"
+	                          "int twice(int x) { return x + x; }"
+	                          "void main() { print_int(sq(twice(3))); }";
+	struct mCc_func_cache cache;
+	ASSERT_EQ(0, mCc_func_cache_init(&cache, nullptr, nullptr));
+	ASSERT_EQ(compile(before, 2, nullptr), compile(before, 2, &cache));
+	ASSERT_EQ(0u, cache.stats.hits);
+	ASSERT_EQ(3u, cache.stats.misses);
+
+	ASSERT_EQ(compile(after, 2, nullptr), compile(after, 2, &cache));
+	ASSERT_EQ(2u, cache.stats.hits);
+	ASSERT_EQ(4u, cache.stats.misses);
+
+	// Another optimisation level generates everything again
+	ASSERT_EQ(compile(after, 3, nullptr), compile(after, 3, &cache));
+	ASSERT_EQ(7u, cache.stats.misses);
+	mCc_func_cache_free(&cache);
+}
+
+TEST(FuncCache, CalleeSignature)
+{
+	// main is unchanged, but the function it calls returns another type
+	const std::string before = "int f() { return 1; }"
+	                           "void main() { f(); }";
+	const std::string after = "float f() { return 1.0; }"
+	                          "void main() { f(); }";
+	struct mCc_func_cache cache;
+	ASSERT_EQ(0, mCc_func_cache_init(&cache, nullptr, nullptr));
+	ASSERT_EQ(compile(before, 0, nullptr), compile(before, 0, &cache));
+	ASSERT_EQ(compile(after, 0, nullptr), compile(after, 0, &cache));
+	ASSERT_EQ(0u, cache.stats.hits);
+	ASSERT_EQ(4u, cache.stats.misses);
+	mCc_func_cache_free(&cache);
+}
+
+static std::string finish(struct mCc_cache_key *key)
+{
+	EXPECT_EQ(0, mCc_cache_key_finish(key));
+	std::string result(key->data, key->size);
+	mCc_cache_key_free(key);
+	return result;
+}
+
+TEST(FuncCache, CompactFingerprint)
+{
+	auto sources = read_examples();
+	ASSERT_LT(0u, sources.size());
+	struct mCc_tac_opt_options options = mCc_tac_opt_default_options(2);
+	for (auto &src : sources) {
+		auto result = mCc_parser_parse_string(src.c_str());
+		ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+		auto prog = result.program;
+		struct mCc_context *ctx = mCc_context_new();
+		auto link_result = mCc_ast_symtab_build(ctx, prog);
+		ASSERT_EQ(0, link_result.status);
+		ASSERT_EQ(0, mCc_typecheck(ctx, prog, link_result.root_symtab).status);
+
+		struct mCc_ast_compact compact;
+		ASSERT_EQ(0, mCc_ast_compact_build(&compact, prog, src.data(),
+		                                   src.size()));
+		ASSERT_EQ(prog->func_def_count, compact.functions.count);
+		for (unsigned int i = 0; i < prog->func_def_count; ++i) {
+			struct mCc_cache_key pointer, scanned;
+			mCc_cache_key_init(&pointer);
+			mCc_func_cache_fingerprint(&pointer, prog->func_defs[i], &options);
+			mCc_cache_key_init(&scanned);
+			mCc_func_cache_fingerprint_compact(&scanned, &compact, i, &options);
+			ASSERT_EQ(finish(&pointer), finish(&scanned));
+		}
+
+		mCc_ast_compact_free(&compact);
+		mCc_context_delete(ctx);
+		mCc_ast_delete_program(prog);
+	}
+}
+
+TEST(FuncCache, Eviction)
+{
+	const std::string prog = "void main() { print_int(42); }";
+	struct mCc_func_cache cache;
+	ASSERT_EQ(0, mCc_func_cache_init(&cache, nullptr, nullptr));
+	compile(prog, 0, &cache);
+	for (int i = 1; i < MCC_FUNC_CACHE_MAX_AGE; ++i)
+		compile("void main() { print_int(" + std::to_string(i) + "); }", 0,
+		        &cache);
+	compile(prog, 0, &cache);
+	ASSERT_EQ(1u, cache.stats.hits);
+
+	for (int i = 0; i <= MCC_FUNC_CACHE_MAX_AGE; ++i)
+		compile("void main() { print_int(" + std::to_string(i) + "); }", 0,
+		        &cache);
+	uint64_t misses = cache.stats.misses;
+	compile(prog, 0, &cache);
+	ASSERT_EQ(misses + 1, cache.stats.misses);
+	mCc_func_cache_free(&cache);
+}
+
+TEST(FuncCache, OnDisk)
+{
+	char tmp[] = "/tmp/mCc_func_cache_XXXXXX";
+	ASSERT_NE(nullptr, mkdtemp(tmp));
+	struct mCc_cache disk;
+	ASSERT_EQ(0, mCc_cache_open(&disk, tmp, MCC_CACHE_DEFAULT_MAX_SIZE));
+	struct mCc_cache_key prefix;
+	mCc_cache_key_init(&prefix);
+	mCc_cache_key_add_string(&prefix, "test");
+	ASSERT_EQ(0, mCc_cache_key_finish(&prefix));
+
+	const std::string prog = "int one() { return 1; }"
+	                         "void main() { print_int(one()); }";
+	std::string expected = compile(prog, 1, nullptr);
+
+	// Like two processes sharing the directory
+	for (int i = 0; i < 2; ++i) {
+		struct mCc_func_cache cache;
+		ASSERT_EQ(0, mCc_func_cache_init(&cache, &disk, &prefix));
+		ASSERT_EQ(expected, compile(prog, 1, &cache));
+		ASSERT_EQ(i ? 2u : 0u, cache.stats.hits);
+		mCc_func_cache_free(&cache);
+	}
+	mCc_cache_key_free(&prefix);
+	mCc_cache_close(&disk);
+	ASSERT_EQ(0, system((std::string("rm -rf ") + tmp).c_str()));
+}
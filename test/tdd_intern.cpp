@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "mCc/context.h"
+#include "mCc/intern.h"
+#include "mCc/parser.h"
+#include "mCc/symtab.h"
+
+TEST(Intern, SameStringSameAtom)
+{
+	struct mCc_interner *interner = mCc_interner_new(nullptr);
+	ASSERT_NE(nullptr, interner);
+
+	mCc_atom fib = mCc_interner_intern(interner, "fib", 3);
+	// Only the given length counts
+	mCc_atom main = mCc_interner_intern(interner, "main()", 4);
+	ASSERT_NE(MCC_ATOM_NONE, fib);
+	ASSERT_NE(MCC_ATOM_NONE, main);
+	ASSERT_NE(fib, main);
+
+	ASSERT_EQ(fib, mCc_interner_intern(interner, "fib", 3));
+	ASSERT_EQ(main, mCc_interner_find(interner, "main", 4));
+	ASSERT_EQ(MCC_ATOM_NONE, mCc_interner_find(interner, "fi", 2));
+	ASSERT_STREQ("main", mCc_interner_str(interner, main));
+	ASSERT_EQ(nullptr, mCc_interner_str(interner, MCC_ATOM_NONE));
+	ASSERT_EQ(nullptr, mCc_interner_str(interner, main + 1));
+
+	// The empty string is an ordinary one
+	mCc_atom empty = mCc_interner_intern(interner, "", 0);
+	ASSERT_NE(MCC_ATOM_NONE, empty);
+	ASSERT_STREQ("", mCc_interner_str(interner, empty));
+	mCc_interner_delete(interner);
+}
+
+TEST(Intern, Grow)
+{
+	struct mCc_interner *interner = mCc_interner_new(nullptr);
+	ASSERT_NE(nullptr, interner);
+
+	const int count = 20 * MCC_INTERNER_FIRST_CAPACITY;
+	const char *first = mCc_interner_str(
+	    interner, mCc_interner_intern(interner, "x0", 2));
+	for (int i = 1; i < count; ++i) {
+		std::string name = "x" + std::to_string(i);
+		ASSERT_EQ((mCc_atom)i + 1,
+		          mCc_interner_intern(interner, name.data(), name.size()));
+	}
+	std::string longer(5000, 'a');
+	mCc_atom atom = mCc_interner_intern(interner, longer.data(), longer.size());
+	ASSERT_EQ(longer, mCc_interner_str(interner, atom));
+
+	// The text stays where it is
+	ASSERT_EQ(first, mCc_interner_str(interner, 1));
+	for (int i = 0; i < count; ++i) {
+		std::string name = "x" + std::to_string(i);
+		ASSERT_EQ((mCc_atom)i + 1,
+		          mCc_interner_find(interner, name.data(), name.size()));
+	}
+	mCc_interner_delete(interner);
+}
+
+TEST(Intern, ParsedIdentifiers)
+{
+	auto result = mCc_parser_parse_string(
+	    "int f(int a) { return a; } void main() { int a; a = f(1); "
+	    "print(\"a\"); print(\"a\"); }");
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	auto prog = result.program;
+	ASSERT_NE(nullptr, prog->interner);
+
+	auto f = prog->func_defs[0];
+	auto body = prog->func_defs[1]->body;
+	auto param = f->para->decl[0]->decl_id;
+	auto local = body->compound_stmts[0]->declaration->decl_id;
+	auto call = body->compound_stmts[1]->rhs_assgn;
+
+	// Equal names share the atom and the text
+	ASSERT_NE(MCC_ATOM_NONE, param->atom);
+	ASSERT_EQ(param->atom, local->atom);
+	ASSERT_EQ(param->id_value, local->id_value);
+	ASSERT_EQ(f->identifier->atom, call->f_name->atom);
+	ASSERT_NE(f->identifier->atom, param->atom);
+	ASSERT_STREQ("f", mCc_interner_str(prog->interner, call->f_name->atom));
+
+	auto str1 = body->compound_stmts[2]->expression->arguments->expressions[0];
+	auto str2 = body->compound_stmts[3]->expression->arguments->expressions[0];
+	ASSERT_STREQ("a", str1->literal->s_value);
+	ASSERT_EQ(str1->literal->s_value, str2->literal->s_value);
+
+	mCc_ast_delete_program(prog);
+}
+
+TEST(Intern, SymtabLookup)
+{
+	auto result = mCc_parser_parse_string("void main() { int x; x = 1; }");
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	auto prog = result.program;
+	auto decl = prog->func_defs[0]->body->compound_stmts[0]->declaration;
+
+	struct mCc_context *ctx = mCc_context_new();
+	mCc_symtab_set_interner(ctx, prog->interner);
+	auto scope = mCc_symtab_new_root_scope(ctx, "");
+	ASSERT_EQ(0, mCc_symtab_scope_add_decl(scope, decl));
+	auto entry = mCc_symtab_scope_lookup_id(scope, decl->decl_id);
+	ASSERT_NE(nullptr, entry);
+	ASSERT_EQ(decl->decl_id->atom, entry->atom);
+
+	// Identifiers built by hand are found by their name
+	struct mCc_ast_identifier id = {};
+	id.id_value = (char *)"x";
+	ASSERT_EQ(entry, mCc_symtab_scope_lookup_id(scope, &id));
+	id.id_value = (char *)"print";
+	ASSERT_NE(nullptr, mCc_symtab_scope_lookup_id(scope, &id));
+	id.id_value = (char *)"y";
+	ASSERT_EQ(nullptr, mCc_symtab_scope_lookup_id(scope, &id));
+
+	// So are those of another tree
+	auto other = mCc_parser_parse_string("x");
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, other.status);
+	ASSERT_EQ(entry, mCc_symtab_scope_lookup_id(scope,
+	                                            other.expression->identifier));
+	mCc_ast_delete_expression(other.expression);
+
+	mCc_context_delete(ctx);
+	mCc_ast_delete_program(prog);
+}
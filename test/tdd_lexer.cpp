@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "examples.h"
+#include "mCc/lexer.h"
+#include "mCc/source.h"
+
+// Scan a text with both lexers and compare the tokens
+static void expect_same_tokens(const std::string &text)
+{
+	SCOPED_TRACE(text.size() < 200 ? text : text.substr(0, 200));
+	struct mCc_source source;
+	ASSERT_EQ(0, mCc_source_init(&source, text.data(), text.size(), nullptr));
+
+	unsigned int flex_count, hand_count;
+	auto flex = mCc_lexer_tokens(&source, MCC_LEXER_KIND_FLEX, &flex_count);
+	auto hand = mCc_lexer_tokens(&source, MCC_LEXER_KIND_HAND, &hand_count);
+	ASSERT_NE(nullptr, flex);
+	ASSERT_NE(nullptr, hand);
+	// Both leave the text as it was
+	ASSERT_EQ(text, std::string(source.data, source.size));
+
+	EXPECT_EQ(flex_count, hand_count);
+	for (unsigned int i = 0; i < std::min(flex_count, hand_count); ++i) {
+		SCOPED_TRACE("token " + std::to_string(i));
+		ASSERT_EQ(flex[i].kind, hand[i].kind);
+		ASSERT_EQ(flex[i].start_offset, hand[i].start_offset);
+		ASSERT_EQ(flex[i].end_offset, hand[i].end_offset);
+		// The literal values, bit for bit
+		ASSERT_EQ(0, std::memcmp(&flex[i].i_value, &hand[i].i_value,
+		                         sizeof(double)));
+	}
+	free(flex);
+	free(hand);
+	mCc_source_close(&source);
+}
+
+TEST(Lexer, SameTokensAsFlexOnExamples)
+{
+	auto sources = read_examples();
+	ASSERT_FALSE(sources.empty());
+	for (auto &source : sources)
+		expect_same_tokens(source);
+}
+
+TEST(Lexer, SameTokensAsFlexOnEdgeCases)
+{
+	const char *inputs[] = {
+		"",
+		"   \n\t\r  ",
+		"int iff int1 _int Int bool boolean float string strings void",
+		"if else while return true false truefalse",
+		"a<=b>=c==d!=e<f>g=h!i&&j||k+l-m*n/o;(p)[q]{r},",
+		"a & b | c & & d",
+		"@ # $ ` ~ ' \\ ? .5 1.",
+		"0 007 2147483647 99999999999999999999999999",
+		"1.5 0.1 3.14159265358979323846264338 0.000000000000000000000001",
+		"123456789012345.6789 9007199254740993.0 1.50000000000000000000000",
+		"1.5e3 12ab",
+		"\"a string\" \"\" \"unterminated",
+		"/* comment */ x /**/ y /***/ z /* a **/ w */",
+		"/* comment with * stars ** and / slashes */ done",
+		"/* unterminated comment",
+		"x /",
+		"x /* */",
+		"x\n\n\n                                                        \n",
+	};
+	for (auto input : inputs)
+		expect_same_tokens(input);
+
+	// Runs longer than a vector
+	expect_same_tokens("/*" + std::string(100, 'x') + "*" +
+	                   std::string(70, ' ') + "*/ a" + std::string(70, '\t') +
+	                   "b" + std::string(33, ' '));
+}
+
+TEST(Lexer, TokenText)
+{
+	const char text[] = "int foo = \"bar\";";
+	struct mCc_source source;
+	ASSERT_EQ(0, mCc_source_init(&source, text, sizeof(text) - 1, nullptr));
+	struct mCc_lexer lexer;
+	mCc_lexer_init(&lexer, &source);
+
+	struct mCc_lexer_token token;
+	ASSERT_NE(0, mCc_lexer_next(&lexer, &token));
+	ASSERT_EQ(MCC_AST_TYPE_INT, token.type);
+	ASSERT_STREQ("int", token.text);
+
+	// The text is terminated in place until the next token
+	ASSERT_NE(0, mCc_lexer_next(&lexer, &token));
+	ASSERT_STREQ("foo", token.text);
+	ASSERT_EQ(source.data + 4, token.text);
+	ASSERT_EQ(4u, token.start_offset);
+	ASSERT_EQ(7u, token.end_offset);
+	ASSERT_NE(0, mCc_lexer_next(&lexer, &token));
+	ASSERT_STREQ("=", token.text);
+	ASSERT_NE(0, mCc_lexer_next(&lexer, &token));
+	ASSERT_STREQ("\"bar\"", token.text);
+	ASSERT_NE(0, mCc_lexer_next(&lexer, &token));
+
+	// The end keeps the range of the last match
+	ASSERT_EQ(0, mCc_lexer_next(&lexer, &token));
+	ASSERT_STREQ("", token.text);
+	ASSERT_EQ(15u, token.start_offset);
+	ASSERT_EQ(16u, token.end_offset);
+	ASSERT_EQ(0, mCc_lexer_next(&lexer, &token));
+
+	mCc_lexer_close(&lexer);
+	ASSERT_STREQ(text, source.data);
+	mCc_source_close(&source);
+}
@@ -0,0 +1,377 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "examples.h"
+#include "mCc/ast_print.h"
+#include "mCc/ast_statements.h"
+#include "mCc/ast_visit.h"
+#include "mCc/parser.h"
+#include "mCc/parser_descent.h"
+#include "mCc/source.h"
+
+// The node addresses numbered in order of appearance
+static std::string number_nodes(const std::string &text)
+{
+	std::regex address("0x[0-9a-f]+");
+	std::map<std::string, int> ids;
+	std::string result;
+	auto last = text.cbegin();
+	for (std::sregex_iterator it(text.begin(), text.end(), address), end;
+	     it != end; ++it) {
+		result.append(last, (*it)[0].first);
+		auto id = ids.emplace(it->str(), ids.size()).first->second;
+		result += "n" + std::to_string(id);
+		last = (*it)[0].second;
+	}
+	result.append(last, text.cend());
+	return result;
+}
+
+static void add_loc(std::string *locs, struct mCc_ast_node *node)
+{
+	*locs += std::to_string(node->sloc.start_offset) + "-" +
+	         std::to_string(node->sloc.end_offset) + " ";
+}
+
+#define LOC_CB(name, type)                                                     \
+	static void loc_##name(struct type *n, void *data)                     \
+	{                                                                      \
+		add_loc(static_cast<std::string *>(data), &n->node);           \
+	}
+LOC_CB(statement, mCc_ast_statement)
+LOC_CB(declaration, mCc_ast_declaration)
+LOC_CB(expression, mCc_ast_expression)
+LOC_CB(literal, mCc_ast_literal)
+LOC_CB(identifier, mCc_ast_identifier)
+LOC_CB(arguments, mCc_ast_arguments)
+LOC_CB(parameter, mCc_ast_parameters)
+LOC_CB(function_def, mCc_ast_function_def)
+LOC_CB(program, mCc_ast_program)
+
+// The DOT output followed by the locations of all nodes in pre-order
+static std::string describe(const struct mCc_parser_result &result)
+{
+	std::string locs;
+	struct mCc_ast_visitor visitor = {};
+	visitor.traversal = MCC_AST_VISIT_DEPTH_FIRST;
+	visitor.order = MCC_AST_VISIT_PRE_ORDER;
+	visitor.userdata = &locs;
+	visitor.statement = loc_statement;
+	visitor.declaration = loc_declaration;
+	visitor.expression = loc_expression;
+	visitor.literal = loc_literal;
+	visitor.identifier = loc_identifier;
+	visitor.arguments = loc_arguments;
+	visitor.parameter = loc_parameter;
+	visitor.function_def = loc_function_def;
+	visitor.program = loc_program;
+
+	char *data;
+	size_t size;
+	FILE *out = open_memstream(&data, &size);
+	if (result.program) {
+		mCc_ast_print_dot_program(out, result.program);
+		mCc_ast_visit_program(result.program, &visitor);
+	} else if (result.statement) {
+		mCc_ast_print_dot_statement(out, result.statement);
+		mCc_ast_visit_statement(result.statement, &visitor);
+	} else if (result.expression) {
+		mCc_ast_print_dot_expression(out, result.expression);
+		mCc_ast_visit_expression(result.expression, &visitor);
+	}
+	fclose(out);
+	std::string text(data, size);
+	free(data);
+	return number_nodes(text) + "\n" + locs;
+}
+
+static void delete_result(struct mCc_parser_result &result)
+{
+	if (result.program)
+		mCc_ast_delete_program(result.program);
+	else if (result.statement)
+		mCc_ast_delete_statement(result.statement);
+	else if (result.expression)
+		mCc_ast_delete_expression(result.expression);
+}
+
+static struct mCc_parser_result parse(enum mCc_parser_kind kind,
+                                      const std::string &input)
+{
+	return mCc_parser_parse_buffer(input.data(), input.size(), kind);
+}
+
+// Parse with both parsers and compare the trees, or where the errors are
+static void expect_same_tree(const std::string &input)
+{
+	SCOPED_TRACE(input.size() < 200 ? input : input.substr(0, 200));
+	auto bison = parse(MCC_PARSER_KIND_BISON, input);
+	auto descent = parse(MCC_PARSER_KIND_DESCENT, input);
+
+	ASSERT_EQ(bison.status, descent.status);
+	if (bison.status != MCC_PARSER_STATUS_OK) {
+		// The text at the end depends on the scanner
+		if (descent.err_text[0]) {
+			EXPECT_STREQ(bison.err_text, descent.err_text);
+		}
+		EXPECT_EQ(bison.err_loc.start_offset, descent.err_loc.start_offset);
+		EXPECT_EQ(bison.err_loc.start_line, descent.err_loc.start_line);
+		EXPECT_EQ(bison.err_loc.start_col, descent.err_loc.start_col);
+		free((void *)bison.err_msg);
+		free((void *)bison.err_text);
+		free((void *)descent.err_msg);
+		free((void *)descent.err_text);
+		return;
+	}
+
+	EXPECT_EQ(bison.program != nullptr, descent.program != nullptr);
+	EXPECT_EQ(bison.statement != nullptr, descent.statement != nullptr);
+	EXPECT_EQ(bison.expression != nullptr, descent.expression != nullptr);
+	EXPECT_EQ(describe(bison), describe(descent));
+
+	delete_result(bison);
+	delete_result(descent);
+}
+
+TEST(ParserDescent, SameTreeAsBisonOnExamples)
+{
+	auto sources = read_examples();
+	ASSERT_LT(0u, sources.size());
+	for (auto &src : sources)
+		expect_same_tree(src);
+}
+
+TEST(ParserDescent, SameTreeAsBison)
+{
+	const char *inputs[] = {
+		"",
+		"42",
+		"42 * (-192 + 3.14)",
+		"1 + 2 * 3 - 4 / 5 < 6 == 7 != 8 >= 9 <= 10 > 11",
+		"a || b && c || !d && -e",
+		"-a[1] + f(x, y * 2, g()) < !b || c && d",
+		"\"str\" == x",
+		"- - !-1 * -(2)",
+		"((a))",
+		"f(f(f(1), 2), (3))",
+		"x;",
+		"a = b[3] - -4;",
+		"a[i + 1] = f(a[i]);",
+		"a[1] + 2;",
+		"f(a);",
+		"return x + 1;",
+		"return;",
+		"if (a) if (b) c; else d;",
+		"if (a) { } else if (b) { c = 1; } else { d; e; }",
+		"while (a < 10) a = a + 1;",
+		"{ int [10] a; a[0] = 1; { } { b; } }",
+		"int x;",
+		"string [5] s;",
+		"bool [true] b;",
+		"void main() { }",
+		"int f(int a, float [3] b, string c) { return a; } void g() { f(1); }",
+		"void f() { while (1) { if (x) return; } } bool g(bool b) { }",
+	};
+	for (auto input : inputs)
+		expect_same_tree(input);
+}
+
+TEST(ParserDescent, SameErrorsAsBison)
+{
+	const char *inputs[] = {
+		"a = ;",
+		"a = b",
+		"int x",
+		"f(1,)",
+		"1 + (2",
+		"(1 + 2))",
+		"a[1 + 2;",
+		"x; y;",
+		"void f( { }",
+		"void f(int a,) { }",
+		"int f() { return 1 }",
+		"if a",
+		"{ a; ",
+		"void 1",
+		"int [x] y;",
+		"void f() { } x;",
+	};
+	for (auto input : inputs)
+		expect_same_tree(input);
+}
+
+TEST(ParserDescent, DeepExpressions)
+{
+	const int depth = 100000;
+	std::string parenths = std::string(depth, '(') + "1" + std::string(depth, ')');
+	std::string unary = std::string(depth, '-') + "x";
+	std::string calls;
+	for (int i = 0; i < depth; ++i)
+		calls += "f(a[";
+	calls += "1";
+	for (int i = 0; i < depth; ++i)
+		calls += "])";
+
+	for (auto &input : { parenths, unary, calls }) {
+		auto result = parse(MCC_PARSER_KIND_DESCENT, input);
+		ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+		ASSERT_NE(nullptr, result.expression);
+		EXPECT_EQ(0u, result.expression->node.sloc.start_offset);
+		EXPECT_EQ(input.size(), result.expression->node.sloc.end_offset);
+		delete_result(result);
+	}
+}
+
+TEST(ParserDescent, DeepStatementsFallBackToBison)
+{
+	for (int depth : { MCC_PARSER_DESCENT_MAX_DEPTH - 1,
+	                   MCC_PARSER_DESCENT_MAX_DEPTH + 1 }) {
+		std::string blocks = "void main() { " + std::string(depth, '{') +
+		                     "x = 1;" + std::string(depth, '}') + " }";
+		expect_same_tree(blocks);
+
+		std::string ifs = "void main() { ";
+		for (int i = 0; i < depth; ++i)
+			ifs += "if (a) x; else ";
+		ifs += "y; }";
+		expect_same_tree(ifs);
+	}
+}
+
+struct streamed {
+	std::string signatures;
+	std::vector<std::string> functions;
+	int stop_after; ///< Stop after this many functions, -1 never
+};
+
+static std::string describe_func_def(struct mCc_ast_function_def *func)
+{
+	char *data;
+	size_t size;
+	FILE *out = open_memstream(&data, &size);
+	mCc_ast_print_dot_function_def(out, func);
+	fclose(out);
+	std::string text(data, size);
+	free(data);
+	return number_nodes(text) + "\n" +
+	       std::to_string(func->node.sloc.start_offset) + "-" +
+	       std::to_string(func->node.sloc.end_offset);
+}
+
+static int stream_signatures(struct mCc_ast_program *program, void *data)
+{
+	auto s = static_cast<struct streamed *>(data);
+	for (unsigned int i = 0; i < program->func_def_count; ++i) {
+		EXPECT_EQ(nullptr, program->func_defs[i]->body);
+		s->signatures += program->func_defs[i]->identifier->id_value;
+		s->signatures += " ";
+	}
+	return 0;
+}
+
+static int stream_function(struct mCc_ast_function_def *func, void *data)
+{
+	auto s = static_cast<struct streamed *>(data);
+	s->functions.push_back(describe_func_def(func));
+	mCc_ast_delete_func_def(func);
+	return (int)s->functions.size() == s->stop_after;
+}
+
+static struct mCc_parser_result parse_stream(const std::string &input,
+                                             struct streamed *s)
+{
+	struct mCc_parser_stream stream = {};
+	stream.signatures = stream_signatures;
+	stream.function = stream_function;
+	stream.userdata = s;
+	struct mCc_source source;
+	EXPECT_EQ(0, mCc_source_init(&source, input.data(), input.size(),
+	                             nullptr));
+	auto result = mCc_parser_parse_source_stream(&source, &stream);
+	if (result.program)
+		mCc_ast_delete_program(result.program);
+	mCc_source_close(&source);
+	return result;
+}
+
+TEST(ParserDescent, StreamSameFunctions)
+{
+	auto sources = read_examples();
+	sources.push_back("int f(int a, float [3] b) { { if (a) { } } return a; }"
+	                  " void g() { } bool h() { return f(1, x) == 2; }");
+	for (auto &src : sources) {
+		auto whole = parse(MCC_PARSER_KIND_BISON, src);
+		ASSERT_EQ(MCC_PARSER_STATUS_OK, whole.status);
+		ASSERT_NE(nullptr, whole.program);
+		std::string names;
+		std::vector<std::string> functions;
+		for (unsigned int i = 0; i < whole.program->func_def_count; ++i) {
+			auto func = whole.program->func_defs[i];
+			names += func->identifier->id_value + std::string(" ");
+			functions.push_back(describe_func_def(func));
+		}
+		delete_result(whole);
+
+		struct streamed s = { "", {}, -1 };
+		auto result = parse_stream(src, &s);
+		ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+		EXPECT_EQ(names, s.signatures);
+		EXPECT_EQ(functions, s.functions);
+	}
+}
+
+TEST(ParserDescent, StreamStops)
+{
+	const std::string program = "void f() { } void g() { } void h() { }";
+	struct streamed s = { "", {}, 2 };
+	auto result = parse_stream(program, &s);
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	EXPECT_EQ("f g h ", s.signatures);
+	EXPECT_EQ(2u, s.functions.size());
+
+	// A syntax error in a body stops after the functions before it
+	s = { "", {}, -1 };
+	const std::string broken = "void f() { } void g() { x = ; } void h() { }";
+	result = parse_stream(broken, &s);
+	ASSERT_EQ(MCC_PARSER_STATUS_PARSE_ERROR, result.status);
+	EXPECT_EQ(28u, result.err_loc.start_offset);
+	EXPECT_EQ(1u, s.functions.size());
+	free((void *)result.err_msg);
+	free((void *)result.err_text);
+
+	// Without proper signatures, the whole source is parsed
+	for (auto input :
+	     { "void f() { } void g(int) { }", "x = 1;", "void f() {" }) {
+		s = { "", {}, -1 };
+		result = parse_stream(input, &s);
+		auto whole = parse(MCC_PARSER_KIND_BISON, input);
+		EXPECT_EQ(whole.status, result.status);
+		EXPECT_EQ(whole.err_loc.start_offset, result.err_loc.start_offset);
+		EXPECT_EQ("", s.signatures);
+		EXPECT_EQ(0u, s.functions.size());
+		if (result.statement)
+			mCc_ast_delete_statement(result.statement);
+		free((void *)result.err_msg);
+		free((void *)result.err_text);
+		free((void *)whole.err_msg);
+		free((void *)whole.err_text);
+		if (whole.status == MCC_PARSER_STATUS_OK)
+			delete_result(whole);
+	}
+
+	// Statements too deep for the descent parser cannot be streamed
+	int depth = MCC_PARSER_DESCENT_MAX_DEPTH + 1;
+	s = { "", {}, -1 };
+	result = parse_stream("void f() { } void main() { " +
+	                          std::string(depth, '{') +
+	                          std::string(depth, '}') + " }",
+	                      &s);
+	ASSERT_EQ(MCC_PARSER_STATUS_TOO_DEEP, result.status);
+	EXPECT_EQ(1u, s.functions.size());
+}
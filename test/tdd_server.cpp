@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "examples.h"
+#include "mCc/compile.h"
+#include "mCc/server.h"
+
+/* A server on a fresh socket, stopped at the end of the test */
+class Server : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		char dir[] = "/tmp/mCc_server_XXXXXX";
+		ASSERT_NE(nullptr, mkdtemp(dir));
+		this->dir = dir;
+		path = this->dir + "/sock";
+		ASSERT_LE(0, listen_fd = mCc_server_listen(path.c_str()));
+		server = std::thread(
+		    [this] { ASSERT_EQ(0, mCc_server_run(listen_fd, 2)); });
+	}
+
+	void TearDown() override
+	{
+		shutdown(listen_fd, SHUT_RDWR);
+		server.join();
+		close(listen_fd);
+		unlink(path.c_str());
+		rmdir(dir.c_str());
+	}
+
+	std::string dir, path;
+	int listen_fd = -1;
+	std::thread server;
+};
+
+TEST_F(Server, SameAsInProcess)
+{
+	int fd = mCc_client_connect(path.c_str());
+	ASSERT_LE(0, fd);
+
+	// Requests on one connection reuse the server's context
+	for (unsigned int opt_level = 0; opt_level <= 3; ++opt_level) {
+		struct mCc_compile_options options =
+		    mCc_compile_default_options(opt_level);
+		options.source_name = "hello.mC";
+		for (auto parser :
+		     { MCC_PARSER_KIND_BISON, MCC_PARSER_KIND_DESCENT }) {
+			options.parser = parser;
+			struct mCc_output output;
+			ASSERT_EQ(MCC_COMPILE_STATUS_OK,
+			          mCc_client_compile(fd, hello, strlen(hello),
+			                             &options, &output));
+			ASSERT_EQ(0u, output.diagnostic_count);
+			ASSERT_EQ(compile(hello, &options),
+			          std::string(output.data, output.size));
+			mCc_output_free(&output);
+		}
+	}
+
+	struct mCc_compile_options options = mCc_compile_default_options(2);
+	options.output_kind = MCC_COMPILE_OUTPUT_OBJECT;
+	struct mCc_output output;
+	ASSERT_EQ(MCC_COMPILE_STATUS_OK,
+	          mCc_client_compile(fd, hello, strlen(hello), &options, &output));
+	ASSERT_EQ(0, memcmp("\x7f" "ELF", output.data, 4));
+	mCc_output_free(&output);
+	close(fd);
+}
+
+TEST_F(Server, Diagnostics)
+{
+	int fd = mCc_client_connect(path.c_str());
+	ASSERT_LE(0, fd);
+
+	const char parse_error[] = "void main() {\n  int a\n}";
+	struct mCc_output output;
+	ASSERT_EQ(MCC_COMPILE_STATUS_PARSE_ERROR,
+	          mCc_client_compile(fd, parse_error, strlen(parse_error), nullptr,
+	                             &output));
+	ASSERT_EQ(nullptr, output.data);
+	ASSERT_EQ(1u, output.diagnostic_count);
+	ASSERT_EQ(3, output.diagnostics[0].loc.start_line);
+	ASSERT_STREQ("}", output.diagnostics[0].text);
+	mCc_output_free(&output);
+
+	const char type_error[] = "void main() {\n  int a;\n  a = 1.5;\n}";
+	ASSERT_EQ(MCC_COMPILE_STATUS_TYPE_ERROR,
+	          mCc_client_compile(fd, type_error, strlen(type_error), nullptr,
+	                             &output));
+	ASSERT_EQ(1u, output.diagnostic_count);
+	ASSERT_EQ(nullptr, output.diagnostics[0].text);
+	mCc_output_free(&output);
+
+	// A failed symbol table does not break the next request
+	const char symtab_error[] = "void main() { b = 1; }";
+	ASSERT_EQ(MCC_COMPILE_STATUS_SYMTAB_ERROR,
+	          mCc_client_compile(fd, symtab_error, strlen(symtab_error),
+	                             nullptr, &output));
+	mCc_output_free(&output);
+	ASSERT_EQ(MCC_COMPILE_STATUS_OK,
+	          mCc_client_compile(fd, hello, strlen(hello), nullptr, &output));
+	mCc_output_free(&output);
+	close(fd);
+}
+
+TEST_F(Server, ConcurrentClients)
+{
+	struct mCc_compile_options options = mCc_compile_default_options(3);
+	std::string expected = compile(hello, &options);
+
+	std::thread clients[4];
+	for (auto &client : clients) {
+		client = std::thread([&] {
+			for (int i = 0; i < 20; ++i) {
+				int fd = mCc_client_connect(path.c_str());
+				ASSERT_LE(0, fd);
+				struct mCc_output output;
+				EXPECT_EQ(MCC_COMPILE_STATUS_OK,
+				          mCc_client_compile(fd, hello, strlen(hello),
+				                             &options, &output));
+				EXPECT_EQ(expected, std::string(output.data, output.size));
+				mCc_output_free(&output);
+				close(fd);
+			}
+		});
+	}
+	for (auto &client : clients)
+		client.join();
+}
+
+TEST_F(Server, PathInUse)
+{
+	// A live server keeps its socket
+	errno = 0;
+	ASSERT_EQ(-1, mCc_server_listen(path.c_str()));
+	ASSERT_EQ(EADDRINUSE, errno);
+	int fd = mCc_client_connect(path.c_str());
+	ASSERT_LE(0, fd);
+	close(fd);
+
+	// Other files are never replaced
+	std::string file = dir + "/file";
+	FILE *f = fopen(file.c_str(), "w");
+	ASSERT_NE(nullptr, f);
+	fputs("keep", f);
+	fclose(f);
+	errno = 0;
+	ASSERT_EQ(-1, mCc_server_listen(file.c_str()));
+	ASSERT_EQ(EEXIST, errno);
+	struct stat st;
+	ASSERT_EQ(0, stat(file.c_str(), &st));
+	ASSERT_TRUE(S_ISREG(st.st_mode));
+	ASSERT_EQ(4, st.st_size);
+	unlink(file.c_str());
+
+	// A socket nobody listens on is stale
+	std::string stale = dir + "/stale";
+	int old_fd = mCc_server_listen(stale.c_str());
+	ASSERT_LE(0, old_fd);
+	close(old_fd);
+	int new_fd = mCc_server_listen(stale.c_str());
+	ASSERT_LE(0, new_fd);
+	close(new_fd);
+	unlink(stale.c_str());
+}
+
+TEST(Client, NoServer)
+{
+	ASSERT_EQ(-1, mCc_client_connect("/nonexistent/mCc.sock"));
+
+	// A connection the server closed
+	int fds[2];
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	close(fds[1]);
+	struct mCc_output output;
+	ASSERT_EQ(MCC_COMPILE_STATUS_SERVER_ERROR,
+	          mCc_client_compile(fds[0], hello, strlen(hello), nullptr,
+	                             &output));
+	ASSERT_EQ(1u, output.diagnostic_count);
+	ASSERT_EQ(nullptr, output.data);
+	mCc_output_free(&output);
+	close(fds[0]);
+}
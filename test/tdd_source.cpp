@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include "mCc/parser.h"
+#include "mCc/source.h"
+
+/* Write a temporary file, returning its path */
+static std::string write_temp(const std::string &text)
+{
+	char path[] = "/tmp/mCc_source_XXXXXX";
+	int fd = mkstemp(path);
+	EXPECT_LE(0, fd);
+	EXPECT_EQ((ssize_t)text.size(), write(fd, text.data(), text.size()));
+	close(fd);
+	return path;
+}
+
+TEST(Source, Locate)
+{
+	struct mCc_source source;
+	const char text[] = "ab\n\ncd\nef";
+	ASSERT_EQ(0, mCc_source_init(&source, text, sizeof(text) - 1, nullptr));
+	ASSERT_EQ('\0', source.data[source.size]);
+	ASSERT_EQ('\0', source.data[source.size + 1]);
+	ASSERT_EQ(nullptr, source.line_starts);
+
+	// "cd", the end column is that of the last byte
+	auto loc = mCc_source_locate(&source, 4, 6);
+	ASSERT_NE(nullptr, source.line_starts);
+	ASSERT_EQ(4u, source.line_count);
+	ASSERT_EQ(3, loc.start_line);
+	ASSERT_EQ(1, loc.start_col);
+	ASSERT_EQ(3, loc.end_line);
+	ASSERT_EQ(2, loc.end_col);
+	ASSERT_EQ(4u, loc.start_offset);
+	ASSERT_EQ(6u, loc.end_offset);
+
+	// Up to the end of the text, which has no newline
+	loc = mCc_source_locate(&source, 1, 9);
+	ASSERT_EQ(1, loc.start_line);
+	ASSERT_EQ(2, loc.start_col);
+	ASSERT_EQ(4, loc.end_line);
+	ASSERT_EQ(2, loc.end_col);
+
+	// An empty location is left alone
+	struct mCc_ast_source_location empty = {};
+	mCc_source_resolve(&source, &empty);
+	ASSERT_EQ(0, empty.start_line);
+	mCc_source_close(&source);
+}
+
+TEST(Source, OpenMapped)
+{
+	std::string path = write_temp("void main() {}\n");
+	struct mCc_source source;
+	ASSERT_EQ(0, mCc_source_open(&source, path.c_str()));
+	ASSERT_NE(0u, source.mapped_size);
+	ASSERT_EQ(15u, source.size);
+	ASSERT_EQ("void main() {}\n", std::string(source.data, source.size));
+	ASSERT_EQ('\0', source.data[source.size]);
+	ASSERT_EQ('\0', source.data[source.size + 1]);
+	mCc_source_close(&source);
+	unlink(path.c_str());
+}
+
+TEST(Source, OpenFullPage)
+{
+	// No room for the NULs after the text in its last page, so it is read
+	long page = sysconf(_SC_PAGESIZE);
+	std::string text = "void main() {}\n";
+	text += "/*" + std::string(page - text.size() - 5, '*') + "*/\n";
+	ASSERT_EQ((size_t)page, text.size());
+	std::string path = write_temp(text);
+
+	struct mCc_source source;
+	ASSERT_EQ(0, mCc_source_open(&source, path.c_str()));
+	ASSERT_EQ(0u, source.mapped_size);
+	ASSERT_EQ(text, std::string(source.data, source.size));
+	ASSERT_EQ('\0', source.data[source.size + 1]);
+
+	auto result = mCc_parser_parse_source(&source, MCC_PARSER_KIND_DEFAULT);
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	mCc_ast_delete_program(result.program);
+	mCc_source_close(&source);
+	unlink(path.c_str());
+
+	struct mCc_source missing;
+	ASSERT_EQ(-1, mCc_source_open(&missing, path.c_str()));
+}
+
+TEST(Source, ParsedOffsets)
+{
+	std::string path = write_temp("int f() {\n\treturn 1;\n}\n"
+	                              "void main() {\n\tf();\n}\n");
+	struct mCc_source source;
+	ASSERT_EQ(0, mCc_source_open(&source, path.c_str()));
+	auto result = mCc_parser_parse_source(&source, MCC_PARSER_KIND_DEFAULT);
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	auto prog = result.program;
+	ASSERT_EQ(&source, prog->source);
+
+	// The parser only records offsets, the lines are looked up on demand
+	auto ret = prog->func_defs[0]->body->compound_stmts[0];
+	auto loc = ret->node.sloc;
+	ASSERT_EQ(0, loc.start_line);
+	ASSERT_EQ(11u, loc.start_offset);
+	ASSERT_EQ(17u, loc.end_offset);
+	ASSERT_EQ(nullptr, source.line_starts);
+	mCc_source_resolve(prog->source, &loc);
+	ASSERT_EQ(2, loc.start_line);
+	ASSERT_EQ(2, loc.start_col);
+	ASSERT_EQ(2, loc.end_line);
+	ASSERT_EQ(7, loc.end_col);
+
+	auto call = prog->func_defs[1]->body->compound_stmts[0]->expression;
+	loc = call->node.sloc;
+	mCc_source_resolve(prog->source, &loc);
+	ASSERT_EQ(5, loc.start_line);
+	ASSERT_EQ(2, loc.start_col);
+	ASSERT_EQ(4, loc.end_col);
+
+	mCc_ast_delete_program(prog);
+	mCc_source_close(&source);
+	unlink(path.c_str());
+}
+
+TEST(Source, ParseErrorLocation)
+{
+	auto result = mCc_parser_parse_string("void main() {\n  int x\n}\n");
+	ASSERT_EQ(MCC_PARSER_STATUS_PARSE_ERROR, result.status);
+	ASSERT_EQ(3, result.err_loc.start_line);
+	ASSERT_EQ(1, result.err_loc.start_col);
+	ASSERT_EQ(3, result.err_loc.end_line);
+	ASSERT_EQ(1, result.err_loc.end_col);
+	free((void *)result.err_msg);
+	free((void *)result.err_text);
+}
@@ -1,23 +1,29 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <string>
+
+#include "mCc/context.h"
 #include "mCc/symtab.h"
 
+static struct mCc_context *ctx = mCc_context_new();
+
 TEST(SYMTAB_BASIC, SCOPE_NAMING)
 {
-	struct mCc_symtab_scope *root = mCc_symtab_new_scope_in(NULL, "root");
+	struct mCc_symtab_scope *root = mCc_symtab_new_root_scope(ctx, "root");
 	ASSERT_STREQ("root", root->name);
 	struct mCc_symtab_scope *child = mCc_symtab_new_scope_in(root, "child");
 	ASSERT_STREQ("root_child", child->name);
 
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(SYMTAB_BASIC, INSERT_LOOKUP_ENTRY)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 	ASSERT_NE((void *)NULL, scope);
 
-	struct mCc_ast_identifier id;
+	struct mCc_ast_identifier id = {};
 	id.id_value = (char *)"id";
 
 	struct mCc_ast_declaration decl;
@@ -31,15 +37,15 @@ TEST(SYMTAB_BASIC, INSERT_LOOKUP_ENTRY)
 	ASSERT_NE((void *)NULL, found);
 	ASSERT_STREQ(id.id_value, found->identifier->id_value);
 
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(SYMTAB_FUNC, INSERT_LOOKUP_FUNC_NAME)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 	ASSERT_NE((void *)NULL, scope);
 
-	struct mCc_ast_identifier id;
+	struct mCc_ast_identifier id = {};
 	id.id_value = (char *)"main";
 
 	struct mCc_ast_function_def func;
@@ -56,13 +62,13 @@ TEST(SYMTAB_FUNC, INSERT_LOOKUP_FUNC_NAME)
 	ASSERT_NE((void *)NULL, found);
 	ASSERT_STREQ(func.identifier->id_value, found->identifier->id_value);
 
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(SYMTAB_FUNC, LOOKUP_BUILT_IN_VOID_PARAM)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
-	struct mCc_ast_identifier id;
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
+	struct mCc_ast_identifier id = {};
 	id.id_value = (char *)"print";
 
 	struct mCc_symtab_entry *found = mCc_symtab_scope_lookup_id(scope, &id);
@@ -77,13 +83,13 @@ TEST(SYMTAB_FUNC, LOOKUP_BUILT_IN_VOID_PARAM)
 
 	ASSERT_STREQ("msg", found->params->decl[0]->decl_id->id_value);
 
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(SYMTAB_FUNC, LOOKUP_BUILT_IN_VOID_NO_PARAM)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
-	struct mCc_ast_identifier id;
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
+	struct mCc_ast_identifier id = {};
 	id.id_value = (char *)"print_nl";
 
 	struct mCc_symtab_entry *found = mCc_symtab_scope_lookup_id(scope, &id);
@@ -95,13 +101,13 @@ TEST(SYMTAB_FUNC, LOOKUP_BUILT_IN_VOID_NO_PARAM)
 
 	ASSERT_EQ((void *)NULL, found->params);
 
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(SYMTAB_FUNC, LOOKUP_BUILT_IN_TYPE_NO_PARAM)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
-	struct mCc_ast_identifier id;
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
+	struct mCc_ast_identifier id = {};
 	id.id_value = (char *)"read_int";
 
 	struct mCc_symtab_entry *found = mCc_symtab_scope_lookup_id(scope, &id);
@@ -113,5 +119,77 @@ TEST(SYMTAB_FUNC, LOOKUP_BUILT_IN_TYPE_NO_PARAM)
 
 	ASSERT_EQ((void *)NULL, found->params);
 
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
+}
+
+TEST(SYMTAB_FUNC, BUILT_INS_SHARED)
+{
+	struct mCc_context *other = mCc_context_new();
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
+	struct mCc_symtab_scope *other_scope = mCc_symtab_new_root_scope(other, "");
+	struct mCc_ast_identifier id = {};
+	id.id_value = (char *)"print_float";
+
+	// Both contexts refer to the same nodes, and so does the next root scope
+	struct mCc_symtab_entry *found = mCc_symtab_scope_lookup_id(scope, &id);
+	ASSERT_NE((void *)NULL, found);
+	ASSERT_TRUE(found->built_in);
+	struct mCc_ast_identifier *built_in = found->identifier;
+	ASSERT_EQ(built_in,
+	          mCc_symtab_scope_lookup_id(other_scope, &id)->identifier);
+	ASSERT_EQ(MCC_AST_TYPE_FLOAT, found->params->decl[0]->decl_type);
+	mCc_context_delete(other);
+
+	mCc_symtab_delete_scopes(ctx);
+	scope = mCc_symtab_new_root_scope(ctx, "");
+	ASSERT_EQ(built_in, mCc_symtab_scope_lookup_id(scope, &id)->identifier);
+
+	mCc_symtab_delete_all_scopes(ctx);
+}
+
+TEST(SYMTAB_BASIC, SHADOW_AND_LEAVE)
+{
+	struct mCc_symtab_scope *root = mCc_symtab_new_root_scope(ctx, "");
+	struct mCc_symtab_scope *func = mCc_symtab_new_scope_in(root, "f");
+
+	struct mCc_ast_identifier outer_id = {}, inner_id = {}, id = {};
+	outer_id.id_value = (char *)"a";
+	inner_id.id_value = (char *)"a";
+	id.id_value = (char *)"a";
+	struct mCc_ast_declaration outer = {}, inner = {};
+	outer.decl_type = MCC_AST_TYPE_INT;
+	outer.decl_id = &outer_id;
+	inner.decl_type = MCC_AST_TYPE_FLOAT;
+	inner.decl_id = &inner_id;
+
+	ASSERT_EQ(0, mCc_symtab_scope_add_decl(func, &outer));
+	ASSERT_EQ(1, mCc_symtab_scope_add_decl(func, &outer));
+
+	struct mCc_symtab_scope *block = mCc_symtab_new_scope_in(func, "anon");
+	ASSERT_STREQ("_f_anon", block->name);
+	ASSERT_EQ(0, mCc_symtab_scope_add_decl(block, &inner));
+	ASSERT_EQ(MCC_AST_TYPE_FLOAT,
+	          mCc_symtab_scope_lookup_id(block, &id)->primitive_type);
+	// Looking up from an enclosing scope skips the inner declaration
+	ASSERT_EQ(MCC_AST_TYPE_INT,
+	          mCc_symtab_scope_lookup_id(func, &id)->primitive_type);
+	ASSERT_EQ(nullptr, mCc_symtab_scope_lookup_id(root, &id));
+
+	ASSERT_EQ(func, mCc_symtab_scope_leave(block));
+	ASSERT_EQ(outer_id.symtab_ref, mCc_symtab_scope_lookup_id(func, &id));
+	ASSERT_EQ(root, mCc_symtab_scope_leave(func));
+	ASSERT_EQ(nullptr, mCc_symtab_scope_lookup_id(root, &id));
+
+	// The entries of the scopes that were left are still there to print
+	char *data;
+	size_t size;
+	FILE *out = open_memstream(&data, &size);
+	mCc_symtab_print_all_scopes(ctx, out);
+	fclose(out);
+	std::string text(data, size);
+	free(data);
+	ASSERT_NE(std::string::npos, text.find("| _f | a | var | int |"));
+	ASSERT_NE(std::string::npos, text.find("| _f_anon | a | var | float |"));
+
+	mCc_symtab_delete_all_scopes(ctx);
 }
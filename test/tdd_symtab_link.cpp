@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
 
 #include "mCc/ast_symtab_link.h"
+#include "mCc/context.h"
 #include "mCc/parser.h"
 #include "mCc/symtab.h"
 
+static struct mCc_context *ctx = mCc_context_new();
+
 TEST(TDD_PARSER_SYMTABLINK, TEST)
 {
 
@@ -13,7 +16,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST)
 	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"b");
 
 	ASSERT_EQ(0, strcmp(id->id_value,
@@ -23,7 +26,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST)
 
 	mCc_ast_delete_identifier(id);
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TDD_PARSER_SYMTABLINK, TEST_ARR)
@@ -35,7 +38,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_ARR)
 	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"b");
 
 	ASSERT_STREQ(id->id_value,
@@ -53,7 +56,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_ARR)
 
 	mCc_ast_delete_identifier(id);
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC)
@@ -66,7 +69,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC)
 	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	mCc_ast_identifier *ida = mCc_ast_new_identifier((char *)"a");
 	mCc_ast_identifier *idb = mCc_ast_new_identifier((char *)"b");
 	mCc_ast_identifier *idf = mCc_ast_new_identifier((char *)"f");
@@ -89,7 +92,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC)
 	mCc_ast_delete_identifier(idf);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_PARA)
@@ -102,7 +105,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_PARA)
 	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	mCc_ast_identifier *idb = mCc_ast_new_identifier((char *)"b");
 	mCc_ast_identifier *idf = mCc_ast_new_identifier((char *)"f");
 
@@ -123,7 +126,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_PARA)
 	mCc_ast_delete_identifier(idf);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_PARA2)
@@ -136,7 +139,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_PARA2)
 	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	mCc_ast_identifier *idb = mCc_ast_new_identifier((char *)"b");
 	mCc_ast_identifier *idr = mCc_ast_new_identifier((char *)"r");
 	mCc_ast_identifier *idf = mCc_ast_new_identifier((char *)"f");
@@ -163,7 +166,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_PARA2)
 	mCc_ast_delete_identifier(idf);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_RETURN)
@@ -175,7 +178,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_RETURN)
 	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	mCc_ast_identifier *idb = mCc_ast_new_identifier((char *)"b");
 	mCc_ast_identifier *idr = mCc_ast_new_identifier((char *)"r");
 	mCc_ast_identifier *idf = mCc_ast_new_identifier((char *)"f");
@@ -202,7 +205,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_RETURN)
 	mCc_ast_delete_identifier(idf);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_WITH_ARR_DECL)
@@ -215,7 +218,7 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_WITH_ARR_DECL)
 	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"t");
 
 	ASSERT_STREQ(id->id_value,
@@ -230,5 +233,66 @@ TEST(TDD_PARSER_SYMTABLINK, TEST_FUNC_WITH_ARR_DECL)
 	mCc_ast_delete_identifier(id);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
+}
+
+TEST(TDD_PARSER_SYMTABLINK, TEST_SLOTS)
+{
+
+	const char str[] = "int f(int a, int[3] b){ int c; if (a < 1) { int a; "
+	                   "a = c; } return b[a]; }"
+	                   "void main(){ int x; x = f(x, x); }";
+	auto result = mCc_parser_parse_string(str);
+
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	auto prog = result.program;
+
+	ASSERT_EQ(0, mCc_ast_symtab_build(ctx, prog).status);
+	auto f = prog->func_defs[0];
+	auto main = prog->func_defs[1];
+
+	// Numbered per function, in order of declaration, shadowed ones included
+	ASSERT_EQ(4u, f->slot_count);
+	ASSERT_EQ(1u, main->slot_count);
+	ASSERT_EQ(0u, f->para->decl[0]->decl_id->slot);
+	ASSERT_EQ(1u, f->para->decl[1]->decl_id->slot);
+	auto then = f->body->compound_stmts[1]->if_stmt;
+	auto inner = then->compound_stmts[1];
+	ASSERT_EQ(3u, then->compound_stmts[0]->declaration->decl_id->slot);
+	ASSERT_EQ(3u, inner->id_assgn->slot);
+	ASSERT_EQ(2u, inner->rhs_assgn->identifier->slot);
+
+	auto ret = f->body->compound_stmts[2]->ret_val;
+	ASSERT_EQ(1u, ret->array_id->slot);
+	ASSERT_EQ(0u, ret->subscript_expr->identifier->slot);
+
+	auto call = main->body->compound_stmts[1]->rhs_assgn;
+	ASSERT_EQ(MCC_AST_SLOT_NONE, call->f_name->slot);
+	ASSERT_EQ(0u, call->arguments->expressions[0]->identifier->slot);
+
+	mCc_ast_delete_program(prog);
+	mCc_symtab_delete_all_scopes(ctx);
+}
+
+TEST(TDD_PARSER_SYMTABLINK, TEST_CALLEE)
+{
+	const char str[] = "int f(int x) { return x; } "
+	                   "void main() { print_int(f(1)); }";
+	auto result = mCc_parser_parse_string(str);
+	ASSERT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	auto prog = result.program;
+
+	ASSERT_EQ(0, mCc_ast_symtab_build(ctx, prog).status);
+	auto print_int = prog->func_defs[1]->body->compound_stmts[0]->expression;
+	auto f = print_int->arguments->expressions[0];
+	// The callees stay linked without the scopes
+	mCc_symtab_delete_all_scopes(ctx);
+
+	ASSERT_EQ(prog->func_defs[0], f->callee);
+	ASSERT_FALSE(f->callee->built_in);
+	ASSERT_TRUE(print_int->callee->built_in);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, print_int->callee->func_type);
+	ASSERT_EQ(MCC_AST_TYPE_INT, print_int->callee->para->decl[0]->decl_type);
+
+	mCc_ast_delete_program(prog);
 }
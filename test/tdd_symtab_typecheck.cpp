@@ -1,22 +1,25 @@
 #include <gtest/gtest.h>
 
+#include "mCc/context.h"
 #include "mCc/parser.h"
 #include "mCc/typecheck.h"
 
+static struct mCc_context *ctx = mCc_context_new();
+
 TEST(TYPE_CHECK, LITERAL)
 {
 	struct mCc_ast_literal *lit = mCc_ast_new_literal_int(3);
 	struct mCc_ast_expression *expr = mCc_ast_new_expression_literal(lit);
 
-	ASSERT_EQ(MCC_AST_TYPE_INT, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_INT, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
 TEST(TYPE_CHECK, IDENTIFIER)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 	struct mCc_ast_identifier *decl_id = mCc_ast_new_identifier((char *)"foo");
 	struct mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"foo");
 	struct mCc_ast_declaration *decl =
@@ -28,12 +31,12 @@ TEST(TYPE_CHECK, IDENTIFIER)
 	expr->identifier->symtab_ref = found;
 
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
-	ASSERT_EQ(MCC_AST_TYPE_STRING, mCc_typecheck_test_type_check(expr).type);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
+	ASSERT_EQ(MCC_AST_TYPE_STRING, mCc_typecheck_test_type_check(ctx, expr).type);
 
 	mCc_ast_delete_declaration(decl);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_UNARY, UNARY_NEG_FLOAT)
@@ -42,9 +45,9 @@ TEST(TYPE_CHECK_UNARY, UNARY_NEG_FLOAT)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_FLOAT, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_FLOAT, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 
 	mCc_ast_delete_expression(expr);
 }
@@ -55,9 +58,9 @@ TEST(TYPE_CHECK_UNARY, UNARY_NEG_STRING)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -69,9 +72,9 @@ TEST(TYPE_CHECK_UNARY, UNARY_NOT_BOOL)
 
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 
 	mCc_ast_delete_expression(expr);
 }
@@ -82,9 +85,9 @@ TEST(TYPE_CHECK_UNARY, UNARY_NOT_INT)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -94,9 +97,9 @@ TEST(TYPE_CHECK_BINARY, NOT_MATCHING_SIDES)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -106,9 +109,9 @@ TEST(TYPE_CHECK_BINARY, BINARY_SUB_INT)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_INT, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_INT, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -118,9 +121,9 @@ TEST(TYPE_CHECK_BINARY, BINARY_LT_FLOAT)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -130,9 +133,9 @@ TEST(TYPE_CHECK_BINARY, BINARY_GEQ_BOOL)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -142,9 +145,9 @@ TEST(TYPE_CHECK_BINARY, BINARY_AND_BOOL)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -154,9 +157,9 @@ TEST(TYPE_CHECK_BINARY, BINARY_OR_INT)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -166,9 +169,9 @@ TEST(TYPE_CHECK_BINARY, BINARY_EQ_STRING)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -178,9 +181,9 @@ TEST(TYPE_CHECK_BINARY, BINARY_NEQ_BOOL)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_BOOL, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
@@ -190,15 +193,15 @@ TEST(TYPE_CHECK_PARENTH, PARENTH)
 	auto result = mCc_parser_parse_string(input);
 	auto expr = result.expression;
 
-	ASSERT_EQ(MCC_AST_TYPE_INT, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_INT, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
 }
 
 TEST(TYPE_CHECK_ARR_SUBSCR, INT_SUBSCR)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 	struct mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"foo");
 	struct mCc_ast_declaration *decl =
 	    mCc_ast_new_declaration(MCC_AST_TYPE_STRING, NULL, id);
@@ -212,17 +215,17 @@ TEST(TYPE_CHECK_ARR_SUBSCR, INT_SUBSCR)
 
 	expr->identifier->symtab_ref = found;
 
-	ASSERT_EQ(MCC_AST_TYPE_STRING, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_STRING, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_declaration(decl);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ARR_SUBSCR, NO_INT_SUBSCR)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 	struct mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"foo");
 	struct mCc_ast_declaration *decl =
 	    mCc_ast_new_declaration(MCC_AST_TYPE_INT, NULL, id);
@@ -236,17 +239,17 @@ TEST(TYPE_CHECK_ARR_SUBSCR, NO_INT_SUBSCR)
 
 	expr->identifier->symtab_ref = found;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_declaration(decl);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ARR_SUBSCR, EXPR_SUBSCR)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 	struct mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"foo");
 	struct mCc_ast_declaration *decl =
 	    mCc_ast_new_declaration(MCC_AST_TYPE_STRING, NULL, id);
@@ -260,17 +263,17 @@ TEST(TYPE_CHECK_ARR_SUBSCR, EXPR_SUBSCR)
 
 	expr->identifier->symtab_ref = found;
 
-	ASSERT_EQ(MCC_AST_TYPE_STRING, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_STRING, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_declaration(decl);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ARGUMENTS, VOID)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 
 	const char input[] = "print_nl()";
 	auto result = mCc_parser_parse_string(input);
@@ -281,16 +284,16 @@ TEST(TYPE_CHECK_ARGUMENTS, VOID)
 	assert(found);
 	expr->f_name->symtab_ref = found;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ARGUMENTS, MATCHING_PARAMS)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 
 	const char input[] = "print_int(2)";
 	auto result = mCc_parser_parse_string(input);
@@ -301,16 +304,16 @@ TEST(TYPE_CHECK_ARGUMENTS, MATCHING_PARAMS)
 	assert(found);
 	expr->f_name->symtab_ref = found;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ARGUMENTS, NOT_MATCHING_PARAMS)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 
 	const char input[] = "print_int(\"d\")";
 	auto result = mCc_parser_parse_string(input);
@@ -321,16 +324,16 @@ TEST(TYPE_CHECK_ARGUMENTS, NOT_MATCHING_PARAMS)
 	assert(found);
 	expr->f_name->symtab_ref = found;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ARGUMENTS, WRONG_NUMBER_OF_ARGS)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 
 	const char input[] = "print_int(1,2)";
 	auto result = mCc_parser_parse_string(input);
@@ -341,16 +344,16 @@ TEST(TYPE_CHECK_ARGUMENTS, WRONG_NUMBER_OF_ARGS)
 	assert(found);
 	expr->f_name->symtab_ref = found;
 
-	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_VOID, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_CALL_EXPR, RETURN_INT)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 
 	const char input[] = "read_int()";
 	auto result = mCc_parser_parse_string(input);
@@ -361,11 +364,11 @@ TEST(TYPE_CHECK_CALL_EXPR, RETURN_INT)
 	assert(found);
 	expr->f_name->symtab_ref = found;
 
-	ASSERT_EQ(MCC_AST_TYPE_INT, mCc_typecheck_test_type_check(expr).type);
+	ASSERT_EQ(MCC_AST_TYPE_INT, mCc_typecheck_test_type_check(ctx, expr).type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check(expr).status);
+	          mCc_typecheck_test_type_check(ctx, expr).status);
 	mCc_ast_delete_expression(expr);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_IFELSE, DANGLING_IF)
@@ -376,7 +379,7 @@ TEST(TYPE_CHECK_IFELSE, DANGLING_IF)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_IF, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -389,7 +392,7 @@ TEST(TYPE_CHECK_IFELSE, IF_ELSE)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_IFELSE, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -402,7 +405,7 @@ TEST(TYPE_CHECK_IFELSE, NO_BOOL_COND)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_IF, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -415,7 +418,7 @@ TEST(TYPE_CHECK_WHILE, WHILE_SUCCESS)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_WHILE, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -428,7 +431,7 @@ TEST(TYPE_CHECK_WHILE, WHILE_NO_BOOL)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_WHILE, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -441,14 +444,14 @@ TEST(TYPE_CHECK_WHILE, WHILE_WRONG_BODY)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_WHILE, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
 
 TEST(TYPE_CHECK_ASSGN, ASSGN_SUCCESS)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 	struct mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"foo");
 	struct mCc_ast_declaration *decl =
 	    mCc_ast_new_declaration(MCC_AST_TYPE_INT, NULL, id);
@@ -464,16 +467,16 @@ TEST(TYPE_CHECK_ASSGN, ASSGN_SUCCESS)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_ASSGN, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_declaration(decl);
 	mCc_ast_delete_statement(stmt);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ASSGN, ASSGN_FAILURE)
 {
-	struct mCc_symtab_scope *scope = mCc_symtab_new_scope_in(NULL, "");
+	struct mCc_symtab_scope *scope = mCc_symtab_new_root_scope(ctx, "");
 	struct mCc_ast_identifier *id = mCc_ast_new_identifier((char *)"foo");
 	struct mCc_ast_declaration *decl =
 	    mCc_ast_new_declaration(MCC_AST_TYPE_INT, NULL, id);
@@ -489,11 +492,11 @@ TEST(TYPE_CHECK_ASSGN, ASSGN_FAILURE)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_ASSGN, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_declaration(decl);
 	mCc_ast_delete_statement(stmt);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_EXPR, EXPR_SUCCESS)
@@ -504,7 +507,7 @@ TEST(TYPE_CHECK_EXPR, EXPR_SUCCESS)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_EXPR, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -517,7 +520,7 @@ TEST(TYPE_CHECK_CMPND, EMPTY)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_CMPND, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -530,7 +533,7 @@ TEST(TYPE_CHECK_CMPND, SINGLE)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_CMPND, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -543,7 +546,7 @@ TEST(TYPE_CHECK_CMPND, MULTIPLE)
 
 	ASSERT_EQ(MCC_AST_STATEMENT_TYPE_CMPND, stmt->type);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_stmt(stmt).status);
+	          mCc_typecheck_test_type_check_stmt(ctx, stmt).status);
 
 	mCc_ast_delete_statement(stmt);
 }
@@ -554,12 +557,12 @@ TEST(TYPE_CHECK_RETURN, RETURN_VOID)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, RETURN_INT)
@@ -569,12 +572,12 @@ TEST(TYPE_CHECK_RETURN, RETURN_INT)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, RETURN_WRONG_TYPE)
@@ -584,12 +587,12 @@ TEST(TYPE_CHECK_RETURN, RETURN_WRONG_TYPE)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, RETURN_IF_WRONG)
@@ -598,12 +601,12 @@ TEST(TYPE_CHECK_RETURN, RETURN_IF_WRONG)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, RETURN_IF)
@@ -612,12 +615,12 @@ TEST(TYPE_CHECK_RETURN, RETURN_IF)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, RETURN_DOUBLE_IF)
@@ -626,12 +629,12 @@ TEST(TYPE_CHECK_RETURN, RETURN_DOUBLE_IF)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, RETURN_IF_ELSE)
@@ -640,12 +643,12 @@ TEST(TYPE_CHECK_RETURN, RETURN_IF_ELSE)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, RETURN_IF_ELIF)
@@ -655,12 +658,12 @@ TEST(TYPE_CHECK_RETURN, RETURN_IF_ELIF)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ERROR_MSG, UNARY)
@@ -669,14 +672,14 @@ TEST(TYPE_CHECK_ERROR_MSG, UNARY)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
-	auto check_result = mCc_typecheck_test_type_check_program(prog);
+	mCc_ast_symtab_build(ctx, prog);
+	auto check_result = mCc_typecheck_test_type_check_program(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR, check_result.status);
 	ASSERT_STREQ("Expected type Integer or Float, but found Bool",
 	             check_result.err_msg);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_ERROR_MSG, BINARY_MISMATCH)
@@ -685,13 +688,13 @@ TEST(TYPE_CHECK_ERROR_MSG, BINARY_MISMATCH)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
-	auto check_result = mCc_typecheck_test_type_check_program(prog);
+	mCc_ast_symtab_build(ctx, prog);
+	auto check_result = mCc_typecheck_test_type_check_program(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR, check_result.status);
 	ASSERT_STREQ("Expected type Integer, but found Bool", check_result.err_msg);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, VOID_NO_RETURN)
@@ -700,12 +703,12 @@ TEST(TYPE_CHECK_RETURN, VOID_NO_RETURN)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, VOID_EMPTY_BODY)
@@ -714,12 +717,12 @@ TEST(TYPE_CHECK_RETURN, VOID_EMPTY_BODY)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_OK,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, TYPE_EMPTY_BODY)
@@ -728,12 +731,12 @@ TEST(TYPE_CHECK_RETURN, TYPE_EMPTY_BODY)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_RETURN, TYPE_IF_NO_CMPND)
@@ -743,12 +746,12 @@ TEST(TYPE_CHECK_RETURN, TYPE_IF_NO_CMPND)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_PARAM, UNMATCHING_NUMBER)
@@ -758,12 +761,12 @@ TEST(TYPE_CHECK_PARAM, UNMATCHING_NUMBER)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_PARAM, UNMATCHING_NUMBER_2)
@@ -773,12 +776,12 @@ TEST(TYPE_CHECK_PARAM, UNMATCHING_NUMBER_2)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_PARAM, UNMATCHING_NUMBER_3)
@@ -788,12 +791,12 @@ TEST(TYPE_CHECK_PARAM, UNMATCHING_NUMBER_3)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_PARAM, UNMATCHING_NUMBER_4)
@@ -803,12 +806,12 @@ TEST(TYPE_CHECK_PARAM, UNMATCHING_NUMBER_4)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
 
 TEST(TYPE_CHECK_PARAM, UNMATCHING_TYPE)
@@ -818,10 +821,10 @@ TEST(TYPE_CHECK_PARAM, UNMATCHING_TYPE)
 	auto result = mCc_parser_parse_string(input);
 	auto prog = result.program;
 
-	mCc_ast_symtab_build(prog);
+	mCc_ast_symtab_build(ctx, prog);
 	ASSERT_EQ(MCC_TYPECHECK_STATUS_ERROR,
-	          mCc_typecheck_test_type_check_program(prog).status);
+	          mCc_typecheck_test_type_check_program(ctx, prog).status);
 
 	mCc_ast_delete_program(prog);
-	mCc_symtab_delete_all_scopes();
+	mCc_symtab_delete_all_scopes(ctx);
 }
@@ -0,0 +1,316 @@
+#include <gtest/gtest.h>
+
+#include "mCc/ast_symtab_link.h"
+#include "mCc/context.h"
+#include "mCc/parser.h"
+#include "mCc/tac_builder.h"
+#include "mCc/tac_opt.h"
+#include "mCc/typecheck.h"
+
+static struct mCc_context *ctx = mCc_context_new();
+
+static struct mCc_tac_program *build_tac(const char *input,
+                                         struct mCc_ast_program **ast)
+{
+	auto result = mCc_parser_parse_string(input);
+	EXPECT_EQ(MCC_PARSER_STATUS_OK, result.status);
+	*ast = result.program;
+
+	auto link_result = mCc_ast_symtab_build(ctx, *ast);
+	EXPECT_EQ(0, link_result.status);
+	auto check_result = mCc_typecheck(ctx, *ast, link_result.root_symtab);
+	EXPECT_EQ(MCC_TYPECHECK_STATUS_OK, check_result.status);
+
+	return mCc_tac_build(ctx, *ast);
+}
+
+static void delete_tac(struct mCc_tac_program *tac, struct mCc_ast_program *ast)
+{
+	mCc_tac_program_delete(tac);
+	mCc_symtab_delete_all_scopes(ctx);
+	mCc_ast_delete_program(ast);
+}
+
+static unsigned int count_quads(struct mCc_tac_program *tac,
+                                enum mCc_tac_quad_type type)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < tac->quad_count; ++i)
+		if (tac->quads[i]->type == type)
+			++count;
+	return count;
+}
+
+TEST(TAC_OPT_IF_CONVERT, Triangle)
+{
+	const char input[] = "int max(int a, int b) { int m; m = b;"
+	                     "if (a > b) m = a; return m; }"
+	                     "void main() { print_int(max(1, 2)); }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(1, mCc_tac_opt_if_convert(tac, 4));
+	ASSERT_EQ(0u, count_quads(tac, MCC_TAC_QUAD_JUMPFALSE));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_SELECT));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_IF_CONVERT, DiamondSwap)
+{
+	const char input[] = "void sort(int a, int b) { int tmp;"
+	                     "if (a > b) { tmp = b; b = a; a = tmp; } else {}"
+	                     "print_int(a); print_int(b); }"
+	                     "void main() { sort(2, 1); }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(1, mCc_tac_opt_if_convert(tac, 4));
+	ASSERT_EQ(0u, count_quads(tac, MCC_TAC_QUAD_JUMPFALSE));
+	ASSERT_EQ(0u, count_quads(tac, MCC_TAC_QUAD_JUMP));
+	// tmp is not read after the if
+	ASSERT_EQ(2u, count_quads(tac, MCC_TAC_QUAD_SELECT));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_IF_CONVERT, SpeculationBudget)
+{
+	const char input[] = "void sort(int a, int b) { int tmp;"
+	                     "if (a > b) { tmp = b; b = a; a = tmp; }"
+	                     "print_int(a); print_int(b); }"
+	                     "void main() { sort(2, 1); }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(0, mCc_tac_opt_if_convert(tac, 2));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_JUMPFALSE));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_IF_CONVERT, SideEffects)
+{
+	const char input[] = "int f(int a, int b) {"
+	                     "if (b != 0) { a = a / b; print_int(a); }"
+	                     "return a; }"
+	                     "void main() { print_int(f(4, 2)); }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(0, mCc_tac_opt_if_convert(tac, 100));
+	ASSERT_EQ(0u, count_quads(tac, MCC_TAC_QUAD_SELECT));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_IF_CONVERT, UnsafeLoad)
+{
+	const char input[] = "int f(int[4] a, int i) { int r; r = 0;"
+	                     "if (i < 4) r = a[i]; return r; }"
+	                     "void main() { int[4] a; a[0] = 1; print_int(f(a, 0)); }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	// a[i] is not loaded before the branch, so i might be out of bounds
+	ASSERT_EQ(0, mCc_tac_opt_if_convert(tac, 100));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_ROTATE_LOOPS, WhileLoop)
+{
+	const char input[] = "void main() { int i; i = 0;"
+	                     "while (i < 5) { print_int(i); i = i + 1; } }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(1, mCc_tac_opt_rotate_loops(tac, 8));
+	// Guard before the loop, repeat at the bottom, no jump back
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_JUMPFALSE));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_JUMPTRUE));
+	ASSERT_EQ(0u, count_quads(tac, MCC_TAC_QUAD_JUMP));
+
+	unsigned int headers = 0;
+	for (unsigned int i = 0; i < tac->quad_count; ++i)
+		if (tac->quads[i]->type == MCC_TAC_QUAD_LABEL &&
+		    tac->quads[i]->loop_header)
+			++headers;
+	ASSERT_EQ(1u, headers);
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_ROTATE_LOOPS, ConditionTooLarge)
+{
+	const char input[] = "void main() { int i; i = 0;"
+	                     "while (i < 5) { i = i + 1; } }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(0, mCc_tac_opt_rotate_loops(tac, 1));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_JUMP));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_LAYOUT_BLOCKS, EarlyReturn)
+{
+	const char input[] = "int f(int n) { if (n == 0) { return 1; }"
+	                     "return n * 2; }"
+	                     "void main() { print_int(f(3)); }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(1, mCc_tac_opt_layout_blocks(tac));
+	ASSERT_EQ(0u, count_quads(tac, MCC_TAC_QUAD_JUMPFALSE));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_JUMPTRUE));
+
+	// The early return is placed after the fall-through return of f
+	unsigned int first_return = 0;
+	while (tac->quads[first_return]->type != MCC_TAC_QUAD_RETURN)
+		++first_return;
+	ASSERT_EQ(MCC_TAC_QUAD_LABEL, tac->quads[first_return + 1]->type);
+	ASSERT_EQ(MCC_TAC_QUAD_RETURN, tac->quads[first_return + 3]->type);
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_UNROLL_LOOPS, ConstantTripCount)
+{
+	const char input[] = "void main() { int i; i = 10;"
+	                     "while (i > 4) { print_int(i); i = i - 2; } }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	auto options = mCc_tac_opt_default_options(3);
+	ASSERT_EQ(1, mCc_tac_opt_unroll_loops(tac, &options));
+	// i = 10, 8, 6
+	ASSERT_EQ(0u, count_quads(tac, MCC_TAC_QUAD_JUMPFALSE));
+	ASSERT_EQ(0u, count_quads(tac, MCC_TAC_QUAD_JUMP));
+	ASSERT_EQ(3u, count_quads(tac, MCC_TAC_QUAD_CALL));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_UNROLL_LOOPS, UnknownTripCount)
+{
+	const char input[] = "void main() { int i; int n; n = read_int(); i = 0;"
+	                     "while (i < n) { print_int(i); i = i + 1; } }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	auto options = mCc_tac_opt_default_options(3);
+	options.unroll_factor = 4;
+	ASSERT_EQ(1, mCc_tac_opt_unroll_loops(tac, &options));
+	// Unrolled loop followed by the remainder loop
+	ASSERT_EQ(2u, count_quads(tac, MCC_TAC_QUAD_JUMPFALSE));
+	ASSERT_EQ(2u, count_quads(tac, MCC_TAC_QUAD_JUMP));
+	ASSERT_EQ(1u + 4u + 1u, count_quads(tac, MCC_TAC_QUAD_CALL));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_UNROLL_LOOPS, SizeBudget)
+{
+	const char input[] = "void main() { int i; i = 0;"
+	                     "while (i < 100) { print_int(i); i = i + 1; } }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	auto options = mCc_tac_opt_default_options(3);
+	options.unroll_max_size = 8;
+	ASSERT_EQ(0, mCc_tac_opt_unroll_loops(tac, &options));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_JUMP));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_UNROLL_LOOPS, NoInductionVariable)
+{
+	const char input[] = "void main() { int i; i = 1;"
+	                     "while (i < 100) { i = i * 2; } print_int(i); }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	auto options = mCc_tac_opt_default_options(3);
+	ASSERT_EQ(0, mCc_tac_opt_unroll_loops(tac, &options));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_VECTORIZE_LOOPS, ElementWise)
+{
+	const char input[] = "void main() { int[64] a; int i; i = 0;"
+	                     "while (i < 63) { a[i] = a[i] + a[i]; i = i + 1; } }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(1, mCc_tac_opt_vectorize_loops(tac));
+	ASSERT_EQ(2u, count_quads(tac, MCC_TAC_QUAD_VECTOR_LOAD));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_VECTOR_OP));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_VECTOR_STORE));
+	// The scalar loop is kept for the remaining iterations
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_STORE));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_VECTORIZE_LOOPS, Reduction)
+{
+	const char input[] = "int sum(int[64] a, int n) { int i; int s;"
+	                     "i = 0; s = 0;"
+	                     "while (i < n) { s = s + a[i]; i = i + 1; }"
+	                     "return s; }"
+	                     "void main() { int[64] a; a[0] = 1;"
+	                     "print_int(sum(a, 1)); }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(1, mCc_tac_opt_vectorize_loops(tac));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_VECTOR_ZERO));
+	ASSERT_EQ(1u, count_quads(tac, MCC_TAC_QUAD_VECTOR_REDUCE));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_VECTORIZE_LOOPS, LoopCarriedDependence)
+{
+	const char input[] = "void main() { int[64] a; int i; i = 0;"
+	                     "while (i < 63) { a[i + 1] = a[i]; i = i + 1; } }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	ASSERT_EQ(0, mCc_tac_opt_vectorize_loops(tac));
+
+	delete_tac(tac, ast);
+}
+
+TEST(TAC_OPT_VECTORIZE_LOOPS, IntMultiplication)
+{
+	const char input[] = "void main() { int[64] a; int i; i = 0;"
+	                     "while (i < 63) { a[i] = a[i] * 3; i = i + 1; } }";
+	struct mCc_ast_program *ast;
+	auto tac = build_tac(input, &ast);
+	ASSERT_NE(nullptr, tac);
+
+	// There is no packed 32-bit multiplication in SSE2
+	ASSERT_EQ(0, mCc_tac_opt_vectorize_loops(tac));
+
+	delete_tac(tac, ast);
+}
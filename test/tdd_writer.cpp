@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "mCc/writer.h"
+
+static std::string take(struct mCc_writer *w)
+{
+	size_t size;
+	char *memory = mCc_writer_take_memory(w, &size);
+	EXPECT_NE(nullptr, memory);
+	std::string result(memory, size);
+	free(memory);
+	return result;
+}
+
+TEST(Writer, Emitters)
+{
+	struct mCc_writer w;
+	mCc_writer_init_memory(&w);
+
+	mCc_writer_puts(&w, "\tmovl\t");
+	mCc_writer_mem(&w, -8, "ebp");
+	mCc_writer_puts(&w, ", ");
+	mCc_writer_reg(&w, "eax");
+	mCc_writer_putc(&w, '\n');
+	mCc_writer_int(&w, -2147483647L - 1);
+	mCc_writer_putc(&w, ' ');
+	mCc_writer_uint(&w, 0);
+	mCc_writer_putc(&w, ' ');
+	mCc_writer_ptr(&w, (void *)0x1f);
+	mCc_writer_putc(&w, ' ');
+	mCc_writer_ptr(&w, nullptr);
+	mCc_writer_printf(&w, " %.2f", 1.5);
+
+	ASSERT_EQ("\tmovl\t-8(%ebp), %eax\n-2147483648 0 0x1f (nil) 1.50",
+	          take(&w));
+	ASSERT_EQ(0, mCc_writer_close(&w));
+}
+
+TEST(Writer, LargeOutput)
+{
+	struct mCc_writer w;
+	mCc_writer_init_memory(&w);
+
+	// Crosses the buffer with small writes, one huge write and printf
+	std::string expected;
+	for (int i = 0; i < 10000; ++i) {
+		mCc_writer_int(&w, i);
+		mCc_writer_putc(&w, ',');
+		expected += std::to_string(i) + ",";
+	}
+	std::string big(3 * MCC_WRITER_BUFFER_SIZE, 'x');
+	mCc_writer_write(&w, big.data(), big.size());
+	expected += big;
+	std::string line(MCC_WRITER_BUFFER_SIZE - 10, 'y');
+	mCc_writer_printf(&w, "%s%s", line.c_str(), line.c_str());
+	expected += line + line;
+
+	ASSERT_EQ(expected, take(&w));
+	ASSERT_EQ(0, mCc_writer_close(&w));
+}
+
+TEST(Writer, File)
+{
+	FILE *file = tmpfile();
+	ASSERT_NE(nullptr, file);
+
+	struct mCc_writer w;
+	mCc_writer_init_file(&w, file);
+	mCc_writer_puts(&w, "t");
+	mCc_writer_int(&w, 42);
+	ASSERT_EQ(0, mCc_writer_flush(&w));
+
+	rewind(file);
+	char buf[8] = { 0 };
+	ASSERT_EQ(3u, fread(buf, 1, sizeof(buf), file));
+	ASSERT_STREQ("t42", buf);
+	fclose(file);
+}
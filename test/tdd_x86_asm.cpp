@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "mCc/elf.h"
+#include "mCc/x86_asm.h"
+
+static struct mCc_elf_object *assemble(const char *input,
+                                       struct mCc_elf_error *error)
+{
+	FILE *in = fmemopen((void *)input, strlen(input), "r");
+	EXPECT_NE(nullptr, in);
+	auto obj = mCc_elf_object_new();
+	if (mCc_x86_assemble(in, obj, error)) {
+		mCc_elf_object_delete(obj);
+		obj = nullptr;
+	}
+	fclose(in);
+	return obj;
+}
+
+static std::vector<unsigned char> text(const struct mCc_elf_object *obj)
+{
+	for (unsigned int i = 0; i < obj->section_count; ++i)
+		if (strcmp(obj->sections[i].name, ".text") == 0)
+			return std::vector<unsigned char>(
+			    obj->sections[i].data,
+			    obj->sections[i].data + obj->sections[i].size);
+	return {};
+}
+
+TEST(X86_ASM, GeneralPurpose)
+{
+	const char input[] = "\tmovl %eax, -4(%ebp)\n"
+	                     "\tmovl 8(%ebp), %edx\n"
+	                     "\taddl $1, %eax # comment\n"
+	                     "\tsubl $1000, %esp\n"
+	                     "\timull -8(%ebp), %eax\n"
+	                     "\tleal 0(,%eax,4), %edx\n"
+	                     "\tmovl %edx, -20(%ebp,%eax,4)\n"
+	                     "\tsetle %al\n"
+	                     "\tmovzx %al, %eax\n"
+	                     "\tcmovne -12(%ebp), %eax\n";
+	struct mCc_elf_error error;
+	auto obj = assemble(input, &error);
+	ASSERT_NE(nullptr, obj) << error.msg;
+
+	std::vector<unsigned char> expected = {
+		0x89, 0x45, 0xfc,                   // movl %eax,-4(%ebp)
+		0x8b, 0x55, 0x08,                   // movl 8(%ebp),%edx
+		0x83, 0xc0, 0x01,                   // addl $1,%eax
+		0x81, 0xec, 0xe8, 0x03, 0x00, 0x00, // subl $1000,%esp
+		0x0f, 0xaf, 0x45, 0xf8,             // imull -8(%ebp),%eax
+		0x8d, 0x14, 0x85, 0, 0, 0, 0,       // leal 0(,%eax,4),%edx
+		0x89, 0x54, 0x85, 0xec,             // movl %edx,-20(%ebp,%eax,4)
+		0x0f, 0x9e, 0xc0,                   // setle %al
+		0x0f, 0xb6, 0xc0,                   // movzx %al,%eax
+		0x0f, 0x45, 0x45, 0xf4,             // cmovne -12(%ebp),%eax
+	};
+	ASSERT_EQ(expected, text(obj));
+
+	mCc_elf_object_delete(obj);
+}
+
+TEST(X86_ASM, FloatAndVector)
+{
+	const char input[] = "\tflds -4(%ebp)\n"
+	                     "\tfmuls -8(%ebp)\n"
+	                     "\tfstps -12(%ebp)\n"
+	                     "\tfchs\n"
+	                     "\tmovdqu (%eax), %xmm1\n"
+	                     "\tpaddd %xmm2, %xmm1\n"
+	                     "\tpshufd $0xb1, %xmm0, %xmm1\n"
+	                     "\tmovd %xmm7, %eax\n";
+	struct mCc_elf_error error;
+	auto obj = assemble(input, &error);
+	ASSERT_NE(nullptr, obj) << error.msg;
+
+	std::vector<unsigned char> expected = {
+		0xd9, 0x45, 0xfc,             // flds -4(%ebp)
+		0xd8, 0x4d, 0xf8,             // fmuls -8(%ebp)
+		0xd9, 0x5d, 0xf4,             // fstps -12(%ebp)
+		0xd9, 0xe0,                   // fchs
+		0xf3, 0x0f, 0x6f, 0x08,       // movdqu (%eax),%xmm1
+		0x66, 0x0f, 0xfe, 0xca,       // paddd %xmm2,%xmm1
+		0x66, 0x0f, 0x70, 0xc8, 0xb1, // pshufd $0xb1,%xmm0,%xmm1
+		0x66, 0x0f, 0x7e, 0xf8,       // movd %xmm7,%eax
+	};
+	ASSERT_EQ(expected, text(obj));
+
+	mCc_elf_object_delete(obj);
+}
+
+TEST(X86_ASM, BranchesAndRelocations)
+{
+	const char input[] = ".section .rodata\n"
+	                     "S0:\n"
+	                     ".string \"hi\"\n"
+	                     ".text\n"
+	                     ".global main\n"
+	                     "main:\n"
+	                     ".L0:\n"
+	                     "\tmovl $S0, -4(%ebp)\n"
+	                     "\tcall print\n"
+	                     "\tjne .L0\n";
+	struct mCc_elf_error error;
+	auto obj = assemble(input, &error);
+	ASSERT_NE(nullptr, obj) << error.msg;
+
+	auto code = text(obj);
+	ASSERT_EQ(18u, code.size());
+	// jne .L0 is resolved: rel32 = 0 - 18
+	ASSERT_EQ(0x0f, code[12]);
+	ASSERT_EQ(0x85, code[13]);
+	ASSERT_EQ(0xee, code[14]);
+	ASSERT_EQ(0xff, code[17]);
+
+	// $S0 is absolute, print is external
+	const struct mCc_elf_section *section = &obj->sections[0];
+	ASSERT_STREQ(".text", section->name);
+	ASSERT_EQ(2u, section->reloc_count);
+	ASSERT_EQ(MCC_ELF_R_386_32, section->relocs[0].type);
+	ASSERT_EQ(3u, section->relocs[0].offset);
+	ASSERT_STREQ("S0", obj->symbols[section->relocs[0].symbol].name);
+	ASSERT_EQ(MCC_ELF_R_386_PC32, section->relocs[1].type);
+	ASSERT_EQ(8u, section->relocs[1].offset);
+	auto print = &obj->symbols[section->relocs[1].symbol];
+	ASSERT_STREQ("print", print->name);
+	ASSERT_EQ(MCC_ELF_UNDEF, print->section);
+	ASSERT_TRUE(print->global);
+
+	mCc_elf_object_delete(obj);
+}
+
+TEST(X86_ASM, MultiLineString)
+{
+	const char input[] = ".section .rodata\n"
+	                     ".string \"a\\tb\n"
+	                     "c\"\n";
+	struct mCc_elf_error error;
+	auto obj = assemble(input, &error);
+	ASSERT_NE(nullptr, obj) << error.msg;
+
+	const struct mCc_elf_section *section = &obj->sections[1];
+	ASSERT_STREQ(".rodata", section->name);
+	ASSERT_EQ(6u, section->size);
+	ASSERT_EQ(0, memcmp("a\tb\nc", section->data, 6));
+
+	mCc_elf_object_delete(obj);
+}
+
+TEST(X86_ASM, Error)
+{
+	const char input[] = "\tmovl %eax, %ebx\n"
+	                     "\tfrobnicate %eax\n";
+	struct mCc_elf_error error;
+	ASSERT_EQ(nullptr, assemble(input, &error));
+	ASSERT_EQ(2u, error.line);
+	ASSERT_STREQ("unknown instruction frobnicate", error.msg);
+}
+
+TEST(ELF, WriteAndRead)
+{
+	const char input[] = ".section .rodata\n"
+	                     "S0:\n"
+	                     ".string \"hi\"\n"
+	                     ".text\n"
+	                     ".global main\n"
+	                     "main:\n"
+	                     "\tpushl $S0\n"
+	                     "\tcall print\n";
+	struct mCc_elf_error error;
+	auto obj = assemble(input, &error);
+	ASSERT_NE(nullptr, obj) << error.msg;
+
+	FILE *file = tmpfile();
+	ASSERT_NE(nullptr, file);
+	ASSERT_EQ(0, mCc_elf_write_object(obj, file));
+	rewind(file);
+	auto read = mCc_elf_read_object(file, &error);
+	fclose(file);
+	ASSERT_NE(nullptr, read) << error.msg;
+
+	ASSERT_EQ(2u, read->section_count);
+	ASSERT_STREQ(".text", read->sections[0].name);
+	ASSERT_EQ(obj->sections[0].size, read->sections[0].size);
+	ASSERT_EQ(2u, read->sections[0].reloc_count);
+	// The reference to S0 goes through the .rodata section symbol
+	auto s0 = &read->symbols[read->sections[0].relocs[0].symbol];
+	ASSERT_TRUE(s0->is_section);
+	ASSERT_EQ(1, s0->section);
+	auto print = &read->symbols[read->sections[0].relocs[1].symbol];
+	ASSERT_STREQ("print", print->name);
+	ASSERT_EQ(MCC_ELF_UNDEF, print->section);
+
+	mCc_elf_object_delete(read);
+	mCc_elf_object_delete(obj);
+}
+
+TEST(ELF, Link)
+{
+	struct mCc_elf_error error;
+	auto start = assemble(".global _start\n"
+	                      "_start:\n"
+	                      "\tcall main\n",
+	                      &error);
+	ASSERT_NE(nullptr, start) << error.msg;
+	auto prog = assemble(".global main\n"
+	                     "main:\n"
+	                     "\tret\n",
+	                     &error);
+	ASSERT_NE(nullptr, prog) << error.msg;
+
+	struct mCc_elf_object *objs[] = { start, prog };
+	FILE *file = tmpfile();
+	ASSERT_NE(nullptr, file);
+	ASSERT_EQ(0, mCc_elf_link(objs, 2, file, &error)) << error.msg;
+	// main follows _start directly, the call is relocated
+	ASSERT_EQ(prog->sections[0].addr, start->sections[0].addr + 5);
+	fclose(file);
+
+	// Without main, the call cannot be resolved
+	file = tmpfile();
+	ASSERT_NE(nullptr, file);
+	ASSERT_NE(0, mCc_elf_link(objs, 1, file, &error));
+	ASSERT_STREQ("undefined reference to `main'", error.msg);
+	fclose(file);
+
+	mCc_elf_object_delete(start);
+	mCc_elf_object_delete(prog);
+}